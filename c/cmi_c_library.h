@@ -39,6 +39,7 @@ void cmi_init_periodic_sp(const char *parameter_file, const int num_thread,
                           const double unit_mass_in_SI, const float *box_anchor,
                           const float *box_sides);
 void cmi_destroy();
+void cmi_set_persistent_mode(const int persistent_mode);
 
 void cmi_compute_neutral_fraction_dp(const double *x, const double *y,
                                      const double *z, const double *h,
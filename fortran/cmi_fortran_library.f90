@@ -128,6 +128,21 @@ module cmi_fortran_library
     subroutine cmi_destroy() bind(C, name = "cmi_destroy")
     end subroutine cmi_destroy
 
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_set_persistent_mode().
+    !>
+    !> @param persistent_mode Persistent mode flag (0: off, otherwise: on).
+    !-
+    subroutine cmi_set_persistent_mode(persistent_mode) &
+      bind(C, name = "cmi_set_persistent_mode")
+
+      use iso_c_binding
+      implicit none
+
+      integer (kind = c_int), intent(in), value :: persistent_mode
+
+    end subroutine cmi_set_persistent_mode
+
     !-
     !> @brief Fortran interface for
     !> CMILibrary::cmi_compute_neutral_fraction_dp().
@@ -25,13 +25,16 @@
  */
 #include "EmissivityCalculator.hpp"
 #include "DensityGrid.hpp"
+#include "EmissionMapRenderer.hpp"
 #include "LineCoolingData.hpp"
 #include <boost/python/class.hpp>
 #include <boost/python/dict.hpp>
 #include <boost/python/extract.hpp>
+#include <boost/python/list.hpp>
 #include <boost/python/make_constructor.hpp>
 #include <boost/python/module.hpp>
 #include <boost/python/numeric.hpp>
+#include <cmath>
 
 /*! @brief Tell numpy to use the non deprecated API. */
 #define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
@@ -95,45 +98,6 @@ static void compute_emissivities(EmissivityCalculator &calculator,
   calculator.calculate_emissivities(grid);
 }
 
-/**
- * @brief Get the units in which the given variable name is expressed.
- *
- * @param name std::string representation of a cell variable name.
- * @return std::string representation of the units in which that variable is
- * expressed.
- */
-static std::string get_variable_unit(std::string name) {
-  // names are ordered alphabetically
-  if (name.find("NeutralFraction") == 0) {
-    // all neutral fractions are dimensionless
-    return "";
-  } else if (name == "NumberDensity") {
-    return "m^-3";
-  } else if (name == "OI_6300") {
-    return "no idea";
-  } else if (name == "Temperature") {
-    return "K";
-  } else {
-    cmac_error("Unknown variable: %s!", name.c_str());
-    return "";
-  }
-}
-
-/**
- * @brief Get the EmissionLine corresponding to the given std::string.
- *
- * @param name Name of an EmissionLine.
- * @return Corresponding EmissionLine.
- */
-static EmissionLine get_line(std::string name) {
-  if (name == "OI_6300") {
-    return EMISSIONLINE_OI_6300;
-  } else {
-    cmac_error("Unknown emission line name: %s!", name.c_str());
-    return NUMBER_OF_EMISSIONLINES;
-  }
-}
-
 /**
  * @brief Make an emission map for the given emission line in the given
  * direction.
@@ -144,7 +108,7 @@ static EmissionLine get_line(std::string name) {
  * @param line EmissionLine to make a map of.
  * @param shape Size of the resulting map.
  * @return Python dict containing a numpy.ndarray with the requested map, and a
- * string representation of the units in which the variables are expressed.
+ * string representation of the units in which the map is expressed.
  */
 static boost::python::dict make_emission_map(EmissivityCalculator &calculator,
                                              DensityGrid &grid, char direction,
@@ -160,43 +124,97 @@ static boost::python::dict make_emission_map(EmissivityCalculator &calculator,
   boost::python::handle<> handle(narr);
   boost::python::numeric::array arr(handle);
 
-  Box<> box = grid.get_box();
+  // convert the coordinate direction into viewing angles for which the image
+  // axes correspond to the remaining coordinate axes
+  // for the y direction, the first image axis points in the negative x
+  // direction, so we have to flip the image
+  double theta = 0.;
+  double phi = 0.;
+  bool flip = false;
+  if (direction == 'x') {
+    theta = 0.5 * M_PI;
+    phi = 0.;
+  } else if (direction == 'y') {
+    theta = 0.5 * M_PI;
+    phi = 0.5 * M_PI;
+    flip = true;
+  } else if (direction == 'z') {
+    theta = 0.;
+    phi = -0.5 * M_PI;
+  } else {
+    cmac_error("Unknown coordinate direction: %c!", direction);
+  }
+
+  const std::vector< EmissionLine > lines(1, EmissivityValues::get_line(line));
+  EmissionMapRenderer renderer(theta, phi, size[0], size[1], 0., 0., -1., -1.,
+                               lines);
+  renderer.render(grid);
 
   for (int_fast32_t i = 0; i < size[0]; ++i) {
+    const int_fast32_t ix = flip ? size[0] - 1 - i : i;
     for (int_fast32_t j = 0; j < size[1]; ++j) {
-      CoordinateVector<> start;
-      CoordinateVector<> dir;
-      if (direction == 'x') {
-        dir[0] = 1.;
-        start[0] = box.get_anchor().x();
-        start[1] =
-            box.get_anchor().y() + (i + 0.5) * box.get_sides().y() / size[0];
-        start[2] =
-            box.get_anchor().z() + (j + 0.5) * box.get_sides().z() / size[1];
-      } else if (direction == 'y') {
-        dir[1] = 1.;
-        start[0] =
-            box.get_anchor().x() + (i + 0.5) * box.get_sides().x() / size[0];
-        start[1] = box.get_anchor().y();
-        start[2] =
-            box.get_anchor().z() + (j + 0.5) * box.get_sides().z() / size[1];
-      } else if (direction == 'z') {
-        dir[2] = 1.;
-        start[0] =
-            box.get_anchor().x() + (i + 0.5) * box.get_sides().x() / size[0];
-        start[1] =
-            box.get_anchor().y() + (j + 0.5) * box.get_sides().y() / size[1];
-        start[2] = box.get_anchor().z();
-      } else {
-        cmac_error("Unknown coordinate direction: %c!", direction);
-      }
-      arr[i][j] = grid.get_total_emission(start, dir, get_line(line));
+      arr[i][j] = renderer.get_pixel(0, ix, j);
     }
   }
 
   boost::python::dict result;
   result["values"] = arr.copy();
-  result["units"] = get_variable_unit(line);
+  result["units"] = "J m^-2 s^-1";
+  return result;
+}
+
+/**
+ * @brief Make emission maps for the given emission lines, as seen from an
+ * observer in the given direction.
+ *
+ * All maps are rendered at once, in parallel, by tracing every ray only once.
+ *
+ * @param calculator EmissivityCalculator on which to act (acts as self).
+ * @param grid DensityGrid on which to act.
+ * @param theta Viewing angle @f$\theta{}@f$ (in radians).
+ * @param phi Viewing angle @f$\phi{}@f$ (in radians).
+ * @param line_names Python list with the names of the lines to render.
+ * @param shape Size of the resulting maps.
+ * @param num_threads Number of threads to use (-1 means all available
+ * threads).
+ * @return Python dict containing a numpy.ndarray with the requested map for
+ * every line, and a string representation of the units in which the maps are
+ * expressed.
+ */
+static boost::python::dict
+make_emission_maps(EmissivityCalculator &calculator, DensityGrid &grid,
+                   double theta, double phi, boost::python::list line_names,
+                   boost::python::tuple shape, int num_threads) {
+
+  // make sure the grid has emissivity values
+  calculator.calculate_emissivities(grid);
+
+  npy_intp size[2] = {boost::python::extract< unsigned int >(shape[0]),
+                      boost::python::extract< unsigned int >(shape[1])};
+
+  std::vector< EmissionLine > lines;
+  for (boost::python::ssize_t i = 0; i < boost::python::len(line_names);
+       ++i) {
+    lines.push_back(EmissivityValues::get_line(
+        boost::python::extract< std::string >(line_names[i])));
+  }
+
+  EmissionMapRenderer renderer(theta, phi, size[0], size[1], 0., 0., -1., -1.,
+                               lines, "", ".", num_threads);
+  renderer.render(grid);
+
+  boost::python::dict result;
+  for (size_t iline = 0; iline < lines.size(); ++iline) {
+    PyObject *narr = PyArray_SimpleNew(2, size, NPY_DOUBLE);
+    boost::python::handle<> handle(narr);
+    boost::python::numeric::array arr(handle);
+    const std::vector< double > &image = renderer.get_image(iline);
+    std::copy(image.begin(), image.end(),
+              static_cast< double * >(PyArray_DATA(
+                  reinterpret_cast< PyArrayObject * >(arr.ptr()))));
+    result[EmissivityValues::get_name(lines[iline])] = arr;
+  }
+  result["units"] = "J m^-2 s^-1";
   return result;
 }
 
@@ -239,7 +257,8 @@ BOOST_PYTHON_MODULE(libemissivitycalculator) {
            boost::python::make_constructor(&initEmissivityCalculator))
       .def("get_emissivities", &get_emissivities)
       .def("compute_emissivities", &compute_emissivities)
-      .def("make_emission_map", &make_emission_map);
+      .def("make_emission_map", &make_emission_map)
+      .def("make_emission_maps", &make_emission_maps);
 
   boost::python::class_< Abundances, boost::shared_ptr< Abundances >,
                          boost::noncopyable >("Abundances",
@@ -163,6 +163,7 @@ private:
                 static_cast< HeatingTermName >(i);
             _ionization_variables[index].set_heating(heating_term, 0.);
           }
+          _ionization_variables[index].set_mean_intensity_second_moment(0.);
         } else {
           _ionization_variables.push_back(IonizationVariables());
           _emissivities.push_back(nullptr);
@@ -327,6 +328,10 @@ public:
     DensityGrid::initialize(block, density_function);
     DensityGrid::set_densities(block, density_function);
 
+    // if the block covers the entire grid, it should also cover the cells that
+    // are added by the refinement
+    const bool full_block = (block.first == 0 && block.second == _cells.size());
+
     // apply mesh refinement
     if (_refinement_scheme) {
       if (_log) {
@@ -356,6 +361,9 @@ public:
     // function, as it is also used in reset_grid()
     // at this point, we want to read all values from the density function,
     // since it also contains the initial temperature etc.
+    if (full_block) {
+      block.second = _cells.size();
+    }
     DensityGrid::set_densities(block, density_function);
   }
 
@@ -692,17 +700,23 @@ public:
 
   /**
    * @brief Get the total line emission along a ray with the given origin and
-   * direction.
+   * direction, for all given lines at once.
    *
    * @param origin Origin of the ray (in m).
    * @param direction Direction of the ray.
-   * @param line EmissionLine name of the line to trace.
-   * @return Accumulated emission along the ray (in J m^-2 s^-1).
+   * @param lines EmissionLine names of the lines to trace.
+   * @param emissions Array to store the accumulated emission along the ray for
+   * every line in (in J m^-2 s^-1).
    */
-  virtual double get_total_emission(CoordinateVector<> origin,
-                                    CoordinateVector<> direction,
-                                    EmissionLine line) {
-    double S = 0.;
+  virtual void get_total_emissions(CoordinateVector<> origin,
+                                   CoordinateVector<> direction,
+                                   const std::vector< EmissionLine > &lines,
+                                   double *emissions) {
+
+    const size_t numline = lines.size();
+    for (size_t iline = 0; iline < numline; ++iline) {
+      emissions[iline] = 0.;
+    }
 
     cellsize_t index = get_cell_index(origin);
     AMRGridCell< cellsize_t > *current_cell = _cells[index];
@@ -720,14 +734,15 @@ public:
 
       origin = next_wall;
 
-      S += it.get_emissivities()->get_emissivity(line);
+      const EmissivityValues *emissivities = it.get_emissivities();
+      for (size_t iline = 0; iline < numline; ++iline) {
+        emissions[iline] += ds * emissivities->get_emissivity(lines[iline]);
+      }
 
       if (periodic_correction.norm2() > 0.) {
         break;
       }
     }
-
-    return S;
   }
 
   /**
@@ -787,6 +802,54 @@ public:
     return std::vector< Face >();
   }
 
+  /**
+   * @brief Get the geometrical information needed to integrate a function over
+   * the cell with the given index and to walk from the cell to its
+   * neighbours.
+   *
+   * @param index Index of a cell.
+   * @param bounding_box Geometrical box of the cell (in m).
+   * @param planes Empty, since the cell coincides with its box.
+   * @param ngbs Indices of the lowest level cells that share a face with the
+   * cell.
+   */
+  virtual void get_cell_geometry(
+      cellsize_t index, Box<> &bounding_box,
+      std::vector< std::pair< CoordinateVector<>, double > > &planes,
+      std::vector< cellsize_t > &ngbs) const {
+
+    const AMRGridCell< cellsize_t > *cell = _cells[index];
+    bounding_box = cell->get_geometry();
+    planes.clear();
+    ngbs.clear();
+    std::vector< AMRGridCell< cellsize_t > * > border_cells;
+    for (uint_fast8_t i = 0; i < 6; ++i) {
+      const AMRNgbPosition side = static_cast< AMRNgbPosition >(i);
+      AMRGridCell< cellsize_t > *ngb = cell->get_ngb(side);
+      if (ngb == nullptr) {
+        continue;
+      }
+      // skip neighbours across a periodic boundary: they are on the wrong side
+      // of the cell
+      const uint_fast8_t dim = i / 2;
+      const double ngb_anchor = ngb->get_geometry().get_anchor()[dim];
+      const double cell_anchor = bounding_box.get_anchor()[dim];
+      if ((i % 2 == 0 && ngb_anchor >= cell_anchor) ||
+          (i % 2 == 1 && ngb_anchor <= cell_anchor)) {
+        continue;
+      }
+      // the neighbour is either a lowest level cell, or a refined cell at the
+      // same level: in the latter case we need all its children that border
+      // the cell
+      border_cells.clear();
+      ngb->get_border_cells(static_cast< AMRNgbPosition >(i ^ 1),
+                            border_cells);
+      for (size_t j = 0; j < border_cells.size(); ++j) {
+        ngbs.push_back(border_cells[j]->value());
+      }
+    }
+  }
+
   /**
    * @brief Print the grid to the given stream for visual inspection.
    *
@@ -30,6 +30,7 @@
 #include "Error.hpp"
 
 #include <ostream>
+#include <vector>
 
 /*! @brief The maximal value a key can take. */
 #define AMRGRIDCELL_MAXKEY 0xffffffff
@@ -654,6 +655,30 @@ public:
     return _ngbs[position];
   }
 
+  /**
+   * @brief Get the lowest level cells in this cell that border the given side
+   * of this cell.
+   *
+   * @param side Side of the cell.
+   * @param cells std::vector to add the lowest level cells to.
+   */
+  inline void get_border_cells(AMRNgbPosition side,
+                               std::vector< AMRGridCell * > &cells) {
+    if (_values != nullptr) {
+      cells.push_back(this);
+    } else {
+      // side / 2 is the dimension (x = 0, y = 1, z = 2), side % 2 the
+      // requested child coordinate in that dimension (see AMRChildPosition)
+      const uint_fast8_t shift = 2 - side / 2;
+      const uint_fast8_t high = side % 2;
+      for (uint_fast8_t i = 0; i < 8; ++i) {
+        if (((i >> shift) & 1) == high && _children[i] != nullptr) {
+          _children[i]->get_border_cells(side, cells);
+        }
+      }
+    }
+  }
+
   /**
    * @brief Print the cell to the given stream.
    *
@@ -30,6 +30,29 @@
 #include "DensityGrid.hpp"
 #include "Utilities.hpp"
 #include <fstream>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Write the given cell values to the file with the given name.
+ *
+ * @param filename Name of the file.
+ * @param values Cell values: 6 values per cell (midpoint position, number
+ * density, volume and neutral hydrogen fraction).
+ */
+static void write_snapshot(const std::string filename,
+                           const std::vector< double > &values) {
+
+  std::ofstream file(filename);
+
+  file << "#x (m)\ty (m)\tz (m)\tn (m^-3)\tvolume (m^3)\tneutral H fraction\n";
+
+  for (size_t i = 0; i < values.size(); i += 6) {
+    file << values[i] << "\t" << values[i + 1] << "\t" << values[i + 2]
+         << "\t" << values[i + 3] << "\t" << values[i + 4] << "\t"
+         << values[i + 5] << "\n";
+  }
+}
 
 /**
  * @brief Constructor.
@@ -37,10 +60,16 @@
  * @param prefix Prefix of snapshot file names.
  * @param output_folder Name of the folder where output files should be placed.
  * @param log Log to write logging information to.
+ * @param maximum_number_of_snapshots_in_flight Maximum number of snapshots that
+ * can be staged for asynchronous writing at the same time. If 0, snapshots are
+ * written synchronously.
  */
 AsciiFileDensityGridWriter::AsciiFileDensityGridWriter(
-    std::string prefix, std::string output_folder, Log *log)
-    : DensityGridWriter(output_folder, log), _prefix(prefix) {}
+    std::string prefix, std::string output_folder, Log *log,
+    uint_fast32_t maximum_number_of_snapshots_in_flight)
+    : DensityGridWriter(output_folder, log,
+                        maximum_number_of_snapshots_in_flight),
+      _prefix(prefix) {}
 
 /**
  * @brief ParameterFile constructor.
@@ -48,6 +77,10 @@ AsciiFileDensityGridWriter::AsciiFileDensityGridWriter(
  * Parameters are:
  *  - prefix: Prefix that will be prepended to all snapshot file names (default:
  *    snapshot)
+ *  - asynchronous output: Write snapshots from a background I/O thread, while
+ *    the simulation continues (default: false)
+ *  - maximum number of snapshots in flight: Maximum number of snapshots that
+ *    are staged for asynchronous output at the same time (default: 2)
  *
  * @param output_folder Name of the folder where output files should be placed.
  * @param params ParameterFile to read.
@@ -57,7 +90,9 @@ AsciiFileDensityGridWriter::AsciiFileDensityGridWriter(
     std::string output_folder, ParameterFile &params, Log *log)
     : AsciiFileDensityGridWriter(params.get_value< std::string >(
                                      "DensityGridWriter:prefix", "snapshot"),
-                                 output_folder, log) {}
+                                 output_folder, log,
+                                 get_maximum_number_of_snapshots_in_flight(
+                                     params)) {}
 
 /**
  * @brief Write a snapshot.
@@ -74,17 +109,30 @@ void AsciiFileDensityGridWriter::write(DensityGrid &grid,
 
   std::string filename =
       Utilities::compose_filename(_output_folder, _prefix, "txt", iteration, 3);
-  std::ofstream file(filename);
-
-  file << "#x (m)\ty (m)\tz (m)\tn (m^-3)\tvolume (m^3)\tneutral H fraction\n";
 
+  // copy the cell values, so that the file can be written asynchronously
+  // (only once a slot is available, to bound the number of copies)
+  if (_write_queue != nullptr) {
+    _write_queue->acquire_slot();
+  }
+  std::shared_ptr< std::vector< double > > values =
+      std::make_shared< std::vector< double > >();
+  values->reserve(6 * grid.get_number_of_cells());
   for (auto it = grid.begin(); it != grid.end(); ++it) {
-    CoordinateVector<> x = it.get_cell_midpoint();
-    double n = it.get_ionization_variables().get_number_density();
-    IonName ion = ION_H_n;
-    double frac = it.get_ionization_variables().get_ionic_fraction(ion);
-    double volume = it.get_volume();
-    file << x.x() << "\t" << x.y() << "\t" << x.z() << "\t" << n << "\t"
-         << volume << "\t" << frac << "\n";
+    const CoordinateVector<> x = it.get_cell_midpoint();
+    values->push_back(x.x());
+    values->push_back(x.y());
+    values->push_back(x.z());
+    values->push_back(it.get_ionization_variables().get_number_density());
+    values->push_back(it.get_volume());
+    values->push_back(
+        it.get_ionization_variables().get_ionic_fraction(ION_H_n));
+  }
+
+  if (_write_queue == nullptr) {
+    write_snapshot(filename, *values);
+  } else {
+    _write_queue->add_job(
+        [filename, values]() { write_snapshot(filename, *values); });
   }
 }
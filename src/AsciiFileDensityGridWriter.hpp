@@ -37,8 +37,9 @@ private:
   std::string _prefix;
 
 public:
-  AsciiFileDensityGridWriter(std::string prefix, std::string output_folder,
-                             Log *log = nullptr);
+  AsciiFileDensityGridWriter(
+      std::string prefix, std::string output_folder, Log *log = nullptr,
+      uint_fast32_t maximum_number_of_snapshots_in_flight = 0);
 
   AsciiFileDensityGridWriter(std::string output_folder, ParameterFile &params,
                              Log *log = nullptr);
@@ -0,0 +1,179 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file AsynchronousWriteQueue.hpp
+ *
+ * @brief Bounded queue of output jobs that are executed by a single background
+ * I/O thread.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef ASYNCHRONOUSWRITEQUEUE_HPP
+#define ASYNCHRONOUSWRITEQUEUE_HPP
+
+#include "Error.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Bounded queue of output jobs that are executed by a single background
+ * I/O thread.
+ *
+ * Jobs are executed in the order in which they were added. Since all jobs are
+ * executed by the same thread, libraries that are not thread safe (like HDF5)
+ * can safely be used within the jobs, as long as they are not used by another
+ * thread at the same time.
+ *
+ * The number of jobs in flight (jobs that are waiting or are being executed) is
+ * bounded. Adding a job happens in two steps: acquire_slot() blocks until a
+ * slot becomes available and reserves it, after which add_job() hands over the
+ * job. A caller should only fill the staging buffer of its job after it
+ * acquired a slot, so that the number of staging buffers that exist at any
+ * given time is bounded by the maximum number of jobs in flight.
+ */
+class AsynchronousWriteQueue {
+private:
+  /*! @brief Maximum number of jobs in flight. */
+  const uint_fast32_t _maximum_number_of_jobs;
+
+  /*! @brief Jobs that are waiting or are being executed. The job that is being
+   *  executed is only removed from the queue when it is finished. */
+  std::deque< std::function< void() > > _jobs;
+
+  /*! @brief Number of slots that were acquired but for which no job was added
+   *  yet. */
+  uint_fast32_t _number_of_acquired_slots;
+
+  /*! @brief Flag signalling the I/O thread to stop once the queue is empty. */
+  bool _stop;
+
+  /*! @brief Mutex protecting the queue. */
+  std::mutex _mutex;
+
+  /*! @brief Condition variable used to signal changes to the queue. */
+  std::condition_variable _condition;
+
+  /*! @brief Background I/O thread. */
+  std::thread _thread;
+
+  /**
+   * @brief Main loop of the background I/O thread.
+   */
+  inline void execute_jobs() {
+    std::unique_lock< std::mutex > lock(_mutex);
+    while (true) {
+      _condition.wait(lock, [this]() { return _stop || !_jobs.empty(); });
+      if (_jobs.empty()) {
+        // _stop is set and there is nothing left to do
+        return;
+      }
+      std::function< void() > job = _jobs.front();
+      lock.unlock();
+      job();
+      lock.lock();
+      _jobs.pop_front();
+      _condition.notify_all();
+    }
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * Starts the background I/O thread.
+   *
+   * @param maximum_number_of_jobs Maximum number of jobs in flight.
+   */
+  inline AsynchronousWriteQueue(const uint_fast32_t maximum_number_of_jobs)
+      : _maximum_number_of_jobs(maximum_number_of_jobs),
+        _number_of_acquired_slots(0), _stop(false) {
+
+    if (_maximum_number_of_jobs == 0) {
+      cmac_error("An AsynchronousWriteQueue needs to allow at least one job in "
+                 "flight!");
+    }
+    _thread = std::thread(&AsynchronousWriteQueue::execute_jobs, this);
+  }
+
+  /**
+   * @brief Destructor.
+   *
+   * Waits until all jobs are finished and stops the background I/O thread.
+   */
+  inline ~AsynchronousWriteQueue() {
+    {
+      std::unique_lock< std::mutex > lock(_mutex);
+      _stop = true;
+    }
+    _condition.notify_all();
+    _thread.join();
+  }
+
+  /**
+   * @brief Reserve a slot for a new job.
+   *
+   * If the maximum number of jobs is in flight, this routine blocks until the
+   * oldest job has finished. Every call to this routine should be followed by
+   * exactly one call to add_job().
+   */
+  inline void acquire_slot() {
+    std::unique_lock< std::mutex > lock(_mutex);
+    _condition.wait(lock, [this]() {
+      return _jobs.size() + _number_of_acquired_slots < _maximum_number_of_jobs;
+    });
+    ++_number_of_acquired_slots;
+  }
+
+  /**
+   * @brief Add a job to the queue, using a slot that was previously reserved
+   * with acquire_slot().
+   *
+   * This routine never blocks.
+   *
+   * @param job Job to execute. The job should only use data that it owns (or
+   * that is guaranteed to outlive it), since it is executed at a later time.
+   */
+  inline void add_job(std::function< void() > job) {
+    {
+      std::unique_lock< std::mutex > lock(_mutex);
+      if (_number_of_acquired_slots == 0) {
+        cmac_error("Adding a job to an AsynchronousWriteQueue without "
+                   "acquiring a slot first!");
+      }
+      --_number_of_acquired_slots;
+      _jobs.push_back(job);
+    }
+    _condition.notify_all();
+  }
+
+  /**
+   * @brief Wait until all jobs in the queue have finished.
+   */
+  inline void flush() {
+    std::unique_lock< std::mutex > lock(_mutex);
+    _condition.wait(lock, [this]() { return _jobs.empty(); });
+  }
+};
+
+#endif // ASYNCHRONOUSWRITEQUEUE_HPP
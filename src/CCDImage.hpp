@@ -33,6 +33,7 @@
 #include "Utilities.hpp"
 
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -103,6 +104,35 @@ private:
     }
   }
 
+  /**
+   * @brief Get the parameter name of the parameter with the given name for the
+   * observer with the given index.
+   *
+   * @param observer Index of the observer.
+   * @param name Name of the parameter.
+   * @return Full parameter name: "CCDImage:observer[observer]:name".
+   */
+  inline static std::string get_observer_key(const uint_fast32_t observer,
+                                             const std::string name) {
+    std::stringstream key;
+    key << "CCDImage:observer[" << observer << "]:" << name;
+    return key.str();
+  }
+
+  /**
+   * @brief Get the default file name for the observer with the given index.
+   *
+   * @param observer Index of the observer.
+   * @return Default file name: "galaxy_image_" followed by the observer index
+   * (e.g. "galaxy_image_0" for the first observer).
+   */
+  inline static std::string
+  get_observer_default_filename(const uint_fast32_t observer) {
+    std::stringstream filename;
+    filename << "galaxy_image_" << observer;
+    return filename.str();
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -197,6 +227,48 @@ public:
                                             "galaxy_image"),
             output_folder, log) {}
 
+  /**
+   * @brief ParameterFile constructor for one of multiple observers.
+   *
+   * The viewing angles and the file name are read from the
+   * "CCDImage:observer[observer]" block:
+   *  - view theta: @f$\theta{}@f$ angle of the observer w.r.t. the box origin
+   *    (default: 89.7 degrees)
+   *  - view phi: @f$\phi{}@f$ angle of the observer w.r.t. the box origin
+   *    (default: 0. degrees)
+   *  - filename: Image file name (default: galaxy_image_observer)
+   *
+   * All other parameters are shared by all observers and are read from the
+   * "CCDImage" block (see the ParameterFile constructor above).
+   *
+   * @param observer Index of the observer.
+   * @param output_folder Folder where the image is saved.
+   * @param params ParameterFile to read from.
+   * @param log Log to write logging info to.
+   */
+  inline CCDImage(const uint_fast32_t observer, std::string output_folder,
+                  ParameterFile &params, Log *log = nullptr)
+      : CCDImage(
+            params.get_physical_value< QUANTITY_ANGLE >(
+                get_observer_key(observer, "view theta"), "89.7 degrees"),
+            params.get_physical_value< QUANTITY_ANGLE >(
+                get_observer_key(observer, "view phi"), "0. degrees"),
+            params.get_value< uint_fast32_t >("CCDImage:image width", 200),
+            params.get_value< uint_fast32_t >("CCDImage:image height", 200),
+            params.get_physical_value< QUANTITY_LENGTH >("CCDImage:anchor x",
+                                                         "-12.1 kpc"),
+            params.get_physical_value< QUANTITY_LENGTH >("CCDImage:anchor y",
+                                                         "-12.1 kpc"),
+            params.get_physical_value< QUANTITY_LENGTH >("CCDImage:sides x",
+                                                         "24.2 kpc"),
+            params.get_physical_value< QUANTITY_LENGTH >("CCDImage:sides y",
+                                                         "24.2 kpc"),
+            params.get_value< std::string >("CCDImage:type", "BinaryArray"),
+            params.get_value< std::string >(
+                get_observer_key(observer, "filename"),
+                get_observer_default_filename(observer)),
+            output_folder, log) {}
+
   /**
    * @brief Reset the image contents to zero.
    */
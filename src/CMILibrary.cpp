@@ -29,6 +29,8 @@
 
 IonizationSimulation *global_ionization_simulation = nullptr;
 SPHArrayInterface *global_interface = nullptr;
+bool global_persistent_mode = false;
+bool global_is_initialized = false;
 
 #ifdef CMILIBRARY_TALK
 #include "TerminalLog.hpp"
@@ -72,6 +74,7 @@ void cmi_init(const char *parameter_file, const int num_thread,
       new IonizationSimulation(true, false, false, num_thread, parameter_file,
                                nullptr, log_initialize());
   global_interface = new SPHArrayInterface(unit_length_in_SI, unit_mass_in_SI);
+  global_interface->set_persistent_mode(global_persistent_mode);
 }
 
 /**
@@ -98,6 +101,7 @@ void cmi_init_periodic_dp(const char *parameter_file, const int num_thread,
                                nullptr, log_initialize());
   global_interface = new SPHArrayInterface(unit_length_in_SI, unit_mass_in_SI,
                                            box_anchor, box_sides);
+  global_interface->set_persistent_mode(global_persistent_mode);
 }
 
 /**
@@ -124,6 +128,7 @@ void cmi_init_periodic_sp(const char *parameter_file, const int num_thread,
                                nullptr, log_initialize());
   global_interface = new SPHArrayInterface(unit_length_in_SI, unit_mass_in_SI,
                                            box_anchor, box_sides);
+  global_interface->set_persistent_mode(global_persistent_mode);
 }
 
 /**
@@ -132,9 +137,52 @@ void cmi_init_periodic_sp(const char *parameter_file, const int num_thread,
 void cmi_destroy() {
   delete global_ionization_simulation;
   delete global_interface;
+  global_ionization_simulation = nullptr;
+  global_interface = nullptr;
+  global_is_initialized = false;
   log_destroy();
 }
 
+/**
+ * @brief Set the persistent mode of the CMI library.
+ *
+ * In persistent mode, the grid, the neighbour search tree and the ionization
+ * state of the previous call are kept. Subsequent calls only update the
+ * densities in place and perform a reduced number of iterations, starting from
+ * the previous solution. This is a lot cheaper if the density field only
+ * changes a little in between calls (as is the case for successive time steps
+ * in a simulation).
+ *
+ * This function can be called before or after the library is initialized; the
+ * flag is stored and applied during initialization if necessary.
+ *
+ * @param persistent_mode Persistent mode flag (0: off, otherwise: on).
+ */
+void cmi_set_persistent_mode(const int persistent_mode) {
+  global_persistent_mode = (persistent_mode != 0);
+  if (global_interface != nullptr) {
+    global_interface->set_persistent_mode(global_persistent_mode);
+  }
+}
+
+/**
+ * @brief Compute the ionization state for the current contents of the global
+ * SPHArrayInterface.
+ *
+ * If persistent mode is active and the library was already initialized, we
+ * only update the densities and warm start from the previous solution.
+ */
+inline static void cmi_compute_ionization_state() {
+  if (global_persistent_mode && global_is_initialized) {
+    global_ionization_simulation->update(global_interface);
+    global_ionization_simulation->run(global_interface, true);
+  } else {
+    global_ionization_simulation->initialize(global_interface);
+    global_ionization_simulation->run(global_interface);
+    global_is_initialized = true;
+  }
+}
+
 /**
  * @brief Compute the neutral fractions for the given SPH density field and
  * store them in the given array.
@@ -155,8 +203,7 @@ void cmi_compute_neutral_fraction_dp(const double *x, const double *y,
                                      const size_t N) {
 
   global_interface->reset(x, y, z, h, m, N);
-  global_ionization_simulation->initialize(global_interface);
-  global_ionization_simulation->run(global_interface);
+  cmi_compute_ionization_state();
   global_interface->fill_array(nH);
 }
 
@@ -180,8 +227,7 @@ void cmi_compute_neutral_fraction_mp(const double *x, const double *y,
                                      const size_t N) {
 
   global_interface->reset(x, y, z, h, m, N);
-  global_ionization_simulation->initialize(global_interface);
-  global_ionization_simulation->run(global_interface);
+  cmi_compute_ionization_state();
   global_interface->fill_array(nH);
 }
 
@@ -205,7 +251,6 @@ void cmi_compute_neutral_fraction_sp(const float *x, const float *y,
                                      const size_t N) {
 
   global_interface->reset(x, y, z, h, m, N);
-  global_ionization_simulation->initialize(global_interface);
-  global_ionization_simulation->run(global_interface);
+  cmi_compute_ionization_state();
   global_interface->fill_array(nH);
 }
@@ -118,6 +118,12 @@ int main(int argc, char **argv) {
   parser.add_option("output_statistics", 's',
                     "Output statistical information about the photons.",
                     COMMANDLINEOPTION_NOARGUMENT, "false");
+  parser.add_option("restart", 'r',
+                    "Resume the simulation from the given checkpoint file. "
+                    "The simulation should use the same parameter file and "
+                    "number of threads as the simulation that wrote the "
+                    "checkpoint.",
+                    COMMANDLINEOPTION_STRINGARGUMENT);
   parser.parse_arguments(argc, argv);
 
   LogLevel loglevel = LOGLEVEL_STATUS;
@@ -233,6 +239,9 @@ int main(int argc, char **argv) {
     }
 
     simulation.initialize();
+    if (parser.get_value< std::string >("restart") != "") {
+      simulation.set_restart_file(parser.get_value< std::string >("restart"));
+    }
     simulation.run();
 
     programtimer.stop();
@@ -171,76 +171,6 @@ Box<> CartesianDensityGrid::get_cell(
   return Box<>(CoordinateVector<>(cell_xmin, cell_ymin, cell_zmin), _cellside);
 }
 
-/**
- * @brief Check whether the given index points to a valid cell.
- *
- * This method also applies periodic boundary conditions (if applicable).
- *
- * @param index Indices of the cell.
- * @param position Current position of the photon.
- * @return True if the indices are valid, false otherwise.
- */
-bool CartesianDensityGrid::is_inside(CoordinateVector< int_fast32_t > &index,
-                                     CoordinateVector<> &position) const {
-  bool inside = true;
-  if (!_periodicity_flags.x()) {
-    inside &= (index.x() >= 0 && index.x() < _ncell.x());
-  } else {
-    if (index.x() < 0) {
-      index[0] = _ncell.x() - 1;
-      position[0] += _box.get_sides().x();
-    }
-    if (index.x() >= _ncell.x()) {
-      index[0] = 0;
-      position[0] -= _box.get_sides().x();
-    }
-  }
-  if (!_periodicity_flags.y()) {
-    inside &= (index.y() >= 0 && index.y() < _ncell.y());
-  } else {
-    if (index.y() < 0) {
-      index[1] = _ncell.y() - 1;
-      position[1] += _box.get_sides().y();
-    }
-    if (index.y() >= _ncell.y()) {
-      index[1] = 0;
-      position[1] -= _box.get_sides().y();
-    }
-  }
-  if (!_periodicity_flags.z()) {
-    inside &= (index.z() >= 0 && index.z() < _ncell.z());
-  } else {
-    if (index.z() < 0) {
-      index[2] = _ncell.z() - 1;
-      position[2] += _box.get_sides().z();
-    }
-    if (index.z() >= _ncell.z()) {
-      index[2] = 0;
-      position[2] -= _box.get_sides().z();
-    }
-  }
-  return inside;
-}
-
-/**
- * @brief Check whether the given index points to a valid cell.
- *
- * This version ignores the boundary flags and always assumes open boundaries.
- *
- * @param index Indices of the cell.
- * @param position Current position of the photon.
- * @return True if the indices are valid, false otherwise.
- */
-bool CartesianDensityGrid::is_inside_non_periodic(
-    CoordinateVector< int_fast32_t > &index,
-    CoordinateVector<> &position) const {
-  bool inside = true;
-  inside &= (index.x() >= 0 && index.x() < _ncell.x());
-  inside &= (index.y() >= 0 && index.y() < _ncell.y());
-  inside &= (index.z() >= 0 && index.z() < _ncell.z());
-  return inside;
-}
-
 /**
  * @brief Get the intersection point of a photon with one of the walls of a
  * cell.
@@ -400,33 +330,21 @@ double CartesianDensityGrid::integrate_optical_depth(const Photon &photon) {
 
   double optical_depth = 0.;
 
-  CoordinateVector<> photon_origin = photon.get_position();
-  CoordinateVector<> photon_direction = photon.get_direction();
+  CellTraversal traversal(*this, photon.get_position(),
+                          photon.get_direction());
 
-  // find out in which cell the photon is currently hiding
-  CoordinateVector< int_fast32_t > index = get_cell_indices(photon_origin);
-
-  unsigned int ncell = 0;
   // while the photon is still in the box
-  while (is_inside(index, photon_origin)) {
-    ++ncell;
-    Box<> cell = get_cell(index);
-
-    double ds;
-    CoordinateVector< int_fast8_t > next_index;
-    CoordinateVector<> next_wall = get_wall_intersection(
-        photon_origin, photon_direction, cell, next_index, ds);
+  while (traversal.is_inside()) {
 
     // get the optical depth of the path from the current photon location to the
-    // cell wall, update S
-    DensityGrid::iterator it(get_long_index(index), *this);
+    // cell wall
+    const double ds = traversal.get_segment_length();
+    DensityGrid::iterator it(get_long_index(traversal.get_index()), *this);
 
-    // Helium abundance. Should be a parameter.
     optical_depth +=
         get_optical_depth(ds, it.get_ionization_variables(), photon);
 
-    photon_origin = next_wall;
-    index += next_index;
+    traversal.next_cell();
   }
 
   return optical_depth;
@@ -444,64 +362,46 @@ double CartesianDensityGrid::integrate_optical_depth(const Photon &photon) {
  */
 DensityGrid::iterator CartesianDensityGrid::interact(Photon &photon,
                                                      double optical_depth) {
-  double S = 0.;
 
-  CoordinateVector<> photon_origin = photon.get_position();
-  CoordinateVector<> photon_direction = photon.get_direction();
-
-  // find out in which cell the photon is currently hiding
-  CoordinateVector< int_fast32_t > index = get_cell_indices(photon_origin);
+  CellTraversal traversal(*this, photon.get_position(),
+                          photon.get_direction());
 
   uint_fast32_t ncell = 0;
   DensityGrid::iterator last_cell = end();
   // while the photon has not exceeded the optical depth and is still in the box
-  while (is_inside(index, photon_origin) && optical_depth > 0.) {
+  while (traversal.is_inside() && optical_depth > 0.) {
     ++ncell;
-    Box<> cell = get_cell(index);
-
-    double ds;
-    CoordinateVector< int_fast8_t > next_index;
-    CoordinateVector<> next_wall = get_wall_intersection(
-        photon_origin, photon_direction, cell, next_index, ds);
 
     // get the optical depth of the path from the current photon location to the
-    // cell wall, update S
-    DensityGrid::iterator it(get_long_index(index), *this);
+    // cell wall
+    double ds = traversal.get_segment_length();
+    DensityGrid::iterator it(get_long_index(traversal.get_index()), *this);
     last_cell = it;
 
-    // Helium abundance. Should be a parameter.
     double tau = get_optical_depth(ds, it.get_ionization_variables(), photon);
     optical_depth -= tau;
 
-    // if the optical depth exceeds or equals the wanted value: exit the loop
-
     // if the optical depth exceeded the wanted value: find out where in the
-    // cell we end up, and correct S
+    // cell we end up, and correct ds
     if (optical_depth < 0.) {
-      double Scorr = ds * optical_depth / tau;
-      // order is important here!
-      photon_origin += (next_wall - photon_origin) * (ds + Scorr) / ds;
-      ds += Scorr;
+      ds += ds * optical_depth / tau;
+      traversal.move(ds);
     } else {
-      photon_origin = next_wall;
       // we don't want to do this if the photon does not actually leave the
       // cell, since this might trigger a periodic boundary position change:
       // the position of the photon is adapted for a traversal of the periodic
       // boundaries, while it does not traverse them
-      // if there are no periodic boundaries, it does not matter where we
-      // update the index, since the index will not be used any more after
-      // leaving this loop
-      index += next_index;
+      traversal.next_cell();
     }
 
     // ds is now the actual distance travelled in the cell
     // update contributions to mean intensity integrals
     update_integrals(ds, it, photon);
-
-    S += ds;
   }
 
+  const CoordinateVector<> photon_origin = traversal.get_position();
   if (ncell == 0 && optical_depth > 0.) {
+    const CoordinateVector<> photon_direction = photon.get_direction();
     cmac_error("Photon leaves the system immediately (position: %g %g %g, "
                "direction: %g %g %g)!",
                photon_origin.x(), photon_origin.y(), photon_origin.z(),
@@ -511,7 +411,7 @@ DensityGrid::iterator CartesianDensityGrid::interact(Photon &photon,
 
   photon.set_position(photon_origin);
 
-  if (!is_inside(index, photon_origin)) {
+  if (!traversal.is_inside()) {
     last_cell = end();
   }
 
@@ -520,43 +420,39 @@ DensityGrid::iterator CartesianDensityGrid::interact(Photon &photon,
 
 /**
  * @brief Get the total line emission along a ray with the given origin and
- * direction.
+ * direction, for all given lines at once.
  *
  * @param origin Origin of the ray (in m).
  * @param direction Direction of the ray.
- * @param line EmissionLine name of the line to trace.
- * @return Accumulated emission along the ray (in J m^-2 s^-1).
+ * @param lines EmissionLine names of the lines to trace.
+ * @param emissions Array to store the accumulated emission along the ray for
+ * every line in (in J m^-2 s^-1).
  */
-double CartesianDensityGrid::get_total_emission(CoordinateVector<> origin,
-                                                CoordinateVector<> direction,
-                                                EmissionLine line) {
-  double S = 0.;
+void CartesianDensityGrid::get_total_emissions(
+    CoordinateVector<> origin, CoordinateVector<> direction,
+    const std::vector< EmissionLine > &lines, double *emissions) {
 
-  // find out in which cell the origin lies
-  CoordinateVector< int_fast32_t > index = get_cell_indices(origin);
-
-  uint_fast32_t ncell = 0;
-  // while the photon has not exceeded the optical depth and is still in the box
-  while (is_inside_non_periodic(index, origin)) {
-    ++ncell;
-    Box<> cell = get_cell(index);
+  const size_t numline = lines.size();
+  for (size_t iline = 0; iline < numline; ++iline) {
+    emissions[iline] = 0.;
+  }
 
-    double ds;
-    CoordinateVector< int_fast8_t > next_index;
-    CoordinateVector<> next_wall =
-        get_wall_intersection(origin, direction, cell, next_index, ds);
+  // emission maps are never periodic
+  CellTraversal traversal(*this, origin, direction, false);
 
-    // get the optical depth of the path from the current photon location to the
-    // cell wall, update S
-    DensityGrid::iterator it(get_long_index(index), *this);
+  while (traversal.is_inside()) {
 
-    S += ds * it.get_emissivities()->get_emissivity(line);
+    // add the emission along the path from the current ray location to the
+    // cell wall
+    const double ds = traversal.get_segment_length();
+    DensityGrid::iterator it(get_long_index(traversal.get_index()), *this);
+    const EmissivityValues *emissivities = it.get_emissivities();
+    for (size_t iline = 0; iline < numline; ++iline) {
+      emissions[iline] += ds * emissivities->get_emissivity(lines[iline]);
+    }
 
-    origin = next_wall;
-    index += next_index;
+    traversal.next_cell();
   }
-
-  return S;
 }
 
 /**
@@ -792,3 +688,36 @@ std::vector< Face > CartesianDensityGrid::get_faces(cellsize_t index) const {
 
   return faces;
 }
+
+/**
+ * @brief Get the geometrical information needed to integrate a function over
+ * the cell with the given index and to walk from the cell to its neighbours.
+ *
+ * @param index Index of a cell.
+ * @param bounding_box Geometrical box of the cell (in m).
+ * @param planes Empty, since the cell coincides with its box.
+ * @param ngbs Indices of the (at most 6) face neighbours of the cell within the
+ * box.
+ */
+void CartesianDensityGrid::get_cell_geometry(
+    cellsize_t index, Box<> &bounding_box,
+    std::vector< std::pair< CoordinateVector<>, double > > &planes,
+    std::vector< cellsize_t > &ngbs) const {
+
+  const CoordinateVector< int_fast32_t > cellindices = get_indices(index);
+  bounding_box = get_cell(cellindices);
+  planes.clear();
+  ngbs.clear();
+  for (uint_fast8_t i = 0; i < 3; ++i) {
+    if (cellindices[i] > 0) {
+      CoordinateVector< int_fast32_t > ngb_low(cellindices);
+      ngb_low[i] -= 1;
+      ngbs.push_back(get_long_index(ngb_low));
+    }
+    if (cellindices[i] < _ncell[i] - 1) {
+      CoordinateVector< int_fast32_t > ngb_high(cellindices);
+      ngb_high[i] += 1;
+      ngbs.push_back(get_long_index(ngb_high));
+    }
+  }
+}
@@ -30,6 +30,7 @@
 #include "DensityGrid.hpp"
 
 #include <cstdlib>
+#include <limits>
 
 class DensityFunction;
 class Log;
@@ -111,10 +112,206 @@ private:
   CoordinateVector< int_fast32_t >
   get_cell_indices(CoordinateVector<> position) const;
 
-  bool is_inside(CoordinateVector< int_fast32_t > &index,
-                 CoordinateVector<> &position) const;
-  bool is_inside_non_periodic(CoordinateVector< int_fast32_t > &index,
-                              CoordinateVector<> &position) const;
+
+  /**
+   * @brief Incremental traversal of the cells of the grid along a ray, using
+   * the 3D digital differential analyzer of Amanatides, J. & Woo, A. 1987,
+   * Eurographics, 87, 3.
+   *
+   * For every coordinate axis, we store the distance along the ray at which
+   * the ray crosses the next cell wall perpendicular to that axis, and the
+   * distance along the ray in between two such crossings. Moving to the next
+   * cell then only requires selecting the axis with the closest wall crossing
+   * and adding the crossing distance for that axis, so that we never need to
+   * construct the geometry of the cells along the ray.
+   *
+   * Positions along the ray are always computed from the original ray origin,
+   * so that round off errors do not accumulate. Periodic boundaries are
+   * handled by wrapping the cell index and keeping track of the corresponding
+   * offset of the ray position.
+   */
+  class CellTraversal {
+  private:
+    /*! @brief Grid we traverse. */
+    const CartesianDensityGrid &_grid;
+
+    /*! @brief Origin of the ray (in m). */
+    const CoordinateVector<> _origin;
+
+    /*! @brief Direction of the ray. */
+    const CoordinateVector<> _direction;
+
+    /*! @brief Offset of the ray position due to the traversal of periodic
+     *  boundaries (in m). */
+    CoordinateVector<> _periodic_offset;
+
+    /*! @brief Periodicity flags used during the traversal. */
+    const CoordinateVector< bool > _periodic;
+
+    /*! @brief Indices of the current cell. */
+    CoordinateVector< int_fast32_t > _index;
+
+    /*! @brief Change in index when moving to the next cell along each axis. */
+    CoordinateVector< int_fast32_t > _step;
+
+    /*! @brief Distance along the ray to the next wall crossing along each axis
+     *  (in m). */
+    CoordinateVector<> _next_wall;
+
+    /*! @brief Distance along the ray in between two wall crossings along each
+     *  axis (in m). */
+    CoordinateVector<> _wall_spacing;
+
+    /*! @brief Distance along the ray that was covered so far (in m). */
+    double _distance;
+
+    /*! @brief Axis of the next wall crossing. */
+    uint_fast8_t _next_axis;
+
+    /*! @brief Is the current cell inside the grid? */
+    bool _inside;
+
+    /**
+     * @brief Find the axis of the next wall crossing.
+     */
+    inline void find_next_axis() {
+      _next_axis = 0;
+      if (_next_wall[1] < _next_wall[_next_axis]) {
+        _next_axis = 1;
+      }
+      if (_next_wall[2] < _next_wall[_next_axis]) {
+        _next_axis = 2;
+      }
+    }
+
+    /**
+     * @brief Check if the current index along the given axis is inside the
+     * grid, and apply periodic boundaries along that axis if necessary.
+     *
+     * @param i Axis.
+     * @return True if the index along the axis is inside the grid.
+     */
+    inline bool check_axis(const uint_fast8_t i) {
+      if (_index[i] < 0) {
+        if (_periodic[i]) {
+          _index[i] = _grid._ncell[i] - 1;
+          _periodic_offset[i] += _grid._box.get_sides()[i];
+        } else {
+          return false;
+        }
+      }
+      if (_index[i] >= _grid._ncell[i]) {
+        if (_periodic[i]) {
+          _index[i] = 0;
+          _periodic_offset[i] -= _grid._box.get_sides()[i];
+        } else {
+          return false;
+        }
+      }
+      return true;
+    }
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param grid Grid we traverse.
+     * @param origin Origin of the ray (in m).
+     * @param direction Direction of the ray.
+     * @param use_periodicity Apply the periodic boundaries of the grid? If
+     * false, all boundaries are treated as open.
+     */
+    inline CellTraversal(const CartesianDensityGrid &grid,
+                         const CoordinateVector<> &origin,
+                         const CoordinateVector<> &direction,
+                         const bool use_periodicity = true)
+        : _grid(grid), _origin(origin), _direction(direction),
+          _periodic(use_periodicity ? grid._periodicity_flags
+                                    : CoordinateVector< bool >(false)),
+          _index(grid.get_cell_indices(origin)), _distance(0.) {
+
+      const CoordinateVector<> &anchor = _grid._box.get_anchor();
+      const CoordinateVector<> &cellside = _grid._cellside;
+      for (uint_fast8_t i = 0; i < 3; ++i) {
+        if (_direction[i] > 0.) {
+          _step[i] = 1;
+          _next_wall[i] =
+              (anchor[i] + (_index[i] + 1) * cellside[i] - _origin[i]) /
+              _direction[i];
+          _wall_spacing[i] = cellside[i] / _direction[i];
+        } else if (_direction[i] < 0.) {
+          _step[i] = -1;
+          _next_wall[i] = (anchor[i] + _index[i] * cellside[i] - _origin[i]) /
+                          _direction[i];
+          _wall_spacing[i] = -cellside[i] / _direction[i];
+        } else {
+          // we never cross a wall along this axis
+          _step[i] = 0;
+          _next_wall[i] = std::numeric_limits< double >::max();
+          _wall_spacing[i] = 0.;
+        }
+      }
+      find_next_axis();
+
+      _inside = check_axis(0);
+      _inside &= check_axis(1);
+      _inside &= check_axis(2);
+    }
+
+    /**
+     * @brief Is the current cell inside the grid?
+     *
+     * @return True if the current cell is inside the grid.
+     */
+    inline bool is_inside() const { return _inside; }
+
+    /**
+     * @brief Get the indices of the current cell.
+     *
+     * @return Indices of the current cell.
+     */
+    inline const CoordinateVector< int_fast32_t > &get_index() const {
+      return _index;
+    }
+
+    /**
+     * @brief Get the length of the ray segment from the current position to
+     * the next cell wall.
+     *
+     * @return Length of the ray segment inside the current cell (in m).
+     */
+    inline double get_segment_length() const {
+      return _next_wall[_next_axis] - _distance;
+    }
+
+    /**
+     * @brief Move to the next cell along the ray.
+     */
+    inline void next_cell() {
+      _distance = _next_wall[_next_axis];
+      _next_wall[_next_axis] += _wall_spacing[_next_axis];
+      _index[_next_axis] += _step[_next_axis];
+      _inside = check_axis(_next_axis);
+      find_next_axis();
+    }
+
+    /**
+     * @brief Move the given distance along the ray, without leaving the
+     * current cell.
+     *
+     * @param distance Distance to move (in m).
+     */
+    inline void move(const double distance) { _distance += distance; }
+
+    /**
+     * @brief Get the current position along the ray.
+     *
+     * @return Current position (in m).
+     */
+    inline CoordinateVector<> get_position() const {
+      return _origin + _distance * _direction + _periodic_offset;
+    }
+  };
 
 public:
   CartesianDensityGrid(
@@ -201,9 +398,10 @@ public:
   virtual double integrate_optical_depth(const Photon &photon);
   virtual DensityGrid::iterator interact(Photon &photon, double optical_depth);
 
-  virtual double get_total_emission(CoordinateVector<> origin,
-                                    CoordinateVector<> direction,
-                                    EmissionLine line);
+  virtual void get_total_emissions(CoordinateVector<> origin,
+                                   CoordinateVector<> direction,
+                                   const std::vector< EmissionLine > &lines,
+                                   double *emissions);
 
   /**
    * @brief Get an iterator to the first cell in the grid.
@@ -227,6 +425,11 @@ public:
   get_neighbours(cellsize_t index);
 
   virtual std::vector< Face > get_faces(unsigned long index) const;
+
+  virtual void
+  get_cell_geometry(cellsize_t index, Box<> &bounding_box,
+                    std::vector< std::pair< CoordinateVector<>, double > > &planes,
+                    std::vector< cellsize_t > &ngbs) const;
 };
 
 #endif // CARTESIANDENSITYGRID_HPP
@@ -29,6 +29,10 @@
 #include "CoordinateVector.hpp"
 #include "Face.hpp"
 
+#include <cstddef>
+
+class DensityGrid;
+
 /**
  * @brief General interface for geometrical cell information.
  */
@@ -54,6 +58,23 @@ public:
    * @return Faces of the cell.
    */
   virtual std::vector< Face > get_faces() const = 0;
+
+  /**
+   * @brief Get the DensityGrid the cell belongs to.
+   *
+   * @return Pointer to the DensityGrid, or a null pointer if the cell is not
+   * part of a DensityGrid.
+   */
+  virtual const DensityGrid *get_grid() const { return nullptr; }
+
+  /**
+   * @brief Get the index of the cell in the DensityGrid it belongs to.
+   *
+   * Only meaningful if get_grid() does not return a null pointer.
+   *
+   * @return Index of the cell.
+   */
+  virtual size_t get_index() const { return 0; }
 };
 
 /**
@@ -28,6 +28,8 @@
 
 #include "ElementNames.hpp"
 
+#include <cinttypes>
+
 /**
  * @brief General interface for photoionization cross sections.
  */
@@ -47,6 +49,28 @@ public:
    * @return Photoionization cross section (in m^2).
    */
   virtual double get_cross_section(IonName ion, double energy) const = 0;
+
+  /**
+   * @brief Get the photoionization cross sections for the given ion at the
+   * given photon energies.
+   *
+   * The default implementation calls get_cross_section() for every energy.
+   * Implementations can override this to evaluate all cross sections in a
+   * single pass.
+   *
+   * @param ion IonName for a valid ion.
+   * @param energies Photon frequencies (in Hz).
+   * @param cross_sections Array to store the photoionization cross sections in
+   * (in m^2).
+   * @param number Number of energies.
+   */
+  virtual void get_cross_sections(IonName ion, const double *energies,
+                                  double *cross_sections,
+                                  const uint_fast32_t number) const {
+    for (uint_fast32_t i = 0; i < number; ++i) {
+      cross_sections[i] = get_cross_section(ion, energies[i]);
+    }
+  }
 };
 
 #endif // CROSSSECTIONS_HPP
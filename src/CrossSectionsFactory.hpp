@@ -23,6 +23,8 @@
  *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
+#ifndef CROSSSECTIONSFACTORY_HPP
+#define CROSSSECTIONSFACTORY_HPP
 
 #include "CrossSections.hpp"
 #include "Error.hpp"
@@ -31,6 +33,7 @@
 
 // implementations
 #include "FixedValueCrossSections.hpp"
+#include "TabulatedCrossSections.hpp"
 #include "VernerCrossSections.hpp"
 
 /**
@@ -38,12 +41,39 @@
  */
 class CrossSectionsFactory {
 public:
+  /**
+   * @brief Generate a CrossSections instance of the given type.
+   *
+   * @param type Type of CrossSections instance to generate.
+   * @param params ParameterFile to read from.
+   * @param log Log to write logging info to.
+   * @return Pointer to a newly created CrossSections implementation.
+   * Memory management for the pointer needs to be done by the calling routine.
+   */
+  static CrossSections *
+  generate_from_type(std::string type, ParameterFile &params,
+                     Log *log = nullptr) {
+
+    if (type == "FixedValue") {
+      return new FixedValueCrossSections(params);
+    } else if (type == "Tabulated") {
+      return new TabulatedCrossSections(params, log);
+    } else if (type == "Verner") {
+      return new VernerCrossSections();
+    } else {
+      cmac_error("Unknown CrossSections type: \"%s\"!", type.c_str());
+      return nullptr;
+    }
+  }
+
   /**
    * @brief Generate a CrossSections instance based on the type chosen in the
    * parameter file.
    *
    * Supported types are (default: Verner):
    *  - FixedValue: Implementation that uses user specified cross sections.
+   *  - Tabulated: Implementation that interpolates on precomputed tables of
+   *    another CrossSections implementation.
    *  - Verner: Implementation that uses the Verner & Yakovlev (1995) and Verner
    *    et al. (1996) cross sections.
    *
@@ -61,13 +91,8 @@ public:
       log->write_info("Requested CrossSections type: ", type);
     }
 
-    if (type == "FixedValue") {
-      return new FixedValueCrossSections(params);
-    } else if (type == "Verner") {
-      return new VernerCrossSections();
-    } else {
-      cmac_error("Unknown CrossSections type: \"%s\"!", type.c_str());
-      return nullptr;
-    }
+    return generate_from_type(type, params, log);
   }
 };
+
+#endif // CROSSSECTIONSFACTORY_HPP
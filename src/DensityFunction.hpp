@@ -29,6 +29,8 @@
 #include "Cell.hpp"
 #include "DensityValues.hpp"
 
+class DensityGrid;
+
 /**
  * @brief Interface for functors that can be used to fill a DensityGrid.
  */
@@ -49,6 +51,20 @@ public:
    */
   virtual void initialize() {}
 
+  /**
+   * @brief Prepare the DensityFunction for use on the given DensityGrid.
+   *
+   * This routine is called by the DensityGrid before operator() is called for
+   * its cells. It does not need to be implemented by all implementations; SPH
+   * implementations can use it to map all particles onto the grid in a single
+   * pass, after which operator() becomes a simple lookup.
+   *
+   * @param grid DensityGrid that will be filled.
+   * @param worksize Number of parallel threads to use. If a negative number is
+   * given, all available threads will be used.
+   */
+  virtual void prepare(const DensityGrid &grid, int_fast32_t worksize = -1) {}
+
   /**
    * @brief Function that gives the density for a given cell.
    *
@@ -41,6 +41,8 @@ void DensityGrid::set_densities(std::pair< cellsize_t, cellsize_t > &block,
                                 DensityFunction &function,
                                 int_fast32_t worksize) {
 
+  function.prepare(*this, worksize);
+
   DensityGridInitializationFunction init(function, _has_hydro);
   WorkDistributor<
       DensityGridTraversalJobMarket< DensityGridInitializationFunction >,
@@ -60,3 +62,61 @@ void DensityGrid::set_densities(std::pair< cellsize_t, cellsize_t > &block,
     _log->write_status("Done initializing grid.");
   }
 }
+
+/**
+ * @brief Update the number densities of the cells using the given
+ * DensityFunction.
+ *
+ * Contrary to set_densities(), the temperatures and ionic fractions are not
+ * changed. This can be used to restart a simulation from a previous solution
+ * with a new density field.
+ *
+ * @param block Block that should be updated by this MPI process.
+ * @param function DensityFunction to use.
+ * @param worksize Number of parallel threads to use. If a negative number is
+ * given, all available threads will be used.
+ */
+void DensityGrid::update_number_densities(
+    std::pair< cellsize_t, cellsize_t > &block, DensityFunction &function,
+    int_fast32_t worksize) {
+
+  function.prepare(*this, worksize);
+
+  DensityGridNumberDensityUpdateFunction update(function);
+  WorkDistributor<
+      DensityGridTraversalJobMarket< DensityGridNumberDensityUpdateFunction >,
+      DensityGridTraversalJob< DensityGridNumberDensityUpdateFunction > >
+      workers(worksize);
+  DensityGridTraversalJobMarket< DensityGridNumberDensityUpdateFunction > jobs(
+      *this, update, block);
+  workers.do_in_parallel(jobs);
+}
+
+/**
+ * @brief Add the per-thread shadow copies of the mean intensity and heating
+ * integrals to the cells.
+ *
+ * This method should be called after every photon propagation step. It does
+ * nothing if the grid does not use DENSITYGRID_ACCUMULATION_THREADLOCAL mode.
+ *
+ * @param worksize Number of parallel threads to use. If a negative number is
+ * given, all available threads will be used.
+ */
+void DensityGrid::reduce_thread_accumulators(int_fast32_t worksize) {
+
+  if (_accumulation_mode != DENSITYGRID_ACCUMULATION_THREADLOCAL) {
+    return;
+  }
+
+  DensityGridAccumulatorReductionFunction reduce(
+      _thread_accumulators.size(), get_number_of_accumulated_values());
+  WorkDistributor<
+      DensityGridTraversalJobMarket< DensityGridAccumulatorReductionFunction >,
+      DensityGridTraversalJob< DensityGridAccumulatorReductionFunction > >
+      workers(worksize);
+  std::pair< cellsize_t, cellsize_t > block =
+      std::make_pair(0, get_number_of_cells());
+  DensityGridTraversalJobMarket< DensityGridAccumulatorReductionFunction > jobs(
+      *this, reduce, block);
+  workers.do_in_parallel(jobs);
+}
@@ -35,25 +35,56 @@
 #include "DensityValues.hpp"
 #include "EmissivityValues.hpp"
 #include "HydroVariables.hpp"
-#include "IonizationVariables.hpp"
+#include "IonizationVariablesArray.hpp"
 #include "Lock.hpp"
 #include "Log.hpp"
 #include "Photon.hpp"
+#include "RestartReader.hpp"
+#include "RestartWriter.hpp"
 #include "Timer.hpp"
 #include "UnitConverter.hpp"
 #include "WorkDistributor.hpp"
+#include "WorkEnvironment.hpp"
 
 #ifdef USE_LOCKFREE
 #include "Atomic.hpp"
 #endif
 
 #include <cmath>
+#include <string>
 #include <tuple>
+#include <vector>
 
 /*! @brief Size of the variables storing cell indices; this should be big enough
  *  to store at least the number of cells. */
 typedef size_t cellsize_t;
 
+/*! @brief Number of values that are always accumulated per cell during the
+ *  photon propagation step: the mean intensity integrals for all ions and the
+ *  heating terms. If second moment accumulation is enabled, the second moment
+ *  of the hydrogen mean intensity contributions is accumulated as well. */
+#define DENSITYGRID_NUMBER_OF_ACCUMULATED_VALUES                               \
+  (NUMBER_OF_IONNAMES + NUMBER_OF_HEATINGTERMS)
+
+/*! @brief Number of bits below the reference contribution of a cell that are
+ *  kept when contributions are rounded for reproducible accumulation. */
+#define DENSITYGRID_REPRODUCIBLE_PRECISION_BITS 23
+
+/**
+ * @brief Ways in which the contributions of photon packets to the mean
+ * intensity and heating integrals can be accumulated.
+ */
+enum DensityGridAccumulationMode {
+  /*! @brief Lock the cell for every update (if the code is compiled with
+   *  USE_LOCKFREE, atomic additions are used instead). */
+  DENSITYGRID_ACCUMULATION_LOCK = 0,
+  /*! @brief Use atomic additions for every update. */
+  DENSITYGRID_ACCUMULATION_ATOMIC,
+  /*! @brief Add contributions to per-thread shadow arrays that are summed
+   *  into the cells after the photon propagation step. */
+  DENSITYGRID_ACCUMULATION_THREADLOCAL
+};
+
 /**
  * @brief General interface for density grids.
  */
@@ -75,7 +106,7 @@ protected:
   const double _ionization_energy_He;
 
   /*! @brief Ionization calculation variables. */
-  std::vector< IonizationVariables > _ionization_variables;
+  IonizationVariablesArray _ionization_variables;
 
   /// hydro
 
@@ -95,9 +126,55 @@ protected:
   std::vector< Lock > _lock;
 #endif
 
+  /*! @brief Method used to accumulate the mean intensity and heating
+   *  integrals. */
+  DensityGridAccumulationMode _accumulation_mode;
+
+  /*! @brief Per-thread shadow arrays for the mean intensity and heating
+   *  integrals (only used in DENSITYGRID_ACCUMULATION_THREADLOCAL mode). */
+  std::vector< std::vector< double > > _thread_accumulators;
+
+  /*! @brief Round all contributions to the integrals to a fixed-point unit, so
+   *  that the accumulated values do not depend on the order in which they are
+   *  added? */
+  bool _reproducible_accumulation;
+
+  /*! @brief Accumulate the second moment of the hydrogen mean intensity
+   *  contributions (only needed to estimate the Monte Carlo noise)? */
+  bool _second_moment_accumulation;
+
   /*! @brief Log to write log messages to. */
   Log *_log;
 
+  /**
+   * @brief Allocate the per-thread shadow arrays used in
+   * DENSITYGRID_ACCUMULATION_THREADLOCAL mode.
+   *
+   * One array is allocated for every thread that can be used by a parallel
+   * region. In all other modes, the arrays are freed.
+   */
+  inline void allocate_thread_accumulators() {
+    if (_accumulation_mode != DENSITYGRID_ACCUMULATION_THREADLOCAL) {
+      std::vector< std::vector< double > >().swap(_thread_accumulators);
+      return;
+    }
+
+    const int_fast32_t num_threads = WorkEnvironment::get_max_num_threads();
+    const size_t size =
+        _ionization_variables.size() * get_number_of_accumulated_values();
+    if (_log) {
+      _log->write_status("Allocating ", num_threads,
+                         " per-thread accumulator arrays (",
+                         Utilities::human_readable_bytes(num_threads * size *
+                                                         sizeof(double)),
+                         ")...");
+    }
+    _thread_accumulators.resize(num_threads);
+    for (int_fast32_t i = 0; i < num_threads; ++i) {
+      _thread_accumulators[i].assign(size, 0.);
+    }
+  }
+
   /**
    * @brief Get the optical depth for a photon travelling the given path in the
    * given cell.
@@ -108,7 +185,8 @@ protected:
    * @return Optical depth.
    */
   inline static double
-  get_optical_depth(double ds, const IonizationVariables &ionization_variables,
+  get_optical_depth(double ds,
+                    const IonizationVariablesReference &ionization_variables,
                     const Photon &photon) {
     return ds * ionization_variables.get_number_density() *
            (photon.get_cross_section(ION_H_n) *
@@ -117,10 +195,54 @@ protected:
                 ionization_variables.get_ionic_fraction(ION_He_n));
   }
 
+  /**
+   * @brief Round the given contributions to the integrals of a cell with the
+   * given volume to a fixed-point unit.
+   *
+   * The unit is a fixed fraction (2^-DENSITYGRID_REPRODUCIBLE_PRECISION_BITS)
+   * of a reference contribution that only depends on the volume of the cell:
+   * a photon with unit weight crossing the cell with a cross section of
+   * 2^-70 m^2 (~8.5x10^-22 m^2, close to the maximum hydrogen cross section)
+   * and, for the heating terms, an energy excess of 2^53 Hz (~37 eV). The
+   * rounded contributions are integer multiples of the unit, so that all sums
+   * are exact and hence bitwise reproducible, as long as the integrals of a
+   * cell stay below 2^(53 - DENSITYGRID_REPRODUCIBLE_PRECISION_BITS) = 2^30
+   * reference contributions during a single photon propagation step.
+   *
+   * @param volume Volume of the cell (in m^3).
+   * @param dmean_intensity Contributions to the mean intensity integrals.
+   * @param dheating_H Contribution to the hydrogen heating integral.
+   * @param dheating_He Contribution to the helium heating integral.
+   * @param dsecond_moment Contribution to the second moment of the hydrogen
+   * mean intensity integral.
+   */
+  inline static void round_contributions(const double volume,
+                                         double *dmean_intensity,
+                                         double &dheating_H,
+                                         double &dheating_He,
+                                         double &dsecond_moment) {
+    const int exponent_reference = std::ilogb(volume) / 3 - 70;
+    const int exponent_unit =
+        exponent_reference - DENSITYGRID_REPRODUCIBLE_PRECISION_BITS;
+    for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+      dmean_intensity[i] =
+          Utilities::round_to_fixed_point(dmean_intensity[i], exponent_unit);
+    }
+    dheating_H =
+        Utilities::round_to_fixed_point(dheating_H, exponent_unit + 53);
+    dheating_He =
+        Utilities::round_to_fixed_point(dheating_He, exponent_unit + 53);
+    dsecond_moment = Utilities::round_to_fixed_point(
+        dsecond_moment, exponent_reference + exponent_unit);
+  }
+
   /**
    * @brief Update the contributions to the mean intensity integrals due to the
    * given photon travelling the given path length in the given cell.
    *
+   * If reproducible accumulation is enabled, the contributions are rounded
+   * using round_contributions() before they are added.
+   *
    * @param ds Path length the photon traverses (in m).
    * @param cell DensityValues of the cell the photon travels in.
    * @param photon Photon.
@@ -128,7 +250,8 @@ protected:
   inline void update_integrals(double ds, DensityGrid::iterator &cell,
                                const Photon &photon) const {
 
-    IonizationVariables &ionization_variables = cell.get_ionization_variables();
+    IonizationVariablesReference ionization_variables =
+        cell.get_ionization_variables();
     if (ionization_variables.get_number_density() > 0.) {
       // we tried speeding things up by using lock-free addition, but it turns
       // out that the overhead caused by doing this is larger than the overhead
@@ -149,18 +272,63 @@ protected:
       double dheating_He = ds * photon.get_weight() *
                            photon.get_cross_section(ION_He_n) *
                            (photon.get_energy() - _ionization_energy_He);
+      // the second moment is used to estimate the Monte Carlo noise
+      double dsecond_moment = 0.;
+      if (_second_moment_accumulation) {
+        dsecond_moment = dmean_intensity[ION_H_n] * dmean_intensity[ION_H_n];
+      }
+      if (_reproducible_accumulation) {
+        round_contributions(cell.get_volume(), dmean_intensity, dheating_H,
+                            dheating_He, dsecond_moment);
+      }
+      if (_accumulation_mode == DENSITYGRID_ACCUMULATION_THREADLOCAL) {
+        // every thread has its own copy of the integrals, so no
+        // synchronization is required. The copies are summed in
+        // reduce_thread_accumulators()
+        double *accumulators =
+            cell.get_thread_accumulators(WorkEnvironment::get_thread_id());
+        for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+          accumulators[i] += dmean_intensity[i];
+        }
+        accumulators[NUMBER_OF_IONNAMES + HEATINGTERM_H] += dheating_H;
+        accumulators[NUMBER_OF_IONNAMES + HEATINGTERM_He] += dheating_He;
+        if (_second_moment_accumulation) {
+          accumulators[DENSITYGRID_NUMBER_OF_ACCUMULATED_VALUES] +=
+              dsecond_moment;
+        }
+      } else if (_accumulation_mode == DENSITYGRID_ACCUMULATION_ATOMIC) {
+        for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+          IonName ion = static_cast< IonName >(i);
+          ionization_variables.atomic_increase_mean_intensity(
+              ion, dmean_intensity[i]);
+        }
+        ionization_variables.atomic_increase_heating(HEATINGTERM_H,
+                                                     dheating_H);
+        ionization_variables.atomic_increase_heating(HEATINGTERM_He,
+                                                     dheating_He);
+        if (_second_moment_accumulation) {
+          ionization_variables.atomic_increase_mean_intensity_second_moment(
+              dsecond_moment);
+        }
+      } else {
 #ifndef USE_LOCKFREE
-      cell.lock();
+        cell.lock();
 #endif
-      for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
-        IonName ion = static_cast< IonName >(i);
-        ionization_variables.increase_mean_intensity(ion, dmean_intensity[i]);
-      }
-      ionization_variables.increase_heating(HEATINGTERM_H, dheating_H);
-      ionization_variables.increase_heating(HEATINGTERM_He, dheating_He);
+        for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+          IonName ion = static_cast< IonName >(i);
+          ionization_variables.increase_mean_intensity(ion,
+                                                       dmean_intensity[i]);
+        }
+        ionization_variables.increase_heating(HEATINGTERM_H, dheating_H);
+        ionization_variables.increase_heating(HEATINGTERM_He, dheating_He);
+        if (_second_moment_accumulation) {
+          ionization_variables.increase_mean_intensity_second_moment(
+              dsecond_moment);
+        }
 #ifndef USE_LOCKFREE
-      cell.unlock();
+        cell.unlock();
 #endif
+      }
     }
   }
 
@@ -187,7 +355,9 @@ public:
             UnitConverter::to_SI< QUANTITY_FREQUENCY >(13.6, "eV")),
         _ionization_energy_He(
             UnitConverter::to_SI< QUANTITY_FREQUENCY >(24.6, "eV")),
-        _has_hydro(hydro), _log(log) {}
+        _has_hydro(hydro), _accumulation_mode(DENSITYGRID_ACCUMULATION_LOCK),
+        _reproducible_accumulation(false), _second_moment_accumulation(false),
+        _log(log) {}
 
   /**
    * @brief Virtual destructor.
@@ -213,12 +383,133 @@ public:
 #ifndef USE_LOCKFREE
     _lock.resize(numcell);
 #endif
+    allocate_thread_accumulators();
 
     if (_log) {
       _log->write_status("Done allocating memory.");
     }
   }
 
+  /**
+   * @brief Get direct access to the ionization variables of all cells.
+   *
+   * The variables of the cell an iterator points to are stored at the index of
+   * that iterator. This is used by the ionization and temperature sweeps to
+   * operate on the contiguous arrays of the state variables.
+   *
+   * @return IonizationVariablesArray containing the variables of all cells.
+   */
+  inline IonizationVariablesArray &get_ionization_variables_array() {
+    return _ionization_variables;
+  }
+
+  /**
+   * @brief Get the DensityGridAccumulationMode that corresponds to the given
+   * name.
+   *
+   * Supported names are:
+   *  - Lock: lock the cell for every update (default)
+   *  - Atomic: use atomic additions
+   *  - ThreadLocal: use per-thread shadow arrays for the integrals
+   *
+   * @param name Name of an accumulation mode.
+   * @return Corresponding DensityGridAccumulationMode.
+   */
+  inline static DensityGridAccumulationMode
+  get_accumulation_mode(const std::string name) {
+    if (name == "Lock") {
+      return DENSITYGRID_ACCUMULATION_LOCK;
+    } else if (name == "Atomic") {
+      return DENSITYGRID_ACCUMULATION_ATOMIC;
+    } else if (name == "ThreadLocal") {
+      return DENSITYGRID_ACCUMULATION_THREADLOCAL;
+    } else {
+      cmac_error("Unknown accumulation mode: \"%s\"!", name.c_str());
+      return DENSITYGRID_ACCUMULATION_LOCK;
+    }
+  }
+
+  /**
+   * @brief Set the method used to accumulate the mean intensity and heating
+   * integrals during the photon propagation step.
+   *
+   * In DENSITYGRID_ACCUMULATION_THREADLOCAL mode, the integrals are only
+   * added to the cells by reduce_thread_accumulators(), which should be called
+   * after every photon propagation step. This mode needs one copy of the
+   * integrals for every thread, so the maximum number of threads should be
+   * set before this function is called.
+   *
+   * @param mode DensityGridAccumulationMode.
+   */
+  inline void set_accumulation_mode(DensityGridAccumulationMode mode) {
+    _accumulation_mode = mode;
+    allocate_thread_accumulators();
+  }
+
+  /**
+   * @brief Get the method used to accumulate the mean intensity and heating
+   * integrals during the photon propagation step.
+   *
+   * @return DensityGridAccumulationMode.
+   */
+  inline DensityGridAccumulationMode get_accumulation_mode() const {
+    return _accumulation_mode;
+  }
+
+  /**
+   * @brief Set whether or not the contributions to the mean intensity and
+   * heating integrals should be rounded to a fixed-point unit, so that the
+   * integrals are bitwise identical for any order of accumulation (and hence
+   * for any number of threads and processes, and any accumulation mode).
+   *
+   * See round_contributions() for the rounding and its limitations.
+   *
+   * @param reproducible_accumulation Round the contributions?
+   */
+  inline void set_reproducible_accumulation(bool reproducible_accumulation) {
+    _reproducible_accumulation = reproducible_accumulation;
+  }
+
+  /**
+   * @brief Set whether or not the second moment of the hydrogen mean intensity
+   * contributions should be accumulated during the photon propagation step.
+   *
+   * The second moment is only used to estimate the Monte Carlo noise on the
+   * ionization state (see IterationConvergenceChecker), so it is not
+   * accumulated by default. In DENSITYGRID_ACCUMULATION_THREADLOCAL mode, this
+   * resizes the per-thread shadow arrays.
+   *
+   * @param second_moment_accumulation Accumulate the second moment?
+   */
+  inline void set_second_moment_accumulation(bool second_moment_accumulation) {
+    _second_moment_accumulation = second_moment_accumulation;
+    allocate_thread_accumulators();
+  }
+
+  /**
+   * @brief Check whether the second moment of the hydrogen mean intensity
+   * contributions is accumulated during the photon propagation step.
+   *
+   * @return True if the second moment is accumulated.
+   */
+  inline bool get_second_moment_accumulation() const {
+    return _second_moment_accumulation;
+  }
+
+  /**
+   * @brief Get the number of values that are accumulated per cell during the
+   * photon propagation step.
+   *
+   * @return DENSITYGRID_NUMBER_OF_ACCUMULATED_VALUES, plus one if the second
+   * moment of the hydrogen mean intensity contributions is accumulated.
+   */
+  inline uint_fast32_t get_number_of_accumulated_values() const {
+    return DENSITYGRID_NUMBER_OF_ACCUMULATED_VALUES +
+           (_second_moment_accumulation ? 1 : 0);
+  }
+
+  void reduce_thread_accumulators(int_fast32_t worksize = -1);
+
   /**
    * @brief Routine that does the actual initialization of the grid.
    *
@@ -315,6 +606,25 @@ public:
    */
   virtual std::vector< Face > get_faces(cellsize_t index) const = 0;
 
+  /**
+   * @brief Get the geometrical information needed to integrate a function over
+   * the cell with the given index and to walk from the cell to its
+   * neighbours.
+   *
+   * @param index Index of a cell.
+   * @param bounding_box Axis aligned bounding box of the cell (in m).
+   * @param planes Planes that cut the cell out of its bounding box, as pairs of
+   * an outward normal n and an offset d: a position p inside the bounding box
+   * is inside the cell if n.p <= d for all planes. Empty for cells that
+   * coincide with their bounding box.
+   * @param ngbs Indices of the cells that share a face with the cell.
+   * Neighbours across periodic boundaries are not included.
+   */
+  virtual void get_cell_geometry(
+      cellsize_t index, Box<> &bounding_box,
+      std::vector< std::pair< CoordinateVector<>, double > > &planes,
+      std::vector< cellsize_t > &ngbs) const = 0;
+
   /**
    * @brief Get an iterator to the cell containing the given position.
    *
@@ -357,6 +667,24 @@ public:
   virtual DensityGrid::iterator interact(Photon &photon,
                                          double optical_depth) = 0;
 
+  /**
+   * @brief Get the total line emission along a ray with the given origin and
+   * direction, for all given lines at once.
+   *
+   * The ray is traced through the grid only once. This method does not change
+   * the grid and can be called by multiple threads simultaneously.
+   *
+   * @param origin Origin of the ray (in m). Should be inside the grid.
+   * @param direction Direction of the ray.
+   * @param lines EmissionLine names of the lines to trace.
+   * @param emissions Array to store the accumulated emission along the ray for
+   * every line in (in J m^-2 s^-1). Should have the same size as lines.
+   */
+  virtual void get_total_emissions(CoordinateVector<> origin,
+                                   CoordinateVector<> direction,
+                                   const std::vector< EmissionLine > &lines,
+                                   double *emissions) = 0;
+
   /**
    * @brief Get the total line emission along a ray with the given origin and
    * direction.
@@ -366,9 +694,14 @@ public:
    * @param line EmissionLine name of the line to trace.
    * @return Accumulated emission along the ray (in J m^-2 s^-1).
    */
-  virtual double get_total_emission(CoordinateVector<> origin,
-                                    CoordinateVector<> direction,
-                                    EmissionLine line) = 0;
+  inline double get_total_emission(CoordinateVector<> origin,
+                                   CoordinateVector<> direction,
+                                   EmissionLine line) {
+    const std::vector< EmissionLine > lines(1, line);
+    double emission;
+    get_total_emissions(origin, direction, lines, &emission);
+    return emission;
+  }
 
   /**
    * @brief Index increment used in the iterator.
@@ -436,6 +769,8 @@ public:
         const HeatingTermName name = static_cast< HeatingTermName >(i);
         _grid->_ionization_variables[_index].set_heating(name, 0.);
       }
+      _grid->_ionization_variables[_index].set_mean_intensity_second_moment(
+          0.);
     }
 
     /**
@@ -476,7 +811,8 @@ public:
      *
      * @return Read only access to the ionization variables.
      */
-    inline const IonizationVariables &get_ionization_variables() const {
+    inline const IonizationVariablesReference
+    get_ionization_variables() const {
       return _grid->_ionization_variables[_index];
     }
 
@@ -486,7 +822,7 @@ public:
      *
      * @return Read/write access to the ionization variables.
      */
-    inline IonizationVariables &get_ionization_variables() {
+    inline IonizationVariablesReference get_ionization_variables() {
       return _grid->_ionization_variables[_index];
     }
 
@@ -555,6 +891,23 @@ public:
     inline void unlock() { _grid->_lock[_index].unlock(); }
 #endif
 
+    /**
+     * @brief Get the shadow copy of the mean intensity and heating integrals
+     * of the cell the iterator is pointing to for the thread with the given
+     * rank.
+     *
+     * Only valid in DENSITYGRID_ACCUMULATION_THREADLOCAL mode.
+     *
+     * @param thread_id Rank of the thread.
+     * @return Pointer to the get_number_of_accumulated_values() values for the
+     * cell (mean intensity integrals, followed by the heating terms and the
+     * second moment, if accumulated).
+     */
+    inline double *get_thread_accumulators(int_fast32_t thread_id) {
+      const size_t offset = _index * _grid->get_number_of_accumulated_values();
+      return &_grid->_thread_accumulators[thread_id][offset];
+    }
+
     /**
      * @brief Get the volume of the cell the iterator is pointing to.
      *
@@ -603,7 +956,14 @@ public:
      *
      * @return Index of the current cell.
      */
-    inline cellsize_t get_index() const { return _index; }
+    virtual cellsize_t get_index() const { return _index; }
+
+    /**
+     * @brief Get the DensityGrid the iterator belongs to.
+     *
+     * @return Pointer to the DensityGrid.
+     */
+    virtual const DensityGrid *get_grid() const { return _grid; }
 
     /**
      * @brief Compare iterators.
@@ -701,7 +1061,8 @@ public:
     inline void operator()(iterator it) {
 
       DensityValues vals = _function(it);
-      IonizationVariables &ionization_variables = it.get_ionization_variables();
+      IonizationVariablesReference ionization_variables =
+          it.get_ionization_variables();
       ionization_variables.set_number_density(vals.get_number_density());
       ionization_variables.set_temperature(vals.get_temperature());
       for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
@@ -719,6 +1080,107 @@ public:
   void set_densities(std::pair< cellsize_t, cellsize_t > &block,
                      DensityFunction &function, int_fast32_t worksize = -1);
 
+  /**
+   * @brief Functor class used to update the number densities of the cells
+   * without touching the other variables.
+   */
+  class DensityGridNumberDensityUpdateFunction {
+  private:
+    /*! @brief DensityFunction that sets the density for each cell in the grid.
+     */
+    DensityFunction &_function;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param function DensityFunction that sets the density for each cell in
+     * the grid.
+     */
+    DensityGridNumberDensityUpdateFunction(DensityFunction &function)
+        : _function(function) {}
+
+    /**
+     * @brief Routine that updates the number density for a single cell in the
+     * grid.
+     *
+     * @param it DensityGrid::iterator pointing to a single cell in the grid.
+     */
+    inline void operator()(iterator it) {
+      DensityValues vals = _function(it);
+      it.get_ionization_variables().set_number_density(
+          vals.get_number_density());
+    }
+  };
+
+  void update_number_densities(std::pair< cellsize_t, cellsize_t > &block,
+                               DensityFunction &function,
+                               int_fast32_t worksize = -1);
+
+  /**
+   * @brief Functor class used to add the per-thread shadow copies of the mean
+   * intensity and heating integrals to the cells.
+   */
+  class DensityGridAccumulatorReductionFunction {
+  private:
+    /*! @brief Number of per-thread shadow copies. */
+    const int_fast32_t _num_threads;
+
+    /*! @brief Number of accumulated values per cell. */
+    const uint_fast32_t _num_values;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param num_threads Number of per-thread shadow copies.
+     * @param num_values Number of accumulated values per cell.
+     */
+    DensityGridAccumulatorReductionFunction(int_fast32_t num_threads,
+                                            uint_fast32_t num_values)
+        : _num_threads(num_threads), _num_values(num_values) {}
+
+    /**
+     * @brief Add the shadow copies for the given cell to the cell and reset
+     * them.
+     *
+     * @param it DensityGrid::iterator pointing to a cell.
+     */
+    inline void operator()(iterator it) {
+
+      double sum[DENSITYGRID_NUMBER_OF_ACCUMULATED_VALUES + 1] = {0.};
+      for (int_fast32_t ithread = 0; ithread < _num_threads; ++ithread) {
+        double *accumulators = it.get_thread_accumulators(ithread);
+        for (uint_fast32_t i = 0; i < _num_values; ++i) {
+          sum[i] += accumulators[i];
+          accumulators[i] = 0.;
+        }
+      }
+
+      // every cell is only processed by a single thread, so we do not need to
+      // lock
+      IonizationVariablesReference ionization_variables =
+          it.get_ionization_variables();
+      for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+        IonName ion = static_cast< IonName >(i);
+        ionization_variables.set_mean_intensity(
+            ion, ionization_variables.get_mean_intensity(ion) + sum[i]);
+      }
+      for (int_fast32_t i = 0; i < NUMBER_OF_HEATINGTERMS; ++i) {
+        HeatingTermName name = static_cast< HeatingTermName >(i);
+        ionization_variables.set_heating(
+            name,
+            ionization_variables.get_heating(name) +
+                sum[NUMBER_OF_IONNAMES + i]);
+      }
+      if (_num_values > DENSITYGRID_NUMBER_OF_ACCUMULATED_VALUES) {
+        ionization_variables.set_mean_intensity_second_moment(
+            ionization_variables.get_mean_intensity_second_moment() +
+            sum[DENSITYGRID_NUMBER_OF_ACCUMULATED_VALUES]);
+      }
+    }
+  };
+
   /**
    * @brief Reset the mean intensity counters and update the reemission
    * probabilities for all cells.
@@ -741,6 +1203,15 @@ public:
    */
   virtual void evolve(double timestep) {}
 
+  /**
+   * @brief Does the geometry of the grid change when evolve() is called?
+   *
+   * This method should only be implemented for moving grids.
+   *
+   * @return False, since the grid is static by default.
+   */
+  virtual bool has_moving_geometry() const { return false; }
+
   /**
    * @brief Set the velocity for the grid movement.
    *
@@ -750,6 +1221,43 @@ public:
    */
   virtual void set_grid_velocity(double gamma) {}
 
+  /**
+   * @brief Write the state of the grid to the given RestartWriter.
+   *
+   * By default, we only write the ionization and hydro variables of the cells.
+   * Grids that have additional state (like moving grids) should extend this
+   * method.
+   *
+   * @param restart_writer RestartWriter to write to.
+   */
+  virtual void write_restart_file(RestartWriter &restart_writer) const {
+    _ionization_variables.write_restart_file(restart_writer);
+    restart_writer.write(_has_hydro);
+    if (_has_hydro) {
+      restart_writer.write(_hydro_variables);
+    }
+  }
+
+  /**
+   * @brief Restore the state of the grid from the given RestartReader.
+   *
+   * The grid should have been initialized using the same parameters as the
+   * grid that wrote the restart file.
+   *
+   * @param restart_reader RestartReader to read from.
+   */
+  virtual void read_restart_file(RestartReader &restart_reader) {
+    _ionization_variables.read_restart_file(restart_reader);
+    const bool has_hydro = restart_reader.read< bool >();
+    if (has_hydro != _has_hydro) {
+      cmac_error("Restart file was written for a grid %s hydrodynamics!",
+                 has_hydro ? "with" : "without");
+    }
+    if (_has_hydro) {
+      restart_reader.read_fixed_size(_hydro_variables);
+    }
+  }
+
   /**
    * @brief Get the total number of hydrogen atoms contained in the grid.
    *
@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2016 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file DensityGridBatchTraversalJobMarket.hpp
+ *
+ * @brief JobMarket used to spawn DensityGridBatchTraversalJobs that should be
+ * executed for contiguous batches of cells of the DensityGrid, possibly in
+ * parallel.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef DENSITYGRIDBATCHTRAVERSALJOBMARKET_HPP
+#define DENSITYGRIDBATCHTRAVERSALJOBMARKET_HPP
+
+#include "DensityGrid.hpp"
+#include "DensityGridBatchTraversalJob.hpp"
+#include "Timer.hpp"
+#include "WorkStealingScheduler.hpp"
+
+/**
+ * @brief JobMarket used to spawn DensityGridBatchTraversalJobs that should be
+ * executed for contiguous batches of cells of the DensityGrid, possibly in
+ * parallel.
+ */
+template < typename _function_ > class DensityGridBatchTraversalJobMarket {
+private:
+  /*! @brief Template _function_ that should be executed for every batch of
+   *  cells. This function can be a function or a functor, and should take two
+   *  DensityGrid::iterators (begin and end of the batch) as parameters. */
+  _function_ &_function;
+
+  /*! @brief DensityGrid on which we operate. */
+  DensityGrid &_grid;
+
+  /*! @brief Block that is traversed by the local MPI process. */
+  std::pair< cellsize_t, cellsize_t > _block;
+
+  /*! @brief Scheduler that distributes the cells of the block over the
+   *  threads. */
+  WorkStealingScheduler _scheduler;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param grid DensityGrid on which we operate.
+   * @param function Template function or functor that should be executed for
+   * every batch of cells. This function/functor should take two
+   * DensityGrid::iterators (begin and end of the batch) as parameters.
+   * @param block Block that is traversed by the local MPI process.
+   */
+  inline DensityGridBatchTraversalJobMarket(
+      DensityGrid &grid, _function_ &function,
+      std::pair< cellsize_t, cellsize_t > &block)
+      : _function(function), _grid(grid), _block(block),
+        _scheduler(1.e-3, 100) {
+
+    // make sure the second element of _block contains the size and not the end
+    // index
+    _block.second -= _block.first;
+  }
+
+  /**
+   * @brief Set the number of parallel threads that will be used to execute
+   * the jobs.
+   *
+   * This distributes the cells of the block over the per thread queues of
+   * the WorkStealingScheduler.
+   *
+   * @param worksize Number of parallel threads that will be used.
+   */
+  inline void set_worksize(int_fast32_t worksize) {
+    _scheduler.reset(_block.first, _block.first + _block.second, worksize);
+  }
+
+  /**
+   * @brief Get a DensityGridBatchTraversalJob.
+   *
+   * @param thread_id Id of the thread that calls this function.
+   * @return Pointer to a unique and thread safe DensityGridBatchTraversalJob
+   * instance.
+   */
+  inline DensityGridBatchTraversalJob< _function_ > *
+  get_job(int_fast32_t thread_id) {
+
+    uint_fast64_t begin, end;
+    if (!_scheduler.get_chunk(thread_id, begin, end)) {
+      return nullptr;
+    }
+    std::pair< DensityGrid::iterator, DensityGrid::iterator > chunk =
+        _grid.get_chunk(begin, end);
+    DensityGridBatchTraversalJob< _function_ > *job =
+        new DensityGridBatchTraversalJob< _function_ >(chunk.first,
+                                                       chunk.second, _function);
+    return job;
+  }
+};
+
+#endif // DENSITYGRIDBATCHTRAVERSALJOBMARKET_HPP
@@ -51,6 +51,10 @@ public:
    *  - Cartesian: Regular static Cartesian grid
    *  - Voronoi: Unstructured, moving Voronoi grid
    *
+   * The method used to accumulate the mean intensity and heating integrals is
+   * set by the parameter "accumulation mode" (default: Lock, see
+   * DensityGrid::get_accumulation_mode() for supported values).
+   *
    * @param simulation_box SimulationBox.
    * @param params ParameterFile containing the parameters used by the specific
    * implementation.
@@ -68,16 +72,27 @@ public:
     if (log) {
       log->write_info("Requested DensityGrid type: ", type);
     }
+    DensityGrid *grid = nullptr;
     if (type == "AMR") {
-      return new AMRDensityGrid(simulation_box, params, hydro, log);
+      grid = new AMRDensityGrid(simulation_box, params, hydro, log);
     } else if (type == "Cartesian") {
-      return new CartesianDensityGrid(simulation_box, params, hydro, log);
+      grid = new CartesianDensityGrid(simulation_box, params, hydro, log);
     } else if (type == "Voronoi") {
-      return new VoronoiDensityGrid(simulation_box, params, hydro, log);
+      grid = new VoronoiDensityGrid(simulation_box, params, hydro, log);
     } else {
       cmac_error("Unknown DensityGrid type: \"%s\".", type.c_str());
       return nullptr;
     }
+
+    const std::string accumulation_mode = params.get_value< std::string >(
+        "DensityGrid:accumulation mode", "Lock");
+    if (log) {
+      log->write_info("Requested DensityGrid accumulation mode: ",
+                      accumulation_mode);
+    }
+    grid->set_accumulation_mode(
+        DensityGrid::get_accumulation_mode(accumulation_mode));
+    return grid;
   }
 };
 
@@ -29,8 +29,8 @@
 
 #include "DensityGrid.hpp"
 #include "DensityGridTraversalJob.hpp"
-#include "Lock.hpp"
 #include "Timer.hpp"
+#include "WorkStealingScheduler.hpp"
 
 /**
  * @brief JobMarket used to spawn DensityGridTraversalJobs that should be
@@ -38,9 +38,6 @@
  */
 template < typename _function_ > class DensityGridTraversalJobMarket {
 private:
-  /*! @brief Fraction of the grid that was already processed. */
-  double _fraction_done;
-
   /*! @brief Template _function_ that should be executed for every cell of the
    *  grid. This function can be a function or a functor, and should take a
    *  DensityGrid::iterator as single parameter. */
@@ -52,8 +49,9 @@ private:
   /*! @brief Block that is traversed by the local MPI process. */
   std::pair< cellsize_t, cellsize_t > _block;
 
-  /*! @brief Lock used to ensure safe access to the internal counters. */
-  Lock _lock;
+  /*! @brief Scheduler that distributes the cells of the block over the
+   *  threads. */
+  WorkStealingScheduler _scheduler;
 
 public:
   /**
@@ -68,7 +66,8 @@ public:
   inline DensityGridTraversalJobMarket(
       DensityGrid &grid, _function_ &function,
       std::pair< cellsize_t, cellsize_t > &block)
-      : _fraction_done(0.), _function(function), _grid(grid), _block(block) {
+      : _function(function), _grid(grid), _block(block),
+        _scheduler(1.e-3, 100) {
 
     // make sure the second element of _block contains the size and not the end
     // index
@@ -79,9 +78,14 @@ public:
    * @brief Set the number of parallel threads that will be used to execute
    * the jobs.
    *
+   * This distributes the cells of the block over the per thread queues of
+   * the WorkStealingScheduler.
+   *
    * @param worksize Number of parallel threads that will be used.
    */
-  inline void set_worksize(int_fast32_t worksize) {}
+  inline void set_worksize(int_fast32_t worksize) {
+    _scheduler.reset(_block.first, _block.first + _block.second, worksize);
+  }
 
   /**
    * @brief Get a DensityGridTraversalJob.
@@ -93,23 +97,10 @@ public:
   inline DensityGridTraversalJob< _function_ > *
   get_job(int_fast32_t thread_id) {
 
-    if (_fraction_done == 1.) {
-      return nullptr;
-    }
-    _lock.lock();
-    // _fraction_done could be 1. now, as another thread might have changed it
-    if (_fraction_done == 1.) {
-      _lock.unlock();
+    uint_fast64_t begin, end;
+    if (!_scheduler.get_chunk(thread_id, begin, end)) {
       return nullptr;
     }
-    double begin_fraction = _fraction_done;
-    double end_fraction =
-        _fraction_done + std::max(0.05 * (1. - _fraction_done), 0.001);
-    end_fraction = std::min(end_fraction, 1.);
-    _fraction_done = end_fraction;
-    _lock.unlock();
-    cellsize_t begin = _block.first + begin_fraction * _block.second;
-    cellsize_t end = _block.first + end_fraction * _block.second;
     std::pair< DensityGrid::iterator, DensityGrid::iterator > chunk =
         _grid.get_chunk(begin, end);
     DensityGridTraversalJob< _function_ > *job =
@@ -26,13 +26,14 @@
 #ifndef DENSITYGRIDWRITER_HPP
 #define DENSITYGRIDWRITER_HPP
 
+#include "AsynchronousWriteQueue.hpp"
 #include "Log.hpp"
+#include "ParameterFile.hpp"
 
 #include <cstdlib>
 #include <string>
 
 class DensityGrid;
-class ParameterFile;
 
 /**
  * @brief Snapshot file writer for the DensityGrid.
@@ -45,6 +46,10 @@ protected:
   /*! @brief Log to write logging information to. */
   Log *_log;
 
+  /*! @brief Queue used to write snapshots asynchronously (nullptr if
+   *  snapshots are written synchronously). */
+  AsynchronousWriteQueue *_write_queue;
+
 public:
   /**
    * @brief Constructor.
@@ -52,19 +57,76 @@ public:
    * @param output_folder Name of the folder where output files should be
    * placed.
    * @param log Log to write logging information to.
+   * @param maximum_number_of_snapshots_in_flight Maximum number of snapshots
+   * that can be staged for asynchronous writing at the same time. If 0,
+   * snapshots are written synchronously.
    */
-  DensityGridWriter(std::string output_folder, Log *log = nullptr)
-      : _output_folder(output_folder), _log(log) {
+  DensityGridWriter(std::string output_folder, Log *log = nullptr,
+                    uint_fast32_t maximum_number_of_snapshots_in_flight = 0)
+      : _output_folder(output_folder), _log(log), _write_queue(nullptr) {
 
     if (_log) {
       _log->write_status("Output will be written to ", _output_folder, "/");
     }
+
+    if (maximum_number_of_snapshots_in_flight > 0) {
+      _write_queue =
+          new AsynchronousWriteQueue(maximum_number_of_snapshots_in_flight);
+      if (_log) {
+        _log->write_status("Snapshots will be written asynchronously, with at "
+                           "most ",
+                           maximum_number_of_snapshots_in_flight,
+                           " snapshot(s) in flight.");
+      }
+    }
   }
 
   /**
    * @brief Virtual destructor.
+   *
+   * Waits for snapshots that are still being written.
+   */
+  virtual ~DensityGridWriter() { delete _write_queue; }
+
+  // the writer owns its write queue and I/O thread, so it cannot be copied
+  DensityGridWriter(const DensityGridWriter &) = delete;
+  DensityGridWriter &operator=(const DensityGridWriter &) = delete;
+
+  /**
+   * @brief Read the asynchronous output parameters from the given
+   * ParameterFile.
+   *
+   * Parameters are:
+   *  - asynchronous output: Write snapshots from a background I/O thread, while
+   *    the simulation continues (default: false)
+   *  - maximum number of snapshots in flight: Maximum number of snapshots that
+   *    are staged for asynchronous output at the same time (default: 2)
+   *
+   * @param params ParameterFile to read from.
+   * @return Maximum number of snapshots in flight, or 0 if snapshots should be
+   * written synchronously.
    */
-  virtual ~DensityGridWriter() {}
+  inline static uint_fast32_t
+  get_maximum_number_of_snapshots_in_flight(ParameterFile &params) {
+    if (params.get_value< bool >("DensityGridWriter:asynchronous output",
+                                 false)) {
+      return params.get_value< uint_fast32_t >(
+          "DensityGridWriter:maximum number of snapshots in flight", 2);
+    } else {
+      return 0;
+    }
+  }
+
+  /**
+   * @brief Wait until all snapshots have been written to disk.
+   *
+   * Does nothing if snapshots are written synchronously.
+   */
+  inline void flush() {
+    if (_write_queue != nullptr) {
+      _write_queue->flush();
+    }
+  }
 
   /**
    * @brief Write a snapshot.
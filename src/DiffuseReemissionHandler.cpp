@@ -50,7 +50,7 @@ DiffuseReemissionHandler::DiffuseReemissionHandler(
  */
 double DiffuseReemissionHandler::reemit(
     const Photon &photon, double helium_abundance,
-    const IonizationVariables &ionization_variables,
+    const IonizationVariablesReference &ionization_variables,
     RandomGenerator &random_generator, PhotonType &type) const {
 
   double new_frequency = 0.;
@@ -59,8 +59,8 @@ public:
    *
    * @param ionization_variables IonizationVariables of the cell.
    */
-  inline static void
-  set_reemission_probabilities(IonizationVariables &ionization_variables) {
+  inline static void set_reemission_probabilities(
+      IonizationVariablesReference ionization_variables) {
 
     const double T4 = ionization_variables.get_temperature() * 1.e-4;
 
@@ -113,7 +113,7 @@ public:
   }
 
   double reemit(const Photon &photon, double helium_abundance,
-                const IonizationVariables &ionization_variables,
+                const IonizationVariablesReference &ionization_variables,
                 RandomGenerator &random_generator, PhotonType &type) const;
 };
 
@@ -33,6 +33,8 @@
 #include "PhotonSource.hpp"
 #include "RandomGenerator.hpp"
 
+#include <vector>
+
 /**
  * @brief Job implementation that shoots photons through a dusty DensityGrid.
  */
@@ -50,8 +52,8 @@ private:
   /*! @brief DensityGrid through which photons are propagated. */
   DensityGrid &_density_grid;
 
-  /*! @brief CCDImage computed by this thread. */
-  CCDImage _image;
+  /*! @brief CCDImages computed by this thread (one per observer). */
+  std::vector< CCDImage > _images;
 
   /*! @brief Number of photons to propagate through the DensityGrid. */
   uint_fast64_t _numphoton;
@@ -66,15 +68,15 @@ public:
    * @param random_seed Seed for the RandomGenerator used by this specific
    * thread.
    * @param density_grid DensityGrid through which photons are propagated.
-   * @param image CCDImage to construct.
+   * @param images CCDImages to construct (one per observer).
    */
   inline DustPhotonShootJob(PhotonSource &photon_source,
                             const DustScattering &dust_scattering,
                             int_fast32_t random_seed, DensityGrid &density_grid,
-                            const CCDImage &image)
+                            const std::vector< CCDImage > &images)
       : _photon_source(photon_source), _dust_scattering(dust_scattering),
         _random_generator(random_seed), _density_grid(density_grid),
-        _image(image), _numphoton(0) {}
+        _images(images), _numphoton(0) {}
 
   /**
    * @brief Set the number of photons for the next execution of the job.
@@ -84,13 +86,16 @@ public:
   inline void set_numphoton(uint_fast64_t numphoton) { _numphoton = numphoton; }
 
   /**
-   * @brief Update the given CCDImage.
+   * @brief Update the given CCDImages.
    *
-   * @param image CCDImage to update.
+   * @param images CCDImages to update (one per observer).
    */
-  inline void update_image(CCDImage &image) {
-    image += _image;
-    _image.reset();
+  inline void update_images(std::vector< CCDImage > &images) {
+    cmac_assert(images.size() == _images.size());
+    for (size_t i = 0; i < _images.size(); ++i) {
+      images[i] += _images[i];
+      _images[i].reset();
+    }
   }
 
   /**
@@ -107,6 +112,7 @@ public:
   inline void execute() {
     // parameter
     const double band_albedo = _dust_scattering.get_albedo();
+    const size_t numimage = _images.size();
 
     for (uint_fast64_t i = 0; i < _numphoton; ++i) {
       Photon photon = _photon_source.get_random_photon(_random_generator);
@@ -123,12 +129,16 @@ public:
       // overwrite cross section: we want it to be the dust attenuation
       photon.set_cross_section(ION_H_n, _dust_scattering.get_kappa());
 
-      Photon old_photon(photon);
-      old_photon.set_direction(
-          _image.get_direction(sint, cost, phi, sinp, cosp));
-      const double tau_old = _density_grid.integrate_optical_depth(old_photon);
-      _image.add_photon(old_photon.get_position(),
-                        0.25 * std::exp(-tau_old) / M_PI, 0., 0.);
+      // add the direct (unscattered) contribution to every observer
+      for (size_t iimage = 0; iimage < numimage; ++iimage) {
+        Photon old_photon(photon);
+        old_photon.set_direction(
+            _images[iimage].get_direction(sint, cost, phi, sinp, cosp));
+        const double tau_old =
+            _density_grid.integrate_optical_depth(old_photon);
+        _images[iimage].add_photon(old_photon.get_position(),
+                                   0.25 * std::exp(-tau_old) / M_PI, 0., 0.);
+      }
 
       double albedo = 1.;
       // make sure the photon scatters at least once by forcing a first
@@ -140,21 +150,26 @@ public:
       DensityGrid::iterator it = _density_grid.interact(photon, tau);
       while (it != _density_grid.end()) {
 
-        // peel off a photon towards the observer
-        Photon new_photon(photon);
-        const CoordinateVector<> direction_new =
-            _image.get_direction(sint, cost, phi, sinp, cosp);
-        const double hgfac = _dust_scattering.scatter_towards(
-            new_photon, direction_new, sint, cost, phi, sinp, cosp);
-        const double tau_new =
-            _density_grid.integrate_optical_depth(new_photon);
-        double fi, fq, fu, fv;
-        new_photon.get_stokes_parameters(fi, fq, fu, fv);
         // after every scattering event, the accumulated albedo is reduced
         albedo *= band_albedo;
-        const double weight_new = weight * hgfac * albedo * std::exp(-tau_new);
-        _image.add_photon(new_photon.get_position(), weight_new * fi,
-                          weight_new * fq, weight_new * fu);
+
+        // peel off a photon towards every observer
+        for (size_t iimage = 0; iimage < numimage; ++iimage) {
+          Photon new_photon(photon);
+          const CoordinateVector<> direction_new =
+              _images[iimage].get_direction(sint, cost, phi, sinp, cosp);
+          const double hgfac = _dust_scattering.scatter_towards(
+              new_photon, direction_new, sint, cost, phi, sinp, cosp);
+          const double tau_new =
+              _density_grid.integrate_optical_depth(new_photon);
+          double fi, fq, fu, fv;
+          new_photon.get_stokes_parameters(fi, fq, fu, fv);
+          const double weight_new =
+              weight * hgfac * albedo * std::exp(-tau_new);
+          _images[iimage].add_photon(new_photon.get_position(),
+                                     weight_new * fi, weight_new * fq,
+                                     weight_new * fu);
+        }
 
         _dust_scattering.scatter(photon, _random_generator);
         tau = -std::log(_random_generator.get_uniform_random_double());
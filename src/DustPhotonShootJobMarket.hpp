@@ -29,7 +29,9 @@
 
 #include "Configuration.hpp"
 #include "DustPhotonShootJob.hpp"
-#include "Lock.hpp"
+#include "WorkStealingScheduler.hpp"
+
+#include <vector>
 
 class CCDImage;
 class DensityGrid;
@@ -52,12 +54,8 @@ private:
   /*! @brief Total number of photons to propagate through the grid. */
   uint_fast64_t _numphoton;
 
-  /*! @brief Number of photons to shoot during a single DustPhotonShootJob. */
-  const uint_fast64_t _jobsize;
-
-  /*! @brief Lock used to ensure safe access to the internal photon number
-   *  counters. */
-  Lock _lock;
+  /*! @brief Scheduler that distributes the photons over the threads. */
+  WorkStealingScheduler _scheduler;
 
 public:
   /**
@@ -69,9 +67,9 @@ public:
    * @param random_seed Seed for the RandomGenerator.
    * @param density_grid DensityGrid through which photons are propagated.
    * @param numphoton Total number of photons to propagate through the grid.
-   * @param image CCDImage to construct (threads will update a copy of this
-   * image).
-   * @param jobsize Number of photons to shoot during a single
+   * @param images CCDImages to construct, one per observer (threads will
+   * update a copy of these images).
+   * @param jobsize Minimum number of photons to shoot during a single
    * DustPhotonShootJob.
    * @param worksize Number of threads used in the calculation.
    */
@@ -80,15 +78,16 @@ public:
                                   int_fast32_t random_seed,
                                   DensityGrid &density_grid,
                                   uint_fast64_t numphoton,
-                                  const CCDImage &image, uint_fast64_t jobsize,
-                                  int_fast32_t worksize)
-      : _worksize(worksize), _numphoton(numphoton), _jobsize(jobsize) {
+                                  const std::vector< CCDImage > &images,
+                                  uint_fast64_t jobsize, int_fast32_t worksize)
+      : _worksize(worksize), _numphoton(numphoton),
+        _scheduler(1.e-3, jobsize, jobsize) {
 
     // create a separate RandomGenerator for each thread.
     // create a single PhotonShootJob for each thread.
     for (int_fast32_t i = 0; i < _worksize; ++i) {
       _jobs[i] = new DustPhotonShootJob(photon_source, dust_scattering,
-                                        random_seed + i, density_grid, image);
+                                        random_seed + i, density_grid, images);
     }
   }
 
@@ -107,9 +106,14 @@ public:
    * @brief Set the number of parallel threads that will be used to execute
    * the jobs.
    *
+   * This distributes the photons over the per thread queues of the
+   * WorkStealingScheduler.
+   *
    * @param worksize Number of parallel threads that will be used.
    */
-  inline void set_worksize(int_fast32_t worksize) {}
+  inline void set_worksize(int_fast32_t worksize) {
+    _scheduler.reset(0, _numphoton, worksize);
+  }
 
   /**
    * @brief Set the number of photons.
@@ -122,13 +126,13 @@ public:
   inline void set_numphoton(uint_fast64_t numphoton) { _numphoton = numphoton; }
 
   /**
-   * @brief Update the given CCDImage.
+   * @brief Update the given CCDImages with the contributions of all threads.
    *
-   * @param image CCDImage to update.
+   * @param images CCDImages to update (one per observer).
    */
-  inline void update_image(CCDImage &image) {
+  inline void update_images(std::vector< CCDImage > &images) {
     for (int_fast32_t i = 0; i < _worksize; ++i) {
-      _jobs[i]->update_image(image);
+      _jobs[i]->update_images(images);
     }
   }
 
@@ -140,15 +144,9 @@ public:
    * @return DustPhotonShootJob.
    */
   inline DustPhotonShootJob *get_job(int_fast32_t thread_id) {
-    uint_fast64_t jobsize = std::max(_numphoton / (10 * _worksize), _jobsize);
-    _lock.lock();
-    if (jobsize >= _numphoton) {
-      jobsize = _numphoton;
-    }
-    _numphoton -= jobsize;
-    _lock.unlock();
-    if (jobsize > 0) {
-      _jobs[thread_id]->set_numphoton(jobsize);
+    uint_fast64_t begin, end;
+    if (_scheduler.get_chunk(thread_id, begin, end)) {
+      _jobs[thread_id]->set_numphoton(end - begin);
       return _jobs[thread_id];
     } else {
       return nullptr;
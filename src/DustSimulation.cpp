@@ -48,14 +48,22 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 /**
  * @brief Perform a dusty radiative transfer simulation.
  *
  * This method reads the following parameters from the parameter file:
- *  - random seed: Seed for the random number generator (default: 42)
+ *  - random seed: Seed for the random number generator (default: 42). The
+ *    dust photons always use the ranlxd2 generator (one random sequence per
+ *    thread), so that the result depends on the number of threads and
+ *    processes.
  *  - output folder: Folder where all output files will be placed (default: .)
  *  - number of photons: Number of photons to use (default: 5e5)
+ *  - number of observers: Number of observers for which a CCDImage is made
+ *    during the same Monte Carlo run. If 0, a single observer is set up from
+ *    the CCDImage parameters; if larger than 0, the viewing angles of observer
+ *    i are read from the CCDImage:observer[i] block (default: 0)
  *
  * @param parser CommandLineParser that contains the parsed command line
  * arguments.
@@ -99,7 +107,16 @@ int DustSimulation::do_simulation(CommandLineParser &parser, bool write_output,
   // set up output
   std::string output_folder = Utilities::get_absolute_path(
       params.get_value< std::string >("DustSimulation:output folder", "."));
-  CCDImage dust_image(output_folder, params, log);
+  const uint_fast32_t numobserver = params.get_value< uint_fast32_t >(
+      "DustSimulation:number of observers", 0);
+  std::vector< CCDImage > dust_images;
+  if (numobserver == 0) {
+    dust_images.push_back(CCDImage(output_folder, params, log));
+  } else {
+    for (uint_fast32_t i = 0; i < numobserver; ++i) {
+      dust_images.push_back(CCDImage(i, output_folder, params, log));
+    }
+  }
 
   uint_fast64_t numphoton = params.get_value< uint_fast64_t >(
       "DustSimulation:number of photons", 5e5);
@@ -149,7 +166,8 @@ int DustSimulation::do_simulation(CommandLineParser &parser, bool write_output,
                       " for photon shooting.");
   }
   DustPhotonShootJobMarket dustphotonshootjobs(
-      source, dust_scattering, random_seed, grid, 0, dust_image, 100, worksize);
+      source, dust_scattering, random_seed, grid, 0, dust_images, 100,
+      worksize);
 
   if (log) {
     log->write_status("Start shooting ", numphoton, " photons...");
@@ -159,18 +177,20 @@ int DustSimulation::do_simulation(CommandLineParser &parser, bool write_output,
   worktimer.start();
   dust_workdistributor.do_in_parallel(dustphotonshootjobs);
   worktimer.stop();
-  dustphotonshootjobs.update_image(dust_image);
+  dustphotonshootjobs.update_images(dust_images);
 
   if (log) {
     log->write_status("Done shooting photons.");
   }
 
   if (log) {
-    log->write_status("Saving final image...");
+    log->write_status("Saving final image(s)...");
+  }
+  for (size_t i = 0; i < dust_images.size(); ++i) {
+    dust_images[i].save(1. / numphoton);
   }
-  dust_image.save(1. / numphoton);
   if (log) {
-    log->write_status("Done saving image.");
+    log->write_status("Done saving image(s).");
   }
 
   programtimer.stop();
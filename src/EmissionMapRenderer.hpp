@@ -0,0 +1,602 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file EmissionMapRenderer.hpp
+ *
+ * @brief Shared memory parallel renderer for line emission maps.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef EMISSIONMAPRENDERER_HPP
+#define EMISSIONMAPRENDERER_HPP
+
+#include "Box.hpp"
+#include "CoordinateVector.hpp"
+#include "DensityGrid.hpp"
+#include "EmissivityValues.hpp"
+#include "Error.hpp"
+#include "Lock.hpp"
+#include "Log.hpp"
+#include "ParameterFile.hpp"
+#include "Utilities.hpp"
+#include "WorkDistributor.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*! @brief Fraction of the length of a ray inside the grid box with which the
+ *  ray origin is moved into the box, to make sure it is not on the box
+ *  boundary. */
+#define EMISSIONMAPRENDERER_EPSILON 1.e-10
+
+/**
+ * @brief Shared memory parallel renderer for line emission maps.
+ *
+ * The renderer traces one ray per pixel through a DensityGrid with
+ * precomputed emissivities (see EmissivityCalculator), and accumulates the
+ * emission for all requested lines along that ray at once. The rays are
+ * distributed over the available threads using a WorkDistributor.
+ *
+ * The viewing direction and the image plane use the same conventions as the
+ * CCDImage: the observer is located in the direction
+ * @f$(\sin(\theta{})\cos(\phi{}), \sin(\theta{})\sin(\phi{}),
+ * \cos(\theta{}))@f$, and the image plane is spanned by the unit vectors
+ * @f$(-\sin(\phi{}), \cos(\phi{}), 0)@f$ and @f$(-\cos(\theta{})\cos(\phi{}),
+ * -\cos(\theta{})\sin(\phi{}), \sin(\theta{}))@f$. If no image box is given,
+ * the image box is set to the projection of the grid box onto the image plane.
+ *
+ * Pixel (ix, iy) of the image for line i is stored in element
+ * ix * (image height) + iy of image i.
+ */
+class EmissionMapRenderer {
+private:
+  /*! @brief Direction of the rays (towards the observer). */
+  const CoordinateVector<> _direction;
+
+  /*! @brief Unit vector along the x axis of the image plane. */
+  const CoordinateVector<> _image_x_axis;
+
+  /*! @brief Unit vector along the y axis of the image plane. */
+  const CoordinateVector<> _image_y_axis;
+
+  /*! @brief Resolution of the images. */
+  const uint_fast32_t _resolution[2];
+
+  /*! @brief Lower left corner of the image box (in m). */
+  double _anchor[2];
+
+  /*! @brief Side lengths of the image box (in m). If these are not positive,
+   *  the image box is fitted to the grid box. */
+  double _sides[2];
+
+  /*! @brief Flag indicating whether the image box should be fitted to the grid
+   *  box. */
+  const bool _fit_image_box;
+
+  /*! @brief Lines to render. */
+  const std::vector< EmissionLine > _lines;
+
+  /*! @brief Images, one for every line. */
+  std::vector< std::vector< double > > _images;
+
+  /*! @brief Prefix for the names of the output files. */
+  const std::string _prefix;
+
+  /*! @brief Folder where the output files are written. */
+  const std::string _output_folder;
+
+  /*! @brief Number of threads to use (-1 means all available threads). */
+  const int_fast32_t _worksize;
+
+  /*! @brief Log to write logging info to. */
+  Log *_log;
+
+  /**
+   * @brief Convert the given comma separated list of line names into a list
+   * of EmissionLines.
+   *
+   * @param names List of line names, of the form "[name1, name2, ...]" (the
+   * brackets are optional).
+   * @return Corresponding EmissionLines.
+   */
+  inline static std::vector< EmissionLine >
+  get_lines(const std::string names) {
+    std::vector< EmissionLine > lines;
+    size_t begin = names.find('[');
+    begin = (begin == std::string::npos) ? 0 : begin + 1;
+    size_t end = names.find(']');
+    end = (end == std::string::npos) ? names.size() : end;
+    while (begin < end) {
+      size_t next = std::min(names.find(',', begin), end);
+      size_t first = begin;
+      size_t last = next;
+      while (first < last && names[first] == ' ') {
+        ++first;
+      }
+      while (last > first && names[last - 1] == ' ') {
+        --last;
+      }
+      if (last > first) {
+        lines.push_back(
+            EmissivityValues::get_line(names.substr(first, last - first)));
+      }
+      begin = next + 1;
+    }
+    return lines;
+  }
+
+  /**
+   * @brief Set the image box to the projection of the given grid box onto the
+   * image plane.
+   *
+   * @param box Grid box (in m).
+   */
+  inline void fit_image_box(const Box<> &box) {
+    double min_x = DBL_MAX;
+    double max_x = -DBL_MAX;
+    double min_y = DBL_MAX;
+    double max_y = -DBL_MAX;
+    for (uint_fast8_t i = 0; i < 8; ++i) {
+      const CoordinateVector<> corner(
+          box.get_anchor().x() + ((i & 1) ? box.get_sides().x() : 0.),
+          box.get_anchor().y() + ((i & 2) ? box.get_sides().y() : 0.),
+          box.get_anchor().z() + ((i & 4) ? box.get_sides().z() : 0.));
+      const double x = CoordinateVector<>::dot_product(corner, _image_x_axis);
+      const double y = CoordinateVector<>::dot_product(corner, _image_y_axis);
+      min_x = std::min(min_x, x);
+      max_x = std::max(max_x, x);
+      min_y = std::min(min_y, y);
+      max_y = std::max(max_y, y);
+    }
+    _anchor[0] = min_x;
+    _anchor[1] = min_y;
+    _sides[0] = max_x - min_x;
+    _sides[1] = max_y - min_y;
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param theta Viewing angle @f$\theta{}@f$ (in radians).
+   * @param phi Viewing angle @f$\phi{}@f$ (in radians).
+   * @param resolution_x Number of pixels in the horizontal direction.
+   * @param resolution_y Number of pixels in the vertical direction.
+   * @param anchor_x Horizontal position of the lower left corner of the image
+   * box (in m).
+   * @param anchor_y Vertical position of the lower left corner of the image
+   * box (in m).
+   * @param sides_x Horizontal side length of the image box (in m). If this
+   * value (or sides_y) is not positive, the image box is fitted to the grid.
+   * @param sides_y Vertical side length of the image box (in m).
+   * @param lines Lines to render.
+   * @param prefix Prefix for the names of the output files.
+   * @param output_folder Folder where the output files are written.
+   * @param worksize Number of threads to use (-1 means all available threads).
+   * @param log Log to write logging info to.
+   */
+  inline EmissionMapRenderer(const double theta, const double phi,
+                             const uint_fast32_t resolution_x,
+                             const uint_fast32_t resolution_y,
+                             const double anchor_x, const double anchor_y,
+                             const double sides_x, const double sides_y,
+                             const std::vector< EmissionLine > &lines,
+                             const std::string prefix = "emission_map_",
+                             const std::string output_folder = ".",
+                             const int_fast32_t worksize = -1,
+                             Log *log = nullptr)
+      : _direction(std::sin(theta) * std::cos(phi),
+                   std::sin(theta) * std::sin(phi), std::cos(theta)),
+        _image_x_axis(-std::sin(phi), std::cos(phi), 0.),
+        _image_y_axis(-std::cos(theta) * std::cos(phi),
+                      -std::cos(theta) * std::sin(phi), std::sin(theta)),
+        _resolution{resolution_x, resolution_y}, _anchor{anchor_x, anchor_y},
+        _sides{sides_x, sides_y},
+        _fit_image_box(sides_x <= 0. || sides_y <= 0.),
+        _lines(lines), _prefix(prefix),
+        _output_folder(Utilities::get_absolute_path(output_folder)),
+        _worksize(worksize), _log(log) {
+
+    if (_resolution[0] == 0 || _resolution[1] == 0) {
+      cmac_error("Emission map resolution cannot be zero!");
+    }
+
+    _images.resize(_lines.size());
+
+    if (_log) {
+      _log->write_status("Created EmissionMapRenderer for ", _lines.size(),
+                         " lines, with a resolution of ", _resolution[0], "x",
+                         _resolution[1], " and a viewing angle of (", theta,
+                         ", ", phi, ").");
+    }
+  }
+
+  /**
+   * @brief ParameterFile constructor.
+   *
+   * Parameters are:
+   *  - view theta: Viewing angle @f$\theta{}@f$ (default: 90. degrees)
+   *  - view phi: Viewing angle @f$\phi{}@f$ (default: 0. degrees)
+   *  - image width: Number of pixels in the horizontal direction (default: 200)
+   *  - image height: Number of pixels in the vertical direction (default: 200)
+   *  - anchor x: Horizontal position of the lower left corner of the image box
+   *    (default: 0. m)
+   *  - anchor y: Vertical position of the lower left corner of the image box
+   *    (default: 0. m)
+   *  - sides x: Horizontal side length of the image box (default: -1. m: fit
+   *    the image box to the grid)
+   *  - sides y: Vertical side length of the image box (default: -1. m: fit the
+   *    image box to the grid)
+   *  - lines: Comma separated list of lines to render (default: [Halpha])
+   *  - prefix: Prefix for the names of the output files (default:
+   *    emission_map_)
+   *
+   * @param output_folder Folder where the output files are written.
+   * @param params ParameterFile to read from.
+   * @param worksize Number of threads to use (-1 means all available threads).
+   * @param log Log to write logging info to.
+   */
+  inline EmissionMapRenderer(const std::string output_folder,
+                             ParameterFile &params,
+                             const int_fast32_t worksize = -1,
+                             Log *log = nullptr)
+      : EmissionMapRenderer(
+            params.get_physical_value< QUANTITY_ANGLE >(
+                "EmissionMapRenderer:view theta", "90. degrees"),
+            params.get_physical_value< QUANTITY_ANGLE >(
+                "EmissionMapRenderer:view phi", "0. degrees"),
+            params.get_value< uint_fast32_t >("EmissionMapRenderer:image width",
+                                              200),
+            params.get_value< uint_fast32_t >(
+                "EmissionMapRenderer:image height", 200),
+            params.get_physical_value< QUANTITY_LENGTH >(
+                "EmissionMapRenderer:anchor x", "0. m"),
+            params.get_physical_value< QUANTITY_LENGTH >(
+                "EmissionMapRenderer:anchor y", "0. m"),
+            params.get_physical_value< QUANTITY_LENGTH >(
+                "EmissionMapRenderer:sides x", "-1. m"),
+            params.get_physical_value< QUANTITY_LENGTH >(
+                "EmissionMapRenderer:sides y", "-1. m"),
+            get_lines(params.get_value< std::string >(
+                "EmissionMapRenderer:lines", "[Halpha]")),
+            params.get_value< std::string >("EmissionMapRenderer:prefix",
+                                            "emission_map_"),
+            output_folder, worksize, log) {}
+
+  /**
+   * @brief Get the origin of the ray through the given pixel.
+   *
+   * @param pixel_index Index of the pixel.
+   * @param box Grid box (in m).
+   * @param origin Variable to store the origin in (in m). The origin is the
+   * point where the ray enters the grid box.
+   * @return True if the ray intersects the grid box.
+   */
+  inline bool get_ray_origin(const size_t pixel_index, const Box<> &box,
+                             CoordinateVector<> &origin) const {
+
+    const uint_fast32_t ix = pixel_index / _resolution[1];
+    const uint_fast32_t iy = pixel_index % _resolution[1];
+    const double x = _anchor[0] + (ix + 0.5) * _sides[0] / _resolution[0];
+    const double y = _anchor[1] + (iy + 0.5) * _sides[1] / _resolution[1];
+    const CoordinateVector<> point = x * _image_x_axis + y * _image_y_axis;
+
+    // find the part of the line through the pixel that lies inside the box
+    double tmin = -DBL_MAX;
+    double tmax = DBL_MAX;
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+      const double box_min = box.get_anchor()[i];
+      const double box_max = box_min + box.get_sides()[i];
+      if (_direction[i] != 0.) {
+        double t1 = (box_min - point[i]) / _direction[i];
+        double t2 = (box_max - point[i]) / _direction[i];
+        if (t1 > t2) {
+          std::swap(t1, t2);
+        }
+        tmin = std::max(tmin, t1);
+        tmax = std::min(tmax, t2);
+      } else if (point[i] < box_min || point[i] > box_max) {
+        return false;
+      }
+    }
+    if (tmin >= tmax) {
+      return false;
+    }
+
+    origin = point + (tmin + EMISSIONMAPRENDERER_EPSILON * (tmax - tmin)) *
+                         _direction;
+    return true;
+  }
+
+  /**
+   * @brief Render the given pixel.
+   *
+   * This method can be called by multiple threads simultaneously, as long as
+   * they render different pixels.
+   *
+   * @param grid DensityGrid to render.
+   * @param pixel_index Index of the pixel.
+   * @param emissions Buffer to use to store the emission for all lines. Should
+   * have the same size as the number of lines.
+   */
+  inline void render_pixel(DensityGrid &grid, const size_t pixel_index,
+                           double *emissions) {
+
+    CoordinateVector<> origin;
+    if (get_ray_origin(pixel_index, grid.get_box(), origin)) {
+      grid.get_total_emissions(origin, _direction, _lines, emissions);
+    } else {
+      for (size_t iline = 0; iline < _lines.size(); ++iline) {
+        emissions[iline] = 0.;
+      }
+    }
+    for (size_t iline = 0; iline < _lines.size(); ++iline) {
+      _images[iline][pixel_index] = emissions[iline];
+    }
+  }
+
+  /**
+   * @brief Get the number of lines that are rendered.
+   *
+   * @return Number of lines.
+   */
+  inline size_t get_number_of_lines() const { return _lines.size(); }
+
+  /**
+   * @brief Get the line with the given index.
+   *
+   * @param iline Index of a line.
+   * @return Corresponding EmissionLine.
+   */
+  inline EmissionLine get_line(const size_t iline) const {
+    return _lines[iline];
+  }
+
+  /**
+   * @brief Get the resolution of the images in the given direction.
+   *
+   * @param i Direction (0 for horizontal, 1 for vertical).
+   * @return Number of pixels in that direction.
+   */
+  inline uint_fast32_t get_resolution(const uint_fast8_t i) const {
+    return _resolution[i];
+  }
+
+  /**
+   * @brief Get the total number of pixels in an image.
+   *
+   * @return Number of pixels.
+   */
+  inline size_t get_number_of_pixels() const {
+    return static_cast< size_t >(_resolution[0]) * _resolution[1];
+  }
+
+  /**
+   * @brief Get the image for the line with the given index.
+   *
+   * @param iline Index of a line.
+   * @return Corresponding image (in J m^-2 s^-1).
+   */
+  inline const std::vector< double > &get_image(const size_t iline) const {
+    return _images[iline];
+  }
+
+  /**
+   * @brief Get the value of the given pixel in the image for the given line.
+   *
+   * @param iline Index of a line.
+   * @param ix Horizontal index of the pixel.
+   * @param iy Vertical index of the pixel.
+   * @return Value of the pixel (in J m^-2 s^-1).
+   */
+  inline double get_pixel(const size_t iline, const uint_fast32_t ix,
+                          const uint_fast32_t iy) const {
+    return _images[iline][ix * _resolution[1] + iy];
+  }
+
+  /**
+   * @brief Save the images as binary arrays, one file per line.
+   *
+   * The files are named (prefix)(line name).dat and contain the pixel values
+   * in the same layout as the images.
+   */
+  inline void save() const {
+    for (size_t iline = 0; iline < _lines.size(); ++iline) {
+      const std::string filename = _output_folder + "/" + _prefix +
+                                   EmissivityValues::get_name(_lines[iline]) +
+                                   ".dat";
+      std::ofstream array_file(filename, std::ios::binary);
+      array_file.write(reinterpret_cast< const char * >(_images[iline].data()),
+                       _images[iline].size() * sizeof(double));
+      array_file.close();
+      if (_log) {
+        _log->write_status("Wrote emission map \"", filename, "\".");
+      }
+    }
+  }
+
+  /**
+   * @brief Job that renders a contiguous range of pixels.
+   */
+  class EmissionMapRenderJob {
+  private:
+    /*! @brief EmissionMapRenderer that owns the images. */
+    EmissionMapRenderer &_renderer;
+
+    /*! @brief DensityGrid to render. */
+    DensityGrid &_grid;
+
+    /*! @brief Index of the first pixel to render. */
+    const size_t _first_pixel;
+
+    /*! @brief Index beyond the last pixel to render. */
+    const size_t _last_pixel;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param renderer EmissionMapRenderer that owns the images.
+     * @param grid DensityGrid to render.
+     * @param first_pixel Index of the first pixel to render.
+     * @param last_pixel Index beyond the last pixel to render.
+     */
+    inline EmissionMapRenderJob(EmissionMapRenderer &renderer,
+                                DensityGrid &grid, const size_t first_pixel,
+                                const size_t last_pixel)
+        : _renderer(renderer), _grid(grid), _first_pixel(first_pixel),
+          _last_pixel(last_pixel) {}
+
+    /**
+     * @brief Should the Job be deleted by the Worker when it is finished?
+     *
+     * @return True, since the Job is created by the job market for every
+     * range of pixels.
+     */
+    inline bool do_cleanup() const { return true; }
+
+    /**
+     * @brief Render the pixels.
+     */
+    inline void execute() {
+      std::vector< double > emissions(_renderer._lines.size());
+      for (size_t i = _first_pixel; i < _last_pixel; ++i) {
+        _renderer.render_pixel(_grid, i, emissions.data());
+      }
+    }
+
+    /**
+     * @brief Get a name tag for this job.
+     *
+     * @return "emission_map_render".
+     */
+    inline std::string get_tag() const { return "emission_map_render"; }
+  };
+
+  /**
+   * @brief JobMarket that hands out ranges of pixels to render.
+   */
+  class EmissionMapRenderJobMarket {
+  private:
+    /*! @brief EmissionMapRenderer that owns the images. */
+    EmissionMapRenderer &_renderer;
+
+    /*! @brief DensityGrid to render. */
+    DensityGrid &_grid;
+
+    /*! @brief Index of the next pixel that should be rendered. */
+    size_t _next_pixel;
+
+    /*! @brief Number of pixels per job. */
+    const size_t _jobsize;
+
+    /*! @brief Lock used to ensure safe access to the pixel counter. */
+    Lock _lock;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param renderer EmissionMapRenderer that owns the images.
+     * @param grid DensityGrid to render.
+     */
+    inline EmissionMapRenderJobMarket(EmissionMapRenderer &renderer,
+                                      DensityGrid &grid)
+        : _renderer(renderer), _grid(grid), _next_pixel(0),
+          _jobsize(renderer._resolution[1]) {}
+
+    /**
+     * @brief Set the number of parallel threads that will be used to execute
+     * the jobs.
+     *
+     * @param worksize Number of parallel threads that will be used.
+     */
+    inline void set_worksize(int_fast32_t worksize) {}
+
+    /**
+     * @brief Get a job that renders the next column of pixels.
+     *
+     * @param thread_id Rank of the thread that wants a job.
+     * @return Pointer to a job, or a nullptr if all pixels have been handed
+     * out.
+     */
+    inline EmissionMapRenderJob *get_job(int_fast32_t thread_id) {
+      const size_t numpixel = _renderer.get_number_of_pixels();
+      _lock.lock();
+      const size_t first_pixel = _next_pixel;
+      _next_pixel = std::min(_next_pixel + _jobsize, numpixel);
+      const size_t last_pixel = _next_pixel;
+      _lock.unlock();
+      if (first_pixel < last_pixel) {
+        return new EmissionMapRenderJob(_renderer, _grid, first_pixel,
+                                        last_pixel);
+      } else {
+        return nullptr;
+      }
+    }
+  };
+
+  /**
+   * @brief Render the emission maps for the given DensityGrid.
+   *
+   * The emissivities of the grid should have been computed before calling
+   * this method (see EmissivityCalculator::calculate_emissivities()).
+   *
+   * @param grid DensityGrid to render.
+   */
+  inline void render(DensityGrid &grid) {
+
+    if (grid.get_number_of_cells() > 0 &&
+        grid.begin().get_emissivities() == nullptr) {
+      cmac_error("Emissivities need to be computed before emission maps can "
+                 "be rendered!");
+    }
+
+    if (_fit_image_box) {
+      fit_image_box(grid.get_box());
+    }
+
+    const size_t numpixel = get_number_of_pixels();
+    for (size_t iline = 0; iline < _lines.size(); ++iline) {
+      _images[iline].assign(numpixel, 0.);
+    }
+
+    WorkDistributor< EmissionMapRenderJobMarket, EmissionMapRenderJob >
+        workdistributor(_worksize);
+    EmissionMapRenderJobMarket jobs(*this, grid);
+
+    if (_log) {
+      _log->write_status("Rendering ", _lines.size(), " emission maps using ",
+                         workdistributor.get_worksize_string(), "...");
+    }
+
+    workdistributor.do_in_parallel(jobs);
+
+    if (_log) {
+      _log->write_status("Done rendering emission maps.");
+    }
+  }
+};
+
+#endif // EMISSIONMAPRENDERER_HPP
@@ -128,7 +128,7 @@ void EmissivityCalculator::get_balmer_jump_emission(
  * @return EmissivityValues in the cell.
  */
 EmissivityValues EmissivityCalculator::calculate_emissivities(
-    const IonizationVariables &ionization_variables,
+    const IonizationVariablesReference &ionization_variables,
     const Abundances &abundances,
     const LineCoolingData &line_cooling_data) const {
 
@@ -83,10 +83,10 @@ public:
                                 double &emission_helium_high,
                                 double &emission_helium_low) const;
 
-  EmissivityValues
-  calculate_emissivities(const IonizationVariables &ionization_variables,
-                         const Abundances &abundances,
-                         const LineCoolingData &line_cooling_data) const;
+  EmissivityValues calculate_emissivities(
+      const IonizationVariablesReference &ionization_variables,
+      const Abundances &abundances,
+      const LineCoolingData &line_cooling_data) const;
 
   void calculate_emissivities(DensityGrid &grid) const;
   std::vector< EmissivityValues > get_emissivities(DensityGrid &grid) const;
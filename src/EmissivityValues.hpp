@@ -199,6 +199,24 @@ public:
       return "";
     }
   }
+
+  /**
+   * @brief Get the EmissionLine corresponding to the given std::string
+   * representation.
+   *
+   * @param name Name of an EmissionLine, as returned by get_name().
+   * @return Corresponding EmissionLine.
+   */
+  static inline EmissionLine get_line(const std::string name) {
+    for (int_fast32_t i = 0; i < NUMBER_OF_EMISSIONLINES; ++i) {
+      const EmissionLine line = static_cast< EmissionLine >(i);
+      if (get_name(line) == name) {
+        return line;
+      }
+    }
+    cmac_error("Unknown emission line name: %s!", name.c_str());
+    return NUMBER_OF_EMISSIONLINES;
+  }
 };
 
 #endif // EMISSIVITYVALUES_HPP
@@ -35,6 +35,7 @@
 #include "ParameterFile.hpp"
 #include "RandomGenerator.hpp"
 #include "WorkDistributor.hpp"
+#include "WorkStealingScheduler.hpp"
 
 #include <iostream>
 #include <vector>
@@ -213,14 +214,13 @@ private:
     /*! @brief Per thread FractalDensityMaskConstructionJob. */
     std::vector< FractalDensityMaskConstructionJob * > _jobs;
 
-    /*! @brief Current index on the first level. */
-    uint_fast32_t _current_index;
-
     /*! @brief Total number of particles on the first level. */
     const uint_fast32_t _num_part;
 
-    /*! @brief Lock used to ensure safe access to the internal index counter. */
-    Lock _lock;
+    /*! @brief Scheduler that distributes the first level blocks over the
+     *  threads. Every first level block is expensive, so every job only
+     *  constructs a single block. */
+    WorkStealingScheduler _scheduler;
 
   public:
     /**
@@ -231,7 +231,7 @@ private:
      */
     inline FractalDensityMaskConstructionJobMarket(FractalDensityMask &mask,
                                                    int_fast32_t worksize)
-        : _current_index(0), _num_part(mask._N) {
+        : _num_part(mask._N), _scheduler(1.e-3, 1, 1, 1) {
 
       _jobs.reserve(worksize);
       for (int_fast32_t i = 0; i < worksize; ++i) {
@@ -245,7 +245,10 @@ private:
      *
      * @param worksize Number of parallel threads that will be used.
      */
-    inline void set_worksize(int_fast32_t worksize) {}
+    inline void set_worksize(int_fast32_t worksize) {
+      // the first level blocks that are constructed start from index 1
+      _scheduler.reset(1, std::max(_num_part, uint_fast32_t(1)), worksize);
+    }
 
     /**
      * @brief Destructor.
@@ -268,24 +271,9 @@ private:
      */
     inline FractalDensityMaskConstructionJob *get_job(int_fast32_t thread_id) {
 
-      if (_current_index == _num_part) {
-        return nullptr;
-      }
-      bool has_job = false;
-      uint_fast32_t current_index = 0;
-      // we can only change _current_index if the lock is locked
-      // similarly, we can only take decision based on the value of
-      // _current_index while the lock is locked (because otherwise another
-      // thread might invalidate the decision we take, while we take it)
-      _lock.lock();
-      ++_current_index;
-      if (_current_index < _num_part) {
-        has_job = true;
-        current_index = _current_index;
-      }
-      _lock.unlock();
-      if (has_job) {
-        _jobs[thread_id]->set_index(current_index);
+      uint_fast64_t begin, end;
+      if (_scheduler.get_chunk(thread_id, begin, end)) {
+        _jobs[thread_id]->set_index(begin);
         return _jobs[thread_id];
       } else {
         return nullptr;
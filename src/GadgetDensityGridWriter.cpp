@@ -34,76 +34,270 @@
 #include "Log.hpp"
 #include "ParameterFile.hpp"
 #include "Utilities.hpp"
+#include <memory>
 #include <vector>
 
+
 /**
- * @brief Constructor.
- *
- * @param prefix Prefix for the name of the file to write.
- * @param output_folder Name of the folder where output files should be placed.
- * @param log Log to write logging information to.
- * @param padding Number of digits used for the counter in the filenames.
+ * @brief Copy of the general snapshot information that is written to the
+ * header groups of a snapshot file.
  */
-GadgetDensityGridWriter::GadgetDensityGridWriter(std::string prefix,
-                                                 std::string output_folder,
-                                                 Log *log, uint_fast8_t padding)
-    : DensityGridWriter(output_folder, log), _prefix(prefix),
-      _padding(padding) {
+class GadgetSnapshotHeader {
+public:
+  /*! @brief Name of the snapshot file. */
+  std::string _filename;
 
-  // turn off default HDF5 error handling: we catch errors ourselves
-  HDF5Tools::initialize();
-  if (_log) {
-    _log->write_status("Set up GadgetDensityGridWriter with prefix \"", _prefix,
-                       "\".");
+  /*! @brief Side lengths of the grid box (in m). */
+  CoordinateVector<> _box_sides;
+
+  /*! @brief Number of cells in the grid. */
+  uint32_t _number_of_cells;
+
+  /*! @brief Does the grid contain hydro variables? */
+  bool _has_hydro;
+
+  /*! @brief Value of the counter appended to the file name. */
+  uint32_t _iteration;
+
+  /*! @brief Simulation time (in s). */
+  double _time;
+
+  /*! @brief Time stamp of the snapshot. */
+  std::string _timestamp;
+
+  /*! @brief Run parameters (key-value pairs). */
+  std::vector< std::pair< std::string, std::string > > _parameters;
+
+  /**
+   * @brief Constructor.
+   *
+   * @param filename Name of the snapshot file.
+   * @param grid DensityGrid that is written out.
+   * @param iteration Value of the counter appended to the file name.
+   * @param params ParameterFile containing the run parameters.
+   * @param time Simulation time (in s).
+   */
+  GadgetSnapshotHeader(const std::string filename, DensityGrid &grid,
+                       const uint_fast32_t iteration, ParameterFile &params,
+                       const double time)
+      : _filename(filename), _box_sides(grid.get_box().get_sides()),
+        _number_of_cells(grid.get_number_of_cells()),
+        _has_hydro(grid.has_hydro()), _iteration(iteration), _time(time),
+        _timestamp(Utilities::get_timestamp()) {
+
+    for (auto it = params.begin(); it != params.end(); ++it) {
+      _parameters.push_back(std::make_pair(it.get_key(), it.get_value()));
+    }
   }
-}
+};
 
 /**
- * @brief ParameterFile constructor.
- *
- * Parameters are:
- *  - prefix: Prefix to prepend to all snapshot file names (default: snapshot)
- *  - padding: Number of digits to use in the output file names (default: 3)
- *
- * @param output_folder Name of the folder where output files should be placed.
- * @param params ParameterFile to read.
- * @param log Log to write logging information to.
+ * @brief Copy of the cell variables that are written to a snapshot file, for a
+ * contiguous block of cells.
  */
-GadgetDensityGridWriter::GadgetDensityGridWriter(std::string output_folder,
-                                                 ParameterFile &params,
-                                                 Log *log)
-    : GadgetDensityGridWriter(
-          params.get_value< std::string >("DensityGridWriter:prefix",
-                                          "snapshot"),
-          output_folder, log,
-          params.get_value< uint_fast8_t >("DensityGridWriter:padding", 3)) {}
+class GadgetSnapshotBlock {
+public:
+  /*! @brief Index of the first cell in the block. */
+  uint_fast32_t _offset;
 
-/**
- * @brief Write the file.
- *
- * @param grid DensityGrid to write out.
- * @param iteration Value of the counter to append to the filename.
- * @param params ParameterFile containing the run parameters that should be
- * written to the file.
- * @param time Simulation time (in s).
- */
-void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
-                                    ParameterFile &params, double time) {
+  /*! @brief Cell midpoints, relative to the box anchor (in m). */
+  std::vector< CoordinateVector<> > _coordinates;
 
-  std::string filename = Utilities::compose_filename(
-      _output_folder, _prefix, "hdf5", iteration, _padding);
+  /*! @brief Number densities (in m^-3). */
+  std::vector< double > _number_densities;
 
-  if (_log) {
-    _log->write_status("Writing file \"", filename, "\".");
+  /*! @brief Temperatures (in K). */
+  std::vector< double > _temperatures;
+
+  /*! @brief Ionic fractions. */
+  std::vector< std::vector< double > > _ionic_fractions;
+
+#ifdef DO_OUTPUT_COOLING
+  /*! @brief Cooling rates. */
+  std::vector< std::vector< double > > _cooling;
+#endif
+
+#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
+  /*! @brief Photoionization rates. */
+  std::vector< std::vector< double > > _photoionization_rates;
+#endif
+
+#ifdef DO_OUTPUT_HEATING
+  /*! @brief Heating rates. */
+  std::vector< std::vector< double > > _heating;
+#endif
+
+  /*! @brief Hydrodynamical densities (in kg m^-3). */
+  std::vector< double > _densities;
+
+  /*! @brief Hydrodynamical velocities (in m s^-1). */
+  std::vector< CoordinateVector<> > _velocities;
+
+  /*! @brief Hydrodynamical pressures (in kg m^-1 s^-2). */
+  std::vector< double > _pressures;
+
+  /*! @brief Hydrodynamical masses (in kg). */
+  std::vector< double > _masses;
+
+  /*! @brief Hydrodynamical total energies (in kg m^2 s^-2). */
+  std::vector< double > _total_energies;
+
+  /**
+   * @brief Copy the variables of the given block of cells.
+   *
+   * @param grid DensityGrid to copy from.
+   * @param offset Index of the first cell in the block.
+   * @param upper_limit Index of the first cell that is no longer part of the
+   * block.
+   */
+  inline void fill(DensityGrid &grid, const uint_fast32_t offset,
+                   const uint_fast32_t upper_limit) {
+
+    _offset = offset;
+    const uint_fast32_t blocksize = upper_limit - offset;
+    const CoordinateVector<> anchor = grid.get_box().get_anchor();
+
+    _coordinates.resize(blocksize);
+    _number_densities.resize(blocksize);
+    _temperatures.resize(blocksize);
+    // the inner vectors need to be reallocated explicitly, since resizing the
+    // outer vector does not change the size of the existing elements
+    _ionic_fractions.assign(NUMBER_OF_IONNAMES,
+                            std::vector< double >(blocksize));
+#ifdef DO_OUTPUT_COOLING
+    _cooling.assign(NUMBER_OF_IONNAMES, std::vector< double >(blocksize));
+#endif
+#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
+    _photoionization_rates.assign(NUMBER_OF_IONNAMES,
+                                  std::vector< double >(blocksize));
+#endif
+#ifdef DO_OUTPUT_HEATING
+    _heating.assign(NUMBER_OF_HEATINGTERMS, std::vector< double >(blocksize));
+#endif
+    size_t index = 0;
+    for (auto it = grid.begin() + offset; it != grid.begin() + upper_limit;
+         ++it) {
+      _coordinates[index] = it.get_cell_midpoint() - anchor;
+
+      const IonizationVariablesReference ionization_variables =
+          it.get_ionization_variables();
+
+      _number_densities[index] = ionization_variables.get_number_density();
+      _temperatures[index] = ionization_variables.get_temperature();
+      for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+        const IonName ion = static_cast< IonName >(i);
+        _ionic_fractions[i][index] =
+            ionization_variables.get_ionic_fraction(ion);
+#ifdef DO_OUTPUT_COOLING
+        _cooling[i][index] = ionization_variables.get_cooling(ion);
+#endif
+#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
+        _photoionization_rates[i][index] =
+            ionization_variables.get_mean_intensity(ion);
+#endif
+      }
+#ifdef DO_OUTPUT_HEATING
+      for (int_fast32_t i = 0; i < NUMBER_OF_HEATINGTERMS; ++i) {
+        const HeatingTermName heating_term = static_cast< HeatingTermName >(i);
+        _heating[i][index] = ionization_variables.get_heating(heating_term);
+      }
+#endif
+      ++index;
+    }
+
+    if (grid.has_hydro()) {
+      _densities.resize(blocksize);
+      _velocities.resize(blocksize);
+      _pressures.resize(blocksize);
+      _masses.resize(blocksize);
+      _total_energies.resize(blocksize);
+      index = 0;
+      for (auto it = grid.begin() + offset; it != grid.begin() + upper_limit;
+           ++it) {
+        const HydroVariables &hydro_variables = it.get_hydro_variables();
+        _densities[index] = hydro_variables.get_primitives_density();
+        _velocities[index] = hydro_variables.get_primitives_velocity();
+        _pressures[index] = hydro_variables.get_primitives_pressure();
+        _masses[index] = hydro_variables.get_conserved_mass();
+        _total_energies[index] = hydro_variables.get_conserved_total_energy();
+        ++index;
+      }
+    }
+  }
+
+  /**
+   * @brief Write the block to the given group.
+   *
+   * The datasets should already exist.
+   *
+   * @param group HDF5Group to write to.
+   * @param has_hydro Write hydro variables?
+   */
+  inline void write(HDF5Tools::HDF5Group group, const bool has_hydro) {
+
+    HDF5Tools::append_dataset< CoordinateVector<> >(group, "Coordinates",
+                                                    _offset, _coordinates);
+    HDF5Tools::append_dataset< double >(group, "NumberDensity", _offset,
+                                        _number_densities);
+    HDF5Tools::append_dataset< double >(group, "Temperature", _offset,
+                                        _temperatures);
+    for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+      HDF5Tools::append_dataset< double >(group,
+                                          "NeutralFraction" + get_ion_name(i),
+                                          _offset, _ionic_fractions[i]);
+#ifdef DO_OUTPUT_COOLING
+      HDF5Tools::append_dataset< double >(group, "Cooling" + get_ion_name(i),
+                                          _offset, _cooling[i]);
+#endif
+#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
+      HDF5Tools::append_dataset< double >(group, "PhotoIonizationRate" +
+                                                     get_ion_name(i),
+                                          _offset, _photoionization_rates[i]);
+#endif
+    }
+#ifdef DO_OUTPUT_HEATING
+    for (int_fast32_t i = 0; i < NUMBER_OF_HEATINGTERMS; ++i) {
+      HDF5Tools::append_dataset< double >(
+          group, "HeatingRate" + get_ion_name(i), _offset, _heating[i]);
+    }
+#endif
+
+    if (has_hydro) {
+      HDF5Tools::append_dataset< double >(group, "Density", _offset,
+                                          _densities);
+      HDF5Tools::append_dataset< CoordinateVector<> >(group, "Velocities",
+                                                      _offset, _velocities);
+      HDF5Tools::append_dataset< double >(group, "Pressure", _offset,
+                                          _pressures);
+      HDF5Tools::append_dataset< double >(group, "Mass", _offset, _masses);
+      HDF5Tools::append_dataset< double >(group, "TotalEnergy", _offset,
+                                          _total_energies);
+    }
   }
+};
+
+/**
+ * @brief Write a snapshot file.
+ *
+ * If a grid is given, the cell variables are copied from the grid in small
+ * blocks, to limit memory usage. Otherwise, the given staged block containing
+ * all cells is written.
+ *
+ * @param header General snapshot information.
+ * @param grid DensityGrid to copy the cell variables from (or nullptr).
+ * @param staged_block Block containing the variables of all cells (only used if
+ * no grid is given).
+ */
+static void write_snapshot(const GadgetSnapshotHeader &header,
+                           DensityGrid *grid,
+                           GadgetSnapshotBlock *staged_block) {
 
   HDF5Tools::HDF5File file =
-      HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_WRITE);
+      HDF5Tools::open_file(header._filename, HDF5Tools::HDF5FILEMODE_WRITE);
 
   // write header
   HDF5Tools::HDF5Group group = HDF5Tools::create_group(file, "Header");
-  Box<> box = grid.get_box();
-  CoordinateVector<> boxsize = box.get_sides();
+  CoordinateVector<> boxsize = header._box_sides;
   HDF5Tools::write_attribute< CoordinateVector<> >(group, "BoxSize", boxsize);
   int32_t dimension = 3;
   HDF5Tools::write_attribute< int32_t >(group, "Dimension", dimension);
@@ -116,7 +310,7 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
   int32_t numfiles = 1;
   HDF5Tools::write_attribute< int32_t >(group, "NumFilesPerSnapshot", numfiles);
   std::vector< uint32_t > numpart(6, 0);
-  numpart[0] = grid.get_number_of_cells();
+  numpart[0] = header._number_of_cells;
   std::vector< uint32_t > numpart_high(6, 0);
   HDF5Tools::write_attribute< std::vector< uint32_t > >(
       group, "NumPart_ThisFile", numpart);
@@ -124,6 +318,7 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
                                                         numpart);
   HDF5Tools::write_attribute< std::vector< uint32_t > >(
       group, "NumPart_Total_HighWord", numpart_high);
+  double time = header._time;
   HDF5Tools::write_attribute< double >(group, "Time", time);
   HDF5Tools::close_group(group);
 
@@ -148,20 +343,20 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
 
   // write parameters
   group = HDF5Tools::create_group(file, "Parameters");
-  for (auto it = params.begin(); it != params.end(); ++it) {
-    std::string key = it.get_key();
-    std::string value = it.get_value();
+  for (size_t i = 0; i < header._parameters.size(); ++i) {
+    std::string key = header._parameters[i].first;
+    std::string value = header._parameters[i].second;
     HDF5Tools::write_attribute< std::string >(group, key, value);
   }
   HDF5Tools::close_group(group);
 
   // write runtime parameters
   group = HDF5Tools::create_group(file, "RuntimePars");
-  std::string timestamp = Utilities::get_timestamp();
+  std::string timestamp = header._timestamp;
   HDF5Tools::write_attribute< std::string >(group, "Creation time", timestamp);
   // an uint_fast32_t does not necessarily have the expected 32-bit size, while
   // we really need a 32-bit variable to write to the file
-  uint32_t uint32_iteration = iteration;
+  uint32_t uint32_iteration = header._iteration;
   HDF5Tools::write_attribute< uint32_t >(group, "Iteration", uint32_iteration);
   HDF5Tools::close_group(group);
 
@@ -213,7 +408,7 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
                                         numpart[0]);
   }
 #endif
-  if (grid.has_hydro()) {
+  if (header._has_hydro) {
     HDF5Tools::create_dataset< double >(group, "Density", numpart[0]);
     HDF5Tools::create_dataset< CoordinateVector<> >(group, "Velocities",
                                                     numpart[0]);
@@ -222,111 +417,123 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
     HDF5Tools::create_dataset< double >(group, "TotalEnergy", numpart[0]);
   }
 
-  const uint_fast32_t blocksize = 10000;
-  const uint_fast32_t numblock =
-      numpart[0] / blocksize + (numpart[0] % blocksize > 0);
-  for (uint_fast32_t iblock = 0; iblock < numblock; ++iblock) {
-    const uint_fast32_t offset = iblock * blocksize;
-    const uint_fast32_t upper_limit =
-        std::min(offset + blocksize, uint_fast32_t(numpart[0]));
-    const uint_fast32_t thisblocksize = upper_limit - offset;
-
-    std::vector< CoordinateVector<> > coords(thisblocksize);
-    std::vector< double > ndens(thisblocksize);
-    std::vector< double > temp(thisblocksize);
-    std::vector< std::vector< double > > nfrac(
-        NUMBER_OF_IONNAMES, std::vector< double >(thisblocksize));
-#ifdef DO_OUTPUT_COOLING
-    std::vector< std::vector< double > > cooling(
-        NUMBER_OF_IONNAMES, std::vector< double >(thisblocksize));
-#endif
-#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
-    std::vector< std::vector< double > > photoionization_rate(
-        NUMBER_OF_IONNAMES, std::vector< double >(thisblocksize));
-#endif
-#ifdef DO_OUTPUT_HEATING
-    std::vector< std::vector< double > > heating(
-        NUMBER_OF_HEATINGTERMS, std::vector< double >(thisblocksize));
-#endif
-    size_t index = 0;
-    for (auto it = grid.begin() + offset; it != grid.begin() + upper_limit;
-         ++it) {
-      coords[index] = it.get_cell_midpoint() - box.get_anchor();
-
-      const IonizationVariables &ionization_variables =
-          it.get_ionization_variables();
-
-      ndens[index] = ionization_variables.get_number_density();
-      temp[index] = ionization_variables.get_temperature();
-      for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
-        const IonName ion = static_cast< IonName >(i);
-        nfrac[i][index] = ionization_variables.get_ionic_fraction(ion);
-#ifdef DO_OUTPUT_COOLING
-        cooling[i][index] = ionization_variables.get_cooling(ion);
-#endif
-#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
-        photoionization_rate[i][index] =
-            ionization_variables.get_mean_intensity(ion);
-#endif
-      }
-#ifdef DO_OUTPUT_HEATING
-      for (int_fast32_t i = 0; i < NUMBER_OF_HEATINGTERMS; ++i) {
-        const HeatingTermName heating_term = static_cast< HeatingTermName >(i);
-        heating[i][index] = ionization_variables.get_heating(heating_term);
-      }
-#endif
-      ++index;
-    }
-    HDF5Tools::append_dataset< CoordinateVector<> >(group, "Coordinates",
-                                                    offset, coords);
-    HDF5Tools::append_dataset< double >(group, "NumberDensity", offset, ndens);
-    HDF5Tools::append_dataset< double >(group, "Temperature", offset, temp);
-    for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
-      HDF5Tools::append_dataset< double >(
-          group, "NeutralFraction" + get_ion_name(i), offset, nfrac[i]);
-#ifdef DO_OUTPUT_COOLING
-      HDF5Tools::append_dataset< double >(group, "Cooling" + get_ion_name(i),
-                                          offset, cooling[i]);
-#endif
-#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
-      HDF5Tools::append_dataset< double >(group, "PhotoIonizationRate" +
-                                                     get_ion_name(i),
-                                          offset, photoionization_rate[i]);
-#endif
-    }
-#ifdef DO_OUTPUT_HEATING
-    for (int_fast32_t i = 0; i < NUMBER_OF_HEATINGTERMS; ++i) {
-      HDF5Tools::append_dataset< double >(
-          group, "HeatingRate" + get_ion_name(i), offset, heating[i]);
-    }
-#endif
-
-    if (grid.has_hydro()) {
-      std::vector< double > dens(thisblocksize);
-      std::vector< CoordinateVector<> > vels(thisblocksize);
-      std::vector< double > pres(thisblocksize);
-      std::vector< double > mass(thisblocksize);
-      std::vector< double > tote(thisblocksize);
-      index = 0;
-      for (auto it = grid.begin() + offset; it != grid.begin() + upper_limit;
-           ++it) {
-        dens[index] = it.get_hydro_variables().get_primitives_density();
-        vels[index] = it.get_hydro_variables().get_primitives_velocity();
-        pres[index] = it.get_hydro_variables().get_primitives_pressure();
-        mass[index] = it.get_hydro_variables().get_conserved_mass();
-        tote[index] = it.get_hydro_variables().get_conserved_total_energy();
-        ++index;
-      }
-      HDF5Tools::append_dataset< double >(group, "Density", offset, dens);
-      HDF5Tools::append_dataset< CoordinateVector<> >(group, "Velocities",
-                                                      offset, vels);
-      HDF5Tools::append_dataset< double >(group, "Pressure", offset, pres);
-      HDF5Tools::append_dataset< double >(group, "Mass", offset, mass);
-      HDF5Tools::append_dataset< double >(group, "TotalEnergy", offset, tote);
+  if (grid != nullptr) {
+    const uint_fast32_t blocksize = 10000;
+    const uint_fast32_t numblock =
+        numpart[0] / blocksize + (numpart[0] % blocksize > 0);
+    GadgetSnapshotBlock block;
+    for (uint_fast32_t iblock = 0; iblock < numblock; ++iblock) {
+      const uint_fast32_t offset = iblock * blocksize;
+      const uint_fast32_t upper_limit =
+          std::min(offset + blocksize, uint_fast32_t(numpart[0]));
+      block.fill(*grid, offset, upper_limit);
+      block.write(group, header._has_hydro);
     }
+  } else {
+    staged_block->write(group, header._has_hydro);
   }
   HDF5Tools::close_group(group);
 
   // close file
   HDF5Tools::close_file(file);
 }
+
+/**
+ * @brief Constructor.
+ *
+ * @param prefix Prefix for the name of the file to write.
+ * @param output_folder Name of the folder where output files should be placed.
+ * @param log Log to write logging information to.
+ * @param padding Number of digits used for the counter in the filenames.
+ * @param maximum_number_of_snapshots_in_flight Maximum number of snapshots that
+ * can be staged for asynchronous writing at the same time. If 0, snapshots are
+ * written synchronously.
+ */
+GadgetDensityGridWriter::GadgetDensityGridWriter(
+    std::string prefix, std::string output_folder, Log *log,
+    uint_fast8_t padding, uint_fast32_t maximum_number_of_snapshots_in_flight)
+    : DensityGridWriter(output_folder, log,
+                        maximum_number_of_snapshots_in_flight),
+      _prefix(prefix), _padding(padding) {
+
+  // turn off default HDF5 error handling: we catch errors ourselves
+  HDF5Tools::initialize();
+  if (_log) {
+    _log->write_status("Set up GadgetDensityGridWriter with prefix \"", _prefix,
+                       "\".");
+  }
+}
+
+/**
+ * @brief ParameterFile constructor.
+ *
+ * Parameters are:
+ *  - prefix: Prefix to prepend to all snapshot file names (default: snapshot)
+ *  - padding: Number of digits to use in the output file names (default: 3)
+ *  - asynchronous output: Write snapshots from a background I/O thread, while
+ *    the simulation continues (default: false)
+ *  - maximum number of snapshots in flight: Maximum number of snapshots that
+ *    are staged for asynchronous output at the same time (default: 2)
+ *
+ * @param output_folder Name of the folder where output files should be placed.
+ * @param params ParameterFile to read.
+ * @param log Log to write logging information to.
+ */
+GadgetDensityGridWriter::GadgetDensityGridWriter(std::string output_folder,
+                                                 ParameterFile &params,
+                                                 Log *log)
+    : GadgetDensityGridWriter(
+          params.get_value< std::string >("DensityGridWriter:prefix",
+                                          "snapshot"),
+          output_folder, log,
+          params.get_value< uint_fast8_t >("DensityGridWriter:padding", 3),
+          get_maximum_number_of_snapshots_in_flight(params)) {}
+
+/**
+ * @brief Write the file.
+ *
+ * In asynchronous mode, the cell variables are copied into a staging buffer,
+ * and the file is written by the background I/O thread, so that the
+ * simulation can continue while the file is written. At most the configured
+ * number of snapshots is in flight; if that limit is reached, this function
+ * waits for the oldest snapshot to be written before it fills a new staging
+ * buffer.
+ *
+ * @param grid DensityGrid to write out.
+ * @param iteration Value of the counter to append to the filename.
+ * @param params ParameterFile containing the run parameters that should be
+ * written to the file.
+ * @param time Simulation time (in s).
+ */
+void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
+                                    ParameterFile &params, double time) {
+
+  std::string filename = Utilities::compose_filename(
+      _output_folder, _prefix, "hdf5", iteration, _padding);
+
+  std::shared_ptr< GadgetSnapshotHeader > header =
+      std::make_shared< GadgetSnapshotHeader >(filename, grid, iteration,
+                                               params, time);
+
+  if (_write_queue == nullptr) {
+    if (_log) {
+      _log->write_status("Writing file \"", filename, "\".");
+    }
+    write_snapshot(*header, &grid, nullptr);
+  } else {
+    if (_log) {
+      _log->write_status("Staging file \"", filename,
+                         "\" for asynchronous writing.");
+    }
+    // only stage the cell variables once a slot is available, so that at most
+    // the configured number of staging buffers exists at any given time
+    _write_queue->acquire_slot();
+    std::shared_ptr< GadgetSnapshotBlock > block =
+        std::make_shared< GadgetSnapshotBlock >();
+    block->fill(grid, 0, header->_number_of_cells);
+    // the job only uses data it owns, so that it does not matter if the
+    // writer or the grid are changed before it is executed
+    _write_queue->add_job(
+        [header, block]() { write_snapshot(*header, nullptr, block.get()); });
+  }
+}
@@ -44,9 +44,10 @@ private:
   const uint_fast8_t _padding;
 
 public:
-  GadgetDensityGridWriter(std::string prefix,
-                          std::string output_folder = std::string("."),
-                          Log *log = nullptr, uint_fast8_t padding = 3);
+  GadgetDensityGridWriter(
+      std::string prefix, std::string output_folder = std::string("."),
+      Log *log = nullptr, uint_fast8_t padding = 3,
+      uint_fast32_t maximum_number_of_snapshots_in_flight = 0);
   GadgetDensityGridWriter(std::string output_folder, ParameterFile &params,
                           Log *log = nullptr);
 
@@ -29,6 +29,7 @@
 #include "HDF5Tools.hpp"
 #include "Log.hpp"
 #include "ParameterFile.hpp"
+#include "SPHGridDeposition.hpp"
 #include "UnitConverter.hpp"
 #include <cfloat>
 #include <fstream>
@@ -55,14 +56,18 @@
  * @param hubble_parameter Hubble parameter used to convert from comoving to
  * physical coordinates. This is a dimensionless parameter, defined as the
  * actual assumed Hubble constant divided by 100 km/s/Mpc.
+ * @param use_deposition Map the particles onto the grid by depositing them in
+ * the cells they overlap with, rather than by sampling the density at the cell
+ * midpoints?
  * @param log Log to write logging information to.
  */
 GadgetSnapshotDensityFunction::GadgetSnapshotDensityFunction(
     std::string name, bool fallback_periodic, double fallback_unit_length_in_SI,
     double fallback_unit_mass_in_SI, double fallback_unit_temperature_in_SI,
     bool use_neutral_fraction, double fallback_temperature,
-    bool comoving_integration, double hubble_parameter, Log *log)
-    : _log(log) {
+    bool comoving_integration, double hubble_parameter, bool use_deposition,
+    Log *log)
+    : _use_deposition(use_deposition), _deposition_grid(nullptr), _log(log) {
 
   // turn off default HDF5 error handling: we catch errors ourselves
   HDF5Tools::initialize();
@@ -243,8 +248,8 @@ GadgetSnapshotDensityFunction::GadgetSnapshotDensityFunction(
                        box.get_sides().z(), " m]...");
   }
 
-  _octree = new Octree(_positions, box, periodic);
-  _octree->set_auxiliaries(_smoothing_lengths, Octree::max< double >);
+  _octree = new LinearOctree(_positions, box, periodic);
+  _octree->set_auxiliaries(_smoothing_lengths, LinearOctree::max< double >);
 
   if (_log) {
     _log->write_status("Done creating octree.");
@@ -272,6 +277,9 @@ GadgetSnapshotDensityFunction::GadgetSnapshotDensityFunction(
  *    simulation (default: false)?
  *  - hubble parameter: Reduced Hubble parameter used for the original
  *    simulation (default: 0.7)
+ *  - use particle deposition: Map the particles onto the grid by depositing
+ *    their mass in all cells they overlap with, instead of sampling the density
+ *    at the cell midpoints (default: false)
  *
  * @param params ParameterFile to read.
  * @param log Log to write logging information to.
@@ -295,6 +303,8 @@ GadgetSnapshotDensityFunction::GadgetSnapshotDensityFunction(
           params.get_value< bool >("DensityFunction:comoving integration flag",
                                    false),
           params.get_value< double >("DensityFunction:hubble parameter", 0.7),
+          params.get_value< bool >("DensityFunction:use particle deposition",
+                                   false),
           log) {}
 
 /**
@@ -306,9 +316,71 @@ GadgetSnapshotDensityFunction::~GadgetSnapshotDensityFunction() {
   delete _octree;
 }
 
+/**
+ * @brief Deposit the particles onto the given grid, if deposition mode is
+ * active.
+ *
+ * Every particle distributes its mass over the cells it overlaps with,
+ * weighted with the kernel (see SPHGridDeposition). The temperature and neutral
+ * fraction are deposited as mass weighted quantities.
+ *
+ * @param grid DensityGrid that will be filled.
+ * @param worksize Number of parallel threads to use. If a negative number is
+ * given, all available threads will be used.
+ */
+void GadgetSnapshotDensityFunction::prepare(const DensityGrid &grid,
+                                            int_fast32_t worksize) {
+
+  if (!_use_deposition) {
+    return;
+  }
+
+  if (_log) {
+    _log->write_status("Depositing ", _positions.size(),
+                       " particles onto the grid...");
+  }
+
+  const size_t numpart = _positions.size();
+  std::vector< std::vector< double > > quantities(3);
+  quantities[0] = _masses;
+  quantities[1].resize(numpart);
+  quantities[2].resize(numpart, 0.);
+  for (size_t i = 0; i < numpart; ++i) {
+    quantities[1][i] = _masses[i] * _temperatures[i];
+    if (_neutral_fractions.size() > 0) {
+      quantities[2][i] = _masses[i] * _neutral_fractions[i];
+    }
+  }
+
+  SPHGridDeposition::deposit(grid, _positions, _smoothing_lengths, quantities,
+                             CubicSplineKernel::kernel_evaluate, _box,
+                             _deposited_values, worksize);
+  _deposition_grid = &grid;
+
+  // convert the deposited values into cell averages, so that they are still
+  // meaningful for cells that are refined before the next call to this
+  // function
+  for (cellsize_t i = 0; i < _deposited_values[0].size(); ++i) {
+    const double mass = _deposited_values[0][i];
+    _deposited_values[0][i] = mass / grid.get_cell_volume(i);
+    if (mass > 0.) {
+      _deposited_values[1][i] /= mass;
+      _deposited_values[2][i] /= mass;
+    }
+  }
+
+  if (_log) {
+    _log->write_status("Done depositing particles.");
+  }
+}
+
 /**
  * @brief Function that gives the density for a given cell.
  *
+ * If the particles were deposited onto the grid the cell belongs to, we simply
+ * return the deposited values for the index of the cell. Otherwise, we sample
+ * the density at the cell midpoint.
+ *
  * @param cell Geometrical information about the cell.
  * @return Initial physical field values for that cell.
  */
@@ -325,10 +397,26 @@ operator()(const Cell &cell) const {
   if (_neutral_fractions.size() > 0) {
     neutral_fraction = 0.;
   }
-  const std::vector< uint_fast32_t > ngbs = _octree->get_ngbs(position);
-  const size_t numngbs = ngbs.size();
-  for (size_t i = 0; i < numngbs; ++i) {
-    const uint_fast32_t index = ngbs[i];
+
+  if (_deposition_grid != nullptr && cell.get_grid() == _deposition_grid &&
+      cell.get_index() < _deposited_values[0].size()) {
+    // cells that did not receive any mass are empty: no particle kernel
+    // overlaps with them
+    const cellsize_t index = cell.get_index();
+    values.set_number_density(_deposited_values[0][index] / 1.6737236e-27);
+    values.set_temperature(_deposited_values[1][index]);
+    if (neutral_fraction >= 0.) {
+      values.set_ionic_fraction(ION_H_n, _deposited_values[2][index]);
+    } else {
+      values.set_ionic_fraction(ION_H_n, 1.e-6);
+    }
+    values.set_ionic_fraction(ION_He_n, 1.e-6);
+    return values;
+  }
+
+  _octree->for_each_ngb(position, [this, &position, &density, &temperature,
+                                    &neutral_fraction](
+                                       const uint_fast32_t index) {
     double r;
     if (!_box.get_sides().x()) {
       r = (position - _positions[index]).norm();
@@ -344,7 +432,7 @@ operator()(const Cell &cell) const {
     if (neutral_fraction >= 0.) {
       neutral_fraction += splineval * _neutral_fractions[index];
     }
-  }
+  });
 
   values.set_number_density(density / 1.6737236e-27);
   values.set_temperature(temperature);
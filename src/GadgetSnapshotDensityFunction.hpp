@@ -29,7 +29,7 @@
 
 #include "Box.hpp"
 #include "DensityFunction.hpp"
-#include "Octree.hpp"
+#include "LinearOctree.hpp"
 #include <string>
 #include <vector>
 
@@ -67,7 +67,21 @@ private:
   std::vector< double > _neutral_fractions;
 
   /*! @brief Octree used to speed up neighbour searching. */
-  Octree *_octree;
+  LinearOctree *_octree;
+
+  /*! @brief Map the particles onto the grid by depositing them in the cells
+   *  they overlap with, rather than by sampling the density at the cell
+   *  midpoints? */
+  const bool _use_deposition;
+
+  /*! @brief DensityGrid onto which the particles were deposited (only used if
+   *  _use_deposition is true). */
+  const DensityGrid *_deposition_grid;
+
+  /*! @brief Deposited density (in kg m^-3), mass weighted temperature (in K)
+   *  and mass weighted neutral fraction for every cell of the deposition
+   *  grid. */
+  std::vector< std::vector< double > > _deposited_values;
 
   /*! @brief Log to write logging info to. */
   Log *_log;
@@ -82,12 +96,15 @@ public:
                                 double fallback_temperature = 0.,
                                 bool comoving_integration = false,
                                 double hubble_parameter = 0.7,
+                                bool use_deposition = false,
                                 Log *log = nullptr);
 
   GadgetSnapshotDensityFunction(ParameterFile &params, Log *log = nullptr);
 
   virtual ~GadgetSnapshotDensityFunction();
 
+  virtual void prepare(const DensityGrid &grid, int_fast32_t worksize = -1);
+
   virtual DensityValues operator()(const Cell &cell) const;
 
   double get_total_hydrogen_number() const;
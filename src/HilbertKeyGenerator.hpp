@@ -80,6 +80,7 @@ private:
    *  m). */
   const Box<> _box;
 
+public:
   /**
    * @brief Get the Hilbert key for the given position.
    *
@@ -150,7 +151,6 @@ private:
     return key;
   }
 
-public:
   /**
    * @brief Constructor.
    *
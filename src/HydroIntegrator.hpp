@@ -35,210 +35,1661 @@
 #include "RiemannSolver.hpp"
 #include "SimulationBox.hpp"
 #include "Timer.hpp"
+#include "WorkStealingScheduler.hpp"
 
 #include <cfloat>
 
+/*! @brief Maximum number of times the system time step can be halved to obtain
+ *  an individual cell time step. */
+#define HYDROINTEGRATOR_MAXIMUM_TIMESTEP_DEPTH 32
+
+/*! @brief Maximum ratio between the individual time steps of neighbouring
+ *  cells. */
+#define HYDROINTEGRATOR_TIMESTEP_LIMITER 4
+
 /*! @brief Stop the serial time timer and start the parallel time timer. */
 #define hydro_start_parallel_timing_block()                                    \
   serial_timer.stop();                                                         \
   parallel_timer.start();
 
-/*! @brief Stop the parallel time timer and start the serial time timer. */
-#define hydro_stop_parallel_timing_block()                                     \
-  parallel_timer.stop();                                                       \
-  serial_timer.start();
+/*! @brief Stop the parallel time timer and start the serial time timer. */
+#define hydro_stop_parallel_timing_block()                                     \
+  parallel_timer.stop();                                                       \
+  serial_timer.start();
+
+/**
+ * @brief Class that performs the hydrodynamical integration.
+ */
+class HydroIntegrator {
+private:
+  /*! @brief Adiabatic index of the gas. */
+  const double _gamma;
+
+  /*! @brief Adiabatic index minus one. */
+  const double _gm1;
+
+  /*! @brief Inverse of adiabatic index minus one. */
+  const double _gm1_inv;
+
+  /*! @brief Flag indicating whether we use radiative heating or not. */
+  const bool _do_radiative_heating;
+
+  /*! @brief Flag indicating whether we want radiative cooling or not. */
+  const bool _do_radiative_cooling;
+
+  /*! @brief Exact Riemann solver used to solve the Riemann problem. */
+  const RiemannSolver _solver;
+
+  /*! @brief Boundary conditions to apply to each boundary. */
+  const HydroBoundaryConditionType _boundaries[6];
+
+  /*! @brief Flag indicating whether cells use individual time steps or not. */
+  const bool _individual_timesteps;
+
+  /*! @brief Maximum pressure ratio (and velocity jump, in units of the
+   *  smallest soundspeed, plus one) across an interface for which the batched
+   *  flux computation uses the approximate HLLC solver instead of the exact
+   *  Riemann solver (values smaller than 1 disable the HLLC solver). */
+  const double _hllc_threshold;
+
+  /**
+   * @brief Get the HydroBoundaryConditionType corresponding to the given type
+   * string.
+   *
+   * @param type std::string representation of a boundary condition type.
+   * @return Corresponding HydroBoundaryConditionType.
+   */
+  static HydroBoundaryConditionType get_boundary_type(std::string type) {
+    if (type == "periodic") {
+      return HYDRO_BOUNDARY_PERIODIC;
+    } else if (type == "reflective") {
+      return HYDRO_BOUNDARY_REFLECTIVE;
+    } else if (type == "inflow") {
+      return HYDRO_BOUNDARY_INFLOW;
+    } else {
+      cmac_error("Unknown boundary condition type: %s!", type.c_str());
+      return HYDRO_BOUNDARY_INVALID;
+    }
+  }
+
+  /// face table used for the flux computation
+
+  /*! @brief DensityGrid for which the face table was built. */
+  const DensityGrid *_face_grid;
+
+  /*! @brief Offsets of the faces owned by each cell: the faces for which cell
+   *  i is the left cell are stored in [_face_offsets[i], _face_offsets[i+1]).
+   *  Every interface between two cells is stored only once. */
+  std::vector< size_t > _face_offsets;
+
+  /*! @brief Index of the left cell of each face. */
+  std::vector< cellsize_t > _face_left_index;
+
+  /*! @brief Index of the right cell of each face (the index of the end of the
+   *  grid for faces on the box boundaries). */
+  std::vector< cellsize_t > _face_right_index;
+
+  /*! @brief Midpoint of each face (in m). */
+  std::vector< CoordinateVector<> > _face_midpoints;
+
+  /*! @brief Normal of each face, pointing from the left to the right cell. */
+  std::vector< CoordinateVector<> > _face_normals;
+
+  /*! @brief Surface area of each face (in m^2). */
+  std::vector< double > _face_areas;
+
+  /*! @brief Offsets of the faces for which each cell is the right cell in
+   *  _right_faces. */
+  std::vector< size_t > _right_face_offsets;
+
+  /*! @brief Indices of the faces for which each cell is the right cell. */
+  std::vector< size_t > _right_faces;
+
+  /*! @brief Time integrated fluxes through each face (5 values per face). */
+  std::vector< double > _face_fluxes;
+
+  /// individual time stepping
+
+  /*! @brief Integer time step of each cell, in units of the smallest possible
+   *  time step within a system time step (a system time step corresponds to
+   *  an integer time step of 2^HYDROINTEGRATOR_MAXIMUM_TIMESTEP_DEPTH). */
+  std::vector< uint64_t > _cell_timesteps;
+
+  /*! @brief New integer time step of each cell. Only differs from
+   *  _cell_timesteps while new time steps are being assigned. */
+  std::vector< uint64_t > _new_cell_timesteps;
+
+  /*! @brief Cells whose new time step still needs to be checked against the
+   *  time steps of their neighbours by the time step limiter. */
+  std::vector< cellsize_t > _limiter_queue;
+
+  /*! @brief Inactive cells whose time step was shortened by the time step
+   *  limiter during the current substep. */
+  std::vector< cellsize_t > _limited_cells;
+
+  /*! @brief Cells in each time step bin: bin i contains all cells with an
+   *  integer time step of 2^i. */
+  std::vector< std::vector< cellsize_t > > _timestep_bins;
+
+  /*! @brief Cells that are active during the current substep. */
+  std::vector< cellsize_t > _active_cells;
+
+  /*! @brief Active cells and their neighbours during the current substep:
+   *  all cells that receive fluxes. */
+  std::vector< cellsize_t > _touched_cells;
+
+  /*! @brief Last substep during which each cell was added to
+   *  _touched_cells. */
+  std::vector< uint_fast32_t > _touched_substep;
+
+  /*! @brief Number of substeps taken during the last system time step. */
+  uint_fast32_t _last_number_of_substeps;
+
+  /*! @brief Number of individual cell updates during the last system time
+   *  step. */
+  uint_fast64_t _last_number_of_cell_updates;
+
+  /**
+   * @brief Build the face table for the given DensityGrid.
+   *
+   * Only interfaces with a neighbour with a larger index are added to the
+   * table, so that every interface is stored (and solved) only once.
+   * Interfaces between a cell and its own periodic copy are skipped, as the
+   * fluxes through both sides of the cell cancel out exactly.
+   *
+   * @param grid DensityGrid.
+   */
+  inline void build_face_table(DensityGrid &grid) {
+
+    const DensityGrid::iterator grid_end = grid.end();
+    const cellsize_t numcell = grid.get_number_of_cells();
+
+    _face_grid = &grid;
+    _face_offsets.resize(numcell + 1);
+    _face_left_index.clear();
+    _face_right_index.clear();
+    _face_midpoints.clear();
+    _face_normals.clear();
+    _face_areas.clear();
+
+    std::vector< size_t > right_face_count(numcell, 0);
+    _face_offsets[0] = 0;
+    for (auto it = grid.begin(); it != grid_end; ++it) {
+      const cellsize_t index = it.get_index();
+      auto ngbs = it.get_neighbours();
+      for (auto ngbit = ngbs.begin(); ngbit != ngbs.end(); ++ngbit) {
+        const DensityGrid::iterator ngb = std::get< 0 >(*ngbit);
+        if (ngb == grid_end || ngb.get_index() > index) {
+          _face_left_index.push_back(index);
+          _face_right_index.push_back(ngb.get_index());
+          _face_midpoints.push_back(std::get< 1 >(*ngbit));
+          _face_normals.push_back(std::get< 2 >(*ngbit));
+          _face_areas.push_back(std::get< 3 >(*ngbit));
+          if (ngb != grid_end) {
+            ++right_face_count[ngb.get_index()];
+          }
+        }
+      }
+      _face_offsets[index + 1] = _face_right_index.size();
+    }
+
+    // build the inverse (right cell) connectivity
+    _right_face_offsets.resize(numcell + 1);
+    _right_face_offsets[0] = 0;
+    for (cellsize_t i = 0; i < numcell; ++i) {
+      _right_face_offsets[i + 1] = _right_face_offsets[i] + right_face_count[i];
+      right_face_count[i] = _right_face_offsets[i];
+    }
+    _right_faces.resize(_right_face_offsets[numcell]);
+    const size_t numface = _face_right_index.size();
+    const cellsize_t end_index = grid_end.get_index();
+    for (size_t iface = 0; iface < numface; ++iface) {
+      const cellsize_t right = _face_right_index[iface];
+      if (right != end_index) {
+        _right_faces[right_face_count[right]] = iface;
+        ++right_face_count[right];
+      }
+    }
+
+    _face_fluxes.resize(5 * numface);
+  }
+
+  /**
+   * @brief Get the left and right state of the Riemann problem at the
+   * interface between the given left cell and right cell.
+   *
+   * The velocities are boosted to the frame of the interface, and the
+   * velocities along the interface normal are returned separately.
+   *
+   * @param grid DensityGrid.
+   * @param grid_end Iterator to the end of the grid.
+   * @param cell DensityGrid::iterator pointing to the left cell.
+   * @param ngb DensityGrid::iterator pointing to the right cell (or grid_end
+   * if the interface is a box boundary).
+   * @param midpoint Midpoint of the interface (in m).
+   * @param normal Normal of the interface, pointing from the left to the right
+   * cell.
+   * @param rhoL Output: density of the left state (in kg m^-3).
+   * @param vL Output: velocity of the left state along the normal (in m s^-1).
+   * @param PL Output: pressure of the left state (in kg m^-1 s^-2).
+   * @param rhoR Output: density of the right state (in kg m^-3).
+   * @param vR Output: velocity of the right state along the normal (in m
+   * s^-1).
+   * @param PR Output: pressure of the right state (in kg m^-1 s^-2).
+   * @param uLframe Output: velocity of the left state in the interface frame
+   * (in m s^-1).
+   * @param uRframe Output: velocity of the right state in the interface frame
+   * (in m s^-1).
+   * @param vframe Output: velocity of the interface (in m s^-1).
+   */
+  inline void get_interface_states(
+      const DensityGrid &grid, const DensityGrid::iterator &grid_end,
+      const DensityGrid::iterator &cell, const DensityGrid::iterator &ngb,
+      const CoordinateVector<> midpoint, const CoordinateVector<> normal,
+      double &rhoL, double &vL, double &PL, double &rhoR, double &vR,
+      double &PR, CoordinateVector<> &uLframe, CoordinateVector<> &uRframe,
+      CoordinateVector<> &vframe) const {
+
+    rhoL = cell.get_hydro_variables().get_primitives_density();
+    const CoordinateVector<> uL =
+        cell.get_hydro_variables().get_primitives_velocity();
+    PL = cell.get_hydro_variables().get_primitives_pressure();
+
+    // get the right state
+    CoordinateVector<> uR;
+    if (ngb != grid_end) {
+      rhoR = ngb.get_hydro_variables().get_primitives_density();
+      uR = ngb.get_hydro_variables().get_primitives_velocity();
+      PR = ngb.get_hydro_variables().get_primitives_pressure();
+      vframe = grid.get_interface_velocity(cell, ngb, midpoint);
+    } else {
+      // apply boundary conditions
+      rhoR = rhoL;
+      uR = uL;
+      if (normal[0] < 0. && _boundaries[0] == HYDRO_BOUNDARY_REFLECTIVE) {
+        uR[0] = -uR[0];
+      }
+      if (normal[0] > 0. && _boundaries[1] == HYDRO_BOUNDARY_REFLECTIVE) {
+        uR[0] = -uR[0];
+      }
+      if (normal[1] < 0. && _boundaries[2] == HYDRO_BOUNDARY_REFLECTIVE) {
+        uR[1] = -uR[1];
+      }
+      if (normal[1] > 0. && _boundaries[3] == HYDRO_BOUNDARY_REFLECTIVE) {
+        uR[1] = -uR[1];
+      }
+      if (normal[2] < 0. && _boundaries[4] == HYDRO_BOUNDARY_REFLECTIVE) {
+        uR[2] = -uR[2];
+      }
+      if (normal[2] > 0. && _boundaries[5] == HYDRO_BOUNDARY_REFLECTIVE) {
+        uR[2] = -uR[2];
+      }
+      PR = PL;
+      vframe = CoordinateVector<>();
+    }
+
+    // boost the velocities to the interface frame
+    uLframe = uL - vframe;
+    uRframe = uR - vframe;
+
+    // project the velocities onto the surface normal
+    vL = CoordinateVector<>::dot_product(uLframe, normal);
+    vR = CoordinateVector<>::dot_product(uRframe, normal);
+  }
+
+  /**
+   * @brief Convert the solution of the Riemann problem at an interface into
+   * time integrated fluxes through that interface.
+   *
+   * @param flag Flag returned by the Riemann solver: -1 if the left state was
+   * sampled, 1 if the right state was sampled, 0 for vacuum.
+   * @param rhosol Density of the solution (in kg m^-3).
+   * @param vsol Velocity of the solution along the normal (in m s^-1).
+   * @param Psol Pressure of the solution (in kg m^-1 s^-2).
+   * @param vL Velocity of the left state along the normal (in m s^-1).
+   * @param vR Velocity of the right state along the normal (in m s^-1).
+   * @param uLframe Velocity of the left state in the interface frame (in m
+   * s^-1).
+   * @param uRframe Velocity of the right state in the interface frame (in m
+   * s^-1).
+   * @param vframe Velocity of the interface (in m s^-1).
+   * @param normal Normal of the interface, pointing from the left to the right
+   * cell.
+   * @param surface_area Surface area of the interface (in m^2).
+   * @param timestep Integration time step (in s).
+   * @param fluxes Array to store the mass, momentum and energy fluxes in (from
+   * the left to the right cell).
+   */
+  inline void get_interface_fluxes(
+      const int_fast32_t flag, const double rhosol, double vsol,
+      const double Psol, const double vL, const double vR,
+      const CoordinateVector<> uLframe, const CoordinateVector<> uRframe,
+      const CoordinateVector<> vframe, const CoordinateVector<> normal,
+      const double surface_area, const double timestep,
+      double *fluxes) const {
+
+    // if the solution was vacuum, there is no flux
+    if (flag != 0) {
+      // deproject the velocity
+      CoordinateVector<> usol;
+      if (flag == -1) {
+        vsol -= vL;
+        usol = uLframe + vsol * normal;
+      } else {
+        vsol -= vR;
+        usol = uRframe + vsol * normal;
+      }
+
+      // rho*e = rho*u + 0.5*rho*v^2 = P/(gamma-1.) + 0.5*rho*v^2
+      double rhoesol = 0.5 * rhosol * usol.norm2() + Psol * _gm1_inv;
+      vsol = CoordinateVector<>::dot_product(usol, normal);
+
+      // get the fluxes
+      const double mflux = rhosol * vsol * surface_area * timestep;
+      CoordinateVector<> pflux = rhosol * vsol * usol + Psol * normal;
+      pflux *= surface_area * timestep;
+      double eflux = (rhoesol + Psol) * vsol * surface_area * timestep;
+
+      // de-boost fluxes to fixed reference frame
+      const double vframe2 = vframe.norm2();
+      eflux += CoordinateVector<>::dot_product(vframe, pflux) +
+               0.5 * vframe2 * mflux;
+      pflux += mflux * vframe;
+
+      fluxes[0] = mflux;
+      fluxes[1] = pflux.x();
+      fluxes[2] = pflux.y();
+      fluxes[3] = pflux.z();
+      fluxes[4] = eflux;
+    } else {
+      fluxes[0] = 0.;
+      fluxes[1] = 0.;
+      fluxes[2] = 0.;
+      fluxes[3] = 0.;
+      fluxes[4] = 0.;
+    }
+  }
+
+  /**
+   * @brief Compute the time integrated fluxes through the interface between
+   * the given left cell and right cell.
+   *
+   * @param grid DensityGrid.
+   * @param grid_end Iterator to the end of the grid.
+   * @param cell DensityGrid::iterator pointing to the left cell.
+   * @param ngb DensityGrid::iterator pointing to the right cell (or grid_end
+   * if the interface is a box boundary).
+   * @param midpoint Midpoint of the interface (in m).
+   * @param normal Normal of the interface, pointing from the left to the right
+   * cell.
+   * @param surface_area Surface area of the interface (in m^2).
+   * @param timestep Integration time step (in s).
+   * @param fluxes Array to store the mass, momentum and energy fluxes in (from
+   * the left to the right cell).
+   */
+  inline void compute_fluxes(const DensityGrid &grid,
+                             const DensityGrid::iterator &grid_end,
+                             const DensityGrid::iterator &cell,
+                             const DensityGrid::iterator &ngb,
+                             const CoordinateVector<> midpoint,
+                             const CoordinateVector<> normal,
+                             const double surface_area, const double timestep,
+                             double *fluxes) const {
+
+    double rhoL, vL, PL, rhoR, vR, PR;
+    CoordinateVector<> uLframe, uRframe, vframe;
+    get_interface_states(grid, grid_end, cell, ngb, midpoint, normal, rhoL, vL,
+                         PL, rhoR, vR, PR, uLframe, uRframe, vframe);
+
+    // solve the Riemann problem
+    double rhosol, vsol, Psol;
+    const int_fast32_t flag =
+        _solver.solve(rhoL, vL, PL, rhoR, vR, PR, rhosol, vsol, Psol);
+
+    get_interface_fluxes(flag, rhosol, vsol, Psol, vL, vR, uLframe, uRframe,
+                         vframe, normal, surface_area, timestep, fluxes);
+  }
+
+  /**
+   * @brief Compute the time integrated fluxes through the given contiguous
+   * range of faces in the face table.
+   *
+   * The faces are processed in blocks of RIEMANNSOLVER_BATCH_SIZE: the left
+   * and right states of all faces in a block are gathered into arrays, and
+   * the Riemann problems for the entire block are solved using a single call
+   * to RiemannSolver::solve_batch.
+   *
+   * @param grid DensityGrid.
+   * @param grid_end Iterator to the end of the grid.
+   * @param face_begin Index of the first face in the range.
+   * @param face_end Index beyond the last face in the range.
+   * @param timestep Integration time step (in s).
+   */
+  inline void compute_fluxes_batch(DensityGrid &grid,
+                                   const DensityGrid::iterator &grid_end,
+                                   const size_t face_begin,
+                                   const size_t face_end,
+                                   const double timestep) {
+
+    double rhoL[RIEMANNSOLVER_BATCH_SIZE], vL[RIEMANNSOLVER_BATCH_SIZE];
+    double PL[RIEMANNSOLVER_BATCH_SIZE], rhoR[RIEMANNSOLVER_BATCH_SIZE];
+    double vR[RIEMANNSOLVER_BATCH_SIZE], PR[RIEMANNSOLVER_BATCH_SIZE];
+    double rhosol[RIEMANNSOLVER_BATCH_SIZE], vsol[RIEMANNSOLVER_BATCH_SIZE];
+    double Psol[RIEMANNSOLVER_BATCH_SIZE];
+    int_fast32_t flags[RIEMANNSOLVER_BATCH_SIZE];
+    CoordinateVector<> uLframe[RIEMANNSOLVER_BATCH_SIZE];
+    CoordinateVector<> uRframe[RIEMANNSOLVER_BATCH_SIZE];
+    CoordinateVector<> vframe[RIEMANNSOLVER_BATCH_SIZE];
+
+    for (size_t iblock = face_begin; iblock < face_end;
+         iblock += RIEMANNSOLVER_BATCH_SIZE) {
+
+      const size_t block_size =
+          std::min(static_cast< size_t >(RIEMANNSOLVER_BATCH_SIZE),
+                   face_end - iblock);
+
+      // gather the left and right states
+      for (size_t i = 0; i < block_size; ++i) {
+        const size_t iface = iblock + i;
+        const DensityGrid::iterator cell(_face_left_index[iface], grid);
+        const DensityGrid::iterator ngb(_face_right_index[iface], grid);
+        get_interface_states(grid, grid_end, cell, ngb, _face_midpoints[iface],
+                             _face_normals[iface], rhoL[i], vL[i], PL[i],
+                             rhoR[i], vR[i], PR[i], uLframe[i], uRframe[i],
+                             vframe[i]);
+      }
+
+      // solve all Riemann problems in the block at once
+      _solver.solve_batch(block_size, rhoL, vL, PL, rhoR, vR, PR, rhosol, vsol,
+                          Psol, flags, _hllc_threshold);
+
+      // convert the solutions into fluxes
+      for (size_t i = 0; i < block_size; ++i) {
+        const size_t iface = iblock + i;
+        get_interface_fluxes(flags[i], rhosol[i], vsol[i], Psol[i], vL[i],
+                             vR[i], uLframe[i], uRframe[i], vframe[i],
+                             _face_normals[iface], _face_areas[iface],
+                             timestep, &_face_fluxes[5 * iface]);
+      }
+    }
+  }
+
+  /**
+   * @brief Job that computes the fluxes through a contiguous range of faces
+   * in the face table.
+   */
+  class HydroFluxComputationJob {
+  private:
+    /*! @brief Reference to the underlying HydroIntegrator. */
+    HydroIntegrator &_hydro_integrator;
+
+    /*! @brief Reference to the grid. */
+    DensityGrid &_grid;
+
+    /*! @brief Iterator to the end of the grid. */
+    const DensityGrid::iterator &_grid_end;
+
+    /*! @brief Index of the first face in the range. */
+    const size_t _face_begin;
+
+    /*! @brief Index beyond the last face in the range. */
+    const size_t _face_end;
+
+    /*! @brief Integration time step (in s). */
+    const double _timestep;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param hydro_integrator Reference to the underlying HydroIntegrator.
+     * @param grid Reference to the DensityGrid.
+     * @param grid_end Iterator to the end of the grid.
+     * @param face_begin Index of the first face in the range.
+     * @param face_end Index beyond the last face in the range.
+     * @param timestep Integration time step (in s).
+     */
+    inline HydroFluxComputationJob(HydroIntegrator &hydro_integrator,
+                                   DensityGrid &grid,
+                                   const DensityGrid::iterator &grid_end,
+                                   const size_t face_begin,
+                                   const size_t face_end, double timestep)
+        : _hydro_integrator(hydro_integrator), _grid(grid), _grid_end(grid_end),
+          _face_begin(face_begin), _face_end(face_end), _timestep(timestep) {}
+
+    /**
+     * @brief Should the Job be deleted by the Worker when it is finished?
+     *
+     * @return True.
+     */
+    inline bool do_cleanup() const { return true; }
+
+    /**
+     * @brief Compute the fluxes through all faces in the range.
+     */
+    inline void execute() {
+      _hydro_integrator.compute_fluxes_batch(_grid, _grid_end, _face_begin,
+                                             _face_end, _timestep);
+    }
+
+    /**
+     * @brief Get a name tag for this job.
+     *
+     * @return "hydro_flux_computation".
+     */
+    inline std::string get_tag() const { return "hydro_flux_computation"; }
+  };
+
+  /**
+   * @brief JobMarket that spawns HydroFluxComputationJobs that together cover
+   * all faces in the face table.
+   *
+   * Chunk boundaries are aligned to RIEMANNSOLVER_BATCH_SIZE, so that every
+   * job (except the last one) solves a whole number of Riemann solver blocks.
+   */
+  class HydroFluxComputationJobMarket {
+  private:
+    /*! @brief Reference to the underlying HydroIntegrator. */
+    HydroIntegrator &_hydro_integrator;
+
+    /*! @brief Reference to the grid. */
+    DensityGrid &_grid;
+
+    /*! @brief Iterator to the end of the grid. */
+    const DensityGrid::iterator &_grid_end;
+
+    /*! @brief Integration time step (in s). */
+    const double _timestep;
+
+    /*! @brief Scheduler that distributes the faces over the threads. */
+    WorkStealingScheduler _scheduler;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param hydro_integrator Reference to the underlying HydroIntegrator.
+     * @param grid Reference to the DensityGrid.
+     * @param grid_end Iterator to the end of the grid.
+     * @param timestep Integration time step (in s).
+     */
+    inline HydroFluxComputationJobMarket(HydroIntegrator &hydro_integrator,
+                                         DensityGrid &grid,
+                                         const DensityGrid::iterator &grid_end,
+                                         double timestep)
+        : _hydro_integrator(hydro_integrator), _grid(grid), _grid_end(grid_end),
+          _timestep(timestep),
+          _scheduler(1.e-3, 10 * RIEMANNSOLVER_BATCH_SIZE) {
+      _scheduler.set_alignment(RIEMANNSOLVER_BATCH_SIZE);
+    }
+
+    /**
+     * @brief Set the number of parallel threads that will be used to execute
+     * the jobs.
+     *
+     * @param worksize Number of parallel threads that will be used.
+     */
+    inline void set_worksize(int_fast32_t worksize) {
+      _scheduler.reset(0, _hydro_integrator._face_right_index.size(),
+                       worksize);
+    }
+
+    /**
+     * @brief Get a HydroFluxComputationJob.
+     *
+     * @param thread_id Id of the thread that calls this function.
+     * @return Pointer to a unique and thread safe HydroFluxComputationJob
+     * instance (or a nullptr if all faces have been handed out).
+     */
+    inline HydroFluxComputationJob *get_job(int_fast32_t thread_id) {
+      uint_fast64_t begin, end;
+      if (!_scheduler.get_chunk(thread_id, begin, end)) {
+        return nullptr;
+      }
+      return new HydroFluxComputationJob(_hydro_integrator, _grid, _grid_end,
+                                         begin, end, _timestep);
+    }
+  };
+
+  /**
+   * @brief Functor that adds the fluxes through all faces of a single cell to
+   * the conserved variable differences of that cell.
+   */
+  class HydroFluxAccumulation {
+  private:
+    /*! @brief Reference to the underlying HydroIntegrator. */
+    const HydroIntegrator &_hydro_integrator;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param hydro_integrator Reference to the underlying HydroIntegrator.
+     */
+    inline HydroFluxAccumulation(const HydroIntegrator &hydro_integrator)
+        : _hydro_integrator(hydro_integrator) {}
+
+    /**
+     * @brief Add the fluxes through all faces of a single cell of the grid.
+     *
+     * Fluxes through faces for which the cell is the left cell are added,
+     * fluxes through faces for which the cell is the right cell are
+     * subtracted.
+     *
+     * @param cell DensityGrid::iterator pointing to a grid cell.
+     */
+    inline void operator()(DensityGrid::iterator &cell) {
+
+      const cellsize_t index = cell.get_index();
+      double delta[5] = {0., 0., 0., 0., 0.};
+      const size_t face_end = _hydro_integrator._face_offsets[index + 1];
+      for (size_t iface = _hydro_integrator._face_offsets[index];
+           iface < face_end; ++iface) {
+        const double *fluxes = &_hydro_integrator._face_fluxes[5 * iface];
+        for (uint_fast8_t i = 0; i < 5; ++i) {
+          delta[i] += fluxes[i];
+        }
+      }
+      const size_t right_face_end =
+          _hydro_integrator._right_face_offsets[index + 1];
+      for (size_t i_right = _hydro_integrator._right_face_offsets[index];
+           i_right < right_face_end; ++i_right) {
+        const size_t iface = _hydro_integrator._right_faces[i_right];
+        const double *fluxes = &_hydro_integrator._face_fluxes[5 * iface];
+        for (uint_fast8_t i = 0; i < 5; ++i) {
+          delta[i] -= fluxes[i];
+        }
+      }
+
+      HydroVariables &hydro_variables = cell.get_hydro_variables();
+      for (uint_fast8_t i = 0; i < 5; ++i) {
+        hydro_variables.delta_conserved(i) += delta[i];
+      }
+    }
+  };
+
+  /**
+   * @brief Functor that computes the fluxes through all active faces of a
+   * single active cell during a substep of the individual time stepping
+   * scheme.
+   *
+   * A face is active if at least one of its cells is active. Faces between two
+   * active cells are computed by the left cell; faces between an active and an
+   * inactive cell are computed by the active cell. The fluxes are integrated
+   * over the smallest time step of both cells.
+   *
+   * The functor should only be called for active cells.
+   */
+  class HydroActiveFluxComputation {
+  private:
+    /*! @brief Reference to the underlying HydroIntegrator. */
+    HydroIntegrator &_hydro_integrator;
+
+    /*! @brief Reference to the grid. */
+    DensityGrid &_grid;
+
+    /*! @brief Iterator to the end of the grid. */
+    const DensityGrid::iterator &_grid_end;
+
+    /*! @brief Current integer time within the system time step. */
+    const uint64_t _current_time;
+
+    /*! @brief Physical time step corresponding to an integer time step of 1
+     *  (in s). */
+    const double _timestep_unit;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param hydro_integrator Reference to the underlying HydroIntegrator.
+     * @param grid Reference to the DensityGrid.
+     * @param grid_end Iterator to the end of the grid.
+     * @param current_time Current integer time within the system time step.
+     * @param timestep_unit Physical time step corresponding to an integer time
+     * step of 1 (in s).
+     */
+    inline HydroActiveFluxComputation(HydroIntegrator &hydro_integrator,
+                                      DensityGrid &grid,
+                                      const DensityGrid::iterator &grid_end,
+                                      uint64_t current_time,
+                                      double timestep_unit)
+        : _hydro_integrator(hydro_integrator), _grid(grid), _grid_end(grid_end),
+          _current_time(current_time), _timestep_unit(timestep_unit) {}
+
+    /**
+     * @brief Compute the fluxes through all active faces of a single cell of
+     * the grid.
+     *
+     * @param cell DensityGrid::iterator pointing to a grid cell.
+     */
+    inline void operator()(DensityGrid::iterator &cell) {
+
+      const cellsize_t index = cell.get_index();
+      const uint64_t cell_timestep = _hydro_integrator._cell_timesteps[index];
+
+      const cellsize_t end_index = _grid_end.get_index();
+      const size_t face_end = _hydro_integrator._face_offsets[index + 1];
+      for (size_t iface = _hydro_integrator._face_offsets[index];
+           iface < face_end; ++iface) {
+        const cellsize_t right = _hydro_integrator._face_right_index[iface];
+        uint64_t face_timestep = cell_timestep;
+        if (right != end_index) {
+          face_timestep = std::min(face_timestep,
+                                   _hydro_integrator._cell_timesteps[right]);
+        }
+        const DensityGrid::iterator ngb(right, _grid);
+        _hydro_integrator.compute_fluxes(
+            _grid, _grid_end, cell, ngb,
+            _hydro_integrator._face_midpoints[iface],
+            _hydro_integrator._face_normals[iface],
+            _hydro_integrator._face_areas[iface],
+            face_timestep * _timestep_unit,
+            &_hydro_integrator._face_fluxes[5 * iface]);
+      }
+
+      const size_t right_face_end =
+          _hydro_integrator._right_face_offsets[index + 1];
+      for (size_t i_right = _hydro_integrator._right_face_offsets[index];
+           i_right < right_face_end; ++i_right) {
+        const size_t iface = _hydro_integrator._right_faces[i_right];
+        const cellsize_t left = _hydro_integrator._face_left_index[iface];
+        if (!_hydro_integrator.is_active(left, _current_time)) {
+          const uint64_t face_timestep =
+              std::min(cell_timestep, _hydro_integrator._cell_timesteps[left]);
+          const DensityGrid::iterator left_cell(left, _grid);
+          _hydro_integrator.compute_fluxes(
+              _grid, _grid_end, left_cell, cell,
+              _hydro_integrator._face_midpoints[iface],
+              _hydro_integrator._face_normals[iface],
+              _hydro_integrator._face_areas[iface],
+              face_timestep * _timestep_unit,
+              &_hydro_integrator._face_fluxes[5 * iface]);
+        }
+      }
+    }
+  };
+
+  /**
+   * @brief Functor that adds the fluxes through all active faces of a single
+   * cell to the conserved variables of that cell during a substep of the
+   * individual time stepping scheme.
+   *
+   * The functor should be called for all active cells and all their
+   * neighbours. Every cell only updates its own variables, so that the
+   * functor can be applied to different cells in parallel.
+   */
+  class HydroActiveFluxAccumulation {
+  private:
+    /*! @brief Reference to the underlying HydroIntegrator. */
+    const HydroIntegrator &_hydro_integrator;
+
+    /*! @brief Index of the end of the grid. */
+    const cellsize_t _end_index;
+
+    /*! @brief Current integer time within the system time step. */
+    const uint64_t _current_time;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param hydro_integrator Reference to the underlying HydroIntegrator.
+     * @param end_index Index of the end of the grid.
+     * @param current_time Current integer time within the system time step.
+     */
+    inline HydroActiveFluxAccumulation(const HydroIntegrator &hydro_integrator,
+                                       const cellsize_t end_index,
+                                       const uint64_t current_time)
+        : _hydro_integrator(hydro_integrator), _end_index(end_index),
+          _current_time(current_time) {}
+
+    /**
+     * @brief Add the fluxes through all active faces of a single cell of the
+     * grid, add the radiation source terms if the cell is active, and apply
+     * the resulting conserved variable differences.
+     *
+     * @param cell DensityGrid::iterator pointing to a grid cell.
+     */
+    inline void operator()(DensityGrid::iterator &cell) {
+
+      const cellsize_t index = cell.get_index();
+      const bool cell_active =
+          _hydro_integrator.is_active(index, _current_time);
+
+      double delta[5] = {0., 0., 0., 0., 0.};
+      const size_t face_end = _hydro_integrator._face_offsets[index + 1];
+      for (size_t iface = _hydro_integrator._face_offsets[index];
+           iface < face_end; ++iface) {
+        const cellsize_t right = _hydro_integrator._face_right_index[iface];
+        const bool face_active =
+            cell_active || (right != _end_index &&
+                            _hydro_integrator.is_active(right, _current_time));
+        if (face_active) {
+          const double *fluxes = &_hydro_integrator._face_fluxes[5 * iface];
+          for (uint_fast8_t i = 0; i < 5; ++i) {
+            delta[i] += fluxes[i];
+          }
+        }
+      }
+      const size_t right_face_end =
+          _hydro_integrator._right_face_offsets[index + 1];
+      for (size_t i_right = _hydro_integrator._right_face_offsets[index];
+           i_right < right_face_end; ++i_right) {
+        const size_t iface = _hydro_integrator._right_faces[i_right];
+        const cellsize_t left = _hydro_integrator._face_left_index[iface];
+        if (cell_active || _hydro_integrator.is_active(left, _current_time)) {
+          const double *fluxes = &_hydro_integrator._face_fluxes[5 * iface];
+          for (uint_fast8_t i = 0; i < 5; ++i) {
+            delta[i] -= fluxes[i];
+          }
+        }
+      }
+
+      HydroVariables &hydro_variables = cell.get_hydro_variables();
+      for (uint_fast8_t i = 0; i < 5; ++i) {
+        hydro_variables.delta_conserved(i) += delta[i];
+      }
+      if (cell_active) {
+        _hydro_integrator.add_radiation_source_terms(cell);
+      }
+      update_conserved_variables(cell);
+    }
+  };
+
+  /**
+   * @brief Functor that updates the primitive variables of a single cell.
+   */
+  class HydroPrimitiveVariableUpdate {
+  private:
+    /*! @brief Reference to the underlying HydroIntegrator. */
+    const HydroIntegrator &_hydro_integrator;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param hydro_integrator Reference to the underlying HydroIntegrator.
+     */
+    inline HydroPrimitiveVariableUpdate(
+        const HydroIntegrator &hydro_integrator)
+        : _hydro_integrator(hydro_integrator) {}
+
+    /**
+     * @brief Update the primitive variables of a single cell of the grid.
+     *
+     * @param cell DensityGrid::iterator pointing to a grid cell.
+     */
+    inline void operator()(DensityGrid::iterator &cell) {
+      _hydro_integrator.update_primitive_variables(cell);
+    }
+  };
+
+  /**
+   * @brief Job that executes a function for a range of cells in a list of
+   * cell indices.
+   */
+  template < typename _function_ > class HydroCellListJob {
+  private:
+    /*! @brief Reference to the grid. */
+    DensityGrid &_grid;
+
+    /*! @brief List of cell indices. */
+    const std::vector< cellsize_t > &_cells;
+
+    /*! @brief Index of the first element of the list in the range. */
+    const size_t _begin;
+
+    /*! @brief Index beyond the last element of the list in the range. */
+    const size_t _end;
+
+    /*! @brief Function or functor that should be executed for every cell. It
+     *  should take a DensityGrid::iterator as single parameter. */
+    _function_ &_function;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param grid Reference to the DensityGrid.
+     * @param cells List of cell indices.
+     * @param begin Index of the first element of the list in the range.
+     * @param end Index beyond the last element of the list in the range.
+     * @param function Function or functor that should be executed for every
+     * cell.
+     */
+    inline HydroCellListJob(DensityGrid &grid,
+                            const std::vector< cellsize_t > &cells,
+                            const size_t begin, const size_t end,
+                            _function_ &function)
+        : _grid(grid), _cells(cells), _begin(begin), _end(end),
+          _function(function) {}
+
+    /**
+     * @brief Should the Job be deleted by the Worker when it is finished?
+     *
+     * @return True.
+     */
+    inline bool do_cleanup() const { return true; }
+
+    /**
+     * @brief Call the function for every cell in the range.
+     */
+    inline void execute() {
+      for (size_t i = _begin; i < _end; ++i) {
+        DensityGrid::iterator cell(_cells[i], _grid);
+        _function(cell);
+      }
+    }
+
+    /**
+     * @brief Get a name tag for this job.
+     *
+     * @return "hydro_cell_list".
+     */
+    inline std::string get_tag() const { return "hydro_cell_list"; }
+  };
+
+  /**
+   * @brief JobMarket that spawns HydroCellListJobs that together cover a list
+   * of cell indices.
+   */
+  template < typename _function_ > class HydroCellListJobMarket {
+  private:
+    /*! @brief Reference to the grid. */
+    DensityGrid &_grid;
+
+    /*! @brief List of cell indices. */
+    const std::vector< cellsize_t > &_cells;
+
+    /*! @brief Function or functor that should be executed for every cell. */
+    _function_ &_function;
+
+    /*! @brief Scheduler that distributes the list over the threads. */
+    WorkStealingScheduler _scheduler;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param grid Reference to the DensityGrid.
+     * @param cells List of cell indices.
+     * @param function Function or functor that should be executed for every
+     * cell.
+     */
+    inline HydroCellListJobMarket(DensityGrid &grid,
+                                  const std::vector< cellsize_t > &cells,
+                                  _function_ &function)
+        : _grid(grid), _cells(cells), _function(function),
+          _scheduler(1.e-3, 100) {}
+
+    /**
+     * @brief Set the number of parallel threads that will be used to execute
+     * the jobs.
+     *
+     * @param worksize Number of parallel threads that will be used.
+     */
+    inline void set_worksize(int_fast32_t worksize) {
+      _scheduler.reset(0, _cells.size(), worksize);
+    }
+
+    /**
+     * @brief Get a HydroCellListJob.
+     *
+     * @param thread_id Id of the thread that calls this function.
+     * @return Pointer to a unique and thread safe HydroCellListJob instance
+     * (or a nullptr if the entire list has been handed out).
+     */
+    inline HydroCellListJob< _function_ > *get_job(int_fast32_t thread_id) {
+      uint_fast64_t begin, end;
+      if (!_scheduler.get_chunk(thread_id, begin, end)) {
+        return nullptr;
+      }
+      return new HydroCellListJob< _function_ >(_grid, _cells, begin, end,
+                                                _function);
+    }
+  };
+
+  /**
+   * @brief Check if the cell with the given index is active at the given
+   * integer time, i.e. if it starts a new individual time step.
+   *
+   * @param index Index of a cell.
+   * @param current_time Integer time within the system time step.
+   * @return True if the cell is active.
+   */
+  inline bool is_active(const cellsize_t index,
+                        const uint64_t current_time) const {
+    return current_time % _cell_timesteps[index] == 0;
+  }
+
+  /**
+   * @brief Get the maximal time step that will lead to a stable integration
+   * for the given cell.
+   *
+   * @param cell DensityGrid::iterator pointing to a grid cell.
+   * @return Maximal time step for that cell (in s).
+   */
+  inline double get_cell_timestep(const DensityGrid::iterator &cell) const {
+    const double rho = cell.get_hydro_variables().get_primitives_density();
+    const double P = cell.get_hydro_variables().get_primitives_pressure();
+    const double cs = std::sqrt(_gamma * P / rho);
+    const double v =
+        cell.get_hydro_variables().get_primitives_velocity().norm();
+    const double V = cell.get_volume();
+    const double R = std::cbrt(0.75 * V / M_PI);
+    return 0.2 * R / (cs + v);
+  }
+
+  /**
+   * @brief Add the radiative heating and cooling source terms to the conserved
+   * variable differences of the given cell (if enabled).
+   *
+   * @param cell DensityGrid::iterator pointing to a grid cell.
+   */
+  inline void add_radiation_source_terms(DensityGrid::iterator &cell) const {
+
+    if (!_do_radiative_heating && !_do_radiative_cooling) {
+      return;
+    }
+
+    const double boltzmann_k =
+        PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_BOLTZMANN);
+    const double mH =
+        PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_PROTON_MASS);
+
+    const IonizationVariablesReference ionization_variables =
+        cell.get_ionization_variables();
+
+    const double xH = ionization_variables.get_ionic_fraction(ION_H_n);
+    const double mpart = xH * mH + 0.5 * (1. - xH) * mH;
+    const double Tgas = 1.e4 * (1. - xH) + 1.e2 * xH;
+    const double ugas = boltzmann_k * Tgas / _gm1 / mpart;
+    const double uold = cell.get_hydro_variables().get_primitives_pressure() /
+                        _gm1 /
+                        cell.get_hydro_variables().get_primitives_density();
+    const double du = ugas - uold;
+    const double dE = cell.get_hydro_variables().get_conserved_mass() * du;
+    if (_do_radiative_heating && dE > 0.) {
+      cell.get_hydro_variables().delta_conserved(4) -= dE;
+    }
+    if (_do_radiative_cooling && dE < 0.) {
+      cell.get_hydro_variables().delta_conserved(4) -= dE;
+    }
+  }
+
+  /**
+   * @brief Apply the conserved variable differences of the given cell and
+   * reset them.
+   *
+   * @param cell DensityGrid::iterator pointing to a grid cell.
+   */
+  inline static void update_conserved_variables(DensityGrid::iterator &cell) {
+    HydroVariables &hydro_variables = cell.get_hydro_variables();
+    for (uint_fast8_t i = 0; i < 5; ++i) {
+      hydro_variables.conserved(i) -= hydro_variables.delta_conserved(i);
+      // reset time differences
+      hydro_variables.delta_conserved(i) = 0.;
+    }
+  }
+
+  /**
+   * @brief Convert the conserved variables of the given cell to primitive
+   * variables, and set the number density and temperature to the
+   * corresponding values.
+   *
+   * @param cell DensityGrid::iterator pointing to a grid cell.
+   */
+  inline void update_primitive_variables(DensityGrid::iterator &cell) const {
 
-/**
- * @brief Class that performs the hydrodynamical integration.
- */
-class HydroIntegrator {
-private:
-  /*! @brief Adiabatic index of the gas. */
-  const double _gamma;
+    const double hydrogen_mass =
+        PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_PROTON_MASS);
+    const double boltzmann_k =
+        PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_BOLTZMANN);
 
-  /*! @brief Adiabatic index minus one. */
-  const double _gm1;
+    const double volume = cell.get_volume();
+    const double mass = cell.get_hydro_variables().get_conserved_mass();
+    const CoordinateVector<> momentum =
+        cell.get_hydro_variables().get_conserved_momentum();
+    const double total_energy =
+        cell.get_hydro_variables().get_conserved_total_energy();
 
-  /*! @brief Inverse of adiabatic index minus one. */
-  const double _gm1_inv;
+    double density, pressure;
+    CoordinateVector<> velocity;
+    if (mass <= 0.) {
+      if (mass < 0.) {
+        cmac_error("Negative mass for cell!");
+      }
+      // vacuum
+      density = 0.;
+      velocity = CoordinateVector<>(0.);
+      pressure = 0.;
+    } else {
+      density = mass / volume;
+      velocity = momentum / mass;
+      // E = V*(rho*u + 0.5*rho*v^2) = (V*P/(gamma-1) + 0.5*m*v^2)
+      // P = (E - 0.5*m*v^2)*(gamma-1)/V
+      pressure = _gm1 *
+                 (total_energy -
+                  0.5 * CoordinateVector<>::dot_product(velocity, momentum)) /
+                 volume;
+    }
 
-  /*! @brief Flag indicating whether we use radiative heating or not. */
-  const bool _do_radiative_heating;
+    cmac_assert(density >= 0.);
+    cmac_assert(pressure >= 0.);
 
-  /*! @brief Flag indicating whether we want radiative cooling or not. */
-  const bool _do_radiative_cooling;
+    cell.get_hydro_variables().set_primitives_density(density);
+    cell.get_hydro_variables().set_primitives_velocity(velocity);
+    cell.get_hydro_variables().set_primitives_pressure(pressure);
 
-  /*! @brief Exact Riemann solver used to solve the Riemann problem. */
-  const RiemannSolver _solver;
+    IonizationVariablesReference ionization_variables =
+        cell.get_ionization_variables();
 
-  /*! @brief Boundary conditions to apply to each boundary. */
-  const HydroBoundaryConditionType _boundaries[6];
+    ionization_variables.set_number_density(density / hydrogen_mass);
+    const double mean_molecular_mass =
+        ionization_variables.get_ionic_fraction(ION_H_n) * hydrogen_mass +
+        0.5 * (1. - ionization_variables.get_ionic_fraction(ION_H_n)) *
+            hydrogen_mass;
+    ionization_variables.set_temperature(mean_molecular_mass * pressure /
+                                         boltzmann_k / density);
+
+    cmac_assert(ionization_variables.get_number_density() >= 0.);
+    cmac_assert(ionization_variables.get_temperature() >= 0.);
+  }
 
   /**
-   * @brief Get the HydroBoundaryConditionType corresponding to the given type
-   * string.
+   * @brief Get the time step bin corresponding to the given integer time step.
    *
-   * @param type std::string representation of a boundary condition type.
-   * @return Corresponding HydroBoundaryConditionType.
+   * @param timestep Integer time step (a power of two).
+   * @return Time step bin: the base 2 logarithm of the time step.
    */
-  static HydroBoundaryConditionType get_boundary_type(std::string type) {
-    if (type == "periodic") {
-      return HYDRO_BOUNDARY_PERIODIC;
-    } else if (type == "reflective") {
-      return HYDRO_BOUNDARY_REFLECTIVE;
-    } else if (type == "inflow") {
-      return HYDRO_BOUNDARY_INFLOW;
-    } else {
-      cmac_error("Unknown boundary condition type: %s!", type.c_str());
-      return HYDRO_BOUNDARY_INVALID;
+  inline static uint_fast32_t get_timestep_bin(const uint64_t timestep) {
+    uint_fast32_t bin = 0;
+    while ((1ull << bin) < timestep) {
+      ++bin;
     }
+    return bin;
   }
 
   /**
-   * @brief Functor that does the flux computation for a single cell.
+   * @brief Get the highest time step bin that is active at the given integer
+   * time.
+   *
+   * A cell is active if its time step divides the current time, so all bins
+   * up to the bin of the largest power of two that divides the current time
+   * are active.
+   *
+   * @param current_time Integer time within the system time step.
+   * @return Highest active time step bin.
    */
-  class HydroFluxComputation {
-  private:
-    /*! @brief Reference to the underlying HydroIntegrator. */
-    const HydroIntegrator &_hydro_integrator;
+  inline static uint_fast32_t get_highest_active_bin(
+      const uint64_t current_time) {
+    if (current_time == 0) {
+      return HYDROINTEGRATOR_MAXIMUM_TIMESTEP_DEPTH;
+    }
+    return get_timestep_bin(current_time & (~current_time + 1));
+  }
 
-    /*! @brief Reference to the grid. */
-    const DensityGrid &_grid;
+  /**
+   * @brief Fill the list of active cells for the given integer time.
+   *
+   * @param current_time Integer time within the system time step.
+   */
+  inline void find_active_cells(const uint64_t current_time) {
+    _active_cells.clear();
+    const uint_fast32_t highest_bin = get_highest_active_bin(current_time);
+    for (uint_fast32_t bin = 0; bin <= highest_bin; ++bin) {
+      _active_cells.insert(_active_cells.end(), _timestep_bins[bin].begin(),
+                           _timestep_bins[bin].end());
+    }
+  }
 
-    /*! @brief Iterator to the end of the grid. */
-    const DensityGrid::iterator &_grid_end;
+  /**
+   * @brief Check if the time step of the inactive cell with the given index was
+   * shortened by the time step limiter during the current substep.
+   *
+   * @param index Index of a cell.
+   * @param current_time Current integer time within the system time step.
+   * @return True if the cell is inactive and has a new time step.
+   */
+  inline bool is_limited(const cellsize_t index,
+                         const uint64_t current_time) const {
+    return !is_active(index, current_time) &&
+           _new_cell_timesteps[index] != _cell_timesteps[index];
+  }
 
-    /*! @brief Integration time step (in s). */
-    const double _timestep;
+  /**
+   * @brief Limit the new time step of the cell with the given index to the
+   * given maximum.
+   *
+   * If the cell is inactive, it is in the middle of its time step. If the
+   * shortened time step still ends in the future, the cell simply finishes its
+   * time step earlier. If not, the cell is woken up: it becomes active at the
+   * current time, with a time step that keeps it on the integer time line.
+   *
+   * Cells whose time step changes are added to the limiter queue, so that the
+   * time steps of their neighbours are checked as well.
+   *
+   * @param index Index of a cell.
+   * @param maximum_timestep Maximum allowed integer time step.
+   * @param current_time Current integer time within the system time step.
+   */
+  inline void limit_timestep(const cellsize_t index,
+                             const uint64_t maximum_timestep,
+                             const uint64_t current_time) {
 
-  public:
-    /**
-     * @brief Constructor.
-     *
-     * @param hydro_integrator Reference to the underlying HydroIntegrator.
-     * @param grid Reference to the DensityGrid.
-     * @param grid_end Iterator to the end of the grid.
-     * @param timestep Integration time step (in s).
-     */
-    inline HydroFluxComputation(const HydroIntegrator &hydro_integrator,
-                                const DensityGrid &grid,
-                                const DensityGrid::iterator &grid_end,
-                                double timestep)
-        : _hydro_integrator(hydro_integrator), _grid(grid), _grid_end(grid_end),
-          _timestep(timestep) {}
+    uint64_t timestep = std::min(_new_cell_timesteps[index], maximum_timestep);
+    if (timestep == _new_cell_timesteps[index]) {
+      return;
+    }
+    if (!is_active(index, current_time)) {
+      const uint64_t start_time =
+          current_time - current_time % _cell_timesteps[index];
+      if (start_time + timestep <= current_time) {
+        // wake up the cell: its time step should divide the current time
+        timestep = std::min(timestep, current_time & (~current_time + 1));
+      }
+      if (_new_cell_timesteps[index] == _cell_timesteps[index]) {
+        _limited_cells.push_back(index);
+      }
+    }
+    _new_cell_timesteps[index] = timestep;
+    _limiter_queue.push_back(index);
+  }
 
-    /**
-     * @brief Do the flux computation for a single cell of the grid.
-     *
-     * @param cell DensityGrid::iterator pointing to a grid cell.
-     */
-    inline void operator()(DensityGrid::iterator &cell) {
+  /**
+   * @brief Get the integer time at which the new time step of the given
+   * limited cell ends.
+   *
+   * @param index Index of a cell for which is_limited() is true.
+   * @param current_time Current integer time within the system time step.
+   * @return Integer time at which the shortened time step ends (the current
+   * time if the cell was woken up).
+   */
+  inline uint64_t get_limited_timestep_end(const cellsize_t index,
+                                           const uint64_t current_time) const {
+    const uint64_t timestep = _new_cell_timesteps[index];
+    if (current_time % timestep == 0) {
+      return current_time;
+    }
+    return current_time - current_time % _cell_timesteps[index] + timestep;
+  }
 
-      const double rhoL = cell.get_hydro_variables().get_primitives_density();
-      const CoordinateVector<> uL =
-          cell.get_hydro_variables().get_primitives_velocity();
-      const double PL = cell.get_hydro_variables().get_primitives_pressure();
-      auto ngbs = cell.get_neighbours();
-      for (auto ngbit = ngbs.begin(); ngbit != ngbs.end(); ++ngbit) {
-        DensityGrid::iterator ngb = std::get< 0 >(*ngbit);
-        // the midpoint is only used if we use a second order scheme
-        const CoordinateVector<> midpoint = std::get< 1 >(*ngbit);
-        const CoordinateVector<> normal = std::get< 2 >(*ngbit);
-        const double surface_area = std::get< 3 >(*ngbit);
-
-        // get the right state
-        double rhoR;
-        CoordinateVector<> uR;
-        double PR;
-        CoordinateVector<> vframe;
-        if (ngb != _grid_end) {
-          rhoR = ngb.get_hydro_variables().get_primitives_density();
-          uR = ngb.get_hydro_variables().get_primitives_velocity();
-          PR = ngb.get_hydro_variables().get_primitives_pressure();
-          vframe = _grid.get_interface_velocity(cell, ngb, midpoint);
-        } else {
-          // apply boundary conditions
-          rhoR = rhoL;
-          uR = uL;
-          if (normal[0] < 0. &&
-              _hydro_integrator._boundaries[0] == HYDRO_BOUNDARY_REFLECTIVE) {
-            uR[0] = -uR[0];
-          }
-          if (normal[0] > 0. &&
-              _hydro_integrator._boundaries[1] == HYDRO_BOUNDARY_REFLECTIVE) {
-            uR[0] = -uR[0];
-          }
-          if (normal[1] < 0. &&
-              _hydro_integrator._boundaries[2] == HYDRO_BOUNDARY_REFLECTIVE) {
-            uR[1] = -uR[1];
-          }
-          if (normal[1] > 0. &&
-              _hydro_integrator._boundaries[3] == HYDRO_BOUNDARY_REFLECTIVE) {
-            uR[1] = -uR[1];
-          }
-          if (normal[2] < 0. &&
-              _hydro_integrator._boundaries[4] == HYDRO_BOUNDARY_REFLECTIVE) {
-            uR[2] = -uR[2];
-          }
-          if (normal[2] > 0. &&
-              _hydro_integrator._boundaries[5] == HYDRO_BOUNDARY_REFLECTIVE) {
-            uR[2] = -uR[2];
-          }
-          PR = PL;
+  /**
+   * @brief Remove the part of the flux through the given face that was
+   * integrated beyond the new end of the time step of the given limited cell.
+   *
+   * Fluxes are integrated over the entire face time step at the start of that
+   * time step, so when a cell is shortened or woken up, the fluxes through its
+   * faces that extend beyond its new end time are partially undone for both
+   * cells. Faces between two limited cells are only treated once, by the cell
+   * with the smallest index.
+   *
+   * @param grid DensityGrid on which to operate.
+   * @param index Index of a limited cell.
+   * @param iface Index of a face of that cell.
+   * @param ngb Index of the other cell of the face (the index of the end of the
+   * grid for a boundary face).
+   * @param end_index Index of the end of the grid.
+   * @param current_time Current integer time within the system time step.
+   */
+  inline void undo_face_flux(DensityGrid &grid, const cellsize_t index,
+                             const size_t iface, const cellsize_t ngb,
+                             const cellsize_t end_index,
+                             const uint64_t current_time) {
+
+    const bool ngb_limited =
+        ngb != end_index && is_limited(ngb, current_time);
+    if (ngb_limited && ngb < index) {
+      return;
+    }
+
+    uint64_t face_timestep = _cell_timesteps[index];
+    if (ngb != end_index) {
+      face_timestep = std::min(face_timestep, _cell_timesteps[ngb]);
+    }
+    if (current_time % face_timestep == 0) {
+      // the face time step ends now
+      return;
+    }
+    const uint64_t face_end =
+        current_time - current_time % face_timestep + face_timestep;
+    uint64_t new_face_end = get_limited_timestep_end(index, current_time);
+    if (ngb_limited) {
+      new_face_end = std::min(new_face_end,
+                              get_limited_timestep_end(ngb, current_time));
+    }
+    if (new_face_end >= face_end) {
+      return;
+    }
+
+    const double fraction =
+        static_cast< double >(face_end - new_face_end) / face_timestep;
+    const double *fluxes = &_face_fluxes[5 * iface];
+    const cellsize_t left = _face_left_index[iface];
+    const cellsize_t right = _face_right_index[iface];
+    HydroVariables &left_variables =
+        DensityGrid::iterator(left, grid).get_hydro_variables();
+    for (uint_fast8_t i = 0; i < 5; ++i) {
+      left_variables.conserved(i) += fraction * fluxes[i];
+    }
+    if (right != end_index) {
+      HydroVariables &right_variables =
+          DensityGrid::iterator(right, grid).get_hydro_variables();
+      for (uint_fast8_t i = 0; i < 5; ++i) {
+        right_variables.conserved(i) -= fraction * fluxes[i];
+      }
+    }
+  }
+
+  /**
+   * @brief Assign new individual time steps to all cells that are active at
+   * the given integer time.
+   *
+   * The new time step is the largest power of two fraction of the system time
+   * step that is smaller than the maximal stable time step of the cell, and
+   * that keeps the cell synchronised with the integer time line.
+   *
+   * The new time steps are then limited so that the time step of every cell is
+   * at most HYDROINTEGRATOR_TIMESTEP_LIMITER times the time step of each of its
+   * neighbours. The limiter works on a separate array of new time steps and
+   * propagates changes through the grid until no time step changes anymore,
+   * so that the result does not depend on the order of the cells. Inactive
+   * neighbours of cells whose time step dropped are shortened or woken up (see
+   * limit_timestep()), and the fluxes they received beyond their new end time
+   * are undone.
+   *
+   * Only the active cells and the cells affected by the limiter are visited.
+   * Since an active cell can only get a time step that is at most as large as
+   * the largest active time step, the active bins are emptied and refilled
+   * with the active cells. Woken up cells are added to the active cells.
+   *
+   * @param grid DensityGrid on which to operate.
+   * @param current_time Current integer time within the system time step.
+   * @param timestep_unit Physical time step corresponding to an integer time
+   * step of 1 (in s).
+   */
+  inline void assign_individual_timesteps(DensityGrid &grid,
+                                          const uint64_t current_time,
+                                          const double timestep_unit) {
+
+    const uint_fast32_t highest_bin = get_highest_active_bin(current_time);
+    // the largest time step that keeps an active cell synchronised: the
+    // largest power of two that divides the current time
+    const uint64_t maximum_timestep = 1ull << highest_bin;
+
+    // compute the new time steps of the active cells
+    _limiter_queue.clear();
+    _limited_cells.clear();
+    for (auto it = _active_cells.begin(); it != _active_cells.end(); ++it) {
+      const cellsize_t index = *it;
+      const DensityGrid::iterator cell(index, grid);
+
+      const double dt = get_cell_timestep(cell);
+      uint64_t timestep = maximum_timestep;
+      while (timestep > 0 && timestep * timestep_unit > dt) {
+        timestep >>= 1;
+      }
+      if (timestep == 0) {
+        cmac_error("Time step wants to be smaller than minimum individual time "
+                   "step: %g (minimum: %g)!",
+                   dt, timestep_unit);
+      }
+      _new_cell_timesteps[index] = timestep;
+      _limiter_queue.push_back(index);
+    }
+
+    // apply the time step limiter
+    const cellsize_t end_index = grid.end().get_index();
+    while (!_limiter_queue.empty()) {
+      const cellsize_t index = _limiter_queue.back();
+      _limiter_queue.pop_back();
+
+      // the time step of the cell is limited by the time steps of its
+      // neighbours...
+      for (size_t iface = _face_offsets[index];
+           iface < _face_offsets[index + 1]; ++iface) {
+        const cellsize_t right = _face_right_index[iface];
+        if (right != end_index) {
+          limit_timestep(index,
+                         HYDROINTEGRATOR_TIMESTEP_LIMITER *
+                             _new_cell_timesteps[right],
+                         current_time);
+        }
+      }
+      for (size_t i_right = _right_face_offsets[index];
+           i_right < _right_face_offsets[index + 1]; ++i_right) {
+        const cellsize_t left = _face_left_index[_right_faces[i_right]];
+        limit_timestep(index,
+                       HYDROINTEGRATOR_TIMESTEP_LIMITER *
+                           _new_cell_timesteps[left],
+                       current_time);
+      }
+
+      // ...and limits the time steps of its neighbours
+      const uint64_t neighbour_maximum =
+          HYDROINTEGRATOR_TIMESTEP_LIMITER * _new_cell_timesteps[index];
+      for (size_t iface = _face_offsets[index];
+           iface < _face_offsets[index + 1]; ++iface) {
+        const cellsize_t right = _face_right_index[iface];
+        if (right != end_index) {
+          limit_timestep(right, neighbour_maximum, current_time);
         }
+      }
+      for (size_t i_right = _right_face_offsets[index];
+           i_right < _right_face_offsets[index + 1]; ++i_right) {
+        const cellsize_t left = _face_left_index[_right_faces[i_right]];
+        limit_timestep(left, neighbour_maximum, current_time);
+      }
+    }
 
-        // boost the velocities to the interface frame (and use new variables,
-        // as we still want to use the old value of uL for other neighbours)
-        const CoordinateVector<> uLframe = uL - vframe;
-        const CoordinateVector<> uRframe = uR - vframe;
-
-        // project the velocities onto the surface normal
-        const double vL = CoordinateVector<>::dot_product(uLframe, normal);
-        const double vR = CoordinateVector<>::dot_product(uRframe, normal);
-
-        // solve the Riemann problem
-        double rhosol, vsol, Psol;
-        const int flag = _hydro_integrator._solver.solve(
-            rhoL, vL, PL, rhoR, vR, PR, rhosol, vsol, Psol);
-
-        // if the solution was vacuum, there is no flux
-        if (flag != 0) {
-          // deproject the velocity
-          CoordinateVector<> usol;
-          if (flag == -1) {
-            vsol -= vL;
-            usol = uLframe + vsol * normal;
-          } else {
-            vsol -= vR;
-            usol = uRframe + vsol * normal;
+    // undo the fluxes that the limited cells received beyond the new end of
+    // their time step, and remove them from their old bins
+    bool update_bin[HYDROINTEGRATOR_MAXIMUM_TIMESTEP_DEPTH + 1] = {false};
+    for (auto it = _limited_cells.begin(); it != _limited_cells.end(); ++it) {
+      const cellsize_t index = *it;
+      for (size_t iface = _face_offsets[index];
+           iface < _face_offsets[index + 1]; ++iface) {
+        undo_face_flux(grid, index, iface, _face_right_index[iface], end_index,
+                       current_time);
+      }
+      for (size_t i_right = _right_face_offsets[index];
+           i_right < _right_face_offsets[index + 1]; ++i_right) {
+        const size_t iface = _right_faces[i_right];
+        undo_face_flux(grid, index, iface, _face_left_index[iface], end_index,
+                       current_time);
+      }
+      update_bin[get_timestep_bin(_cell_timesteps[index])] = true;
+    }
+    for (uint_fast32_t bin = 0; bin <= HYDROINTEGRATOR_MAXIMUM_TIMESTEP_DEPTH;
+         ++bin) {
+      if (bin <= highest_bin) {
+        _timestep_bins[bin].clear();
+      } else if (update_bin[bin]) {
+        std::vector< cellsize_t > &cells = _timestep_bins[bin];
+        size_t new_size = 0;
+        for (size_t i = 0; i < cells.size(); ++i) {
+          if (!is_limited(cells[i], current_time)) {
+            cells[new_size] = cells[i];
+            ++new_size;
           }
+        }
+        cells.resize(new_size);
+      }
+    }
+
+    // store the new time steps
+    for (auto it = _active_cells.begin(); it != _active_cells.end(); ++it) {
+      const cellsize_t index = *it;
+      _cell_timesteps[index] = _new_cell_timesteps[index];
+      _timestep_bins[get_timestep_bin(_cell_timesteps[index])].push_back(index);
+    }
+    for (auto it = _limited_cells.begin(); it != _limited_cells.end(); ++it) {
+      const cellsize_t index = *it;
+      _cell_timesteps[index] = _new_cell_timesteps[index];
+      _timestep_bins[get_timestep_bin(_cell_timesteps[index])].push_back(index);
+      if (is_active(index, current_time)) {
+        // the cell was woken up: it starts a new time step now
+        DensityGrid::iterator cell(index, grid);
+        update_primitive_variables(cell);
+        _active_cells.push_back(index);
+      }
+    }
+  }
 
-          // rho*e = rho*u + 0.5*rho*v^2 = P/(gamma-1.) + 0.5*rho*v^2
-          double rhoesol =
-              0.5 * rhosol * usol.norm2() + Psol * _hydro_integrator._gm1_inv;
-          vsol = CoordinateVector<>::dot_product(usol, normal);
-
-          // get the fluxes
-          const double mflux = rhosol * vsol * surface_area * _timestep;
-          CoordinateVector<> pflux = rhosol * vsol * usol + Psol * normal;
-          pflux *= surface_area * _timestep;
-          double eflux = (rhoesol + Psol) * vsol * surface_area * _timestep;
-
-          // de-boost fluxes to fixed reference frame
-          const double vframe2 = vframe.norm2();
-          eflux += CoordinateVector<>::dot_product(vframe, pflux) +
-                   0.5 * vframe2 * mflux;
-          pflux += mflux * vframe;
-
-          cell.get_hydro_variables().delta_conserved(0) += mflux;
-          cell.get_hydro_variables().delta_conserved(1) += pflux.x();
-          cell.get_hydro_variables().delta_conserved(2) += pflux.y();
-          cell.get_hydro_variables().delta_conserved(3) += pflux.z();
-          cell.get_hydro_variables().delta_conserved(4) += eflux;
+  /**
+   * @brief Fill the list of cells that receive fluxes during the current
+   * substep: all active cells and their neighbours.
+   *
+   * @param end_index Index of the end of the grid.
+   * @param substep Index of the current substep (starting from 1).
+   */
+  inline void find_touched_cells(const cellsize_t end_index,
+                                 const uint_fast32_t substep) {
+    _touched_cells.clear();
+    for (auto it = _active_cells.begin(); it != _active_cells.end(); ++it) {
+      const cellsize_t index = *it;
+      if (_touched_substep[index] != substep) {
+        _touched_substep[index] = substep;
+        _touched_cells.push_back(index);
+      }
+      for (size_t iface = _face_offsets[index];
+           iface < _face_offsets[index + 1]; ++iface) {
+        const cellsize_t right = _face_right_index[iface];
+        if (right != end_index && _touched_substep[right] != substep) {
+          _touched_substep[right] = substep;
+          _touched_cells.push_back(right);
+        }
+      }
+      for (size_t i_right = _right_face_offsets[index];
+           i_right < _right_face_offsets[index + 1]; ++i_right) {
+        const cellsize_t left = _face_left_index[_right_faces[i_right]];
+        if (_touched_substep[left] != substep) {
+          _touched_substep[left] = substep;
+          _touched_cells.push_back(left);
         }
       }
     }
-  };
+  }
+
+  /**
+   * @brief Do a single hydrodynamical system time step using individual time
+   * steps for the cells.
+   *
+   * Every cell is assigned a time step that is a power of two fraction of the
+   * system time step, and is stored in the corresponding time step bin. The
+   * system time step is then subdivided into substeps; during every substep
+   * only the active cells (the cells in the active bins) and their neighbours
+   * are visited, so that the cost of a substep scales with the number of
+   * active cells rather than with the total number of cells. Fluxes through a
+   * face are always applied to both cells, so that the scheme remains
+   * conservative. The primitive variables of a cell are only updated at the
+   * end of its time step.
+   *
+   * @param grid DensityGrid on which to operate.
+   * @param timestep System time step over which to evolve the system (in s).
+   * @param serial_timer Timer that times the time spent in serial parts of the
+   * algorithm.
+   * @param parallel_timer Timer that times the time spent in parallel parts of
+   * the algorithm.
+   */
+  inline void do_individual_hydro_step(DensityGrid &grid, double timestep,
+                                       Timer &serial_timer,
+                                       Timer &parallel_timer) {
+
+    if (grid.has_moving_geometry()) {
+      cmac_error("Individual time steps are not supported for grids with a "
+                 "moving geometry!");
+    }
+
+    const DensityGrid::iterator grid_end = grid.end();
+    const cellsize_t end_index = grid_end.get_index();
+    const cellsize_t numcell = grid.get_number_of_cells();
+
+    const uint64_t system_timestep = 1ull
+                                     << HYDROINTEGRATOR_MAXIMUM_TIMESTEP_DEPTH;
+    const double timestep_unit = timestep / system_timestep;
+
+    // at the start of the system time step, all cells are active
+    _cell_timesteps.assign(numcell, system_timestep);
+    _new_cell_timesteps.assign(numcell, system_timestep);
+    _timestep_bins.resize(HYDROINTEGRATOR_MAXIMUM_TIMESTEP_DEPTH + 1);
+    for (uint_fast32_t bin = 0; bin < HYDROINTEGRATOR_MAXIMUM_TIMESTEP_DEPTH;
+         ++bin) {
+      _timestep_bins[bin].clear();
+    }
+    _timestep_bins[HYDROINTEGRATOR_MAXIMUM_TIMESTEP_DEPTH].resize(numcell);
+    for (cellsize_t i = 0; i < numcell; ++i) {
+      _timestep_bins[HYDROINTEGRATOR_MAXIMUM_TIMESTEP_DEPTH][i] = i;
+    }
+    _touched_substep.assign(numcell, 0);
+
+    WorkDistributor< HydroCellListJobMarket< HydroActiveFluxComputation >,
+                     HydroCellListJob< HydroActiveFluxComputation > >
+        flux_workers;
+    WorkDistributor< HydroCellListJobMarket< HydroActiveFluxAccumulation >,
+                     HydroCellListJob< HydroActiveFluxAccumulation > >
+        accumulation_workers;
+    WorkDistributor< HydroCellListJobMarket< HydroPrimitiveVariableUpdate >,
+                     HydroCellListJob< HydroPrimitiveVariableUpdate > >
+        primitive_workers;
+    HydroPrimitiveVariableUpdate primitive_update(*this);
+
+    _last_number_of_substeps = 0;
+    _last_number_of_cell_updates = 0;
+    uint64_t current_time = 0;
+    find_active_cells(current_time);
+    while (current_time < system_timestep) {
+
+      assign_individual_timesteps(grid, current_time, timestep_unit);
+      _last_number_of_cell_updates += _active_cells.size();
+      ++_last_number_of_substeps;
+
+      // compute the fluxes through all active faces (in parallel)
+      HydroActiveFluxComputation hydro_flux_computation(
+          *this, grid, grid_end, current_time, timestep_unit);
+      HydroCellListJobMarket< HydroActiveFluxComputation > flux_jobs(
+          grid, _active_cells, hydro_flux_computation);
+      hydro_start_parallel_timing_block();
+      flux_workers.do_in_parallel(flux_jobs);
+      hydro_stop_parallel_timing_block();
+
+      // add the fluxes to both cells of every active face, add the radiation
+      // source terms for the active cells, and update the conserved variables
+      // of all cells that received fluxes (in parallel)
+      find_touched_cells(end_index, _last_number_of_substeps);
+      HydroActiveFluxAccumulation hydro_flux_accumulation(*this, end_index,
+                                                          current_time);
+      HydroCellListJobMarket< HydroActiveFluxAccumulation > accumulation_jobs(
+          grid, _touched_cells, hydro_flux_accumulation);
+      hydro_start_parallel_timing_block();
+      accumulation_workers.do_in_parallel(accumulation_jobs);
+      hydro_stop_parallel_timing_block();
+
+      // find the next substep: the first end of a time step in the lowest
+      // non-empty bin (cells that were shortened by the time step limiter are
+      // not necessarily synchronised with the current time)
+      uint_fast32_t lowest_bin = 0;
+      while (_timestep_bins[lowest_bin].empty()) {
+        ++lowest_bin;
+      }
+      const uint64_t lowest_timestep = 1ull << lowest_bin;
+      current_time += lowest_timestep - current_time % lowest_timestep;
+
+      // update the primitive variables of all cells that reached the end of
+      // their time step (in parallel): these are the active cells of the next
+      // substep
+      find_active_cells(current_time);
+      HydroCellListJobMarket< HydroPrimitiveVariableUpdate > primitive_jobs(
+          grid, _active_cells, primitive_update);
+      hydro_start_parallel_timing_block();
+      primitive_workers.do_in_parallel(primitive_jobs);
+      hydro_stop_parallel_timing_block();
+    }
+
+    grid.evolve(timestep);
+    grid.set_grid_velocity(_gamma);
+  }
 
 public:
   /**
@@ -257,6 +1708,13 @@ public:
    * @param boundary_zhigh Type of boundary for the upper z boundary.
    * @param box_periodicity Periodicity flags for the grid box (used to check
    * the validity of the boundary condition types).
+   * @param individual_timesteps Flag indicating whether to use individual time
+   * steps for the cells or not.
+   * @param hllc_threshold Maximum pressure ratio across an interface for which
+   * the approximate HLLC Riemann solver is used instead of the exact solver
+   * (the velocity jump in units of the smallest soundspeed should also be
+   * smaller than this value minus one; values smaller than 1 disable the HLLC
+   * solver).
    */
   inline HydroIntegrator(double gamma, bool do_radiative_heating,
                          bool do_radiative_cooling,
@@ -267,7 +1725,9 @@ public:
                          std::string boundary_zlow = "reflective",
                          std::string boundary_zhigh = "reflective",
                          CoordinateVector< bool > box_periodicity =
-                             CoordinateVector< bool >(false))
+                             CoordinateVector< bool >(false),
+                         bool individual_timesteps = false,
+                         double hllc_threshold = 0.)
       : _gamma(gamma), _gm1(_gamma - 1.), _gm1_inv(1. / _gm1),
         _do_radiative_heating(do_radiative_heating),
         _do_radiative_cooling(do_radiative_cooling), _solver(gamma),
@@ -276,7 +1736,10 @@ public:
                     get_boundary_type(boundary_ylow),
                     get_boundary_type(boundary_yhigh),
                     get_boundary_type(boundary_zlow),
-                    get_boundary_type(boundary_zhigh)} {
+                    get_boundary_type(boundary_zhigh)},
+        _individual_timesteps(individual_timesteps),
+        _hllc_threshold(hllc_threshold), _face_grid(nullptr),
+        _last_number_of_substeps(0), _last_number_of_cell_updates(0) {
 
     if (_boundaries[0] == HYDRO_BOUNDARY_PERIODIC) {
       if (_boundaries[1] != HYDRO_BOUNDARY_PERIODIC) {
@@ -330,6 +1793,13 @@ public:
    *    (periodic/reflective/inflow, default: reflective)
    *  - boundary z high: Boundary condition type for the upper z boundary
    *    (periodic/reflective/inflow, default: reflective)
+   *  - individual timesteps: Use individual power of two time steps for the
+   *    cells instead of a single global time step (default: false)
+   *  - HLLC threshold: Maximum pressure ratio across an interface for which the
+   *    approximate HLLC Riemann solver is used instead of the exact solver; the
+   *    velocity jump in units of the smallest soundspeed should also be smaller
+   *    than this value minus one (values smaller than 1 disable the HLLC
+   *    solver, default: 0.)
    *
    * @param simulation_box SimulationBox.
    * @param params ParameterFile to read from.
@@ -354,7 +1824,11 @@ public:
                                             "reflective"),
             params.get_value< std::string >("HydroIntegrator:boundary z high",
                                             "reflective"),
-            simulation_box.get_periodicity()) {}
+            simulation_box.get_periodicity(),
+            params.get_value< bool >("HydroIntegrator:individual timesteps",
+                                     false),
+            params.get_value< double >("HydroIntegrator:HLLC threshold", 0.)) {
+  }
 
   /**
    * @brief Initialize the hydro variables for the given DensityGrid.
@@ -409,29 +1883,78 @@ public:
    * @brief Get the maximal system time step that will lead to a stable
    * integration.
    *
+   * If individual time steps are used, this is the largest time step of all
+   * cells, as cells with a smaller time step will subdivide the system time
+   * step. Note that the radiation step of a RadiationHydrodynamicsSimulation
+   * is only done once per system time step, so that the ionization state of
+   * cells with small time steps is kept fixed during all of their substeps.
+   * The coupling between radiation and hydrodynamics hence becomes coarser
+   * than with a global time step; the "radiation time" parameter of the
+   * RadiationHydrodynamicsSimulation can be used to limit the system time
+   * step.
+   *
    * @param grid DensityGrid on which to operate.
    * @return Maximal system time step that yields a stable integration (in s).
    */
   inline double get_maximal_timestep(DensityGrid &grid) const {
 
     double dtmin = DBL_MAX;
+    double dtmax = 0.;
     for (auto it = grid.begin(); it != grid.end(); ++it) {
-      const double rho = it.get_hydro_variables().get_primitives_density();
-      const double P = it.get_hydro_variables().get_primitives_pressure();
-      const double cs = std::sqrt(_gamma * P / rho);
-      const double v =
-          it.get_hydro_variables().get_primitives_velocity().norm();
-      const double V = it.get_volume();
-      const double R = std::cbrt(0.75 * V / M_PI);
-      const double dt = 0.2 * R / (cs + v);
+      const double dt = get_cell_timestep(it);
       dtmin = std::min(dt, dtmin);
+      dtmax = std::max(dt, dtmax);
+    }
+    if (_individual_timesteps) {
+      return dtmax;
+    } else {
+      return dtmin;
     }
-    return dtmin;
+  }
+
+  /**
+   * @brief Check if the cells use individual time steps.
+   *
+   * @return True if individual time steps are used.
+   */
+  inline bool has_individual_timesteps() const { return _individual_timesteps; }
+
+  /**
+   * @brief Get the current integer time step of the cell with the given index.
+   *
+   * @param index Index of a cell.
+   * @return Integer time step of the cell (in units of the smallest possible
+   * individual time step).
+   */
+  inline uint64_t get_individual_timestep(const cellsize_t index) const {
+    return _cell_timesteps[index];
+  }
+
+  /**
+   * @brief Get the number of substeps taken during the last system time step.
+   *
+   * @return Number of substeps (1 if individual time steps are disabled).
+   */
+  inline uint_fast32_t get_last_number_of_substeps() const {
+    return _last_number_of_substeps;
+  }
+
+  /**
+   * @brief Get the number of individual cell updates during the last system
+   * time step.
+   *
+   * @return Number of cell updates.
+   */
+  inline uint_fast64_t get_last_number_of_cell_updates() const {
+    return _last_number_of_cell_updates;
   }
 
   /**
    * @brief Do a single hydrodynamical time step.
    *
+   * If individual time steps are enabled, the time step is the system time
+   * step, which is subdivided by the individual cell time steps.
+   *
    * @param grid DensityGrid on which to operate.
    * @param timestep Time step over which to evolve the system (in s).
    * @param serial_timer Timer that times the time spent in serial parts of the
@@ -440,7 +1963,7 @@ public:
    * the algorithm.
    */
   inline void do_hydro_step(DensityGrid &grid, double timestep,
-                            Timer &serial_timer, Timer &parallel_timer) const {
+                            Timer &serial_timer, Timer &parallel_timer) {
 
     const DensityGrid::iterator grid_end = grid.end();
     std::pair< cellsize_t, cellsize_t > block =
@@ -461,126 +1984,61 @@ public:
     gradient_workers.do_in_parallel(gradient_jobs);
     hydro_stop_parallel_timing_block();
 
-    // do the flux computation (in parallel)
-    HydroFluxComputation hydro_flux_computation(*this, grid, grid_end,
-                                                timestep);
+    // (re)build the face table if necessary
+    if (_face_grid != &grid ||
+        _face_offsets.size() != grid.get_number_of_cells() + 1) {
+      build_face_table(grid);
+    }
+
+    if (_individual_timesteps) {
+      do_individual_hydro_step(grid, timestep, serial_timer, parallel_timer);
+      return;
+    }
+
+    _last_number_of_substeps = 1;
+    _last_number_of_cell_updates = grid.get_number_of_cells();
 
-    WorkDistributor< DensityGridTraversalJobMarket< HydroFluxComputation >,
-                     DensityGridTraversalJob< HydroFluxComputation > >
+    // do the flux computation (in parallel): every face is solved once...
+    WorkDistributor< HydroFluxComputationJobMarket, HydroFluxComputationJob >
         workers;
-    DensityGridTraversalJobMarket< HydroFluxComputation > jobs(
-        grid, hydro_flux_computation, block);
+    HydroFluxComputationJobMarket jobs(*this, grid, grid_end, timestep);
     hydro_start_parallel_timing_block();
     workers.do_in_parallel(jobs);
     hydro_stop_parallel_timing_block();
 
+    // ...and its fluxes are added to both cells (in parallel)
+    HydroFluxAccumulation hydro_flux_accumulation(*this);
+    WorkDistributor< DensityGridTraversalJobMarket< HydroFluxAccumulation >,
+                     DensityGridTraversalJob< HydroFluxAccumulation > >
+        accumulation_workers;
+    DensityGridTraversalJobMarket< HydroFluxAccumulation > accumulation_jobs(
+        grid, hydro_flux_accumulation, block);
+    hydro_start_parallel_timing_block();
+    accumulation_workers.do_in_parallel(accumulation_jobs);
+    hydro_stop_parallel_timing_block();
+
     // do radiation (if enabled)
     if (_do_radiative_heating || _do_radiative_cooling) {
-      const double boltzmann_k =
-          PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_BOLTZMANN);
-      const double mH = PhysicalConstants::get_physical_constant(
-          PHYSICALCONSTANT_PROTON_MASS);
-
       for (auto it = grid.begin(); it != grid.end(); ++it) {
-        const IonizationVariables &ionization_variables =
-            it.get_ionization_variables();
-
-        const double xH = ionization_variables.get_ionic_fraction(ION_H_n);
-        const double mpart = xH * mH + 0.5 * (1. - xH) * mH;
-        const double Tgas = 1.e4 * (1. - xH) + 1.e2 * xH;
-        const double ugas = boltzmann_k * Tgas / _gm1 / mpart;
-        const double uold = it.get_hydro_variables().get_primitives_pressure() /
-                            _gm1 /
-                            it.get_hydro_variables().get_primitives_density();
-        const double du = ugas - uold;
-        const double dE = it.get_hydro_variables().get_conserved_mass() * du;
-        if (_do_radiative_heating && dE > 0.) {
-          it.get_hydro_variables().delta_conserved(4) -= dE;
-        }
-        if (_do_radiative_cooling && dE < 0.) {
-          it.get_hydro_variables().delta_conserved(4) -= dE;
-        }
+        add_radiation_source_terms(it);
       }
     }
 
     // update conserved variables
     for (auto it = grid.begin(); it != grid.end(); ++it) {
-
-      it.get_hydro_variables().conserved(0) -=
-          it.get_hydro_variables().delta_conserved(0);
-      it.get_hydro_variables().conserved(1) -=
-          it.get_hydro_variables().delta_conserved(1);
-      it.get_hydro_variables().conserved(2) -=
-          it.get_hydro_variables().delta_conserved(2);
-      it.get_hydro_variables().conserved(3) -=
-          it.get_hydro_variables().delta_conserved(3);
-      it.get_hydro_variables().conserved(4) -=
-          it.get_hydro_variables().delta_conserved(4);
-
-      // reset time differences
-      it.get_hydro_variables().delta_conserved(0) = 0.;
-      it.get_hydro_variables().delta_conserved(1) = 0.;
-      it.get_hydro_variables().delta_conserved(2) = 0.;
-      it.get_hydro_variables().delta_conserved(3) = 0.;
-      it.get_hydro_variables().delta_conserved(4) = 0.;
+      update_conserved_variables(it);
     }
 
     grid.evolve(timestep);
+    if (grid.has_moving_geometry()) {
+      // the face table is no longer valid
+      _face_grid = nullptr;
+    }
 
-    const double hydrogen_mass =
-        PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_PROTON_MASS);
-    const double boltzmann_k =
-        PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_BOLTZMANN);
     // convert conserved variables to primitive variables
     // also set the number density and temperature to the correct value
     for (auto it = grid.begin(); it != grid.end(); ++it) {
-      const double volume = it.get_volume();
-      const double mass = it.get_hydro_variables().get_conserved_mass();
-      const CoordinateVector<> momentum =
-          it.get_hydro_variables().get_conserved_momentum();
-      const double total_energy =
-          it.get_hydro_variables().get_conserved_total_energy();
-
-      double density, pressure;
-      CoordinateVector<> velocity;
-      if (mass <= 0.) {
-        if (mass < 0.) {
-          cmac_error("Negative mass for cell!");
-        }
-        // vacuum
-        density = 0.;
-        velocity = CoordinateVector<>(0.);
-        pressure = 0.;
-      } else {
-        density = mass / volume;
-        velocity = momentum / mass;
-        // E = V*(rho*u + 0.5*rho*v^2) = (V*P/(gamma-1) + 0.5*m*v^2)
-        // P = (E - 0.5*m*v^2)*(gamma-1)/V
-        pressure = _gm1 *
-                   (total_energy -
-                    0.5 * CoordinateVector<>::dot_product(velocity, momentum)) /
-                   volume;
-      }
-
-      cmac_assert(density >= 0.);
-      cmac_assert(pressure >= 0.);
-
-      it.get_hydro_variables().set_primitives_density(density);
-      it.get_hydro_variables().set_primitives_velocity(velocity);
-      it.get_hydro_variables().set_primitives_pressure(pressure);
-
-      IonizationVariables &ionization_variables = it.get_ionization_variables();
-
-      ionization_variables.set_number_density(density / hydrogen_mass);
-      const double mean_molecular_mass =
-          ionization_variables.get_ionic_fraction(ION_H_n) * hydrogen_mass +
-          0.5 * (1. - ionization_variables.get_ionic_fraction(ION_H_n)) *
-              hydrogen_mass;
-      ionization_variables.set_temperature(mean_molecular_mass * pressure /
-                                           boltzmann_k / density);
-
-      cmac_assert(ionization_variables.get_number_density() >= 0.);
-      cmac_assert(ionization_variables.get_temperature() >= 0.);
+      update_primitive_variables(it);
     }
 
     grid.set_grid_velocity(_gamma);
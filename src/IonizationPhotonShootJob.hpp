@@ -28,8 +28,17 @@
 
 #include "DensityGrid.hpp"
 #include "Photon.hpp"
+#include "PhotonPacketBatch.hpp"
 #include "PhotonSource.hpp"
 #include "RandomGenerator.hpp"
+#include "Utilities.hpp"
+
+#include <algorithm>
+
+/*! @brief Base 2 exponent of the fixed-point unit used to accumulate the photon
+ *  weights when a counter-based RandomGenerator is used. The weight counters
+ *  are then exact up to a total weight of 2^33. */
+#define IONIZATIONPHOTONSHOOTJOB_WEIGHT_UNIT_EXPONENT -20
 
 /**
  * @brief Job implementation that shoots ionizing photons through a DensityGrid.
@@ -45,6 +54,11 @@ private:
   /*! @brief DensityGrid through which photons are propagated. */
   DensityGrid &_density_grid;
 
+  /*! @brief Accumulate the photon weights in a fixed-point unit, so that the
+   *  weight counters do not depend on the order in which photons are
+   *  propagated? */
+  const bool _reproducible;
+
   /*! @brief Total weight of all photons. */
   double _totweight;
 
@@ -54,6 +68,13 @@ private:
   /*! @brief Number of photons to propagate through the DensityGrid. */
   uint_fast64_t _numphoton;
 
+  /*! @brief Global index of the first photon that is propagated during the
+   *  next execution of the job. */
+  uint_fast64_t _first_photon_index;
+
+  /*! @brief Index of the photon shooting pass the photons belong to. */
+  uint_fast32_t _pass;
+
 public:
   /**
    * @brief Constructor.
@@ -62,20 +83,36 @@ public:
    * @param random_seed Seed for the RandomGenerator used by this specific
    * thread.
    * @param density_grid DensityGrid through which photons are propagated.
+   * @param counter_based Use a counter-based RandomGenerator?
    */
   inline IonizationPhotonShootJob(const PhotonSource &photon_source,
                                   int_fast32_t random_seed,
-                                  DensityGrid &density_grid)
-      : _photon_source(photon_source), _random_generator(random_seed),
-        _density_grid(density_grid), _totweight(0.), _typecount{0.},
-        _numphoton(0) {}
+                                  DensityGrid &density_grid,
+                                  const bool counter_based = false)
+      : _photon_source(photon_source),
+        _random_generator(random_seed, counter_based),
+        _density_grid(density_grid), _reproducible(counter_based),
+        _totweight(0.), _typecount{0.},
+        _numphoton(0), _first_photon_index(0), _pass(0) {}
 
   /**
    * @brief Set the number of photons for the next execution of the job.
    *
+   * The global photon index and the pass index are only used by a
+   * counter-based RandomGenerator, which uses a separate random stream for
+   * every photon.
+   *
    * @param numphoton New number of photons.
+   * @param first_photon_index Global index of the first photon.
+   * @param pass Index of the photon shooting pass.
    */
-  inline void set_numphoton(uint_fast64_t numphoton) { _numphoton = numphoton; }
+  inline void set_numphoton(uint_fast64_t numphoton,
+                            uint_fast64_t first_photon_index = 0,
+                            uint_fast32_t pass = 0) {
+    _numphoton = numphoton;
+    _first_photon_index = first_photon_index;
+    _pass = pass;
+  }
 
   /**
    * @brief Update the given weight counters and reset the internal counters.
@@ -92,6 +129,26 @@ public:
     }
   }
 
+  /**
+   * @brief Write the state of the RandomGenerator of this job to the given
+   * RestartWriter.
+   *
+   * @param restart_writer RestartWriter to write to.
+   */
+  inline void write_restart_file(RestartWriter &restart_writer) const {
+    _random_generator.write_restart_file(restart_writer);
+  }
+
+  /**
+   * @brief Restore the state of the RandomGenerator of this job from the given
+   * RestartReader.
+   *
+   * @param restart_reader RestartReader to read from.
+   */
+  inline void read_restart_file(RestartReader &restart_reader) {
+    _random_generator.read_restart_file(restart_reader);
+  }
+
   /**
    * @brief Should the Job be deleted by the Worker when it is finished?
    *
@@ -103,7 +160,8 @@ public:
   /**
    * @brief Shoot _numphoton photons from _photon_source through _density_grid.
    *
-   * For each photon, we first randomly generate the photon. We then draw a
+   * Photons are generated in batches of at most PHOTONPACKETBATCH_SIZE photons
+   * (see PhotonSource::get_random_photons()). For each photon, we then draw a
    * random optical depth using the distribution function of Steinacker, J.,
    * Baes, M. & Gordon, K. D. 2013, Annu. Rev. Astro. Astrophys., 51, 63
    * (http://adsabs.harvard.edu/abs/2013ARA%26A..51...63S), equation (25). We
@@ -113,10 +171,34 @@ public:
    * is still inside the simulation box, we randomly decide whether we need to
    * reemit it or not. If so, we again draw a random optical depth and repeat
    * the whole procedure until the photon is absorbed or leaves the system.
+   *
+   * If the RandomGenerator is counter-based, every batch of photons is
+   * generated using the random stream for that batch, and every photon is
+   * propagated using the random stream for that photon. The history of a
+   * photon then only depends on its global index, and not on the thread that
+   * executes it (provided that batches are never split across jobs). The
+   * photon weights are then rounded to a fixed-point unit before they are
+   * added to the weight counters, so that the counters are exact sums that do
+   * not depend on the order in which the photons are propagated. Combined with
+   * the reproducible accumulation mode of the DensityGrid (see
+   * DensityGrid::set_reproducible_accumulation()), the result of a photon
+   * shooting pass is then bitwise identical for any number of threads and
+   * processes.
    */
   inline void execute() {
+    PhotonPacketBatch batch;
     for (uint_fast64_t i = 0; i < _numphoton; ++i) {
-      Photon photon = _photon_source.get_random_photon(_random_generator);
+      const uint_fast32_t ibatch = i % PHOTONPACKETBATCH_SIZE;
+      if (ibatch == 0) {
+        _random_generator.set_stream(
+            (_first_photon_index + i) / PHOTONPACKETBATCH_SIZE, 2 * _pass + 1);
+        const uint_fast32_t batch_size =
+            std::min(_numphoton - i, uint_fast64_t(PHOTONPACKETBATCH_SIZE));
+        _photon_source.get_random_photons(_random_generator, batch,
+                                          batch_size);
+      }
+      Photon photon = batch.get_photon(ibatch);
+      _random_generator.set_stream(_first_photon_index + i, 2 * _pass);
       // if a fraction of light alpha is absorbed when the light traverses a
       // small path with length dl in the material, then the spatial change of
       // the number of photons is given by
@@ -140,8 +222,13 @@ public:
         tau = -std::log(_random_generator.get_uniform_random_double());
         it = _density_grid.interact(photon, tau);
       }
-      _totweight += photon.get_weight();
-      _typecount[photon.get_type()] += photon.get_weight();
+      double weight = photon.get_weight();
+      if (_reproducible) {
+        weight = Utilities::round_to_fixed_point(
+            weight, IONIZATIONPHOTONSHOOTJOB_WEIGHT_UNIT_EXPONENT);
+      }
+      _totweight += weight;
+      _typecount[photon.get_type()] += weight;
     }
   }
 
@@ -28,8 +28,9 @@
 #define IONIZATIONPHOTONSHOOTJOBMARKET_HPP
 
 #include "Configuration.hpp"
+#include "Error.hpp"
 #include "IonizationPhotonShootJob.hpp"
-#include "Lock.hpp"
+#include "WorkStealingScheduler.hpp"
 
 class PhotonSource;
 class RandomGenerator;
@@ -50,13 +51,14 @@ private:
   /*! @brief Total number of photons to propagate through the grid. */
   uint_fast64_t _numphoton;
 
-  /*! @brief Number of photons to shoot during a single
-   *  IonizationPhotonShootJob. */
-  const uint_fast64_t _jobsize;
+  /*! @brief Global index of the first photon. */
+  uint_fast64_t _first_photon_index;
 
-  /*! @brief Lock used to ensure safe access to the internal photon number
-   *  counters. */
-  Lock _lock;
+  /*! @brief Index of the current photon shooting pass. */
+  uint_fast32_t _pass;
+
+  /*! @brief Scheduler that distributes the photons over the threads. */
+  WorkStealingScheduler _scheduler;
 
 public:
   /**
@@ -66,33 +68,43 @@ public:
    * @param random_seed Seed for the RandomGenerator.
    * @param density_grid DensityGrid through which photons are propagated.
    * @param numphoton Total number of photons to propagate through the grid.
-   * @param jobsize Number of photons to shoot during a single
+   * @param jobsize Minimum number of photons to shoot during a single
    * IonizationPhotonShootJob.
    * @param worksize Number of threads used in the calculation.
+   * @param counter_based Use counter-based RandomGenerators? If true, all
+   * threads use the same seed and every photon uses its own random stream, so
+   * that the photon histories do not depend on the number of threads. Chunks
+   * of photons then always consist of complete photon batches.
    */
   inline IonizationPhotonShootJobMarket(PhotonSource &photon_source,
                                         int_fast32_t random_seed,
                                         DensityGrid &density_grid,
                                         uint_fast64_t numphoton,
                                         uint_fast64_t jobsize,
-                                        int_fast32_t worksize)
-      : _worksize(worksize), _numphoton(numphoton), _jobsize(jobsize) {
+                                        int_fast32_t worksize,
+                                        const bool counter_based = false)
+      : _worksize(worksize), _numphoton(numphoton), _first_photon_index(0),
+        _pass(0), _scheduler(1.e-3, jobsize, jobsize) {
 
     // create a separate RandomGenerator for each thread.
     // create a single PhotonShootJob for each thread.
     for (int_fast32_t i = 0; i < _worksize; ++i) {
-      _jobs[i] = new IonizationPhotonShootJob(photon_source, random_seed + i,
-                                              density_grid);
+      _jobs[i] = new IonizationPhotonShootJob(
+          photon_source, counter_based ? random_seed : random_seed + i,
+          density_grid, counter_based);
+    }
+    if (counter_based) {
+      _scheduler.set_alignment(PHOTONPACKETBATCH_SIZE);
     }
   }
 
   /**
    * @brief Destructor.
    *
-   * Deletes the internal job array.
+   * Deletes the internal job array, in reverse order of creation.
    */
   inline ~IonizationPhotonShootJobMarket() {
-    for (int_fast32_t i = 0; i < _worksize; ++i) {
+    for (int_fast32_t i = _worksize - 1; i >= 0; --i) {
       delete _jobs[i];
     }
   }
@@ -101,19 +113,32 @@ public:
    * @brief Set the number of parallel threads that will be used to execute
    * the jobs.
    *
+   * This distributes the photons over the per thread queues of the
+   * WorkStealingScheduler.
+   *
    * @param worksize Number of parallel threads that will be used.
    */
-  inline void set_worksize(int_fast32_t worksize) {}
+  inline void set_worksize(int_fast32_t worksize) {
+    _scheduler.reset(0, _numphoton, worksize);
+  }
 
   /**
-   * @brief Set the number of photons.
+   * @brief Set the number of photons for the next photon shooting pass.
    *
    * This routine can be used to reset an IonizationPhotonShootJobMarket that
    * was used before.
    *
    * @param numphoton New number of photons.
+   * @param first_photon_index Global index of the first photon (should be a
+   * multiple of PHOTONPACKETBATCH_SIZE when counter-based RandomGenerators are
+   * used).
    */
-  inline void set_numphoton(uint_fast64_t numphoton) { _numphoton = numphoton; }
+  inline void set_numphoton(uint_fast64_t numphoton,
+                            uint_fast64_t first_photon_index = 0) {
+    _numphoton = numphoton;
+    _first_photon_index = first_photon_index;
+    ++_pass;
+  }
 
   /**
    * @brief Update the given weight counters.
@@ -136,20 +161,51 @@ public:
    */
   inline IonizationPhotonShootJob *get_job(int_fast32_t thread_id) {
 
-    uint_fast64_t jobsize = std::max(_numphoton / (10 * _worksize), _jobsize);
-    _lock.lock();
-    if (jobsize >= _numphoton) {
-      jobsize = _numphoton;
-    }
-    _numphoton -= jobsize;
-    _lock.unlock();
-    if (jobsize > 0) {
-      _jobs[thread_id]->set_numphoton(jobsize);
+    uint_fast64_t begin, end;
+    if (_scheduler.get_chunk(thread_id, begin, end)) {
+      _jobs[thread_id]->set_numphoton(end - begin, _first_photon_index + begin,
+                                      _pass);
       return _jobs[thread_id];
     } else {
       return nullptr;
     }
   }
+
+  /**
+   * @brief Write the state of all jobs to the given RestartWriter.
+   *
+   * @param restart_writer RestartWriter to write to.
+   */
+  inline void write_restart_file(RestartWriter &restart_writer) const {
+    restart_writer.write(_worksize);
+    restart_writer.write(_pass);
+    for (int_fast32_t i = 0; i < _worksize; ++i) {
+      _jobs[i]->write_restart_file(restart_writer);
+    }
+  }
+
+  /**
+   * @brief Restore the state of all jobs from the given RestartReader.
+   *
+   * The number of threads needs to be the same as when the restart file was
+   * written, since every thread has its own random number sequence.
+   *
+   * @param restart_reader RestartReader to read from.
+   */
+  inline void read_restart_file(RestartReader &restart_reader) {
+    const int_fast32_t worksize = restart_reader.read< int_fast32_t >();
+    if (worksize != _worksize) {
+      cmac_error("Restart file was written using %" PRIiFAST32
+                 " threads, but %" PRIiFAST32
+                 " threads are used now! The number of threads needs to be "
+                 "the same to resume the simulation.",
+                 worksize, _worksize);
+    }
+    _pass = restart_reader.read< uint_fast32_t >();
+    for (int_fast32_t i = 0; i < _worksize; ++i) {
+      _jobs[i]->read_restart_file(restart_reader);
+    }
+  }
 };
 
 #endif // IONIZATIONPHOTONSHOOTJOBMARKET_HPP
@@ -32,17 +32,25 @@
 #include "DensityGridWriterFactory.hpp"
 #include "DensityMaskFactory.hpp"
 #include "DiffuseReemissionHandler.hpp"
+#include "EmissionMapRenderer.hpp"
+#include "EmissivityCalculator.hpp"
 #include "IonizationVariablesPropertyAccessors.hpp"
+#include "IterationConvergenceChecker.hpp"
 #include "LineCoolingData.hpp"
 #include "MPICommunicator.hpp"
+#include "ParallelCartesianDensityGrid.hpp"
 #include "ParameterFile.hpp"
 #include "PhotonSourceDistributionFactory.hpp"
 #include "PhotonSourceSpectrumFactory.hpp"
 #include "RecombinationRatesFactory.hpp"
+#include "RestartReader.hpp"
+#include "RestartWriter.hpp"
 #include "SimulationBox.hpp"
 #include "TemperatureCalculator.hpp"
 #include "WorkEnvironment.hpp"
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 
 /*! @brief Start the serial and total program time timers at the start of a
  *  member function call. */
@@ -77,9 +85,41 @@
  *  - number of photons first loop: Number of photon packets to use for the
  *    first iteration of the photoionization algorithm (default: (number of
  *    photons))
+ *  - number of iterations warm start: Number of iterations of the
+ *    photoionization algorithm to perform when the simulation is restarted
+ *    from a previous solution (default: 3)
+ *  - adaptive iterations: Stop the iteration as soon as it has converged and
+ *    adapt the number of photons for every iteration (using an
+ *    IterationConvergenceChecker, default: false)
  *  - output folder: Folder where all output files will be placed (default: .)
  *  - random seed: Seed used to initialize the random number generator (default:
  *    42)
+ *  - random generator: Type of random number generator: ranlxd2 (one random
+ *    sequence per thread) or Philox (counter-based, one random stream per
+ *    photon, so that photon histories do not depend on the number of threads
+ *    and processes; the mean intensity and heating integrals and the photon
+ *    weights are then accumulated in fixed-point units, so that the result is
+ *    bitwise identical for any number of threads and processes, default:
+ *    ranlxd2). This only applies to the ionizing photons; DustSimulation
+ *    always uses ranlxd2.
+ *  - checkpoint interval: Number of iterations in between successive
+ *    checkpoints, 0 means no checkpoints are written (default: 0)
+ *  - checkpoint file: Name of the checkpoint file, relative to the output
+ *    folder (default: restart.dat)
+ *  - output emission maps: Render line emission maps of the final state of the
+ *    grid (using an EmissionMapRenderer, default: false)
+ *  - distributed grid: Distribute a Cartesian grid across all MPI processes,
+ *    so that every process only stores the cells of its own subgrids (using a
+ *    ParallelCartesianDensityGrid, default: false)
+ *  - number of subgrids: Number of subgrids the distributed grid is split into
+ *    (default: 64)
+ *
+ * The distributed grid mode does not support periodic boundaries, density
+ * masks, adaptive iterations, checkpoints, emission maps, counter-based random
+ * generators or DensityFunctions that need a DensityGrid to prepare. Photons
+ * are propagated and cells are updated by a single thread on every process.
+ * Snapshots are written by every process as ASCII files that only contain the
+ * cells of that process (the DensityGridWriter:type is ignored).
  *
  * @param write_output Should this process write output?
  * @param every_iteration_output Write an output file after every iteration of
@@ -111,6 +151,17 @@ IonizationSimulation::IonizationSimulation(const bool write_output,
       _number_of_photons_init(_parameter_file.get_value< uint_fast64_t >(
           "IonizationSimulation:number of photons first loop",
           _number_of_photons)),
+      _number_of_iterations_warm_start(
+          _parameter_file.get_value< uint_fast32_t >(
+              "IonizationSimulation:number of iterations warm start", 3)),
+      _checkpoint_interval(_parameter_file.get_value< uint_fast32_t >(
+          "IonizationSimulation:checkpoint interval", 0)),
+      _checkpoint_file_name(
+          Utilities::get_absolute_path(_parameter_file.get_value< std::string >(
+              "IonizationSimulation:output folder", ".")) +
+          "/" +
+          _parameter_file.get_value< std::string >(
+              "IonizationSimulation:checkpoint file", "restart.dat")),
       _abundances(_parameter_file, _log) {
 
   function_start_timers();
@@ -134,8 +185,40 @@ IonizationSimulation::IonizationSimulation(const bool write_output,
   _density_mask = DensityMaskFactory::generate(_parameter_file, _log);
 
   const SimulationBox simulation_box(_parameter_file);
-  _density_grid = DensityGridFactory::generate(simulation_box, _parameter_file,
-                                               false, _log);
+  _density_grid = nullptr;
+  _distributed_density_grid = nullptr;
+  if (_parameter_file.get_value< bool >("IonizationSimulation:distributed grid",
+                                        false)) {
+    if (_parameter_file.get_value< std::string >("DensityGrid:type",
+                                                 "Cartesian") != "Cartesian") {
+      cmac_error("The distributed grid mode only supports Cartesian grids!");
+    }
+    const CoordinateVector< bool > periodic =
+        simulation_box.get_periodicity();
+    if (periodic.x() || periodic.y() || periodic.z()) {
+      cmac_error("The distributed grid mode does not support periodic "
+                 "boundaries!");
+    }
+    if (_density_mask != nullptr) {
+      cmac_error("The distributed grid mode does not support density masks!");
+    }
+    const CoordinateVector< int_fast32_t > numcell =
+        _parameter_file.get_value< CoordinateVector< int_fast32_t > >(
+            "DensityGrid:number of cells",
+            CoordinateVector< int_fast32_t >(64));
+    const uint_fast32_t numsubgrid = _parameter_file.get_value< uint_fast32_t >(
+        "IonizationSimulation:number of subgrids", 64);
+    _distributed_density_grid = new ParallelCartesianDensityGrid(
+        simulation_box.get_box(), numcell, numsubgrid, _mpi_communicator);
+    if (_log) {
+      _log->write_status("Using a distributed Cartesian grid with ",
+                         numcell.x(), "x", numcell.y(), "x", numcell.z(),
+                         " cells.");
+    }
+  } else {
+    _density_grid = DensityGridFactory::generate(simulation_box,
+                                                 _parameter_file, false, _log);
+  }
 
   // create the discrete UV sources
   _photon_source_distribution =
@@ -172,26 +255,87 @@ IonizationSimulation::IonizationSimulation(const bool write_output,
   std::string output_folder =
       Utilities::get_absolute_path(_parameter_file.get_value< std::string >(
           "IonizationSimulation:output folder", "."));
+  _output_folder = output_folder;
   _density_grid_writer = nullptr;
-  if (write_output) {
+  _write_distributed_output = false;
+  if (_distributed_density_grid != nullptr) {
+    // every process holds part of the grid, so every process needs to write
+    // if the process that normally writes output does
+    uint_fast64_t write_flag = write_output;
+    if (_mpi_communicator) {
+      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES >(write_flag);
+    }
+    _write_distributed_output = (write_flag > 0);
+    _distributed_output_prefix = _parameter_file.get_value< std::string >(
+        "DensityGridWriter:prefix", "snapshot");
+  } else if (write_output) {
     _density_grid_writer = DensityGridWriterFactory::generate(
         output_folder, _parameter_file, _log);
   }
+  _emission_map_renderer = nullptr;
+  if (_parameter_file.get_value< bool >(
+          "IonizationSimulation:output emission maps", false) &&
+      write_output) {
+    _emission_map_renderer = new EmissionMapRenderer(
+        output_folder, _parameter_file, _num_thread, _log);
+  }
 
   // used to calculate both the ionization state and the temperature
   _temperature_calculator = new TemperatureCalculator(
       total_luminosity, _abundances, _line_cooling_data, *_recombination_rates,
       _charge_transfer_rates, _parameter_file, _log);
 
+  // used to decide when to stop iterating and how many photons to use
+  _iteration_convergence_checker = nullptr;
+  if (_parameter_file.get_value< bool >(
+          "IonizationSimulation:adaptive iterations", false)) {
+    _iteration_convergence_checker = new IterationConvergenceChecker(
+        _number_of_photons, _parameter_file, _log);
+  }
+
+  if (_distributed_density_grid != nullptr) {
+    if (_iteration_convergence_checker != nullptr) {
+      cmac_error("The distributed grid mode does not support adaptive "
+                 "iterations!");
+    }
+    if (_emission_map_renderer != nullptr) {
+      cmac_error("The distributed grid mode does not support emission maps!");
+    }
+    if (_checkpoint_interval > 0) {
+      cmac_error("The distributed grid mode does not support checkpoints!");
+    }
+  }
+
   // create ray tracing objects
   int_fast32_t random_seed = _parameter_file.get_value< int_fast32_t >(
       "IonizationSimulation:random seed", 42);
+  _counter_based_random_generator = RandomGenerator::is_counter_based_type(
+      _parameter_file.get_value< std::string >(
+          "IonizationSimulation:random generator", "ranlxd2"));
   // make sure every thread on every process has another random seed
-  if (_mpi_communicator) {
+  // counter-based generators use the same seed everywhere, since every photon
+  // has its own random stream
+  if (_mpi_communicator && !_counter_based_random_generator) {
     random_seed += _mpi_communicator->get_rank() * _num_thread;
   }
-  _ionization_photon_shoot_job_market = new IonizationPhotonShootJobMarket(
-      *_photon_source, random_seed, *_density_grid, 0, 100, _num_thread);
+  _ionization_photon_shoot_job_market = nullptr;
+  _distributed_random_seed = random_seed;
+  if (_distributed_density_grid != nullptr) {
+    if (_counter_based_random_generator) {
+      cmac_error("The distributed grid mode does not support counter-based "
+                 "random generators!");
+    }
+  } else {
+    _ionization_photon_shoot_job_market = new IonizationPhotonShootJobMarket(
+        *_photon_source, random_seed, *_density_grid, 0, 100, _num_thread,
+        _counter_based_random_generator);
+    _density_grid->set_reproducible_accumulation(
+        _counter_based_random_generator);
+    // the second moment of the mean intensity is only used to estimate the
+    // Monte Carlo noise for the adaptive iteration control
+    _density_grid->set_second_moment_accumulation(
+        _iteration_convergence_checker != nullptr);
+  }
 
   // we are done reading the parameter file
   // now output all parameters (also those for which default values were used)
@@ -232,6 +376,18 @@ void IonizationSimulation::initialize(DensityFunction *density_function) {
     _log->write_status("Done.");
   }
 
+  // every process only initializes its own part of a distributed grid
+  if (_distributed_density_grid != nullptr) {
+    start_parallel_timing_block();
+    for (auto it = _distributed_density_grid->begin();
+         it != _distributed_density_grid->end(); ++it) {
+      (*it).initialize(*density_function);
+    }
+    stop_parallel_timing_block();
+    function_stop_timers();
+    return;
+  }
+
   // initialize the actual grid
   std::pair< cellsize_t, cellsize_t > block;
   if (_mpi_communicator) {
@@ -255,20 +411,12 @@ void IonizationSimulation::initialize(DensityFunction *density_function) {
     start_parallel_timing_block();
     std::pair< DensityGrid::iterator, DensityGrid::iterator > local_chunk =
         _density_grid->get_chunk(block.first, block.second);
-    _mpi_communicator->gather< double, NumberDensityPropertyAccessor >(
+    _mpi_communicator->gather_multiple<
+        double, NumberDensityPropertyAccessor, TemperaturePropertyAccessor,
+        IonicFractionPropertyAccessor< ION_H_n >,
+        IonicFractionPropertyAccessor< ION_He_n > >(
         _density_grid->begin(), _density_grid->end(), local_chunk.first,
         local_chunk.second, 0);
-    _mpi_communicator->gather< double, TemperaturePropertyAccessor >(
-        _density_grid->begin(), _density_grid->end(), local_chunk.first,
-        local_chunk.second, 0);
-    _mpi_communicator
-        ->gather< double, IonicFractionPropertyAccessor< ION_H_n > >(
-            _density_grid->begin(), _density_grid->end(), local_chunk.first,
-            local_chunk.second, 0);
-    _mpi_communicator
-        ->gather< double, IonicFractionPropertyAccessor< ION_He_n > >(
-            _density_grid->begin(), _density_grid->end(), local_chunk.first,
-            local_chunk.second, 0);
     stop_parallel_timing_block();
   }
 
@@ -290,21 +438,141 @@ void IonizationSimulation::initialize(DensityFunction *density_function) {
   function_stop_timers();
 }
 
+/**
+ * @brief Update the number densities of an already initialized simulation.
+ *
+ * Contrary to initialize(), the grid is not set up again, and the temperatures
+ * and ionic fractions of the previous solution are kept. A subsequent call to
+ * run() with the warm start flag set will then continue from that solution.
+ *
+ * @param density_function DensityFunction to use. If no DensityFunction is
+ * given, the internal DensityFunction is used.
+ */
+void IonizationSimulation::update(DensityFunction *density_function) {
+
+  function_start_timers();
+
+  if (density_function == nullptr) {
+    density_function = _density_function;
+  }
+
+  if (_log) {
+    _log->write_status("Updating DensityFunction...");
+  }
+  density_function->initialize();
+  if (_log) {
+    _log->write_status("Done.");
+  }
+
+  if (_distributed_density_grid != nullptr) {
+    start_parallel_timing_block();
+    for (auto it = _distributed_density_grid->begin();
+         it != _distributed_density_grid->end(); ++it) {
+      (*it).update_number_densities(*density_function);
+    }
+    stop_parallel_timing_block();
+    function_stop_timers();
+    return;
+  }
+
+  std::pair< cellsize_t, cellsize_t > block;
+  if (_mpi_communicator) {
+    block = _mpi_communicator->distribute_block(
+        0, _density_grid->get_number_of_cells());
+  } else {
+    block = std::make_pair(0, _density_grid->get_number_of_cells());
+  }
+
+  start_parallel_timing_block();
+  _density_grid->update_number_densities(block, *density_function);
+  stop_parallel_timing_block();
+
+  if (_mpi_communicator) {
+    start_parallel_timing_block();
+    std::pair< DensityGrid::iterator, DensityGrid::iterator > local_chunk =
+        _density_grid->get_chunk(block.first, block.second);
+    _mpi_communicator->gather< double, NumberDensityPropertyAccessor >(
+        _density_grid->begin(), _density_grid->end(), local_chunk.first,
+        local_chunk.second, 0);
+    stop_parallel_timing_block();
+  }
+
+  // the mask was already initialized, we only need to apply it again
+  if (_density_mask != nullptr) {
+    _density_mask->apply(*_density_grid);
+  }
+
+  function_stop_timers();
+}
+
+/**
+ * @brief Get the name of the restart file for this process.
+ *
+ * Every process has its own random number sequences, so every process writes
+ * its own restart file.
+ *
+ * @param file_name Name of the restart file.
+ * @return Name of the restart file for this process.
+ */
+std::string
+IonizationSimulation::get_process_file_name(const std::string file_name) const {
+  if (_mpi_communicator && _mpi_communicator->get_size() > 1) {
+    std::stringstream process_file_name;
+    process_file_name << file_name << "." << _mpi_communicator->get_rank();
+    return process_file_name.str();
+  } else {
+    return file_name;
+  }
+}
+
 /**
  * @brief Run the actual simulation.
  *
  * @param density_grid_writer DensityGridWriter to use for the final output. If
  * an internal DensityGridWriter exists, this one will write more output.
+ * @param warm_start Is this a continuation of a previous run (after a call to
+ * update())? If so, the ionization state of the previous run is used as a
+ * starting point, and only the warm start number of iterations is performed.
+ *
+ * If a restart file was set using set_restart_file(), the simulation resumes
+ * from the state stored in that file. If a checkpoint interval was set in the
+ * parameter file, a checkpoint is written every checkpoint interval
+ * iterations.
  */
-void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
+void IonizationSimulation::run(DensityGridWriter *density_grid_writer,
+                               const bool warm_start) {
+
+  if (_distributed_density_grid != nullptr) {
+    if (density_grid_writer != nullptr) {
+      cmac_error("The distributed grid cannot be written by an external "
+                 "DensityGridWriter!");
+    }
+    if (!_restart_file_name.empty()) {
+      cmac_error("The distributed grid mode does not support restarts!");
+    }
+    run_distributed(warm_start);
+    return;
+  }
 
   function_start_timers();
 
+  const bool restart = !_restart_file_name.empty();
+
   // write the initial state of the grid to an output file
-  if (_density_grid_writer) {
+  // when warm starting, this state is the final state of the previous run,
+  // which was already written
+  // when restarting, the initial state was written by the original run
+  if (_density_grid_writer && !warm_start && !restart) {
     _density_grid_writer->write(*_density_grid, 0, _parameter_file);
   }
 
+  // when warm starting, the iteration counter continues from the previous
+  // run, so that the iteration dependent parts of the algorithm (like the
+  // temperature calculation) behave as for a converged run
+  const uint_fast32_t number_of_iterations =
+      warm_start ? _number_of_iterations_warm_start : _number_of_iterations;
+  const uint_fast32_t loop_offset = warm_start ? _number_of_iterations : 0;
+
   std::pair< cellsize_t, cellsize_t > block;
   if (_mpi_communicator) {
     block = _mpi_communicator->distribute_block(
@@ -317,16 +585,52 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
 
   // finally: the actual program loop whereby the density grid is ray traced
   // using photon packets generated by the stellar sources
+  // the adaptive photon number persists in between iterations
+  uint_fast64_t adaptive_numphoton = _number_of_photons;
+  if (_iteration_convergence_checker) {
+    _iteration_convergence_checker->initialize(*_density_grid);
+  }
+
   uint_fast32_t loop = 0;
-  while (loop < _number_of_iterations) {
+  bool converged = false;
+
+  if (restart) {
+    if (_log) {
+      _log->write_status("Resuming simulation from restart file \"",
+                         get_process_file_name(_restart_file_name), "\"...");
+    }
+    RestartReader restart_reader(get_process_file_name(_restart_file_name));
+    if (restart_reader.read< bool >() != warm_start) {
+      cmac_error("Restart file was written for a %s run!",
+                 warm_start ? "cold start" : "warm start");
+    }
+    loop = restart_reader.read< uint_fast32_t >();
+    adaptive_numphoton = restart_reader.read< uint_fast64_t >();
+    _density_grid->read_restart_file(restart_reader);
+    _ionization_photon_shoot_job_market->read_restart_file(restart_reader);
+    const bool has_convergence_checker = restart_reader.read< bool >();
+    if (has_convergence_checker !=
+        (_iteration_convergence_checker != nullptr)) {
+      cmac_error("Restart file was written using different adaptive iteration "
+                 "settings!");
+    }
+    if (_iteration_convergence_checker) {
+      _iteration_convergence_checker->read_restart_file(restart_reader);
+    }
+    if (_log) {
+      _log->write_status("Done. Continuing from loop ", loop, ".");
+    }
+  }
+
+  while (loop < number_of_iterations && !converged) {
 
     if (_log) {
       _log->write_status("Starting loop ", loop, ".");
     }
 
-    uint_fast64_t lnumphoton = _number_of_photons;
+    uint_fast64_t lnumphoton = adaptive_numphoton;
 
-    if (loop == 0) {
+    if (loop == 0 && !warm_start) {
       // overwrite the number of photons for the first loop (might be useful
       // if more than 1 boundary is periodic, since the initial neutral
       // fractions are very low)
@@ -344,16 +648,32 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
     double totweight = 0.;
 
     uint_fast64_t local_numphoton = lnumphoton;
+    uint_fast64_t first_photon_index = 0;
 
     // make sure this process does only part of the total number of photons
     if (_mpi_communicator) {
-      local_numphoton = _mpi_communicator->distribute(local_numphoton);
+      if (_counter_based_random_generator) {
+        // distribute complete photon batches, so that the batches do not
+        // depend on the number of processes
+        const uint_fast64_t number_of_batches =
+            (lnumphoton + PHOTONPACKETBATCH_SIZE - 1) / PHOTONPACKETBATCH_SIZE;
+        const std::pair< size_t, size_t > batches =
+            _mpi_communicator->distribute_block(0, number_of_batches);
+        first_photon_index = batches.first * PHOTONPACKETBATCH_SIZE;
+        local_numphoton = std::min(
+            uint_fast64_t(batches.second * PHOTONPACKETBATCH_SIZE), lnumphoton);
+        local_numphoton -= std::min(first_photon_index, local_numphoton);
+      } else {
+        local_numphoton = _mpi_communicator->distribute(local_numphoton);
+      }
     }
 
-    _ionization_photon_shoot_job_market->set_numphoton(local_numphoton);
+    _ionization_photon_shoot_job_market->set_numphoton(local_numphoton,
+                                                       first_photon_index);
     _work_timer.start();
     start_parallel_timing_block();
     _work_distributor.do_in_parallel(*_ionization_photon_shoot_job_market);
+    _density_grid->reduce_thread_accumulators(_num_thread);
     stop_parallel_timing_block();
     _work_timer.stop();
 
@@ -406,126 +726,83 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
 
     // reduce the mean intensity integrals and heating terms across all
     // processes
+    // all values are packed into a single buffer and reduced in one
+    // (pipelined) communication
     start_parallel_timing_block();
 
+    // the second moment of the hydrogen mean intensity is only accumulated
+    // (and hence only needs to be reduced) if we use adaptive iterations
     if (_mpi_communicator) {
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_H_n > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_He_n > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_C_p1 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_C_p2 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_N_n > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_N_p1 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_N_p2 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_O_n > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_O_p1 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_Ne_n > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_Ne_p1 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_S_p1 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_S_p2 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_S_p3 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 HeatingPropertyAccessor< HEATINGTERM_H > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 HeatingPropertyAccessor< HEATINGTERM_He > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-    }
-
-    _temperature_calculator->calculate_temperature(loop, totweight,
-                                                   *_density_grid, block);
+      if (_density_grid->get_second_moment_accumulation()) {
+        _mpi_communicator->reduce_multiple<
+            MPI_SUM_OF_ALL_PROCESSES, double,
+            MeanIntensityPropertyAccessor< ION_H_n >,
+            MeanIntensityPropertyAccessor< ION_He_n >,
+            MeanIntensityPropertyAccessor< ION_C_p1 >,
+            MeanIntensityPropertyAccessor< ION_C_p2 >,
+            MeanIntensityPropertyAccessor< ION_N_n >,
+            MeanIntensityPropertyAccessor< ION_N_p1 >,
+            MeanIntensityPropertyAccessor< ION_N_p2 >,
+            MeanIntensityPropertyAccessor< ION_O_n >,
+            MeanIntensityPropertyAccessor< ION_O_p1 >,
+            MeanIntensityPropertyAccessor< ION_Ne_n >,
+            MeanIntensityPropertyAccessor< ION_Ne_p1 >,
+            MeanIntensityPropertyAccessor< ION_S_p1 >,
+            MeanIntensityPropertyAccessor< ION_S_p2 >,
+            MeanIntensityPropertyAccessor< ION_S_p3 >,
+            HeatingPropertyAccessor< HEATINGTERM_H >,
+            HeatingPropertyAccessor< HEATINGTERM_He >,
+            MeanIntensitySecondMomentPropertyAccessor >(
+            _density_grid->begin(), _density_grid->end(), 0);
+      } else {
+        _mpi_communicator->reduce_multiple<
+            MPI_SUM_OF_ALL_PROCESSES, double,
+            MeanIntensityPropertyAccessor< ION_H_n >,
+            MeanIntensityPropertyAccessor< ION_He_n >,
+            MeanIntensityPropertyAccessor< ION_C_p1 >,
+            MeanIntensityPropertyAccessor< ION_C_p2 >,
+            MeanIntensityPropertyAccessor< ION_N_n >,
+            MeanIntensityPropertyAccessor< ION_N_p1 >,
+            MeanIntensityPropertyAccessor< ION_N_p2 >,
+            MeanIntensityPropertyAccessor< ION_O_n >,
+            MeanIntensityPropertyAccessor< ION_O_p1 >,
+            MeanIntensityPropertyAccessor< ION_Ne_n >,
+            MeanIntensityPropertyAccessor< ION_Ne_p1 >,
+            MeanIntensityPropertyAccessor< ION_S_p1 >,
+            MeanIntensityPropertyAccessor< ION_S_p2 >,
+            MeanIntensityPropertyAccessor< ION_S_p3 >,
+            HeatingPropertyAccessor< HEATINGTERM_H >,
+            HeatingPropertyAccessor< HEATINGTERM_He > >(
+            _density_grid->begin(), _density_grid->end(), 0);
+      }
+    }
+
+    _temperature_calculator->calculate_temperature(
+        loop_offset + loop, totweight, *_density_grid, block);
 
     // the calculation above will have changed the ionic fractions, and might
     // have changed the temperatures
     // we have to gather these across all processes
 
     if (_mpi_communicator) {
-      _mpi_communicator->gather< double, TemperaturePropertyAccessor >(
+      _mpi_communicator->gather_multiple<
+          double, TemperaturePropertyAccessor,
+          IonicFractionPropertyAccessor< ION_H_n >,
+          IonicFractionPropertyAccessor< ION_He_n >,
+          IonicFractionPropertyAccessor< ION_C_p1 >,
+          IonicFractionPropertyAccessor< ION_C_p2 >,
+          IonicFractionPropertyAccessor< ION_N_n >,
+          IonicFractionPropertyAccessor< ION_N_p1 >,
+          IonicFractionPropertyAccessor< ION_N_p2 >,
+          IonicFractionPropertyAccessor< ION_O_n >,
+          IonicFractionPropertyAccessor< ION_O_p1 >,
+          IonicFractionPropertyAccessor< ION_Ne_n >,
+          IonicFractionPropertyAccessor< ION_Ne_p1 >,
+          IonicFractionPropertyAccessor< ION_S_p1 >,
+          IonicFractionPropertyAccessor< ION_S_p2 >,
+          IonicFractionPropertyAccessor< ION_S_p3 > >(
           _density_grid->begin(), _density_grid->end(), local_chunk.first,
           local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_H_n > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_He_n > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_C_p1 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_C_p2 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_N_n > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_N_p1 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_N_p2 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_O_n > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_O_p1 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_Ne_n > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_Ne_p1 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_S_p1 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_S_p2 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_S_p3 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
     }
 
     stop_parallel_timing_block();
@@ -534,6 +811,20 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
       _log->write_status("Done calculating ionization state.");
     }
 
+    // all processes have the same copy of the grid, so they all reach the
+    // same conclusion and agree on the next photon number
+    // the photon number for the first loop is a special case that should not
+    // affect the photon number for later loops
+    if (_iteration_convergence_checker) {
+      if (loop == 0 && !warm_start) {
+        adaptive_numphoton = _number_of_photons;
+      } else {
+        adaptive_numphoton = lnumphoton;
+      }
+      converged = _iteration_convergence_checker->is_converged(
+          *_density_grid, adaptive_numphoton);
+    }
+
     // calculate emissivities
     // we disabled this, since we now have the post-processing Python library
     // for this
@@ -544,14 +835,43 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
     ++loop;
 
     if (_density_grid_writer && _every_iteration_output &&
-        loop < _number_of_iterations) {
+        loop < number_of_iterations && !converged) {
       _density_grid_writer->write(*_density_grid, loop, _parameter_file);
     }
+
+    if (_checkpoint_interval > 0 && loop % _checkpoint_interval == 0 &&
+        loop < number_of_iterations && !converged) {
+      // make sure all snapshots up to this point are on disk before the
+      // checkpoint that assumes they exist is written
+      if (_density_grid_writer) {
+        _density_grid_writer->flush();
+      }
+      if (_log) {
+        _log->write_status("Writing checkpoint...");
+      }
+      RestartWriter restart_writer(
+          get_process_file_name(_checkpoint_file_name));
+      restart_writer.write(warm_start);
+      restart_writer.write(loop);
+      restart_writer.write(adaptive_numphoton);
+      _density_grid->write_restart_file(restart_writer);
+      _ionization_photon_shoot_job_market->write_restart_file(restart_writer);
+      restart_writer.write(_iteration_convergence_checker != nullptr);
+      if (_iteration_convergence_checker) {
+        _iteration_convergence_checker->write_restart_file(restart_writer);
+      }
+      restart_writer.finalize();
+    }
   }
 
-  if (_log && loop == _number_of_iterations) {
-    _log->write_status("Maximum number of iterations (", _number_of_iterations,
-                       ") reached, stopping.");
+  if (_log) {
+    if (converged) {
+      _log->write_status("Iteration converged after ", loop,
+                         " iterations, stopping.");
+    } else if (loop == number_of_iterations) {
+      _log->write_status("Maximum number of iterations (",
+                         number_of_iterations, ") reached, stopping.");
+    }
   }
 
   // write final snapshot
@@ -564,6 +884,13 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
                                _parameter_file);
   }
 
+  if (_emission_map_renderer) {
+    const EmissivityCalculator emissivity_calculator(_abundances);
+    emissivity_calculator.calculate_emissivities(*_density_grid);
+    _emission_map_renderer->render(*_density_grid);
+    _emission_map_renderer->save();
+  }
+
   if (_log) {
     _log->write_status("Total photon shooting time: ",
                        Utilities::human_readable_time(_work_timer.value()),
@@ -573,6 +900,218 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
   function_stop_timers();
 }
 
+/**
+ * @brief Run the simulation on the distributed grid.
+ *
+ * Every process generates its share of the photons and adds them to the
+ * subgrid that contains their origin. The photons are then propagated through
+ * the distributed grid (including re-emission), whereby photons that leave the
+ * local subgrids are sent to the process that holds their new subgrid. Photons
+ * are generated and propagated in chunks to limit the memory used by photon
+ * pools and buffers; all processes use the same number of chunks.
+ *
+ * After all photons have been propagated, the total weight and photon type
+ * counts are reduced across all processes, and every process computes the
+ * ionization state (and temperature) of its own cells. No other communication
+ * is required, since every cell is only stored on a single process.
+ *
+ * @param warm_start Is this a continuation of a previous run (after a call to
+ * update())?
+ */
+void IonizationSimulation::run_distributed(const bool warm_start) {
+
+  function_start_timers();
+
+  if (_write_distributed_output && !warm_start) {
+    write_distributed_snapshot(0);
+  }
+
+  const uint_fast32_t number_of_iterations =
+      warm_start ? _number_of_iterations_warm_start : _number_of_iterations;
+  const uint_fast32_t loop_offset = warm_start ? _number_of_iterations : 0;
+
+  RandomGenerator random_generator(_distributed_random_seed);
+
+  for (uint_fast32_t loop = 0; loop < number_of_iterations; ++loop) {
+
+    if (_log) {
+      _log->write_status("Starting loop ", loop, ".");
+    }
+
+    uint_fast64_t lnumphoton = _number_of_photons;
+    if (loop == 0 && !warm_start) {
+      lnumphoton = _number_of_photons_init;
+    }
+
+    for (auto it = _distributed_density_grid->begin();
+         it != _distributed_density_grid->end(); ++it) {
+      ParallelCartesianDensitySubGrid &subgrid = *it;
+      subgrid.reset_mean_intensities();
+      for (uint_fast32_t i = 0; i < subgrid.get_number_of_cells(); ++i) {
+        DiffuseReemissionHandler::set_reemission_probabilities(
+            subgrid.get_ionization_variables(i));
+      }
+    }
+
+    if (_log) {
+      _log->write_status("Start shooting ", lnumphoton, " photons...");
+    }
+
+    double typecount[PHOTONTYPE_NUMBER] = {0};
+    double totweight = 0.;
+    uint_fast64_t num_absorbed = 0;
+    uint_fast64_t num_escaped = 0;
+
+    _work_timer.start();
+    start_parallel_timing_block();
+    const uint_fast64_t chunk_size = PARALLELCARTESIANDENSITYGRID_BATCH_SIZE;
+    for (uint_fast64_t first_photon = 0; first_photon < lnumphoton;
+         first_photon += chunk_size) {
+      uint_fast64_t local_numphoton =
+          std::min(chunk_size, lnumphoton - first_photon);
+      if (_mpi_communicator) {
+        local_numphoton = _mpi_communicator->distribute(local_numphoton);
+      }
+      for (uint_fast64_t i = 0; i < local_numphoton; ++i) {
+        Photon *photon =
+            new Photon(_photon_source->get_random_photon(random_generator));
+        const double tau =
+            -std::log(random_generator.get_uniform_random_double());
+        _distributed_density_grid->add_photon(photon, tau);
+      }
+      _distributed_density_grid->propagate_photons(
+          _mpi_communicator, num_absorbed, num_escaped, totweight, typecount,
+          _photon_source, &random_generator);
+    }
+    stop_parallel_timing_block();
+    _work_timer.stop();
+
+    if (_mpi_communicator) {
+      start_parallel_timing_block();
+      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES >(totweight);
+      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, PHOTONTYPE_NUMBER >(
+          typecount);
+      stop_parallel_timing_block();
+    }
+
+    if (_log) {
+      _log->write_status("Done shooting photons.");
+      if (_output_statistics) {
+        _log->write_status(
+            100. * typecount[PHOTONTYPE_ABSORBED] / totweight,
+            "% of photons were reemitted as non-ionizing photons.");
+        const double escape_fraction = std::max(
+            0., (100. * (totweight - typecount[PHOTONTYPE_ABSORBED])) /
+                    totweight);
+        _log->write_status("Escape fraction: ", escape_fraction, "%.");
+      }
+      _log->write_status("Calculating ionization state after shooting ",
+                         lnumphoton, " photons...");
+    }
+
+    // every process only updates its own cells
+    start_parallel_timing_block();
+    uint_fast64_t number_of_iterations_temperature = 0;
+    for (auto it = _distributed_density_grid->begin();
+         it != _distributed_density_grid->end(); ++it) {
+      ParallelCartesianDensitySubGrid &subgrid = *it;
+      const double volume = subgrid.get_cell_volume();
+      for (uint_fast32_t i = 0; i < subgrid.get_number_of_cells(); ++i) {
+        number_of_iterations_temperature +=
+            _temperature_calculator->calculate_cell_state(
+                loop_offset + loop, totweight, volume,
+                subgrid.get_ionization_variables(i),
+                subgrid.get_cell_midpoint(i));
+      }
+    }
+    stop_parallel_timing_block();
+
+    if (_log) {
+      _log->write_info("Temperature computation: ",
+                       number_of_iterations_temperature,
+                       " iterations on the local process.");
+      _log->write_status("Done calculating ionization state.");
+    }
+
+    if (_write_distributed_output && _every_iteration_output &&
+        loop + 1 < number_of_iterations) {
+      write_distributed_snapshot(loop + 1);
+    }
+  }
+
+  if (_log) {
+    _log->write_status("Maximum number of iterations (", number_of_iterations,
+                       ") reached, stopping.");
+  }
+
+  if (_write_distributed_output) {
+    write_distributed_snapshot(_number_of_iterations);
+  }
+
+  if (_log) {
+    _log->write_status("Total photon shooting time: ",
+                       Utilities::human_readable_time(_work_timer.value()),
+                       ".");
+  }
+
+  function_stop_timers();
+}
+
+/**
+ * @brief Write the part of the distributed grid that is stored on this process
+ * to a snapshot file.
+ *
+ * The file has the same format as the files written by the
+ * AsciiFileDensityGridWriter. If more than one process is used, the rank of the
+ * process is added to the file name.
+ *
+ * @param iteration Iteration number to use in the snapshot file name.
+ */
+void IonizationSimulation::write_distributed_snapshot(
+    const uint_fast32_t iteration) {
+
+  std::string prefix = _distributed_output_prefix;
+  if (_mpi_communicator && _mpi_communicator->get_size() > 1) {
+    std::stringstream rank_prefix;
+    rank_prefix << prefix << "_rank" << _mpi_communicator->get_rank() << "_";
+    prefix = rank_prefix.str();
+  }
+  const std::string filename =
+      Utilities::compose_filename(_output_folder, prefix, "txt", iteration, 3);
+
+  std::ofstream file(filename);
+  file << "#x (m)\ty (m)\tz (m)\tn (m^-3)\tvolume (m^3)\tneutral H fraction\n";
+  for (auto it = _distributed_density_grid->begin();
+       it != _distributed_density_grid->end(); ++it) {
+    ParallelCartesianDensitySubGrid &subgrid = *it;
+    const double volume = subgrid.get_cell_volume();
+    for (uint_fast32_t i = 0; i < subgrid.get_number_of_cells(); ++i) {
+      const CoordinateVector<> x = subgrid.get_cell_midpoint(i);
+      const IonizationVariables &ionization_variables =
+          subgrid.get_ionization_variables(i);
+      file << x.x() << "\t" << x.y() << "\t" << x.z() << "\t"
+           << ionization_variables.get_number_density() << "\t" << volume
+           << "\t" << ionization_variables.get_ionic_fraction(ION_H_n)
+           << "\n";
+    }
+  }
+}
+
+/**
+ * @brief Resume the simulation from the given restart file during the next
+ * call to run().
+ *
+ * The simulation should have been set up with the same parameters and number
+ * of threads (and processes) as the simulation that wrote the restart file.
+ *
+ * @param restart_file_name Name of the restart file, as it was set in the
+ * parameter file of the original simulation.
+ */
+void IonizationSimulation::set_restart_file(
+    const std::string restart_file_name) {
+  _restart_file_name = restart_file_name;
+}
+
 /**
  * @brief Destructor.
  *
@@ -597,9 +1136,11 @@ IonizationSimulation::~IonizationSimulation() {
   delete _ionization_photon_shoot_job_market;
 
   // computation objects
+  delete _iteration_convergence_checker;
   delete _temperature_calculator;
 
   // snapshot output
+  delete _emission_map_renderer;
   delete _density_grid_writer;
 
   // actual photon source object
@@ -614,6 +1155,7 @@ IonizationSimulation::~IonizationSimulation() {
   delete _photon_source_distribution;
 
   // density grid and related objects
+  delete _distributed_density_grid;
   delete _density_grid;
   delete _density_mask;
   delete _density_function;
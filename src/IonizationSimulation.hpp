@@ -41,8 +41,11 @@ class DensityFunction;
 class DensityGrid;
 class DensityGridWriter;
 class DensityMask;
+class EmissionMapRenderer;
+class IterationConvergenceChecker;
 class Log;
 class MPICommunicator;
+class ParallelCartesianDensityGrid;
 class PhotonSource;
 class PhotonSourceDistribution;
 class PhotonSourceSpectrum;
@@ -109,6 +112,21 @@ private:
    *  transparent). */
   const uint_fast64_t _number_of_photons_init;
 
+  /*! @brief Number of iterations of the ray tracing loop when the simulation
+   *  is restarted from a previous solution (warm start). */
+  const uint_fast32_t _number_of_iterations_warm_start;
+
+  /*! @brief Number of iterations in between successive checkpoints (0 means
+   *  no checkpoints are written). */
+  const uint_fast32_t _checkpoint_interval;
+
+  /*! @brief Name of the checkpoint file. */
+  const std::string _checkpoint_file_name;
+
+  /*! @brief Name of the restart file to resume from (empty if the simulation
+   *  starts from scratch). */
+  std::string _restart_file_name;
+
   /// objects owned by the simulation that require parameters
   /// these have to be declared and initialized after the parameter file has
   /// been read
@@ -137,6 +155,24 @@ private:
   /*! @brief Grid used for the photoionization simulation. */
   DensityGrid *_density_grid;
 
+  /*! @brief Grid that is distributed across all processes, used instead of
+   *  the DensityGrid if the distributed grid mode is active. */
+  ParallelCartesianDensityGrid *_distributed_density_grid;
+
+  /*! @brief Should every process write its part of the distributed grid to a
+   *  snapshot file? */
+  bool _write_distributed_output;
+
+  /*! @brief Folder where snapshots of the distributed grid are written. */
+  std::string _output_folder;
+
+  /*! @brief Prefix of the snapshots of the distributed grid. */
+  std::string _distributed_output_prefix;
+
+  /*! @brief Seed for the random number generator used in distributed grid
+   *  mode (already offset for this process in the constructor). */
+  int_fast32_t _distributed_random_seed;
+
   /*! @brief Distribution of discrete UV light sources. */
   PhotonSourceDistribution *_photon_source_distribution;
 
@@ -155,14 +191,24 @@ private:
   /*! @brief Object used to write snapshot output. */
   DensityGridWriter *_density_grid_writer;
 
+  /*! @brief Object used to render line emission maps of the final state. */
+  EmissionMapRenderer *_emission_map_renderer;
+
   /*! @brief Object used to compute the combined ionization and temperature
    *  balance at the end of a ray tracing step. */
   TemperatureCalculator *_temperature_calculator;
 
+  /*! @brief Object used to check the convergence of the ray tracing loop and
+   *  to adapt the number of photons (optional). */
+  IterationConvergenceChecker *_iteration_convergence_checker;
+
   /*! @brief Object used to do the ray tracing of photons through the grid in
    *  parallel. */
   IonizationPhotonShootJobMarket *_ionization_photon_shoot_job_market;
 
+  /*! @brief Do the photon shooting jobs use counter-based RandomGenerators? */
+  bool _counter_based_random_generator;
+
   /// internal timers
 
   /*! @brief Timer to quantify time spent in ray tracing. */
@@ -177,6 +223,11 @@ private:
   /*! @brief Timer to quantity total time spent in the ionization code .*/
   Timer _total_timer;
 
+  std::string get_process_file_name(const std::string file_name) const;
+
+  void run_distributed(const bool warm_start);
+  void write_distributed_snapshot(const uint_fast32_t iteration);
+
 public:
   IonizationSimulation(const bool write_output,
                        const bool every_iteration_output,
@@ -187,7 +238,11 @@ public:
                        Log *log = nullptr);
 
   void initialize(DensityFunction *density_function = nullptr);
-  void run(DensityGridWriter *density_grid_writer = nullptr);
+  void update(DensityFunction *density_function = nullptr);
+  void run(DensityGridWriter *density_grid_writer = nullptr,
+           const bool warm_start = false);
+
+  void set_restart_file(const std::string restart_file_name);
 
   ~IonizationSimulation();
 };
@@ -27,7 +27,7 @@
 #include "Abundances.hpp"
 #include "ChargeTransferRates.hpp"
 #include "DensityGrid.hpp"
-#include "DensityGridTraversalJobMarket.hpp"
+#include "DensityGridBatchTraversalJobMarket.hpp"
 #include "DensityValues.hpp"
 #include "Error.hpp"
 #include "RecombinationRates.hpp"
@@ -58,12 +58,10 @@ IonizationStateCalculator::IonizationStateCalculator(
  *
  * @param jfac Normalization factor for the mean intensity integrals in this
  * cell.
- * @param cell DensityGrid::iterator pointing to a cell.
+ * @param ionization_variables IonizationVariables of the cell.
  */
 void IonizationStateCalculator::calculate_ionization_state(
-    double jfac, DensityGrid::iterator &cell) const {
-
-  IonizationVariables &ionization_variables = cell.get_ionization_variables();
+    double jfac, IonizationVariablesReference ionization_variables) const {
 
   // normalize the mean intensity integrals
   const double jH = jfac * ionization_variables.get_mean_intensity(ION_H_n);
@@ -166,6 +164,134 @@ void IonizationStateCalculator::calculate_ionization_state(
 #endif
 }
 
+/**
+ * @brief Does the ionization state calculation for a batch of consecutive
+ * cells.
+ *
+ * This produces the same result as calling calculate_ionization_state(double,
+ * IonizationVariablesReference) for every cell in the batch, but operates on
+ * the contiguous arrays of the state variables in the IonizationVariablesArray.
+ * Only the iterative hydrogen and helium solver and the metal ionization
+ * balance are done cell by cell; the normalization of the intensity integrals,
+ * the electron and ion densities, and the ionic fractions of neutral and
+ * vacuum cells are computed in simple loops over the batch that the compiler
+ * can vectorize.
+ *
+ * @param jfac Normalization factors for the mean intensity integrals in each
+ * cell of the batch.
+ * @param ionization_variables IonizationVariablesArray containing the cells.
+ * @param offset Index of the first cell of the batch.
+ * @param size Number of cells in the batch (at most
+ * IONIZATIONSTATECALCULATOR_BATCH_SIZE).
+ */
+void IonizationStateCalculator::calculate_ionization_state(
+    const double *jfac, IonizationVariablesArray &ionization_variables,
+    cellsize_t offset, uint_fast32_t size) const {
+
+  cmac_assert(size <= IONIZATIONSTATECALCULATOR_BATCH_SIZE);
+
+  const double AHe = _abundances.get_abundance(ELEMENT_He);
+  const double *ntot = ionization_variables.get_number_densities() + offset;
+  const double *T = ionization_variables.get_temperatures() + offset;
+  double *h0 = ionization_variables.get_ionic_fractions(ION_H_n) + offset;
+  double *he0 = ionization_variables.get_ionic_fractions(ION_He_n) + offset;
+
+  // normalize the mean intensity integrals
+  double jH[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double jHe[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  for (uint_fast32_t i = 0; i < size; ++i) {
+    const IonizationVariablesReference cell = ionization_variables[offset + i];
+    jH[i] = jfac[i] * cell.get_mean_intensity(ION_H_n);
+    jHe[i] = jfac[i] * cell.get_mean_intensity(ION_He_n);
+  }
+
+  // find the cells that are (partially) ionized
+  bool ionized[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  for (uint_fast32_t i = 0; i < size; ++i) {
+    ionized[i] = (jH[i] > 0. && ntot[i] > 0.);
+  }
+
+  // find the ionization equilibrium for hydrogen and helium
+  // cells without hydrogen ionizing radiation are neutral, vacuum cells have
+  // all ionic fractions set to 0
+  for (uint_fast32_t i = 0; i < size; ++i) {
+    if (ionized[i]) {
+      const double alphaH =
+          _recombination_rates.get_recombination_rate(ION_H_n, T[i]);
+      const double alphaHe =
+          _recombination_rates.get_recombination_rate(ION_He_n, T[i]);
+      if (AHe != 0.) {
+        compute_ionization_states_hydrogen_helium(
+            alphaH, alphaHe, jH[i], jHe[i], ntot[i], AHe, T[i], h0[i], he0[i]);
+      } else {
+        h0[i] = compute_ionization_state_hydrogen(alphaH, jH[i], ntot[i]);
+        he0[i] = 0.;
+      }
+    } else {
+      h0[i] = (ntot[i] > 0.) ? 1. : 0.;
+      he0[i] = h0[i];
+    }
+  }
+
+  // do the coolants
+  double ne[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double T4[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nhp[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nh0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  double nhe0[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+  for (uint_fast32_t i = 0; i < size; ++i) {
+    ne[i] = ntot[i] * (1. - h0[i] + AHe * (1. - he0[i]));
+    T4[i] = T[i] * 1.e-4;
+    nhp[i] = ntot[i] * (1. - h0[i]);
+    nh0[i] = ntot[i] * h0[i];
+    nhe0[i] = ntot[i] * he0[i] * AHe;
+  }
+  for (uint_fast32_t i = 0; i < size; ++i) {
+    if (ionized[i]) {
+      const IonizationVariablesReference cell =
+          ionization_variables[offset + i];
+      const double j_metals[12] = {cell.get_mean_intensity(ION_C_p1),
+                                   cell.get_mean_intensity(ION_C_p2),
+                                   cell.get_mean_intensity(ION_N_n),
+                                   cell.get_mean_intensity(ION_N_p1),
+                                   cell.get_mean_intensity(ION_N_p2),
+                                   cell.get_mean_intensity(ION_O_n),
+                                   cell.get_mean_intensity(ION_O_p1),
+                                   cell.get_mean_intensity(ION_Ne_n),
+                                   cell.get_mean_intensity(ION_Ne_p1),
+                                   cell.get_mean_intensity(ION_S_p1),
+                                   cell.get_mean_intensity(ION_S_p2),
+                                   cell.get_mean_intensity(ION_S_p3)};
+      compute_ionization_states_metals(
+          j_metals, ne[i], T[i], T4[i], nh0[i], nhe0[i], nhp[i],
+          _recombination_rates, _charge_transfer_rates, cell);
+    }
+  }
+  // in neutral cells, all coolants are neutral, so their ionic fractions are 0
+  // (apart from the neutral fractions of N, O and Ne, which are 1)
+  for (int_fast32_t ion = ION_C_p1; ion < NUMBER_OF_IONNAMES; ++ion) {
+    const IonName name = static_cast< IonName >(ion);
+    const double neutral_value =
+        (name == ION_N_n || name == ION_O_n || name == ION_Ne_n) ? 1. : 0.;
+    double *fraction =
+        ionization_variables.get_ionic_fractions(name) + offset;
+    for (uint_fast32_t i = 0; i < size; ++i) {
+      if (!ionized[i]) {
+        fraction[i] = (ntot[i] > 0.) ? neutral_value : 0.;
+      }
+    }
+  }
+
+#ifdef DO_OUTPUT_PHOTOIONIZATION_RATES
+  // set the mean intensity values to the values in correct physical units
+  for (uint_fast32_t i = 0; i < size; ++i) {
+    IonizationVariablesReference cell = ionization_variables[offset + i];
+    cell.set_mean_intensity(ION_H_n, jH[i]);
+    cell.set_mean_intensity(ION_He_n, jHe[i]);
+  }
+#endif
+}
+
 /**
  * @brief Compute the ionization balance for the metals at the given temperature
  * (and using the given ionizing luminosity integrals).
@@ -220,7 +346,7 @@ void IonizationStateCalculator::compute_ionization_states_metals(
     const double T, const double T4, const double nh0, const double nhe0,
     const double nhp, const RecombinationRates &recombination_rates,
     const ChargeTransferRates &charge_transfer_rates,
-    IonizationVariables &ionization_variables) {
+    IonizationVariablesReference ionization_variables) {
 
   const double jCp1 = j_metals[0];
   const double jCp2 = j_metals[1];
@@ -396,11 +522,12 @@ void IonizationStateCalculator::calculate_ionization_state(
   // don't necessarily have the same volume
   double jfac = _luminosity / totweight;
   WorkDistributor<
-      DensityGridTraversalJobMarket< IonizationStateCalculatorFunction >,
-      DensityGridTraversalJob< IonizationStateCalculatorFunction > >
+      DensityGridBatchTraversalJobMarket< IonizationStateCalculatorFunction >,
+      DensityGridBatchTraversalJob< IonizationStateCalculatorFunction > >
       workers;
-  IonizationStateCalculatorFunction do_calculation(*this, jfac);
-  DensityGridTraversalJobMarket< IonizationStateCalculatorFunction > jobs(
+  IonizationStateCalculatorFunction do_calculation(
+      *this, jfac, grid.get_ionization_variables_array());
+  DensityGridBatchTraversalJobMarket< IonizationStateCalculatorFunction > jobs(
       grid, do_calculation, block);
   workers.do_in_parallel(jobs);
 }
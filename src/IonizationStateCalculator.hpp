@@ -33,6 +33,10 @@ class Abundances;
 class ChargeTransferRates;
 class RecombinationRates;
 
+/*! @brief Maximum number of cells that is processed in a single batch by the
+ *  batched ionization state sweep. */
+#define IONIZATIONSTATECALCULATOR_BATCH_SIZE 64
+
 /**
  * @brief Class that calculates the ionization state on a grid after the photon
  * shoot loop.
@@ -62,15 +66,32 @@ public:
                             const RecombinationRates &recombination_rates,
                             const ChargeTransferRates &charge_transfer_rates);
 
-  void calculate_ionization_state(double jfac,
-                                  DensityGrid::iterator &cell) const;
+  void calculate_ionization_state(
+      double jfac, IonizationVariablesReference ionization_variables) const;
+
+  void
+  calculate_ionization_state(const double *jfac,
+                             IonizationVariablesArray &ionization_variables,
+                             cellsize_t offset, uint_fast32_t size) const;
+
+  /**
+   * @brief Does the ionization state calculation for a single cell.
+   *
+   * @param jfac Normalization factor for the mean intensity integrals in this
+   * cell.
+   * @param cell DensityGrid::iterator pointing to a cell.
+   */
+  inline void calculate_ionization_state(double jfac,
+                                         DensityGrid::iterator &cell) const {
+    calculate_ionization_state(jfac, cell.get_ionization_variables());
+  }
 
   static void compute_ionization_states_metals(
       const double j_metals[NUMBER_OF_IONNAMES - 2], const double ne,
       const double T, const double T4, const double nh0, const double nhe0,
       const double nhp, const RecombinationRates &recombination_rates,
       const ChargeTransferRates &charge_transfer_rates,
-      IonizationVariables &ionization_variables);
+      IonizationVariablesReference ionization_variables);
 
   static void compute_ionization_states_hydrogen_helium(
       double alphaH, double alphaHe, double jH, double jHe, double nH,
@@ -80,7 +101,7 @@ public:
                                                   double nH);
 
   /**
-   * @brief Functor used to calculate the ionization state of a single cell.
+   * @brief Functor used to calculate the ionization state of a range of cells.
    */
   class IonizationStateCalculatorFunction {
   private:
@@ -91,6 +112,9 @@ public:
      */
     const double _jfac;
 
+    /*! @brief Ionization variables of all cells in the grid. */
+    IonizationVariablesArray &_ionization_variables;
+
   public:
     /**
      * @brief Constructor.
@@ -99,18 +123,40 @@ public:
      * calculation.
      * @param jfac Normalization factor used in the IonizationStateCalculator
      * call.
+     * @param ionization_variables Ionization variables of all cells in the
+     * grid.
      */
     IonizationStateCalculatorFunction(
-        const IonizationStateCalculator &calculator, double jfac)
-        : _calculator(calculator), _jfac(jfac) {}
+        const IonizationStateCalculator &calculator, double jfac,
+        IonizationVariablesArray &ionization_variables)
+        : _calculator(calculator), _jfac(jfac),
+          _ionization_variables(ionization_variables) {}
 
     /**
-     * @brief Do the ionization state calculation for a single cell.
+     * @brief Do the ionization state calculation for the given range of cells.
+     *
+     * The range is split in batches of consecutive cells, which are processed
+     * by the batched ionization state sweep.
      *
-     * @param cell DensityGrid::iterator pointing to a single cell in the grid.
+     * @param begin DensityGrid::iterator pointing to the first cell.
+     * @param end DensityGrid::iterator pointing beyond the last cell.
      */
-    inline void operator()(DensityGrid::iterator &cell) {
-      _calculator.calculate_ionization_state(_jfac / cell.get_volume(), cell);
+    inline void operator()(DensityGrid::iterator begin,
+                           DensityGrid::iterator end) {
+      double jfac[IONIZATIONSTATECALCULATOR_BATCH_SIZE];
+      DensityGrid::iterator it = begin;
+      while (it != end) {
+        const cellsize_t offset = it.get_index();
+        uint_fast32_t size = 0;
+        while (it != end && size < IONIZATIONSTATECALCULATOR_BATCH_SIZE &&
+               it.get_index() == offset + size) {
+          jfac[size] = _jfac / it.get_volume();
+          ++size;
+          ++it;
+        }
+        _calculator.calculate_ionization_state(jfac, _ionization_variables,
+                                               offset, size);
+      }
     }
   };
 
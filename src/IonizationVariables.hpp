@@ -27,11 +27,10 @@
 #define IONIZATIONVARIABLES_HPP
 
 #include "Configuration.hpp"
+#include "Atomic.hpp"
 #include "ElementNames.hpp"
 
-#ifdef USE_LOCKFREE
-#include "Atomic.hpp"
-#endif
+#include <cstddef>
 
 /**
  * @brief Convenient names for reemission probabilities.
@@ -66,58 +65,109 @@ enum HeatingTermName {
   NUMBER_OF_HEATINGTERMS
 };
 
-/**
- * @brief Variables used in the ionization calculation.
- */
-class IonizationVariables {
-private:
-  /*! @brief Number density (in m^-3). */
-  double _number_density;
+/// layout of the variables of a single cell
+
+/*! @brief Position of the number density in the state variables of a cell. */
+#define IONIZATIONVARIABLES_NUMBER_DENSITY 0
+
+/*! @brief Position of the temperature in the state variables of a cell. */
+#define IONIZATIONVARIABLES_TEMPERATURE 1
+
+/*! @brief Position of the first ionic fraction in the state variables of a
+ *  cell. */
+#define IONIZATIONVARIABLES_IONIC_FRACTION 2
 
-  /*! @brief Temperature (in K). */
-  double _temperature;
+/*! @brief Number of state variables of a cell. */
+#define IONIZATIONVARIABLES_NUMBER_OF_STATE_VALUES                             \
+  (IONIZATIONVARIABLES_IONIC_FRACTION + NUMBER_OF_IONNAMES)
 
-  /*! @brief Ionic fractions. For hydrogen and helium, these are the neutral
-   *  fractions. For other elements, they are the fraction of the end product
-   *  of ionization (e.g. _ionic_fraction[ION_C_p1] is the fraction of C that
-   *  is in the form of C++). */
-  double _ionic_fractions[NUMBER_OF_IONNAMES];
+/*! @brief Position of the first mean intensity integral in the per cell data
+ *  block. */
+#define IONIZATIONVARIABLES_MEAN_INTENSITY 0
 
-  /*! @brief Mean intensity integrals of ionizing radiation (without
-   *  normalization factor, in m^3). */
-  double _mean_intensity[NUMBER_OF_IONNAMES];
+/*! @brief Position of the second moment of the hydrogen mean intensity
+ *  integral in the per cell data block. */
+#define IONIZATIONVARIABLES_MEAN_INTENSITY_SECOND_MOMENT                       \
+  (IONIZATIONVARIABLES_MEAN_INTENSITY + NUMBER_OF_IONNAMES)
 
-  /*! @brief Reemission probabilities. */
-  double _reemission_probabilities[NUMBER_OF_REEMISSIONPROBABILITIES];
+/*! @brief Position of the first heating integral in the per cell data block. */
+#define IONIZATIONVARIABLES_HEATING                                            \
+  (IONIZATIONVARIABLES_MEAN_INTENSITY_SECOND_MOMENT + 1)
 
-  /*! @brief Heating integrals (without normalization factor, in m^3 s^-1). */
-  double _heating[NUMBER_OF_HEATINGTERMS];
+/*! @brief Position of the first reemission probability in the per cell data
+ *  block. */
+#define IONIZATIONVARIABLES_REEMISSION_PROBABILITY                             \
+  (IONIZATIONVARIABLES_HEATING + NUMBER_OF_HEATINGTERMS)
+
+/*! @brief Position of the first cooling rate in the per cell data block. */
+#define IONIZATIONVARIABLES_COOLING                                            \
+  (IONIZATIONVARIABLES_REEMISSION_PROBABILITY +                                \
+   NUMBER_OF_REEMISSIONPROBABILITIES)
 
 #ifdef DO_OUTPUT_COOLING
-  /*! @brief Cooling rates per element (in J s^-1). */
-  double _cooling[NUMBER_OF_IONNAMES];
+/*! @brief Size of the per cell data block. */
+#define IONIZATIONVARIABLES_NUMBER_OF_CELL_VALUES                              \
+  (IONIZATIONVARIABLES_COOLING + NUMBER_OF_IONNAMES)
+#else
+/*! @brief Size of the per cell data block. */
+#define IONIZATIONVARIABLES_NUMBER_OF_CELL_VALUES IONIZATIONVARIABLES_COOLING
 #endif
 
+/**
+ * @brief Read/write access to the variables used in the ionization calculation
+ * of a single cell.
+ *
+ * The variables of a cell are split in two groups. The state variables (number
+ * density, temperature and ionic fractions) are read by the photon traversal
+ * and by the ionization and temperature sweeps, and are stored with a constant
+ * stride between consecutive variables. If the stride is the number of cells,
+ * every state variable is stored in its own contiguous array over all cells
+ * (a structure-of-arrays layout, see IonizationVariablesArray). The remaining
+ * variables (mean intensity and heating integrals, reemission probabilities
+ * and cooling rates) are always updated together for a single cell and are
+ * stored in a contiguous per cell data block.
+ *
+ * This class only stores pointers to the actual values, so copies of it refer
+ * to the same cell. Use IonizationVariables to make a copy of the values.
+ */
+class IonizationVariablesReference {
+protected:
+  /*! @brief Pointer to the number density of the cell (the other state
+   *  variables follow at multiples of the stride). */
+  double *_state;
+
+  /*! @brief Distance between consecutive state variables of the cell. */
+  size_t _stride;
+
+  /*! @brief Per cell data block of the cell. */
+  double *_data;
+
 public:
   /**
-   * @brief (Empty) constructor.
+   * @brief Constructor.
+   *
+   * @param state Pointer to the number density of the cell.
+   * @param stride Distance between consecutive state variables of the cell.
+   * @param data Per cell data block of the cell.
    */
-  inline IonizationVariables() : _number_density(0.), _temperature(0.) {
-    for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
-      _ionic_fractions[i] = 0.;
-      _mean_intensity[i] = 0.;
-    }
-    for (int_fast32_t i = 0; i < NUMBER_OF_REEMISSIONPROBABILITIES; ++i) {
-      _reemission_probabilities[i] = 0.;
-    }
-    for (int_fast32_t i = 0; i < NUMBER_OF_HEATINGTERMS; ++i) {
-      _heating[i] = 0.;
+  inline IonizationVariablesReference(double *state, size_t stride,
+                                      double *data)
+      : _state(state), _stride(stride), _data(data) {}
+
+  /**
+   * @brief Copy all values of the given cell into the cell we refer to.
+   *
+   * @param values IonizationVariablesReference to copy from.
+   */
+  inline void copy_values(const IonizationVariablesReference &values) {
+    for (int_fast32_t i = 0; i < IONIZATIONVARIABLES_NUMBER_OF_STATE_VALUES;
+         ++i) {
+      _state[i * _stride] = values._state[i * values._stride];
     }
-#ifdef DO_OUTPUT_COOLING
-    for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
-      _cooling[i] = 0.;
+    for (int_fast32_t i = 0; i < IONIZATIONVARIABLES_NUMBER_OF_CELL_VALUES;
+         ++i) {
+      _data[i] = values._data[i];
     }
-#endif
   }
 
   /**
@@ -125,7 +175,9 @@ public:
    *
    * @return Number density (in m^-3).
    */
-  inline double get_number_density() const { return _number_density; }
+  inline double get_number_density() const {
+    return _state[IONIZATIONVARIABLES_NUMBER_DENSITY * _stride];
+  }
 
   /**
    * @brief Set the number density.
@@ -133,7 +185,7 @@ public:
    * @param number_density New number density (in m^-3).
    */
   inline void set_number_density(double number_density) {
-    _number_density = number_density;
+    _state[IONIZATIONVARIABLES_NUMBER_DENSITY * _stride] = number_density;
   }
 
   /**
@@ -141,7 +193,9 @@ public:
    *
    * @return Temperature (in K).
    */
-  inline double get_temperature() const { return _temperature; }
+  inline double get_temperature() const {
+    return _state[IONIZATIONVARIABLES_TEMPERATURE * _stride];
+  }
 
   /**
    * @brief Set the temperature.
@@ -149,17 +203,22 @@ public:
    * @param temperature New temperature (in K).
    */
   inline void set_temperature(double temperature) {
-    _temperature = temperature;
+    _state[IONIZATIONVARIABLES_TEMPERATURE * _stride] = temperature;
   }
 
   /**
    * @brief Get the ionic fraction of the ion with the given name.
    *
+   * For hydrogen and helium, these are the neutral fractions. For other
+   * elements, they are the fraction of the end product of ionization (e.g. the
+   * ionic fraction of ION_C_p1 is the fraction of C that is in the form of
+   * C++).
+   *
    * @param ion IonName.
    * @return Ionic fraction of that ion.
    */
   inline double get_ionic_fraction(IonName ion) const {
-    return _ionic_fractions[ion];
+    return _state[(IONIZATIONVARIABLES_IONIC_FRACTION + ion) * _stride];
   }
 
   /**
@@ -169,7 +228,8 @@ public:
    * @param ionic_fraction New ionic fraction for that ion.
    */
   inline void set_ionic_fraction(IonName ion, double ionic_fraction) {
-    _ionic_fractions[ion] = ionic_fraction;
+    _state[(IONIZATIONVARIABLES_IONIC_FRACTION + ion) * _stride] =
+        ionic_fraction;
   }
 
   /**
@@ -180,7 +240,7 @@ public:
    * in m^3).
    */
   inline double get_mean_intensity(IonName ion) const {
-    return _mean_intensity[ion];
+    return _data[IONIZATIONVARIABLES_MEAN_INTENSITY + ion];
   }
 
   /**
@@ -191,7 +251,7 @@ public:
    * ion (without normalization factor, in m^3).
    */
   inline void set_mean_intensity(IonName ion, double mean_intensity) {
-    _mean_intensity[ion] = mean_intensity;
+    _data[IONIZATIONVARIABLES_MEAN_INTENSITY + ion] = mean_intensity;
   }
 
   /**
@@ -203,12 +263,77 @@ public:
    */
   inline void increase_mean_intensity(IonName ion, double increment) {
 #ifdef USE_LOCKFREE
-    Atomic::add(_mean_intensity[ion], increment);
+    Atomic::add(_data[IONIZATIONVARIABLES_MEAN_INTENSITY + ion], increment);
 #else
-    _mean_intensity[ion] += increment;
+    _data[IONIZATIONVARIABLES_MEAN_INTENSITY + ion] += increment;
 #endif
   }
 
+  /**
+   * @brief Atomically add the given increment to the mean intensity integral
+   * for the ion with the given name.
+   *
+   * Unlike increase_mean_intensity(), this function is always thread safe,
+   * irrespective of the USE_LOCKFREE configuration option.
+   *
+   * @param ion IonName.
+   * @param increment Increment (without normalization factor, in m^3).
+   */
+  inline void atomic_increase_mean_intensity(IonName ion, double increment) {
+    Atomic::add(_data[IONIZATIONVARIABLES_MEAN_INTENSITY + ion], increment);
+  }
+
+  /**
+   * @brief Get the sum of the squares of the individual photon packet
+   * contributions to the hydrogen mean intensity integral.
+   *
+   * The relative Monte Carlo noise on the hydrogen mean intensity integral is
+   * the square root of this value divided by the integral itself.
+   *
+   * @return Second moment of the hydrogen mean intensity contributions
+   * (without normalization factor, in m^6).
+   */
+  inline double get_mean_intensity_second_moment() const {
+    return _data[IONIZATIONVARIABLES_MEAN_INTENSITY_SECOND_MOMENT];
+  }
+
+  /**
+   * @brief Set the sum of the squares of the individual photon packet
+   * contributions to the hydrogen mean intensity integral.
+   *
+   * @param second_moment New value for the second moment (without
+   * normalization factor, in m^6).
+   */
+  inline void set_mean_intensity_second_moment(double second_moment) {
+    _data[IONIZATIONVARIABLES_MEAN_INTENSITY_SECOND_MOMENT] = second_moment;
+  }
+
+  /**
+   * @brief Add the given increment to the second moment of the hydrogen mean
+   * intensity contributions.
+   *
+   * @param increment Increment (without normalization factor, in m^6).
+   */
+  inline void increase_mean_intensity_second_moment(double increment) {
+#ifdef USE_LOCKFREE
+    Atomic::add(_data[IONIZATIONVARIABLES_MEAN_INTENSITY_SECOND_MOMENT],
+                increment);
+#else
+    _data[IONIZATIONVARIABLES_MEAN_INTENSITY_SECOND_MOMENT] += increment;
+#endif
+  }
+
+  /**
+   * @brief Atomically add the given increment to the second moment of the
+   * hydrogen mean intensity contributions.
+   *
+   * @param increment Increment (without normalization factor, in m^6).
+   */
+  inline void atomic_increase_mean_intensity_second_moment(double increment) {
+    Atomic::add(_data[IONIZATIONVARIABLES_MEAN_INTENSITY_SECOND_MOMENT],
+                increment);
+  }
+
   /**
    * @brief Get the reemission probability for the channel with the given name.
    *
@@ -217,7 +342,7 @@ public:
    */
   inline double
   get_reemission_probability(ReemissionProbabilityName name) const {
-    return _reemission_probabilities[name];
+    return _data[IONIZATIONVARIABLES_REEMISSION_PROBABILITY + name];
   }
 
   /**
@@ -229,7 +354,8 @@ public:
    */
   inline void set_reemission_probability(ReemissionProbabilityName name,
                                          double reemission_probability) {
-    _reemission_probabilities[name] = reemission_probability;
+    _data[IONIZATIONVARIABLES_REEMISSION_PROBABILITY + name] =
+        reemission_probability;
   }
 
   /**
@@ -239,7 +365,7 @@ public:
    * @return Heating term (without normalization factor, in m^3 s^-1).
    */
   inline double get_heating(HeatingTermName name) const {
-    return _heating[name];
+    return _data[IONIZATIONVARIABLES_HEATING + name];
   }
 
   /**
@@ -250,7 +376,7 @@ public:
    * factor, in m^3 s^-1).
    */
   inline void set_heating(HeatingTermName name, double heating) {
-    _heating[name] = heating;
+    _data[IONIZATIONVARIABLES_HEATING + name] = heating;
   }
 
   /**
@@ -261,12 +387,26 @@ public:
    */
   inline void increase_heating(HeatingTermName name, double increment) {
 #ifdef USE_LOCKFREE
-    Atomic::add(_heating[name], increment);
+    Atomic::add(_data[IONIZATIONVARIABLES_HEATING + name], increment);
 #else
-    _heating[name] += increment;
+    _data[IONIZATIONVARIABLES_HEATING + name] += increment;
 #endif
   }
 
+  /**
+   * @brief Atomically add the given increment to the heating term with the
+   * given name.
+   *
+   * Unlike increase_heating(), this function is always thread safe,
+   * irrespective of the USE_LOCKFREE configuration option.
+   *
+   * @param name HeatingTermName.
+   * @param increment Increment (without normalization factor, in m^3 s^-1).
+   */
+  inline void atomic_increase_heating(HeatingTermName name, double increment) {
+    Atomic::add(_data[IONIZATIONVARIABLES_HEATING + name], increment);
+  }
+
 #ifdef DO_OUTPUT_COOLING
   /**
    * @brief Get the cooling rate for the ion with the given name.
@@ -274,7 +414,9 @@ public:
    * @param ion IonName.
    * @return Cooling rate (in J s^-1).
    */
-  inline double get_cooling(IonName ion) const { return _cooling[ion]; }
+  inline double get_cooling(IonName ion) const {
+    return _data[IONIZATIONVARIABLES_COOLING + ion];
+  }
 
   /**
    * @brief Set the cooling rate for the ion with the given name.
@@ -283,9 +425,75 @@ public:
    * @param cooling Cooling rate (in J s^-1).
    */
   inline void set_cooling(IonName ion, double cooling) {
-    _cooling[ion] = cooling;
+    _data[IONIZATIONVARIABLES_COOLING + ion] = cooling;
   }
 #endif
 };
 
+/**
+ * @brief Variables used in the ionization calculation.
+ *
+ * Stand alone copy of the variables of a single cell, with the same interface
+ * as the IonizationVariablesReference to the variables of a cell in a grid.
+ */
+class IonizationVariables : public IonizationVariablesReference {
+private:
+  /*! @brief State variables: number density (in m^-3), temperature (in K) and
+   *  ionic fractions. */
+  double _state_values[IONIZATIONVARIABLES_NUMBER_OF_STATE_VALUES];
+
+  /*! @brief Mean intensity integrals (in m^3), second moment of the hydrogen
+   *  mean intensity contributions (in m^6), heating integrals (in m^3 s^-1),
+   *  reemission probabilities and cooling rates (in J s^-1). */
+  double _cell_values[IONIZATIONVARIABLES_NUMBER_OF_CELL_VALUES];
+
+public:
+  /**
+   * @brief (Empty) constructor.
+   */
+  inline IonizationVariables()
+      : IonizationVariablesReference(_state_values, 1, _cell_values) {
+    for (int_fast32_t i = 0; i < IONIZATIONVARIABLES_NUMBER_OF_STATE_VALUES;
+         ++i) {
+      _state_values[i] = 0.;
+    }
+    for (int_fast32_t i = 0; i < IONIZATIONVARIABLES_NUMBER_OF_CELL_VALUES;
+         ++i) {
+      _cell_values[i] = 0.;
+    }
+  }
+
+  /**
+   * @brief Copy constructor.
+   *
+   * @param values IonizationVariables to copy.
+   */
+  inline IonizationVariables(const IonizationVariables &values)
+      : IonizationVariablesReference(_state_values, 1, _cell_values) {
+    copy_values(values);
+  }
+
+  /**
+   * @brief Constructor that copies the values of the given cell.
+   *
+   * @param values IonizationVariablesReference to the cell to copy.
+   */
+  inline explicit IonizationVariables(
+      const IonizationVariablesReference &values)
+      : IonizationVariablesReference(_state_values, 1, _cell_values) {
+    copy_values(values);
+  }
+
+  /**
+   * @brief Copy assignment operator.
+   *
+   * @param values IonizationVariables to copy.
+   * @return Reference to this object.
+   */
+  inline IonizationVariables &operator=(const IonizationVariables &values) {
+    copy_values(values);
+    return *this;
+  }
+};
+
 #endif // IONIZATIONVARIABLES_HPP
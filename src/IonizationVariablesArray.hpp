@@ -0,0 +1,249 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file IonizationVariablesArray.hpp
+ *
+ * @brief Structure-of-arrays storage for the IonizationVariables of all cells
+ * in a grid.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef IONIZATIONVARIABLESARRAY_HPP
+#define IONIZATIONVARIABLESARRAY_HPP
+
+#include "Error.hpp"
+#include "IonizationVariables.hpp"
+#include "RestartReader.hpp"
+#include "RestartWriter.hpp"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief Structure-of-arrays storage for the IonizationVariables of all cells
+ * in a grid.
+ *
+ * Every state variable (number density, temperature and every ionic fraction)
+ * is stored in its own contiguous array over all cells, so that the photon
+ * traversal only loads the values it actually needs, and so that the
+ * ionization and temperature sweeps can operate on contiguous arrays. The
+ * arrays for the different variables are stored back to back in a single
+ * allocation, with a distance between them equal to the capacity of the
+ * storage.
+ *
+ * The mean intensity and heating integrals are always updated together when a
+ * photon crosses a cell, and are therefore kept in a contiguous data block per
+ * cell, together with the other variables of the cell.
+ *
+ * The variables of a single cell are accessed through an
+ * IonizationVariablesReference, which has the same interface as
+ * IonizationVariables. Like for an std::vector, references are invalidated by
+ * operations that increase the capacity of the storage.
+ */
+class IonizationVariablesArray {
+private:
+  /*! @brief Number of cells. */
+  size_t _size;
+
+  /*! @brief Number of cells for which memory is allocated. This is also the
+   *  distance between the arrays of consecutive state variables. */
+  size_t _capacity;
+
+  /*! @brief State variables of all cells. */
+  std::vector< double > _state;
+
+  /*! @brief Per cell data blocks of all cells. */
+  std::vector< double > _data;
+
+  /**
+   * @brief Make sure memory is allocated for at least the given number of
+   * cells.
+   *
+   * The arrays for the state variables are moved to their new position.
+   *
+   * @param capacity Minimum number of cells.
+   */
+  inline void reserve(size_t capacity) {
+    if (capacity <= _capacity) {
+      return;
+    }
+    std::vector< double > state(
+        IONIZATIONVARIABLES_NUMBER_OF_STATE_VALUES * capacity, 0.);
+    for (int_fast32_t i = 0; i < IONIZATIONVARIABLES_NUMBER_OF_STATE_VALUES;
+         ++i) {
+      std::copy(_state.begin() + i * _capacity,
+                _state.begin() + i * _capacity + _size,
+                state.begin() + i * capacity);
+    }
+    _state.swap(state);
+    _capacity = capacity;
+  }
+
+public:
+  /**
+   * @brief Empty constructor.
+   */
+  inline IonizationVariablesArray() : _size(0), _capacity(0) {}
+
+  /**
+   * @brief Get the number of cells.
+   *
+   * @return Number of cells.
+   */
+  inline size_t size() const { return _size; }
+
+  /**
+   * @brief Change the number of cells.
+   *
+   * New cells have all their variables set to 0.
+   *
+   * @param size New number of cells.
+   */
+  inline void resize(size_t size) {
+    reserve(size);
+    for (int_fast32_t i = 0; i < IONIZATIONVARIABLES_NUMBER_OF_STATE_VALUES;
+         ++i) {
+      for (size_t j = size; j < _size; ++j) {
+        _state[i * _capacity + j] = 0.;
+      }
+    }
+    _data.resize(size * IONIZATIONVARIABLES_NUMBER_OF_CELL_VALUES, 0.);
+    _size = size;
+  }
+
+  /**
+   * @brief Add a cell with the given variables.
+   *
+   * The capacity is doubled if necessary, so that adding cells one by one
+   * only requires a logarithmic number of reallocations.
+   *
+   * @param values Variables of the new cell.
+   */
+  inline void push_back(const IonizationVariablesReference &values) {
+    // make a copy, since the values might be stored in this array
+    const IonizationVariables copy(values);
+    if (_size == _capacity) {
+      reserve(std::max(size_t(1), 2 * _capacity));
+    }
+    resize(_size + 1);
+    back().copy_values(copy);
+  }
+
+  /**
+   * @brief Get read/write access to the variables of the cell with the given
+   * index.
+   *
+   * @param index Index of a cell.
+   * @return IonizationVariablesReference to the variables of that cell.
+   */
+  inline IonizationVariablesReference operator[](size_t index) {
+    cmac_assert(index < _size);
+    return IonizationVariablesReference(
+        &_state[index], _capacity,
+        &_data[index * IONIZATIONVARIABLES_NUMBER_OF_CELL_VALUES]);
+  }
+
+  /**
+   * @brief Get read only access to the variables of the cell with the given
+   * index.
+   *
+   * @param index Index of a cell.
+   * @return Read only IonizationVariablesReference to the variables of that
+   * cell.
+   */
+  inline const IonizationVariablesReference operator[](size_t index) const {
+    cmac_assert(index < _size);
+    return IonizationVariablesReference(
+        const_cast< double * >(&_state[index]), _capacity,
+        const_cast< double * >(
+            &_data[index * IONIZATIONVARIABLES_NUMBER_OF_CELL_VALUES]));
+  }
+
+  /**
+   * @brief Get read/write access to the variables of the last cell.
+   *
+   * @return IonizationVariablesReference to the variables of the last cell.
+   */
+  inline IonizationVariablesReference back() { return (*this)[_size - 1]; }
+
+  /**
+   * @brief Get the contiguous array containing the number densities of all
+   * cells.
+   *
+   * @return Number densities (in m^-3).
+   */
+  inline double *get_number_densities() {
+    return &_state[IONIZATIONVARIABLES_NUMBER_DENSITY * _capacity];
+  }
+
+  /**
+   * @brief Get the contiguous array containing the temperatures of all cells.
+   *
+   * @return Temperatures (in K).
+   */
+  inline double *get_temperatures() {
+    return &_state[IONIZATIONVARIABLES_TEMPERATURE * _capacity];
+  }
+
+  /**
+   * @brief Get the contiguous array containing the ionic fractions of the ion
+   * with the given name for all cells.
+   *
+   * @param ion IonName.
+   * @return Ionic fractions of that ion.
+   */
+  inline double *get_ionic_fractions(IonName ion) {
+    return &_state[(IONIZATIONVARIABLES_IONIC_FRACTION + ion) * _capacity];
+  }
+
+  /**
+   * @brief Write the variables of all cells to the given RestartWriter.
+   *
+   * @param restart_writer RestartWriter to write to.
+   */
+  inline void write_restart_file(RestartWriter &restart_writer) const {
+    restart_writer.write(uint_fast64_t(_capacity));
+    restart_writer.write(_state);
+    restart_writer.write(_data);
+  }
+
+  /**
+   * @brief Read the variables of all cells from the given RestartReader.
+   *
+   * The number of cells should match the number of cells in the file.
+   *
+   * @param restart_reader RestartReader to read from.
+   */
+  inline void read_restart_file(RestartReader &restart_reader) {
+    const size_t expected_size = _size;
+    _capacity = restart_reader.read< uint_fast64_t >();
+    restart_reader.read(_state);
+    restart_reader.read(_data);
+    _size = _data.size() / IONIZATIONVARIABLES_NUMBER_OF_CELL_VALUES;
+    if (_size != expected_size ||
+        _state.size() !=
+            IONIZATIONVARIABLES_NUMBER_OF_STATE_VALUES * _capacity) {
+      cmac_error("Wrong number of cells in restart file (%zu, expected %zu)! "
+                 "Was the file written for a different setup?",
+                 _size, expected_size);
+    }
+  }
+};
+
+#endif // IONIZATIONVARIABLESARRAY_HPP
@@ -109,6 +109,35 @@ public:
   }
 };
 
+/**
+ * @brief PropertyAccessor for the second moment of the hydrogen mean intensity
+ * contributions.
+ */
+class MeanIntensitySecondMomentPropertyAccessor {
+public:
+  /**
+   * @brief Get the second moment of the hydrogen mean intensity contributions.
+   *
+   * @param it DensityGrid::iterator pointing to a cell.
+   * @return Second moment for that cell (in m^6).
+   */
+  inline static double get_value(const DensityGrid::iterator &it) {
+    return it.get_ionization_variables().get_mean_intensity_second_moment();
+  }
+
+  /**
+   * @brief Set the second moment of the hydrogen mean intensity contributions.
+   *
+   * @param it DensityGrid::iterator pointing to a cell.
+   * @param second_moment Second moment for that cell (in m^6).
+   */
+  inline static void set_value(DensityGrid::iterator &it,
+                               double second_moment) {
+    it.get_ionization_variables().set_mean_intensity_second_moment(
+        second_moment);
+  }
+};
+
 /**
  * @brief PropertyAccessor for the temperature.
  */
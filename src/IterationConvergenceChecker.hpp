@@ -0,0 +1,468 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file IterationConvergenceChecker.hpp
+ *
+ * @brief Object that decides when the photoionization iteration has converged
+ * and how many photons should be used for the next iteration.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef ITERATIONCONVERGENCECHECKER_HPP
+#define ITERATIONCONVERGENCECHECKER_HPP
+
+#include "DensityGrid.hpp"
+#include "Log.hpp"
+#include "ParameterFile.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+
+/*! @brief Maximal ratio of the neutral fraction change and the expected
+ *  Monte Carlo noise on that change for which we assume that the change is
+ *  dominated by Monte Carlo noise. */
+#define ITERATIONCONVERGENCECHECKER_NOISE_FACTOR 2.
+
+/*! @brief Target value for the expected Monte Carlo noise (w.r.t. the
+ *  tolerance) used to scale the photon number. */
+#define ITERATIONCONVERGENCECHECKER_NOISE_TARGET 0.5
+
+/*! @brief Factor (w.r.t. the tolerance) above which the change is considered
+ *  to be large enough to make a high photon number pointless, provided the
+ *  change is still dominated by the systematic evolution of the solution. */
+#define ITERATIONCONVERGENCECHECKER_LARGE_CHANGE_FACTOR 10.
+
+/**
+ * @brief Statistics for a single iteration of the photoionization algorithm.
+ */
+class IterationStatistics {
+public:
+  /*! @brief Iteration number. */
+  uint_fast32_t _iteration;
+
+  /*! @brief Number of photons used during the iteration. */
+  uint_fast64_t _number_of_photons;
+
+  /*! @brief RMS change in neutral fraction. */
+  double _neutral_fraction_change;
+
+  /*! @brief Maximal change in neutral fraction. */
+  double _maximum_neutral_fraction_change;
+
+  /*! @brief RMS relative change in temperature. */
+  double _temperature_change;
+
+  /*! @brief Ratio of the total change w.r.t. the total change in the previous
+   *  iteration. */
+  double _change_ratio;
+
+  /*! @brief Expected RMS change in neutral fraction due to Monte Carlo noise
+   *  alone. */
+  double _noise;
+
+  /*! @brief Was the change dominated by Monte Carlo noise? */
+  bool _noise_dominated;
+
+  /*! @brief Did the iteration meet the convergence criterion? */
+  bool _converged;
+};
+
+/**
+ * @brief Object that decides when the photoionization iteration has converged
+ * and how many photons should be used for the next iteration.
+ *
+ * After every iteration, we compute the change in neutral fraction and the
+ * relative change in temperature for every cell w.r.t. the previous iteration,
+ * and combine these into a single RMS change. We use the absolute change for
+ * the neutral fraction, since the relative change in highly ionized cells is
+ * completely dominated by Monte Carlo noise and does not matter. The iteration
+ * is converged if this change is below the tolerance (and a minimal number of
+ * iterations was performed).
+ *
+ * The change between two iterations consists of a systematic part, that
+ * decreases quickly as the algorithm converges, and a Monte Carlo noise part,
+ * that only decreases if more photons are used. We estimate the noise part
+ * from the Monte Carlo estimators themselves: the relative noise on the
+ * hydrogen mean intensity integral of a cell is
+ * @f$\epsilon = \sqrt{\sum_i c_i^2} / \sum_i c_i@f$, with @f$c_i@f$ the
+ * contributions of the individual photon packets (@f$\epsilon \approx
+ * 1/\sqrt{N}@f$ for @f$N@f$ similar contributions). In ionization
+ * equilibrium, this translates into a noise
+ * @f$\sigma_x = \frac{x(1-x)}{1+x}\epsilon@f$ on the neutral fraction
+ * @f$x@f$. The noise on the change is the combination of the noise of the
+ * current and the previous iteration. We do not estimate the noise on the
+ * temperature, as the temperature depends on the ratio of the heating and
+ * photoionization integrals, which are strongly correlated.
+ *
+ * If the neutral fraction change is comparable to the expected noise, we
+ * consider it noise dominated. The iteration is only converged if both the
+ * change and the expected noise are below the tolerance. If the expected noise
+ * is too large, we increase the photon number by the factor that is needed to
+ * reduce it to a fixed fraction of the tolerance. If the change is large and
+ * not noise dominated, more photons would be wasted and we decrease the photon
+ * number, as long as this keeps the expected noise below that target.
+ */
+class IterationConvergenceChecker {
+private:
+  /*! @brief Tolerance on the RMS change. */
+  const double _tolerance;
+
+  /*! @brief Minimum number of iterations before the checker will decide the
+   *  iteration has converged. */
+  const uint_fast32_t _minimum_number_of_iterations;
+
+  /*! @brief Minimum number of photons to use during an iteration. */
+  const uint_fast64_t _minimum_number_of_photons;
+
+  /*! @brief Maximum number of photons to use during an iteration. */
+  const uint_fast64_t _maximum_number_of_photons;
+
+  /*! @brief Maximum factor by which the photon number is decreased. */
+  const double _photon_number_factor;
+
+  /*! @brief Neutral fractions of hydrogen at the end of the previous
+   *  iteration. */
+  std::vector< double > _old_neutral_fractions;
+
+  /*! @brief Temperatures at the end of the previous iteration (in K). */
+  std::vector< double > _old_temperatures;
+
+  /*! @brief Estimated Monte Carlo variance on the neutral fractions at the end
+   *  of the previous iteration. */
+  std::vector< double > _old_neutral_fraction_variances;
+
+  /*! @brief Total change during the previous iteration. */
+  double _old_change;
+
+  /*! @brief Statistics for all iterations since the last call to
+   *  initialize(). */
+  std::vector< IterationStatistics > _statistics;
+
+  /*! @brief Log to write logging info to. */
+  Log *_log;
+
+  /**
+   * @brief Get the symmetric relative difference between two values.
+   *
+   * @param a First value.
+   * @param b Second value.
+   * @return Relative difference, in the range [0, 1].
+   */
+  inline static double relative_difference(const double a, const double b) {
+    const double sum = std::abs(a) + std::abs(b);
+    if (sum == 0.) {
+      return 0.;
+    } else {
+      return std::abs(a - b) / sum;
+    }
+  }
+
+  /**
+   * @brief Estimate the Monte Carlo variance on the neutral fraction of the
+   * given cell.
+   *
+   * @param vars IonizationVariables of the cell.
+   * @return Estimated variance on the neutral fraction.
+   */
+  inline static double
+  get_neutral_fraction_variance(const IonizationVariablesReference &vars) {
+    const double J = vars.get_mean_intensity(ION_H_n);
+    if (J <= 0.) {
+      // no photon packets reached this cell, so there is no noise
+      return 0.;
+    }
+    const double relative_variance =
+        std::min(vars.get_mean_intensity_second_moment() / (J * J), 1.);
+    const double xH = vars.get_ionic_fraction(ION_H_n);
+    const double dxH = xH * (1. - xH) / (1. + xH);
+    return dxH * dxH * relative_variance;
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param tolerance Tolerance on the RMS change.
+   * @param minimum_number_of_iterations Minimum number of iterations before
+   * the checker will decide the iteration has converged.
+   * @param minimum_number_of_photons Minimum number of photons to use during
+   * an iteration.
+   * @param maximum_number_of_photons Maximum number of photons to use during
+   * an iteration.
+   * @param photon_number_factor Maximum factor by which the photon number is
+   * decreased.
+   * @param log Log to write logging info to.
+   */
+  IterationConvergenceChecker(const double tolerance,
+                              const uint_fast32_t minimum_number_of_iterations,
+                              const uint_fast64_t minimum_number_of_photons,
+                              const uint_fast64_t maximum_number_of_photons,
+                              const double photon_number_factor,
+                              Log *log = nullptr)
+      : _tolerance(tolerance),
+        _minimum_number_of_iterations(minimum_number_of_iterations),
+        _minimum_number_of_photons(minimum_number_of_photons),
+        _maximum_number_of_photons(maximum_number_of_photons),
+        _photon_number_factor(photon_number_factor), _old_change(0.),
+        _log(log) {
+
+    if (_minimum_number_of_photons > _maximum_number_of_photons) {
+      cmac_error("Minimum number of photons (%" PRIuFAST64
+                 ") larger than maximum number of photons (%" PRIuFAST64 ")!",
+                 _minimum_number_of_photons, _maximum_number_of_photons);
+    }
+    if (_photon_number_factor < 1.) {
+      cmac_error("Photon number factor should be at least 1 (got %g)!",
+                 _photon_number_factor);
+    }
+
+    if (_log) {
+      _log->write_status(
+          "Created IterationConvergenceChecker with tolerance ", _tolerance,
+          ", at least ", _minimum_number_of_iterations,
+          " iterations, and a photon number between ",
+          _minimum_number_of_photons, " and ", _maximum_number_of_photons,
+          " (factor ", _photon_number_factor, ").");
+    }
+  }
+
+  /**
+   * @brief ParameterFile constructor.
+   *
+   * Parameters are:
+   *  - tolerance: Tolerance on the RMS change in neutral fraction and relative
+   *    change in temperature (default: 0.01)
+   *  - minimum number of iterations: Minimum number of iterations before the
+   *    iteration can be considered to be converged (default: 3)
+   *  - minimum number of photons: Minimum number of photons to use during an
+   *    iteration (default: 0.1 * (number of photons))
+   *  - maximum number of photons: Maximum number of photons to use during an
+   *    iteration (default: 10 * (number of photons))
+   *  - photon number factor: Maximum factor by which the number of photons is
+   *    decreased (default: 2.). The factor by which the number of photons is
+   *    increased follows from the estimated Monte Carlo noise.
+   *
+   * @param number_of_photons Reference number of photons per iteration.
+   * @param params ParameterFile to read from.
+   * @param log Log to write logging info to.
+   */
+  IterationConvergenceChecker(const uint_fast64_t number_of_photons,
+                              ParameterFile &params, Log *log = nullptr)
+      : IterationConvergenceChecker(
+            params.get_value< double >("IterationConvergenceChecker:tolerance",
+                                       0.01),
+            params.get_value< uint_fast32_t >(
+                "IterationConvergenceChecker:minimum number of iterations", 3),
+            params.get_value< uint_fast64_t >(
+                "IterationConvergenceChecker:minimum number of photons",
+                std::max(number_of_photons / 10, uint_fast64_t(1))),
+            params.get_value< uint_fast64_t >(
+                "IterationConvergenceChecker:maximum number of photons",
+                10 * number_of_photons),
+            params.get_value< double >(
+                "IterationConvergenceChecker:photon number factor", 2.),
+            log) {}
+
+  /**
+   * @brief Store the current state of the grid as a reference for the first
+   * iteration.
+   *
+   * This function also clears the statistics for previous iterations.
+   *
+   * @param grid DensityGrid.
+   */
+  inline void initialize(DensityGrid &grid) {
+    _old_neutral_fractions.resize(grid.get_number_of_cells());
+    _old_temperatures.resize(grid.get_number_of_cells());
+    // the reference state is assumed to be noise free
+    _old_neutral_fraction_variances.assign(grid.get_number_of_cells(), 0.);
+    size_t index = 0;
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      const IonizationVariablesReference vars = it.get_ionization_variables();
+      _old_neutral_fractions[index] = vars.get_ionic_fraction(ION_H_n);
+      _old_temperatures[index] = vars.get_temperature();
+      ++index;
+    }
+    _old_change = 0.;
+    _statistics.clear();
+  }
+
+  /**
+   * @brief Check if the iteration has converged, and update the number of
+   * photons for the next iteration.
+   *
+   * @param grid DensityGrid at the end of the current iteration.
+   * @param number_of_photons Number of photons used during the current
+   * iteration. Is updated to the number of photons to use during the next
+   * iteration.
+   * @return True if the iteration has converged.
+   */
+  inline bool is_converged(DensityGrid &grid,
+                           uint_fast64_t &number_of_photons) {
+
+    if (_old_neutral_fractions.size() != grid.get_number_of_cells()) {
+      cmac_error("IterationConvergenceChecker was not initialized!");
+    }
+
+    double neutral_fraction_change = 0.;
+    double maximum_neutral_fraction_change = 0.;
+    double temperature_change = 0.;
+    double noise = 0.;
+    size_t index = 0;
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      const IonizationVariablesReference vars = it.get_ionization_variables();
+      const double xH = vars.get_ionic_fraction(ION_H_n);
+      const double T = vars.get_temperature();
+      const double dxH = std::abs(xH - _old_neutral_fractions[index]);
+      const double dT = relative_difference(T, _old_temperatures[index]);
+      neutral_fraction_change += dxH * dxH;
+      maximum_neutral_fraction_change =
+          std::max(maximum_neutral_fraction_change, dxH);
+      temperature_change += dT * dT;
+      const double variance = get_neutral_fraction_variance(vars);
+      noise += _old_neutral_fraction_variances[index] + variance;
+      _old_neutral_fraction_variances[index] = variance;
+      _old_neutral_fractions[index] = xH;
+      _old_temperatures[index] = T;
+      ++index;
+    }
+    const double number_of_cells = std::max(index, size_t(1));
+    neutral_fraction_change =
+        std::sqrt(neutral_fraction_change / number_of_cells);
+    temperature_change = std::sqrt(temperature_change / number_of_cells);
+    noise = std::sqrt(noise / number_of_cells);
+    const double change = std::sqrt(neutral_fraction_change *
+                                        neutral_fraction_change +
+                                    temperature_change * temperature_change);
+
+    IterationStatistics statistics;
+    statistics._iteration = _statistics.size();
+    statistics._number_of_photons = number_of_photons;
+    statistics._neutral_fraction_change = neutral_fraction_change;
+    statistics._maximum_neutral_fraction_change =
+        maximum_neutral_fraction_change;
+    statistics._temperature_change = temperature_change;
+    // the first iteration has no previous change to compare with
+    if (_old_change > 0.) {
+      statistics._change_ratio = change / _old_change;
+    } else {
+      statistics._change_ratio = 0.;
+    }
+    statistics._noise = noise;
+    // if the change is comparable to the expected noise, it is a measure for
+    // the Monte Carlo noise rather than for the convergence of the solution
+    const bool noise_dominated =
+        neutral_fraction_change <=
+        ITERATIONCONVERGENCECHECKER_NOISE_FACTOR * noise;
+    statistics._noise_dominated = noise_dominated;
+    // a small change only means convergence if the noise is small as well
+    statistics._converged = (change < _tolerance) && (noise < _tolerance) &&
+                            (_statistics.size() + 1 >=
+                             _minimum_number_of_iterations);
+
+    _old_change = change;
+
+    if (!statistics._converged) {
+      // the noise scales as 1/sqrt(number of photons)
+      const double target_noise =
+          ITERATIONCONVERGENCECHECKER_NOISE_TARGET * _tolerance;
+      const bool large_change =
+          change > ITERATIONCONVERGENCECHECKER_LARGE_CHANGE_FACTOR * _tolerance;
+      if (noise > target_noise && (noise_dominated || !large_change)) {
+        const double factor = noise * noise / (target_noise * target_noise);
+        number_of_photons =
+            std::min(uint_fast64_t(std::ceil(number_of_photons * factor)),
+                     _maximum_number_of_photons);
+      } else if (!noise_dominated && large_change) {
+        double factor = _photon_number_factor;
+        if (noise > 0.) {
+          factor = std::min(factor, target_noise * target_noise /
+                                        (noise * noise));
+        }
+        if (factor > 1.) {
+          number_of_photons = std::max(
+              uint_fast64_t(number_of_photons / factor),
+              _minimum_number_of_photons);
+        }
+      }
+      number_of_photons =
+          std::max(std::min(number_of_photons, _maximum_number_of_photons),
+                   _minimum_number_of_photons);
+    }
+
+    if (_log) {
+      _log->write_status(
+          "Iteration ", statistics._iteration, ": ",
+          statistics._number_of_photons,
+          " photons, RMS neutral fraction change ",
+          statistics._neutral_fraction_change, " (max ",
+          statistics._maximum_neutral_fraction_change,
+          "), RMS temperature change ", statistics._temperature_change,
+          ", change ratio ", statistics._change_ratio,
+          ", expected noise ", statistics._noise,
+          (noise_dominated ? " (noise dominated)" : ""), ", converged: ",
+          (statistics._converged ? "yes" : "no"), ", next photon number: ",
+          number_of_photons, ".");
+    }
+
+    _statistics.push_back(statistics);
+
+    return statistics._converged;
+  }
+
+  /**
+   * @brief Get the statistics for all iterations since the last call to
+   * initialize().
+   *
+   * @return Statistics for all iterations.
+   */
+  inline const std::vector< IterationStatistics > &get_statistics() const {
+    return _statistics;
+  }
+
+  /**
+   * @brief Write the state of the checker to the given RestartWriter.
+   *
+   * @param restart_writer RestartWriter to write to.
+   */
+  inline void write_restart_file(RestartWriter &restart_writer) const {
+    restart_writer.write(_old_neutral_fractions);
+    restart_writer.write(_old_temperatures);
+    restart_writer.write(_old_neutral_fraction_variances);
+    restart_writer.write(_old_change);
+    restart_writer.write(_statistics);
+  }
+
+  /**
+   * @brief Restore the state of the checker from the given RestartReader.
+   *
+   * @param restart_reader RestartReader to read from.
+   */
+  inline void read_restart_file(RestartReader &restart_reader) {
+    restart_reader.read(_old_neutral_fractions);
+    restart_reader.read(_old_temperatures);
+    restart_reader.read(_old_neutral_fraction_variances);
+    _old_change = restart_reader.read< double >();
+    restart_reader.read(_statistics);
+  }
+};
+
+#endif // ITERATIONCONVERGENCECHECKER_HPP
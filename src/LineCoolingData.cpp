@@ -27,6 +27,8 @@
 #include "LineCoolingData.hpp"
 #include "Error.hpp"
 #include "PhysicalConstants.hpp"
+#include <algorithm>
+#include <cinttypes>
 #include <cmath>
 #include <cstdlib>
 #include <fstream>
@@ -1556,190 +1558,645 @@ int LineCoolingData::solve_system_of_linear_equations(double A[5][5],
 }
 
 /**
- * @brief Find the level populations for the given element at the given
- * temperature.
+ * @brief Solve a batch of systems of 5 coupled linear equations.
  *
- * @param element LineCoolingDataFiveLevelElement.
- * @param collision_strength_prefactor Prefactor for the collision strengths
- * (in s^-1).
+ * This function does exactly the same as solve_system_of_linear_equations(),
+ * but for LINECOOLINGDATA_NUMFIVELEVELELEMENTS independent systems at once.
+ * The last index of both @f$A@f$ and @f$B@f$ is the index of the system. The
+ * pivot search and row interchanges are done separately for every system,
+ * while the elimination and substitution loops run over all systems at once,
+ * so that the compiler can vectorize them.
+ *
+ * @param A Elements of the matrices @f$A@f$.
+ * @param B Elements of the matrices @f$B@f$, and elements of the solutions on
+ * exit.
+ * @return Exit code: 0 on success. If a non zero value is returned, it is the
+ * index of the first singular system plus one, and the values stored in B on
+ * exit are meaningless and should not be used.
+ */
+int LineCoolingData::solve_systems_of_linear_equations(
+    double A[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS],
+    double B[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS]) {
+
+  for (uint_fast8_t j = 0; j < 5; ++j) {
+    for (int_fast32_t l = 0; l < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++l) {
+      // find the next row with the largest coefficient
+      uint_fast8_t imax = 0;
+      double Amax = 0.;
+      for (uint_fast8_t i = j; i < 5; ++i) {
+        if (std::abs(A[i][j][l]) > std::abs(Amax)) {
+          Amax = A[i][j][l];
+          imax = i;
+        }
+      }
+      // check that the matrix is non-singular
+      if (Amax == 0.) {
+        return l + 1;
+      }
+      const double Amax_inv = 1. / Amax;
+      // interchange rows if necessary and normalize row j
+      // we only need the columns to the right of the diagonal
+      if (imax != j) {
+        for (uint_fast8_t k = j + 1; k < 5; ++k) {
+          const double save = A[j][k][l];
+          A[j][k][l] = A[imax][k][l];
+          A[imax][k][l] = save;
+        }
+        const double save = A[j][j][l];
+        A[j][j][l] = A[imax][j][l];
+        A[imax][j][l] = save;
+        const double saveB = B[j][l];
+        B[j][l] = B[imax][l];
+        B[imax][l] = saveB;
+      }
+      for (uint_fast8_t k = j + 1; k < 5; ++k) {
+        A[j][k][l] *= Amax_inv;
+      }
+      B[j][l] *= Amax_inv;
+    }
+    // use row j to eliminate all rows below row j
+    for (uint_fast8_t i = j + 1; i < 5; ++i) {
+      for (uint_fast8_t k = j + 1; k < 5; ++k) {
+        for (int_fast32_t l = 0; l < LINECOOLINGDATA_NUMFIVELEVELELEMENTS;
+             ++l) {
+          A[i][k][l] -= A[i][j][l] * A[j][k][l];
+        }
+      }
+      for (int_fast32_t l = 0; l < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++l) {
+        B[i][l] -= A[i][j][l] * B[j][l];
+      }
+    }
+  }
+  // back substitution
+  for (uint_fast8_t i = 0; i < 4; ++i) {
+    for (uint_fast8_t j = 0; j < i + 1; ++j) {
+      for (int_fast32_t l = 0; l < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++l) {
+        B[3 - i][l] -= B[4 - j][l] * A[3 - i][4 - j][l];
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Evaluate the collision rate coefficient for deexcitation for the given
+ * collision strength fit parameters.
+ *
+ * The rate coefficient has the form
+ * \f[
+ *   q(T) = \frac{P}{\sqrt{T}} T^{1+a_0} \left(a_1 + \frac{a_2}{T} + a_3\log{T}
+ *          + a_4 T \left(1 + (a_5 - 1) T^{a_6}\right)\right),
+ * \f]
+ * so that its derivative with respect to \f$\log{T}\f$ can be computed
+ * analytically.
+ *
+ * @param fit Collision strength fit parameters \f$a_0 - a_6\f$.
+ * @param prefactor Collision strength prefactor divided by the square root of
+ * the temperature, \f$\frac{P}{\sqrt{T}}\f$ (in m^3 s^-1).
  * @param T Temperature (in K).
- * @param Tinv Inverse of the temperature (in K^-1).
- * @param logT Natural logarithm of the temperature in K.
- * @param level_populations Array to store the resulting level populations in.
+ * @param Tinv Inverse temperature (in K^-1).
+ * @param logT Natural logarithm of the temperature.
+ * @param derivative Variable to store the derivative of the rate coefficient
+ * with respect to \f$\log{T}\f$ in (in m^3 s^-1; not computed if this is a
+ * null pointer).
+ * @return Collision rate coefficient (in m^3 s^-1).
  */
-void LineCoolingData::compute_level_populations(
-    LineCoolingDataFiveLevelElement element,
-    double collision_strength_prefactor, double T, double Tinv, double logT,
-    double level_populations[5]) const {
+double LineCoolingData::get_collision_rate_coefficient(const double fit[7],
+                                                       double prefactor,
+                                                       double T, double Tinv,
+                                                       double logT,
+                                                       double *derivative) {
+
+  const double prefactor_T = prefactor * std::pow(T, 1. + fit[0]);
+  const double T_a6 = std::pow(T, fit[6]);
+  const double fit_value = fit[1] + fit[2] * Tinv + fit[3] * logT +
+                           fit[4] * T * (1. + (fit[5] - 1.) * T_a6);
+  if (derivative != nullptr) {
+    const double dfit_value =
+        -fit[2] * Tinv + fit[3] +
+        fit[4] * T * (1. + (fit[5] - 1.) * (1. + fit[6]) * T_a6);
+    *derivative = prefactor_T * ((0.5 + fit[0]) * fit_value + dfit_value);
+  }
+  return prefactor_T * fit_value;
+}
 
-  double level_matrix[5][5];
-  // initialize the level populations and the first row of the coefficient
-  // matrix
-  for (uint_fast8_t i = 0; i < 5; ++i) {
-    level_matrix[0][i] = 1.;
-    level_populations[i] = 0.;
+/**
+ * @brief Compute the collision rate coefficients for all transitions of all
+ * elements at the given temperature, and optionally their derivatives with
+ * respect to \f$\log{T}\f$.
+ *
+ * @param temperature Temperature (in K).
+ * @param collision_rate_coefficient_down Array to store the collision rate
+ * coefficients for deexcitation in (in m^3 s^-1).
+ * @param collision_rate_coefficient_up Array to store the collision rate
+ * coefficients for excitation in (in m^3 s^-1).
+ * @param dcollision_rate_coefficient_down Array to store the derivatives of
+ * the collision rate coefficients for deexcitation in (in m^3 s^-1; not
+ * computed if this is a null pointer).
+ * @param dcollision_rate_coefficient_up Array to store the derivatives of the
+ * collision rate coefficients for excitation in (in m^3 s^-1; only computed if
+ * dcollision_rate_coefficient_down is computed).
+ */
+void LineCoolingData::compute_collision_rate_coefficients(
+    double temperature,
+    double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                          [NUMBER_OF_TRANSITIONS],
+    double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                        [NUMBER_OF_TRANSITIONS],
+    double dcollision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                           [NUMBER_OF_TRANSITIONS],
+    double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                         [NUMBER_OF_TRANSITIONS]) const {
+
+  // _collision_strength_prefactor has units K^0.5 m^3 s^-1;
+  // collision_strength_prefactor has units m^3 s^-1
+  const double collision_strength_prefactor =
+      _collision_strength_prefactor / std::sqrt(temperature);
+  const double T = temperature;
+  const double Tinv = 1. / temperature;
+  const double logT = std::log(temperature);
+  const bool derivatives = (dcollision_rate_coefficient_down != nullptr);
+
+  double derivative = 0.;
+  for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++j) {
+    for (int_fast32_t i = 0; i < NUMBER_OF_TRANSITIONS; ++i) {
+      const double collision_strength = get_collision_rate_coefficient(
+          _five_level_collision_strength[j][i], collision_strength_prefactor,
+          T, Tinv, logT, derivatives ? &derivative : nullptr);
+      const double boltzmann_factor =
+          std::exp(-_five_level_energy_difference[j][i] * Tinv);
+      collision_rate_coefficient_down[j][i] = collision_strength;
+      collision_rate_coefficient_up[j][i] =
+          collision_strength * boltzmann_factor;
+      if (derivatives) {
+        dcollision_rate_coefficient_down[j][i] = derivative;
+        dcollision_rate_coefficient_up[j][i] =
+            boltzmann_factor *
+            (derivative +
+             collision_strength * _five_level_energy_difference[j][i] * Tinv);
+      }
+    }
   }
-  // the first row of the coefficient matrix expresses the constant number of
-  // particles: the sum of all level populations is unity
-  level_populations[0] = 1.;
-
-  // precompute the collision rates for the given temperature
-  double collision_rate_down[NUMBER_OF_TRANSITIONS];
-  double collision_rate_up[NUMBER_OF_TRANSITIONS];
-  for (int_fast32_t i = 0; i < NUMBER_OF_TRANSITIONS; ++i) {
-    const double collision_strength =
-        collision_strength_prefactor *
-        std::pow(T, 1. + _five_level_collision_strength[element][i][0]) *
-        (_five_level_collision_strength[element][i][1] +
-         _five_level_collision_strength[element][i][2] * Tinv +
-         _five_level_collision_strength[element][i][3] * logT +
-         _five_level_collision_strength[element][i][4] * T *
-             (1. +
-              (_five_level_collision_strength[element][i][5] - 1.) *
-                  std::pow(T, _five_level_collision_strength[element][i][6])));
-    collision_rate_down[i] = collision_strength;
-    collision_rate_up[i] =
-        collision_strength *
-        std::exp(-_five_level_energy_difference[element][i] * Tinv);
+
+  const int_fast32_t offset = LINECOOLINGDATA_NUMFIVELEVELELEMENTS;
+  for (int_fast32_t i = 0; i < LINECOOLINGDATA_NUMTWOLEVELELEMENTS; ++i) {
+    const double collision_strength = get_collision_rate_coefficient(
+        _two_level_collision_strength[i], collision_strength_prefactor, T,
+        Tinv, logT, derivatives ? &derivative : nullptr);
+    const double boltzmann_factor =
+        std::exp(-_two_level_energy_difference[i] * Tinv);
+    collision_rate_coefficient_down[offset + i][0] = collision_strength;
+    collision_rate_coefficient_up[offset + i][0] =
+        collision_strength * boltzmann_factor;
+    if (derivatives) {
+      dcollision_rate_coefficient_down[offset + i][0] = derivative;
+      dcollision_rate_coefficient_up[offset + i][0] =
+          boltzmann_factor *
+          (derivative +
+           collision_strength * _two_level_energy_difference[i] * Tinv);
+    }
   }
+}
+
+/**
+ * @brief Get the collision rate coefficients for all transitions of all
+ * elements at the given temperature.
+ *
+ * The collision rates for a given electron density are obtained by multiplying
+ * the coefficients with the electron density. For the two level elements, only
+ * the first transition is used.
+ *
+ * @param temperature Temperature (in K).
+ * @param collision_rate_coefficient_down Array to store the collision rate
+ * coefficients for deexcitation in (in m^3 s^-1).
+ * @param collision_rate_coefficient_up Array to store the collision rate
+ * coefficients for excitation in (in m^3 s^-1).
+ */
+void LineCoolingData::get_collision_rate_coefficients(
+    double temperature,
+    double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                          [NUMBER_OF_TRANSITIONS],
+    double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                        [NUMBER_OF_TRANSITIONS]) const {
+  compute_collision_rate_coefficients(temperature,
+                                      collision_rate_coefficient_down,
+                                      collision_rate_coefficient_up, nullptr,
+                                      nullptr);
+}
+
+/**
+ * @brief Get the collision rate coefficients for all transitions of all
+ * elements at the given temperature, together with their derivatives with
+ * respect to the natural logarithm of the temperature.
+ *
+ * @param temperature Temperature (in K).
+ * @param collision_rate_coefficient_down Array to store the collision rate
+ * coefficients for deexcitation in (in m^3 s^-1).
+ * @param collision_rate_coefficient_up Array to store the collision rate
+ * coefficients for excitation in (in m^3 s^-1).
+ * @param dcollision_rate_coefficient_down Array to store the derivatives of
+ * the collision rate coefficients for deexcitation in (in m^3 s^-1).
+ * @param dcollision_rate_coefficient_up Array to store the derivatives of the
+ * collision rate coefficients for excitation in (in m^3 s^-1).
+ */
+void LineCoolingData::get_collision_rate_coefficients(
+    double temperature,
+    double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                          [NUMBER_OF_TRANSITIONS],
+    double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                        [NUMBER_OF_TRANSITIONS],
+    double dcollision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                           [NUMBER_OF_TRANSITIONS],
+    double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                         [NUMBER_OF_TRANSITIONS]) const {
+  compute_collision_rate_coefficients(
+      temperature, collision_rate_coefficient_down,
+      collision_rate_coefficient_up, dcollision_rate_coefficient_down,
+      dcollision_rate_coefficient_up);
+}
 
-  level_matrix[1][0] = collision_rate_up[TRANSITION_0_to_1] *
-                       _five_level_inverse_statistical_weight[element][0];
-  level_matrix[1][1] =
-      -(_five_level_transition_probability[element][TRANSITION_0_to_1] +
-        _five_level_inverse_statistical_weight[element][1] *
-            (collision_rate_down[TRANSITION_0_to_1] +
-             collision_rate_up[TRANSITION_1_to_2] +
-             collision_rate_up[TRANSITION_1_to_3] +
-             collision_rate_up[TRANSITION_1_to_4]));
-  level_matrix[1][2] =
-      _five_level_transition_probability[element][TRANSITION_1_to_2] +
-      _five_level_inverse_statistical_weight[element][2] *
-          collision_rate_down[TRANSITION_1_to_2];
-  level_matrix[1][3] =
-      _five_level_transition_probability[element][TRANSITION_1_to_3] +
-      _five_level_inverse_statistical_weight[element][3] *
-          collision_rate_down[TRANSITION_1_to_3];
-  level_matrix[1][4] =
-      _five_level_transition_probability[element][TRANSITION_1_to_4] +
-      _five_level_inverse_statistical_weight[element][4] *
-          collision_rate_down[TRANSITION_1_to_4];
-
-  level_matrix[2][0] = collision_rate_up[TRANSITION_0_to_2] *
-                       _five_level_inverse_statistical_weight[element][0];
-  level_matrix[2][1] = collision_rate_up[TRANSITION_1_to_2] *
-                       _five_level_inverse_statistical_weight[element][1];
-  level_matrix[2][2] =
-      -(_five_level_transition_probability[element][TRANSITION_0_to_2] +
-        _five_level_transition_probability[element][TRANSITION_1_to_2] +
+/**
+ * @brief Set up the coefficient matrix of the level population equations for
+ * all five level elements.
+ *
+ * The first row of the matrix expresses that the level populations sum to
+ * unity, the other rows express the balance between the radiative and
+ * collisional transitions into and out of a level.
+ *
+ * If derivative is true, the given collision rate coefficients are instead
+ * interpreted as the derivatives of the coefficients with respect to some
+ * parameter, and the matrix contains the derivatives of the coefficients of
+ * the level population equations with respect to that parameter: the
+ * transition probabilities and the first row are then zero.
+ *
+ * @param electron_density Electron density (in m^-3).
+ * @param collision_rate_coefficient_down Collision rate coefficients for
+ * deexcitation (in m^3 s^-1).
+ * @param collision_rate_coefficient_up Collision rate coefficients for
+ * excitation (in m^3 s^-1).
+ * @param derivative Set up the derivative of the coefficient matrix?
+ * @param level_matrix Array to store the coefficient matrix in.
+ */
+void LineCoolingData::set_level_matrix(
+    double electron_density,
+    const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+    const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                              [NUMBER_OF_TRANSITIONS],
+    bool derivative,
+    double level_matrix[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS]) const {
+
+  for (int_fast32_t element = 0; element < LINECOOLINGDATA_NUMFIVELEVELELEMENTS;
+       ++element) {
+
+    // the first row of the coefficient matrix expresses the constant number of
+    // particles: the sum of all level populations is unity
+    for (uint_fast8_t i = 0; i < 5; ++i) {
+      level_matrix[0][i][element] = derivative ? 0. : 1.;
+    }
+
+    double transition_probability[NUMBER_OF_TRANSITIONS];
+    for (int_fast32_t i = 0; i < NUMBER_OF_TRANSITIONS; ++i) {
+      transition_probability[i] =
+          derivative ? 0. : _five_level_transition_probability[element][i];
+    }
+
+    // compute the collision rates for the given electron density
+    double collision_rate_down[NUMBER_OF_TRANSITIONS];
+    double collision_rate_up[NUMBER_OF_TRANSITIONS];
+    for (int_fast32_t i = 0; i < NUMBER_OF_TRANSITIONS; ++i) {
+      collision_rate_down[i] =
+          electron_density * collision_rate_coefficient_down[element][i];
+      collision_rate_up[i] =
+          electron_density * collision_rate_coefficient_up[element][i];
+    }
+
+    level_matrix[1][0][element] =
+        collision_rate_up[TRANSITION_0_to_1] *
+        _five_level_inverse_statistical_weight[element][0];
+    level_matrix[1][1][element] =
+        -(transition_probability[TRANSITION_0_to_1] +
+          _five_level_inverse_statistical_weight[element][1] *
+              (collision_rate_down[TRANSITION_0_to_1] +
+               collision_rate_up[TRANSITION_1_to_2] +
+               collision_rate_up[TRANSITION_1_to_3] +
+               collision_rate_up[TRANSITION_1_to_4]));
+    level_matrix[1][2][element] =
+        transition_probability[TRANSITION_1_to_2] +
         _five_level_inverse_statistical_weight[element][2] *
-            (collision_rate_down[TRANSITION_0_to_2] +
-             collision_rate_down[TRANSITION_1_to_2] +
-             collision_rate_up[TRANSITION_2_to_3] +
-             collision_rate_up[TRANSITION_2_to_4]));
-  level_matrix[2][3] =
-      _five_level_transition_probability[element][TRANSITION_2_to_3] +
-      collision_rate_down[TRANSITION_2_to_3] *
-          _five_level_inverse_statistical_weight[element][3];
-  level_matrix[2][4] =
-      _five_level_transition_probability[element][TRANSITION_2_to_4] +
-      collision_rate_down[TRANSITION_2_to_4] *
-          _five_level_inverse_statistical_weight[element][4];
-
-  level_matrix[3][0] = collision_rate_up[TRANSITION_0_to_3] *
-                       _five_level_inverse_statistical_weight[element][0];
-  level_matrix[3][1] = collision_rate_up[TRANSITION_1_to_3] *
-                       _five_level_inverse_statistical_weight[element][1];
-  level_matrix[3][2] = collision_rate_up[TRANSITION_2_to_3] *
-                       _five_level_inverse_statistical_weight[element][2];
-  level_matrix[3][3] =
-      -(_five_level_transition_probability[element][TRANSITION_0_to_3] +
-        _five_level_transition_probability[element][TRANSITION_1_to_3] +
-        _five_level_transition_probability[element][TRANSITION_2_to_3] +
+            collision_rate_down[TRANSITION_1_to_2];
+    level_matrix[1][3][element] =
+        transition_probability[TRANSITION_1_to_3] +
         _five_level_inverse_statistical_weight[element][3] *
-            (collision_rate_down[TRANSITION_0_to_3] +
-             collision_rate_down[TRANSITION_1_to_3] +
-             collision_rate_down[TRANSITION_2_to_3] +
-             collision_rate_up[TRANSITION_3_to_4]));
-  level_matrix[3][4] =
-      _five_level_transition_probability[element][TRANSITION_3_to_4] +
-      collision_rate_down[TRANSITION_3_to_4] *
-          _five_level_inverse_statistical_weight[element][4];
-
-  level_matrix[4][0] = collision_rate_up[TRANSITION_0_to_4] *
-                       _five_level_inverse_statistical_weight[element][0];
-  level_matrix[4][1] = collision_rate_up[TRANSITION_1_to_4] *
-                       _five_level_inverse_statistical_weight[element][1];
-  level_matrix[4][2] = collision_rate_up[TRANSITION_2_to_4] *
-                       _five_level_inverse_statistical_weight[element][2];
-  level_matrix[4][3] = collision_rate_up[TRANSITION_3_to_4] *
-                       _five_level_inverse_statistical_weight[element][3];
-  level_matrix[4][4] =
-      -(_five_level_transition_probability[element][TRANSITION_0_to_4] +
-        _five_level_transition_probability[element][TRANSITION_1_to_4] +
-        _five_level_transition_probability[element][TRANSITION_2_to_4] +
-        _five_level_transition_probability[element][TRANSITION_3_to_4] +
+            collision_rate_down[TRANSITION_1_to_3];
+    level_matrix[1][4][element] =
+        transition_probability[TRANSITION_1_to_4] +
         _five_level_inverse_statistical_weight[element][4] *
-            (collision_rate_down[TRANSITION_0_to_4] +
-             collision_rate_down[TRANSITION_1_to_4] +
-             collision_rate_down[TRANSITION_2_to_4] +
-             collision_rate_down[TRANSITION_3_to_4]));
+            collision_rate_down[TRANSITION_1_to_4];
+
+    level_matrix[2][0][element] =
+        collision_rate_up[TRANSITION_0_to_2] *
+        _five_level_inverse_statistical_weight[element][0];
+    level_matrix[2][1][element] =
+        collision_rate_up[TRANSITION_1_to_2] *
+        _five_level_inverse_statistical_weight[element][1];
+    level_matrix[2][2][element] =
+        -(transition_probability[TRANSITION_0_to_2] +
+          transition_probability[TRANSITION_1_to_2] +
+          _five_level_inverse_statistical_weight[element][2] *
+              (collision_rate_down[TRANSITION_0_to_2] +
+               collision_rate_down[TRANSITION_1_to_2] +
+               collision_rate_up[TRANSITION_2_to_3] +
+               collision_rate_up[TRANSITION_2_to_4]));
+    level_matrix[2][3][element] =
+        transition_probability[TRANSITION_2_to_3] +
+        collision_rate_down[TRANSITION_2_to_3] *
+            _five_level_inverse_statistical_weight[element][3];
+    level_matrix[2][4][element] =
+        transition_probability[TRANSITION_2_to_4] +
+        collision_rate_down[TRANSITION_2_to_4] *
+            _five_level_inverse_statistical_weight[element][4];
+
+    level_matrix[3][0][element] =
+        collision_rate_up[TRANSITION_0_to_3] *
+        _five_level_inverse_statistical_weight[element][0];
+    level_matrix[3][1][element] =
+        collision_rate_up[TRANSITION_1_to_3] *
+        _five_level_inverse_statistical_weight[element][1];
+    level_matrix[3][2][element] =
+        collision_rate_up[TRANSITION_2_to_3] *
+        _five_level_inverse_statistical_weight[element][2];
+    level_matrix[3][3][element] =
+        -(transition_probability[TRANSITION_0_to_3] +
+          transition_probability[TRANSITION_1_to_3] +
+          transition_probability[TRANSITION_2_to_3] +
+          _five_level_inverse_statistical_weight[element][3] *
+              (collision_rate_down[TRANSITION_0_to_3] +
+               collision_rate_down[TRANSITION_1_to_3] +
+               collision_rate_down[TRANSITION_2_to_3] +
+               collision_rate_up[TRANSITION_3_to_4]));
+    level_matrix[3][4][element] =
+        transition_probability[TRANSITION_3_to_4] +
+        collision_rate_down[TRANSITION_3_to_4] *
+            _five_level_inverse_statistical_weight[element][4];
+
+    level_matrix[4][0][element] =
+        collision_rate_up[TRANSITION_0_to_4] *
+        _five_level_inverse_statistical_weight[element][0];
+    level_matrix[4][1][element] =
+        collision_rate_up[TRANSITION_1_to_4] *
+        _five_level_inverse_statistical_weight[element][1];
+    level_matrix[4][2][element] =
+        collision_rate_up[TRANSITION_2_to_4] *
+        _five_level_inverse_statistical_weight[element][2];
+    level_matrix[4][3][element] =
+        collision_rate_up[TRANSITION_3_to_4] *
+        _five_level_inverse_statistical_weight[element][3];
+    level_matrix[4][4][element] =
+        -(transition_probability[TRANSITION_0_to_4] +
+          transition_probability[TRANSITION_1_to_4] +
+          transition_probability[TRANSITION_2_to_4] +
+          transition_probability[TRANSITION_3_to_4] +
+          _five_level_inverse_statistical_weight[element][4] *
+              (collision_rate_down[TRANSITION_0_to_4] +
+               collision_rate_down[TRANSITION_1_to_4] +
+               collision_rate_down[TRANSITION_2_to_4] +
+               collision_rate_down[TRANSITION_3_to_4]));
+  }
+}
+
+/**
+ * @brief Find the level populations for all five level elements.
+ *
+ * The level population equations for all elements are solved together, using
+ * solve_systems_of_linear_equations().
+ *
+ * @param electron_density Electron density (in m^-3).
+ * @param collision_rate_coefficient_down Collision rate coefficients for
+ * deexcitation (in m^3 s^-1).
+ * @param collision_rate_coefficient_up Collision rate coefficients for
+ * excitation (in m^3 s^-1).
+ * @param level_populations Array to store the resulting level populations in.
+ * @param level_matrix Array to store a copy of the coefficient matrix of the
+ * level population equations in (not stored if this is a null pointer).
+ */
+void LineCoolingData::compute_level_populations(
+    double electron_density,
+    const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+    const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                              [NUMBER_OF_TRANSITIONS],
+    double level_populations[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS],
+    double level_matrix[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS]) const {
+
+  double level_matrix_solve[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS];
+  set_level_matrix(electron_density, collision_rate_coefficient_down,
+                   collision_rate_coefficient_up, false, level_matrix_solve);
+  if (level_matrix != nullptr) {
+    // the solver below overwrites the matrix
+    std::copy(&level_matrix_solve[0][0][0],
+              &level_matrix_solve[0][0][0] +
+                  25 * LINECOOLINGDATA_NUMFIVELEVELELEMENTS,
+              &level_matrix[0][0][0]);
+  }
+  for (int_fast32_t element = 0; element < LINECOOLINGDATA_NUMFIVELEVELELEMENTS;
+       ++element) {
+    level_populations[0][element] = 1.;
+    for (uint_fast8_t i = 1; i < 5; ++i) {
+      level_populations[i][element] = 0.;
+    }
+  }
 
   // find level populations
   const int_fast32_t status =
-      solve_system_of_linear_equations(level_matrix, level_populations);
+      solve_systems_of_linear_equations(level_matrix_solve, level_populations);
+  if (status != 0) {
+    // something went wrong
+    cmac_error("Singular matrix in level population computation (element: "
+               "%" PRIiFAST32 ", n_e: %g)!",
+               status - 1, electron_density);
+  }
+}
+
+/**
+ * @brief Find the derivatives of the level populations of all five level
+ * elements with respect to the natural logarithm of the temperature, at a
+ * fixed electron density.
+ *
+ * If the level populations \f$n\f$ satisfy \f$M n = b\f$, with a constant
+ * right hand side \f$b\f$, then their derivatives satisfy
+ * \f[
+ *   M \frac{{\rm{}d}n}{{\rm{}d}\log{T}} =
+ *     -\frac{{\rm{}d}M}{{\rm{}d}\log{T}} n,
+ * \f]
+ * where the derivative of the coefficient matrix \f$M\f$ only depends on the
+ * derivatives of the collision rate coefficients.
+ *
+ * @param electron_density Electron density (in m^-3).
+ * @param level_matrix Coefficient matrix \f$M\f$ of the level population
+ * equations, as stored by compute_level_populations().
+ * @param dcollision_rate_coefficient_down Derivatives of the collision rate
+ * coefficients for deexcitation (in m^3 s^-1).
+ * @param dcollision_rate_coefficient_up Derivatives of the collision rate
+ * coefficients for excitation (in m^3 s^-1).
+ * @param level_populations Level populations.
+ * @param dlevel_populations Array to store the derivatives of the level
+ * populations in.
+ */
+void LineCoolingData::compute_level_population_derivatives(
+    double electron_density,
+    const double level_matrix[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS],
+    const double dcollision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                 [NUMBER_OF_TRANSITIONS],
+    const double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                               [NUMBER_OF_TRANSITIONS],
+    const double level_populations[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS],
+    double dlevel_populations[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS]) const {
+
+  double dlevel_matrix[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS];
+  set_level_matrix(electron_density, dcollision_rate_coefficient_down,
+                   dcollision_rate_coefficient_up, true, dlevel_matrix);
+  for (uint_fast8_t i = 0; i < 5; ++i) {
+    for (int_fast32_t element = 0;
+         element < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++element) {
+      dlevel_populations[i][element] = 0.;
+      for (uint_fast8_t k = 0; k < 5; ++k) {
+        dlevel_populations[i][element] -=
+            dlevel_matrix[i][k][element] * level_populations[k][element];
+      }
+    }
+  }
+
+  // the solver overwrites the matrix, so we reuse dlevel_matrix to store a
+  // copy
+  std::copy(&level_matrix[0][0][0],
+            &level_matrix[0][0][0] + 25 * LINECOOLINGDATA_NUMFIVELEVELELEMENTS,
+            &dlevel_matrix[0][0][0]);
+  const int_fast32_t status =
+      solve_systems_of_linear_equations(dlevel_matrix, dlevel_populations);
   if (status != 0) {
     // something went wrong
-    cmac_error("Singular matrix in level population computation (element: %i, "
-               "T: %g, n_e: %g)!",
-               element, 1. / Tinv,
-               collision_strength_prefactor /
-                   (_collision_strength_prefactor * std::sqrt(Tinv)));
+    cmac_error("Singular matrix in level population derivative computation "
+               "(element: %" PRIiFAST32 ", n_e: %g)!",
+               status - 1, electron_density);
   }
 }
 
 /**
  * @brief Find the level population of the second level for the given two level
- * element at the given temperature.
+ * element.
  *
  * @param element LineCoolingDataTwoLevelElement.
- * @param collision_strength_prefactor Prefactor for the collision strengths
- * (in s^-1).
- * @param T Temperature (in K).
- * @param Tinv Inverse temperature (in K^-1).
- * @param logT Natural logarithm of the temperature in K.
+ * @param electron_density Electron density (in m^-3).
+ * @param collision_rate_coefficient_down Collision rate coefficients for
+ * deexcitation (in m^3 s^-1).
+ * @param collision_rate_coefficient_up Collision rate coefficients for
+ * excitation (in m^3 s^-1).
  * @return Level population of the second level.
  */
 double LineCoolingData::compute_level_population(
-    LineCoolingDataTwoLevelElement element, double collision_strength_prefactor,
-    double T, double Tinv, double logT) const {
+    LineCoolingDataTwoLevelElement element, double electron_density,
+    const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+    const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                              [NUMBER_OF_TRANSITIONS]) const {
 
   // note that we need to remap the element index
   const int_fast32_t i = element - LINECOOLINGDATA_NUMFIVELEVELELEMENTS;
-  const double ksi = _two_level_energy_difference[i];
   const double A = _two_level_transition_probability[i];
-  const double collision_strength =
-      collision_strength_prefactor *
-      std::pow(T, 1. + _two_level_collision_strength[i][0]) *
-      (_two_level_collision_strength[i][1] +
-       _two_level_collision_strength[i][2] * Tinv +
-       _two_level_collision_strength[i][3] * logT +
-       _two_level_collision_strength[i][4] * T *
-           (1. +
-            (_two_level_collision_strength[i][5] - 1.) *
-                std::pow(T, _two_level_collision_strength[i][6])));
+  const double collision_rate_down =
+      electron_density * collision_rate_coefficient_down[element][0];
+  const double collision_rate_up =
+      electron_density * collision_rate_coefficient_up[element][0];
   const double inv_omega_1 = _two_level_inverse_statistical_weight[i][0];
   const double inv_omega_2 = _two_level_inverse_statistical_weight[i][1];
-  const double Texp = std::exp(-ksi * Tinv);
-  return collision_strength * Texp * inv_omega_1 /
-         (A + collision_strength * (inv_omega_2 + Texp * inv_omega_1));
+  return collision_rate_up * inv_omega_1 /
+         (A + collision_rate_down * inv_omega_2 +
+          collision_rate_up * inv_omega_1);
 }
 
 /**
  * @brief Get the radiative energy losses due to line cooling at the given
  * temperature, electron density and coolant abundances.
  *
- * We consider 12 ions; 10 with 5 low lying collisionally excited levels, and 2
+ * This computes the collision rate coefficients at the given temperature and
+ * then calls the version of get_cooling() that uses them.
+ *
+ * @param temperature Temperature (in K).
+ * @param electron_density Electron density (in m^-3).
+ * @param abundances Abdunances of coolants.
+ * @return Radiative cooling per hydrogen atom (in kg m^2s^-3).
+ */
+double LineCoolingData::get_cooling(
+    double temperature, double electron_density,
+    const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const {
+
+  if (electron_density == 0.) {
+    // we cannot return a 0 cooling rate, because that crashes our iterative
+    // temperature finding scheme
+    return 1.e-99;
+  }
+
+  double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                        [NUMBER_OF_TRANSITIONS];
+  double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                      [NUMBER_OF_TRANSITIONS];
+  get_collision_rate_coefficients(temperature, collision_rate_coefficient_down,
+                                  collision_rate_coefficient_up);
+  return get_cooling(electron_density, collision_rate_coefficient_down,
+                     collision_rate_coefficient_up, abundances);
+}
+
+/**
+ * @brief Get the radiative energy losses due to line cooling at the given
+ * temperature, electron density and coolant abundances, together with the
+ * derivative of the losses with respect to the natural logarithm of the
+ * temperature (at fixed electron density and abundances).
+ *
+ * @param temperature Temperature (in K).
+ * @param electron_density Electron density (in m^-3).
+ * @param abundances Abdunances of coolants.
+ * @param dcooling Variable to store the derivative of the radiative cooling
+ * per hydrogen atom with respect to the natural logarithm of the temperature in
+ * (in kg m^2s^-3).
+ * @return Radiative cooling per hydrogen atom (in kg m^2s^-3).
+ */
+double LineCoolingData::get_cooling(
+    double temperature, double electron_density,
+    const double abundances[LINECOOLINGDATA_NUMELEMENTS],
+    double &dcooling) const {
+
+  if (electron_density == 0.) {
+    // we cannot return a 0 cooling rate, because that crashes our iterative
+    // temperature finding scheme
+    dcooling = 0.;
+    return 1.e-99;
+  }
+
+  double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                        [NUMBER_OF_TRANSITIONS];
+  double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                      [NUMBER_OF_TRANSITIONS];
+  double dcollision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                         [NUMBER_OF_TRANSITIONS];
+  double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                       [NUMBER_OF_TRANSITIONS];
+  get_collision_rate_coefficients(
+      temperature, collision_rate_coefficient_down,
+      collision_rate_coefficient_up, dcollision_rate_coefficient_down,
+      dcollision_rate_coefficient_up);
+  return get_cooling(electron_density, collision_rate_coefficient_down,
+                     collision_rate_coefficient_up,
+                     dcollision_rate_coefficient_down,
+                     dcollision_rate_coefficient_up, abundances, dcooling);
+}
+
+/**
+ * @brief Compute the radiative energy losses due to line cooling for the given
+ * collision rate coefficients, electron density and coolant abundances, and
+ * optionally their derivative.
+ *
+ * We consider 13 ions; 10 with 5 low lying collisionally excited levels, and 3
  * with only 2 levels. For the former, we solve equations (3.27) and (3.28) in
  * Osterbrock & Ferland (2006), with the cooling rate given by equation (3.29).
  *
@@ -1759,14 +2216,49 @@ double LineCoolingData::compute_level_population(
  * \f]
  * We substitute this in equation (3.25).
  *
- * @param temperature Temperature (in K).
+ * The collision rate coefficients are the only temperature dependent input, so
+ * that they can be computed directly (get_collision_rate_coefficients()) or
+ * interpolated from a table (LineCoolingTable).
+ *
+ * If the derivatives of the collision rate coefficients with respect to some
+ * parameter (e.g. the natural logarithm of the temperature) are given, we also
+ * compute the derivative of the cooling with respect to that parameter, using
+ * the derivatives of the level populations
+ * (compute_level_population_derivatives()).
+ *
  * @param electron_density Electron density (in m^-3).
+ * @param collision_rate_coefficient_down Collision rate coefficients for
+ * deexcitation (in m^3 s^-1).
+ * @param collision_rate_coefficient_up Collision rate coefficients for
+ * excitation (in m^3 s^-1).
+ * @param dcollision_rate_coefficient_down Derivatives of the collision rate
+ * coefficients for deexcitation (in m^3 s^-1; the derivative of the cooling is
+ * only computed if this is not a null pointer).
+ * @param dcollision_rate_coefficient_up Derivatives of the collision rate
+ * coefficients for excitation (in m^3 s^-1).
  * @param abundances Abdunances of coolants.
+ * @param dcooling Variable to store the derivative of the radiative cooling
+ * per hydrogen atom in (in kg m^2s^-3; only used if the derivatives of the
+ * collision rate coefficients are given).
  * @return Radiative cooling per hydrogen atom (in kg m^2s^-3).
  */
-double LineCoolingData::get_cooling(
-    double temperature, double electron_density,
-    const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const {
+double LineCoolingData::compute_cooling(
+    double electron_density,
+    const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+    const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                              [NUMBER_OF_TRANSITIONS],
+    const double dcollision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                 [NUMBER_OF_TRANSITIONS],
+    const double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                               [NUMBER_OF_TRANSITIONS],
+    const double abundances[LINECOOLINGDATA_NUMELEMENTS],
+    double *dcooling) const {
+
+  const bool derivative = (dcollision_rate_coefficient_down != nullptr);
+  if (derivative) {
+    *dcooling = 0.;
+  }
 
   if (electron_density == 0.) {
     // we cannot return a 0 cooling rate, because that crashes our iterative
@@ -1780,57 +2272,57 @@ double LineCoolingData::get_cooling(
   const double kb =
       PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_BOLTZMANN);
 
-  // _collision_strength_prefactor has units K^0.5 m^3 s^-1;
-  // collision_strength_prefactor has units s^-1
-  const double collision_strength_prefactor =
-      _collision_strength_prefactor * electron_density / std::sqrt(temperature);
-  const double Tinv = 1. / temperature;
-  const double logT = std::log(temperature);
-
   /// five level elements
 
+  double level_populations[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS];
+  double level_matrix[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS];
+  compute_level_populations(electron_density, collision_rate_coefficient_down,
+                            collision_rate_coefficient_up, level_populations,
+                            derivative ? level_matrix : nullptr);
+
+  double dlevel_populations[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS];
+  if (derivative) {
+    compute_level_population_derivatives(
+        electron_density, level_matrix, dcollision_rate_coefficient_down,
+        dcollision_rate_coefficient_up, level_populations, dlevel_populations);
+  }
+
   double cooling = 0.;
   for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++j) {
 
-    const LineCoolingDataFiveLevelElement element =
-        static_cast< LineCoolingDataFiveLevelElement >(j);
-
-    double level_populations[5];
-    compute_level_populations(element, collision_strength_prefactor,
-                              temperature, Tinv, logT, level_populations);
-
-    // compute the cooling for each transition
+    // compute the energy that is radiated per unit time by an ion in each
+    // level
     // this corresponds to equation (3.29) in Osterbrock & Ferland (2006)
-    const double cl2 =
-        level_populations[1] *
-        _five_level_transition_probability[j][TRANSITION_0_to_1] *
-        _five_level_energy_difference[j][TRANSITION_0_to_1];
-    const double cl3 =
-        level_populations[2] *
-        (_five_level_transition_probability[j][TRANSITION_0_to_2] *
-             _five_level_energy_difference[j][TRANSITION_0_to_2] +
-         _five_level_transition_probability[j][TRANSITION_1_to_2] *
-             _five_level_energy_difference[j][TRANSITION_1_to_2]);
-    const double cl4 =
-        level_populations[3] *
-        (_five_level_transition_probability[j][TRANSITION_0_to_3] *
-             _five_level_energy_difference[j][TRANSITION_0_to_3] +
-         _five_level_transition_probability[j][TRANSITION_1_to_3] *
-             _five_level_energy_difference[j][TRANSITION_1_to_3] +
-         _five_level_transition_probability[j][TRANSITION_2_to_3] *
-             _five_level_energy_difference[j][TRANSITION_2_to_3]);
-    const double cl5 =
-        level_populations[4] *
-        (_five_level_transition_probability[j][TRANSITION_0_to_4] *
-             _five_level_energy_difference[j][TRANSITION_0_to_4] +
-         _five_level_transition_probability[j][TRANSITION_1_to_4] *
-             _five_level_energy_difference[j][TRANSITION_1_to_4] +
-         _five_level_transition_probability[j][TRANSITION_2_to_4] *
-             _five_level_energy_difference[j][TRANSITION_2_to_4] +
-         _five_level_transition_probability[j][TRANSITION_3_to_4] *
-             _five_level_energy_difference[j][TRANSITION_3_to_4]);
-
-    cooling += abundances[j] * kb * (cl2 + cl3 + cl4 + cl5);
+    const double w2 = _five_level_transition_probability[j][TRANSITION_0_to_1] *
+                      _five_level_energy_difference[j][TRANSITION_0_to_1];
+    const double w3 = _five_level_transition_probability[j][TRANSITION_0_to_2] *
+                          _five_level_energy_difference[j][TRANSITION_0_to_2] +
+                      _five_level_transition_probability[j][TRANSITION_1_to_2] *
+                          _five_level_energy_difference[j][TRANSITION_1_to_2];
+    const double w4 = _five_level_transition_probability[j][TRANSITION_0_to_3] *
+                          _five_level_energy_difference[j][TRANSITION_0_to_3] +
+                      _five_level_transition_probability[j][TRANSITION_1_to_3] *
+                          _five_level_energy_difference[j][TRANSITION_1_to_3] +
+                      _five_level_transition_probability[j][TRANSITION_2_to_3] *
+                          _five_level_energy_difference[j][TRANSITION_2_to_3];
+    const double w5 = _five_level_transition_probability[j][TRANSITION_0_to_4] *
+                          _five_level_energy_difference[j][TRANSITION_0_to_4] +
+                      _five_level_transition_probability[j][TRANSITION_1_to_4] *
+                          _five_level_energy_difference[j][TRANSITION_1_to_4] +
+                      _five_level_transition_probability[j][TRANSITION_2_to_4] *
+                          _five_level_energy_difference[j][TRANSITION_2_to_4] +
+                      _five_level_transition_probability[j][TRANSITION_3_to_4] *
+                          _five_level_energy_difference[j][TRANSITION_3_to_4];
+
+    cooling += abundances[j] * kb *
+               (level_populations[1][j] * w2 + level_populations[2][j] * w3 +
+                level_populations[3][j] * w4 + level_populations[4][j] * w5);
+    if (derivative) {
+      *dcooling +=
+          abundances[j] * kb *
+          (dlevel_populations[1][j] * w2 + dlevel_populations[2][j] * w3 +
+           dlevel_populations[3][j] * w4 + dlevel_populations[4][j] * w5);
+    }
   }
 
   /// 2 level atoms
@@ -1843,14 +2335,104 @@ double LineCoolingData::get_cooling(
     const LineCoolingDataTwoLevelElement element =
         static_cast< LineCoolingDataTwoLevelElement >(index);
     const double level_population = compute_level_population(
-        element, collision_strength_prefactor, temperature, Tinv, logT);
-    cooling += abundances[index] * kb * _two_level_energy_difference[i] *
-               _two_level_transition_probability[i] * level_population;
+        element, electron_density, collision_rate_coefficient_down,
+        collision_rate_coefficient_up);
+    const double w = _two_level_energy_difference[i] *
+                     _two_level_transition_probability[i];
+    cooling += abundances[index] * kb * w * level_population;
+    if (derivative) {
+      // the level population has the form U / (A + D + U), with U and D the
+      // excitation and deexcitation rates; its derivative is
+      // (dU (A + D) - U dD) / (A + D + U)^2
+      const double A = _two_level_transition_probability[i];
+      const double U = electron_density *
+                       collision_rate_coefficient_up[index][0] *
+                       _two_level_inverse_statistical_weight[i][0];
+      const double D = electron_density *
+                       collision_rate_coefficient_down[index][0] *
+                       _two_level_inverse_statistical_weight[i][1];
+      const double dU = electron_density *
+                        dcollision_rate_coefficient_up[index][0] *
+                        _two_level_inverse_statistical_weight[i][0];
+      const double dD = electron_density *
+                        dcollision_rate_coefficient_down[index][0] *
+                        _two_level_inverse_statistical_weight[i][1];
+      const double denominator = A + D + U;
+      *dcooling += abundances[index] * kb * w * (dU * (A + D) - U * dD) /
+                   (denominator * denominator);
+    }
   }
 
   return cooling;
 }
 
+/**
+ * @brief Get the radiative energy losses due to line cooling for the given
+ * collision rate coefficients, electron density and coolant abundances.
+ *
+ * See compute_cooling().
+ *
+ * @param electron_density Electron density (in m^-3).
+ * @param collision_rate_coefficient_down Collision rate coefficients for
+ * deexcitation (in m^3 s^-1).
+ * @param collision_rate_coefficient_up Collision rate coefficients for
+ * excitation (in m^3 s^-1).
+ * @param abundances Abdunances of coolants.
+ * @return Radiative cooling per hydrogen atom (in kg m^2s^-3).
+ */
+double LineCoolingData::get_cooling(
+    double electron_density,
+    const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+    const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                              [NUMBER_OF_TRANSITIONS],
+    const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const {
+  return compute_cooling(electron_density, collision_rate_coefficient_down,
+                         collision_rate_coefficient_up, nullptr, nullptr,
+                         abundances, nullptr);
+}
+
+/**
+ * @brief Get the radiative energy losses due to line cooling for the given
+ * collision rate coefficients, electron density and coolant abundances,
+ * together with the derivative of the losses with respect to the natural
+ * logarithm of the temperature, given the derivatives of the collision rate
+ * coefficients.
+ *
+ * See compute_cooling().
+ *
+ * @param electron_density Electron density (in m^-3).
+ * @param collision_rate_coefficient_down Collision rate coefficients for
+ * deexcitation (in m^3 s^-1).
+ * @param collision_rate_coefficient_up Collision rate coefficients for
+ * excitation (in m^3 s^-1).
+ * @param dcollision_rate_coefficient_down Derivatives of the collision rate
+ * coefficients for deexcitation (in m^3 s^-1).
+ * @param dcollision_rate_coefficient_up Derivatives of the collision rate
+ * coefficients for excitation (in m^3 s^-1).
+ * @param abundances Abdunances of coolants.
+ * @param dcooling Variable to store the derivative of the radiative cooling
+ * per hydrogen atom in (in kg m^2s^-3).
+ * @return Radiative cooling per hydrogen atom (in kg m^2s^-3).
+ */
+double LineCoolingData::get_cooling(
+    double electron_density,
+    const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+    const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                              [NUMBER_OF_TRANSITIONS],
+    const double dcollision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                 [NUMBER_OF_TRANSITIONS],
+    const double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                               [NUMBER_OF_TRANSITIONS],
+    const double abundances[LINECOOLINGDATA_NUMELEMENTS],
+    double &dcooling) const {
+  return compute_cooling(
+      electron_density, collision_rate_coefficient_down,
+      collision_rate_coefficient_up, dcollision_rate_coefficient_down,
+      dcollision_rate_coefficient_up, abundances, &dcooling);
+}
+
 /**
  * @brief Calculate the strength of all emission lines for which we have data.
  *
@@ -1870,10 +2452,12 @@ std::vector< std::vector< double > > LineCoolingData::get_line_strengths(
   const double kb =
       PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_BOLTZMANN);
 
-  const double collision_strength_prefactor =
-      _collision_strength_prefactor * electron_density / std::sqrt(temperature);
-  const double Tinv = 1. / temperature;
-  const double logT = std::log(temperature);
+  double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                        [NUMBER_OF_TRANSITIONS];
+  double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                      [NUMBER_OF_TRANSITIONS];
+  get_collision_rate_coefficients(temperature, collision_rate_coefficient_down,
+                                  collision_rate_coefficient_up);
 
   // vector to store line strengths in
   std::vector< std::vector< double > > line_strengths(
@@ -1881,57 +2465,54 @@ std::vector< std::vector< double > > LineCoolingData::get_line_strengths(
 
   /// 5 level elements
 
+  double level_populations[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS];
+  compute_level_populations(electron_density, collision_rate_coefficient_down,
+                            collision_rate_coefficient_up, level_populations);
+
   for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++j) {
 
     line_strengths[j].resize(NUMBER_OF_TRANSITIONS);
 
-    const LineCoolingDataFiveLevelElement element =
-        static_cast< LineCoolingDataFiveLevelElement >(j);
-
-    double level_populations[5];
-    compute_level_populations(element, collision_strength_prefactor,
-                              temperature, Tinv, logT, level_populations);
-
     const double prefactor = abundances[j] * kb;
 
     line_strengths[j][TRANSITION_0_to_1] =
-        prefactor * level_populations[1] *
+        prefactor * level_populations[1][j] *
         _five_level_transition_probability[j][TRANSITION_0_to_1] *
         _five_level_energy_difference[j][TRANSITION_0_to_1];
     line_strengths[j][TRANSITION_0_to_2] =
-        prefactor * level_populations[2] *
+        prefactor * level_populations[2][j] *
         _five_level_transition_probability[j][TRANSITION_0_to_2] *
         _five_level_energy_difference[j][TRANSITION_0_to_2];
     line_strengths[j][TRANSITION_1_to_2] =
-        prefactor * level_populations[2] *
+        prefactor * level_populations[2][j] *
         _five_level_transition_probability[j][TRANSITION_1_to_2] *
         _five_level_energy_difference[j][TRANSITION_1_to_2];
     line_strengths[j][TRANSITION_0_to_3] =
-        prefactor * level_populations[3] *
+        prefactor * level_populations[3][j] *
         _five_level_transition_probability[j][TRANSITION_0_to_3] *
         _five_level_energy_difference[j][TRANSITION_0_to_3];
     line_strengths[j][TRANSITION_1_to_3] =
-        prefactor * level_populations[3] *
+        prefactor * level_populations[3][j] *
         _five_level_transition_probability[j][TRANSITION_1_to_3] *
         _five_level_energy_difference[j][TRANSITION_1_to_3];
     line_strengths[j][TRANSITION_2_to_3] =
-        prefactor * level_populations[3] *
+        prefactor * level_populations[3][j] *
         _five_level_transition_probability[j][TRANSITION_2_to_3] *
         _five_level_energy_difference[j][TRANSITION_2_to_3];
     line_strengths[j][TRANSITION_0_to_4] =
-        prefactor * level_populations[4] *
+        prefactor * level_populations[4][j] *
         _five_level_transition_probability[j][TRANSITION_0_to_4] *
         _five_level_energy_difference[j][TRANSITION_0_to_4];
     line_strengths[j][TRANSITION_1_to_4] =
-        prefactor * level_populations[4] *
+        prefactor * level_populations[4][j] *
         _five_level_transition_probability[j][TRANSITION_1_to_4] *
         _five_level_energy_difference[j][TRANSITION_1_to_4];
     line_strengths[j][TRANSITION_2_to_4] =
-        prefactor * level_populations[4] *
+        prefactor * level_populations[4][j] *
         _five_level_transition_probability[j][TRANSITION_2_to_4] *
         _five_level_energy_difference[j][TRANSITION_2_to_4];
     line_strengths[j][TRANSITION_3_to_4] =
-        prefactor * level_populations[4] *
+        prefactor * level_populations[4][j] *
         _five_level_transition_probability[j][TRANSITION_3_to_4] *
         _five_level_energy_difference[j][TRANSITION_3_to_4];
   }
@@ -1950,7 +2531,8 @@ std::vector< std::vector< double > > LineCoolingData::get_line_strengths(
         static_cast< LineCoolingDataTwoLevelElement >(index);
 
     const double level_population = compute_level_population(
-        element, collision_strength_prefactor, temperature, Tinv, logT);
+        element, electron_density, collision_rate_coefficient_down,
+        collision_rate_coefficient_up);
 
     line_strengths[index][0] = abundances[index] * kb * level_population *
                                _two_level_energy_difference[i] *
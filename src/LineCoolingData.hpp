@@ -230,14 +230,70 @@ private:
    *  \left(2\pi{}m_e\right)^\frac{3}{2}\f$ (in K^0.5 m^3 s^-1). */
   double _collision_strength_prefactor;
 
-  void compute_level_populations(LineCoolingDataFiveLevelElement element,
-                                 double collision_strength_prefactor, double T,
-                                 double Tinv, double logT,
-                                 double level_populations[5]) const;
+  static double get_collision_rate_coefficient(const double fit[7],
+                                               double prefactor, double T,
+                                               double Tinv, double logT,
+                                               double *derivative);
 
-  double compute_level_population(LineCoolingDataTwoLevelElement element,
-                                  double collision_strength_prefactor, double T,
-                                  double Tinv, double logT) const;
+  void compute_collision_rate_coefficients(
+      double temperature,
+      double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                            [NUMBER_OF_TRANSITIONS],
+      double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                          [NUMBER_OF_TRANSITIONS],
+      double dcollision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                             [NUMBER_OF_TRANSITIONS],
+      double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                           [NUMBER_OF_TRANSITIONS]) const;
+
+  void set_level_matrix(
+      double electron_density,
+      const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                  [NUMBER_OF_TRANSITIONS],
+      const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+      bool derivative,
+      double level_matrix[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS]) const;
+
+  void compute_level_populations(
+      double electron_density,
+      const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                  [NUMBER_OF_TRANSITIONS],
+      const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+      double level_populations[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS],
+      double level_matrix[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS] =
+          nullptr) const;
+
+  void compute_level_population_derivatives(
+      double electron_density,
+      const double level_matrix[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS],
+      const double dcollision_rate_coefficient_down
+          [LINECOOLINGDATA_NUMELEMENTS][NUMBER_OF_TRANSITIONS],
+      const double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                                 [NUMBER_OF_TRANSITIONS],
+      const double level_populations[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS],
+      double dlevel_populations[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS]) const;
+
+  double compute_level_population(
+      LineCoolingDataTwoLevelElement element, double electron_density,
+      const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                  [NUMBER_OF_TRANSITIONS],
+      const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS]) const;
+
+  double compute_cooling(
+      double electron_density,
+      const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                  [NUMBER_OF_TRANSITIONS],
+      const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+      const double dcollision_rate_coefficient_down
+          [LINECOOLINGDATA_NUMELEMENTS][NUMBER_OF_TRANSITIONS],
+      const double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                                 [NUMBER_OF_TRANSITIONS],
+      const double abundances[LINECOOLINGDATA_NUMELEMENTS],
+      double *dcooling) const;
 
 public:
   LineCoolingData();
@@ -250,10 +306,52 @@ public:
                                 uint_fast8_t level) const;
 
   static int solve_system_of_linear_equations(double A[5][5], double B[5]);
+  static int solve_systems_of_linear_equations(
+      double A[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS],
+      double B[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS]);
+
+  void get_collision_rate_coefficients(
+      double temperature,
+      double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                            [NUMBER_OF_TRANSITIONS],
+      double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                          [NUMBER_OF_TRANSITIONS]) const;
+  void get_collision_rate_coefficients(
+      double temperature,
+      double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                            [NUMBER_OF_TRANSITIONS],
+      double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                          [NUMBER_OF_TRANSITIONS],
+      double dcollision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                             [NUMBER_OF_TRANSITIONS],
+      double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                           [NUMBER_OF_TRANSITIONS]) const;
 
   double
   get_cooling(double temperature, double electron_density,
               const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const;
+  double get_cooling(double temperature, double electron_density,
+                     const double abundances[LINECOOLINGDATA_NUMELEMENTS],
+                     double &dcooling) const;
+  double get_cooling(
+      double electron_density,
+      const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                  [NUMBER_OF_TRANSITIONS],
+      const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+      const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const;
+  double get_cooling(
+      double electron_density,
+      const double collision_rate_coefficient_down[LINECOOLINGDATA_NUMELEMENTS]
+                                                  [NUMBER_OF_TRANSITIONS],
+      const double collision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                                [NUMBER_OF_TRANSITIONS],
+      const double dcollision_rate_coefficient_down
+          [LINECOOLINGDATA_NUMELEMENTS][NUMBER_OF_TRANSITIONS],
+      const double dcollision_rate_coefficient_up[LINECOOLINGDATA_NUMELEMENTS]
+                                                 [NUMBER_OF_TRANSITIONS],
+      const double abundances[LINECOOLINGDATA_NUMELEMENTS],
+      double &dcooling) const;
 
   std::vector< std::vector< double > > get_line_strengths(
       double temperature, double electron_density,
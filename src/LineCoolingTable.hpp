@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file LineCoolingTable.hpp
+ *
+ * @brief Tabulated version of the LineCoolingData cooling rate.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef LINECOOLINGTABLE_HPP
+#define LINECOOLINGTABLE_HPP
+
+#include "Error.hpp"
+#include "LineCoolingData.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Tabulated version of the LineCoolingData cooling rate.
+ *
+ * The only temperature dependent input for the line cooling are the collision
+ * rate coefficients, which involve a number of std::pow and std::exp calls
+ * for every transition. We tabulate these coefficients on a grid that is
+ * uniform in the logarithm of the temperature, and interpolate linearly in
+ * between grid points. The level populations and the cooling itself are
+ * still computed by LineCoolingData.
+ *
+ * Temperatures outside the table range are handled by LineCoolingData. The
+ * default range covers the temperatures that are reached during the
+ * temperature iteration, and for which the collision strength fits are valid
+ * (some of them become negative below a few 100 K). With the default 200
+ * points per decade, the maximum relative error on the cooling rate is of the
+ * order of 5e-5.
+ */
+class LineCoolingTable {
+private:
+  /*! @brief Number of values stored for every temperature in the table. */
+  static const uint_fast32_t TABLE_ROW_SIZE =
+      2 * LINECOOLINGDATA_NUMELEMENTS * NUMBER_OF_TRANSITIONS;
+
+  /*! @brief LineCoolingData that is tabulated. */
+  const LineCoolingData &_line_cooling_data;
+
+  /*! @brief Natural logarithm of the lowest temperature in the table (in K). */
+  const double _minimum_log_temperature;
+
+  /*! @brief Natural logarithm of the highest temperature in the table (in
+   *  K). */
+  const double _maximum_log_temperature;
+
+  /*! @brief Inverse of the spacing between subsequent temperatures in the
+   *  table, in natural logarithmic space. */
+  const double _inverse_log_temperature_step;
+
+  /*! @brief Collision rate coefficients for deexcitation and excitation for
+   *  all temperatures in the table (in m^3 s^-1). */
+  std::vector< double > _collision_rate_coefficients;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param line_cooling_data LineCoolingData to tabulate.
+   * @param minimum_temperature Lowest temperature in the table (in K).
+   * @param maximum_temperature Highest temperature in the table (in K).
+   * @param number_of_temperatures Number of temperatures in the table.
+   */
+  inline LineCoolingTable(const LineCoolingData &line_cooling_data,
+                          const double minimum_temperature = 1000.,
+                          const double maximum_temperature = 1.e5,
+                          const uint_fast32_t number_of_temperatures = 401)
+      : _line_cooling_data(line_cooling_data),
+        _minimum_log_temperature(std::log(minimum_temperature)),
+        _maximum_log_temperature(std::log(maximum_temperature)),
+        _inverse_log_temperature_step(
+            (number_of_temperatures - 1.) /
+            (_maximum_log_temperature - _minimum_log_temperature)),
+        _collision_rate_coefficients(number_of_temperatures * TABLE_ROW_SIZE,
+                                     0.) {
+
+    cmac_assert(number_of_temperatures > 1);
+    cmac_assert(maximum_temperature > minimum_temperature);
+
+    for (uint_fast32_t i = 0; i < number_of_temperatures; ++i) {
+      const double temperature =
+          std::exp(_minimum_log_temperature +
+                   i / _inverse_log_temperature_step);
+      double coefficients[2][LINECOOLINGDATA_NUMELEMENTS]
+                         [NUMBER_OF_TRANSITIONS] = {{{0.}}};
+      _line_cooling_data.get_collision_rate_coefficients(
+          temperature, coefficients[0], coefficients[1]);
+      const double *row = &coefficients[0][0][0];
+      for (uint_fast32_t j = 0; j < TABLE_ROW_SIZE; ++j) {
+        _collision_rate_coefficients[i * TABLE_ROW_SIZE + j] = row[j];
+      }
+    }
+  }
+
+  /**
+   * @brief Get the radiative energy losses due to line cooling at the given
+   * temperature, electron density and coolant abundances.
+   *
+   * @param temperature Temperature (in K).
+   * @param electron_density Electron density (in m^-3).
+   * @param abundances Abdunances of coolants.
+   * @return Radiative cooling per hydrogen atom (in kg m^2s^-3).
+   */
+  inline double
+  get_cooling(const double temperature, const double electron_density,
+              const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const {
+
+    const double log_temperature = std::log(temperature);
+    if (log_temperature < _minimum_log_temperature ||
+        log_temperature > _maximum_log_temperature) {
+      return _line_cooling_data.get_cooling(temperature, electron_density,
+                                            abundances);
+    }
+
+    const uint_fast32_t number_of_temperatures =
+        _collision_rate_coefficients.size() / TABLE_ROW_SIZE;
+    const double x = (log_temperature - _minimum_log_temperature) *
+                     _inverse_log_temperature_step;
+    const uint_fast32_t index =
+        std::min(static_cast< uint_fast32_t >(x), number_of_temperatures - 2);
+    const double fraction = x - index;
+
+    double coefficients[2][LINECOOLINGDATA_NUMELEMENTS][NUMBER_OF_TRANSITIONS];
+    double *row = &coefficients[0][0][0];
+    const double *low = &_collision_rate_coefficients[index * TABLE_ROW_SIZE];
+    const double *high = low + TABLE_ROW_SIZE;
+    for (uint_fast32_t j = 0; j < TABLE_ROW_SIZE; ++j) {
+      row[j] = low[j] + fraction * (high[j] - low[j]);
+    }
+
+    return _line_cooling_data.get_cooling(electron_density, coefficients[0],
+                                          coefficients[1], abundances);
+  }
+
+  /**
+   * @brief Get the radiative energy losses due to line cooling at the given
+   * temperature, electron density and coolant abundances, together with the
+   * derivative of the losses with respect to the natural logarithm of the
+   * temperature (at fixed electron density and abundances).
+   *
+   * Within the table range, the derivatives of the collision rate coefficients
+   * are the slopes of the linear interpolation, so that the derivative is
+   * consistent with the tabulated cooling.
+   *
+   * @param temperature Temperature (in K).
+   * @param electron_density Electron density (in m^-3).
+   * @param abundances Abdunances of coolants.
+   * @param dcooling Variable to store the derivative of the radiative cooling
+   * per hydrogen atom in (in kg m^2s^-3).
+   * @return Radiative cooling per hydrogen atom (in kg m^2s^-3).
+   */
+  inline double
+  get_cooling(const double temperature, const double electron_density,
+              const double abundances[LINECOOLINGDATA_NUMELEMENTS],
+              double &dcooling) const {
+
+    const double log_temperature = std::log(temperature);
+    if (log_temperature < _minimum_log_temperature ||
+        log_temperature > _maximum_log_temperature) {
+      return _line_cooling_data.get_cooling(temperature, electron_density,
+                                            abundances, dcooling);
+    }
+
+    if (electron_density == 0.) {
+      // see LineCoolingData::get_cooling()
+      dcooling = 0.;
+      return 1.e-99;
+    }
+
+    const uint_fast32_t number_of_temperatures =
+        _collision_rate_coefficients.size() / TABLE_ROW_SIZE;
+    const double x = (log_temperature - _minimum_log_temperature) *
+                     _inverse_log_temperature_step;
+    const uint_fast32_t index =
+        std::min(static_cast< uint_fast32_t >(x), number_of_temperatures - 2);
+    const double fraction = x - index;
+
+    double coefficients[2][LINECOOLINGDATA_NUMELEMENTS][NUMBER_OF_TRANSITIONS];
+    double dcoefficients[2][LINECOOLINGDATA_NUMELEMENTS]
+                        [NUMBER_OF_TRANSITIONS];
+    double *row = &coefficients[0][0][0];
+    double *drow = &dcoefficients[0][0][0];
+    const double *low = &_collision_rate_coefficients[index * TABLE_ROW_SIZE];
+    const double *high = low + TABLE_ROW_SIZE;
+    for (uint_fast32_t j = 0; j < TABLE_ROW_SIZE; ++j) {
+      row[j] = low[j] + fraction * (high[j] - low[j]);
+      drow[j] = (high[j] - low[j]) * _inverse_log_temperature_step;
+    }
+
+    return _line_cooling_data.get_cooling(
+        electron_density, coefficients[0], coefficients[1], dcoefficients[0],
+        dcoefficients[1], abundances, dcooling);
+  }
+};
+
+#endif // LINECOOLINGTABLE_HPP
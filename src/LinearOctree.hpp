@@ -0,0 +1,1007 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file LinearOctree.hpp
+ *
+ * @brief Flat octree based on Hilbert keys, used to speed up SPH neighbour
+ * searches.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef LINEAROCTREE_HPP
+#define LINEAROCTREE_HPP
+
+#include "Box.hpp"
+#include "Configuration.hpp"
+#include "CoordinateVector.hpp"
+#include "Error.hpp"
+#include "HilbertKeyGenerator.hpp"
+#include "WorkDistributor.hpp"
+#include "WorkStealingScheduler.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <string>
+#include <vector>
+
+/*! @brief Maximum number of positions in a leaf of the tree. */
+#define LINEAROCTREE_LEAF_SIZE 8
+
+/*! @brief Maximum depth of the tree (set by the number of bits per coordinate
+ *  in a Hilbert key). */
+#define LINEAROCTREE_MAXIMUM_LEVEL 21
+
+/*! @brief Level of the tree at which sub trees are constructed in parallel.
+ *  A value of 2 creates up to 64 independent tasks. */
+#define LINEAROCTREE_TASK_LEVEL 2
+
+/**
+ * @brief Single node of a LinearOctree.
+ */
+class LinearOctreeNode {
+public:
+  /*! @brief Index of the first position in the node (in the sorted index
+   *  list). */
+  uint_fast32_t _first;
+
+  /*! @brief Index of the first position that is no longer in the node (in the
+   *  sorted index list). */
+  uint_fast32_t _last;
+
+  /*! @brief Index of the next node to visit if the sub tree of this node is
+   *  skipped. For a node that is not a leaf, the first child is always the
+   *  next node in the node list. */
+  uint_fast32_t _next;
+
+  /*! @brief Is this node a leaf? */
+  bool _is_leaf;
+};
+
+/**
+ * @brief Flat octree based on Hilbert keys, used to speed up SPH neighbour
+ * searches.
+ *
+ * The tree is constructed by sorting the positions on their Hilbert key (using
+ * a parallel radix sort). Positions that share the first 3l bits of their key
+ * are in the same node on level l of the tree, so that every node corresponds
+ * to a contiguous range in the sorted list. The nodes are stored in a single
+ * contiguous array in depth first order: the first child of a node is the
+ * next element in the array, and every node stores the index of the node that
+ * follows its sub tree. The tree can hence be traversed without recursion and
+ * without pointer chasing. Leaves can contain up to LINEAROCTREE_LEAF_SIZE
+ * positions.
+ *
+ * The boxes stored for the nodes are the tight bounding boxes of the positions
+ * they contain, so that the tree remains valid if the positions move (after a
+ * call to update_boxes()), although it might become less efficient.
+ *
+ * The neighbour search functions come in two flavours: versions that call a
+ * given callback function for every neighbour (and do not allocate any
+ * memory), and versions that store the neighbours in a (reusable)
+ * std::vector.
+ */
+class LinearOctree {
+private:
+  /*! @brief Reference to the underlying positions. */
+  std::vector< CoordinateVector<> > &_positions;
+
+  /*! @brief Box containing the positions. Only used for periodic distance
+   *  calculations. */
+  const Box<> _box;
+
+  /*! @brief Periodicity flag. */
+  const bool _is_periodic;
+
+  /*! @brief Indices of the positions, sorted on Hilbert key. */
+  std::vector< uint_fast32_t > _indices;
+
+  /*! @brief Nodes of the tree, in depth first order. */
+  std::vector< LinearOctreeNode > _nodes;
+
+  /*! @brief Bounding boxes of the nodes. */
+  std::vector< Box<> > _node_boxes;
+
+  /*! @brief Auxiliary variables of the nodes. */
+  std::vector< double > _node_variables;
+
+  /*! @brief Auxiliary variables of the positions, in sorted order. */
+  std::vector< double > _sorted_variables;
+
+  /**
+   * @brief Job that executes a function for a range of indices.
+   */
+  template < typename _function_ > class LinearOctreeJob {
+  private:
+    /*! @brief Function or functor that should be executed for every index. It
+     *  should take a size_t as single parameter. */
+    _function_ &_function;
+
+    /*! @brief First index in the range. */
+    const size_t _begin;
+
+    /*! @brief Index beyond the last index in the range. */
+    const size_t _end;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param function Function or functor that should be executed for every
+     * index.
+     * @param begin First index in the range.
+     * @param end Index beyond the last index in the range.
+     */
+    inline LinearOctreeJob(_function_ &function, const size_t begin,
+                           const size_t end)
+        : _function(function), _begin(begin), _end(end) {}
+
+    /**
+     * @brief Should the Job be deleted by the Worker when it is finished?
+     *
+     * @return True.
+     */
+    inline bool do_cleanup() const { return true; }
+
+    /**
+     * @brief Call the function for every index in the range.
+     */
+    inline void execute() {
+      for (size_t i = _begin; i < _end; ++i) {
+        _function(i);
+      }
+    }
+
+    /**
+     * @brief Get a name tag for this job.
+     *
+     * @return "linearoctree_construction".
+     */
+    inline std::string get_tag() const { return "linearoctree_construction"; }
+  };
+
+  /**
+   * @brief JobMarket that spawns LinearOctreeJobs that together cover a range
+   * of indices.
+   */
+  template < typename _function_ > class LinearOctreeJobMarket {
+  private:
+    /*! @brief Function or functor that should be executed for every index. */
+    _function_ &_function;
+
+    /*! @brief Number of indices. */
+    const size_t _size;
+
+    /*! @brief Scheduler that distributes the indices over the threads. */
+    WorkStealingScheduler _scheduler;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param function Function or functor that should be executed for every
+     * index.
+     * @param size Number of indices.
+     * @param jobsize Number of indices in the first job of every thread.
+     */
+    inline LinearOctreeJobMarket(_function_ &function, const size_t size,
+                                 const size_t jobsize)
+        : _function(function), _size(size), _scheduler(1.e-3, jobsize) {}
+
+    /**
+     * @brief Set the number of parallel threads that will be used to execute
+     * the jobs.
+     *
+     * @param worksize Number of parallel threads that will be used.
+     */
+    inline void set_worksize(int_fast32_t worksize) {
+      _scheduler.reset(0, _size, worksize);
+    }
+
+    /**
+     * @brief Get a LinearOctreeJob.
+     *
+     * @param thread_id Id of the thread that calls this function.
+     * @return Pointer to a unique and thread safe LinearOctreeJob instance (or
+     * a nullptr if all indices have been handed out).
+     */
+    inline LinearOctreeJob< _function_ > *get_job(int_fast32_t thread_id) {
+      uint_fast64_t begin, end;
+      if (!_scheduler.get_chunk(thread_id, begin, end)) {
+        return nullptr;
+      }
+      return new LinearOctreeJob< _function_ >(_function, begin, end);
+    }
+  };
+
+  /**
+   * @brief Functor that computes the Hilbert key of a position.
+   */
+  class LinearOctreeKeyComputation {
+  private:
+    /*! @brief Key generator. */
+    const HilbertKeyGenerator &_key_generator;
+
+    /*! @brief Positions. */
+    const std::vector< CoordinateVector<> > &_positions;
+
+    /*! @brief Keys. */
+    std::vector< uint64_t > &_keys;
+
+    /*! @brief Indices of the positions. */
+    std::vector< uint_fast32_t > &_indices;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param key_generator Key generator.
+     * @param positions Positions.
+     * @param keys Keys.
+     * @param indices Indices of the positions.
+     */
+    inline LinearOctreeKeyComputation(
+        const HilbertKeyGenerator &key_generator,
+        const std::vector< CoordinateVector<> > &positions,
+        std::vector< uint64_t > &keys, std::vector< uint_fast32_t > &indices)
+        : _key_generator(key_generator), _positions(positions), _keys(keys),
+          _indices(indices) {}
+
+    /**
+     * @brief Compute the key for the position with the given index.
+     *
+     * @param i Index of a position.
+     */
+    inline void operator()(const size_t i) {
+      _keys[i] = _key_generator.get_key(_positions[i]);
+      _indices[i] = i;
+    }
+  };
+
+  /**
+   * @brief Functor that does one radix sort pass for a block of keys.
+   *
+   * The keys are split in a fixed number of contiguous blocks. In counting
+   * mode, the functor computes the digit histogram of a block. In scatter mode,
+   * it moves the keys and values of the block to the positions given by the
+   * offsets that were computed from all histograms.
+   */
+  class LinearOctreeRadixSortBlock {
+  private:
+    /*! @brief Keys to sort. */
+    const std::vector< uint64_t > &_keys;
+
+    /*! @brief Values that are sorted together with the keys. */
+    const std::vector< uint_fast32_t > &_values;
+
+    /*! @brief Sorted keys. */
+    std::vector< uint64_t > &_keys_buffer;
+
+    /*! @brief Sorted values. */
+    std::vector< uint_fast32_t > &_values_buffer;
+
+    /*! @brief Counts (counting mode) or offsets (scatter mode) for every
+     *  digit value (major index) and every block (minor index). */
+    std::vector< size_t > &_counts;
+
+    /*! @brief Number of blocks. */
+    const size_t _number_of_blocks;
+
+    /*! @brief Shift of the digit. */
+    uint_fast8_t _shift;
+
+    /*! @brief Scatter the keys (true) or count them (false)? */
+    bool _scatter;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param keys Keys to sort.
+     * @param values Values that are sorted together with the keys.
+     * @param keys_buffer Sorted keys.
+     * @param values_buffer Sorted values.
+     * @param counts Counts or offsets for every digit value and every block.
+     * @param number_of_blocks Number of blocks.
+     */
+    inline LinearOctreeRadixSortBlock(
+        const std::vector< uint64_t > &keys,
+        const std::vector< uint_fast32_t > &values,
+        std::vector< uint64_t > &keys_buffer,
+        std::vector< uint_fast32_t > &values_buffer,
+        std::vector< size_t > &counts, const size_t number_of_blocks)
+        : _keys(keys), _values(values), _keys_buffer(keys_buffer),
+          _values_buffer(values_buffer), _counts(counts),
+          _number_of_blocks(number_of_blocks), _shift(0), _scatter(false) {}
+
+    /**
+     * @brief Set the pass and the mode for the next parallel run.
+     *
+     * @param shift Shift of the digit.
+     * @param scatter Scatter the keys (true) or count them (false)?
+     */
+    inline void set_mode(const uint_fast8_t shift, const bool scatter) {
+      _shift = shift;
+      _scatter = scatter;
+    }
+
+    /**
+     * @brief Count or scatter the keys in the block with the given index.
+     *
+     * @param block Index of a block.
+     */
+    inline void operator()(const size_t block) {
+      const size_t size = _keys.size();
+      const size_t first = (size * block) / _number_of_blocks;
+      const size_t last = (size * (block + 1)) / _number_of_blocks;
+
+      size_t local_counts[256] = {0};
+      if (_scatter) {
+        for (uint_fast32_t digit = 0; digit < 256; ++digit) {
+          local_counts[digit] = _counts[digit * _number_of_blocks + block];
+        }
+        for (size_t i = first; i < last; ++i) {
+          const size_t target = local_counts[(_keys[i] >> _shift) & 0xff]++;
+          _keys_buffer[target] = _keys[i];
+          _values_buffer[target] = _values[i];
+        }
+      } else {
+        for (size_t i = first; i < last; ++i) {
+          ++local_counts[(_keys[i] >> _shift) & 0xff];
+        }
+        for (uint_fast32_t digit = 0; digit < 256; ++digit) {
+          _counts[digit * _number_of_blocks + block] = local_counts[digit];
+        }
+      }
+    }
+  };
+
+  /**
+   * @brief Functor that constructs the sub tree of a task.
+   */
+  class LinearOctreeSubtreeConstruction {
+  private:
+    /*! @brief Sorted Hilbert keys. */
+    const std::vector< uint64_t > &_keys;
+
+    /*! @brief Ranges of sorted keys (first and last index) and levels of the
+     *  tasks. */
+    const std::vector<
+        std::pair< std::pair< uint_fast32_t, uint_fast32_t >, uint_fast8_t > >
+        &_tasks;
+
+    /*! @brief Sub trees constructed by the tasks. */
+    std::vector< std::vector< LinearOctreeNode > > &_task_nodes;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param keys Sorted Hilbert keys.
+     * @param tasks Ranges of sorted keys and levels of the tasks.
+     * @param task_nodes Sub trees constructed by the tasks.
+     */
+    inline LinearOctreeSubtreeConstruction(
+        const std::vector< uint64_t > &keys,
+        const std::vector< std::pair< std::pair< uint_fast32_t, uint_fast32_t >,
+                                      uint_fast8_t > > &tasks,
+        std::vector< std::vector< LinearOctreeNode > > &task_nodes)
+        : _keys(keys), _tasks(tasks), _task_nodes(task_nodes) {}
+
+    /**
+     * @brief Construct the sub tree of the task with the given index.
+     *
+     * @param i Index of a task.
+     */
+    inline void operator()(const size_t i) {
+      build_subtree(_keys, _tasks[i].first.first, _tasks[i].first.second,
+                    _tasks[i].second, _task_nodes[i]);
+    }
+  };
+
+  /**
+   * @brief Sort the given keys, and apply the same permutation to the given
+   * values.
+   *
+   * We use a least significant digit radix sort with 8-bit digits. The keys
+   * are split in one block per thread. Every pass first computes a histogram
+   * for every block; the combined histograms determine where every block puts
+   * its keys, so that the sort is stable and both steps of a pass can be done
+   * in parallel. Passes for which all keys have the same digit are skipped.
+   *
+   * @param keys Keys to sort.
+   * @param values Values that are sorted together with the keys.
+   * @param worksize Number of parallel threads to use. If a negative number is
+   * given, all available threads will be used.
+   */
+  inline static void radix_sort(std::vector< uint64_t > &keys,
+                                std::vector< uint_fast32_t > &values,
+                                int_fast32_t worksize = -1) {
+
+    const size_t size = keys.size();
+    std::vector< uint64_t > keys_buffer(size);
+    std::vector< uint_fast32_t > values_buffer(size);
+
+    WorkDistributor< LinearOctreeJobMarket< LinearOctreeRadixSortBlock >,
+                     LinearOctreeJob< LinearOctreeRadixSortBlock > >
+        workers(worksize);
+    const size_t number_of_blocks = workers.get_worksize();
+    // counts for every digit value (major index) and every block (minor
+    // index)
+    std::vector< size_t > counts(256 * number_of_blocks);
+    LinearOctreeRadixSortBlock sort_block(keys, values, keys_buffer,
+                                          values_buffer, counts,
+                                          number_of_blocks);
+    LinearOctreeJobMarket< LinearOctreeRadixSortBlock > jobs(
+        sort_block, number_of_blocks, 1);
+
+    for (uint_fast8_t shift = 0; shift < 64; shift += 8) {
+      sort_block.set_mode(shift, false);
+      workers.do_in_parallel(jobs);
+
+      // convert the counts into offsets
+      bool skip = false;
+      size_t offset = 0;
+      for (uint_fast32_t digit = 0; digit < 256; ++digit) {
+        size_t digit_count = 0;
+        for (size_t iblock = 0; iblock < number_of_blocks; ++iblock) {
+          const size_t count = counts[digit * number_of_blocks + iblock];
+          counts[digit * number_of_blocks + iblock] = offset;
+          offset += count;
+          digit_count += count;
+        }
+        if (digit_count == size) {
+          skip = true;
+        }
+      }
+
+      if (!skip) {
+        sort_block.set_mode(shift, true);
+        workers.do_in_parallel(jobs);
+        keys.swap(keys_buffer);
+        values.swap(values_buffer);
+      }
+    }
+  }
+
+  /**
+   * @brief Get the level at which the given range of sorted keys splits into
+   * more than one node.
+   *
+   * @param keys Sorted Hilbert keys.
+   * @param first Index of the first key in the range.
+   * @param last Index of the first key that is no longer in the range.
+   * @param level Level of the node that contains the range.
+   * @return Level at which the range splits, or LINEAROCTREE_MAXIMUM_LEVEL if
+   * the node should be a leaf.
+   */
+  inline static uint_fast8_t
+  get_split_level(const std::vector< uint64_t > &keys,
+                  const uint_fast32_t first, const uint_fast32_t last,
+                  uint_fast8_t level) {
+    if (last - first <= LINEAROCTREE_LEAF_SIZE) {
+      return LINEAROCTREE_MAXIMUM_LEVEL;
+    }
+    // since the keys are sorted, the range splits on a level if the first and
+    // last key differ on that level
+    while (level < LINEAROCTREE_MAXIMUM_LEVEL &&
+           (keys[first] >> get_shift(level)) ==
+               (keys[last - 1] >> get_shift(level))) {
+      ++level;
+    }
+    return level;
+  }
+
+  /**
+   * @brief Get the shift that needs to be applied to a key to get the key
+   * prefix of a child of a node on the given level.
+   *
+   * @param level Level of the parent node.
+   * @return Corresponding shift.
+   */
+  inline static uint_fast8_t get_shift(const uint_fast8_t level) {
+    return 3 * (LINEAROCTREE_MAXIMUM_LEVEL - level - 1);
+  }
+
+  /**
+   * @brief Get the index of the first key after the given first key that
+   * belongs to another child.
+   *
+   * @param keys Sorted Hilbert keys.
+   * @param first Index of the first key of the child.
+   * @param last Index of the first key that is no longer in the parent.
+   * @param level Level of the parent.
+   * @return Index of the first key that is no longer in the child.
+   */
+  inline static uint_fast32_t get_child_end(const std::vector< uint64_t > &keys,
+                                            const uint_fast32_t first,
+                                            const uint_fast32_t last,
+                                            const uint_fast8_t level) {
+    const uint_fast8_t shift = get_shift(level);
+    const uint64_t prefix = keys[first] >> shift;
+    // all keys with the same prefix have a value in [prefix << shift,
+    // (prefix + 1) << shift[
+    const uint64_t upper = (prefix + 1) << shift;
+    return std::lower_bound(keys.begin() + first, keys.begin() + last, upper) -
+           keys.begin();
+  }
+
+  /**
+   * @brief Construct the sub tree for the given range of sorted keys.
+   *
+   * @param keys Sorted Hilbert keys.
+   * @param first Index of the first key in the range.
+   * @param last Index of the first key that is no longer in the range.
+   * @param level Level of the node that contains the range.
+   * @param nodes Node list to add the nodes to.
+   */
+  inline static void build_subtree(const std::vector< uint64_t > &keys,
+                                   const uint_fast32_t first,
+                                   const uint_fast32_t last,
+                                   const uint_fast8_t level,
+                                   std::vector< LinearOctreeNode > &nodes) {
+
+    const size_t index = nodes.size();
+    nodes.push_back(LinearOctreeNode());
+    nodes[index]._first = first;
+    nodes[index]._last = last;
+
+    const uint_fast8_t split_level = get_split_level(keys, first, last, level);
+    if (split_level == LINEAROCTREE_MAXIMUM_LEVEL) {
+      nodes[index]._is_leaf = true;
+    } else {
+      nodes[index]._is_leaf = false;
+      uint_fast32_t child_first = first;
+      while (child_first < last) {
+        const uint_fast32_t child_last =
+            get_child_end(keys, child_first, last, split_level);
+        build_subtree(keys, child_first, child_last, split_level + 1, nodes);
+        child_first = child_last;
+      }
+    }
+    nodes[index]._next = nodes.size();
+  }
+
+  /**
+   * @brief Collect the ranges of sorted keys for which the sub tree can be
+   * constructed independently.
+   *
+   * @param keys Sorted Hilbert keys.
+   * @param first Index of the first key in the range.
+   * @param last Index of the first key that is no longer in the range.
+   * @param level Level of the node that contains the range.
+   * @param tasks List to add the ranges (first and last index and level) to.
+   */
+  inline static void collect_tasks(
+      const std::vector< uint64_t > &keys, const uint_fast32_t first,
+      const uint_fast32_t last, const uint_fast8_t level,
+      std::vector< std::pair< std::pair< uint_fast32_t, uint_fast32_t >,
+                              uint_fast8_t > > &tasks) {
+
+    const uint_fast8_t split_level = get_split_level(keys, first, last, level);
+    if (level >= LINEAROCTREE_TASK_LEVEL ||
+        split_level == LINEAROCTREE_MAXIMUM_LEVEL) {
+      tasks.push_back(std::make_pair(std::make_pair(first, last), level));
+    } else {
+      uint_fast32_t child_first = first;
+      while (child_first < last) {
+        const uint_fast32_t child_last =
+            get_child_end(keys, child_first, last, split_level);
+        collect_tasks(keys, child_first, child_last, split_level + 1, tasks);
+        child_first = child_last;
+      }
+    }
+  }
+
+  /**
+   * @brief Assemble the top of the tree and add the sub trees that were
+   * constructed by the tasks.
+   *
+   * The traversal order is the same as in collect_tasks(), so that the tasks
+   * are encountered in the order in which they were collected.
+   *
+   * @param keys Sorted Hilbert keys.
+   * @param first Index of the first key in the range.
+   * @param last Index of the first key that is no longer in the range.
+   * @param level Level of the node that contains the range.
+   * @param task_nodes Sub trees constructed by the tasks.
+   * @param next_task Index of the next task to add.
+   */
+  inline void
+  assemble(const std::vector< uint64_t > &keys, const uint_fast32_t first,
+           const uint_fast32_t last, const uint_fast8_t level,
+           const std::vector< std::vector< LinearOctreeNode > > &task_nodes,
+           size_t &next_task) {
+
+    const uint_fast8_t split_level = get_split_level(keys, first, last, level);
+    if (level >= LINEAROCTREE_TASK_LEVEL ||
+        split_level == LINEAROCTREE_MAXIMUM_LEVEL) {
+      const std::vector< LinearOctreeNode > &subtree = task_nodes[next_task];
+      ++next_task;
+      const uint_fast32_t offset = _nodes.size();
+      for (size_t i = 0; i < subtree.size(); ++i) {
+        _nodes.push_back(subtree[i]);
+        _nodes.back()._next += offset;
+      }
+    } else {
+      const size_t index = _nodes.size();
+      _nodes.push_back(LinearOctreeNode());
+      _nodes[index]._first = first;
+      _nodes[index]._last = last;
+      _nodes[index]._is_leaf = false;
+      uint_fast32_t child_first = first;
+      while (child_first < last) {
+        const uint_fast32_t child_last =
+            get_child_end(keys, child_first, last, split_level);
+        assemble(keys, child_first, child_last, split_level + 1, task_nodes,
+                 next_task);
+        child_first = child_last;
+      }
+      _nodes[index]._next = _nodes.size();
+    }
+  }
+
+  /**
+   * @brief Get the distance between the given position and the position with
+   * the given index.
+   *
+   * @param index Index of a position.
+   * @param centre Position.
+   * @return Distance between both positions, taking into account periodic
+   * boundaries if necessary.
+   */
+  inline double get_distance(const uint_fast32_t index,
+                             const CoordinateVector<> &centre) const {
+    if (_is_periodic) {
+      return _box.periodic_distance(_positions[index], centre).norm();
+    } else {
+      return (_positions[index] - centre).norm();
+    }
+  }
+
+  /**
+   * @brief Get the distance between the given position and the box of the
+   * node with the given index.
+   *
+   * @param index Index of a node.
+   * @param centre Position.
+   * @return Distance between the node box and the position, taking into
+   * account periodic boundaries if necessary.
+   */
+  inline double get_node_distance(const uint_fast32_t index,
+                                  const CoordinateVector<> &centre) const {
+    if (_is_periodic) {
+      return _box.periodic_distance(_node_boxes[index], centre);
+    } else {
+      return _node_boxes[index].get_distance(centre);
+    }
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param positions Reference to the underlying positions.
+   * @param box Box containing the positions.
+   * @param periodic Periodicity flag.
+   * @param worksize Number of parallel threads to use during the construction.
+   * If a negative number is given, all available threads will be used.
+   */
+  inline LinearOctree(std::vector< CoordinateVector<> > &positions, Box<> box,
+                      bool periodic = false, int_fast32_t worksize = -1)
+      : _positions(positions), _box(box), _is_periodic(periodic) {
+
+    const size_t size = _positions.size();
+    if (size == 0) {
+      return;
+    }
+    if (size > UINT32_MAX) {
+      cmac_error("Too many positions for a LinearOctree (%zu)!", size);
+    }
+
+    // we use the bounding box of the positions to compute the keys, since the
+    // given box might be degenerate (or might not contain all positions)
+    CoordinateVector<> minpos(DBL_MAX);
+    CoordinateVector<> maxpos(-DBL_MAX);
+    for (size_t i = 0; i < size; ++i) {
+      minpos = CoordinateVector<>::min(minpos, _positions[i]);
+      maxpos = CoordinateVector<>::max(maxpos, _positions[i]);
+    }
+    CoordinateVector<> sides = maxpos - minpos;
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+      // make sure the largest coordinate maps inside the key range, and avoid
+      // divisions by zero
+      sides[i] = std::max(1.001 * sides[i], DBL_MIN);
+    }
+    const HilbertKeyGenerator key_generator(Box<>(minpos, sides));
+
+    std::vector< uint64_t > keys(size);
+    _indices.resize(size);
+    {
+      LinearOctreeKeyComputation key_computation(key_generator, _positions,
+                                                 keys, _indices);
+      WorkDistributor< LinearOctreeJobMarket< LinearOctreeKeyComputation >,
+                       LinearOctreeJob< LinearOctreeKeyComputation > >
+          workers(worksize);
+      LinearOctreeJobMarket< LinearOctreeKeyComputation > jobs(
+          key_computation, size, 1000);
+      workers.do_in_parallel(jobs);
+    }
+
+    radix_sort(keys, _indices, worksize);
+
+    // split the tree into independent sub trees and construct these in
+    // parallel
+    std::vector<
+        std::pair< std::pair< uint_fast32_t, uint_fast32_t >, uint_fast8_t > >
+        tasks;
+    collect_tasks(keys, 0, size, 0, tasks);
+    std::vector< std::vector< LinearOctreeNode > > task_nodes(tasks.size());
+    {
+      LinearOctreeSubtreeConstruction subtree_construction(keys, tasks,
+                                                           task_nodes);
+      WorkDistributor<
+          LinearOctreeJobMarket< LinearOctreeSubtreeConstruction >,
+          LinearOctreeJob< LinearOctreeSubtreeConstruction > >
+          workers(worksize);
+      LinearOctreeJobMarket< LinearOctreeSubtreeConstruction > jobs(
+          subtree_construction, tasks.size(), 1);
+      workers.do_in_parallel(jobs);
+    }
+
+    size_t next_task = 0;
+    assemble(keys, 0, size, 0, task_nodes, next_task);
+    cmac_assert(next_task == tasks.size());
+
+    _node_boxes.resize(_nodes.size());
+    _node_variables.resize(_nodes.size(), 0.);
+    update_boxes();
+  }
+
+  /**
+   * @brief Custom version of std::max that can be used as a template operation.
+   *
+   * @param a Variable a.
+   * @param b Variable b.
+   * @return std::max(a,b).
+   */
+  template < typename _datatype_ >
+  inline static const _datatype_ &max(const _datatype_ &a,
+                                      const _datatype_ &b) {
+    return std::max(a, b);
+  }
+
+  /**
+   * @brief Set the auxiliary variables and accumulate the variables in the
+   * nodes using the given operation.
+   *
+   * @param v std::vector containing the values of the auxiliary variables (for
+   * each position, there is exactly one corresponding variable).
+   * @param op Operation used to accumulate variables within nodes.
+   */
+  template < typename _operation_ >
+  inline void set_auxiliaries(const std::vector< double > &v, _operation_ op) {
+
+    const size_t size = _indices.size();
+    _sorted_variables.resize(size);
+    for (size_t i = 0; i < size; ++i) {
+      _sorted_variables[i] = v[_indices[i]];
+    }
+
+    // children are always stored after their parent, so by traversing the
+    // nodes in reverse order, we are sure all children are done before their
+    // parent
+    for (size_t i = _nodes.size(); i > 0; --i) {
+      const size_t index = i - 1;
+      const LinearOctreeNode &node = _nodes[index];
+      if (node._is_leaf) {
+        double variable = _sorted_variables[node._first];
+        for (uint_fast32_t j = node._first + 1; j < node._last; ++j) {
+          variable = op(variable, _sorted_variables[j]);
+        }
+        _node_variables[index] = variable;
+      } else {
+        uint_fast32_t child = index + 1;
+        double variable = _node_variables[child];
+        child = _nodes[child]._next;
+        while (child < node._next) {
+          variable = op(variable, _node_variables[child]);
+          child = _nodes[child]._next;
+        }
+        _node_variables[index] = variable;
+      }
+    }
+  }
+
+  /**
+   * @brief Recompute the bounding boxes of all nodes.
+   *
+   * This function is called by the constructor, and should be called again if
+   * the underlying positions have moved. The tree structure is kept.
+   */
+  inline void update_boxes() {
+
+    for (size_t i = _nodes.size(); i > 0; --i) {
+      const size_t index = i - 1;
+      const LinearOctreeNode &node = _nodes[index];
+      CoordinateVector<> minpos(DBL_MAX);
+      CoordinateVector<> maxpos(-DBL_MAX);
+      if (node._is_leaf) {
+        for (uint_fast32_t j = node._first; j < node._last; ++j) {
+          const CoordinateVector<> &position = _positions[_indices[j]];
+          minpos = CoordinateVector<>::min(minpos, position);
+          maxpos = CoordinateVector<>::max(maxpos, position);
+        }
+      } else {
+        uint_fast32_t child = index + 1;
+        while (child < node._next) {
+          const Box<> &child_box = _node_boxes[child];
+          minpos = CoordinateVector<>::min(minpos, child_box.get_anchor());
+          maxpos = CoordinateVector<>::max(
+              maxpos, child_box.get_anchor() + child_box.get_sides());
+          child = _nodes[child]._next;
+        }
+      }
+      _node_boxes[index] = Box<>(minpos, maxpos - minpos);
+    }
+  }
+
+  /**
+   * @brief Call the given function for all neighbours of the given position.
+   *
+   * A neighbour is a position in the internal list for which the given position
+   * lies inside the sphere with the list position as centre and the
+   * corresponding auxiliary variable as radius.
+   *
+   * @param centre Position for which we search neighbours.
+   * @param callback Function that is called with the index of every neighbour
+   * as argument.
+   */
+  template < typename _callback_ >
+  inline void for_each_ngb(const CoordinateVector<> &centre,
+                           _callback_ &&callback) const {
+    for_each_ngb_sphere(centre, 0., callback);
+  }
+
+  /**
+   * @brief Call the given function for all neighbours of the sphere with the
+   * given position and radius.
+   *
+   * A neighbour is a position in the internal list for which the input sphere
+   * overlaps with the sphere with the list position as centre and the
+   * corresponding auxiliary variable as radius.
+   *
+   * @param centre Centre of the sphere for which we search neighbours.
+   * @param radius Radius of the sphere for which we search neighbours.
+   * @param callback Function that is called with the index of every neighbour
+   * as argument.
+   */
+  template < typename _callback_ >
+  inline void for_each_ngb_sphere(const CoordinateVector<> &centre,
+                                  const double radius,
+                                  _callback_ &&callback) const {
+
+    const uint_fast32_t number_of_nodes = _nodes.size();
+    uint_fast32_t next = 0;
+    while (next < number_of_nodes) {
+      const LinearOctreeNode &node = _nodes[next];
+      // check opening criterion
+      if (get_node_distance(next, centre) > _node_variables[next] + radius) {
+        next = node._next;
+      } else if (node._is_leaf) {
+        for (uint_fast32_t j = node._first; j < node._last; ++j) {
+          const uint_fast32_t index = _indices[j];
+          if (get_distance(index, centre) <= _sorted_variables[j] + radius) {
+            callback(index);
+          }
+        }
+        next = node._next;
+      } else {
+        next = next + 1;
+      }
+    }
+  }
+
+  /**
+   * @brief Get the indices of the neighbours of the given position.
+   *
+   * @param centre Position for which we search neighbours.
+   * @param ngbs std::vector to store the neighbour indices in. The vector is
+   * cleared first, but its memory is reused.
+   */
+  inline void get_ngbs(const CoordinateVector<> &centre,
+                       std::vector< uint_fast32_t > &ngbs) const {
+    ngbs.clear();
+    for_each_ngb(centre,
+                 [&ngbs](const uint_fast32_t index) { ngbs.push_back(index); });
+  }
+
+  /**
+   * @brief Get the indices of the neighbours of the given position.
+   *
+   * @param centre Position for which we search neighbours.
+   * @return Indices of the positions in the internal list that are neighbours
+   * of the given centre.
+   */
+  inline std::vector< uint_fast32_t >
+  get_ngbs(const CoordinateVector<> &centre) const {
+    std::vector< uint_fast32_t > ngbs;
+    get_ngbs(centre, ngbs);
+    return ngbs;
+  }
+
+  /**
+   * @brief Get the indices of the neighbours of the sphere with the given
+   * position and radius.
+   *
+   * @param centre Centre of the sphere for which we search neighbours.
+   * @param radius Radius of the sphere for which we search neighbours.
+   * @return Indices of the positions in the internal list that are neighbours
+   * of the given sphere.
+   */
+  inline std::vector< uint_fast32_t >
+  get_ngbs_sphere(const CoordinateVector<> &centre, const double radius) const {
+    std::vector< uint_fast32_t > ngbs;
+    for_each_ngb_sphere(centre, radius, [&ngbs](const uint_fast32_t index) {
+      ngbs.push_back(index);
+    });
+    return ngbs;
+  }
+
+  /**
+   * @brief Get the index of the closest position to the given position.
+   *
+   * @param centre Position that is at the centre of the search radius.
+   * @return Index of the closest position to that position.
+   */
+  inline uint_fast32_t get_closest_ngb(const CoordinateVector<> &centre) const {
+
+    double rmin = DBL_MAX;
+    uint_fast32_t imin = 0;
+    const uint_fast32_t number_of_nodes = _nodes.size();
+    uint_fast32_t next = 0;
+    while (next < number_of_nodes) {
+      const LinearOctreeNode &node = _nodes[next];
+      if (get_node_distance(next, centre) > rmin) {
+        next = node._next;
+      } else if (node._is_leaf) {
+        for (uint_fast32_t j = node._first; j < node._last; ++j) {
+          const uint_fast32_t index = _indices[j];
+          const double r = get_distance(index, centre);
+          if (r <= rmin) {
+            rmin = r;
+            imin = index;
+          }
+        }
+        next = node._next;
+      } else {
+        next = next + 1;
+      }
+    }
+    return imin;
+  }
+
+  /**
+   * @brief Get the number of nodes in the tree.
+   *
+   * @return Number of nodes.
+   */
+  inline size_t get_number_of_nodes() const { return _nodes.size(); }
+};
+
+#endif // LINEAROCTREE_HPP
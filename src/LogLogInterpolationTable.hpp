@@ -0,0 +1,495 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file LogLogInterpolationTable.hpp
+ *
+ * @brief Precomputed, logarithmically spaced interpolation table for a positive
+ * function of a single variable, with support for discontinuities.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef LOGLOGINTERPOLATIONTABLE_HPP
+#define LOGLOGINTERPOLATIONTABLE_HPP
+
+#include "Error.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+
+/*! @brief Number of sampling points per table interval that are used to detect
+ *  discontinuities in the tabulated function. */
+#define LOGLOGINTERPOLATIONTABLE_NUMBER_OF_SCAN_POINTS 8
+
+/*! @brief Minimum factor by which the logarithmic change over a single scan
+ *  interval has to exceed the change over the neighbouring scan intervals for
+ *  it to be flagged as a discontinuity. */
+#define LOGLOGINTERPOLATIONTABLE_JUMP_FACTOR 4.
+
+/*! @brief Relative width of the interval in which a discontinuity is located
+ *  at the end of the bisection. */
+#define LOGLOGINTERPOLATIONTABLE_EDGE_TOLERANCE 1.e-13
+
+/*! @brief Number of table intervals next to a smooth transition to zero that
+ *  are tabulated as a function of the distance to the transition. */
+#define LOGLOGINTERPOLATIONTABLE_TAIL_INTERVALS 64
+
+/*! @brief Relative distance to a smooth transition to zero below which the
+ *  function is extrapolated as a power law of that distance. */
+#define LOGLOGINTERPOLATIONTABLE_TAIL_MINIMUM_DISTANCE 1.e-8
+
+/**
+ * @brief Precomputed, logarithmically spaced interpolation table for a positive
+ * function of a single variable, with support for discontinuities.
+ *
+ * The function is tabulated on a grid that is uniform in @f$\log(x)@f$, and is
+ * interpolated linearly in @f$\log(x)-\log(y)@f$ space, which is exact for
+ * power laws.
+ *
+ * Before the table is constructed, the function is scanned for
+ * discontinuities: transitions between zero and non-zero values (e.g. an
+ * ionization threshold), and jumps in the function value (e.g. an inner shell
+ * edge). These are located up to machine precision using bisection, and the
+ * table is split into segments that end at the discontinuities, so that the
+ * interpolation never crosses one. Segments in which the function is zero are
+ * stored as a single flag.
+ *
+ * If the function goes to zero smoothly (e.g. a fit that is clipped to zero),
+ * @f$\log(y)@f$ diverges and cannot be interpolated in @f$\log(x)@f$. The last
+ * table intervals before such a transition at @f$x_0@f$ are therefore
+ * tabulated as a function of @f$\log(|x-x_0|)@f$ instead, which is exact for a
+ * function that goes to zero linearly.
+ *
+ * After the table is constructed, the maximum relative difference between the
+ * interpolated and the exact function is measured at three points inside
+ * every table interval.
+ *
+ * Outside the table range, the first and last non-zero table interval are
+ * extrapolated as power laws.
+ */
+class LogLogInterpolationTable {
+private:
+  /**
+   * @brief Types of table segment.
+   */
+  enum SegmentType {
+    /*! @brief Segment in which the function is zero. */
+    SEGMENTTYPE_ZERO = 0,
+    /*! @brief Segment tabulated as a function of @f$\log(x)@f$. */
+    SEGMENTTYPE_LOG,
+    /*! @brief Segment tabulated as a function of @f$\log(x_0-x)@f$. */
+    SEGMENTTYPE_TAIL_BEFORE_ZERO,
+    /*! @brief Segment tabulated as a function of @f$\log(x-x_0)@f$. */
+    SEGMENTTYPE_TAIL_AFTER_ZERO
+  };
+
+  /**
+   * @brief Table segment.
+   */
+  struct Segment {
+    /*! @brief Natural logarithm of the lower limit of the segment. */
+    double _minimum_log_x;
+
+    /*! @brief Type of the segment. */
+    SegmentType _type;
+
+    /*! @brief Position of the transition to zero (only used for tails). */
+    double _edge;
+
+    /*! @brief Lower limit of the table variable. */
+    double _minimum_u;
+
+    /*! @brief Inverse of the spacing of the table variable. */
+    double _inverse_spacing;
+
+    /*! @brief Offset of the first point of the segment in the value array. */
+    uint_fast32_t _offset;
+
+    /*! @brief Number of points in the segment. */
+    uint_fast32_t _size;
+  };
+
+  /*! @brief Table segments. */
+  std::vector< Segment > _segments;
+
+  /*! @brief Natural logarithm of the tabulated function values. */
+  std::vector< double > _log_y;
+
+  /*! @brief Maximum relative difference between the interpolated and the exact
+   *  function. */
+  double _maximum_relative_error;
+
+  /**
+   * @brief Locate a discontinuity in the given interval using bisection.
+   *
+   * @param function Function to tabulate.
+   * @param xmin Lower limit of the interval, updated to the largest value
+   * before the discontinuity.
+   * @param xmax Upper limit of the interval, updated to the smallest value
+   * after the discontinuity.
+   */
+  template < typename _function_ >
+  inline static void locate_edge(_function_ &function, double &xmin,
+                                 double &xmax) {
+
+    double ymin = function(xmin);
+    double ymax = function(xmax);
+    const bool zero_transition = ((ymin == 0.) != (ymax == 0.));
+    while (xmax > xmin * (1. + LOGLOGINTERPOLATIONTABLE_EDGE_TOLERANCE)) {
+      const double xmid = std::sqrt(xmin * xmax);
+      if (xmid <= xmin || xmid >= xmax) {
+        break;
+      }
+      const double ymid = function(xmid);
+      bool left;
+      if (zero_transition) {
+        left = ((ymid == 0.) != (ymin == 0.));
+      } else {
+        left = (std::abs(std::log(ymid / ymin)) >
+                std::abs(std::log(ymax / ymid)));
+      }
+      if (left) {
+        xmax = xmid;
+        ymax = ymid;
+      } else {
+        xmin = xmid;
+        ymin = ymid;
+      }
+    }
+  }
+
+  /**
+   * @brief Get the table variable for the given segment.
+   *
+   * @param segment Non-zero segment.
+   * @param x Function argument.
+   * @param log_x Natural logarithm of the function argument.
+   * @return Table variable.
+   */
+  inline static double get_table_variable(const Segment &segment,
+                                          const double x, const double log_x) {
+    if (segment._type == SEGMENTTYPE_LOG) {
+      return log_x;
+    } else {
+      return std::log(std::abs(x - segment._edge));
+    }
+  }
+
+  /**
+   * @brief Interpolate in the given non-zero segment.
+   *
+   * @param segment Non-zero segment.
+   * @param u Table variable.
+   * @return Interpolated function value.
+   */
+  inline double interpolate(const Segment &segment, const double u) const {
+
+    const double uscaled =
+        (u - segment._minimum_u) * segment._inverse_spacing;
+    // the interval index is clamped, so that values outside the segment are
+    // extrapolated using the first or last interval
+    const int_fast32_t last_interval = segment._size - 2;
+    const int_fast32_t index =
+        std::max(int_fast32_t(0),
+                 std::min(last_interval, int_fast32_t(std::floor(uscaled))));
+    const double t = uscaled - index;
+    const double *log_y = &_log_y[segment._offset + index];
+    return std::exp(log_y[0] + t * (log_y[1] - log_y[0]));
+  }
+
+  /**
+   * @brief Add a non-zero segment to the table.
+   *
+   * @param function Function to tabulate.
+   * @param xmin Lower limit of the segment.
+   * @param xmax Upper limit of the segment.
+   * @param type Type of the segment.
+   * @param edge Position of the transition to zero (only used for tails).
+   * @param spacing Maximum spacing of the table variable.
+   */
+  template < typename _function_ >
+  inline void add_segment(_function_ &function, const double xmin,
+                          const double xmax, const SegmentType type,
+                          const double edge, const double spacing) {
+
+    Segment segment;
+    segment._minimum_log_x = std::log(xmin);
+    segment._type = type;
+    segment._edge = edge;
+    segment._offset = _log_y.size();
+
+    // the table variable at both ends of the segment (note that tails before
+    // a transition to zero are tabulated in the direction of decreasing x)
+    double umin, umax;
+    if (type == SEGMENTTYPE_LOG) {
+      umin = segment._minimum_log_x;
+      umax = std::log(xmax);
+    } else {
+      const double minimum_distance =
+          LOGLOGINTERPOLATIONTABLE_TAIL_MINIMUM_DISTANCE * edge;
+      if (type == SEGMENTTYPE_TAIL_BEFORE_ZERO) {
+        umin = std::log(std::max(edge - xmax, minimum_distance));
+        umax = std::log(edge - xmin);
+      } else {
+        umin = std::log(std::max(xmin - edge, minimum_distance));
+        umax = std::log(xmax - edge);
+      }
+    }
+    segment._minimum_u = umin;
+    segment._size =
+        std::max(uint_fast32_t(2),
+                 uint_fast32_t(std::ceil((umax - umin) / spacing)) + 1);
+    const double segment_spacing = (umax - umin) / (segment._size - 1.);
+    segment._inverse_spacing =
+        (segment_spacing > 0.) ? 1. / segment_spacing : 0.;
+
+    // converts a table variable value back into a function argument
+    auto get_x = [type, edge](const double u) {
+      if (type == SEGMENTTYPE_LOG) {
+        return std::exp(u);
+      } else if (type == SEGMENTTYPE_TAIL_BEFORE_ZERO) {
+        return edge - std::exp(u);
+      } else {
+        return edge + std::exp(u);
+      }
+    };
+
+    for (uint_fast32_t i = 0; i < segment._size; ++i) {
+      double x = get_x(umin + i * segment_spacing);
+      // make sure we sample the exact segment limits (round off could put
+      // them on the wrong side of a discontinuity)
+      if (type == SEGMENTTYPE_LOG && i == 0) {
+        x = xmin;
+      } else if (type == SEGMENTTYPE_LOG && i == segment._size - 1) {
+        x = xmax;
+      }
+      x = std::max(xmin, std::min(xmax, x));
+      _log_y.push_back(std::log(std::max(function(x), DBL_MIN)));
+    }
+
+    // measure the interpolation error
+    for (uint_fast32_t i = 0; i < segment._size - 1; ++i) {
+      for (uint_fast8_t j = 1; j < 4; ++j) {
+        const double u = umin + (i + 0.25 * j) * segment_spacing;
+        const double yexact = function(get_x(u));
+        if (yexact > 0.) {
+          const double yinterp = interpolate(segment, u);
+          _maximum_relative_error = std::max(_maximum_relative_error,
+                                             std::abs(yinterp / yexact - 1.));
+        }
+      }
+    }
+
+    _segments.push_back(segment);
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param function Function to tabulate, called as function(x). Should return
+   * positive or zero values.
+   * @param minimum_x Lower limit of the table range.
+   * @param maximum_x Upper limit of the table range.
+   * @param number_of_points Number of points in the table if the function has
+   * no discontinuities. Every discontinuity adds a few points, every smooth
+   * transition to zero adds a tail table with a comparable number of points.
+   */
+  template < typename _function_ >
+  inline LogLogInterpolationTable(_function_ function, const double minimum_x,
+                                  const double maximum_x,
+                                  const uint_fast32_t number_of_points)
+      : _maximum_relative_error(0.) {
+
+    if (minimum_x <= 0. || maximum_x <= minimum_x) {
+      cmac_error("Invalid range for a LogLogInterpolationTable: [%g, %g]!",
+                 minimum_x, maximum_x);
+    }
+    if (number_of_points < 2) {
+      cmac_error("A LogLogInterpolationTable needs at least 2 points!");
+    }
+
+    const double log_minimum_x = std::log(minimum_x);
+    const double log_range = std::log(maximum_x) - log_minimum_x;
+    const double spacing = log_range / (number_of_points - 1.);
+
+    // scan the function on a finer grid to find the discontinuities
+    const uint_fast32_t number_of_scan_intervals =
+        (number_of_points - 1) * LOGLOGINTERPOLATIONTABLE_NUMBER_OF_SCAN_POINTS;
+    const uint_fast32_t number_of_scan_points = number_of_scan_intervals + 1;
+    std::vector< double > scan_x(number_of_scan_points);
+    std::vector< double > scan_y(number_of_scan_points);
+    for (uint_fast32_t i = 0; i < number_of_scan_points; ++i) {
+      scan_x[i] =
+          std::exp(log_minimum_x + i * log_range / number_of_scan_intervals);
+      scan_y[i] = function(scan_x[i]);
+      if (scan_y[i] < 0.) {
+        cmac_error("Negative function value in LogLogInterpolationTable (%g at "
+                   "%g)!",
+                   scan_y[i], scan_x[i]);
+      }
+    }
+    // logarithmic change over every scan interval (0 if the interval contains
+    // a zero value)
+    std::vector< double > scan_change(number_of_scan_points - 1, 0.);
+    for (uint_fast32_t i = 0; i < number_of_scan_points - 1; ++i) {
+      if (scan_y[i] > 0. && scan_y[i + 1] > 0.) {
+        scan_change[i] = std::abs(std::log(scan_y[i + 1] / scan_y[i]));
+      }
+    }
+
+    // the segment limits: every discontinuity ends a segment at the largest
+    // value before it and starts a new segment at the smallest value after it
+    std::vector< double > segment_minimum(1, minimum_x);
+    std::vector< double > segment_maximum;
+    for (uint_fast32_t i = 0; i < number_of_scan_points - 1; ++i) {
+      bool edge = ((scan_y[i] == 0.) != (scan_y[i + 1] == 0.));
+      if (!edge && scan_change[i] > 0.) {
+        double neighbour_change = 0.;
+        if (i > 0) {
+          neighbour_change = scan_change[i - 1];
+        }
+        if (i < number_of_scan_points - 2) {
+          neighbour_change = std::max(neighbour_change, scan_change[i + 1]);
+        }
+        edge = (scan_change[i] >
+                LOGLOGINTERPOLATIONTABLE_JUMP_FACTOR * neighbour_change);
+      }
+      if (edge) {
+        double xmin = scan_x[i];
+        double xmax = scan_x[i + 1];
+        locate_edge(function, xmin, xmax);
+        segment_maximum.push_back(xmin);
+        segment_minimum.push_back(xmax);
+      }
+    }
+    segment_maximum.push_back(maximum_x);
+
+    // now tabulate the segments
+    const uint_fast32_t number_of_segments = segment_minimum.size();
+    std::vector< bool > zero_segment(number_of_segments);
+    for (uint_fast32_t iseg = 0; iseg < number_of_segments; ++iseg) {
+      // segments are either zero or non-zero everywhere
+      zero_segment[iseg] = (function(std::sqrt(
+                                segment_minimum[iseg] *
+                                segment_maximum[iseg])) == 0.);
+    }
+    // the largest distance to a transition to zero that is treated as a tail
+    const double tail_size =
+        std::expm1(LOGLOGINTERPOLATIONTABLE_TAIL_INTERVALS * spacing);
+    for (uint_fast32_t iseg = 0; iseg < number_of_segments; ++iseg) {
+      const double xmin = segment_minimum[iseg];
+      const double xmax = segment_maximum[iseg];
+      if (zero_segment[iseg]) {
+        Segment segment;
+        segment._minimum_log_x = std::log(xmin);
+        segment._type = SEGMENTTYPE_ZERO;
+        segment._edge = 0.;
+        segment._minimum_u = 0.;
+        segment._inverse_spacing = 0.;
+        segment._offset = _log_y.size();
+        segment._size = 0;
+        _segments.push_back(segment);
+        continue;
+      }
+
+      // a transition to zero is smooth if the function decreases strongly
+      // over the last table interval before it
+      const double xmin_inner = std::min(xmax, xmin * std::exp(spacing));
+      const double xmax_inner = std::max(xmin, xmax * std::exp(-spacing));
+      const bool tail_before =
+          (iseg > 0 && zero_segment[iseg - 1] &&
+           function(xmin) < 0.5 * function(xmin_inner));
+      const bool tail_after =
+          (iseg < number_of_segments - 1 && zero_segment[iseg + 1] &&
+           function(xmax) < 0.5 * function(xmax_inner));
+
+      // the tails cover (at most) half of the segment
+      double xlog_min = xmin;
+      double xlog_max = xmax;
+      if (tail_before) {
+        const double edge = segment_maximum[iseg - 1];
+        xlog_min = std::min(edge * (1. + tail_size),
+                            xmin + 0.5 * (xmax - xmin));
+        add_segment(function, xmin, xlog_min, SEGMENTTYPE_TAIL_AFTER_ZERO,
+                    edge, spacing);
+      }
+      if (tail_after) {
+        xlog_max = std::max(segment_minimum[iseg + 1] / (1. + tail_size),
+                            xmax - 0.5 * (xmax - xmin));
+      }
+      if (xlog_max > xlog_min) {
+        add_segment(function, xlog_min, xlog_max, SEGMENTTYPE_LOG, 0.,
+                    spacing);
+      }
+      if (tail_after) {
+        add_segment(function, xlog_max, xmax, SEGMENTTYPE_TAIL_BEFORE_ZERO,
+                    segment_minimum[iseg + 1], spacing);
+      }
+    }
+  }
+
+  /**
+   * @brief Get the interpolated function value for the given argument.
+   *
+   * @param x Function argument.
+   * @return Interpolated function value.
+   */
+  inline double get_value(const double x) const {
+
+    const double log_x = std::log(x);
+    // find the segment that contains the argument: there are only a few
+    // segments, so a linear search is fastest
+    uint_fast32_t isegment = _segments.size() - 1;
+    while (isegment > 0 && log_x < _segments[isegment]._minimum_log_x) {
+      --isegment;
+    }
+    const Segment &segment = _segments[isegment];
+    if (segment._type == SEGMENTTYPE_ZERO) {
+      return 0.;
+    }
+    return interpolate(segment, get_table_variable(segment, x, log_x));
+  }
+
+  /**
+   * @brief Get the number of segments in the table.
+   *
+   * Smooth transitions to zero are stored as separate segments.
+   *
+   * @return Number of segments.
+   */
+  inline uint_fast32_t get_number_of_segments() const {
+    return _segments.size();
+  }
+
+  /**
+   * @brief Get the maximum relative difference between the interpolated and
+   * the exact function within the table range.
+   *
+   * @return Maximum relative error.
+   */
+  inline double get_maximum_relative_error() const {
+    return _maximum_relative_error;
+  }
+};
+
+#endif // LOGLOGINTERPOLATIONTABLE_HPP
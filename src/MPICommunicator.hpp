@@ -34,6 +34,7 @@
 #include "MPIMessageBox.hpp"
 #include "MPIUtilities.hpp"
 
+#include <algorithm>
 #include <vector>
 
 #ifdef HAVE_MPI
@@ -78,6 +79,81 @@ enum MPIOperatorType {
   MPI_SUM_OF_ALL_PROCESSES = 0
 };
 
+/**
+ * @brief Helper class used to pack the values of multiple PropertyAccessors
+ * for a single element into a contiguous buffer, and to unpack them again.
+ *
+ * This is the general template, which is only used to end the recursion over
+ * the PropertyAccessors.
+ */
+template < typename _datatype_, typename... _PropertyAccessors_ >
+class MPIPropertyPacker {
+public:
+  /*! @brief Number of values per element. */
+  static const size_t size = 0;
+
+  /**
+   * @brief Pack the values for the element the given iterator points to.
+   *
+   * @param it Iterator to an element.
+   * @param buffer Buffer to pack into.
+   */
+  template < typename _iteratortype_ >
+  inline static void pack(const _iteratortype_ &it, _datatype_ *buffer) {}
+
+  /**
+   * @brief Unpack the values for the element the given iterator points to.
+   *
+   * @param it Iterator to an element.
+   * @param buffer Buffer to unpack from.
+   */
+  template < typename _iteratortype_ >
+  inline static void unpack(_iteratortype_ &it, const _datatype_ *buffer) {}
+};
+
+/**
+ * @brief Helper class used to pack the values of multiple PropertyAccessors
+ * for a single element into a contiguous buffer, and to unpack them again.
+ *
+ * This specialization handles the first PropertyAccessor and recursively
+ * calls the version for the other PropertyAccessors.
+ */
+template < typename _datatype_, typename _PropertyAccessor_,
+           typename... _PropertyAccessors_ >
+class MPIPropertyPacker< _datatype_, _PropertyAccessor_,
+                         _PropertyAccessors_... > {
+public:
+  /*! @brief Number of values per element. */
+  static const size_t size =
+      1 + MPIPropertyPacker< _datatype_, _PropertyAccessors_... >::size;
+
+  /**
+   * @brief Pack the values for the element the given iterator points to.
+   *
+   * @param it Iterator to an element.
+   * @param buffer Buffer to pack into.
+   */
+  template < typename _iteratortype_ >
+  inline static void pack(const _iteratortype_ &it, _datatype_ *buffer) {
+    buffer[0] = _PropertyAccessor_::get_value(it);
+    MPIPropertyPacker< _datatype_, _PropertyAccessors_... >::pack(it,
+                                                                  buffer + 1);
+  }
+
+  /**
+   * @brief Unpack the values for the element the given iterator points to.
+   *
+   * @param it Iterator to an element.
+   * @param buffer Buffer to unpack from.
+   */
+  template < typename _iteratortype_ >
+  inline static void unpack(_iteratortype_ &it, const _datatype_ *buffer) {
+    _PropertyAccessor_::set_value(it, buffer[0]);
+    MPIPropertyPacker< _datatype_, _PropertyAccessors_... >::unpack(it,
+                                                                    buffer + 1);
+  }
+};
+
 /**
  * @brief C++ wrapper around basic MPI functions.
  */
@@ -557,6 +633,111 @@ public:
 #endif
   }
 
+  /**
+   * @brief Reduce multiple properties of the elements pointed to by the given
+   * begin and end iterator in a single communication, using the given template
+   * property accessors to get and set the relevant values for each element.
+   *
+   * The values for all properties are packed into a single contiguous buffer
+   * (all properties of the first element, then all properties of the second
+   * element...), so that all properties are reduced in a single collective
+   * call, rather than in one call per property. If the buffer is too small to
+   * hold all elements, the reduction is split into chunks. If the MPI library
+   * supports non-blocking collectives, the chunks are pipelined: the next chunk
+   * is packed while the previous chunk is being reduced, and a chunk is only
+   * unpacked after the next chunk has been started.
+   *
+   * @param begin Iterator to the first element that should be reduced.
+   * @param end Iterator to the first element that should not be reduced, or the
+   * end of the list.
+   * @param size Number of values to reduce in a single MPI communication. This
+   * value sets the memory size of the two buffers that are used internally.
+   */
+  template < MPIOperatorType _operatortype_, typename _datatype_,
+             typename... _PropertyAccessors_, typename _iteratortype_ >
+  void reduce_multiple(_iteratortype_ begin, _iteratortype_ end,
+                       size_t size) const {
+
+#ifdef HAVE_MPI
+    if (_size > 1) {
+      typedef MPIPropertyPacker< _datatype_, _PropertyAccessors_... > packer;
+      if (size == 0) {
+        size = MPICOMMUNICATOR_DEFAULT_BUFFERSIZE;
+      }
+      // the buffer should at least be able to hold a single element
+      const size_t chunksize = std::max(size / packer::size, size_t(1));
+      std::vector< _datatype_ > sendbuffer[2];
+      sendbuffer[0].resize(chunksize * packer::size);
+      sendbuffer[1].resize(chunksize * packer::size);
+      const MPI_Datatype dtype = MPIUtilities::get_datatype< _datatype_ >();
+      const MPI_Op otype = get_operator(_operatortype_);
+
+      // start iterators and element counts of the two chunks
+      _iteratortype_ chunkit[2] = {begin, begin};
+      size_t chunkcount[2] = {0, 0};
+#if MPI_VERSION >= 3
+      MPI_Request request[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+#endif
+
+      // index of the chunk that is currently being packed
+      uint_fast8_t active = 0;
+      // is there a chunk in flight that still needs to be unpacked?
+      bool has_pending = false;
+      _iteratortype_ it = begin;
+      while (it != end || has_pending) {
+
+        if (it != end) {
+          // pack the next chunk
+          chunkit[active] = it;
+          size_t i = 0;
+          while (it != end && i < chunksize) {
+            packer::pack(it, &sendbuffer[active][i * packer::size]);
+            ++i;
+            ++it;
+          }
+          chunkcount[active] = i;
+#if MPI_VERSION >= 3
+          const int_fast32_t status = MPI_Iallreduce(
+              MPI_IN_PLACE, &sendbuffer[active][0], i * packer::size, dtype,
+              otype, MPI_COMM_WORLD, &request[active]);
+          if (status != MPI_SUCCESS) {
+            cmac_error("Error in MPI_Iallreduce!");
+          }
+#else
+          const int_fast32_t status =
+              MPI_Allreduce(MPI_IN_PLACE, &sendbuffer[active][0],
+                            i * packer::size, dtype, otype, MPI_COMM_WORLD);
+          if (status != MPI_SUCCESS) {
+            cmac_error("Error in MPI_Allreduce!");
+          }
+#endif
+        }
+
+        // now finish the previous chunk (if any)
+        const uint_fast8_t pending = 1 - active;
+        if (has_pending) {
+#if MPI_VERSION >= 3
+          MPI_Wait(&request[pending], MPI_STATUS_IGNORE);
+#endif
+          _iteratortype_ unpackit = chunkit[pending];
+          for (size_t i = 0; i < chunkcount[pending]; ++i) {
+            packer::unpack(unpackit, &sendbuffer[pending][i * packer::size]);
+            ++unpackit;
+          }
+          has_pending = false;
+        }
+
+        // the chunk we just started becomes the pending chunk
+        if (chunkcount[active] > 0) {
+          has_pending = true;
+          chunkcount[pending] = 0;
+          active = pending;
+        }
+      }
+    }
+#endif
+  }
+
   /**
    * @brief Ensure the given std::vector is up to date on all processes,
    * assuming that MPI process i holds the block returned by
@@ -809,6 +990,87 @@ public:
 #endif
   }
 
+  /**
+   * @brief Gather multiple properties of the elements pointed to by the given
+   * begin and end iterator in a single communication, using the given
+   * PropertyAccessors to access iterator values.
+   *
+   * This routine does the same as the single PropertyAccessor version of
+   * gather(), but packs the values of all properties for an element into a
+   * single buffer, so that only one set of communications is needed for all
+   * properties.
+   *
+   * @param global_begin Iterator to the first element that should be gathered.
+   * @param global_end Iterator to the first element that should not be
+   * gathered, or the end of the list.
+   * @param local_begin Iterator to the first local element that should be send.
+   * @param local_end Iterator to the first local element that should not be
+   * send, or the end of the list.
+   * @param size Number of values to gather in a single MPI communication. This
+   * value sets the memory size of the buffer that is used internally.
+   */
+  template < typename _datatype_, typename... _PropertyAccessors_,
+             typename _iteratortype_ >
+  void gather_multiple(_iteratortype_ global_begin, _iteratortype_ global_end,
+                       _iteratortype_ local_begin, _iteratortype_ local_end,
+                       size_t size) const {
+
+#ifdef HAVE_MPI
+    if (_size > 1) {
+      typedef MPIPropertyPacker< _datatype_, _PropertyAccessors_... > packer;
+      if (size == 0) {
+        size = MPICOMMUNICATOR_DEFAULT_BUFFERSIZE;
+      }
+      const size_t chunksize = std::max(size / packer::size, size_t(1));
+      std::vector< _datatype_ > sendbuffer(chunksize * packer::size);
+      const MPI_Datatype dtype = MPIUtilities::get_datatype< _datatype_ >();
+
+      _iteratortype_ it = global_begin;
+      for (int_fast32_t irank = 0; irank < _size; ++irank) {
+
+        const bool is_local = (irank == _rank);
+
+        int done = false;
+        if (is_local) {
+          cmac_assert(it == local_begin);
+
+          done = (it == local_end);
+        }
+
+        while (!done) {
+          unsigned int i = 0;
+          if (is_local) {
+            while (it != local_end && i < chunksize) {
+              packer::pack(it, &sendbuffer[i * packer::size]);
+              ++i;
+              ++it;
+            }
+            done = (it == local_end);
+          }
+
+          // the element count and done flag are communicated together, so
+          // that we only need two broadcasts per chunk
+          int header[2] = {static_cast< int >(i), done};
+          MPI_Bcast(header, 2, MPI_INT, irank, MPI_COMM_WORLD);
+          i = header[0];
+          done = header[1];
+          MPI_Bcast(sendbuffer.data(), i * packer::size, dtype, irank,
+                    MPI_COMM_WORLD);
+
+          if (!is_local) {
+            for (uint_fast32_t j = 0; j < i; ++j) {
+              packer::unpack(it, &sendbuffer[j * packer::size]);
+              ++it;
+            }
+          }
+        }
+      }
+
+      cmac_assert(it == global_end);
+    }
+#endif
+  }
+
   /**
    * @brief Send the given message to the given process.
    *
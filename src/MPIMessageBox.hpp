@@ -77,10 +77,16 @@ public:
    * @param world_size Total number of MPI processes.
    */
   inline MPIMessageBox(int world_size)
-      : _num_semi_ready(1), _num_ready(1), _last_tag(0) {
+      : _num_semi_ready(1), _notified_ready(false), _num_ready(1),
+        _last_tag(0) {
     _state_flags.resize(world_size, 0);
   }
 
+  /**
+   * @brief Virtual destructor.
+   */
+  virtual ~MPIMessageBox() {}
+
   /**
    * @brief Generate a message from the given tag.
    *
@@ -121,6 +127,8 @@ public:
         _notified_ready = false;
       }
       MPIMessage *message = generate(announcement.get_type());
+      // make sure the receive buffer is large enough to hold the message
+      message->set_size(announcement.get_size());
       _inbox.push_back(message);
       return message;
     } else {
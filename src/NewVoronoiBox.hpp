@@ -27,6 +27,7 @@
 #define NEWVORONOIBOX_HPP
 
 #include "Box.hpp"
+#include "Error.hpp"
 #include "NewVoronoiVariables.hpp"
 
 #include <cinttypes>
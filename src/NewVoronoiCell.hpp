@@ -26,12 +26,23 @@
 #ifndef NEWVORONOICELL_HPP
 #define NEWVORONOICELL_HPP
 
+#include "NewVoronoiBox.hpp"
+#include "NewVoronoiTetrahedron.hpp"
 #include "VoronoiFace.hpp"
 
+#include <cinttypes>
 #include <vector>
 
 /**
  * @brief Voronoi cell constructed using the new algorithm.
+ *
+ * Apart from the geometrical properties of the cell, we also store its
+ * topology: the Delaunay tetrahedra that have the cell generator as a vertex,
+ * and for every face the ordered ring of tetrahedra around the Delaunay edge
+ * that corresponds to that face. The Voronoi vertices are the midpoints of the
+ * circumspheres of these tetrahedra, so that the geometry of the cell can be
+ * recomputed for new generator positions without reconstructing the cell, as
+ * long as the topology does not change.
  */
 class NewVoronoiCell {
 private:
@@ -44,6 +55,22 @@ private:
   /*! @brief Faces of the cell. */
   std::vector< VoronoiFace > _faces;
 
+  /*! @brief Generator indices of the vertices of the Delaunay tetrahedra that
+   *  have the cell generator as a vertex (4 indices per tetrahedron). */
+  std::vector< uint_least32_t > _tetrahedra;
+
+  /*! @brief Offsets of the faces in the face tetrahedra list: the tetrahedra
+   *  around face i are stored in [_face_offsets[i], _face_offsets[i+1]). */
+  std::vector< uint_least32_t > _face_offsets;
+
+  /*! @brief Indices of the tetrahedra around every face, ordered
+   *  counterclockwise when looking from outside the cell towards the cell
+   *  generator, through the face. */
+  std::vector< uint_least32_t > _face_tetrahedra;
+
+  /*! @brief Index of the neighbouring generator that generated each face. */
+  std::vector< uint_least32_t > _face_neighbours;
+
 public:
   /**
    * @brief Empty constructor.
@@ -61,6 +88,25 @@ public:
                         const std::vector< VoronoiFace > &faces)
       : _volume(volume), _centroid(centroid), _faces(faces) {}
 
+  /**
+   * @brief Constructor.
+   *
+   * Only sets the topology of the cell; compute_geometry() needs to be called
+   * before the geometrical properties can be used.
+   *
+   * @param tetrahedra Generator indices of the vertices of the Delaunay
+   * tetrahedra that have the cell generator as a vertex.
+   * @param face_offsets Offsets of the faces in the face tetrahedra list.
+   * @param face_tetrahedra Ordered indices of the tetrahedra around every face.
+   * @param face_neighbours Index of the neighbouring generator for every face.
+   */
+  inline NewVoronoiCell(const std::vector< uint_least32_t > &tetrahedra,
+                        const std::vector< uint_least32_t > &face_offsets,
+                        const std::vector< uint_least32_t > &face_tetrahedra,
+                        const std::vector< uint_least32_t > &face_neighbours)
+      : _volume(0.), _tetrahedra(tetrahedra), _face_offsets(face_offsets),
+        _face_tetrahedra(face_tetrahedra), _face_neighbours(face_neighbours) {}
+
   /**
    * @brief Get the volume of the cell.
    *
@@ -81,6 +127,117 @@ public:
    * @return Faces of the cell.
    */
   inline const std::vector< VoronoiFace > &get_faces() const { return _faces; }
+
+  /**
+   * @brief Get the number of Delaunay tetrahedra that have the cell generator
+   * as a vertex.
+   *
+   * @return Number of tetrahedra (0 if the cell has no topology information).
+   */
+  inline uint_fast32_t get_number_of_tetrahedra() const {
+    return _tetrahedra.size() / 4;
+  }
+
+  /**
+   * @brief Get the generator index of the given vertex of the given
+   * tetrahedron.
+   *
+   * @param tetrahedron Index of a tetrahedron.
+   * @param vertex Index of a vertex of that tetrahedron (0-3).
+   * @return Generator index of that vertex.
+   */
+  inline uint_fast32_t get_tetrahedron_vertex(uint_fast32_t tetrahedron,
+                                              uint_fast8_t vertex) const {
+    return _tetrahedra[4 * tetrahedron + vertex];
+  }
+
+  /**
+   * @brief Compute the vertices of the cell for the given generator positions.
+   *
+   * @param generator Index of the cell generator.
+   * @param box VoronoiBox containing the box generating positions (in m).
+   * @param positions Generator positions (in m).
+   * @param vertices Vector to store the cell generator position (first
+   * element), followed by the midpoints of the circumspheres of all
+   * tetrahedra (in m).
+   */
+  inline void
+  compute_vertices(uint_fast32_t generator, const NewVoronoiBox &box,
+                   const std::vector< CoordinateVector<> > &positions,
+                   std::vector< CoordinateVector<> > &vertices) const {
+
+    const CoordinateVector<> &generator_position = positions[generator];
+    const uint_fast32_t number_of_tetrahedra = get_number_of_tetrahedra();
+    vertices.resize(number_of_tetrahedra + 1);
+    vertices[0] = generator_position;
+    for (uint_fast32_t i = 0; i < number_of_tetrahedra; ++i) {
+      CoordinateVector<> p[4];
+      for (uint_fast8_t j = 0; j < 4; ++j) {
+        const uint_fast32_t index = _tetrahedra[4 * i + j];
+        if (index < NEWVORONOICELL_MAX_INDEX) {
+          p[j] = positions[index];
+        } else {
+          p[j] = box.get_position(index, generator_position);
+        }
+      }
+      vertices[i + 1] =
+          NewVoronoiTetrahedron::get_midpoint_circumsphere(p[0], p[1], p[2],
+                                                           p[3]);
+    }
+  }
+
+  /**
+   * @brief Compute the volume, centroid and faces of the cell from the given
+   * cell vertices.
+   *
+   * @param vertices Cell generator position, followed by the midpoints of the
+   * circumspheres of all tetrahedra, as computed by compute_vertices() (in m).
+   */
+  inline void
+  compute_geometry(const std::vector< CoordinateVector<> > &vertices) {
+
+    _volume = 0.;
+    _centroid = CoordinateVector<>();
+    _faces.clear();
+    const uint_fast32_t number_of_faces = _face_neighbours.size();
+    _faces.reserve(number_of_faces);
+    for (uint_fast32_t i = 0; i < number_of_faces; ++i) {
+      const uint_least32_t *ring = &_face_tetrahedra[_face_offsets[i]];
+      const uint_fast32_t ring_size = _face_offsets[i + 1] - _face_offsets[i];
+      double area = 0.;
+      CoordinateVector<> midpoint;
+      std::vector< CoordinateVector<> > face_vertices;
+      face_vertices.reserve(ring_size);
+      face_vertices.push_back(vertices[ring[0] + 1]);
+      face_vertices.push_back(vertices[ring[1] + 1]);
+      for (uint_fast32_t j = 2; j < ring_size; ++j) {
+        face_vertices.push_back(vertices[ring[j] + 1]);
+        const NewVoronoiTetrahedron tetrahedron(0, ring[0] + 1, ring[j] + 1,
+                                                ring[j - 1] + 1);
+        const double tvol = tetrahedron.get_volume(vertices);
+        const CoordinateVector<> tcentroid = tetrahedron.get_centroid(vertices);
+        _volume += tvol;
+        _centroid += tvol * tcentroid;
+
+        const CoordinateVector<> r1 =
+            vertices[ring[j] + 1] - vertices[ring[0] + 1];
+        const CoordinateVector<> r2 =
+            vertices[ring[j - 1] + 1] - vertices[ring[0] + 1];
+        const CoordinateVector<> w = CoordinateVector<>::cross_product(r1, r2);
+        const double tarea = 0.5 * w.norm();
+        const CoordinateVector<> tmidpoint =
+            (vertices[ring[0] + 1] + vertices[ring[j - 1] + 1] +
+             vertices[ring[j] + 1]) /
+            3.;
+        area += tarea;
+        midpoint += tarea * tmidpoint;
+      }
+      midpoint /= area;
+      _faces.push_back(
+          VoronoiFace(area, midpoint, _face_neighbours[i], face_vertices));
+    }
+    _centroid /= _volume;
+  }
 };
 
 #endif // NEWVORONOICELL_HPP
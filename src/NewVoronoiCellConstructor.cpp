@@ -318,7 +318,8 @@ double NewVoronoiCellConstructor::get_max_radius_squared() const {
 }
 
 /**
- * @brief Compute geometrical properties of the central cell.
+ * @brief Compute the topology and the geometrical properties of the central
+ * cell.
  *
  * @param box Bounding box of the grid (in m).
  * @param positions Positions of the generators (in m).
@@ -328,20 +329,6 @@ NewVoronoiCell NewVoronoiCellConstructor::get_cell(
     const NewVoronoiBox &box,
     const std::vector< CoordinateVector<> > &positions) const {
 
-  std::vector< CoordinateVector<> > real_positions(_vertices_size);
-  for (uint_fast32_t i = 0; i < _vertices_size; ++i) {
-    real_positions[i] = get_position(_vertices[i], box, positions);
-  }
-
-  std::vector< CoordinateVector<> > cell_vertices(_tetrahedra_size + 1);
-  cell_vertices[0] = real_positions[0];
-  for (uint_fast32_t i = 0; i < _tetrahedra_size; ++i) {
-    if (_tetrahedra[i].is_active()) {
-      cell_vertices[i + 1] =
-          _tetrahedra[i].get_midpoint_circumsphere(real_positions);
-    }
-  }
-
   // we loop over all tetrahedra and check if the central generator (0) is part
   // of it. If so, we add new connections for every other vertex of the
   // tetrahedron that has not been processed before
@@ -404,50 +391,39 @@ NewVoronoiCell NewVoronoiCellConstructor::get_cell(
     }
   }
 
-  // due to the ordering of the connections, this constructs the faces in a
-  // counterclockwise direction when looking from outside the cell towards the
-  // cell generator, through the face
-  double volume = 0.;
-  CoordinateVector<> centroid;
-  std::vector< VoronoiFace > faces;
+  // we only store the tetrahedra that have the central generator as a vertex,
+  // in the order in which they are first encountered in the connections
+  std::vector< uint_least32_t > tetrahedra;
+  std::vector< uint_fast32_t > tetrahedron_index(_tetrahedra_size,
+                                                 NEWVORONOICELL_MAX_INDEX);
+  std::vector< uint_least32_t > face_offsets(connections.size() + 1, 0);
+  std::vector< uint_least32_t > face_tetrahedra;
+  std::vector< uint_least32_t > face_neighbours(connections.size());
   for (size_t i = 0; i < connections.size(); ++i) {
-    double area = 0.;
-    CoordinateVector<> midpoint;
-    std::vector< CoordinateVector<> > vertices;
-    vertices.push_back(cell_vertices[connections[i][0] + 1]);
-    vertices.push_back(cell_vertices[connections[i][1] + 1]);
-    for (size_t j = 2; j < connections[i].size(); ++j) {
-      vertices.push_back(cell_vertices[connections[i][j] + 1]);
-      const NewVoronoiTetrahedron tetrahedron(0, connections[i][0] + 1,
-                                              connections[i][j] + 1,
-                                              connections[i][j - 1] + 1);
-      const double tvol = tetrahedron.get_volume(cell_vertices);
-      const CoordinateVector<> tcentroid =
-          tetrahedron.get_centroid(cell_vertices);
-      volume += tvol;
-      centroid += tvol * tcentroid;
-
-      const CoordinateVector<> r1 = cell_vertices[connections[i][j] + 1] -
-                                    cell_vertices[connections[i][0] + 1];
-      const CoordinateVector<> r2 = cell_vertices[connections[i][j - 1] + 1] -
-                                    cell_vertices[connections[i][0] + 1];
-      const CoordinateVector<> w = CoordinateVector<>::cross_product(r1, r2);
-      const double tarea = 0.5 * w.norm();
-      const CoordinateVector<> tmidpoint =
-          (cell_vertices[connections[i][0] + 1] +
-           cell_vertices[connections[i][j - 1] + 1] +
-           cell_vertices[connections[i][j] + 1]) /
-          3.;
-      area += tarea;
-      midpoint += tarea * tmidpoint;
+    for (size_t j = 0; j < connections[i].size(); ++j) {
+      const uint_fast32_t itet = connections[i][j];
+      if (tetrahedron_index[itet] == NEWVORONOICELL_MAX_INDEX) {
+        tetrahedron_index[itet] = tetrahedra.size() / 4;
+        for (uint_fast8_t k = 0; k < 4; ++k) {
+          tetrahedra.push_back(_vertices[_tetrahedra[itet].get_vertex(k)]);
+        }
+      }
+      face_tetrahedra.push_back(tetrahedron_index[itet]);
     }
-    midpoint /= area;
-    faces.push_back(VoronoiFace(area, midpoint,
-                                _vertices[connection_vertices[i]], vertices));
+    face_offsets[i + 1] = face_tetrahedra.size();
+    face_neighbours[i] = _vertices[connection_vertices[i]];
   }
-  centroid /= volume;
 
-  return NewVoronoiCell(volume, centroid, faces);
+  // due to the ordering of the connections, this constructs the faces in a
+  // counterclockwise direction when looking from outside the cell towards the
+  // cell generator, through the face
+  NewVoronoiCell cell(tetrahedra, face_offsets, face_tetrahedra,
+                      face_neighbours);
+  std::vector< CoordinateVector<> > cell_vertices;
+  cell.compute_vertices(_vertices[0], box, positions, cell_vertices);
+  cell.compute_geometry(cell_vertices);
+
+  return cell;
 }
 
 /**
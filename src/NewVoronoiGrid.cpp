@@ -27,6 +27,8 @@
 #include "ExactGeometricTests.hpp"
 #include "NewVoronoiCellConstructor.hpp"
 #include "WorkDistributor.hpp"
+
+#include <algorithm>
 #include <cfloat>
 
 /*! @brief If not commented out, this checks the empty circumsphere condition
@@ -39,6 +41,10 @@
  *  tolerance equal to the value of this define). */
 //#define NEWVORONOIGRID_CHECK_TOTAL_VOLUME 1.e-14
 
+/*! @brief Relative tolerance used to decide if a generator is close enough to a
+ *  circumsphere to require an exact geometric test during a geometry update. */
+#define NEWVORONOIGRID_GEOMETRY_UPDATE_TOLERANCE 1.e-6
+
 /**
  * @brief Check if the given cell fulfills the Delaunay condition.
  *
@@ -76,22 +82,58 @@
 /**
  * @brief Compute the cell with the given index.
  *
+ * If an old version of the cell is given, we first intersect with the
+ * neighbours of that cell. Since generators usually only move a small fraction
+ * of a cell between two grid constructions, the resulting cell will be very
+ * close to the final cell, and most other generators will be rejected by the
+ * cheap distance check in NewVoronoiCellConstructor::intersect().
+ *
  * @param index Index of the cell to compute.
  * @param constructor NewVoronoiCellConstructor to use.
+ * @param max_radius_squared Variable to store the squared radius of the sphere
+ * that contains all generators that can affect the cell in (in m^2).
+ * @param old_cell Old version of the cell (can be a nullptr).
  * @return NewVoronoiCell.
  */
 NewVoronoiCell
 NewVoronoiGrid::compute_cell(uint_fast32_t index,
-                             NewVoronoiCellConstructor &constructor) const {
+                             NewVoronoiCellConstructor &constructor,
+                             double &max_radius_squared,
+                             const NewVoronoiCell *old_cell) const {
 
   constructor.setup(index, _real_generator_positions, _real_voronoi_box,
                     _real_rescaled_positions, _real_rescaled_box, true);
 
+  // neighbours of the old cell that have already been added
+  std::vector< uint_fast32_t > old_neighbours;
+  if (old_cell != nullptr) {
+    const std::vector< VoronoiFace > &faces = old_cell->get_faces();
+    old_neighbours.reserve(faces.size());
+    for (auto faceit = faces.begin(); faceit != faces.end(); ++faceit) {
+      const uint_fast32_t j = faceit->get_neighbour();
+      if (j < NEWVORONOICELL_MAX_INDEX && j != index) {
+        old_neighbours.push_back(j);
+      }
+    }
+    std::sort(old_neighbours.begin(), old_neighbours.end());
+    old_neighbours.erase(
+        std::unique(old_neighbours.begin(), old_neighbours.end()),
+        old_neighbours.end());
+    for (auto ngbit = old_neighbours.begin(); ngbit != old_neighbours.end();
+         ++ngbit) {
+      constructor.intersect(*ngbit, _real_rescaled_box,
+                            _real_rescaled_positions, _real_voronoi_box,
+                            _real_generator_positions);
+      newvoronoigrid_check_cell(constructor);
+    }
+  }
+
   auto it = _point_locations.get_neighbours(index);
   auto ngbs = it.get_neighbours();
   for (auto ngbit = ngbs.begin(); ngbit != ngbs.end(); ++ngbit) {
     const uint_fast32_t j = *ngbit;
-    if (j != index) {
+    if (j != index && !std::binary_search(old_neighbours.begin(),
+                                          old_neighbours.end(), j)) {
       constructor.intersect(j, _real_rescaled_box, _real_rescaled_positions,
                             _real_voronoi_box, _real_generator_positions);
       newvoronoigrid_check_cell(constructor);
@@ -102,18 +144,212 @@ NewVoronoiGrid::compute_cell(uint_fast32_t index,
     ngbs = it.get_neighbours();
     for (auto ngbit = ngbs.begin(); ngbit != ngbs.end(); ++ngbit) {
       const uint_fast32_t j = *ngbit;
-      constructor.intersect(j, _real_rescaled_box, _real_rescaled_positions,
-                            _real_voronoi_box, _real_generator_positions);
-      newvoronoigrid_check_cell(constructor);
+      if (!std::binary_search(old_neighbours.begin(), old_neighbours.end(),
+                              j)) {
+        constructor.intersect(j, _real_rescaled_box, _real_rescaled_positions,
+                              _real_voronoi_box, _real_generator_positions);
+        newvoronoigrid_check_cell(constructor);
+      }
     }
   }
 
+  max_radius_squared = constructor.get_max_radius_squared();
+
   NewVoronoiCell cell =
       constructor.get_cell(_real_voronoi_box, _real_generator_positions);
 
   return cell;
 }
 
+/**
+ * @brief Check if the cell with the given index needs to be recomputed after
+ * the generators have moved.
+ *
+ * This is the case if the generator of the cell moved, if one of its
+ * neighbours moved, or if a generator that moved is now inside the sphere that
+ * contains all generators that can affect the cell.
+ *
+ * @param index Index of a cell.
+ * @return True if the cell needs to be recomputed.
+ */
+bool NewVoronoiGrid::needs_update(uint_fast32_t index) const {
+
+  if (_moved[index]) {
+    return true;
+  }
+
+  const std::vector< VoronoiFace > &faces = _cells[index].get_faces();
+  for (auto faceit = faces.begin(); faceit != faces.end(); ++faceit) {
+    const uint_fast32_t j = faceit->get_neighbour();
+    if (j < NEWVORONOICELL_MAX_INDEX && _moved[j]) {
+      return true;
+    }
+  }
+
+  const double max_radius_squared = _max_radii_squared[index];
+  const CoordinateVector<> &position = _real_generator_positions[index];
+  auto it = _point_locations.get_neighbours(index);
+  do {
+    const std::vector< uint_least32_t > &ngbs = it.get_neighbours();
+    for (auto ngbit = ngbs.begin(); ngbit != ngbs.end(); ++ngbit) {
+      const uint_fast32_t j = *ngbit;
+      if (_moved[j] &&
+          (_real_generator_positions[j] - position).norm2() <=
+              max_radius_squared) {
+        return true;
+      }
+    }
+  } while (it.increase_range() && it.get_max_radius2() <= max_radius_squared);
+
+  return false;
+}
+
+/**
+ * @brief Try to update the cell with the given index after the generators have
+ * moved, without changing its topology.
+ *
+ * The topology of the cell is set by the Delaunay tetrahedra that have the cell
+ * generator as a vertex. These tetrahedra are still the correct Delaunay
+ * tetrahedra after the generators have moved if they are all still positively
+ * oriented, and if no other generator (or mirror copy of the cell generator)
+ * lies inside or on their circumsphere. Generators outside the new security
+ * radius of the cell (twice the largest distance between the generator and a
+ * cell vertex) cannot lie inside any circumsphere, so that we only need to
+ * test the generators within that radius. We use the same exact geometric
+ * tests as the NewVoronoiCellConstructor, so that the topology is exactly the
+ * same as for a cell that is constructed from scratch. The more expensive
+ * exact circumsphere test is only done for generators that are close to a
+ * circumsphere.
+ *
+ * If the test passes, only the geometry of the cell (volume, centroid and
+ * faces) is recomputed using the new generator positions.
+ *
+ * @param index Index of a cell.
+ * @param vertices Buffer used to store the vertices of the cell (in m).
+ * @return True if the cell kept its topology and its geometry was updated,
+ * false if the cell needs to be reconstructed.
+ */
+bool NewVoronoiGrid::update_cell_geometry(
+    uint_fast32_t index, std::vector< CoordinateVector<> > &vertices) {
+
+  NewVoronoiCell &cell = _cells[index];
+  const uint_fast32_t number_of_tetrahedra = cell.get_number_of_tetrahedra();
+  if (number_of_tetrahedra == 0) {
+    return false;
+  }
+
+  // check that all tetrahedra are still positively oriented
+  const CoordinateVector<> &rescaled_generator =
+      _real_rescaled_positions[index];
+  for (uint_fast32_t i = 0; i < number_of_tetrahedra; ++i) {
+    CoordinateVector<> pr[4];
+    for (uint_fast8_t j = 0; j < 4; ++j) {
+      const uint_fast32_t vertex = cell.get_tetrahedron_vertex(i, j);
+      if (vertex < NEWVORONOICELL_MAX_INDEX) {
+        pr[j] = _real_rescaled_positions[vertex];
+      } else if (vertex >= NEWVORONOICELL_BOX_LEFT) {
+        pr[j] = _real_rescaled_box.get_position(vertex, rescaled_generator);
+      } else {
+        // the cell is connected to the large all-encompassing tetrahedron
+        return false;
+      }
+    }
+    if (ExactGeometricTests::orient3d_adaptive(pr[0], pr[1], pr[2], pr[3]) >=
+        0) {
+      return false;
+    }
+  }
+
+  // compute the new cell vertices and the new security radius
+  cell.compute_vertices(index, _real_voronoi_box, _real_generator_positions,
+                        vertices);
+  const CoordinateVector<> &generator = _real_generator_positions[index];
+  double max_radius_squared = 0.;
+  for (uint_fast32_t i = 0; i < number_of_tetrahedra; ++i) {
+    max_radius_squared =
+        std::max(max_radius_squared, (vertices[i + 1] - generator).norm2());
+  }
+  max_radius_squared *= 4.;
+
+  // check that the given point does not lie inside or on the circumsphere of
+  // any tetrahedron it is not a vertex of
+  // the squared radius of a circumsphere is computed as the squared distance
+  // between its midpoint and the cell generator, which is a vertex of every
+  // tetrahedron; points that are clearly outside a circumsphere are rejected
+  // without doing the exact test
+  const auto is_outside_circumspheres = [this, &cell, &vertices, &generator,
+                                         &rescaled_generator,
+                                         number_of_tetrahedra](
+                                            const uint_fast32_t point,
+                                            const CoordinateVector<> &position,
+                                            const CoordinateVector<>
+                                                &rescaled_position) {
+    for (uint_fast32_t i = 0; i < number_of_tetrahedra; ++i) {
+      const uint_fast32_t v[4] = {cell.get_tetrahedron_vertex(i, 0),
+                                  cell.get_tetrahedron_vertex(i, 1),
+                                  cell.get_tetrahedron_vertex(i, 2),
+                                  cell.get_tetrahedron_vertex(i, 3)};
+      if (v[0] == point || v[1] == point || v[2] == point || v[3] == point) {
+        continue;
+      }
+      const CoordinateVector<> &midpoint = vertices[i + 1];
+      const double r2 = (midpoint - generator).norm2();
+      if ((position - midpoint).norm2() >
+          (1. + NEWVORONOIGRID_GEOMETRY_UPDATE_TOLERANCE) * r2) {
+        continue;
+      }
+      CoordinateVector<> pr[4];
+      for (uint_fast8_t j = 0; j < 4; ++j) {
+        if (v[j] < NEWVORONOICELL_MAX_INDEX) {
+          pr[j] = _real_rescaled_positions[v[j]];
+        } else {
+          pr[j] = _real_rescaled_box.get_position(v[j], rescaled_generator);
+        }
+      }
+      if (ExactGeometricTests::insphere_adaptive(pr[0], pr[1], pr[2], pr[3],
+                                                 rescaled_position) <= 0) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  // mirror copies of the generator in the walls of the simulation box
+  for (uint_fast8_t i = 0; i < 6; ++i) {
+    const uint_fast32_t wall = NEWVORONOICELL_BOX_LEFT + i;
+    if (!is_outside_circumspheres(
+            wall, _real_voronoi_box.get_position(wall, generator),
+            _real_rescaled_box.get_position(wall, rescaled_generator))) {
+      return false;
+    }
+  }
+
+  // other generators within the security radius
+  auto it = _point_locations.get_neighbours(index);
+  do {
+    const std::vector< uint_least32_t > &ngbs = it.get_neighbours();
+    for (auto ngbit = ngbs.begin(); ngbit != ngbs.end(); ++ngbit) {
+      const uint_fast32_t j = *ngbit;
+      if (j != index &&
+          (_real_generator_positions[j] - generator).norm2() <=
+              (1. + NEWVORONOIGRID_GEOMETRY_UPDATE_TOLERANCE) *
+                  max_radius_squared &&
+          !is_outside_circumspheres(j, _real_generator_positions[j],
+                                    _real_rescaled_positions[j])) {
+        return false;
+      }
+    }
+  } while (it.increase_range() &&
+           it.get_max_radius2() <=
+               (1. + NEWVORONOIGRID_GEOMETRY_UPDATE_TOLERANCE) *
+                   max_radius_squared);
+
+  // the topology is still valid: update the geometry
+  cell.compute_geometry(vertices);
+  _max_radii_squared[index] = max_radius_squared;
+  return true;
+}
+
 /**
  * @brief Constructor.
  *
@@ -152,6 +388,8 @@ NewVoronoiGrid::NewVoronoiGrid(
   // (notice that the first range is closed, while the other range is half open)
   max_anchor -= min_anchor;
   max_anchor *= (1. + DBL_EPSILON);
+  _rescaling_anchor = min_anchor;
+  _rescaling_sides = max_anchor;
 
   const double box_bottom_anchor_x =
       1. + (box.get_anchor().x() - min_anchor.x()) / max_anchor.x();
@@ -182,10 +420,7 @@ NewVoronoiGrid::NewVoronoiGrid(
   const size_t psize = positions.size();
   _real_rescaled_positions.resize(psize);
   for (size_t i = 0; i < psize; ++i) {
-    const double x = 1. + (positions[i].x() - min_anchor.x()) / max_anchor.x();
-    const double y = 1. + (positions[i].y() - min_anchor.y()) / max_anchor.y();
-    const double z = 1. + (positions[i].z() - min_anchor.z()) / max_anchor.z();
-    _real_rescaled_positions[i] = CoordinateVector<>(x, y, z);
+    _real_rescaled_positions[i] = get_rescaled_position(positions[i]);
   }
 }
 
@@ -204,6 +439,8 @@ void NewVoronoiGrid::compute_grid(int_fast32_t worksize) {
 
   const size_t psize = _real_generator_positions.size();
   _cells.resize(psize);
+  _max_radii_squared.resize(psize);
+  _changed.assign(psize, true);
 
   WorkDistributor< NewVoronoiGridConstructionJobMarket,
                    NewVoronoiGridConstructionJob >
@@ -214,6 +451,57 @@ void NewVoronoiGrid::compute_grid(int_fast32_t worksize) {
   newvoronoigrid_check_volume();
 }
 
+/**
+ * @brief Does this implementation support incremental updates of the grid
+ * after the generators have moved?
+ *
+ * @return True.
+ */
+bool NewVoronoiGrid::has_incremental_update() const { return true; }
+
+/**
+ * @brief Update the Voronoi grid after the generators have moved.
+ *
+ * The generators are relocated in the existing PointLocations object, and only
+ * the cells that are affected by the movement are updated (see
+ * needs_update()). Cells that keep their topology only get a geometry update
+ * (see update_cell_geometry()); the other cells are reconstructed, starting
+ * from the neighbours of the old cell. The result is the same as for a grid
+ * that is constructed from scratch.
+ *
+ * @param worksize Number of shared memory threads to use during the grid
+ * update.
+ */
+void NewVoronoiGrid::update_grid(int_fast32_t worksize) {
+
+  const size_t psize = _real_generator_positions.size();
+  cmac_assert(psize == _cells.size());
+
+  _moved.resize(psize);
+  _changed.assign(psize, false);
+  bool any_moved = false;
+  for (size_t i = 0; i < psize; ++i) {
+    const CoordinateVector<> new_position =
+        get_rescaled_position(_real_generator_positions[i]);
+    _moved[i] = (new_position != _real_rescaled_positions[i]);
+    any_moved |= _moved[i];
+    _real_rescaled_positions[i] = new_position;
+  }
+  if (!any_moved) {
+    return;
+  }
+
+  _point_locations.update_positions();
+
+  WorkDistributor< NewVoronoiGridConstructionJobMarket,
+                   NewVoronoiGridConstructionJob >
+      workers(worksize);
+  NewVoronoiGridConstructionJobMarket jobs(*this, 100, true);
+  workers.do_in_parallel(jobs);
+
+  newvoronoigrid_check_volume();
+}
+
 /**
  * @brief Get the volume of the cell with the given index.
  *
@@ -294,6 +582,54 @@ NewVoronoiGrid::get_geometrical_faces(uint_fast32_t index) const {
   return geometrical_faces;
 }
 
+/**
+ * @brief Did the cell with the given index change during the last grid
+ * construction or update?
+ *
+ * @param index Index of a cell in the grid.
+ * @return True if the cell was constructed or updated.
+ */
+bool NewVoronoiGrid::has_changed(uint_fast32_t index) const {
+  return _changed[index];
+}
+
+/**
+ * @brief Get the number of faces of the cell with the given index.
+ *
+ * @param index Index of a cell in the grid.
+ * @return Number of faces of that cell.
+ */
+uint_fast32_t NewVoronoiGrid::get_number_of_faces(uint_fast32_t index) const {
+  return _cells[index].get_faces().size();
+}
+
+/**
+ * @brief Get the index of the neighbour that generated the given face of the
+ * cell with the given index.
+ *
+ * @param index Index of a cell in the grid.
+ * @param face Index of a face of that cell.
+ * @return Index of the neighbouring cell (or wall) on the other side of the
+ * face.
+ */
+uint_fast32_t NewVoronoiGrid::get_face_neighbour(uint_fast32_t index,
+                                                 uint_fast32_t face) const {
+  return _cells[index].get_faces()[face].get_neighbour();
+}
+
+/**
+ * @brief Get the midpoint of the given face of the cell with the given index.
+ *
+ * @param index Index of a cell in the grid.
+ * @param face Index of a face of that cell.
+ * @return Midpoint of the face (in m).
+ */
+CoordinateVector<>
+NewVoronoiGrid::get_face_midpoint(uint_fast32_t index,
+                                  uint_fast32_t face) const {
+  return _cells[index].get_faces()[face].get_midpoint();
+}
+
 /**
  * @brief Get the index of the Voronoi cell that contains the given position.
  *
@@ -29,12 +29,12 @@
 #define NEWVORONOIGRID_HPP
 
 #include "Face.hpp"
-#include "Lock.hpp"
 #include "NewVoronoiBox.hpp"
 #include "NewVoronoiCell.hpp"
 #include "NewVoronoiCellConstructor.hpp"
 #include "PointLocations.hpp"
 #include "VoronoiGrid.hpp"
+#include "WorkStealingScheduler.hpp"
 
 #include <vector>
 
@@ -54,6 +54,14 @@ private:
   /*! @brief Real VoronoiBox (in m). */
   const NewVoronoiBox _real_voronoi_box;
 
+  /*! @brief Anchor of the range that is mapped to [1,2[ in the rescaled
+   *  representation (in m). */
+  CoordinateVector<> _rescaling_anchor;
+
+  /*! @brief Sides of the range that is mapped to [1,2[ in the rescaled
+   *  representation (in m). */
+  CoordinateVector<> _rescaling_sides;
+
   /*! @brief Real rescaled representation of the mesh generating positions (in
    *  the range [1,2[). */
   std::vector< CoordinateVector<> > _real_rescaled_positions;
@@ -65,11 +73,44 @@ private:
   /*! @brief Voronoi cells. */
   std::vector< NewVoronoiCell > _cells;
 
+  /*! @brief Squared radius of the sphere around each generator that contains
+   *  all generators that can affect its cell (in m^2). */
+  std::vector< double > _max_radii_squared;
+
+  /*! @brief Flags signalling which generators moved since the last grid
+   *  construction or update. */
+  std::vector< bool > _moved;
+
+  /*! @brief Flags signalling which cells changed during the last grid
+   *  construction or update (one element per cell, so that different threads
+   *  can safely set them). */
+  std::vector< uint_least8_t > _changed;
+
   /*! @brief PointLocations object used to speed up neighbour searching. */
   PointLocations _point_locations;
 
+  /**
+   * @brief Get the rescaled representation of the given position.
+   *
+   * @param position Position (in m).
+   * @return Rescaled position (in the range [1,2[).
+   */
+  inline CoordinateVector<>
+  get_rescaled_position(const CoordinateVector<> &position) const {
+    return CoordinateVector<>(
+        1. + (position.x() - _rescaling_anchor.x()) / _rescaling_sides.x(),
+        1. + (position.y() - _rescaling_anchor.y()) / _rescaling_sides.y(),
+        1. + (position.z() - _rescaling_anchor.z()) / _rescaling_sides.z());
+  }
+
   NewVoronoiCell compute_cell(uint_fast32_t index,
-                              NewVoronoiCellConstructor &constructor) const;
+                              NewVoronoiCellConstructor &constructor,
+                              double &max_radius_squared,
+                              const NewVoronoiCell *old_cell = nullptr) const;
+
+  bool needs_update(uint_fast32_t index) const;
+  bool update_cell_geometry(uint_fast32_t index,
+                            std::vector< CoordinateVector<> > &vertices);
 
   /**
    * @brief Job that constructs part of the Voronoi grid.
@@ -85,17 +126,28 @@ private:
     /*! @brief Index of the beyond last cell that this job will construct. */
     uint_fast32_t _last_index;
 
+    /*! @brief Only recompute the cells that are affected by generator
+     *  movement since the last construction or update? */
+    const bool _update;
+
     /*! @brief NewVoronoiCellConstructor object used by this thread. */
     NewVoronoiCellConstructor _constructor;
 
+    /*! @brief Buffer used to store the vertices of a cell during a geometry
+     *  update (in m). */
+    std::vector< CoordinateVector<> > _vertices;
+
   public:
     /**
      * @brief Constructor.
      *
      * @param grid Reference to the NewVoronoiGrid we are constructing.
+     * @param update Only recompute the cells that are affected by generator
+     * movement since the last construction or update?
      */
-    inline NewVoronoiGridConstructionJob(NewVoronoiGrid &grid)
-        : _grid(grid), _first_index(0), _last_index(0) {}
+    inline NewVoronoiGridConstructionJob(NewVoronoiGrid &grid,
+                                         const bool update)
+        : _grid(grid), _first_index(0), _last_index(0), _update(update) {}
 
     /**
      * @brief Update the cell range that will be constructed during the next run
@@ -121,10 +173,28 @@ private:
 
     /**
      * @brief Construct the Voronoi cell for each index in the job range.
+     *
+     * In update mode, only the cells that are affected by generator movement
+     * are updated. Cells that keep their topology only get a geometry update;
+     * the other cells are reconstructed, starting from the neighbours of the
+     * old cell.
      */
     inline void execute() {
       for (uint_fast32_t i = _first_index; i < _last_index; ++i) {
-        _grid._cells[i] = _grid.compute_cell(i, _constructor);
+        if (_update) {
+          if (_grid.needs_update(i)) {
+            _grid._changed[i] = true;
+            if (!_grid.update_cell_geometry(i, _vertices)) {
+              _grid._cells[i] =
+                  _grid.compute_cell(i, _constructor,
+                                     _grid._max_radii_squared[i],
+                                     &_grid._cells[i]);
+            }
+          }
+        } else {
+          _grid._cells[i] = _grid.compute_cell(i, _constructor,
+                                               _grid._max_radii_squared[i]);
+        }
       }
     }
 
@@ -147,25 +217,27 @@ private:
     /*! @brief Per thread NewVoronoiGridConstructionJob. */
     NewVoronoiGridConstructionJob *_jobs[MAX_NUM_THREADS];
 
-    /*! @brief Index of the first cell that still needs to be constructed. */
-    uint_fast32_t _current_index;
+    /*! @brief Only recompute the cells that are affected by generator
+     *  movement since the last construction or update? */
+    const bool _update;
 
-    /*! @brief Number of cells constructed by a single job. */
-    const uint_fast32_t _jobsize;
-
-    /*! @brief Lock used to ensure safe access to the internal index. */
-    Lock _lock;
+    /*! @brief Scheduler that distributes the cells over the threads. */
+    WorkStealingScheduler _scheduler;
 
   public:
     /**
      * @brief Constructor.
      *
      * @param grid NewVoronoiGrid we want to construct.
-     * @param jobsize Number of cell constructed by a single job.
+     * @param jobsize Number of cells constructed by the first job of every
+     * thread (later jobs adapt their size to the measured construction cost).
+     * @param update Only recompute the cells that are affected by generator
+     * movement since the last construction or update?
      */
     inline NewVoronoiGridConstructionJobMarket(NewVoronoiGrid &grid,
-                                               uint_fast32_t jobsize)
-        : _grid(grid), _current_index(0), _jobsize(jobsize) {
+                                               uint_fast32_t jobsize,
+                                               const bool update = false)
+        : _grid(grid), _update(update), _scheduler(1.e-3, jobsize) {
 
       for (uint_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
         _jobs[i] = nullptr;
@@ -190,8 +262,9 @@ private:
      * @param worksize Number of parallel threads that will be used.
      */
     inline void set_worksize(int_fast32_t worksize) {
+      _scheduler.reset(0, _grid._cells.size(), worksize);
       for (int_fast32_t i = 0; i < worksize; ++i) {
-        _jobs[i] = new NewVoronoiGridConstructionJob(_grid);
+        _jobs[i] = new NewVoronoiGridConstructionJob(_grid, _update);
       }
     }
 
@@ -203,19 +276,8 @@ private:
      * NewVoronoiGridConstructionJob.
      */
     inline NewVoronoiGridConstructionJob *get_job(int_fast32_t thread_id) {
-      const uint_fast32_t cellsize = _grid._cells.size();
-      if (_current_index == cellsize) {
-        return nullptr;
-      }
-      uint_fast32_t first_index;
-      uint_fast32_t jobsize;
-      _lock.lock();
-      first_index = _current_index;
-      jobsize = std::min(_jobsize, cellsize - _current_index);
-      _current_index += jobsize;
-      _lock.unlock();
-      if (first_index < cellsize) {
-        const uint_fast32_t last_index = first_index + jobsize;
+      uint_fast64_t first_index, last_index;
+      if (_scheduler.get_chunk(thread_id, first_index, last_index)) {
         _jobs[thread_id]->update_indices(first_index, last_index);
         return _jobs[thread_id];
       } else {
@@ -235,6 +297,8 @@ public:
   /// grid computation methods
 
   virtual void compute_grid(int_fast32_t worksize = -1);
+  virtual bool has_incremental_update() const;
+  virtual void update_grid(int_fast32_t worksize = -1);
 
   /// cell/grid property access
 
@@ -243,6 +307,12 @@ public:
   virtual CoordinateVector<> get_wall_normal(int_fast32_t wallindex) const;
   virtual std::vector< VoronoiFace > get_faces(uint_fast32_t index) const;
   virtual std::vector< Face > get_geometrical_faces(uint_fast32_t index) const;
+  virtual bool has_changed(uint_fast32_t index) const;
+  virtual uint_fast32_t get_number_of_faces(uint_fast32_t index) const;
+  virtual uint_fast32_t get_face_neighbour(uint_fast32_t index,
+                                           uint_fast32_t face) const;
+  virtual CoordinateVector<> get_face_midpoint(uint_fast32_t index,
+                                               uint_fast32_t face) const;
 
   /// grid navigation
 
@@ -30,6 +30,8 @@
 #include "CoordinateVector.hpp"
 #include "NewVoronoiVariables.hpp"
 
+#include <vector>
+
 /**
  * @brief Delaunay tetrahedron used in the NewVoronoiCellConstructor incremental
  * construction algorithm.
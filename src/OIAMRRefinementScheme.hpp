@@ -87,7 +87,7 @@ public:
   virtual bool refine(uint_fast8_t level, DensityGrid::iterator &cell) const {
 
     const double volume = cell.get_volume();
-    const IonizationVariables &ioniziation_variables =
+    const IonizationVariablesReference ioniziation_variables =
         cell.get_ionization_variables();
     const double On_frac = ioniziation_variables.get_ionic_fraction(ION_O_n);
     const double Op1_frac = ioniziation_variables.get_ionic_fraction(ION_O_p1);
@@ -92,7 +92,7 @@ public:
     // we assume an ionizing cross section of 1.e-18 cm^2
     const double xsecH = 1.e-22;
 
-    const IonizationVariables &ioniziation_variables =
+    const IonizationVariablesReference ioniziation_variables =
         cell.get_ionization_variables();
 
     const double opacity = ioniziation_variables.get_number_density() *
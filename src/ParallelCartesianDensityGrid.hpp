@@ -30,11 +30,22 @@
 #define PARALLELCARTESIANDENSITYGRID_HPP
 
 #include "Box.hpp"
+#include "MPICommunicator.hpp"
 #include "ParallelCartesianDensitySubGrid.hpp"
+#include "PhotonMessage.hpp"
+#include "PhotonPool.hpp"
+#include "PhotonSource.hpp"
+#include "RandomGenerator.hpp"
 #include "Utilities.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
+/*! @brief Maximum number of photons in a single PhotonBatch that is exchanged
+ *  between processes. */
+#define PARALLELCARTESIANDENSITYGRID_BATCH_SIZE 10000
+
 /**
  * @brief DensityGrid (implementation?) containing a distributed Cartesian grid.
  */
@@ -59,21 +70,17 @@ private:
    *  grid. */
   std::vector< DensitySubGrid * > _subgrids;
 
-public:
   /**
-   * @brief Constructor.
+   * @brief Set up the block layout of the grid.
    *
    * @param box Box containing the entire grid.
    * @param numcell Number of cells in each dimension.
    * @param numdomain Total number of subgrids.
-   * @param domain Part of the domain stored on the local process.
+   * @return Number of cells in a single block.
    */
-  ParallelCartesianDensityGrid(Box<> box,
-                               CoordinateVector< int_fast32_t > numcell,
-                               uint_fast32_t numdomain,
-                               std::pair< uint_fast32_t, uint_fast32_t > domain)
-      : _box_anchor(box.get_anchor()), _domain(domain),
-        _numcell(numcell.x() * numcell.y() * numcell.z()) {
+  inline CoordinateVector< int_fast32_t >
+  set_block_layout(Box<> box, CoordinateVector< int_fast32_t > numcell,
+                   uint_fast32_t numdomain) {
 
     // get the number of cells in a single block
     CoordinateVector< int_fast32_t > block_resolution =
@@ -90,9 +97,28 @@ public:
     _block_sides[1] /= _num_blocks[1];
     _block_sides[2] /= _num_blocks[2];
 
+    return block_resolution;
+  }
+
+  /**
+   * @brief Create the blocks and set up the neighbour relations between them.
+   *
+   * @param box Box containing the entire grid.
+   * @param block_resolution Number of cells in a single block.
+   * @param world_size Total number of MPI processes across which the blocks
+   * are distributed (0 if the home processes of the blocks outside the local
+   * domain are unknown).
+   */
+  inline void create_blocks(Box<> box,
+                            CoordinateVector< int_fast32_t > block_resolution,
+                            int_fast32_t world_size) {
+
+    const int_fast32_t numblock =
+        _num_blocks.x() * _num_blocks.y() * _num_blocks.z();
+
     // create the blocks
     // allocate memory
-    _subgrids.reserve(_num_blocks.x() * _num_blocks.y() * _num_blocks.z());
+    _subgrids.reserve(numblock);
     for (int_fast32_t ix = 0; ix < _num_blocks.x(); ++ix) {
       for (int_fast32_t iy = 0; iy < _num_blocks.y(); ++iy) {
         for (int_fast32_t iz = 0; iz < _num_blocks.z(); ++iz) {
@@ -108,9 +134,22 @@ public:
             _subgrids.push_back(new ParallelCartesianDensitySubGrid(
                 blockbox, block_resolution));
           } else {
-            _subgrids.push_back(new GhostDensitySubGrid(block_resolution.x() *
-                                                        block_resolution.y() *
-                                                        block_resolution.z()));
+            GhostDensitySubGrid *ghost = new GhostDensitySubGrid(
+                block_resolution.x() * block_resolution.y() *
+                block_resolution.z());
+            // find the process that holds the block (this is the process
+            // whose block of indices, as given by
+            // MPICommunicator::distribute_block, contains this index)
+            for (int_fast32_t rank = 0; rank < world_size; ++rank) {
+              const std::pair< size_t, size_t > rank_domain =
+                  MPICommunicator::distribute_block(rank, world_size, 0,
+                                                    numblock);
+              if (index >= static_cast< int_fast32_t >(rank_domain.first) &&
+                  index < static_cast< int_fast32_t >(rank_domain.second)) {
+                ghost->set_home_process(rank);
+              }
+            }
+            _subgrids.push_back(ghost);
           }
         }
       }
@@ -124,7 +163,7 @@ public:
                                iy * _num_blocks.z() + iz;
           if (index >= _domain.first && index < _domain.second) {
             ParallelCartesianDensitySubGrid *block =
-                reinterpret_cast< ParallelCartesianDensitySubGrid * >(
+                static_cast< ParallelCartesianDensitySubGrid * >(
                     _subgrids[index]);
             block->set_index(index);
             if (ix > 0) {
@@ -167,6 +206,90 @@ public:
     }
   }
 
+  /**
+   * @brief Add the given Photon to the outbox for the home process of the non
+   * local sub region with the given index.
+   *
+   * The Photon is copied into the outbox and its memory is freed.
+   *
+   * @param outbox PhotonPool containing the outgoing photons per process.
+   * @param index Index of a non local sub region.
+   * @param photon Photon to send.
+   * @param optical_depth Optical depth the photon still needs to travel.
+   */
+  inline void send_photon(PhotonPool &outbox, int_fast32_t index,
+                          Photon *photon, double optical_depth) const {
+    const GhostDensitySubGrid *ghost =
+        static_cast< const GhostDensitySubGrid * >(_subgrids[index]);
+    if (ghost->get_home_process() < 0) {
+      cmac_error("Photon enters a sub region with unknown home process!");
+    }
+    outbox.add_photon(ghost->get_home_process(), *photon, index,
+                      optical_depth);
+    delete photon;
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param box Box containing the entire grid.
+   * @param numcell Number of cells in each dimension.
+   * @param numdomain Total number of subgrids.
+   * @param domain Part of the domain stored on the local process.
+   */
+  ParallelCartesianDensityGrid(Box<> box,
+                               CoordinateVector< int_fast32_t > numcell,
+                               uint_fast32_t numdomain,
+                               std::pair< uint_fast32_t, uint_fast32_t > domain)
+      : _box_anchor(box.get_anchor()), _domain(domain),
+        _numcell(numcell.x() * numcell.y() * numcell.z()) {
+
+    CoordinateVector< int_fast32_t > block_resolution =
+        set_block_layout(box, numcell, numdomain);
+    create_blocks(box, block_resolution, 0);
+  }
+
+  /**
+   * @brief Constructor for a grid that is distributed across all MPI
+   * processes.
+   *
+   * Every process holds a contiguous range of subgrids, as given by
+   * MPICommunicator::distribute_block. Subgrids owned by other processes are
+   * represented by a GhostDensitySubGrid that knows the rank of its home
+   * process, so that the memory needed per process scales as one over the
+   * number of processes.
+   *
+   * @param box Box containing the entire grid.
+   * @param numcell Number of cells in each dimension.
+   * @param numdomain Total number of subgrids.
+   * @param comm MPICommunicator used to distribute the subgrids (can be a
+   * nullptr, in which case all subgrids are stored on the local process).
+   */
+  ParallelCartesianDensityGrid(Box<> box,
+                               CoordinateVector< int_fast32_t > numcell,
+                               uint_fast32_t numdomain,
+                               const MPICommunicator *comm)
+      : _box_anchor(box.get_anchor()),
+        _numcell(numcell.x() * numcell.y() * numcell.z()) {
+
+    CoordinateVector< int_fast32_t > block_resolution =
+        set_block_layout(box, numcell, numdomain);
+    const int_fast32_t numblock =
+        _num_blocks.x() * _num_blocks.y() * _num_blocks.z();
+    if (comm) {
+      const std::pair< size_t, size_t > domain =
+          comm->distribute_block(0, numblock);
+      _domain.first = domain.first;
+      _domain.second = domain.second;
+      create_blocks(box, block_resolution, comm->get_size());
+    } else {
+      _domain.first = 0;
+      _domain.second = numblock;
+      create_blocks(box, block_resolution, 1);
+    }
+  }
+
   /**
    * @brief Destructor.
    *
@@ -185,24 +308,48 @@ public:
    */
   uint_fast32_t get_number_of_cells() const { return _numcell; }
 
+  /**
+   * @brief Get the index of the sub region that contains the given position.
+   *
+   * @param position Position (in m).
+   * @return Index of the sub region that contains the position.
+   */
+  int_fast32_t get_block_index(const CoordinateVector<> position) const {
+    CoordinateVector< int_fast32_t > block_index;
+    block_index[0] = (position.x() - _box_anchor.x()) / _block_sides.x();
+    block_index[1] = (position.y() - _box_anchor.y()) / _block_sides.y();
+    block_index[2] = (position.z() - _box_anchor.z()) / _block_sides.z();
+    // positions on the upper walls of the box belong to the last block
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+      block_index[i] = std::max(block_index[i], int_fast32_t(0));
+      block_index[i] =
+          std::min(block_index[i], int_fast32_t(_num_blocks[i] - 1));
+    }
+    return block_index.x() * _num_blocks.y() * _num_blocks.z() +
+           block_index.y() * _num_blocks.z() + block_index.z();
+  }
+
+  /**
+   * @brief Check if the sub region with the given index is stored on the local
+   * process.
+   *
+   * @param index Index of a sub region.
+   * @return True if the sub region is part of the local domain.
+   */
+  inline bool is_local(int_fast32_t index) const {
+    return index >= _domain.first && index < _domain.second;
+  }
+
   /**
    * @brief Add a Photon to the photon pool of the sub region that contains it.
    *
    * @param photon Photon to add.
+   * @param optical_depth Optical depth the photon should travel in total
+   * (dimensionless).
    */
-  void add_photon(Photon *photon) {
-    // find out in which sub region the photon resides
-    CoordinateVector< int_fast32_t > block_index;
-    block_index[0] =
-        (photon->get_position().x() - _box_anchor.x()) / _block_sides.x();
-    block_index[1] =
-        (photon->get_position().y() - _box_anchor.y()) / _block_sides.y();
-    block_index[2] =
-        (photon->get_position().z() - _box_anchor.z()) / _block_sides.z();
-    int_fast32_t long_index =
-        block_index.x() * _num_blocks.y() * _num_blocks.z() +
-        block_index.y() * _num_blocks.z() + block_index.z();
-    _subgrids[long_index]->add_photon(photon);
+  void add_photon(Photon *photon, double optical_depth) {
+    _subgrids[get_block_index(photon->get_position())]->add_photon(
+        photon, optical_depth);
   }
 
   /**
@@ -211,9 +358,202 @@ public:
    *
    * @param index Index of a sub region.
    * @param photon Photon to add.
+   * @param optical_depth Optical depth the photon should travel in total
+   * (dimensionless).
+   */
+  void add_photon(int_fast32_t index, Photon *photon, double optical_depth) {
+    _subgrids[index]->add_photon(photon, optical_depth);
+  }
+
+  /**
+   * @brief Propagate all photons in the photon pools of the local sub regions
+   * until they are absorbed or leave the simulation box.
+   *
+   * Photons that move into a sub region owned by another process are collected
+   * per destination process in a PhotonPool and are sent to that process as
+   * PhotonMessages through a PhotonMessageBox. Every exchange round ends with a
+   * global reduction of the number of photons that were received, which also
+   * acts as a barrier between rounds. We stop when no process received any
+   * photons during the last round.
+   *
+   * Photons in the pools of sub regions owned by other processes (e.g. photons
+   * emitted by a source in a remote sub region) are sent to the home process
+   * of that sub region during the first round.
+   *
+   * If a PhotonSource is given, absorbed photons are offered to
+   * PhotonSource::reemit() using the ionization variables of the cell in which
+   * they were absorbed. Re-emitted photons get a new random optical depth and
+   * continue their journey from the absorption point. Photons that are not
+   * re-emitted are counted as absorbed.
+   *
+   * This method must be called by all processes at the same time, and the
+   * propagation on a single process is done by a single thread.
+   *
+   * @param comm MPICommunicator used to exchange photons between processes
+   * (can be a nullptr if the entire grid is stored on the local process).
+   * @param num_absorbed Variable that is incremented with the number of
+   * photons that were absorbed in the local sub regions.
+   * @param num_escaped Variable that is incremented with the number of photons
+   * that left the simulation box from a local sub region.
+   * @param totweight Variable that is incremented with the total weight of all
+   * photons that were absorbed or escaped from the local sub regions.
+   * @param typecount Total weights per photon type of all photons that were
+   * absorbed or escaped from the local sub regions (incremented).
+   * @param photon_source PhotonSource used to re-emit absorbed photons (can be
+   * a nullptr, in which case photons are not re-emitted).
+   * @param random_generator RandomGenerator used for the re-emission (only
+   * used if a PhotonSource is given).
+   */
+  void propagate_photons(const MPICommunicator *comm,
+                         uint_fast64_t &num_absorbed,
+                         uint_fast64_t &num_escaped, double &totweight,
+                         double typecount[PHOTONTYPE_NUMBER],
+                         const PhotonSource *photon_source = nullptr,
+                         RandomGenerator *random_generator = nullptr) {
+
+    const int_fast32_t world_size = comm ? comm->get_size() : 1;
+    PhotonPool outbox(world_size, PARALLELCARTESIANDENSITYGRID_BATCH_SIZE);
+    PhotonPool inbox(1, PARALLELCARTESIANDENSITYGRID_BATCH_SIZE);
+
+    // move photons that were added to a non local sub region to the outbox
+    for (int_fast32_t index = 0; index < static_cast< int_fast32_t >(
+                                             _subgrids.size());
+         ++index) {
+      if (!is_local(index)) {
+        DensitySubGrid &ghost = *_subgrids[index];
+        while (ghost.photon_size() > 0) {
+          double optical_depth;
+          Photon *photon = ghost.get_photon(optical_depth);
+          send_photon(outbox, index, photon, optical_depth);
+        }
+      }
+    }
+
+    uint_fast64_t num_active = 1;
+    while (num_active > 0) {
+
+      // propagate all photons in the local pools, until every photon was
+      // either absorbed, left the box, or left the local domain
+      bool work_left = true;
+      while (work_left) {
+        work_left = false;
+        for (int_fast32_t index = _domain.first; index < _domain.second;
+             ++index) {
+          ParallelCartesianDensitySubGrid &subgrid =
+              static_cast< ParallelCartesianDensitySubGrid & >(
+                  *_subgrids[index]);
+          while (subgrid.photon_size() > 0) {
+            double optical_depth;
+            Photon *photon = subgrid.get_photon(optical_depth);
+            int_fast32_t next_index = subgrid.interact(*photon, optical_depth);
+            // the photon was absorbed within this sub region, so it can only
+            // be re-emitted within this sub region
+            while (photon_source != nullptr && optical_depth <= 0. &&
+                   photon_source->reemit(
+                       *photon,
+                       subgrid.get_ionization_variables(
+                           subgrid.get_cell_index(photon->get_position())),
+                       *random_generator)) {
+              optical_depth =
+                  -std::log(random_generator->get_uniform_random_double());
+              next_index = subgrid.interact(*photon, optical_depth);
+            }
+            if (optical_depth <= 0. || next_index < 0) {
+              if (optical_depth <= 0.) {
+                ++num_absorbed;
+              } else {
+                ++num_escaped;
+              }
+              totweight += photon->get_weight();
+              typecount[photon->get_type()] += photon->get_weight();
+              delete photon;
+            } else if (is_local(next_index)) {
+              _subgrids[next_index]->add_photon(photon, optical_depth);
+              work_left = true;
+            } else {
+              send_photon(outbox, next_index, photon, optical_depth);
+            }
+          }
+        }
+      }
+
+      num_active = 0;
+      if (world_size > 1) {
+        const int_fast32_t rank = comm->get_rank();
+        PhotonMessageBox message_box(world_size, inbox);
+
+        // send the outgoing photons
+        for (int_fast32_t i = 0; i < world_size; ++i) {
+          PhotonBatch *batch = outbox.get_batch(i);
+          while (batch != nullptr) {
+            if (i == rank) {
+              cmac_error("Local photon ended up in the outbox!");
+            }
+            comm->send_message(i, new PhotonMessage(*batch), message_box);
+            delete batch;
+            batch = outbox.get_batch(i);
+          }
+        }
+
+        // tell the other processes we are done sending, and wait until all
+        // processes are done
+        for (int_fast32_t i = 0; i < world_size; ++i) {
+          if (i != rank) {
+            comm->send_semi_ready(i, message_box);
+          }
+        }
+        while (!message_box.is_ready()) {
+          comm->check_for_message(message_box);
+          message_box.check_statuses();
+          if (message_box.is_semi_ready() &&
+              !message_box.has_notified_ready()) {
+            for (int_fast32_t i = 0; i < world_size; ++i) {
+              if (i != rank) {
+                comm->send_ready(i, message_box);
+              }
+            }
+            message_box.set_notified_ready();
+          }
+        }
+
+        // add the received photons to the local pools
+        PhotonBatch *batch = inbox.get_batch(0);
+        while (batch != nullptr) {
+          for (auto it = batch->begin(); it != batch->end(); ++it) {
+            const int_fast32_t index = it.get_new_index();
+            if (!is_local(index)) {
+              cmac_error("Received a photon for a non local sub region!");
+            }
+            _subgrids[index]->add_photon(new Photon(it.get_photon()),
+                                         it.get_optical_depth());
+          }
+          delete batch;
+          batch = inbox.get_batch(0);
+        }
+
+        num_active = message_box.get_number_of_received_photons();
+        comm->reduce< MPI_SUM_OF_ALL_PROCESSES >(num_active);
+      }
+    }
+  }
+
+  /**
+   * @brief Propagate all photons in the photon pools of the local sub regions
+   * until they are absorbed or leave the simulation box, without re-emission.
+   *
+   * @param comm MPICommunicator used to exchange photons between processes
+   * (can be a nullptr if the entire grid is stored on the local process).
+   * @param num_absorbed Variable that is incremented with the number of
+   * photons that were absorbed in the local sub regions.
+   * @param num_escaped Variable that is incremented with the number of photons
+   * that left the simulation box from a local sub region.
    */
-  void add_photon(int_fast32_t index, Photon *photon) {
-    _subgrids[index]->add_photon(photon);
+  void propagate_photons(const MPICommunicator *comm,
+                         uint_fast64_t &num_absorbed,
+                         uint_fast64_t &num_escaped) {
+    double totweight = 0.;
+    double typecount[PHOTONTYPE_NUMBER] = {0};
+    propagate_photons(comm, num_absorbed, num_escaped, totweight, typecount);
   }
 
   /**
@@ -241,10 +581,16 @@ public:
     /**
      * @brief Dereference operator.
      *
+     * The iterator only loops over local sub regions, which are always
+     * ParallelCartesianDensitySubGrids.
+     *
      * @return Reference to the sub region the iterator is currently pointing
      * to.
      */
-    DensitySubGrid &operator*() { return *_grid._subgrids[_index]; }
+    ParallelCartesianDensitySubGrid &operator*() {
+      return static_cast< ParallelCartesianDensitySubGrid & >(
+          *_grid._subgrids[_index]);
+    }
 
     /**
      * @brief Get the offset of the block the iterator is currently pointing to
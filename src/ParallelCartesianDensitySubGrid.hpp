@@ -29,10 +29,14 @@
 
 #include "Box.hpp"
 #include "DensityFunction.hpp"
+#include "IonizationVariables.hpp"
 #include "Photon.hpp"
+#include "UnitConverter.hpp"
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
+#include <vector>
 
 /**
  * @brief General interface for sub regions of a DensityGrid.
@@ -42,6 +46,10 @@ private:
   /*! @brief Photon pool for this sub region. */
   std::vector< Photon * > _photon_pool;
 
+  /*! @brief Optical depths the photons in the photon pool still need to
+   *  travel. */
+  std::vector< double > _optical_depth_pool;
+
   /*! @brief Number of cells in this sub region. */
   uint_least32_t _numcell;
 
@@ -68,19 +76,27 @@ public:
    * @brief Add a Photon to the photon pool.
    *
    * @param photon Photon to add.
+   * @param optical_depth Optical depth the photon still needs to travel.
    */
-  inline void add_photon(Photon *photon) { _photon_pool.push_back(photon); }
+  inline void add_photon(Photon *photon, double optical_depth) {
+    _photon_pool.push_back(photon);
+    _optical_depth_pool.push_back(optical_depth);
+  }
 
   /**
    * @brief Get the last Photon in the photon pool.
    *
    * This method also removes the photon from the pool.
    *
+   * @param optical_depth Variable to store the optical depth the photon still
+   * needs to travel in.
    * @return Photon.
    */
-  inline Photon *get_photon() {
+  inline Photon *get_photon(double &optical_depth) {
     Photon *photon = _photon_pool.back();
     _photon_pool.pop_back();
+    optical_depth = _optical_depth_pool.back();
+    _optical_depth_pool.pop_back();
     return photon;
   }
 
@@ -104,13 +120,15 @@ public:
    *
    * @param photon Photon.
    * @param optical_depth Optical depth the photon should travel in total
-   * (dimensionless).
+   * (dimensionless). On exit, this variable contains the optical depth the
+   * photon still needs to travel after leaving the sub region (or a value
+   * smaller than or equal to zero if the photon was absorbed).
    * @return Index of the sub region that contains the photon on exit. This can
    * be either a negative number (which means the photon leaves the box), an
    * index refering to a local sub region (including this one), or an index
    * refering to a GhostDensitySubGrid.
    */
-  virtual int_fast32_t interact(Photon &photon, double optical_depth) = 0;
+  virtual int_fast32_t interact(Photon &photon, double &optical_depth) = 0;
 
   /**
    * @brief Initialize all cells in the sub region.
@@ -134,17 +152,14 @@ public:
  */
 class DensitySubGridVariables {
 private:
-  /*! @brief Number densities (in m^-3). */
-  std::vector< double > _number_density;
-
-  /*! @brief Hydrogen neutral fractions. */
-  std::vector< double > _neutral_fraction_H;
+  /*! @brief Ionization variables for all cells in the sub region. */
+  std::vector< IonizationVariables > _ionization_variables;
 
-  /*! @brief Re-emission probabilities. */
-  std::vector< double > _reemission_probability_H;
+  /*! @brief Ionization energy of hydrogen (in Hz). */
+  const double _ionization_energy_H;
 
-  /*! @brief Mean intensity integrals (without normalization factor, in m^3). */
-  std::vector< double > _mean_intensity_H;
+  /*! @brief Ionization energy of helium (in Hz). */
+  const double _ionization_energy_He;
 
 public:
   /**
@@ -152,12 +167,12 @@ public:
    *
    * @param numcell Number of cells in the sub region.
    */
-  DensitySubGridVariables(int_fast32_t numcell) {
-    _number_density.resize(numcell, 0.);
-    _neutral_fraction_H.resize(numcell, 0.);
-    _reemission_probability_H.resize(numcell, 0.);
-    _mean_intensity_H.resize(numcell, 0.);
-  }
+  DensitySubGridVariables(int_fast32_t numcell)
+      : _ionization_variables(numcell),
+        _ionization_energy_H(
+            UnitConverter::to_SI< QUANTITY_FREQUENCY >(13.6, "eV")),
+        _ionization_energy_He(
+            UnitConverter::to_SI< QUANTITY_FREQUENCY >(24.6, "eV")) {}
 
   /**
    * @brief Virtual destructor.
@@ -175,24 +190,42 @@ public:
    */
   inline double get_optical_depth(double ds, int_fast32_t index,
                                   const Photon &photon) const {
-    return ds * _number_density[index] *
-           (photon.get_cross_section(ION_H_n) * _neutral_fraction_H[index]);
+    const IonizationVariables &ionization_variables =
+        _ionization_variables[index];
+    return ds * ionization_variables.get_number_density() *
+           (photon.get_cross_section(ION_H_n) *
+                ionization_variables.get_ionic_fraction(ION_H_n) +
+            photon.get_cross_section_He_corr() *
+                ionization_variables.get_ionic_fraction(ION_He_n));
   }
 
   /**
    * @brief Update the contributions to the mean intensity integrals due to the
    * given photon travelling the given path length in the given cell.
    *
+   * A sub region is only ever traversed by a single thread, so no
+   * synchronization is required.
+   *
    * @param ds Path length the photon traverses (in m).
    * @param index Index of the cell the photon travels in.
    * @param photon Photon.
    */
   inline void update_integrals(double ds, int_fast32_t index,
                                const Photon &photon) {
-    if (_number_density[index] > 0.) {
-      double dmean_intensity_H =
-          ds * photon.get_weight() * photon.get_cross_section(ION_H_n);
-      _mean_intensity_H[index] += dmean_intensity_H;
+    IonizationVariables &ionization_variables = _ionization_variables[index];
+    if (ionization_variables.get_number_density() > 0.) {
+      const double dsw = ds * photon.get_weight();
+      for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+        const IonName ion = static_cast< IonName >(i);
+        ionization_variables.increase_mean_intensity(
+            ion, dsw * photon.get_cross_section(ion));
+      }
+      ionization_variables.increase_heating(
+          HEATINGTERM_H, dsw * photon.get_cross_section(ION_H_n) *
+                             (photon.get_energy() - _ionization_energy_H));
+      ionization_variables.increase_heating(
+          HEATINGTERM_He, dsw * photon.get_cross_section(ION_He_n) *
+                              (photon.get_energy() - _ionization_energy_He));
     }
   }
 
@@ -204,21 +237,54 @@ public:
    * @param values DensityValues for that cell.
    */
   inline void initialize(int_fast32_t index, DensityValues values) {
-    _number_density[index] = values.get_number_density();
-    _neutral_fraction_H[index] = values.get_ionic_fraction(ION_H_n);
-    double T = values.get_temperature();
-    double alpha_1_H = 1.58e-13 * std::pow(T * 1.e-4, -0.53);
-    double alpha_A_agn = 4.18e-13 * std::pow(T * 1.e-4, -0.7);
-    _reemission_probability_H[index] = alpha_1_H / alpha_A_agn;
+    IonizationVariables &ionization_variables = _ionization_variables[index];
+    ionization_variables.set_number_density(values.get_number_density());
+    ionization_variables.set_temperature(values.get_temperature());
+    for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+      const IonName ion = static_cast< IonName >(i);
+      ionization_variables.set_ionic_fraction(ion,
+                                              values.get_ionic_fraction(ion));
+    }
   }
 
   /**
-   * @brief Get a reference to the internal number density array.
+   * @brief Reset the mean intensity and heating integrals of all cells in the
+   * sub region.
+   */
+  inline void reset_mean_intensities() {
+    for (size_t index = 0; index < _ionization_variables.size(); ++index) {
+      IonizationVariables &ionization_variables = _ionization_variables[index];
+      for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+        const IonName ion = static_cast< IonName >(i);
+        ionization_variables.set_mean_intensity(ion, 0.);
+      }
+      for (int_fast32_t i = 0; i < NUMBER_OF_HEATINGTERMS; ++i) {
+        const HeatingTermName name = static_cast< HeatingTermName >(i);
+        ionization_variables.set_heating(name, 0.);
+      }
+    }
+  }
+
+  /**
+   * @brief Get the ionization variables of the cell with the given index.
+   *
+   * @param index Index of a cell.
+   * @return Reference to the IonizationVariables of that cell.
+   */
+  inline IonizationVariables &get_ionization_variables(int_fast32_t index) {
+    return _ionization_variables[index];
+  }
+
+  /**
+   * @brief Get read only access to the ionization variables of the cell with
+   * the given index.
    *
-   * @return Reference to the internal number density array.
+   * @param index Index of a cell.
+   * @return Read only reference to the IonizationVariables of that cell.
    */
-  inline std::vector< double > &get_number_density_handle() {
-    return _number_density;
+  inline const IonizationVariables &
+  get_ionization_variables(int_fast32_t index) const {
+    return _ionization_variables[index];
   }
 };
 
@@ -276,8 +342,9 @@ public:
    * index refering to a local sub region (including this one), or an index
    * refering to a GhostDensitySubGrid.
    */
-  virtual int_fast32_t interact(Photon &photon, double optical_depth) {
+  virtual int_fast32_t interact(Photon &photon, double &optical_depth) {
     cmac_error("A photon should never be propagated through a ghost region!");
+    return -1;
   }
 
   /**
@@ -584,14 +651,16 @@ public:
    *
    * @param photon Photon.
    * @param optical_depth Optical depth the photon should travel in total
-   * (dimensionless).
+   * (dimensionless). On exit, this variable contains the optical depth the
+   * photon still needs to travel after leaving the sub region (or a value
+   * smaller than or equal to zero if the photon was absorbed).
    * @return Index of the ParallelCartesianDensitySubGrid that contains the
    * photon on exit. This can be either a negative number (which means the
    * photon leaves the box), an index refering to a local
    * ParallelCartesianDensitySubGrid (including this one), or an index refering
    * to a GhostDensitySubGrid.
    */
-  virtual int_fast32_t interact(Photon &photon, double optical_depth) {
+  virtual int_fast32_t interact(Photon &photon, double &optical_depth) {
     double S = 0.;
 
     CoordinateVector<> photon_origin = photon.get_position();
@@ -599,6 +668,13 @@ public:
 
     // find out in which cell the photon is currently hiding
     CoordinateVector< int_fast32_t > index = get_cell_indices(photon_origin);
+    // photons that enter from a neighbouring sub region start on the wall
+    // between both regions, and round off might put them just outside this
+    // sub region
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+      index[i] = std::max(index[i], int_fast32_t(0));
+      index[i] = std::min(index[i], int_fast32_t(_numcell[i] - 1));
+    }
 
     uint_fast32_t ncell = 0;
     // while the photon has not exceeded the optical depth and is still in the
@@ -615,7 +691,8 @@ public:
       // get the optical depth of the path from the current photon location to
       // the
       // cell wall, update S
-      double tau = get_optical_depth(ds, get_long_index(index), photon);
+      const uint_fast64_t long_index = get_long_index(index);
+      double tau = get_optical_depth(ds, long_index, photon);
       optical_depth -= tau;
 
       // if the optical depth exceeds or equals the wanted value: exit the loop
@@ -641,7 +718,9 @@ public:
 
       // ds is now the actual distance travelled in the cell
       // update contributions to mean intensity integrals
-      update_integrals(ds, get_long_index(index), photon);
+      // note that we cannot use index here, since it might already point to
+      // the next cell
+      update_integrals(ds, long_index, photon);
 
       S += ds;
     }
@@ -720,6 +799,63 @@ public:
     }
     return positions;
   }
+
+  /**
+   * @brief Get the index of the cell that contains the given position.
+   *
+   * Positions just outside the sub region (due to round off) are mapped to
+   * the closest cell inside the sub region.
+   *
+   * @param position Position (in m).
+   * @return Index of the cell that contains the position.
+   */
+  inline int_fast32_t get_cell_index(const CoordinateVector<> position) const {
+    CoordinateVector< int_fast32_t > index = get_cell_indices(position);
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+      index[i] = std::max(index[i], int_fast32_t(0));
+      index[i] = std::min(index[i], int_fast32_t(_numcell[i] - 1));
+    }
+    return get_long_index(index);
+  }
+
+  /**
+   * @brief Get the midpoint of the cell with the given index.
+   *
+   * @param index Index of a cell.
+   * @return Midpoint of the cell (in m).
+   */
+  inline CoordinateVector<> get_cell_midpoint(int_fast32_t index) const {
+    const CoordinateVector< int_fast32_t > indices = get_indices(index);
+    return CoordinateVector<>(
+        _box.get_anchor().x() + (indices.x() + 0.5) * _cellsides.x(),
+        _box.get_anchor().y() + (indices.y() + 0.5) * _cellsides.y(),
+        _box.get_anchor().z() + (indices.z() + 0.5) * _cellsides.z());
+  }
+
+  /**
+   * @brief Get the volume of a single cell in the sub region.
+   *
+   * @return Volume of a single cell (in m^3).
+   */
+  inline double get_cell_volume() const {
+    return _cellsides.x() * _cellsides.y() * _cellsides.z();
+  }
+
+  /**
+   * @brief Update the number densities of all cells in the sub region.
+   *
+   * Contrary to initialize(), the temperatures and ionic fractions are kept.
+   *
+   * @param function DensityFunction to use.
+   */
+  void update_number_densities(DensityFunction &function) {
+    for (uint_fast32_t index = 0; index < get_number_of_cells(); ++index) {
+      const CoordinateVector<> position = get_cell_midpoint(index);
+      const DummyCell cell(position.x(), position.y(), position.z());
+      get_ionization_variables(index).set_number_density(
+          function(cell).get_number_density());
+    }
+  }
 };
 
 #endif // PARALLELCARTESIANDENSITYSUBGRID_HPP
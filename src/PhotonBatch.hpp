@@ -44,6 +44,10 @@ private:
    *  propagated. */
   std::vector< int_least32_t > _indices;
 
+  /*! @brief Optical depths the photons still need to travel before they are
+   *  absorbed. */
+  std::vector< double > _optical_depths;
+
   /*! @brief Maximum size of the internal arrays. */
   uint_least32_t _size;
 
@@ -56,24 +60,38 @@ public:
   PhotonBatch(uint_fast32_t size) : _size(size) {
     _photons.reserve(size);
     _indices.reserve(size);
+    _optical_depths.reserve(size);
   }
 
   /**
    * @brief Add the given Photon to the internal list.
    *
    * @param photon Photon to add.
+   * @param index Index of the next sub region in which the photon needs to be
+   * propagated (default: -1).
+   * @param optical_depth Optical depth the photon still needs to travel
+   * (default: 0).
    * @return True if the Photon was successfully added.
    */
-  bool add_photon(Photon photon) {
+  bool add_photon(Photon photon, int_fast32_t index = -1,
+                  double optical_depth = 0.) {
     if (_photons.size() < _size) {
       _photons.push_back(photon);
-      _indices.push_back(-1);
+      _indices.push_back(index);
+      _optical_depths.push_back(optical_depth);
       return true;
     } else {
       return false;
     }
   }
 
+  /**
+   * @brief Get the number of Photons in the batch.
+   *
+   * @return Number of Photons in the batch.
+   */
+  uint_fast32_t size() const { return _photons.size(); }
+
   /**
    * @brief Iterator to loop over the Photons contained in the PhotonBatch.
    */
@@ -159,6 +177,14 @@ public:
      * @return New index for the Photon the iterator is pointing to.
      */
     int_fast32_t get_new_index() const { return _batch._indices[_index]; }
+
+    /**
+     * @brief Get the optical depth the Photon the iterator is currently
+     * pointing to still needs to travel.
+     *
+     * @return Remaining optical depth of the Photon.
+     */
+    double get_optical_depth() const { return _batch._optical_depths[_index]; }
   };
 
   /**
@@ -60,8 +60,13 @@ public:
    * This method uses a locking mechanism to guarantee thread safety.
    *
    * @param photon Photon to add.
+   * @param index Index of the next sub region in which the photon needs to be
+   * propagated (default: -1).
+   * @param optical_depth Optical depth the photon still needs to travel
+   * (default: 0).
    */
-  void add_photon(Photon photon) {
+  void add_photon(Photon photon, int_fast32_t index = -1,
+                  double optical_depth = 0.) {
     // lock the bucket: everything below can only be done by one thread at a
     // time
     _lock.lock();
@@ -70,11 +75,11 @@ public:
       // create the first batch
       _batches.push_back(PhotonBatch(_max_size));
     }
-    bool success = _batches.back().add_photon(photon);
+    bool success = _batches.back().add_photon(photon, index, optical_depth);
     if (!success) {
       // create a new batch
       _batches.push_back(PhotonBatch(_max_size));
-      success = _batches.back().add_photon(photon);
+      success = _batches.back().add_photon(photon, index, optical_depth);
       if (!success) {
         cmac_error("Something went wrong while adding a photon to a bucket!");
       }
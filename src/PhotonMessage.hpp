@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file PhotonMessage.hpp
+ *
+ * @brief MPIMessage that contains a PhotonBatch that is sent to another
+ * process.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef PHOTONMESSAGE_HPP
+#define PHOTONMESSAGE_HPP
+
+#include "MPIMessage.hpp"
+#include "PhotonBatch.hpp"
+#include "PhotonPool.hpp"
+
+#include <vector>
+
+/*! @brief Number of double precision values used to store a single Photon in
+ *  the message buffer: sub region index, remaining optical depth, position (3
+ *  values), direction (3 values), energy, weight, type, abundance corrected
+ *  helium cross section, and the cross sections for all ions. */
+#define PHOTONMESSAGE_PHOTON_SIZE (12 + NUMBER_OF_IONNAMES)
+
+/**
+ * @brief MPIMessage that contains a PhotonBatch that is sent to another
+ * process.
+ */
+class PhotonMessage : public MPIMessage {
+private:
+  /*! @brief Buffer containing the packed photon data. */
+  std::vector< double > _buffer;
+
+public:
+  /**
+   * @brief Empty constructor.
+   *
+   * Used to create a receive buffer. The size of the buffer is set later on
+   * by the MPIMessageBox.
+   */
+  PhotonMessage() : MPIMessage(0) { set_datatype< double >(); }
+
+  /**
+   * @brief Constructor.
+   *
+   * Packs the contents of the given PhotonBatch into the internal buffer.
+   *
+   * @param batch PhotonBatch to send.
+   */
+  PhotonMessage(PhotonBatch &batch)
+      : MPIMessage(batch.size() * PHOTONMESSAGE_PHOTON_SIZE) {
+    set_datatype< double >();
+    _buffer.resize(batch.size() * PHOTONMESSAGE_PHOTON_SIZE);
+    size_t offset = 0;
+    for (auto it = batch.begin(); it != batch.end(); ++it) {
+      const Photon photon = it.get_photon();
+      _buffer[offset] = it.get_new_index();
+      _buffer[offset + 1] = it.get_optical_depth();
+      const CoordinateVector<> position = photon.get_position();
+      _buffer[offset + 2] = position.x();
+      _buffer[offset + 3] = position.y();
+      _buffer[offset + 4] = position.z();
+      const CoordinateVector<> direction = photon.get_direction();
+      _buffer[offset + 5] = direction.x();
+      _buffer[offset + 6] = direction.y();
+      _buffer[offset + 7] = direction.z();
+      _buffer[offset + 8] = photon.get_energy();
+      _buffer[offset + 9] = photon.get_weight();
+      _buffer[offset + 10] = photon.get_type();
+      _buffer[offset + 11] = photon.get_cross_section_He_corr();
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        _buffer[offset + 12 + ion] = photon.get_cross_section(IonName(ion));
+      }
+      offset += PHOTONMESSAGE_PHOTON_SIZE;
+    }
+  }
+
+  /**
+   * @brief Virtual destructor.
+   *
+   * Wait until the communication is finished before the buffer is freed.
+   */
+  virtual ~PhotonMessage() { wait_until_finished(); }
+
+  /**
+   * @brief Get a handle to the internal buffer.
+   *
+   * @return Pointer to the internal buffer.
+   */
+  virtual void *get_buffer_handle() { return _buffer.data(); }
+
+  /**
+   * @brief Resize the internal buffer.
+   *
+   * @param size New size of the internal buffer.
+   */
+  virtual void set_buffer_size(int size) { _buffer.resize(size); }
+
+  /**
+   * @brief Get the type of this message.
+   *
+   * @return 2.
+   */
+  virtual int get_type() const { return 2; }
+
+  /**
+   * @brief Get the number of photons contained in the message.
+   *
+   * @return Number of photons in the message.
+   */
+  inline uint_fast32_t get_number_of_photons() const {
+    return _buffer.size() / PHOTONMESSAGE_PHOTON_SIZE;
+  }
+
+  /**
+   * @brief Unpack the photons in the message and add them to the given bucket
+   * of the given PhotonPool.
+   *
+   * @param pool PhotonPool to add the photons to.
+   * @param bucket_index Index of the bucket in the PhotonPool.
+   */
+  inline void unpack(PhotonPool &pool, uint_fast32_t bucket_index) const {
+    for (size_t offset = 0; offset < _buffer.size();
+         offset += PHOTONMESSAGE_PHOTON_SIZE) {
+      const CoordinateVector<> position(
+          _buffer[offset + 2], _buffer[offset + 3], _buffer[offset + 4]);
+      const CoordinateVector<> direction(
+          _buffer[offset + 5], _buffer[offset + 6], _buffer[offset + 7]);
+      Photon photon(position, direction, _buffer[offset + 8]);
+      photon.set_weight(_buffer[offset + 9]);
+      photon.set_type(PhotonType(_buffer[offset + 10]));
+      photon.set_cross_section_He_corr(_buffer[offset + 11]);
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        photon.set_cross_section(IonName(ion), _buffer[offset + 12 + ion]);
+      }
+      pool.add_photon(bucket_index, photon, _buffer[offset],
+                      _buffer[offset + 1]);
+    }
+  }
+};
+
+/**
+ * @brief MPIMessageBox that receives PhotonMessages and stores the photons
+ * they contain in a PhotonPool.
+ */
+class PhotonMessageBox : public MPIMessageBox {
+private:
+  /*! @brief PhotonPool in which received photons are stored. */
+  PhotonPool &_inbox;
+
+  /*! @brief Number of photons received so far. */
+  uint_fast64_t _number_of_received_photons;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param world_size Total number of MPI processes.
+   * @param inbox PhotonPool in which received photons are stored (all photons
+   * are stored in the first bucket).
+   */
+  PhotonMessageBox(int world_size, PhotonPool &inbox)
+      : MPIMessageBox(world_size), _inbox(inbox),
+        _number_of_received_photons(0) {}
+
+  /**
+   * @brief Virtual destructor.
+   */
+  virtual ~PhotonMessageBox() {}
+
+  /**
+   * @brief Generate an MPIMessage of the given type.
+   *
+   * @param type Type of message to generate.
+   * @return Pointer to a newly generated PhotonMessage.
+   */
+  virtual MPIMessage *generate(int type) const {
+    if (type != 2) {
+      cmac_error("Unknown message type: %i!", type);
+    }
+    return new PhotonMessage();
+  }
+
+  /**
+   * @brief Store the photons contained in the given message in the inbox.
+   *
+   * @param message Received MPIMessage.
+   */
+  virtual void use_message(MPIMessage *message) {
+    if (message->get_type() != 2) {
+      cmac_error("Unknown message type: %i!", message->get_type());
+    }
+    const PhotonMessage *photon_message =
+        reinterpret_cast< PhotonMessage * >(message);
+    photon_message->unpack(_inbox, 0);
+    _number_of_received_photons += photon_message->get_number_of_photons();
+  }
+
+  /**
+   * @brief Get the number of photons that were received so far.
+   *
+   * @return Number of received photons.
+   */
+  inline uint_fast64_t get_number_of_received_photons() const {
+    return _number_of_received_photons;
+  }
+};
+
+#endif // PHOTONMESSAGE_HPP
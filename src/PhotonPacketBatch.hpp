@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file PhotonPacketBatch.hpp
+ *
+ * @brief Batch of newly generated photon packets, stored as a structure of
+ * arrays.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef PHOTONPACKETBATCH_HPP
+#define PHOTONPACKETBATCH_HPP
+
+#include "Error.hpp"
+#include "Photon.hpp"
+
+#include <cinttypes>
+
+/*! @brief Maximum number of photons in a single PhotonPacketBatch. */
+#define PHOTONPACKETBATCH_SIZE 64
+
+/**
+ * @brief Batch of newly generated photon packets, stored as a structure of
+ * arrays.
+ *
+ * The batch is filled by PhotonSource::get_random_photons(). Storing every
+ * photon property in a separate contiguous array allows the loops that
+ * generate the photons (and that evaluate their cross sections) to run over
+ * the whole batch at once.
+ */
+class PhotonPacketBatch {
+private:
+  /*! @brief Number of photons in the batch. */
+  uint_fast32_t _size;
+
+  /*! @brief Positions of the photons (in m). */
+  double _positions[3][PHOTONPACKETBATCH_SIZE];
+
+  /*! @brief Directions of the photons. */
+  double _directions[3][PHOTONPACKETBATCH_SIZE];
+
+  /*! @brief Energies of the photons (in Hz). */
+  double _energies[PHOTONPACKETBATCH_SIZE];
+
+  /*! @brief Weights of the photons. */
+  double _weights[PHOTONPACKETBATCH_SIZE];
+
+  /*! @brief Ionization cross sections of the photons (in m^2). */
+  double _cross_sections[NUMBER_OF_IONNAMES][PHOTONPACKETBATCH_SIZE];
+
+  /*! @brief Abundance corrected helium cross sections of the photons
+   *  (in m^2). */
+  double _cross_sections_He_corr[PHOTONPACKETBATCH_SIZE];
+
+  /*! @brief PhotonSource fills the internal arrays. */
+  friend class PhotonSource;
+
+public:
+  /**
+   * @brief Empty constructor.
+   */
+  inline PhotonPacketBatch() : _size(0) {}
+
+  /**
+   * @brief Get the number of photons in the batch.
+   *
+   * @return Number of photons in the batch.
+   */
+  inline uint_fast32_t size() const { return _size; }
+
+  /**
+   * @brief Get the photon with the given index.
+   *
+   * @param index Index of a photon in the batch.
+   * @return Photon.
+   */
+  inline Photon get_photon(const uint_fast32_t index) const {
+
+    cmac_assert(index < _size);
+
+    Photon photon(CoordinateVector<>(_positions[0][index],
+                                     _positions[1][index],
+                                     _positions[2][index]),
+                  CoordinateVector<>(_directions[0][index],
+                                     _directions[1][index],
+                                     _directions[2][index]),
+                  _energies[index]);
+    for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+      photon.set_cross_section(static_cast< IonName >(i),
+                               _cross_sections[i][index]);
+    }
+    photon.set_cross_section_He_corr(_cross_sections_He_corr[index]);
+    photon.set_weight(_weights[index]);
+    return photon;
+  }
+};
+
+#endif // PHOTONPACKETBATCH_HPP
@@ -57,9 +57,14 @@ public:
    *
    * @param bucket_index Index of a PhotonBucket.
    * @param photon Photon to add.
+   * @param index Index of the next sub region in which the photon needs to be
+   * propagated (default: -1).
+   * @param optical_depth Optical depth the photon still needs to travel
+   * (default: 0).
    */
-  void add_photon(uint_fast32_t bucket_index, Photon photon) {
-    _buckets[bucket_index].add_photon(photon);
+  void add_photon(uint_fast32_t bucket_index, Photon photon,
+                  int_fast32_t index = -1, double optical_depth = 0.) {
+    _buckets[bucket_index].add_photon(photon, index, optical_depth);
   }
 
   /**
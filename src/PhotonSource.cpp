@@ -68,8 +68,10 @@ PhotonSource::PhotonSource(PhotonSourceDistribution *distribution,
   if (distribution != nullptr) {
     _discrete_positions.resize(distribution->get_number_of_sources());
     _discrete_probabilities.resize(distribution->get_number_of_sources());
+    std::vector< double > discrete_weights(_discrete_positions.size());
     for (size_t i = 0; i < _discrete_positions.size(); ++i) {
       _discrete_positions[i] = distribution->get_position(i);
+      discrete_weights[i] = distribution->get_weight(i);
       if (i > 0) {
         _discrete_probabilities[i] =
             _discrete_probabilities[i - 1] + distribution->get_weight(i);
@@ -84,6 +86,7 @@ PhotonSource::PhotonSource(PhotonSourceDistribution *distribution,
       } else {
         _discrete_probabilities.back() = 1.;
       }
+      _discrete_table.initialize(discrete_weights);
     }
     discrete_luminosity = distribution->get_total_luminosity();
 
@@ -245,6 +248,132 @@ PhotonSource::get_random_photon(RandomGenerator &random_generator) const {
   return photon;
 }
 
+/**
+ * @brief Fill the given PhotonPacketBatch with photons with a random direction
+ * and energy.
+ *
+ * The photons follow the same distributions as the photons returned by
+ * get_random_photon(), but every step of the generation is done for the whole
+ * batch at once: the discrete sources are sampled from an alias table, the
+ * random isotropic directions are computed in a single loop, the frequencies
+ * are sampled using PhotonSourceSpectrum::get_random_frequencies(), and the
+ * cross sections are evaluated ion by ion using
+ * CrossSections::get_cross_sections().
+ *
+ * @param random_generator RandomGenerator to use.
+ * @param batch PhotonPacketBatch to fill.
+ * @param number Number of photons to generate (should not be larger than
+ * PHOTONPACKETBATCH_SIZE).
+ */
+void PhotonSource::get_random_photons(RandomGenerator &random_generator,
+                                      PhotonPacketBatch &batch,
+                                      const uint_fast32_t number) const {
+
+  cmac_assert(number <= PHOTONPACKETBATCH_SIZE);
+
+  batch._size = number;
+
+  // decide which photons are emitted by which type of source
+  uint_fast32_t discrete_indices[PHOTONPACKETBATCH_SIZE];
+  uint_fast32_t continuous_indices[PHOTONPACKETBATCH_SIZE];
+  uint_fast32_t number_of_discrete = 0;
+  uint_fast32_t number_of_continuous = 0;
+  for (uint_fast32_t i = 0; i < number; ++i) {
+    if (random_generator.get_uniform_random_double() >=
+        _continuous_probability) {
+      discrete_indices[number_of_discrete] = i;
+      ++number_of_discrete;
+    } else {
+      continuous_indices[number_of_continuous] = i;
+      ++number_of_continuous;
+    }
+  }
+
+  // temporary arrays used to store the properties of the discrete and
+  // continuous photons contiguously
+  double random_numbers[2][PHOTONPACKETBATCH_SIZE];
+  double directions[3][PHOTONPACKETBATCH_SIZE];
+  double frequencies[PHOTONPACKETBATCH_SIZE];
+
+  if (number_of_discrete > 0) {
+    cmac_assert(_discrete_table.get_size() > 0);
+
+    for (uint_fast32_t i = 0; i < number_of_discrete; ++i) {
+      const uint_fast32_t index = discrete_indices[i];
+      const uint_fast32_t isource =
+          _discrete_table.sample(random_generator.get_uniform_random_double());
+      const CoordinateVector<> &position = _discrete_positions[isource];
+      batch._positions[0][index] = position.x();
+      batch._positions[1][index] = position.y();
+      batch._positions[2][index] = position.z();
+      batch._weights[index] = _discrete_photon_weight;
+    }
+
+    // random isotropic directions: first draw all random numbers, so that the
+    // loop that computes the directions does not depend on the
+    // RandomGenerator state
+    for (uint_fast32_t i = 0; i < number_of_discrete; ++i) {
+      random_numbers[0][i] = random_generator.get_uniform_random_double();
+      random_numbers[1][i] = random_generator.get_uniform_random_double();
+    }
+    for (uint_fast32_t i = 0; i < number_of_discrete; ++i) {
+      const double cost = 2. * random_numbers[0][i] - 1.;
+      const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+      const double phi = 2. * M_PI * random_numbers[1][i];
+      directions[0][i] = sint * std::cos(phi);
+      directions[1][i] = sint * std::sin(phi);
+      directions[2][i] = cost;
+    }
+
+    _discrete_spectrum->get_random_frequencies(random_generator, frequencies,
+                                               number_of_discrete);
+
+    for (uint_fast32_t i = 0; i < number_of_discrete; ++i) {
+      const uint_fast32_t index = discrete_indices[i];
+      batch._directions[0][index] = directions[0][i];
+      batch._directions[1][index] = directions[1][i];
+      batch._directions[2][index] = directions[2][i];
+      batch._energies[index] = frequencies[i];
+    }
+  }
+
+  if (number_of_continuous > 0) {
+    cmac_assert(_continuous_source != nullptr);
+
+    for (uint_fast32_t i = 0; i < number_of_continuous; ++i) {
+      const uint_fast32_t index = continuous_indices[i];
+      const std::pair< CoordinateVector<>, CoordinateVector<> > posdir =
+          _continuous_source->get_random_incoming_direction(random_generator);
+      batch._positions[0][index] = posdir.first.x();
+      batch._positions[1][index] = posdir.first.y();
+      batch._positions[2][index] = posdir.first.z();
+      batch._directions[0][index] = posdir.second.x();
+      batch._directions[1][index] = posdir.second.y();
+      batch._directions[2][index] = posdir.second.z();
+      batch._weights[index] = _continuous_photon_weight;
+    }
+
+    _continuous_spectrum->get_random_frequencies(random_generator, frequencies,
+                                                 number_of_continuous);
+
+    for (uint_fast32_t i = 0; i < number_of_continuous; ++i) {
+      batch._energies[continuous_indices[i]] = frequencies[i];
+    }
+  }
+
+  // cross sections: one (virtual) call per ion for the whole batch
+  for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+    const IonName ion = static_cast< IonName >(i);
+    _cross_sections.get_cross_sections(ion, batch._energies,
+                                       batch._cross_sections[ion], number);
+  }
+  const double AHe = _abundances.get_abundance(ELEMENT_He);
+  for (uint_fast32_t i = 0; i < number; ++i) {
+    batch._cross_sections_He_corr[i] =
+        AHe * batch._cross_sections[ION_He_n][i];
+  }
+}
+
 /**
  * @brief Get the total luminosity of all sources together.
  *
@@ -266,9 +395,9 @@ double PhotonSource::get_total_luminosity() const { return _total_luminosity; }
  * @return True if the photon is re-emitted as an ionizing photon, false if it
  * leaves the system.
  */
-bool PhotonSource::reemit(Photon &photon,
-                          const IonizationVariables &ionization_variables,
-                          RandomGenerator &random_generator) const {
+bool PhotonSource::reemit(
+    Photon &photon, const IonizationVariablesReference &ionization_variables,
+    RandomGenerator &random_generator) const {
 
   if (_reemission_handler) {
     PhotonType type;
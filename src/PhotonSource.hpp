@@ -33,8 +33,10 @@
 #include "HeliumTwoPhotonContinuumSpectrum.hpp"
 #include "HydrogenLymanContinuumSpectrum.hpp"
 #include "Photon.hpp"
+#include "PhotonPacketBatch.hpp"
 #include "RandomGenerator.hpp"
 #include "Utilities.hpp"
+#include "WalkerAliasTable.hpp"
 
 #include <cmath>
 #include <vector>
@@ -73,6 +75,10 @@ private:
    *  source. */
   std::vector< double > _discrete_probabilities;
 
+  /*! @brief Alias table used to sample the discrete sources in constant time
+   *  (used for batched photon generation). */
+  WalkerAliasTable _discrete_table;
+
   /// continuous sources
 
   /*! @brief ContinuousPhotonSource instance used. */
@@ -145,9 +151,14 @@ public:
 
   Photon get_random_photon(RandomGenerator &random_generator) const;
 
+  void get_random_photons(RandomGenerator &random_generator,
+                          PhotonPacketBatch &batch,
+                          const uint_fast32_t number) const;
+
   double get_total_luminosity() const;
 
-  bool reemit(Photon &photon, const IonizationVariables &ionization_variables,
+  bool reemit(Photon &photon,
+              const IonizationVariablesReference &ionization_variables,
               RandomGenerator &random_generator) const;
 };
 
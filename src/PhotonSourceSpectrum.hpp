@@ -26,6 +26,8 @@
 #ifndef PHOTONSOURCESPECTRUM_HPP
 #define PHOTONSOURCESPECTRUM_HPP
 
+#include <cinttypes>
+
 class RandomGenerator;
 
 /**
@@ -48,6 +50,27 @@ public:
   virtual double get_random_frequency(RandomGenerator &random_generator,
                                       double temperature = 0.) const = 0;
 
+  /**
+   * @brief Get a number of random frequencies from the spectrum.
+   *
+   * The default implementation calls get_random_frequency() for every
+   * frequency. Implementations can override this to sample all frequencies in
+   * a single pass.
+   *
+   * @param random_generator RandomGenerator to use.
+   * @param frequencies Array to store the random frequencies in (in Hz).
+   * @param number Number of random frequencies to generate.
+   * @param temperature Temperature of the gas (for reemission spectra) (in K).
+   */
+  virtual void get_random_frequencies(RandomGenerator &random_generator,
+                                      double *frequencies,
+                                      const uint_fast32_t number,
+                                      double temperature = 0.) const {
+    for (uint_fast32_t i = 0; i < number; ++i) {
+      frequencies[i] = get_random_frequency(random_generator, temperature);
+    }
+  }
+
   /**
    * @brief Get the total ionizing flux emitted by the spectrum.
    *
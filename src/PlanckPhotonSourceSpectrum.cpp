@@ -102,6 +102,16 @@ PlanckPhotonSourceSpectrum::PlanckPhotonSourceSpectrum(double temperature,
     _log_frequency[i] = std::log10(frequency[i]);
   }
 
+  // set up the alias table for the bins: bin i contains the frequencies
+  // between frequency[i] and frequency[i+1]
+  std::vector< double > bin_probabilities(PLANCKPHOTONSOURCESPECTRUM_NUMFREQ -
+                                          1);
+  for (uint_fast32_t i = 0; i < PLANCKPHOTONSOURCESPECTRUM_NUMFREQ - 1; ++i) {
+    bin_probabilities[i] =
+        _cumulative_distribution[i + 1] - _cumulative_distribution[i];
+  }
+  _bin_table.initialize(bin_probabilities);
+
   if (log) {
     log->write_status("Set up a Planck black body spectrum with temperature ",
                       temperature, " K.");
@@ -164,6 +174,41 @@ double PlanckPhotonSourceSpectrum::get_random_frequency(
   return frequency * 3.288465385e15;
 }
 
+/**
+ * @brief Get a number of random frequencies from a Planck blackbody spectrum.
+ *
+ * Instead of locating a random uniform number in the cumulative distribution
+ * array, we sample the bin using an alias table, and then draw a uniform
+ * position within the cumulative distribution interval covered by that bin.
+ * This yields the same distribution as get_random_frequency(), but replaces
+ * the binary search with a constant time lookup.
+ *
+ * @param random_generator RandomGenerator to use.
+ * @param frequencies Array to store the random frequencies in (in Hz).
+ * @param number Number of random frequencies to generate.
+ * @param temperature Not used for this spectrum.
+ */
+void PlanckPhotonSourceSpectrum::get_random_frequencies(
+    RandomGenerator &random_generator, double *frequencies,
+    const uint_fast32_t number, double temperature) const {
+
+  for (uint_fast32_t i = 0; i < number; ++i) {
+    const uint_fast32_t ix =
+        _bin_table.sample(random_generator.get_uniform_random_double());
+    const double x = _cumulative_distribution[ix] +
+                     random_generator.get_uniform_random_double() *
+                         (_cumulative_distribution[ix + 1] -
+                          _cumulative_distribution[ix]);
+    const double log_random_frequency =
+        (std::log10(x) - _log_cumulative_distribution[ix]) /
+            (_log_cumulative_distribution[ix + 1] -
+             _log_cumulative_distribution[ix]) *
+            (_log_frequency[ix + 1] - _log_frequency[ix]) +
+        _log_frequency[ix];
+    frequencies[i] = std::pow(10., log_random_frequency) * 3.288465385e15;
+  }
+}
+
 /**
  * @brief Get the total ionizing flux of the spectrum.
  *
@@ -28,6 +28,7 @@
 #define PLANCKPHOTONSOURCESPECTRUM_HPP
 
 #include "PhotonSourceSpectrum.hpp"
+#include "WalkerAliasTable.hpp"
 
 #include <string>
 #include <vector>
@@ -59,6 +60,9 @@ private:
   /*! @brief Base 10 logarithm of the cumulative distribution in each bin. */
   std::vector< double > _log_cumulative_distribution;
 
+  /*! @brief Alias table used to sample the frequency bins in constant time. */
+  WalkerAliasTable _bin_table;
+
   /*! @brief Ionizing flux of the spectrum (in m^-2 s^-1). */
   const double _ionizing_flux;
 
@@ -77,6 +81,11 @@ public:
   virtual double get_random_frequency(RandomGenerator &random_generator,
                                       double temperature = 0.) const;
 
+  virtual void get_random_frequencies(RandomGenerator &random_generator,
+                                      double *frequencies,
+                                      const uint_fast32_t number,
+                                      double temperature = 0.) const;
+
   virtual double get_total_flux() const;
 };
 
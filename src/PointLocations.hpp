@@ -49,12 +49,40 @@ private:
   /*! @brief Anchor of the grid in physical space (in m). */
   CoordinateVector<> _grid_anchor;
 
+  /*! @brief Side lengths of the grid (in m). */
+  CoordinateVector<> _grid_sides;
+
   /*! @brief Side lengths of a single cell of the grid (in m). */
   CoordinateVector<> _grid_cell_sides;
 
   /*! @brief Reference to the underlying positions. */
   const std::vector< CoordinateVector<> > &_positions;
 
+  /**
+   * @brief Get the indices of the grid cell that contains the given position.
+   *
+   * Positions outside the grid are assigned to the closest grid cell.
+   *
+   * @param position Position (in m).
+   * @return Indices of the grid cell that contains the position.
+   */
+  inline std::tuple< uint_least32_t, uint_least32_t, uint_least32_t >
+  get_grid_cell(const CoordinateVector<> &position) const {
+    const int_fast32_t nx = _grid.size();
+    const int_fast32_t ny = _grid[0].size();
+    const int_fast32_t nz = _grid[0][0].size();
+    const int_fast32_t ix =
+        (position.x() - _grid_anchor.x()) / _grid_sides.x() * nx;
+    const int_fast32_t iy =
+        (position.y() - _grid_anchor.y()) / _grid_sides.y() * ny;
+    const int_fast32_t iz =
+        (position.z() - _grid_anchor.z()) / _grid_sides.z() * nz;
+    return std::tuple< uint_least32_t, uint_least32_t, uint_least32_t >(
+        std::max(int_fast32_t(0), std::min(nx - 1, ix)),
+        std::max(int_fast32_t(0), std::min(ny - 1, iy)),
+        std::max(int_fast32_t(0), std::min(nz - 1, iz)));
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -102,6 +130,7 @@ public:
 
     // set up the geometrical quantities
     _grid_anchor = minpos;
+    _grid_sides = maxpos;
     _grid_cell_sides = maxpos / ncell_1D;
 
     // set up the positions grid
@@ -135,6 +164,48 @@ public:
     }
   }
 
+  /**
+   * @brief Update the grid after the underlying positions have moved.
+   *
+   * Only positions that moved into a different grid cell are relocated, so
+   * that this is much cheaper than constructing a new PointLocations object if
+   * the positions only moved a small distance. The number of positions cannot
+   * change.
+   *
+   * @return Number of positions that moved into a different grid cell.
+   */
+  inline uint_fast32_t update_positions() {
+
+    cmac_assert(_positions.size() == _cell_map.size());
+
+    uint_fast32_t number_of_relocations = 0;
+    const uint_fast32_t positions_size = _positions.size();
+    for (uint_fast32_t i = 0; i < positions_size; ++i) {
+      const std::tuple< uint_least32_t, uint_least32_t, uint_least32_t >
+          new_cell = get_grid_cell(_positions[i]);
+      const std::tuple< uint_least32_t, uint_least32_t, uint_least32_t >
+          &old_cell = _cell_map[i];
+      if (new_cell != old_cell) {
+        std::vector< uint_least32_t > &old_indices =
+            _grid[std::get< 0 >(old_cell)][std::get< 1 >(old_cell)]
+                 [std::get< 2 >(old_cell)];
+        for (uint_fast32_t j = 0; j < old_indices.size(); ++j) {
+          if (old_indices[j] == i) {
+            old_indices[j] = old_indices.back();
+            old_indices.pop_back();
+            break;
+          }
+        }
+        _grid[std::get< 0 >(new_cell)][std::get< 1 >(new_cell)]
+             [std::get< 2 >(new_cell)]
+                 .push_back(i);
+        _cell_map[i] = new_cell;
+        ++number_of_relocations;
+      }
+    }
+    return number_of_relocations;
+  }
+
   /**
    * @brief Iterator that loops over the neighbours of a position in the grid.
    */
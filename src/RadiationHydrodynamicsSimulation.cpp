@@ -53,6 +53,8 @@
 #include "PhotonSourceDistributionFactory.hpp"
 #include "PhotonSourceSpectrumFactory.hpp"
 #include "RecombinationRatesFactory.hpp"
+#include "RestartReader.hpp"
+#include "RestartWriter.hpp"
 #include "SimulationBox.hpp"
 #include "TemperatureCalculator.hpp"
 #include "TerminalLog.hpp"
@@ -92,6 +94,12 @@
  *    value is given, the radiation field is updated every time step. (default:
  *    -1. s: update every time step)
  *  - random seed: Seed for the random number generator (default: 42)
+ *  - random generator: Type of random number generator: ranlxd2 (one random
+ *    sequence per thread) or Philox (counter-based, one random stream per
+ *    photon; the mean intensity and heating integrals are then accumulated in
+ *    fixed-point units, so that the radiation field is bitwise identical for
+ *    any number of threads and processes, default: ranlxd2). This only applies
+ *    to the ionizing photons; DustSimulation always uses ranlxd2.
  *  - output folder: Folder where all output files will be placed (default: .)
  *  - number of iterations: Number of iterations of the photoionization
  *    algorithm (default: 10)
@@ -99,6 +107,13 @@
  *    photoionization algorithm (default: 1e5)
  *  - number of photons first loop: Number of photons to use during the first
  *    iteration of the photoionization algorithm (default: (number of photons))
+ *  - checkpoint interval: Number of hydro steps in between successive
+ *    checkpoints, 0 means no checkpoints are written (default: 0)
+ *  - checkpoint file: Name of the checkpoint file, relative to the output
+ *    folder (default: restart.dat)
+ *
+ * If the command line argument "restart" is given, the simulation resumes from
+ * the checkpoint file with that name.
  *
  * @param parser CommandLineParser that contains the parsed command line
  * arguments.
@@ -175,6 +190,27 @@ int RadiationHydrodynamicsSimulation::do_simulation(CommandLineParser &parser,
       "RadiationHydrodynamicsSimulation:radiation time", "-1. s");
   uint_fast32_t hydro_lastrad = 0;
 
+  // with individual time steps, the system time step is set by the cell with
+  // the largest time step, while the radiation is only updated once per system
+  // time step: cells with small time steps then evolve over many substeps
+  // with a fixed ionization state
+  if (log && hydro_integrator->has_individual_timesteps() &&
+      hydro_radtime <= 0.) {
+    log->write_warning("Individual hydro time steps are used, but no "
+                       "radiation time was set. The radiation field is only "
+                       "updated once per system time step, which is set by "
+                       "the cell with the largest time step!");
+  }
+
+  // number of hydro steps in between successive checkpoints (0 means no
+  // checkpoints are written)
+  const uint_fast32_t checkpoint_interval = params.get_value< uint_fast32_t >(
+      "RadiationHydrodynamicsSimulation:checkpoint interval", 0);
+  const std::string checkpoint_file_name = params.get_value< std::string >(
+      "RadiationHydrodynamicsSimulation:checkpoint file", "restart.dat");
+  const std::string restart_file_name =
+      parser.get_value< std::string >("restart");
+
   DensityGrid *grid =
       DensityGridFactory::generate(simulation_box, params, true, log);
 
@@ -184,6 +220,9 @@ int RadiationHydrodynamicsSimulation::do_simulation(CommandLineParser &parser,
       PhotonSourceDistributionFactory::generate(params, log);
   int_fast32_t random_seed = params.get_value< int_fast32_t >(
       "RadiationHydrodynamicsSimulation:random seed", 42);
+  const bool counter_based_random_generator =
+      RandomGenerator::is_counter_based_type(params.get_value< std::string >(
+          "RadiationHydrodynamicsSimulation:random generator", "ranlxd2"));
   PhotonSourceSpectrum *spectrum = PhotonSourceSpectrumFactory::generate(
       "PhotonSourceSpectrum", params, log);
 
@@ -294,13 +333,16 @@ int RadiationHydrodynamicsSimulation::do_simulation(CommandLineParser &parser,
                       workdistributor.get_worksize_string(),
                       " for photon shooting.");
   }
-  IonizationPhotonShootJobMarket photonshootjobs(source, random_seed, *grid, 0,
-                                                 100, worksize);
+  IonizationPhotonShootJobMarket photonshootjobs(
+      source, random_seed, *grid, 0, 100, worksize,
+      counter_based_random_generator);
+  grid->set_reproducible_accumulation(counter_based_random_generator);
 
   // initialize the hydro variables (before we write the initial snapshot)
   hydro_integrator->initialize_hydro_variables(*grid);
 
-  if (write_output) {
+  // when restarting, the initial snapshot was written by the original run
+  if (write_output && restart_file_name.empty()) {
     writer->write(*grid, 0, params);
   }
 
@@ -314,6 +356,24 @@ int RadiationHydrodynamicsSimulation::do_simulation(CommandLineParser &parser,
                     maximum_timestep);
   bool has_next_step = true;
   uint_fast32_t num_step = 0;
+
+  if (!restart_file_name.empty()) {
+    if (log) {
+      log->write_status("Resuming simulation from restart file \"",
+                        restart_file_name, "\"...");
+    }
+    RestartReader restart_reader(restart_file_name);
+    num_step = restart_reader.read< uint_fast32_t >();
+    hydro_lastsnap = restart_reader.read< uint_fast32_t >();
+    hydro_lastrad = restart_reader.read< uint_fast32_t >();
+    timeline.read_restart_file(restart_reader);
+    grid->read_restart_file(restart_reader);
+    photonshootjobs.read_restart_file(restart_reader);
+    if (log) {
+      log->write_status("Done. Continuing from hydro step ", num_step, ".");
+    }
+  }
+
   while (has_next_step) {
     double requested_timestep = hydro_integrator->get_maximal_timestep(*grid);
     double actual_timestep, current_time;
@@ -371,6 +431,7 @@ int RadiationHydrodynamicsSimulation::do_simulation(CommandLineParser &parser,
       worktimer.start();
       start_parallel_timing_block();
       workdistributor.do_in_parallel(photonshootjobs);
+      grid->reduce_thread_accumulators(worksize);
       stop_parallel_timing_block();
       worktimer.stop();
 
@@ -394,6 +455,13 @@ int RadiationHydrodynamicsSimulation::do_simulation(CommandLineParser &parser,
 
     hydro_integrator->do_hydro_step(*grid, actual_timestep, serial_timer,
                                     parallel_timer);
+    if (log && hydro_integrator->has_individual_timesteps()) {
+      log->write_info("Hydro step used ",
+                      hydro_integrator->get_last_number_of_substeps(),
+                      " substeps and ",
+                      hydro_integrator->get_last_number_of_cell_updates(),
+                      " cell updates.");
+    }
 
     // write snapshot
     // we don't write if this is the last snapshot, because then it is written
@@ -403,6 +471,24 @@ int RadiationHydrodynamicsSimulation::do_simulation(CommandLineParser &parser,
       writer->write(*grid, hydro_lastsnap, params, current_time);
       ++hydro_lastsnap;
     }
+
+    if (checkpoint_interval > 0 && num_step % checkpoint_interval == 0 &&
+        has_next_step) {
+      // make sure all snapshots up to this point are on disk before the
+      // checkpoint that assumes they exist is written
+      writer->flush();
+      if (log) {
+        log->write_status("Writing checkpoint...");
+      }
+      RestartWriter restart_writer(output_folder + "/" + checkpoint_file_name);
+      restart_writer.write(num_step);
+      restart_writer.write(hydro_lastsnap);
+      restart_writer.write(hydro_lastrad);
+      timeline.write_restart_file(restart_writer);
+      grid->write_restart_file(restart_writer);
+      photonshootjobs.write_restart_file(restart_writer);
+      restart_writer.finalize();
+    }
   }
 
   // write snapshot
@@ -26,15 +26,48 @@
 #ifndef RANDOMGENERATOR_HPP
 #define RANDOMGENERATOR_HPP
 
+#include "Error.hpp"
+#include "RestartReader.hpp"
+#include "RestartWriter.hpp"
+
 #include <cstdint>
+#include <string>
 
 /**
  * @brief Own implementation of the GSL ranlxd2 random generator.
  *
  * Based on http://git.savannah.gnu.org/cgit/gsl.git/tree/rng/ranlxd.c.
+ *
+ * Alternatively, the generator can use the counter-based Philox4x32-10
+ * generator of Salmon, J. K., Moraes, M. A., Dror, R. O. & Shaw, D. E. 2011,
+ * Proceedings of the International Conference for High Performance Computing,
+ * Networking, Storage and Analysis, 16
+ * (https://doi.org/10.1145/2063384.2063405). This generator has no sequential
+ * state: every random number is a bijective function of a key (the seed) and
+ * a counter. The counter contains a 64-bit stream index, so that the random
+ * numbers used for e.g. a single photon packet can be made to depend on the
+ * index of that photon packet only, and not on the thread that happens to
+ * process it.
  */
 class RandomGenerator {
 private:
+  /*! @brief Use the counter-based Philox4x32-10 generator instead of the
+   *  ranlxd2 generator? */
+  bool _counter_based;
+
+  /*! @brief Philox4x32-10 key: seed and substream index. */
+  uint32_t _philox_key[2];
+
+  /*! @brief Philox4x32-10 counter: 64-bit position within the stream and
+   *  64-bit stream index. */
+  uint32_t _philox_counter[4];
+
+  /*! @brief Random numbers generated from the last Philox4x32-10 block. */
+  double _philox_buffer[2];
+
+  /*! @brief Index of the next unused random number in the buffer. */
+  uint_fast32_t _philox_buffer_index;
+
   /*! @brief ranlxd2 state variables. */
   double _xdbl[12];
 
@@ -149,6 +182,44 @@ private:
     _carry = carry;
   }
 
+  /**
+   * @brief Generate the next block of Philox4x32-10 random numbers.
+   *
+   * The 4 32-bit output words are combined into 2 random double precision
+   * values with 53 random bits each. Afterwards, the position counter is
+   * incremented.
+   */
+  inline void generate_philox_block() {
+    uint32_t counter[4] = {_philox_counter[0], _philox_counter[1],
+                           _philox_counter[2], _philox_counter[3]};
+    uint32_t key[2] = {_philox_key[0], _philox_key[1]};
+    for (uint_fast8_t round = 0; round < 10; ++round) {
+      const uint64_t product0 = uint64_t(0xD2511F53) * counter[0];
+      const uint64_t product1 = uint64_t(0xCD9E8D57) * counter[2];
+      const uint32_t new_counter[4] = {
+          uint32_t(product1 >> 32) ^ counter[1] ^ key[0], uint32_t(product1),
+          uint32_t(product0 >> 32) ^ counter[3] ^ key[1], uint32_t(product0)};
+      counter[0] = new_counter[0];
+      counter[1] = new_counter[1];
+      counter[2] = new_counter[2];
+      counter[3] = new_counter[3];
+      key[0] += 0x9E3779B9;
+      key[1] += 0xBB67AE85;
+    }
+
+    const double norm = 1. / 9007199254740992.;
+    _philox_buffer[0] =
+        norm * (((uint64_t(counter[0]) << 32) | counter[1]) >> 11);
+    _philox_buffer[1] =
+        norm * (((uint64_t(counter[2]) << 32) | counter[3]) >> 11);
+    _philox_buffer_index = 0;
+
+    ++_philox_counter[0];
+    if (_philox_counter[0] == 0) {
+      ++_philox_counter[1];
+    }
+  }
+
 public:
   /**
    * @brief Set a new seed for the random generator.
@@ -159,6 +230,9 @@ public:
     int_fast32_t ibit, jbit, i, k, m, xbit[31];
     double x, y;
 
+    // the counter-based generator uses the seed as (first half of the) key
+    _philox_key[0] = seed;
+
     if (seed == 0) {
       // the default seed is 1, not 0
       seed = 1;
@@ -194,14 +268,74 @@ public:
     _ir_old = 0;
     // we implement the ranlxs2 generator
     _pr = 397;
+
+    set_stream(0);
+  }
+
+  /**
+   * @brief Switch to the stream with the given index.
+   *
+   * This resets the counter-based generator to the start of the stream with
+   * the given index and substream index. The random numbers in every stream
+   * are independent of those in all other streams, and only depend on the
+   * seed and the stream and substream index.
+   *
+   * The ranlxd2 generator only has a single stream, so that this function
+   * does nothing if the generator is not counter-based.
+   *
+   * @param stream Stream index.
+   * @param substream Substream index. Can be used to create multiple
+   * independent streams with the same stream index.
+   */
+  inline void set_stream(const uint_fast64_t stream,
+                         const uint_fast32_t substream = 0) {
+    _philox_key[1] = substream;
+    _philox_counter[0] = 0;
+    _philox_counter[1] = 0;
+    _philox_counter[2] = stream;
+    _philox_counter[3] = stream >> 32;
+    // make sure the next call generates a new block
+    _philox_buffer_index = 2;
   }
 
+  /**
+   * @brief Check whether the RandomGenerator type with the given name is
+   * counter-based.
+   *
+   * @param type RandomGenerator type name ("ranlxd2" or "Philox").
+   * @return True if the type is counter-based.
+   */
+  inline static bool is_counter_based_type(const std::string &type) {
+    if (type == "ranlxd2") {
+      return false;
+    } else if (type == "Philox") {
+      return true;
+    } else {
+      cmac_error("Unknown RandomGenerator type: \"%s\"!", type.c_str());
+      return false;
+    }
+  }
+
+  /**
+   * @brief Is this a counter-based generator?
+   *
+   * @return True if the generator uses the Philox4x32-10 algorithm, false if it
+   * uses the ranlxd2 algorithm.
+   */
+  inline bool is_counter_based() const { return _counter_based; }
+
   /**
    * @brief Constructor.
    *
    * @param seed Initial seed for the random number generator.
+   * @param counter_based Use the counter-based Philox4x32-10 generator instead
+   * of the ranlxd2 generator?
    */
-  inline RandomGenerator(int_fast32_t seed = 42) { set_seed(seed); }
+  inline RandomGenerator(int_fast32_t seed = 42,
+                         const bool counter_based = false)
+      : _counter_based(counter_based) {
+    set_seed(seed);
+  }
 
   /**
    * @brief Get a uniform random double precision floating point value in the
@@ -212,6 +346,13 @@ public:
    * @return Random double precision floating point value.
    */
   inline double get_uniform_random_double() {
+    if (_counter_based) {
+      if (_philox_buffer_index == 2) {
+        generate_philox_block();
+      }
+      return _philox_buffer[_philox_buffer_index++];
+    }
+
     _ir = (_ir + 1) % 12;
 
     if (_ir == _ir_old) {
@@ -229,6 +370,62 @@ public:
   inline int_fast32_t get_random_integer() {
     return get_uniform_random_double() * 2147483648.0;
   }
+
+  /**
+   * @brief Write the internal state of the RandomGenerator to the given
+   * RestartWriter.
+   *
+   * @param restart_writer RestartWriter to write to.
+   */
+  inline void write_restart_file(RestartWriter &restart_writer) const {
+    for (uint_fast8_t i = 0; i < 12; ++i) {
+      restart_writer.write(_xdbl[i]);
+    }
+    restart_writer.write(_carry);
+    restart_writer.write(_ir);
+    restart_writer.write(_jr);
+    restart_writer.write(_ir_old);
+    restart_writer.write(_pr);
+    restart_writer.write(_counter_based);
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+      restart_writer.write(_philox_key[i]);
+    }
+    for (uint_fast8_t i = 0; i < 4; ++i) {
+      restart_writer.write(_philox_counter[i]);
+    }
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+      restart_writer.write(_philox_buffer[i]);
+    }
+    restart_writer.write(_philox_buffer_index);
+  }
+
+  /**
+   * @brief Restore the internal state of the RandomGenerator from the given
+   * RestartReader.
+   *
+   * @param restart_reader RestartReader to read from.
+   */
+  inline void read_restart_file(RestartReader &restart_reader) {
+    for (uint_fast8_t i = 0; i < 12; ++i) {
+      _xdbl[i] = restart_reader.read< double >();
+    }
+    _carry = restart_reader.read< double >();
+    _ir = restart_reader.read< uint_fast32_t >();
+    _jr = restart_reader.read< uint_fast32_t >();
+    _ir_old = restart_reader.read< uint_fast32_t >();
+    _pr = restart_reader.read< uint_fast32_t >();
+    _counter_based = restart_reader.read< bool >();
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+      _philox_key[i] = restart_reader.read< uint32_t >();
+    }
+    for (uint_fast8_t i = 0; i < 4; ++i) {
+      _philox_counter[i] = restart_reader.read< uint32_t >();
+    }
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+      _philox_buffer[i] = restart_reader.read< double >();
+    }
+    _philox_buffer_index = restart_reader.read< uint_fast32_t >();
+  }
 };
 
 #endif // RANDOMGENERATOR_HPP
@@ -23,6 +23,8 @@
  *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
+#ifndef RECOMBINATIONRATESFACTORY_HPP
+#define RECOMBINATIONRATESFACTORY_HPP
 
 #include "Error.hpp"
 #include "Log.hpp"
@@ -31,6 +33,7 @@
 
 // implementations
 #include "FixedValueRecombinationRates.hpp"
+#include "TabulatedRecombinationRates.hpp"
 #include "VernerRecombinationRates.hpp"
 
 /**
@@ -38,12 +41,39 @@
  */
 class RecombinationRatesFactory {
 public:
+  /**
+   * @brief Generate a RecombinationRates instance of the given type.
+   *
+   * @param type Type of RecombinationRates instance to generate.
+   * @param params ParameterFile to read from.
+   * @param log Log to write logging info to.
+   * @return Pointer to a newly created RecombinationRates implementation.
+   * Memory management for the pointer needs to be done by the calling routine.
+   */
+  static RecombinationRates *
+  generate_from_type(std::string type, ParameterFile &params,
+                     Log *log = nullptr) {
+
+    if (type == "FixedValue") {
+      return new FixedValueRecombinationRates(params);
+    } else if (type == "Tabulated") {
+      return new TabulatedRecombinationRates(params, log);
+    } else if (type == "Verner") {
+      return new VernerRecombinationRates();
+    } else {
+      cmac_error("Unknown RecombinationRates type: \"%s\"!", type.c_str());
+      return nullptr;
+    }
+  }
+
   /**
    * @brief Generate a RecombinationRates instance based on the type chosen in
    * the parameter file.
    *
    * Supported types are (default: Verner):
    *  - FixedValue: implementation that uses user specified recombination rates.
+   *  - Tabulated: Implementation that interpolates on precomputed tables of
+   *    another RecombinationRates implementation.
    *  - Verner: Implementation that uses the Verner & Ferland (1996)
    *    recombination rates.
    *
@@ -62,13 +92,8 @@ public:
       log->write_info("Requested RecombinationRates type: ", type);
     }
 
-    if (type == "FixedValue") {
-      return new FixedValueRecombinationRates(params);
-    } else if (type == "Verner") {
-      return new VernerRecombinationRates();
-    } else {
-      cmac_error("Unknown RecombinationRates type: \"%s\"!", type.c_str());
-      return nullptr;
-    }
+    return generate_from_type(type, params, log);
   }
 };
+
+#endif // RECOMBINATIONRATESFACTORY_HPP
@@ -0,0 +1,149 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file RestartReader.hpp
+ *
+ * @brief Binary input file used to resume a simulation from a restart file
+ * written by a RestartWriter.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef RESTARTREADER_HPP
+#define RESTARTREADER_HPP
+
+#include "Error.hpp"
+#include "RestartWriter.hpp"
+
+#include <cinttypes>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Binary input file used to resume a simulation from a restart file
+ * written by a RestartWriter.
+ *
+ * Values need to be read in exactly the same order as they were written.
+ */
+class RestartReader {
+private:
+  /*! @brief Name of the restart file. */
+  const std::string _filename;
+
+  /*! @brief Input file. */
+  std::ifstream _file;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param filename Name of the restart file.
+   */
+  inline RestartReader(const std::string filename)
+      : _filename(filename), _file(filename, std::ios::binary) {
+
+    if (!_file.good()) {
+      cmac_error("Unable to open restart file \"%s\"!", _filename.c_str());
+    }
+
+    const std::string tag = read_string();
+    if (tag != RESTARTFILE_TAG) {
+      cmac_error("\"%s\" is not a restart file!", _filename.c_str());
+    }
+    const uint_fast32_t version = read< uint_fast32_t >();
+    if (version != RESTARTFILE_VERSION) {
+      cmac_error("Restart file \"%s\" has the wrong version (%" PRIuFAST32
+                 ", expected %i)!",
+                 _filename.c_str(), version, RESTARTFILE_VERSION);
+    }
+  }
+
+  /**
+   * @brief Read a value from the file.
+   *
+   * @return Value that was read.
+   */
+  template < typename _datatype_ > inline _datatype_ read() {
+    _datatype_ value;
+    _file.read(reinterpret_cast< char * >(&value), sizeof(_datatype_));
+    if (!_file.good()) {
+      cmac_error("Error while reading restart file \"%s\"!", _filename.c_str());
+    }
+    return value;
+  }
+
+  /**
+   * @brief Read an array from the file.
+   *
+   * @param values Array to read into. The array is resized to the size of the
+   * array in the file.
+   */
+  template < typename _datatype_ >
+  inline void read(std::vector< _datatype_ > &values) {
+    const uint_fast64_t size = read< uint_fast64_t >();
+    const uint_fast64_t element_size = read< uint_fast64_t >();
+    if (element_size != sizeof(_datatype_)) {
+      cmac_error("Wrong element size in restart file \"%s\" (%" PRIuFAST64
+                 ", expected %zu)! Was the file written using a different "
+                 "configuration?",
+                 _filename.c_str(), element_size, sizeof(_datatype_));
+    }
+    values.resize(size);
+    if (size > 0) {
+      _file.read(reinterpret_cast< char * >(values.data()),
+                 size * sizeof(_datatype_));
+      if (!_file.good()) {
+        cmac_error("Error while reading restart file \"%s\"!",
+                   _filename.c_str());
+      }
+    }
+  }
+
+  /**
+   * @brief Read an array with a known size from the file.
+   *
+   * @param values Array to read into. Its size should match the size of the
+   * array in the file.
+   */
+  template < typename _datatype_ >
+  inline void read_fixed_size(std::vector< _datatype_ > &values) {
+    const size_t expected_size = values.size();
+    read(values);
+    if (values.size() != expected_size) {
+      cmac_error("Wrong array size in restart file \"%s\" (%zu, expected "
+                 "%zu)! Was the file written for a different setup?",
+                 _filename.c_str(), values.size(), expected_size);
+    }
+  }
+
+  /**
+   * @brief Read a string from the file.
+   *
+   * @return String that was read.
+   */
+  inline std::string read_string() {
+    std::vector< char > characters;
+    read(characters);
+    return std::string(characters.begin(), characters.end());
+  }
+};
+
+#endif // RESTARTREADER_HPP
@@ -0,0 +1,181 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file RestartWriter.hpp
+ *
+ * @brief Binary output file used to store the state of a simulation, so that
+ * it can be resumed later on.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef RESTARTWRITER_HPP
+#define RESTARTWRITER_HPP
+
+#include "Error.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*! @brief Tag that identifies a restart file. */
+#define RESTARTFILE_TAG "CMacIonize restart file"
+
+/*! @brief Version of the restart file format. Should be increased every time
+ *  the layout of the restart file changes. */
+#define RESTARTFILE_VERSION 2
+
+/**
+ * @brief Binary output file used to store the state of a simulation, so that
+ * it can be resumed later on.
+ *
+ * Values are written in the native binary representation, which means restart
+ * files can only be read on the same system, using the same code version and
+ * configuration.
+ *
+ * To make sure a crash during the writing of a restart file does not corrupt
+ * an existing restart file with the same name, all output is written to a
+ * temporary file, which only replaces the actual restart file when finalize()
+ * is called and all output was successfully written. A writer that is
+ * destroyed without being finalized discards its temporary file.
+ */
+class RestartWriter {
+private:
+  /*! @brief Name of the restart file. */
+  const std::string _filename;
+
+  /*! @brief Name of the temporary file that is actually written. */
+  const std::string _temporary_filename;
+
+  /*! @brief Temporary output file. */
+  std::ofstream _file;
+
+  /*! @brief Has the temporary file been moved to its final location? */
+  bool _finalized;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param filename Name of the restart file.
+   */
+  inline RestartWriter(const std::string filename)
+      : _filename(filename), _temporary_filename(filename + ".tmp"),
+        _file(_temporary_filename, std::ios::binary), _finalized(false) {
+
+    if (!_file.good()) {
+      cmac_error("Unable to open restart file \"%s\"!",
+                 _temporary_filename.c_str());
+    }
+
+    write(std::string(RESTARTFILE_TAG));
+    write(uint_fast32_t(RESTARTFILE_VERSION));
+  }
+
+  /**
+   * @brief Destructor.
+   *
+   * If the writer was not finalized, the temporary file is discarded, so that
+   * an existing restart file is left untouched.
+   */
+  inline ~RestartWriter() {
+    if (!_finalized) {
+      _file.close();
+      std::remove(_temporary_filename.c_str());
+    }
+  }
+
+  /**
+   * @brief Flush and close the temporary file and move it to its final
+   * location.
+   *
+   * The existing restart file is only replaced if all output was successfully
+   * written to disk. No more values can be written after this method has been
+   * called.
+   */
+  inline void finalize() {
+    cmac_assert(!_finalized);
+    _file.flush();
+    if (!_file.good()) {
+      cmac_error("Error while writing restart file \"%s\"!",
+                 _temporary_filename.c_str());
+    }
+    _file.close();
+    if (_file.fail()) {
+      cmac_error("Error while closing restart file \"%s\"!",
+                 _temporary_filename.c_str());
+    }
+    if (std::rename(_temporary_filename.c_str(), _filename.c_str()) != 0) {
+      cmac_error("Unable to move \"%s\" to \"%s\"!",
+                 _temporary_filename.c_str(), _filename.c_str());
+    }
+    _finalized = true;
+  }
+
+  /**
+   * @brief Write the given value to the file.
+   *
+   * @param value Value to write. Should be a type that can be safely copied
+   * using memcpy.
+   */
+  template < typename _datatype_ > inline void write(const _datatype_ &value) {
+    _file.write(reinterpret_cast< const char * >(&value), sizeof(_datatype_));
+    if (!_file.good()) {
+      cmac_error("Error while writing restart file \"%s\"!",
+                 _temporary_filename.c_str());
+    }
+  }
+
+  /**
+   * @brief Write the given array to the file.
+   *
+   * We write the size of the array and the size of its elements before the
+   * actual data, so that the reader can check that the array has the expected
+   * layout.
+   *
+   * @param values Array to write. The element type should be a type that can be
+   * safely copied using memcpy.
+   */
+  template < typename _datatype_ >
+  inline void write(const std::vector< _datatype_ > &values) {
+    write(uint_fast64_t(values.size()));
+    write(uint_fast64_t(sizeof(_datatype_)));
+    if (values.size() > 0) {
+      _file.write(reinterpret_cast< const char * >(values.data()),
+                  values.size() * sizeof(_datatype_));
+      if (!_file.good()) {
+        cmac_error("Error while writing restart file \"%s\"!",
+                   _temporary_filename.c_str());
+      }
+    }
+  }
+
+  /**
+   * @brief Write the given string to the file.
+   *
+   * @param value String to write.
+   */
+  inline void write(const std::string &value) {
+    write(std::vector< char >(value.begin(), value.end()));
+  }
+};
+
+#endif // RESTARTWRITER_HPP
@@ -34,6 +34,15 @@
 #include <algorithm>
 #include <cmath>
 
+/*! @brief Number of interfaces that are processed simultaneously by
+ *  RiemannSolver::solve_batch. */
+#define RIEMANNSOLVER_BATCH_SIZE 16
+
+/*! @brief Maximum number of Newton-Raphson iterations used by
+ *  RiemannSolver::solve_batch before a lane is handed over to the scalar
+ *  solver. */
+#define RIEMANNSOLVER_BATCH_MAX_ITERATION 20
+
 /**
  * @brief Exact Riemann solver.
  */
@@ -779,6 +788,79 @@ private:
     }
   }
 
+  /**
+   * @brief Approximate HLLC Riemann solver.
+   *
+   * We use the pressure based wave speed estimates of Toro (2009), section
+   * 10.6. This solver is only used for interfaces with small jumps, for which
+   * the approximate solution is very close to the exact solution.
+   *
+   * @param rhoL Density of the left state.
+   * @param uL Velocity of the left state.
+   * @param PL Pressure of the left state.
+   * @param aL Soundspeed of the left state.
+   * @param rhoR Density of the right state.
+   * @param uR Velocity of the right state.
+   * @param PR Pressure of the right state.
+   * @param aR Soundspeed of the right state.
+   * @param rhosol Density solution.
+   * @param usol Velocity solution.
+   * @param Psol Pressure solution.
+   * @param dxdt Point in velocity space where we want to sample the solution.
+   * @return Flag indicating wether the left state (-1) or the right state (1)
+   * was sampled.
+   */
+  inline int_fast32_t solve_hllc(double rhoL, double uL, double PL, double aL,
+                                 double rhoR, double uR, double PR, double aR,
+                                 double &rhosol, double &usol, double &Psol,
+                                 double dxdt) const {
+    // primitive variable estimate for the middle state pressure
+    const double Ppv = std::max(0., 0.5 * (PL + PR) -
+                                        0.125 * (uR - uL) * (rhoL + rhoR) *
+                                            (aL + aR));
+    double qL = 1.;
+    if (Ppv > PL) {
+      qL = std::sqrt(1. + _gp1d2g * (Ppv / PL - 1.));
+    }
+    double qR = 1.;
+    if (Ppv > PR) {
+      qR = std::sqrt(1. + _gp1d2g * (Ppv / PR - 1.));
+    }
+    const double SL = uL - aL * qL;
+    const double SR = uR + aR * qR;
+    const double rhoLfac = rhoL * (SL - uL);
+    const double rhoRfac = rhoR * (SR - uR);
+    const double Sstar =
+        (PR - PL + rhoLfac * uL - rhoRfac * uR) / (rhoLfac - rhoRfac);
+    if (Sstar < dxdt) {
+      if (dxdt < SR) {
+        /// right middle state
+        rhosol = rhoRfac / (SR - Sstar);
+        usol = Sstar;
+        Psol = PR + rhoRfac * (Sstar - uR);
+      } else {
+        /// right state
+        rhosol = rhoR;
+        usol = uR;
+        Psol = PR;
+      }
+      return 1;
+    } else {
+      if (dxdt > SL) {
+        /// left middle state
+        rhosol = rhoLfac / (SL - Sstar);
+        usol = Sstar;
+        Psol = PL + rhoLfac * (Sstar - uL);
+      } else {
+        /// left state
+        rhosol = rhoL;
+        usol = uL;
+        Psol = PL;
+      }
+      return -1;
+    }
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -921,6 +1003,215 @@ public:
       return -1;
     }
   }
+
+  /**
+   * @brief Solve the Riemann problem for a batch of interfaces at once.
+   *
+   * The interfaces are processed in blocks of RIEMANNSOLVER_BATCH_SIZE. For
+   * every block, we first classify the lanes: lanes that involve vacuum are
+   * handed over to the scalar solver, lanes with a pressure ratio and velocity
+   * jump below the given HLLC threshold are solved using the approximate HLLC
+   * solver, and all other lanes are solved using a fixed structure Newton-
+   * Raphson iteration for the middle state pressure that is applied to all
+   * lanes simultaneously. Lanes that have converged are masked out of the
+   * iteration; lanes that do not converge within
+   * RIEMANNSOLVER_BATCH_MAX_ITERATION iterations are handed over to the
+   * (more robust) scalar solver.
+   *
+   * @param number_of_interfaces Number of interfaces to solve.
+   * @param rhoL Left state densities.
+   * @param uL Left state velocities.
+   * @param PL Left state pressures.
+   * @param rhoR Right state densities.
+   * @param uR Right state velocities.
+   * @param PR Right state pressures.
+   * @param rhosol Density solutions.
+   * @param usol Velocity solutions.
+   * @param Psol Pressure solutions.
+   * @param flags Flags signaling whether the left state (-1), the right state
+   * (1), or a vacuum state (0) was sampled (can be a nullptr).
+   * @param hllc_threshold Maximum pressure ratio between the left and right
+   * state for which the approximate HLLC solver is used; the absolute velocity
+   * jump should also be smaller than this value minus one, in units of the
+   * smallest soundspeed (a value smaller than 1 disables the HLLC solver).
+   * @param dxdt Point in velocity space where we want to sample the solution.
+   */
+  inline void solve_batch(const size_t number_of_interfaces, const double *rhoL,
+                          const double *uL, const double *PL,
+                          const double *rhoR, const double *uR,
+                          const double *PR, double *rhosol, double *usol,
+                          double *Psol, int_fast32_t *flags = nullptr,
+                          const double hllc_threshold = 0.,
+                          const double dxdt = 0.) const {
+
+    // lane types
+    const uint_fast8_t lane_exact = 0;
+    const uint_fast8_t lane_hllc = 1;
+    const uint_fast8_t lane_scalar = 2;
+
+    // per lane variables for a single block
+    uint_fast8_t type[RIEMANNSOLVER_BATCH_SIZE];
+    double aL[RIEMANNSOLVER_BATCH_SIZE], aR[RIEMANNSOLVER_BATCH_SIZE];
+    double AL[RIEMANNSOLVER_BATCH_SIZE], AR[RIEMANNSOLVER_BATCH_SIZE];
+    double BL[RIEMANNSOLVER_BATCH_SIZE], BR[RIEMANNSOLVER_BATCH_SIZE];
+    double PLinv[RIEMANNSOLVER_BATCH_SIZE], PRinv[RIEMANNSOLVER_BATCH_SIZE];
+    double aLfac[RIEMANNSOLVER_BATCH_SIZE], aRfac[RIEMANNSOLVER_BATCH_SIZE];
+    double rhoLaLinv[RIEMANNSOLVER_BATCH_SIZE];
+    double rhoRaRinv[RIEMANNSOLVER_BATCH_SIZE];
+    double udiff[RIEMANNSOLVER_BATCH_SIZE], Pmin[RIEMANNSOLVER_BATCH_SIZE];
+    double Pstar[RIEMANNSOLVER_BATCH_SIZE];
+    // the convergence mask has the same width as a double, so that the
+    // Newton-Raphson loop below can be vectorised using a single vector mode
+    uint_fast64_t converged[RIEMANNSOLVER_BATCH_SIZE];
+
+    for (size_t ibatch = 0; ibatch < number_of_interfaces;
+         ibatch += RIEMANNSOLVER_BATCH_SIZE) {
+
+      const size_t batch_size = std::min(
+          static_cast< size_t >(RIEMANNSOLVER_BATCH_SIZE),
+          number_of_interfaces - ibatch);
+      const double *const brhoL = rhoL + ibatch;
+      const double *const buL = uL + ibatch;
+      const double *const bPL = PL + ibatch;
+      const double *const brhoR = rhoR + ibatch;
+      const double *const buR = uR + ibatch;
+      const double *const bPR = PR + ibatch;
+
+      // classify the lanes and precompute the lane variables
+      for (size_t i = 0; i < batch_size; ++i) {
+        if (brhoL[i] == 0. || brhoR[i] == 0.) {
+          type[i] = lane_scalar;
+          // make sure the Newton-Raphson iteration below does not produce
+          // invalid values for this lane
+          aL[i] = aR[i] = AL[i] = AR[i] = BL[i] = BR[i] = 1.;
+          PLinv[i] = PRinv[i] = aLfac[i] = aRfac[i] = 1.;
+          rhoLaLinv[i] = rhoRaRinv[i] = udiff[i] = Pmin[i] = 1.;
+          continue;
+        }
+        aL[i] = get_soundspeed(brhoL[i], bPL[i]);
+        aR[i] = get_soundspeed(brhoR[i], bPR[i]);
+        aLfac[i] = _tdgm1 * aL[i];
+        aRfac[i] = _tdgm1 * aR[i];
+        udiff[i] = buR[i] - buL[i];
+        AL[i] = _tdgp1 / brhoL[i];
+        BL[i] = _gm1dgp1 * bPL[i];
+        PLinv[i] = 1. / bPL[i];
+        rhoLaLinv[i] = 1. / (brhoL[i] * aL[i]);
+        AR[i] = _tdgp1 / brhoR[i];
+        BR[i] = _gm1dgp1 * bPR[i];
+        PRinv[i] = 1. / bPR[i];
+        rhoRaRinv[i] = 1. / (brhoR[i] * aR[i]);
+        Pmin[i] = 5.e-9 * (bPL[i] + bPR[i]);
+        if (aLfac[i] + aRfac[i] <= udiff[i]) {
+          // vacuum generation
+          type[i] = lane_scalar;
+        } else {
+          const double Pratio =
+              std::max(bPL[i], bPR[i]) / std::min(bPL[i], bPR[i]);
+          if (Pratio <= hllc_threshold &&
+              std::abs(udiff[i]) <=
+                  (hllc_threshold - 1.) * std::min(aL[i], aR[i])) {
+            type[i] = lane_hllc;
+          } else {
+            type[i] = lane_exact;
+          }
+        }
+      }
+
+      // initial guesses for the middle state pressure
+      size_t num_active = 0;
+      for (size_t i = 0; i < batch_size; ++i) {
+        converged[i] = (type[i] != lane_exact);
+        if (converged[i]) {
+          Pstar[i] = 1.;
+        } else {
+          Pstar[i] = guess_P(bPL[i], aL[i], AL[i], BL[i], bPR[i], aR[i],
+                             AR[i], BR[i], udiff[i]);
+          ++num_active;
+        }
+      }
+
+      // Newton-Raphson iteration on all lanes simultaneously
+      // converged lanes are still part of the loop (to keep its structure
+      // fixed), but their result is discarded
+      // the body of this loop has no branches and no function calls other
+      // than std::sqrt and std::pow (which have vector versions if fast math
+      // is activated), so that the compiler can vectorise it: both the shock
+      // and the rarefaction expressions are evaluated for every lane, and the
+      // right one is selected afterwards
+      // note that the derivative of the rarefaction expression reuses the
+      // power computed for the function itself, since
+      // (P/PL)^(-(gamma+1)/(2gamma)) = (P/PL)^((gamma-1)/(2gamma)) / (P/PL)
+      uint_fast32_t niter = 0;
+      while (num_active > 0 && niter < RIEMANNSOLVER_BATCH_MAX_ITERATION) {
+        num_active = 0;
+        for (size_t i = 0; i < batch_size; ++i) {
+          const double P = Pstar[i];
+          const double CL = P + BL[i];
+          const double CR = P + BR[i];
+          const double sqrtL = std::sqrt(AL[i] / CL);
+          const double sqrtR = std::sqrt(AR[i] / CR);
+          const double xL = P * PLinv[i];
+          const double xR = P * PRinv[i];
+          const double powL = std::pow(xL, _gm1d2g);
+          const double powR = std::pow(xR, _gm1d2g);
+          const double dPL = P - bPL[i];
+          const double dPR = P - bPR[i];
+          const double fL =
+              (dPL > 0.) ? dPL * sqrtL : aLfac[i] * (powL - 1.);
+          const double fR =
+              (dPR > 0.) ? dPR * sqrtR : aRfac[i] * (powR - 1.);
+          const double fprimeL = (dPL > 0.)
+                                     ? (1. - 0.5 * dPL / CL) * sqrtL
+                                     : powL / xL * rhoLaLinv[i];
+          const double fprimeR = (dPR > 0.)
+                                     ? (1. - 0.5 * dPR / CR) * sqrtR
+                                     : powR / xR * rhoRaRinv[i];
+          const double Pnew =
+              std::max(Pmin[i], P - (fL + fR + udiff[i]) / (fprimeL + fprimeR));
+          const uint_fast64_t lane_converged =
+              converged[i] | (std::abs(Pnew - P) <= 5.e-9 * (Pnew + P));
+          Pstar[i] = converged[i] ? P : Pnew;
+          converged[i] = lane_converged;
+          num_active += 1 - lane_converged;
+        }
+        ++niter;
+      }
+
+      // sample the solutions
+      for (size_t i = 0; i < batch_size; ++i) {
+        const size_t j = ibatch + i;
+        int_fast32_t flag;
+        if (type[i] == lane_exact && converged[i]) {
+          const double ustar =
+              0.5 * ((buL[i] + buR[i]) +
+                     (fb(bPR[i], AR[i], BR[i], PRinv[i], aRfac[i], Pstar[i]) -
+                      fb(bPL[i], AL[i], BL[i], PLinv[i], aLfac[i], Pstar[i])));
+          if (ustar < dxdt) {
+            sample_right_state(brhoR[i], buR[i], bPR[i], aR[i], PRinv[i],
+                               ustar, Pstar[i], rhosol[j], usol[j], Psol[j],
+                               dxdt);
+            flag = 1;
+          } else {
+            sample_left_state(brhoL[i], buL[i], bPL[i], aL[i], PLinv[i],
+                              ustar, Pstar[i], rhosol[j], usol[j], Psol[j],
+                              dxdt);
+            flag = -1;
+          }
+        } else if (type[i] == lane_hllc) {
+          flag = solve_hllc(brhoL[i], buL[i], bPL[i], aL[i], brhoR[i], buR[i],
+                            bPR[i], aR[i], rhosol[j], usol[j], Psol[j], dxdt);
+        } else {
+          // vacuum or non-converged lane: use the scalar solver
+          flag = solve(brhoL[i], buL[i], bPL[i], brhoR[i], buR[i], bPR[i],
+                       rhosol[j], usol[j], Psol[j], dxdt);
+        }
+        if (flags != nullptr) {
+          flags[j] = flag;
+        }
+      }
+    }
+  }
 };
 
 #endif // RIEMANNSOLVER_HPP
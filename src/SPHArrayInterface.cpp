@@ -39,8 +39,8 @@
 SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
                                      const double unit_mass_in_SI)
     : DensityGridWriter("", nullptr), _unit_length_in_SI(unit_length_in_SI),
-      _unit_mass_in_SI(unit_mass_in_SI), _is_periodic(false), _octree(nullptr) {
-}
+      _unit_mass_in_SI(unit_mass_in_SI), _is_periodic(false), _octree(nullptr),
+      _persistent_mode(false) {}
 
 /**
  * @brief Constructor.
@@ -59,7 +59,8 @@ SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
                                      const double *box_anchor,
                                      const double *box_sides)
     : DensityGridWriter("", nullptr), _unit_length_in_SI(unit_length_in_SI),
-      _unit_mass_in_SI(unit_mass_in_SI), _is_periodic(true), _octree(nullptr) {
+      _unit_mass_in_SI(unit_mass_in_SI), _is_periodic(true), _octree(nullptr),
+      _persistent_mode(false) {
 
   _box.get_anchor()[0] = box_anchor[0] * _unit_length_in_SI;
   _box.get_anchor()[1] = box_anchor[1] * _unit_length_in_SI;
@@ -86,7 +87,8 @@ SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
                                      const float *box_anchor,
                                      const float *box_sides)
     : DensityGridWriter("", nullptr), _unit_length_in_SI(unit_length_in_SI),
-      _unit_mass_in_SI(unit_mass_in_SI), _is_periodic(true), _octree(nullptr) {
+      _unit_mass_in_SI(unit_mass_in_SI), _is_periodic(true), _octree(nullptr),
+      _persistent_mode(false) {
 
   _box.get_anchor()[0] = box_anchor[0] * _unit_length_in_SI;
   _box.get_anchor()[1] = box_anchor[1] * _unit_length_in_SI;
@@ -117,7 +119,10 @@ void SPHArrayInterface::reset(const double *x, const double *y, const double *z,
                               const double *h, const double *m,
                               const size_t npart) {
 
-  delete _octree;
+  if (!_persistent_mode || npart != _positions.size()) {
+    delete _octree;
+    _octree = nullptr;
+  }
 
   _positions.resize(npart);
   _smoothing_lengths.resize(npart, 0.);
@@ -161,7 +166,10 @@ void SPHArrayInterface::reset(const double *x, const double *y, const double *z,
                               const float *h, const float *m,
                               const size_t npart) {
 
-  delete _octree;
+  if (!_persistent_mode || npart != _positions.size()) {
+    delete _octree;
+    _octree = nullptr;
+  }
 
   _positions.resize(npart);
   _smoothing_lengths.resize(npart, 0.);
@@ -205,7 +213,10 @@ void SPHArrayInterface::reset(const float *x, const float *y, const float *z,
                               const float *h, const float *m,
                               const size_t npart) {
 
-  delete _octree;
+  if (!_persistent_mode || npart != _positions.size()) {
+    delete _octree;
+    _octree = nullptr;
+  }
 
   _positions.resize(npart);
   _smoothing_lengths.resize(npart, 0.);
@@ -238,14 +249,35 @@ void SPHArrayInterface::reset(const float *x, const float *y, const float *z,
  *
  * @return Pointer to the internal Octree.
  */
-Octree *SPHArrayInterface::get_octree() { return _octree; }
+LinearOctree *SPHArrayInterface::get_octree() { return _octree; }
+
+/**
+ * @brief Set the persistent mode flag.
+ *
+ * In persistent mode, the internal Octree is kept in between calls to reset()
+ * (provided the number of particles does not change), and is only updated for
+ * the new particle positions rather than rebuilt from scratch. This is much
+ * cheaper if the particles only moved a little bit in between calls.
+ *
+ * @param persistent_mode New value for the persistent mode flag.
+ */
+void SPHArrayInterface::set_persistent_mode(const bool persistent_mode) {
+  _persistent_mode = persistent_mode;
+}
 
 /**
  * @brief Initialize the internal Octree.
+ *
+ * If an Octree from a previous call is still present (persistent mode), it is
+ * updated rather than rebuilt.
  */
 void SPHArrayInterface::initialize() {
-  _octree = new Octree(_positions, _box, _is_periodic);
-  _octree->set_auxiliaries(_smoothing_lengths, Octree::max< double >);
+  if (_octree == nullptr) {
+    _octree = new LinearOctree(_positions, _box, _is_periodic);
+  } else {
+    _octree->update_boxes();
+  }
+  _octree->set_auxiliaries(_smoothing_lengths, LinearOctree::max< double >);
 }
 
 /**
@@ -261,22 +293,20 @@ DensityValues SPHArrayInterface::operator()(const Cell &cell) const {
   const CoordinateVector<> position = cell.get_cell_midpoint();
 
   double density = 0.;
-  const std::vector< uint_fast32_t > ngbs = _octree->get_ngbs(position);
-  const size_t numngbs = ngbs.size();
-  for (size_t i = 0; i < numngbs; ++i) {
-    const size_t index = ngbs[i];
-    double r;
-    if (!_box.get_sides().x()) {
-      r = (position - _positions[index]).norm();
-    } else {
-      r = _box.periodic_distance(position, _positions[index]).norm();
-    }
-    const double h = _smoothing_lengths[index];
-    const double u = r / h;
-    const double m = _masses[index];
-    const double splineval = m * CubicSplineKernel::kernel_evaluate(u, h);
-    density += splineval;
-  }
+  _octree->for_each_ngb(
+      position, [this, &position, &density](const uint_fast32_t index) {
+        double r;
+        if (!_box.get_sides().x()) {
+          r = (position - _positions[index]).norm();
+        } else {
+          r = _box.periodic_distance(position, _positions[index]).norm();
+        }
+        const double h = _smoothing_lengths[index];
+        const double u = r / h;
+        const double m = _masses[index];
+        const double splineval = m * CubicSplineKernel::kernel_evaluate(u, h);
+        density += splineval;
+      });
 
   values.set_number_density(density / 1.6737236e-27);
   values.set_temperature(8000.);
@@ -30,7 +30,7 @@
 #include "Box.hpp"
 #include "DensityFunction.hpp"
 #include "DensityGridWriter.hpp"
-#include "Octree.hpp"
+#include "LinearOctree.hpp"
 
 /**
  * @brief DensityFunction and DensityGridWriter implementations that are coupled
@@ -65,7 +65,11 @@ private:
   std::vector< double > _neutral_fractions;
 
   /*! @brief Octree used to speed up neighbour searching. */
-  Octree *_octree;
+  LinearOctree *_octree;
+
+  /*! @brief Persistent mode flag. If set, the Octree is reused in between
+   *  calls to reset(). */
+  bool _persistent_mode;
 
 public:
   SPHArrayInterface(const double unit_length_in_SI,
@@ -87,7 +91,9 @@ public:
   void reset(const float *x, const float *y, const float *z, const float *h,
              const float *m, const size_t npart);
 
-  Octree *get_octree();
+  LinearOctree *get_octree();
+
+  void set_persistent_mode(const bool persistent_mode);
 
   virtual void initialize();
   virtual DensityValues operator()(const Cell &cell) const;
@@ -0,0 +1,744 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file SPHGridDeposition.hpp
+ *
+ * @brief Particle-centric, mass conserving mapping of SPH particle quantities
+ * onto a DensityGrid.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef SPHGRIDDEPOSITION_HPP
+#define SPHGRIDDEPOSITION_HPP
+
+#include "Box.hpp"
+#include "Configuration.hpp"
+#include "CoordinateVector.hpp"
+#include "DensityGrid.hpp"
+#include "WorkDistributor.hpp"
+#include "WorkStealingScheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*! @brief Maximum number of quadrature points in a single dimension used to
+ *  integrate the kernel of a particle over a single cell. */
+#define SPHGRIDDEPOSITION_QUADRATURE_ORDER 4
+
+/*! @brief Maximum number of quadrature points in a single dimension used to
+ *  compute the fraction of the kernel of a particle that overlaps with the
+ *  grid, for particles that stick out of the grid. */
+#define SPHGRIDDEPOSITION_BOUNDARY_QUADRATURE_ORDER 16
+
+/**
+ * @brief Particle-centric, mass conserving mapping of SPH particle quantities
+ * onto a DensityGrid.
+ *
+ * Instead of sampling the SPH density at the midpoint of every cell (which
+ * requires a neighbour search per cell and misses particles that are smaller
+ * than a cell), we loop over the particles and deposit their kernel weighted
+ * quantities in all cells their kernel overlaps with.
+ *
+ * For every particle, we start from the cell that contains the particle and
+ * walk over the cell neighbours (DensityGrid::get_cell_geometry()) until we
+ * find no more cells whose bounding box is within the kernel support radius.
+ * For every cell we visit, the kernel is integrated over the overlap of the
+ * bounding box of the cell and the bounding cube of the kernel, using a fixed
+ * midpoint quadrature with (at most) SPHGRIDDEPOSITION_QUADRATURE_ORDER points
+ * in every dimension, and a spacing of at most the kernel support radius
+ * divided by SPHGRIDDEPOSITION_QUADRATURE_ORDER. For Cartesian and AMR cells, the bounding box is the cell. For
+ * Voronoi cells, quadrature points that are outside the cell (on the wrong side
+ * of one of the bisector planes) are discarded. Since the quadrature only
+ * covers the part of the kernel that overlaps with the cell, small cells and
+ * small particles are resolved as well as large ones.
+ *
+ * The cell weights are normalized to unity for every particle, so that the
+ * deposited mass is exactly conserved. If a periodic box is given, the
+ * periodic copies of the particle that overlap with the grid are deposited as
+ * well. Particles whose kernel sticks out of the grid (and is not covered by a
+ * periodic copy of the grid) only deposit the fraction of their kernel that
+ * overlaps with the grid, which is computed with a finer quadrature over the
+ * grid box.
+ *
+ * The particles are distributed over the threads by a WorkDistributor. Every
+ * thread deposits into its own copy of the grid values; the copies are summed
+ * afterwards in a second parallel pass over the cells.
+ */
+class SPHGridDeposition {
+private:
+  /**
+   * @brief Job that deposits a range of particles into a per-thread copy of
+   * the grid values.
+   *
+   * Every thread uses the same job for all its particle ranges, so that the
+   * per-thread copy survives until the reduction.
+   */
+  template < typename _kernel_ > class SPHGridDepositionJob {
+  private:
+    /*! @brief DensityGrid to deposit onto. */
+    const DensityGrid &_grid;
+
+    /*! @brief Positions of the particles (in m). */
+    const std::vector< CoordinateVector<> > &_positions;
+
+    /*! @brief Kernel support radii of the particles (in m). */
+    const std::vector< double > &_smoothing_lengths;
+
+    /*! @brief Quantities to deposit. */
+    const std::vector< std::vector< double > > &_quantities;
+
+    /*! @brief Kernel function. */
+    _kernel_ _kernel;
+
+    /*! @brief Periodic box. */
+    const Box<> &_periodic_box;
+
+    /*! @brief Per-thread copy of the deposited quantities, stored quantity by
+     *  quantity. */
+    std::vector< double > _local_result;
+
+    /*! @brief Cells visited by the neighbour walk of the current particle,
+     *  with the kernel integral over that cell. */
+    std::vector< std::pair< cellsize_t, double > > _overlaps;
+
+    /*! @brief Flags that mark the cells visited by the current neighbour
+     *  walk. */
+    std::vector< bool > _visited;
+
+    /*! @brief Bisector planes of the current cell. */
+    std::vector< std::pair< CoordinateVector<>, double > > _planes;
+
+    /*! @brief Neighbours of the current cell. */
+    std::vector< cellsize_t > _ngbs;
+
+    /*! @brief Empty list of planes, used to integrate over boxes. */
+    const std::vector< std::pair< CoordinateVector<>, double > > _no_planes;
+
+    /*! @brief Index of the first particle in the current range. */
+    size_t _begin;
+
+    /*! @brief Index beyond the last particle in the current range. */
+    size_t _end;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param grid DensityGrid to deposit onto.
+     * @param positions Positions of the particles (in m).
+     * @param smoothing_lengths Kernel support radii of the particles (in m).
+     * @param quantities Quantities to deposit.
+     * @param kernel Kernel function.
+     * @param periodic_box Periodic box.
+     */
+    inline SPHGridDepositionJob(
+        const DensityGrid &grid,
+        const std::vector< CoordinateVector<> > &positions,
+        const std::vector< double > &smoothing_lengths,
+        const std::vector< std::vector< double > > &quantities,
+        _kernel_ kernel, const Box<> &periodic_box)
+        : _grid(grid), _positions(positions),
+          _smoothing_lengths(smoothing_lengths), _quantities(quantities),
+          _kernel(kernel), _periodic_box(periodic_box),
+          _local_result(quantities.size() * grid.get_number_of_cells(), 0.),
+          _visited(grid.get_number_of_cells(), false), _begin(0), _end(0) {}
+
+    /**
+     * @brief Set the range of particles that is deposited by the next call to
+     * execute().
+     *
+     * @param begin Index of the first particle in the range.
+     * @param end Index beyond the last particle in the range.
+     */
+    inline void set_range(const size_t begin, const size_t end) {
+      _begin = begin;
+      _end = end;
+    }
+
+    /**
+     * @brief Get the per-thread copy of the deposited quantities.
+     *
+     * @return Deposited quantities, stored quantity by quantity.
+     */
+    inline const std::vector< double > &get_local_result() const {
+      return _local_result;
+    }
+
+    /**
+     * @brief Should the Job be deleted by the Worker when it is finished?
+     *
+     * @return False, since the per-thread copy is still needed.
+     */
+    inline bool do_cleanup() const { return false; }
+
+    /**
+     * @brief Walk over the cells the kernel of the particle with the given
+     * position overlaps with, starting from the given cell, and store the
+     * kernel integral over every cell.
+     *
+     * @param start Index of a cell that overlaps with the kernel.
+     * @param position Position of the particle (in m).
+     * @param h Kernel support radius of the particle (in m).
+     */
+    inline void walk_cells(const cellsize_t start,
+                           const CoordinateVector<> position, const double h) {
+
+      const size_t first = _overlaps.size();
+      _overlaps.push_back(std::make_pair(start, 0.));
+      _visited[start] = true;
+      Box<> bounding_box;
+      for (size_t i = first; i < _overlaps.size(); ++i) {
+        _grid.get_cell_geometry(_overlaps[i].first, bounding_box, _planes,
+                                _ngbs);
+        // cells that are outside the kernel support have a zero integral and
+        // end the walk
+        if (bounding_box.get_distance(position) >= h) {
+          continue;
+        }
+        _overlaps[i].second =
+            integrate_kernel(position, h, _kernel, bounding_box, _planes,
+                             SPHGRIDDEPOSITION_QUADRATURE_ORDER);
+        for (size_t j = 0; j < _ngbs.size(); ++j) {
+          if (!_visited[_ngbs[j]]) {
+            _visited[_ngbs[j]] = true;
+            _overlaps.push_back(std::make_pair(_ngbs[j], 0.));
+          }
+        }
+      }
+      for (size_t i = first; i < _overlaps.size(); ++i) {
+        _visited[_overlaps[i].first] = false;
+      }
+    }
+
+    /**
+     * @brief Deposit a single particle into the per-thread copy of the grid
+     * values.
+     *
+     * @param ipart Index of the particle.
+     */
+    inline void deposit_particle(const size_t ipart) {
+
+      const size_t numcell = _grid.get_number_of_cells();
+      const size_t numquantity = _quantities.size();
+      const Box<> grid_box = _grid.get_box();
+      const double h = _smoothing_lengths[ipart];
+      CoordinateVector<> position = _positions[ipart];
+
+      // in a periodic box, we also need the copies of the particle on the
+      // other side of every periodic boundary the kernel crosses
+      const bool periodic = (_periodic_box.get_sides().x() > 0.);
+      double offsets[3][3] = {{0.}, {0.}, {0.}};
+      uint_fast8_t numoffset[3] = {1, 1, 1};
+      if (periodic) {
+        position = wrap(position, _periodic_box);
+        for (uint_fast8_t i = 0; i < 3; ++i) {
+          const double anchor = _periodic_box.get_anchor()[i];
+          const double side = _periodic_box.get_sides()[i];
+          if (position[i] - h < anchor) {
+            offsets[i][numoffset[i]] = side;
+            ++numoffset[i];
+          }
+          if (position[i] + h > anchor + side) {
+            offsets[i][numoffset[i]] = -side;
+            ++numoffset[i];
+          }
+        }
+      }
+
+      // the kernel is completely covered by the grid if it does not stick out
+      // of the grid, or if it only sticks out of the grid in directions in
+      // which the grid covers the entire periodic box. If it is not, only the
+      // fraction of the kernel that overlaps with the grid is deposited.
+      bool covered = true;
+      for (uint_fast8_t i = 0; i < 3; ++i) {
+        if (position[i] - h < grid_box.get_anchor()[i] ||
+            position[i] + h >
+                grid_box.get_anchor()[i] + grid_box.get_sides()[i]) {
+          covered &= (periodic &&
+                      grid_box.get_anchor()[i] ==
+                          _periodic_box.get_anchor()[i] &&
+                      grid_box.get_sides()[i] == _periodic_box.get_sides()[i]);
+        }
+      }
+      double covered_integral = 0.;
+
+      _overlaps.clear();
+      for (uint_fast8_t ix = 0; ix < numoffset[0]; ++ix) {
+        for (uint_fast8_t iy = 0; iy < numoffset[1]; ++iy) {
+          for (uint_fast8_t iz = 0; iz < numoffset[2]; ++iz) {
+            const CoordinateVector<> image =
+                position +
+                CoordinateVector<>(offsets[0][ix], offsets[1][iy],
+                                   offsets[2][iz]);
+            if (grid_box.get_distance(image) >= h) {
+              continue;
+            }
+            // the walk starts from the cell that contains the point in the
+            // grid closest to the particle
+            CoordinateVector<> start = image;
+            for (uint_fast8_t i = 0; i < 3; ++i) {
+              const double top =
+                  grid_box.get_anchor()[i] + grid_box.get_sides()[i];
+              start[i] = std::max(start[i], grid_box.get_anchor()[i]);
+              if (start[i] >= top) {
+                start[i] = std::nextafter(top, grid_box.get_anchor()[i]);
+              }
+            }
+            walk_cells(_grid.get_cell_index(start), image, h);
+            if (!covered) {
+              covered_integral += integrate_kernel(
+                  image, h, _kernel, grid_box, _no_planes,
+                  SPHGRIDDEPOSITION_BOUNDARY_QUADRATURE_ORDER);
+            }
+          }
+        }
+      }
+
+      if (_overlaps.size() == 0) {
+        // the kernel does not overlap with the grid
+        return;
+      }
+
+      double fraction = 1.;
+      if (!covered) {
+        const Box<> kernel_box(position - CoordinateVector<>(h),
+                               CoordinateVector<>(2. * h));
+        const double total_integral = integrate_kernel(
+            position, h, _kernel, kernel_box, _no_planes,
+            SPHGRIDDEPOSITION_BOUNDARY_QUADRATURE_ORDER);
+        if (total_integral > 0.) {
+          fraction = std::min(1., covered_integral / total_integral);
+        }
+      }
+
+      double norm = 0.;
+      for (size_t i = 0; i < _overlaps.size(); ++i) {
+        norm += _overlaps[i].second;
+      }
+      if (norm <= 0.) {
+        // the kernel is too small to be resolved by the quadrature: deposit
+        // the particle in the first cell of the walk, which contains the
+        // particle (or the point of the grid closest to it)
+        _overlaps.resize(1);
+        _overlaps[0].second = 1.;
+        norm = 1.;
+      }
+      const double inverse_norm = fraction / norm;
+
+      for (size_t i = 0; i < _overlaps.size(); ++i) {
+        const cellsize_t index = _overlaps[i].first;
+        const double weight = _overlaps[i].second * inverse_norm;
+        for (size_t iq = 0; iq < numquantity; ++iq) {
+          _local_result[iq * numcell + index] +=
+              weight * _quantities[iq][ipart];
+        }
+      }
+    }
+
+    /**
+     * @brief Deposit all particles in the current range.
+     */
+    inline void execute() {
+      for (size_t ipart = _begin; ipart < _end; ++ipart) {
+        deposit_particle(ipart);
+      }
+    }
+
+    /**
+     * @brief Get a name tag for this job.
+     *
+     * @return "sphgriddeposition".
+     */
+    inline std::string get_tag() const { return "sphgriddeposition"; }
+  };
+
+  /**
+   * @brief JobMarket that distributes the particles over the
+   * SPHGridDepositionJobs of the threads.
+   */
+  template < typename _kernel_ > class SPHGridDepositionJobMarket {
+  private:
+    /*! @brief Per thread SPHGridDepositionJob. */
+    std::vector< SPHGridDepositionJob< _kernel_ > * > _jobs;
+
+    /*! @brief Number of particles. */
+    const size_t _numpart;
+
+    /*! @brief Scheduler that distributes the particles over the threads. */
+    WorkStealingScheduler _scheduler;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param grid DensityGrid to deposit onto.
+     * @param positions Positions of the particles (in m).
+     * @param smoothing_lengths Kernel support radii of the particles (in m).
+     * @param quantities Quantities to deposit.
+     * @param kernel Kernel function.
+     * @param periodic_box Periodic box.
+     * @param worksize Number of threads to use.
+     */
+    inline SPHGridDepositionJobMarket(
+        const DensityGrid &grid,
+        const std::vector< CoordinateVector<> > &positions,
+        const std::vector< double > &smoothing_lengths,
+        const std::vector< std::vector< double > > &quantities,
+        _kernel_ kernel, const Box<> &periodic_box,
+        const int_fast32_t worksize)
+        : _numpart(positions.size()), _scheduler(1.e-3, 64) {
+
+      _jobs.reserve(worksize);
+      for (int_fast32_t i = 0; i < worksize; ++i) {
+        _jobs.push_back(new SPHGridDepositionJob< _kernel_ >(
+            grid, positions, smoothing_lengths, quantities, kernel,
+            periodic_box));
+      }
+    }
+
+    /**
+     * @brief Destructor.
+     *
+     * Clean up memory used by jobs.
+     */
+    inline ~SPHGridDepositionJobMarket() {
+      for (size_t i = 0; i < _jobs.size(); ++i) {
+        delete _jobs[i];
+      }
+    }
+
+    /**
+     * @brief Set the number of parallel threads that will be used to execute
+     * the jobs.
+     *
+     * @param worksize Number of parallel threads that will be used.
+     */
+    inline void set_worksize(int_fast32_t worksize) {
+      _scheduler.reset(0, _numpart, worksize);
+    }
+
+    /**
+     * @brief Get the SPHGridDepositionJob of the given thread.
+     *
+     * @param thread_id Id of the thread that calls this function.
+     * @return Pointer to the SPHGridDepositionJob of the thread, or a null
+     * pointer if all particles have been handed out.
+     */
+    inline SPHGridDepositionJob< _kernel_ > *get_job(int_fast32_t thread_id) {
+      uint_fast64_t begin, end;
+      if (!_scheduler.get_chunk(thread_id, begin, end)) {
+        return nullptr;
+      }
+      _jobs[thread_id]->set_range(begin, end);
+      return _jobs[thread_id];
+    }
+
+    /**
+     * @brief Get the number of per-thread copies of the deposited quantities.
+     *
+     * @return Number of threads.
+     */
+    inline size_t get_number_of_local_results() const { return _jobs.size(); }
+
+    /**
+     * @brief Get the per-thread copy of the deposited quantities of the given
+     * thread.
+     *
+     * @param thread_id Id of a thread.
+     * @return Deposited quantities of that thread, stored quantity by quantity.
+     */
+    inline const std::vector< double > &
+    get_local_result(const size_t thread_id) const {
+      return _jobs[thread_id]->get_local_result();
+    }
+  };
+
+  /**
+   * @brief Job that adds the per-thread copies of the deposited quantities for
+   * a range of cells.
+   */
+  template < typename _kernel_ > class SPHGridDepositionReductionJob {
+  private:
+    /*! @brief JobMarket that holds the per-thread copies. */
+    const SPHGridDepositionJobMarket< _kernel_ > &_deposition_jobs;
+
+    /*! @brief Deposited quantities. */
+    std::vector< std::vector< double > > &_result;
+
+    /*! @brief Index of the first cell in the range. */
+    const size_t _begin;
+
+    /*! @brief Index beyond the last cell in the range. */
+    const size_t _end;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param deposition_jobs JobMarket that holds the per-thread copies.
+     * @param result Deposited quantities.
+     * @param begin Index of the first cell in the range.
+     * @param end Index beyond the last cell in the range.
+     */
+    inline SPHGridDepositionReductionJob(
+        const SPHGridDepositionJobMarket< _kernel_ > &deposition_jobs,
+        std::vector< std::vector< double > > &result, const size_t begin,
+        const size_t end)
+        : _deposition_jobs(deposition_jobs), _result(result), _begin(begin),
+          _end(end) {}
+
+    /**
+     * @brief Should the Job be deleted by the Worker when it is finished?
+     *
+     * @return True.
+     */
+    inline bool do_cleanup() const { return true; }
+
+    /**
+     * @brief Add the per-thread copies for all cells in the range.
+     */
+    inline void execute() {
+      const size_t numquantity = _result.size();
+      const size_t numthread = _deposition_jobs.get_number_of_local_results();
+      for (size_t iq = 0; iq < numquantity; ++iq) {
+        std::vector< double > &values = _result[iq];
+        const size_t numcell = values.size();
+        for (size_t ithread = 0; ithread < numthread; ++ithread) {
+          const double *thread_values =
+              &_deposition_jobs.get_local_result(ithread)[iq * numcell];
+          for (size_t icell = _begin; icell < _end; ++icell) {
+            values[icell] += thread_values[icell];
+          }
+        }
+      }
+    }
+
+    /**
+     * @brief Get a name tag for this job.
+     *
+     * @return "sphgriddeposition_reduction".
+     */
+    inline std::string get_tag() const { return "sphgriddeposition_reduction"; }
+  };
+
+  /**
+   * @brief JobMarket that spawns SPHGridDepositionReductionJobs that together
+   * cover all cells of the grid.
+   */
+  template < typename _kernel_ > class SPHGridDepositionReductionJobMarket {
+  private:
+    /*! @brief JobMarket that holds the per-thread copies. */
+    const SPHGridDepositionJobMarket< _kernel_ > &_deposition_jobs;
+
+    /*! @brief Deposited quantities. */
+    std::vector< std::vector< double > > &_result;
+
+    /*! @brief Number of cells. */
+    const size_t _numcell;
+
+    /*! @brief Scheduler that distributes the cells over the threads. */
+    WorkStealingScheduler _scheduler;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param deposition_jobs JobMarket that holds the per-thread copies.
+     * @param result Deposited quantities.
+     * @param numcell Number of cells.
+     */
+    inline SPHGridDepositionReductionJobMarket(
+        const SPHGridDepositionJobMarket< _kernel_ > &deposition_jobs,
+        std::vector< std::vector< double > > &result, const size_t numcell)
+        : _deposition_jobs(deposition_jobs), _result(result),
+          _numcell(numcell), _scheduler(1.e-3, 1000) {}
+
+    /**
+     * @brief Set the number of parallel threads that will be used to execute
+     * the jobs.
+     *
+     * @param worksize Number of parallel threads that will be used.
+     */
+    inline void set_worksize(int_fast32_t worksize) {
+      _scheduler.reset(0, _numcell, worksize);
+    }
+
+    /**
+     * @brief Get a SPHGridDepositionReductionJob.
+     *
+     * @param thread_id Id of the thread that calls this function.
+     * @return Pointer to a unique and thread safe
+     * SPHGridDepositionReductionJob instance (or a null pointer if all cells
+     * have been handed out).
+     */
+    inline SPHGridDepositionReductionJob< _kernel_ > *
+    get_job(int_fast32_t thread_id) {
+      uint_fast64_t begin, end;
+      if (!_scheduler.get_chunk(thread_id, begin, end)) {
+        return nullptr;
+      }
+      return new SPHGridDepositionReductionJob< _kernel_ >(_deposition_jobs,
+                                                           _result, begin, end);
+    }
+  };
+
+  /**
+   * @brief Integrate the kernel of a particle over the part of a cell that
+   * overlaps with the bounding cube of the kernel.
+   *
+   * @param position Position of the particle (in m).
+   * @param h Kernel support radius of the particle (in m).
+   * @param kernel Kernel function.
+   * @param bounding_box Bounding box of the cell (in m).
+   * @param planes Planes that cut the cell out of its bounding box (see
+   * DensityGrid::get_cell_geometry()).
+   * @param order Maximum number of quadrature points in every dimension. The
+   * spacing between the points is at most h / order.
+   * @return Integral of the kernel over the cell (in units of the kernel times
+   * m^3).
+   */
+  template < typename _kernel_ >
+  inline static double integrate_kernel(
+      const CoordinateVector<> position, const double h, _kernel_ kernel,
+      const Box<> &bounding_box,
+      const std::vector< std::pair< CoordinateVector<>, double > > &planes,
+      const uint_fast32_t order) {
+
+    CoordinateVector<> lower, dx;
+    CoordinateVector< uint_fast32_t > numpoint;
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+      lower[i] = std::max(bounding_box.get_anchor()[i], position[i] - h);
+      const double upper =
+          std::min(bounding_box.get_anchor()[i] + bounding_box.get_sides()[i],
+                   position[i] + h);
+      if (upper <= lower[i]) {
+        return 0.;
+      }
+      // cells that are small compared to the kernel need fewer points
+      numpoint[i] = std::max(
+          uint_fast32_t(1),
+          std::min(order, uint_fast32_t(std::ceil(order * (upper - lower[i]) /
+                                                  h))));
+      dx[i] = (upper - lower[i]) / numpoint[i];
+    }
+
+    const double inverse_h = 1. / h;
+    double integral = 0.;
+    for (uint_fast32_t ix = 0; ix < numpoint.x(); ++ix) {
+      for (uint_fast32_t iy = 0; iy < numpoint.y(); ++iy) {
+        for (uint_fast32_t iz = 0; iz < numpoint.z(); ++iz) {
+          const CoordinateVector<> x(lower.x() + (ix + 0.5) * dx.x(),
+                                     lower.y() + (iy + 0.5) * dx.y(),
+                                     lower.z() + (iz + 0.5) * dx.z());
+          bool inside = true;
+          for (size_t ip = 0; ip < planes.size(); ++ip) {
+            if (CoordinateVector<>::dot_product(planes[ip].first, x) >
+                planes[ip].second) {
+              inside = false;
+              break;
+            }
+          }
+          if (inside) {
+            integral += kernel((x - position).norm() * inverse_h, h);
+          }
+        }
+      }
+    }
+    return integral * dx.x() * dx.y() * dx.z();
+  }
+
+public:
+  /**
+   * @brief Deposit the given particle quantities onto the given grid.
+   *
+   * @param grid DensityGrid to deposit onto.
+   * @param positions Positions of the particles (in m).
+   * @param smoothing_lengths Kernel support radii of the particles (in m).
+   * @param quantities Quantities to deposit, every element contains the values
+   * for all particles.
+   * @param kernel Kernel function, called as kernel(u, h), with u the distance
+   * in units of the support radius h. Only the shape of the kernel matters,
+   * since the weights are normalized.
+   * @param periodic_box Periodic box. If the box has zero size, the particles
+   * are not wrapped periodically.
+   * @param result Deposited quantities, every element contains the values for
+   * all cells in the grid.
+   * @param worksize Number of parallel threads to use. If a negative number is
+   * given, all available threads will be used.
+   */
+  template < typename _kernel_ >
+  inline static void
+  deposit(const DensityGrid &grid,
+          const std::vector< CoordinateVector<> > &positions,
+          const std::vector< double > &smoothing_lengths,
+          const std::vector< std::vector< double > > &quantities,
+          _kernel_ kernel, const Box<> &periodic_box,
+          std::vector< std::vector< double > > &result,
+          int_fast32_t worksize = -1) {
+
+    const size_t numcell = grid.get_number_of_cells();
+    const size_t numquantity = quantities.size();
+
+    result.resize(numquantity);
+    for (size_t iq = 0; iq < numquantity; ++iq) {
+      result[iq].assign(numcell, 0.);
+    }
+
+    WorkDistributor< SPHGridDepositionJobMarket< _kernel_ >,
+                     SPHGridDepositionJob< _kernel_ > >
+        deposition_workers(worksize);
+    worksize = deposition_workers.get_worksize();
+    SPHGridDepositionJobMarket< _kernel_ > deposition_jobs(
+        grid, positions, smoothing_lengths, quantities, kernel, periodic_box,
+        worksize);
+    deposition_workers.do_in_parallel(deposition_jobs);
+
+    WorkDistributor< SPHGridDepositionReductionJobMarket< _kernel_ >,
+                     SPHGridDepositionReductionJob< _kernel_ > >
+        reduction_workers(worksize);
+    SPHGridDepositionReductionJobMarket< _kernel_ > reduction_jobs(
+        deposition_jobs, result, numcell);
+    reduction_workers.do_in_parallel(reduction_jobs);
+  }
+
+  /**
+   * @brief Wrap the given position periodically inside the given box.
+   *
+   * @param position Position (in m).
+   * @param box Periodic box.
+   * @return Wrapped position (in m).
+   */
+  inline static CoordinateVector<> wrap(CoordinateVector<> position,
+                                        const Box<> &box) {
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+      if (position[i] < box.get_anchor()[i]) {
+        position[i] += box.get_sides()[i];
+      }
+      if (position[i] >= box.get_anchor()[i] + box.get_sides()[i]) {
+        position[i] -= box.get_sides()[i];
+      }
+    }
+    return position;
+  }
+};
+
+#endif // SPHGRIDDEPOSITION_HPP
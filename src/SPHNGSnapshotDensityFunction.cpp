@@ -28,8 +28,9 @@
 #include "SPHNGSnapshotDensityFunction.hpp"
 #include "DensityValues.hpp"
 #include "Log.hpp"
-#include "Octree.hpp"
+#include "LinearOctree.hpp"
 #include "ParameterFile.hpp"
+#include "SPHGridDeposition.hpp"
 #include "UnitConverter.hpp"
 #include <cfloat>
 #include <fstream>
@@ -85,13 +86,18 @@ double SPHNGSnapshotDensityFunction::kernel(const double q, const double h) {
  * @param stats_filename Name of the file with neighbour statistics that will be
  * written out.
  * @param use_new_algorithm Use the new mapping algorithm?
+ * @param use_deposition Map the particles onto the grid by depositing them in
+ * the cells they overlap with, rather than by sampling the density at the cell
+ * midpoints?
  * @param log Log to write logging info to.
  */
 SPHNGSnapshotDensityFunction::SPHNGSnapshotDensityFunction(
     std::string filename, double initial_temperature, bool write_stats,
     uint_fast32_t stats_numbin, double stats_mindist, double stats_maxdist,
-    std::string stats_filename, bool use_new_algorithm, Log *log)
-    : _use_new_algorithm(use_new_algorithm), _octree(nullptr),
+    std::string stats_filename, bool use_new_algorithm, bool use_deposition,
+    Log *log)
+    : _use_new_algorithm(use_new_algorithm), _use_deposition(use_deposition),
+      _deposition_grid(nullptr), _octree(nullptr),
       _initial_temperature(initial_temperature), _stats_numbin(stats_numbin),
       _stats_mindist(stats_mindist), _stats_maxdist(stats_maxdist),
       _stats_filename(stats_filename), _log(log) {
@@ -398,6 +404,9 @@ SPHNGSnapshotDensityFunction::SPHNGSnapshotDensityFunction(
  *    (default: ngb_statistics.txt)
  *  - use new algorithm: Use Maya Petkova's more accurate mapping algorithm
  *    (default: false)?
+ *  - use particle deposition: Map the particles onto the grid by depositing
+ *    their mass in all cells they overlap with, instead of sampling the density
+ *    at the cell midpoints (default: false)?
  *
  * @param params ParameterFile to read from.
  * @param log Log to write logging info to.
@@ -418,6 +427,8 @@ SPHNGSnapshotDensityFunction::SPHNGSnapshotDensityFunction(
           params.get_value< std::string >("DensityFunction:statistics filename",
                                           "ngb_statistics.txt"),
           params.get_value< bool >("DensityFunction:use new algorithm", false),
+          params.get_value< bool >("DensityFunction:use particle deposition",
+                                   false),
           log) {}
 
 /**
@@ -435,8 +446,8 @@ SPHNGSnapshotDensityFunction::~SPHNGSnapshotDensityFunction() {
  */
 void SPHNGSnapshotDensityFunction::initialize() {
 
-  _octree = new Octree(_positions, _partbox, false);
-  _octree->set_auxiliaries(_smoothing_lengths, Octree::max< double >);
+  _octree = new LinearOctree(_positions, _partbox, false);
+  _octree->set_auxiliaries(_smoothing_lengths, LinearOctree::max< double >);
 
   if (_stats_numbin > 0) {
     if (_log) {
@@ -452,12 +463,13 @@ void SPHNGSnapshotDensityFunction::initialize() {
     double totnumngb = 0.;
     double numsmall = 0.;
     double numlarge = 0.;
+    std::vector< uint_fast32_t > ngbs;
     for (size_t i = 0; i < _positions.size(); ++i) {
       if (_log && i % (_positions.size() / 10) == 0) {
         _log->write_info("Got statistics for ", i, " of ", _positions.size(),
                          " particles.");
       }
-      std::vector< uint_fast32_t > ngbs = _octree->get_ngbs(_positions[i]);
+      _octree->get_ngbs(_positions[i], ngbs);
       const size_t numngbs = ngbs.size();
       totnumngb += numngbs;
       for (size_t j = 0; j < numngbs; ++j) {
@@ -886,9 +898,51 @@ double SPHNGSnapshotDensityFunction::mass_contribution(
   return Msum;
 }
 
+/**
+ * @brief Deposit the particles onto the given grid, if deposition mode is
+ * active.
+ *
+ * @param grid DensityGrid that will be filled.
+ * @param worksize Number of parallel threads to use. If a negative number is
+ * given, all available threads will be used.
+ */
+void SPHNGSnapshotDensityFunction::prepare(const DensityGrid &grid,
+                                           int_fast32_t worksize) {
+
+  if (!_use_deposition) {
+    return;
+  }
+
+  if (_log) {
+    _log->write_status("Depositing ", _positions.size(),
+                       " particles onto the grid...");
+  }
+
+  std::vector< std::vector< double > > quantities(1, _masses);
+  std::vector< std::vector< double > > result;
+  SPHGridDeposition::deposit(grid, _positions, _smoothing_lengths, quantities,
+                             kernel, Box<>(), result, worksize);
+  _deposited_densities.swap(result[0]);
+  _deposition_grid = &grid;
+
+  // convert the deposited masses into cell averages, so that they are still
+  // meaningful for cells that are refined before the next call to this
+  // function
+  for (cellsize_t i = 0; i < _deposited_densities.size(); ++i) {
+    _deposited_densities[i] /= grid.get_cell_volume(i);
+  }
+
+  if (_log) {
+    _log->write_status("Done depositing particles.");
+  }
+}
+
 /**
  * @brief Function that gives the density for a given cell -> Maya.
  *
+ * If the particles were deposited onto the grid the cell belongs to, we simply
+ * return the deposited density for the index of the cell.
+ *
  * @param cell Geometrical information about the cell.
  * @return Initial physical field values for that cell.
  */
@@ -896,6 +950,16 @@ DensityValues SPHNGSnapshotDensityFunction::operator()(const Cell &cell) const {
 
   DensityValues values;
 
+  if (_deposition_grid != nullptr && cell.get_grid() == _deposition_grid &&
+      cell.get_index() < _deposited_densities.size()) {
+    values.set_number_density(_deposited_densities[cell.get_index()] /
+                              1.6737236e-27);
+    values.set_temperature(_initial_temperature);
+    values.set_ionic_fraction(ION_H_n, 1.e-6);
+    values.set_ionic_fraction(ION_He_n, 1.e-6);
+    return values;
+  }
+
   if (_use_new_algorithm) {
 
     CoordinateVector<> position = cell.get_cell_midpoint();
@@ -915,20 +979,16 @@ DensityValues SPHNGSnapshotDensityFunction::operator()(const Cell &cell) const {
     // Find the neighbours that are contained inside of a sphere of centre the
     // cell midpoint
     // and radius given by the distance to the furthest vertex.
-    std::vector< uint_fast32_t > ngbs =
-        _octree->get_ngbs_sphere(position, radius);
-    const size_t numngbs = ngbs.size();
-
-    double density = 0.;
-
     // Loop over all the neighbouring particles and calculate their mass
     // contributions.
-    for (size_t i = 0; i < numngbs; i++) {
-      const uint_fast32_t index = ngbs[i];
-      const double h = _smoothing_lengths[index];
-      const CoordinateVector<> particle = _positions[index];
-      density += mass_contribution(cell, particle, h) * _masses[index];
-    }
+    double density = 0.;
+    _octree->for_each_ngb_sphere(
+        position, radius,
+        [this, &cell, &density](const uint_fast32_t index) {
+          const double h = _smoothing_lengths[index];
+          const CoordinateVector<> particle = _positions[index];
+          density += mass_contribution(cell, particle, h) * _masses[index];
+        });
 
     // Divide the cell mass by the cell volume to get density.
     density = density / cell.get_volume();
@@ -946,17 +1006,15 @@ DensityValues SPHNGSnapshotDensityFunction::operator()(const Cell &cell) const {
     const CoordinateVector<> position = cell.get_cell_midpoint();
 
     double density = 0.;
-    std::vector< uint_fast32_t > ngbs = _octree->get_ngbs(position);
-    const size_t numngbs = ngbs.size();
-    for (size_t i = 0; i < numngbs; ++i) {
-      const uint_fast32_t index = ngbs[i];
-      const double r = (position - _positions[index]).norm();
-      const double h = _smoothing_lengths[index];
-      const double q = r / h;
-      const double m = _masses[index];
-      const double splineval = m * kernel(q, h);
-      density += splineval;
-    }
+    _octree->for_each_ngb(
+        position, [this, &position, &density](const uint_fast32_t index) {
+          const double r = (position - _positions[index]).norm();
+          const double h = _smoothing_lengths[index];
+          const double q = r / h;
+          const double m = _masses[index];
+          const double splineval = m * kernel(q, h);
+          density += splineval;
+        });
 
     // convert density to particle density (assuming hydrogen only)
     values.set_number_density(density / 1.6737236e-27);
@@ -39,7 +39,7 @@
 #include <vector>
 
 class Log;
-class Octree;
+class LinearOctree;
 class ParameterFile;
 
 /**
@@ -51,6 +51,19 @@ private:
   /*! @brief Use the new mapping algorithm? */
   const bool _use_new_algorithm;
 
+  /*! @brief Map the particles onto the grid by depositing them in the cells
+   *  they overlap with, rather than by sampling the density at the cell
+   *  midpoints? */
+  const bool _use_deposition;
+
+  /*! @brief DensityGrid onto which the particles were deposited (only used if
+   *  _use_deposition is true). */
+  const DensityGrid *_deposition_grid;
+
+  /*! @brief Deposited density for every cell of the deposition grid (in kg
+   *  m^-3). */
+  std::vector< double > _deposited_densities;
+
   /*! @brief Positions of the SPH particles in the snapshot (in m). */
   std::vector< CoordinateVector<> > _positions;
 
@@ -64,7 +77,7 @@ private:
   Box<> _partbox;
 
   /*! @brief Octree used to speed up neighbour finding. */
-  Octree *_octree;
+  LinearOctree *_octree;
 
   /*! @brief Initial temperature of the gas (in K). */
   double _initial_temperature;
@@ -244,6 +257,7 @@ public:
                                double stats_mindist, double stats_maxdist,
                                std::string stats_filename,
                                bool use_new_algorithm = false,
+                               bool use_deposition = false,
                                Log *log = nullptr);
 
   SPHNGSnapshotDensityFunction(ParameterFile &params, Log *log = nullptr);
@@ -252,6 +266,8 @@ public:
 
   virtual void initialize();
 
+  virtual void prepare(const DensityGrid &grid, int_fast32_t worksize = -1);
+
   CoordinateVector<> get_position(uint_fast32_t index);
   double get_mass(uint_fast32_t index);
   double get_smoothing_length(uint_fast32_t index);
@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file TabulatedCrossSections.cpp
+ *
+ * @brief CrossSections implementation that interpolates on precomputed tables
+ * of another CrossSections implementation: implementation.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "TabulatedCrossSections.hpp"
+#include "CrossSectionsFactory.hpp"
+#include "Log.hpp"
+#include "ParameterFile.hpp"
+#include "UnitConverter.hpp"
+
+/**
+ * @brief Tabulate the given CrossSections implementation.
+ *
+ * @param cross_sections CrossSections implementation to tabulate.
+ * @param minimum_frequency Lower limit of the tabulated frequency range (in
+ * Hz).
+ * @param maximum_frequency Upper limit of the tabulated frequency range (in
+ * Hz).
+ * @param number_of_frequencies Number of frequencies in the tables.
+ * @param log Log to write logging info to.
+ */
+void TabulatedCrossSections::tabulate(const CrossSections &cross_sections,
+                                      double minimum_frequency,
+                                      double maximum_frequency,
+                                      uint_fast32_t number_of_frequencies,
+                                      Log *log) {
+
+  _maximum_relative_error = 0.;
+  _tables.clear();
+  _tables.reserve(NUMBER_OF_IONNAMES);
+  for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+    const IonName ion_name = static_cast< IonName >(ion);
+    _tables.push_back(LogLogInterpolationTable(
+        [&cross_sections, ion_name](const double frequency) {
+          return cross_sections.get_cross_section(ion_name, frequency);
+        },
+        minimum_frequency, maximum_frequency, number_of_frequencies));
+    _maximum_relative_error = std::max(
+        _maximum_relative_error, _tables.back().get_maximum_relative_error());
+  }
+
+  if (log) {
+    log->write_status("Tabulated cross sections on ", number_of_frequencies,
+                      " frequencies in the range [",
+                      UnitConverter::to_unit< QUANTITY_FREQUENCY >(
+                          minimum_frequency, "eV"),
+                      " eV, ",
+                      UnitConverter::to_unit< QUANTITY_FREQUENCY >(
+                          maximum_frequency, "eV"),
+                      " eV], maximum relative error: ",
+                      _maximum_relative_error, ".");
+  }
+}
+
+/**
+ * @brief Constructor.
+ *
+ * @param cross_sections CrossSections implementation to tabulate. It is only
+ * used during construction.
+ * @param minimum_frequency Lower limit of the tabulated frequency range (in
+ * Hz).
+ * @param maximum_frequency Upper limit of the tabulated frequency range (in
+ * Hz).
+ * @param number_of_frequencies Number of frequencies in the tables.
+ * @param log Log to write logging info to.
+ */
+TabulatedCrossSections::TabulatedCrossSections(
+    const CrossSections &cross_sections, double minimum_frequency,
+    double maximum_frequency, uint_fast32_t number_of_frequencies, Log *log) {
+  tabulate(cross_sections, minimum_frequency, maximum_frequency,
+           number_of_frequencies, log);
+}
+
+/**
+ * @brief ParameterFile constructor.
+ *
+ * Parameters are:
+ *  - tabulated type: CrossSections type to tabulate (default: Verner)
+ *  - minimum frequency: Lower limit of the tabulated frequency range (default:
+ *    10. eV)
+ *  - maximum frequency: Upper limit of the tabulated frequency range (default:
+ *    1000. eV)
+ *  - number of frequencies: Number of frequencies in the tables (default:
+ *    1000)
+ *
+ * The CrossSections implementation that is tabulated can read additional
+ * parameters from the same parameter block.
+ *
+ * @param params ParameterFile to read from.
+ * @param log Log to write logging info to.
+ */
+TabulatedCrossSections::TabulatedCrossSections(ParameterFile &params,
+                                               Log *log) {
+
+  const std::string type = params.get_value< std::string >(
+      "CrossSections:tabulated type", "Verner");
+  if (type == "Tabulated") {
+    cmac_error("Cannot tabulate tabulated cross sections!");
+  }
+  CrossSections *cross_sections =
+      CrossSectionsFactory::generate_from_type(type, params, log);
+  tabulate(
+      *cross_sections,
+      params.get_physical_value< QUANTITY_FREQUENCY >(
+          "CrossSections:minimum frequency", "10. eV"),
+      params.get_physical_value< QUANTITY_FREQUENCY >(
+          "CrossSections:maximum frequency", "1000. eV"),
+      params.get_value< uint_fast32_t >("CrossSections:number of frequencies",
+                                        1000),
+      log);
+  delete cross_sections;
+}
+
+/**
+ * @brief Get the photoionization cross section for the given ion at the
+ * given photon energy.
+ *
+ * @param ion IonName for a valid ion.
+ * @param energy Photon frequency (in Hz).
+ * @return Photoionization cross section (in m^2).
+ */
+double TabulatedCrossSections::get_cross_section(IonName ion,
+                                                 double energy) const {
+  return _tables[ion].get_value(energy);
+}
+
+/**
+ * @brief Get the photoionization cross sections for the given ion at the
+ * given photon energies.
+ *
+ * @param ion IonName for a valid ion.
+ * @param energies Photon frequencies (in Hz).
+ * @param cross_sections Array to store the photoionization cross sections in
+ * (in m^2).
+ * @param number Number of energies.
+ */
+void TabulatedCrossSections::get_cross_sections(IonName ion,
+                                                const double *energies,
+                                                double *cross_sections,
+                                                const uint_fast32_t number)
+    const {
+  const LogLogInterpolationTable &table = _tables[ion];
+  for (uint_fast32_t i = 0; i < number; ++i) {
+    cross_sections[i] = table.get_value(energies[i]);
+  }
+}
@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file TabulatedCrossSections.hpp
+ *
+ * @brief CrossSections implementation that interpolates on precomputed tables
+ * of another CrossSections implementation: header.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef TABULATEDCROSSSECTIONS_HPP
+#define TABULATEDCROSSSECTIONS_HPP
+
+#include "CrossSections.hpp"
+#include "LogLogInterpolationTable.hpp"
+
+#include <vector>
+
+class Log;
+class ParameterFile;
+
+/**
+ * @brief CrossSections implementation that interpolates on precomputed tables
+ * of another CrossSections implementation.
+ *
+ * The cross sections of every ion are tabulated on a logarithmic frequency
+ * grid when the object is constructed, and are then interpolated linearly in
+ * log-log space (see LogLogInterpolationTable). Ionization thresholds and inner
+ * shell edges are located to machine precision, so that the interpolation
+ * never crosses them.
+ *
+ * The maximum relative difference between the interpolated and the exact
+ * cross sections is measured during construction and written to the Log. It
+ * can be controlled using the number of frequencies in the tables.
+ */
+class TabulatedCrossSections : public CrossSections {
+private:
+  /*! @brief Interpolation tables, one for every ion. */
+  std::vector< LogLogInterpolationTable > _tables;
+
+  /*! @brief Maximum relative difference between the interpolated and the exact
+   *  cross sections. */
+  double _maximum_relative_error;
+
+  void tabulate(const CrossSections &cross_sections, double minimum_frequency,
+                double maximum_frequency, uint_fast32_t number_of_frequencies,
+                Log *log);
+
+public:
+  TabulatedCrossSections(const CrossSections &cross_sections,
+                         double minimum_frequency, double maximum_frequency,
+                         uint_fast32_t number_of_frequencies,
+                         Log *log = nullptr);
+
+  TabulatedCrossSections(ParameterFile &params, Log *log = nullptr);
+
+  virtual double get_cross_section(IonName ion, double energy) const;
+
+  virtual void get_cross_sections(IonName ion, const double *energies,
+                                  double *cross_sections,
+                                  const uint_fast32_t number) const;
+
+  /**
+   * @brief Get the maximum relative difference between the interpolated and
+   * the exact cross sections within the tabulated frequency range.
+   *
+   * @return Maximum relative error.
+   */
+  inline double get_maximum_relative_error() const {
+    return _maximum_relative_error;
+  }
+};
+
+#endif // TABULATEDCROSSSECTIONS_HPP
@@ -0,0 +1,143 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file TabulatedRecombinationRates.cpp
+ *
+ * @brief RecombinationRates implementation that interpolates on precomputed
+ * tables of another RecombinationRates implementation: implementation.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "TabulatedRecombinationRates.hpp"
+#include "Log.hpp"
+#include "ParameterFile.hpp"
+#include "RecombinationRatesFactory.hpp"
+
+/**
+ * @brief Tabulate the given RecombinationRates implementation.
+ *
+ * @param recombination_rates RecombinationRates implementation to tabulate.
+ * @param minimum_temperature Lower limit of the tabulated temperature range
+ * (in K).
+ * @param maximum_temperature Upper limit of the tabulated temperature range
+ * (in K).
+ * @param number_of_temperatures Number of temperatures in the tables.
+ * @param log Log to write logging info to.
+ */
+void TabulatedRecombinationRates::tabulate(
+    const RecombinationRates &recombination_rates, double minimum_temperature,
+    double maximum_temperature, uint_fast32_t number_of_temperatures,
+    Log *log) {
+
+  _maximum_relative_error = 0.;
+  _tables.clear();
+  _tables.reserve(NUMBER_OF_IONNAMES);
+  for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+    const IonName ion_name = static_cast< IonName >(ion);
+    _tables.push_back(LogLogInterpolationTable(
+        [&recombination_rates, ion_name](const double temperature) {
+          return recombination_rates.get_recombination_rate(ion_name,
+                                                            temperature);
+        },
+        minimum_temperature, maximum_temperature, number_of_temperatures));
+    _maximum_relative_error = std::max(
+        _maximum_relative_error, _tables.back().get_maximum_relative_error());
+  }
+
+  if (log) {
+    log->write_status("Tabulated recombination rates on ",
+                      number_of_temperatures, " temperatures in the range [",
+                      minimum_temperature, " K, ", maximum_temperature,
+                      " K], maximum relative error: ", _maximum_relative_error,
+                      ".");
+  }
+}
+
+/**
+ * @brief Constructor.
+ *
+ * @param recombination_rates RecombinationRates implementation to tabulate. It
+ * is only used during construction.
+ * @param minimum_temperature Lower limit of the tabulated temperature range
+ * (in K).
+ * @param maximum_temperature Upper limit of the tabulated temperature range
+ * (in K).
+ * @param number_of_temperatures Number of temperatures in the tables.
+ * @param log Log to write logging info to.
+ */
+TabulatedRecombinationRates::TabulatedRecombinationRates(
+    const RecombinationRates &recombination_rates, double minimum_temperature,
+    double maximum_temperature, uint_fast32_t number_of_temperatures,
+    Log *log) {
+  tabulate(recombination_rates, minimum_temperature, maximum_temperature,
+           number_of_temperatures, log);
+}
+
+/**
+ * @brief ParameterFile constructor.
+ *
+ * Parameters are:
+ *  - tabulated type: RecombinationRates type to tabulate (default: Verner)
+ *  - minimum temperature: Lower limit of the tabulated temperature range
+ *    (default: 10. K)
+ *  - maximum temperature: Upper limit of the tabulated temperature range
+ *    (default: 1.e9 K)
+ *  - number of temperatures: Number of temperatures in the tables (default:
+ *    1000)
+ *
+ * The RecombinationRates implementation that is tabulated can read additional
+ * parameters from the same parameter block.
+ *
+ * @param params ParameterFile to read from.
+ * @param log Log to write logging info to.
+ */
+TabulatedRecombinationRates::TabulatedRecombinationRates(ParameterFile &params,
+                                                         Log *log) {
+
+  const std::string type = params.get_value< std::string >(
+      "RecombinationRates:tabulated type", "Verner");
+  if (type == "Tabulated") {
+    cmac_error("Cannot tabulate tabulated recombination rates!");
+  }
+  RecombinationRates *recombination_rates =
+      RecombinationRatesFactory::generate_from_type(type, params, log);
+  tabulate(*recombination_rates,
+           params.get_physical_value< QUANTITY_TEMPERATURE >(
+               "RecombinationRates:minimum temperature", "10. K"),
+           params.get_physical_value< QUANTITY_TEMPERATURE >(
+               "RecombinationRates:maximum temperature", "1.e9 K"),
+           params.get_value< uint_fast32_t >(
+               "RecombinationRates:number of temperatures", 1000),
+           log);
+  delete recombination_rates;
+}
+
+/**
+ * @brief Get the recombination rate for the given ion at the given
+ * temperature.
+ *
+ * @param ion IonName for a valid ion.
+ * @param temperature Temperature (in K).
+ * @return Recombination rate (in m^3s^-1).
+ */
+double TabulatedRecombinationRates::get_recombination_rate(
+    IonName ion, double temperature) const {
+  return _tables[ion].get_value(temperature);
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file TabulatedRecombinationRates.hpp
+ *
+ * @brief RecombinationRates implementation that interpolates on precomputed
+ * tables of another RecombinationRates implementation: header.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef TABULATEDRECOMBINATIONRATES_HPP
+#define TABULATEDRECOMBINATIONRATES_HPP
+
+#include "LogLogInterpolationTable.hpp"
+#include "RecombinationRates.hpp"
+
+#include <vector>
+
+class Log;
+class ParameterFile;
+
+/**
+ * @brief RecombinationRates implementation that interpolates on precomputed
+ * tables of another RecombinationRates implementation.
+ *
+ * The recombination rates of every ion are tabulated on a logarithmic
+ * temperature grid when the object is constructed, and are then interpolated
+ * linearly in log-log space (see LogLogInterpolationTable). Discontinuities in
+ * the rates (e.g. at the limits of the validity range of a fit) are located
+ * to machine precision, so that the interpolation never crosses them.
+ *
+ * The maximum relative difference between the interpolated and the exact
+ * recombination rates is measured during construction and written to the Log.
+ * It can be controlled using the number of temperatures in the tables.
+ */
+class TabulatedRecombinationRates : public RecombinationRates {
+private:
+  /*! @brief Interpolation tables, one for every ion. */
+  std::vector< LogLogInterpolationTable > _tables;
+
+  /*! @brief Maximum relative difference between the interpolated and the exact
+   *  recombination rates. */
+  double _maximum_relative_error;
+
+  void tabulate(const RecombinationRates &recombination_rates,
+                double minimum_temperature, double maximum_temperature,
+                uint_fast32_t number_of_temperatures, Log *log);
+
+public:
+  TabulatedRecombinationRates(const RecombinationRates &recombination_rates,
+                              double minimum_temperature,
+                              double maximum_temperature,
+                              uint_fast32_t number_of_temperatures,
+                              Log *log = nullptr);
+
+  TabulatedRecombinationRates(ParameterFile &params, Log *log = nullptr);
+
+  virtual double get_recombination_rate(IonName ion,
+                                        double temperature) const;
+
+  /**
+   * @brief Get the maximum relative difference between the interpolated and
+   * the exact recombination rates within the tabulated temperature range.
+   *
+   * @return Maximum relative error.
+   */
+  inline double get_maximum_relative_error() const {
+    return _maximum_relative_error;
+  }
+};
+
+#endif // TABULATEDRECOMBINATIONRATES_HPP
@@ -28,10 +28,11 @@
 #include "ChargeTransferRates.hpp"
 #include "Configuration.hpp"
 #include "DensityGrid.hpp"
-#include "DensityGridTraversalJobMarket.hpp"
+#include "DensityGridBatchTraversalJobMarket.hpp"
 #include "DensityValues.hpp"
 #include "IonizationStateCalculator.hpp"
 #include "LineCoolingData.hpp"
+#include "LineCoolingTable.hpp"
 #include "PhysicalConstants.hpp"
 #include "RecombinationRates.hpp"
 #include "WorkDistributor.hpp"
@@ -62,6 +63,9 @@
  * fractions.
  * @param charge_transfer_rates ChargeTransferRates used to calculate ionic
  * fractions.
+ * @param tabulated_cooling Use a LineCoolingTable to compute the line cooling?
+ * @param newton_raphson Use a Newton-Raphson solver to find the equilibrium
+ * temperature (instead of the default secant solver)?
  * @param log Log to write logging info to.
  */
 TemperatureCalculator::TemperatureCalculator(
@@ -70,10 +74,11 @@ TemperatureCalculator::TemperatureCalculator(
     uint_fast32_t maximum_number_of_iterations, double pahfac, double crfac,
     double crlim, double crscale, const LineCoolingData &line_cooling_data,
     const RecombinationRates &recombination_rates,
-    const ChargeTransferRates &charge_transfer_rates, Log *log)
+    const ChargeTransferRates &charge_transfer_rates, bool tabulated_cooling,
+    bool newton_raphson, Log *log)
     : _luminosity(luminosity), _abundances(abundances), _pahfac(pahfac),
       _crfac(crfac), _crlim(crlim), _crscale(crscale),
-      _line_cooling_data(line_cooling_data),
+      _line_cooling_data(line_cooling_data), _line_cooling_table(nullptr),
       _recombination_rates(recombination_rates),
       _charge_transfer_rates(charge_transfer_rates),
       _ionization_state_calculator(luminosity, abundances, recombination_rates,
@@ -81,13 +86,25 @@ TemperatureCalculator::TemperatureCalculator(
       _do_temperature_computation(do_temperature_computation),
       _epsilon_convergence(epsilon_convergence),
       _maximum_number_of_iterations(maximum_number_of_iterations),
-      _minimum_iteration_number(minimum_iteration_number) {
+      _minimum_iteration_number(minimum_iteration_number),
+      _newton_raphson(newton_raphson), _log(log) {
+
+  if (tabulated_cooling) {
+    _line_cooling_table = new LineCoolingTable(_line_cooling_data);
+  }
 
   if (log) {
     log->write_status("Set up TemperatureCalculator with total luminosity ",
                       _luminosity, " s^-1, PAH factor ", _pahfac,
                       ", and cosmic ray factor ", _crfac, " (limit: ", _crlim,
                       ", scale height: ", _crscale, " m).");
+    if (tabulated_cooling) {
+      log->write_status("Using tabulated line cooling.");
+    }
+    if (newton_raphson) {
+      log->write_status(
+          "Using a Newton-Raphson solver for the temperature computation.");
+    }
   }
 }
 
@@ -110,6 +127,14 @@ TemperatureCalculator::TemperatureCalculator(
  *    heating is applied (default: 0.75)
  *  - cosmic ray heating scale length: Scale length of the cosmic ray heating
  *    (default: 1.33333 kpc)
+ *  - tabulated cooling: Interpolate the temperature dependent line cooling
+ *    terms from a precomputed table instead of evaluating them directly
+ *    (default: false)
+ *  - solver: Method used to find the equilibrium temperature in a cell: secant
+ *    (logarithmic secant method, starting every iteration from 3 cooling and
+ *    heating evaluations) or Newton-Raphson (Newton-Raphson method that uses 2
+ *    evaluations per iteration and is seeded with the previous temperature of
+ *    the cell, default: secant)
  *
  * @param luminosity Total ionizing luminosity of all photon sources (in s^-1).
  * @param abundances Abundances.
@@ -147,7 +172,38 @@ TemperatureCalculator::TemperatureCalculator(
           params.get_physical_value< QUANTITY_LENGTH >(
               "TemperatureCalculator:cosmic ray heating scale length",
               "1.33333 kpc"),
-          line_cooling_data, recombination_rates, charge_transfer_rates, log) {}
+          line_cooling_data, recombination_rates, charge_transfer_rates,
+          params.get_value< bool >("TemperatureCalculator:tabulated cooling",
+                                   false),
+          is_newton_raphson_solver(params.get_value< std::string >(
+              "TemperatureCalculator:solver", "secant")),
+          log) {}
+
+/**
+ * @brief Destructor.
+ *
+ * Frees up the memory used by the LineCoolingTable.
+ */
+TemperatureCalculator::~TemperatureCalculator() { delete _line_cooling_table; }
+
+/**
+ * @brief Check whether the temperature solver with the given name is the
+ * Newton-Raphson solver.
+ *
+ * @param solver Temperature solver name ("secant" or "Newton-Raphson").
+ * @return True if the solver is the Newton-Raphson solver.
+ */
+bool TemperatureCalculator::is_newton_raphson_solver(
+    const std::string &solver) {
+  if (solver == "secant") {
+    return false;
+  } else if (solver == "Newton-Raphson") {
+    return true;
+  } else {
+    cmac_error("Unknown temperature solver: \"%s\"!", solver.c_str());
+    return false;
+  }
+}
 
 /**
  * @brief Function that calculates the cooling and heating rate for a given
@@ -172,13 +228,17 @@ TemperatureCalculator::TemperatureCalculator(
  * In the fourth and final step, we use our knowledge of the ionization state of
  * the coolants to compute actual cooling rates.
  *
+ * Steps 1 and 3 are done by compute_ionization_balance(), steps 2 and 4 by
+ * compute_cooling_and_heating().
+ *
  * @param h0 Variable to store the hydrogen neutral fraction in.
  * @param he0 Variable to store the helium neutral fraction in.
  * @param gain Total energy gain due to heating.
  * @param loss Total energy loss due to cooling.
  * @param T Temperature (in K).
- * @param cell Cell for which we compute the ionization equilibrium and cooling
- * and heating.
+ * @param ionization_variables IonizationVariables of the cell for which we
+ * compute the ionization equilibrium and cooling and heating.
+ * @param cell_midpoint Midpoint of the cell (in m).
  * @param j Mean ionizing intensity integrals (in s^-1).
  * @param abundances Abundances.
  * @param h Heating integrals (in J s^-1).
@@ -191,22 +251,50 @@ TemperatureCalculator::TemperatureCalculator(
  * fractions.
  * @param charge_transfer_rates ChargeTransferRates used to calculate ionic
  * fractions.
+ * @param line_cooling_table LineCoolingTable used to calculate line cooling
+ * (if not a null pointer, the line_cooling_data is not used directly).
  */
 void TemperatureCalculator::compute_cooling_and_heating_balance(
     double &h0, double &he0, double &gain, double &loss, double T,
-    DensityGrid::iterator &cell, const double j[NUMBER_OF_IONNAMES],
+    IonizationVariablesReference ionization_variables,
+    const CoordinateVector<> &cell_midpoint, const double j[NUMBER_OF_IONNAMES],
     const Abundances &abundances, const double h[NUMBER_OF_HEATINGTERMS],
     double pahfac, double crfac, double crscale,
     const LineCoolingData &line_cooling_data,
     const RecombinationRates &recombination_rates,
-    const ChargeTransferRates &charge_transfer_rates) {
-
-  /// step 0: initialize some variables
+    const ChargeTransferRates &charge_transfer_rates,
+    const LineCoolingTable *line_cooling_table) {
+
+  compute_ionization_balance(h0, he0, T, ionization_variables, j, abundances,
+                             recombination_rates, charge_transfer_rates);
+  compute_cooling_and_heating(gain, loss, h0, he0, T, ionization_variables,
+                              cell_midpoint, abundances, h, pahfac, crfac,
+                              crscale, line_cooling_data, line_cooling_table);
+}
 
-  // get a reference to the ionization variables of the cell
-  // this will be used to set the ionic fractions of the coolants, and to get
-  // access to the number density
-  IonizationVariables &ionization_variables = cell.get_ionization_variables();
+/**
+ * @brief Compute the ionization balance of hydrogen, helium and the coolants
+ * for a given cell at the given temperature.
+ *
+ * @param h0 Variable to store the hydrogen neutral fraction in.
+ * @param he0 Variable to store the helium neutral fraction in.
+ * @param T Temperature (in K).
+ * @param ionization_variables IonizationVariables of the cell for which we
+ * compute the ionization equilibrium (the ionic fractions of the coolants are
+ * stored in it).
+ * @param j Mean ionizing intensity integrals (in s^-1).
+ * @param abundances Abundances.
+ * @param recombination_rates RecombinationRates used to calculate ionic
+ * fractions.
+ * @param charge_transfer_rates ChargeTransferRates used to calculate ionic
+ * fractions.
+ */
+void TemperatureCalculator::compute_ionization_balance(
+    double &h0, double &he0, double T,
+    IonizationVariablesReference ionization_variables,
+    const double j[NUMBER_OF_IONNAMES], const Abundances &abundances,
+    const RecombinationRates &recombination_rates,
+    const ChargeTransferRates &charge_transfer_rates) {
 
   // get the recombination rates of all elements at the selected temperature
   const double alphaH = recombination_rates.get_recombination_rate(ION_H_n, T);
@@ -217,6 +305,82 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   const double jH = j[ION_H_n];
   const double jHe = j[ION_He_n];
 
+  // number density in the cell
+  const double n = ionization_variables.get_number_density();
+
+  // helium abundance. Used to scale the helium number density.
+  const double AHe = abundances.get_abundance(ELEMENT_He);
+
+  /// step 1: get the ionization equilibrium for hydrogen and helium
+
+  IonizationStateCalculator::compute_ionization_states_hydrogen_helium(
+      alphaH, alphaHe, jH, jHe, n, AHe, T, h0, he0);
+
+  // the ionization equilibrium gives us the electron density (we neglect free
+  // electrons coming from ionization of coolants)
+  const double ne = n * (1. - h0 + AHe * (1. - he0));
+
+  // make sure the electron density is a number
+  cmac_assert(ne == ne);
+
+  /// step 3: ionization balance of coolants
+
+  // we first compute the ionic fractions of the different ions of the coolants
+  // they are then used as input for the line cooling routine
+
+  // we precompute the number density of neutral hydrogen and neutral helium,
+  // and of H+
+  const double nh0 = n * h0;
+  const double nhe0 = n * he0 * AHe;
+  const double nhp = n * (1. - h0);
+
+  IonizationStateCalculator::compute_ionization_states_metals(
+      &j[2], ne, T, T * 1.e-4, nh0, nhe0, nhp, recombination_rates,
+      charge_transfer_rates, ionization_variables);
+}
+
+/**
+ * @brief Compute the cooling and heating rate for a given cell with the given
+ * ionization state at the given temperature.
+ *
+ * Optionally, we also compute the derivatives of the heating and cooling with
+ * respect to \f$\log{T}\f$ at fixed ionization state. These derivatives are
+ * computed analytically from the same expressions that are used for the
+ * heating and cooling.
+ *
+ * @param gain Total energy gain due to heating.
+ * @param loss Total energy loss due to cooling.
+ * @param h0 Hydrogen neutral fraction.
+ * @param he0 Helium neutral fraction.
+ * @param T Temperature (in K).
+ * @param ionization_variables IonizationVariables of the cell for which we
+ * compute the cooling and heating (contains the ionic fractions of the
+ * coolants).
+ * @param cell_midpoint Midpoint of the cell (in m).
+ * @param abundances Abundances.
+ * @param h Heating integrals (in J s^-1).
+ * @param pahfac Normalization factor for PAH heating.
+ * @param crfac Normalization factor for cosmic ray heating.
+ * @param crscale Scale height of the cosmic ray heating term (0 for a constant
+ * heating term; in m).
+ * @param line_cooling_data LineCoolingData used to calculate line cooling.
+ * @param line_cooling_table LineCoolingTable used to calculate line cooling
+ * (if not a null pointer, the line_cooling_data is not used directly).
+ * @param dgain Variable to store the derivative of the total energy gain with
+ * respect to \f$\log{T}\f$ in (not computed if this is a null pointer).
+ * @param dloss Variable to store the derivative of the total energy loss with
+ * respect to \f$\log{T}\f$ in (only computed if dgain is computed).
+ */
+void TemperatureCalculator::compute_cooling_and_heating(
+    double &gain, double &loss, double h0, double he0, double T,
+    IonizationVariablesReference ionization_variables,
+    const CoordinateVector<> &cell_midpoint, const Abundances &abundances,
+    const double h[NUMBER_OF_HEATINGTERMS], double pahfac, double crfac,
+    double crscale, const LineCoolingData &line_cooling_data,
+    const LineCoolingTable *line_cooling_table, double *dgain, double *dloss) {
+
+  const bool derivatives = (dgain != nullptr);
+
   // heating integrals
   const double hH = h[HEATINGTERM_H];
   const double hHe = h[HEATINGTERM_He];
@@ -233,18 +397,10 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   // helium abundance. Used to scale the helium number density.
   const double AHe = abundances.get_abundance(ELEMENT_He);
 
-  /// step 1: get the ionization equilibrium for hydrogen and helium
-
-  IonizationStateCalculator::compute_ionization_states_hydrogen_helium(
-      alphaH, alphaHe, jH, jHe, n, AHe, T, h0, he0);
-
   // the ionization equilibrium gives us the electron density (we neglect free
   // electrons coming from ionization of coolants)
   const double ne = n * (1. - h0 + AHe * (1. - he0));
 
-  // make sure the electron density is a number
-  cmac_assert(ne == ne);
-
   // we also need the number densities of H+ and He+
   const double nhp = n * (1. - h0);
   const double nhep = (1. - he0) * n * AHe;
@@ -260,6 +416,7 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   //    radiation
   //  - PAH heating (if active)
   //  - cosmic ray heating (if active)
+  // only the on the spot heating explicitly depends on the temperature
 
   // ionization heating
   gain = n * (hH * h0 + hHe * AHe * he0);
@@ -276,7 +433,8 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   const double pHots = 1. / (1. + 77. / sqrtT * he0 / h0);
   // the constant factor is the energy gain due to a helium Lyman alpha photon
   // being absorbed by hydrogen: (21.2 eV - 13.6 eV) = 1.21765423e-18 J
-  gain += pHots * 1.21765423e-18 * alpha_e_2sP * nenhep;
+  const double heat_ots = pHots * 1.21765423e-18 * alpha_e_2sP * nenhep;
+  gain += heat_ots;
 
   // PAH heating
   // the numerical factors were estimated from Weingartner, J. C. & Draine, B.
@@ -294,23 +452,16 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   if (crfac > 0.) {
     heatcr = crfac * 1.2e-25 / std::sqrt(ne);
     if (crscale > 0.) {
-      heatcr *= std::exp(-std::abs(cell.get_cell_midpoint().z()) / crscale);
+      heatcr *= std::exp(-std::abs(cell_midpoint.z()) / crscale);
     }
   }
   gain += heatcr;
 
-  /// step 3: ionization balance of coolants
-
-  // we first compute the ionic fractions of the different ions of the coolants
-  // they are then used as input for the line cooling routine
-
-  // we precompute the number density of neutral hydrogen and neutral helium
-  const double nh0 = n * h0;
-  const double nhe0 = n * he0 * AHe;
-
-  IonizationStateCalculator::compute_ionization_states_metals(
-      &j[2], ne, T, T4, nh0, nhe0, nhp, recombination_rates,
-      charge_transfer_rates, ionization_variables);
+  if (derivatives) {
+    // alpha_e_2sP scales as T^-0.861, while pHots depends on T through the
+    // factor 1/sqrt(T)
+    *dgain = heat_ots * (-0.861 + 0.5 * (1. - pHots));
+  }
 
   /// step 4: cooling
   // the cooling consists of three term:
@@ -376,6 +527,7 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   abund[SIV] = abundances.get_abundance(ELEMENT_S) *
                ionization_variables.get_ionic_fraction(ION_S_p2);
 
+  double dline = 0.;
 #ifdef DO_OUTPUT_COOLING
   loss = 0.;
   std::vector< std::vector< double > > lines =
@@ -401,8 +553,23 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   ionization_variables.set_cooling(ION_S_p1, cooling[SII]);
   ionization_variables.set_cooling(ION_S_p2, cooling[SIII]);
   ionization_variables.set_cooling(ION_S_p3, cooling[SIV]);
+  if (derivatives) {
+    line_cooling_data.get_cooling(T, ne, abund, dline);
+  }
 #else
-  loss = line_cooling_data.get_cooling(T, ne, abund) * n;
+  if (line_cooling_table != nullptr) {
+    if (derivatives) {
+      loss = line_cooling_table->get_cooling(T, ne, abund, dline) * n;
+    } else {
+      loss = line_cooling_table->get_cooling(T, ne, abund) * n;
+    }
+  } else {
+    if (derivatives) {
+      loss = line_cooling_data.get_cooling(T, ne, abund, dline) * n;
+    } else {
+      loss = line_cooling_data.get_cooling(T, ne, abund) * n;
+    }
+  }
 #endif
 
   // free-free cooling (bremsstrahlung)
@@ -411,12 +578,14 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   // Hernquist, L. 1996, ApJS, 105, 19
   // (http://adsabs.harvard.edu/abs/1996ApJS..105...19K), equation 23
   const double c = 5.5 - logT;
-  const double gff = 1.1 + 0.34 * std::exp(-c * c / 3.);
+  const double expc = 0.34 * std::exp(-c * c / 3.);
+  const double gff = 1.1 + expc;
   // Wood, Mathis & Ercolano (2004), equation 22
   // based on section 3.4 of Osterbrock, D. E. & Ferland, G. J. 2006,
   // Astrophysics of Gaseous Nebulae and Active Galactic Nuclei, 2nd edition
   // (http://adsabs.harvard.edu/abs/2006agna.book.....O)
-  loss += 1.42e-40 * gff * sqrtT * (nenhp + nenhep);
+  const double Lff_prefactor = 1.42e-40 * sqrtT * (nenhp + nenhep);
+  loss += Lff_prefactor * gff;
 
   // cooling due to recombination of hydrogen and helium
 
@@ -426,8 +595,10 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   // valid in the range [5,000 K; 50,000 K]
   // NOTE that the expression for helium is different from that in Kenny's code
   // (it is the same as the commented out expression in Kenny's code)
-  const double Lhp =
-      2.85e-40 * nenhp * sqrtT * (5.914 - 0.5 * logT + 0.01184 * std::cbrt(T));
+  const double cbrtT = std::cbrt(T);
+  const double Lhp_prefactor = 2.85e-40 * nenhp * sqrtT;
+  const double Lhp_fit = 5.914 - 0.5 * logT + 0.01184 * cbrtT;
+  const double Lhp = Lhp_prefactor * Lhp_fit;
   const double Lhep = 1.55e-39 * nenhep * std::pow(T, 0.3647);
 #ifdef DO_OUTPUT_COOLING
   ionization_variables.set_cooling(ION_H_n, Lhp);
@@ -435,9 +606,166 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
 #endif
   loss += Lhp + Lhep;
 
+  if (derivatives) {
+    *dloss = dline * n;
+    // the Gaunt factor depends on log T through c
+    *dloss += Lff_prefactor * (0.5 * gff + expc * 2. * c / 3.);
+    *dloss += Lhp_prefactor * (0.5 * Lhp_fit - 0.5 + 0.01184 * cbrtT / 3.);
+    *dloss += 0.3647 * Lhep;
+  }
+
   // make sure losses are losses and gains are gains
-  loss = std::max(loss, 0.);
-  gain = std::max(gain, 0.);
+  if (loss < 0.) {
+    loss = 0.;
+    if (derivatives) {
+      *dloss = 0.;
+    }
+  }
+  if (gain < 0.) {
+    gain = 0.;
+    if (derivatives) {
+      *dgain = 0.;
+    }
+  }
+}
+
+/**
+ * @brief Find the equilibrium temperature of a cell using the Newton-Raphson
+ * method.
+ *
+ * We look for the root of the function
+ * \f[
+ *   g(x) = \log{H(T)} - \log{L(T)},
+ * \f]
+ * with \f$x = \log{T}\f$, using the Newton-Raphson update (see
+ * https://en.wikipedia.org/wiki/Newton%27s_method)
+ * \f[
+ *   x' = x - \frac{g(x)}{g'(x)}.
+ * \f]
+ * The heating and cooling depend on the temperature both directly and through
+ * the ionization balance of hydrogen, helium and the coolants. The direct
+ * dependence (the line, free-free and recombination cooling and the on the
+ * spot heating at fixed ionization state) is differentiated analytically, see
+ * compute_cooling_and_heating(). The ionization balance is only known
+ * implicitly, so its contribution to \f$g'(x)\f$ is computed using a forward
+ * difference: we compute the ionization balance at a temperature that is 1%
+ * higher, and evaluate the cooling and heating for that ionization state at
+ * the original temperature. Every iteration hence requires two evaluations of
+ * the ionization balance and the cooling and heating (compared to three for
+ * the secant method), while the derivative is accurate, so that the method
+ * converges quadratically close to the root.
+ *
+ * To make the method robust, the temperature is not allowed to change by more
+ * than a factor 4 in a single iteration, and we move in the direction of the
+ * net energy change if the derivative has the wrong sign. The temperature is
+ * limited to the range [4,000 K, 10^10 K]; the gas is only assumed to be
+ * neutral (ionized) if it still cools (heats) at the lower (upper) limit.
+ *
+ * @param T0 Initial temperature guess, and final temperature on exit (in K).
+ * @param h0 Variable to store the hydrogen neutral fraction in.
+ * @param he0 Variable to store the helium neutral fraction in.
+ * @param gain0 Variable to store the final total energy gain due to heating in
+ * (set to the same value as loss0 if the gas was assumed to be fully neutral
+ * or ionized).
+ * @param loss0 Variable to store the final total energy loss due to cooling
+ * in.
+ * @param ionization_variables IonizationVariables of the cell for which we
+ * compute the temperature.
+ * @param cell_midpoint Midpoint of the cell (in m).
+ * @param j Mean ionizing intensity integrals (in s^-1).
+ * @param h Heating integrals (in J s^-1).
+ * @return Number of iterations.
+ */
+uint_fast32_t TemperatureCalculator::find_temperature_newton_raphson(
+    double &T0, double &h0, double &he0, double &gain0, double &loss0,
+    IonizationVariablesReference ionization_variables,
+    const CoordinateVector<> &cell_midpoint, const double j[NUMBER_OF_IONNAMES],
+    const double h[NUMBER_OF_HEATINGTERMS]) const {
+
+  // step in log T used to compute the derivative
+  static const double dlogT = std::log(1.01);
+  // maximum change in log T during a single iteration
+  static const double max_dlogT = std::log(4.);
+
+  // derivatives of the heating and cooling w.r.t. log T at fixed ionization
+  // state
+  double dgain0, dloss0;
+  compute_ionization_balance(h0, he0, T0, ionization_variables, j, _abundances,
+                             _recombination_rates, _charge_transfer_rates);
+  compute_cooling_and_heating(gain0, loss0, h0, he0, T0, ionization_variables,
+                              cell_midpoint, _abundances, h, _pahfac, _crfac,
+                              _crscale, _line_cooling_data,
+                              _line_cooling_table, &dgain0, &dloss0);
+
+  uint_fast32_t niter = 0;
+  while (std::abs(gain0 - loss0) > _epsilon_convergence * gain0 &&
+         niter < _maximum_number_of_iterations) {
+    ++niter;
+
+    if (T0 <= 4000. && gain0 < loss0) {
+      // gas is neutral, temperature is 500 K
+      T0 = 500.;
+      h0 = 1.;
+      he0 = 1.;
+      // force exit out of loop
+      gain0 = 1.;
+      loss0 = 1.;
+      break;
+    }
+
+    if (T0 >= 1.e10 && gain0 > loss0) {
+      // gas is ionized, temperature is 10^10 K
+      T0 = 1.e10;
+      h0 = 1.e-10;
+      he0 = 1.e-10;
+      // force exit out of loop
+      gain0 = 1.;
+      loss0 = 1.;
+      break;
+    }
+
+    // derivative of log(H/L) w.r.t. log T; 0 if it cannot be computed, which
+    // forces a maximal step in the direction of the net energy change
+    double dg = 0.;
+    if (gain0 > 0. && loss0 > 0.) {
+      // explicit temperature dependence
+      dg = dgain0 / gain0 - dloss0 / loss0;
+      // implicit temperature dependence through the ionization balance: we
+      // use a copy of the ionization variables to store the perturbed ionic
+      // fractions of the coolants
+      IonizationVariables perturbed_variables(ionization_variables);
+      double h01, he01, gain1, loss1;
+      compute_ionization_balance(h01, he01, 1.01 * T0, perturbed_variables, j,
+                                 _abundances, _recombination_rates,
+                                 _charge_transfer_rates);
+      compute_cooling_and_heating(gain1, loss1, h01, he01, T0,
+                                  perturbed_variables, cell_midpoint,
+                                  _abundances, h, _pahfac, _crfac, _crscale,
+                                  _line_cooling_data, _line_cooling_table);
+      if (gain1 > 0. && loss1 > 0.) {
+        dg += (std::log(gain1 / loss1) - std::log(gain0 / loss0)) / dlogT;
+      }
+    }
+
+    double step;
+    if (dg < 0.) {
+      step = -std::log(gain0 / loss0) / dg;
+      step = std::max(-max_dlogT, std::min(max_dlogT, step));
+    } else {
+      step = (gain0 > loss0) ? max_dlogT : -max_dlogT;
+    }
+    T0 = std::max(4000., std::min(1.e10, T0 * std::exp(step)));
+
+    compute_ionization_balance(h0, he0, T0, ionization_variables, j,
+                               _abundances, _recombination_rates,
+                               _charge_transfer_rates);
+    compute_cooling_and_heating(gain0, loss0, h0, he0, T0, ionization_variables,
+                                cell_midpoint, _abundances, h, _pahfac, _crfac,
+                                _crscale, _line_cooling_data,
+                                _line_cooling_table, &dgain0, &dloss0);
+  }
+
+  return niter;
 }
 
 /**
@@ -498,14 +826,19 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
  * is zero or negative. We therefore make sure that our heating/cooling is never
  * negative, and add extra code to handle a zero heating/cooling term.
  *
+ * Alternatively, the root can be found using the Newton-Raphson method, see
+ * find_temperature_newton_raphson().
+ *
  * @param jfac Normalization factor for the mean intensity integrals.
  * @param hfac Normalization factor for the heating integrals.
- * @param cell DensityGrid::iterator pointing to a cell.
+ * @param ionization_variables IonizationVariables of the cell.
+ * @param cell_midpoint Midpoint of the cell (in m).
+ * @return Number of iterations used to find the temperature (0 if the cell is
+ * trivially neutral).
  */
-void TemperatureCalculator::calculate_temperature(
-    double jfac, double hfac, DensityGrid::iterator &cell) const {
-
-  IonizationVariables &ionization_variables = cell.get_ionization_variables();
+uint_fast32_t TemperatureCalculator::calculate_temperature(
+    double jfac, double hfac, IonizationVariablesReference ionization_variables,
+    const CoordinateVector<> &cell_midpoint) const {
 
   // if the ionizing intensity is 0, the gas is trivially neutral and all
   // coolants are in the ground state
@@ -535,7 +868,7 @@ void TemperatureCalculator::calculate_temperature(
     ionization_variables.set_ionic_fraction(ION_S_p2, 0.);
     ionization_variables.set_ionic_fraction(ION_S_p3, 0.);
 
-    return;
+    return 0;
   }
 
   // if cosmic ray heating is active, check if the gas is ionized enough
@@ -574,14 +907,16 @@ void TemperatureCalculator::calculate_temperature(
       ionization_variables.set_ionic_fraction(ION_S_p1, 0.);
       ionization_variables.set_ionic_fraction(ION_S_p2, 0.);
       ionization_variables.set_ionic_fraction(ION_S_p3, 0.);
-      return;
+      return 0;
     }
   }
 
   // we make sure our initial temperature guess is high enough
+  // the Newton-Raphson solver starts from the neutral threshold, so that a cell
+  // that is still neutral is detected immediately
   double T0 = ionization_variables.get_temperature();
   if (ionization_variables.get_temperature() <= 4000.) {
-    T0 = 8000.;
+    T0 = _newton_raphson ? 4000. : 8000.;
   }
 
   // normalize the mean intensity integrals
@@ -609,6 +944,13 @@ void TemperatureCalculator::calculate_temperature(
   double loss0 = 0.;
   h0 = 0.;
   he0 = 0.;
+  if (_newton_raphson) {
+    // the secant loop below is skipped, since the Newton-Raphson solver either
+    // converged, reached the maximum number of iterations, or forced an exit
+    niter = find_temperature_newton_raphson(T0, h0, he0, gain0, loss0,
+                                            ionization_variables,
+                                            cell_midpoint, j, h);
+  }
   while (std::abs(gain0 - loss0) > _epsilon_convergence * gain0 &&
          niter < _maximum_number_of_iterations) {
     ++niter;
@@ -616,23 +958,23 @@ void TemperatureCalculator::calculate_temperature(
     // ioneng
     double h01, he01, gain1, loss1;
     compute_cooling_and_heating_balance(
-        h01, he01, gain1, loss1, T1, cell, j, _abundances, h, _pahfac, _crfac,
-        _crscale, _line_cooling_data, _recombination_rates,
-        _charge_transfer_rates);
+        h01, he01, gain1, loss1, T1, ionization_variables, cell_midpoint, j,
+        _abundances, h, _pahfac, _crfac, _crscale, _line_cooling_data,
+        _recombination_rates, _charge_transfer_rates, _line_cooling_table);
 
     const double T2 = 0.9 * T0;
     // ioneng
     double h02, he02, gain2, loss2;
     compute_cooling_and_heating_balance(
-        h02, he02, gain2, loss2, T2, cell, j, _abundances, h, _pahfac, _crfac,
-        _crscale, _line_cooling_data, _recombination_rates,
-        _charge_transfer_rates);
+        h02, he02, gain2, loss2, T2, ionization_variables, cell_midpoint, j,
+        _abundances, h, _pahfac, _crfac, _crscale, _line_cooling_data,
+        _recombination_rates, _charge_transfer_rates, _line_cooling_table);
 
     // ioneng - this one sets h0, he0, gain0 and loss0
     compute_cooling_and_heating_balance(
-        h0, he0, gain0, loss0, T0, cell, j, _abundances, h, _pahfac, _crfac,
-        _crscale, _line_cooling_data, _recombination_rates,
-        _charge_transfer_rates);
+        h0, he0, gain0, loss0, T0, ionization_variables, cell_midpoint, j,
+        _abundances, h, _pahfac, _crfac, _crscale, _line_cooling_data,
+        _recombination_rates, _charge_transfer_rates, _line_cooling_table);
 
     // funny detail: this value is actually constant :p
     static const double logtt = std::log(1.1 / 0.9);
@@ -778,6 +1120,9 @@ void TemperatureCalculator::calculate_temperature(
     IonName ion = static_cast< IonName >(i);
     ionization_variables.set_mean_intensity(ion, j[i]);
   }
+  // keep the second moment consistent with the normalized integral
+  ionization_variables.set_mean_intensity_second_moment(
+      jfac * jfac * ionization_variables.get_mean_intensity_second_moment());
 #endif
 
 #ifdef DO_OUTPUT_HEATING
@@ -787,13 +1132,90 @@ void TemperatureCalculator::calculate_temperature(
     ionization_variables.set_heating(heating_term, h[i]);
   }
 #endif
+
+  return niter;
+}
+
+/**
+ * @brief Calculate a new temperature for a batch of consecutive cells.
+ *
+ * This produces the same result as calling calculate_temperature(double,
+ * double, IonizationVariablesReference, const CoordinateVector<> &) for every
+ * cell in the batch. Cells without ionizing radiation and vacuum cells are
+ * trivially neutral: they are identified and updated in simple loops over the
+ * contiguous arrays of the state variables that the compiler can vectorize, so
+ * that only the cells that require an iterative solution are passed on to the
+ * single cell solver.
+ *
+ * @param jfac Normalization factors for the mean intensity integrals in each
+ * cell of the batch.
+ * @param hfac Normalization factors for the heating integrals in each cell of
+ * the batch.
+ * @param cell_midpoints Midpoints of the cells in the batch (in m).
+ * @param ionization_variables IonizationVariablesArray containing the cells.
+ * @param offset Index of the first cell of the batch.
+ * @param size Number of cells in the batch (at most
+ * TEMPERATURECALCULATOR_BATCH_SIZE).
+ * @param number_of_iterations Array to store the number of iterations used to
+ * find the temperature of each cell in (0 if the cell is trivially neutral).
+ */
+void TemperatureCalculator::calculate_temperature(
+    const double *jfac, const double *hfac,
+    const CoordinateVector<> *cell_midpoints,
+    IonizationVariablesArray &ionization_variables, cellsize_t offset,
+    uint_fast32_t size, uint_fast32_t *number_of_iterations) const {
+
+  cmac_assert(size <= TEMPERATURECALCULATOR_BATCH_SIZE);
+
+  // if the ionizing intensity is 0, the gas is trivially neutral and all
+  // coolants are in the ground state
+  const double *ntot = ionization_variables.get_number_densities() + offset;
+  bool neutral[TEMPERATURECALCULATOR_BATCH_SIZE];
+  for (uint_fast32_t i = 0; i < size; ++i) {
+    const IonizationVariablesReference cell = ionization_variables[offset + i];
+    neutral[i] = (cell.get_mean_intensity(ION_H_n) == 0. &&
+                  cell.get_mean_intensity(ION_He_n) == 0.) ||
+                 ntot[i] == 0.;
+  }
+
+  double *T = ionization_variables.get_temperatures() + offset;
+  for (uint_fast32_t i = 0; i < size; ++i) {
+    if (neutral[i]) {
+      T[i] = 500.;
+    }
+  }
+  for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+    const IonName name = static_cast< IonName >(ion);
+    const double neutral_value =
+        (name == ION_H_n || name == ION_He_n) ? 1. : 0.;
+    double *fraction =
+        ionization_variables.get_ionic_fractions(name) + offset;
+    for (uint_fast32_t i = 0; i < size; ++i) {
+      if (neutral[i]) {
+        fraction[i] = neutral_value;
+      }
+    }
+  }
+
+  // now do the expensive iterative solution for the remaining cells
+  for (uint_fast32_t i = 0; i < size; ++i) {
+    if (neutral[i]) {
+      number_of_iterations[i] = 0;
+    } else {
+      number_of_iterations[i] =
+          calculate_temperature(jfac[i], hfac[i],
+                                ionization_variables[offset + i],
+                                cell_midpoints[i]);
+    }
+  }
 }
 
 /**
  * @brief Calculate a new temperature for each cell in the given block after
  * shooting the given number of photons.
  *
- * This is done in parallel.
+ * This is done in parallel. The total number of temperature iterations is
+ * written to the Log (if present).
  *
  * @param loop Current iteration number of the photoionization algorithm.
  * @param totweight Total weight of all photons that were used.
@@ -815,15 +1237,60 @@ void TemperatureCalculator::calculate_temperature(
                              PHYSICALCONSTANT_PLANCK);
 
     WorkDistributor<
-        DensityGridTraversalJobMarket< TemperatureCalculatorFunction >,
-        DensityGridTraversalJob< TemperatureCalculatorFunction > >
+        DensityGridBatchTraversalJobMarket< TemperatureCalculatorFunction >,
+        DensityGridBatchTraversalJob< TemperatureCalculatorFunction > >
         workers;
-    TemperatureCalculatorFunction do_calculation(*this, jfac, hfac);
-    DensityGridTraversalJobMarket< TemperatureCalculatorFunction > jobs(
+    TemperatureCalculatorFunction do_calculation(
+        *this, jfac, hfac, grid.get_ionization_variables_array());
+    DensityGridBatchTraversalJobMarket< TemperatureCalculatorFunction > jobs(
         grid, do_calculation, block);
     workers.do_in_parallel(jobs);
+
+    if (_log) {
+      const uint_fast64_t number_of_cells = block.second - block.first;
+      _log->write_info("Temperature computation: ",
+                       do_calculation.get_number_of_iterations(),
+                       " iterations for ", number_of_cells, " cells (",
+                       do_calculation.get_number_of_unconverged_cells(),
+                       " cells did not converge).");
+    }
   } else {
     _ionization_state_calculator.calculate_ionization_state(totweight, grid,
                                                             block);
   }
 }
+
+/**
+ * @brief Calculate a new ionization state (and temperature, if applicable) for
+ * a single cell after shooting photons with the given total weight.
+ *
+ * This is the single cell version of calculate_temperature(uint_fast32_t,
+ * double, DensityGrid &, std::pair< cellsize_t, cellsize_t > &), for cells
+ * that are not stored in a DensityGrid (e.g. the cells of a
+ * ParallelCartesianDensityGrid).
+ *
+ * @param loop Current iteration number of the photoionization algorithm.
+ * @param totweight Total weight of all photons that were used.
+ * @param volume Volume of the cell (in m^3).
+ * @param ionization_variables IonizationVariables of the cell.
+ * @param cell_midpoint Midpoint of the cell (in m).
+ * @return Number of iterations used to find the temperature (0 if no
+ * temperature computation was done).
+ */
+uint_fast32_t TemperatureCalculator::calculate_cell_state(
+    uint_fast32_t loop, double totweight, double volume,
+    IonizationVariablesReference ionization_variables,
+    const CoordinateVector<> &cell_midpoint) const {
+
+  const double jfac = _luminosity / totweight / volume;
+  if (_do_temperature_computation && loop > _minimum_iteration_number) {
+    const double hfac = jfac * PhysicalConstants::get_physical_constant(
+                                   PHYSICALCONSTANT_PLANCK);
+    return calculate_temperature(jfac, hfac, ionization_variables,
+                                 cell_midpoint);
+  } else {
+    _ionization_state_calculator.calculate_ionization_state(
+        jfac, ionization_variables);
+    return 0;
+  }
+}
@@ -28,14 +28,22 @@
 #define TEMPERATURECALCULATOR_HPP
 
 #include "DensityGrid.hpp"
+#include "Atomic.hpp"
 #include "IonizationStateCalculator.hpp"
 
+#include <string>
+
 class Abundances;
 class ChargeTransferRates;
 class LineCoolingData;
+class LineCoolingTable;
 class Log;
 class RecombinationRates;
 
+/*! @brief Maximum number of cells that is processed in a single batch by the
+ *  batched temperature sweep. */
+#define TEMPERATURECALCULATOR_BATCH_SIZE 64
+
 /**
  * @brief Class that calculates the temperature for every cell of a grid after
  * the photon shoot loop.
@@ -80,6 +88,10 @@ private:
   /*! @brief LineCoolingData used to calculate cooling due to line emission. */
   const LineCoolingData &_line_cooling_data;
 
+  /*! @brief Tabulated version of the line cooling (nullptr if the line
+   *  cooling is computed directly). */
+  const LineCoolingTable *_line_cooling_table;
+
   /*! @brief RecombinationRates used to calculate ionic fractions. */
   const RecombinationRates &_recombination_rates;
 
@@ -103,6 +115,20 @@ private:
    *  before computing the temperature. */
   const uint_fast32_t _minimum_iteration_number;
 
+  /*! @brief Use a Newton-Raphson solver to find the equilibrium temperature
+   *  (instead of the default secant solver)? */
+  const bool _newton_raphson;
+
+  /*! @brief Log to write logging info to. */
+  Log *_log;
+
+  uint_fast32_t find_temperature_newton_raphson(
+      double &T0, double &h0, double &he0, double &gain0, double &loss0,
+      IonizationVariablesReference ionization_variables,
+      const CoordinateVector<> &cell_midpoint,
+      const double j[NUMBER_OF_IONNAMES],
+      const double h[NUMBER_OF_HEATINGTERMS]) const;
+
 public:
   TemperatureCalculator(
       bool do_temperature_computation, uint_fast32_t minimum_iteration_number,
@@ -111,7 +137,9 @@ public:
       double pahfac, double crfac, double crlim, double crscale,
       const LineCoolingData &line_cooling_data,
       const RecombinationRates &recombination_rates,
-      const ChargeTransferRates &charge_transfer_rates, Log *log = nullptr);
+      const ChargeTransferRates &charge_transfer_rates,
+      bool tabulated_cooling = false, bool newton_raphson = false,
+      Log *log = nullptr);
 
   TemperatureCalculator(double luminosity, const Abundances &abundances,
                         const LineCoolingData &line_cooling_data,
@@ -119,23 +147,113 @@ public:
                         const ChargeTransferRates &charge_transfer_rates,
                         ParameterFile &params, Log *log = nullptr);
 
+  ~TemperatureCalculator();
+
+  static bool is_newton_raphson_solver(const std::string &solver);
+
   static void compute_cooling_and_heating_balance(
+      double &h0, double &he0, double &gain, double &loss, double T,
+      IonizationVariablesReference ionization_variables,
+      const CoordinateVector<> &cell_midpoint,
+      const double j[NUMBER_OF_IONNAMES], const Abundances &abundances,
+      const double h[NUMBER_OF_HEATINGTERMS], double pahfac, double crfac,
+      double crscale, const LineCoolingData &line_cooling_data,
+      const RecombinationRates &recombination_rates,
+      const ChargeTransferRates &charge_transfer_rates,
+      const LineCoolingTable *line_cooling_table = nullptr);
+
+  static void compute_ionization_balance(
+      double &h0, double &he0, double T,
+      IonizationVariablesReference ionization_variables,
+      const double j[NUMBER_OF_IONNAMES], const Abundances &abundances,
+      const RecombinationRates &recombination_rates,
+      const ChargeTransferRates &charge_transfer_rates);
+
+  static void compute_cooling_and_heating(
+      double &gain, double &loss, double h0, double he0, double T,
+      IonizationVariablesReference ionization_variables,
+      const CoordinateVector<> &cell_midpoint, const Abundances &abundances,
+      const double h[NUMBER_OF_HEATINGTERMS], double pahfac, double crfac,
+      double crscale, const LineCoolingData &line_cooling_data,
+      const LineCoolingTable *line_cooling_table = nullptr,
+      double *dgain = nullptr, double *dloss = nullptr);
+
+  /**
+   * @brief Compute the cooling and heating rate for the given cell, together
+   * with the ionization balance.
+   *
+   * See compute_cooling_and_heating_balance() above.
+   *
+   * @param h0 Variable to store the hydrogen neutral fraction in.
+   * @param he0 Variable to store the helium neutral fraction in.
+   * @param gain Total energy gain due to heating.
+   * @param loss Total energy loss due to cooling.
+   * @param T Temperature (in K).
+   * @param cell Cell for which we compute the ionization equilibrium and
+   * cooling and heating.
+   * @param j Mean ionizing intensity integrals (in s^-1).
+   * @param abundances Abundances.
+   * @param h Heating integrals (in J s^-1).
+   * @param pahfac Normalization factor for PAH heating.
+   * @param crfac Normalization factor for cosmic ray heating.
+   * @param crscale Scale height of the cosmic ray heating term (0 for a
+   * constant heating term; in m).
+   * @param line_cooling_data LineCoolingData used to calculate line cooling.
+   * @param recombination_rates RecombinationRates used to calculate ionic
+   * fractions.
+   * @param charge_transfer_rates ChargeTransferRates used to calculate ionic
+   * fractions.
+   * @param line_cooling_table LineCoolingTable used to calculate line cooling
+   * (if not a null pointer, the line_cooling_data is not used directly).
+   */
+  inline static void compute_cooling_and_heating_balance(
       double &h0, double &he0, double &gain, double &loss, double T,
       DensityGrid::iterator &cell, const double j[NUMBER_OF_IONNAMES],
       const Abundances &abundances, const double h[NUMBER_OF_HEATINGTERMS],
       double pahfac, double crfac, double crscale,
       const LineCoolingData &line_cooling_data,
       const RecombinationRates &recombination_rates,
-      const ChargeTransferRates &charge_transfer_rates);
+      const ChargeTransferRates &charge_transfer_rates,
+      const LineCoolingTable *line_cooling_table = nullptr) {
+    compute_cooling_and_heating_balance(
+        h0, he0, gain, loss, T, cell.get_ionization_variables(),
+        cell.get_cell_midpoint(), j, abundances, h, pahfac, crfac, crscale,
+        line_cooling_data, recombination_rates, charge_transfer_rates,
+        line_cooling_table);
+  }
 
-  void calculate_temperature(double jfac, double hfac,
-                             DensityGrid::iterator &cell) const;
+  uint_fast32_t
+  calculate_temperature(double jfac, double hfac,
+                        IonizationVariablesReference ionization_variables,
+                        const CoordinateVector<> &cell_midpoint) const;
+
+  void calculate_temperature(const double *jfac, const double *hfac,
+                             const CoordinateVector<> *cell_midpoints,
+                             IonizationVariablesArray &ionization_variables,
+                             cellsize_t offset, uint_fast32_t size,
+                             uint_fast32_t *number_of_iterations) const;
+
+  /**
+   * @brief Calculate a new temperature for the given cell.
+   *
+   * @param jfac Normalization factor for the mean intensity integrals.
+   * @param hfac Normalization factor for the heating integrals.
+   * @param cell DensityGrid::iterator pointing to a cell.
+   * @return Number of iterations used to find the temperature (0 if the cell
+   * is trivially neutral).
+   */
+  inline uint_fast32_t
+  calculate_temperature(double jfac, double hfac,
+                        DensityGrid::iterator &cell) const {
+    return calculate_temperature(jfac, hfac, cell.get_ionization_variables(),
+                                 cell.get_cell_midpoint());
+  }
 
   /**
-   * @brief Functor used to calculate the temperature of a single cell.
+   * @brief Functor used to calculate the temperature of a range of cells.
    *
-   * This functor is called by the thread that is doing the computation for that
-   * cell, and calls TemperatureCalculator::calculate_temperature on the
+   * This functor is called by the thread that is doing the computation for
+   * these cells, and calls the batched calculate_temperature() of the
    * underlying TemperatureCalculator object.
    */
   class TemperatureCalculatorFunction {
@@ -151,6 +269,16 @@ public:
      * call. */
     const double _hfac;
 
+    /*! @brief Total number of temperature iterations for all cells. */
+    uint_fast64_t _number_of_iterations;
+
+    /*! @brief Number of cells for which the temperature computation did not
+     *  converge within the maximum number of iterations. */
+    uint_fast64_t _number_of_unconverged_cells;
+
+    /*! @brief Ionization variables of all cells in the grid. */
+    IonizationVariablesArray &_ionization_variables;
+
   public:
     /**
      * @brief Constructor.
@@ -161,25 +289,89 @@ public:
      * call.
      * @param hfac Second normalization factor used in the TemperatureCalculator
      * call.
+     * @param ionization_variables Ionization variables of all cells in the
+     * grid.
+     */
+    TemperatureCalculatorFunction(
+        const TemperatureCalculator &calculator, double jfac, double hfac,
+        IonizationVariablesArray &ionization_variables)
+        : _calculator(calculator), _jfac(jfac), _hfac(hfac),
+          _number_of_iterations(0), _number_of_unconverged_cells(0),
+          _ionization_variables(ionization_variables) {}
+
+    /**
+     * @brief Do the temperature calculation for the given range of cells.
+     *
+     * The range is split in batches of consecutive cells, which are processed
+     * by the batched temperature sweep.
+     *
+     * @param begin DensityGrid::iterator pointing to the first cell.
+     * @param end DensityGrid::iterator pointing beyond the last cell.
+     */
+    inline void operator()(DensityGrid::iterator begin,
+                           DensityGrid::iterator end) {
+      double jfac[TEMPERATURECALCULATOR_BATCH_SIZE];
+      double hfac[TEMPERATURECALCULATOR_BATCH_SIZE];
+      CoordinateVector<> cell_midpoints[TEMPERATURECALCULATOR_BATCH_SIZE];
+      uint_fast32_t number_of_iterations[TEMPERATURECALCULATOR_BATCH_SIZE];
+      DensityGrid::iterator it = begin;
+      while (it != end) {
+        const cellsize_t offset = it.get_index();
+        uint_fast32_t size = 0;
+        while (it != end && size < TEMPERATURECALCULATOR_BATCH_SIZE &&
+               it.get_index() == offset + size) {
+          const double volume = it.get_volume();
+          jfac[size] = _jfac / volume;
+          hfac[size] = _hfac / volume;
+          cell_midpoints[size] = it.get_cell_midpoint();
+          ++size;
+          ++it;
+        }
+        _calculator.calculate_temperature(jfac, hfac, cell_midpoints,
+                                          _ionization_variables, offset, size,
+                                          number_of_iterations);
+        uint_fast64_t total_number_of_iterations = 0;
+        uint_fast64_t number_of_unconverged_cells = 0;
+        for (uint_fast32_t i = 0; i < size; ++i) {
+          total_number_of_iterations += number_of_iterations[i];
+          if (number_of_iterations[i] >=
+              _calculator._maximum_number_of_iterations) {
+            ++number_of_unconverged_cells;
+          }
+        }
+        Atomic::add(_number_of_iterations, total_number_of_iterations);
+        Atomic::add(_number_of_unconverged_cells, number_of_unconverged_cells);
+      }
+    }
+
+    /**
+     * @brief Get the total number of temperature iterations for all cells.
+     *
+     * @return Total number of temperature iterations.
      */
-    TemperatureCalculatorFunction(const TemperatureCalculator &calculator,
-                                  double jfac, double hfac)
-        : _calculator(calculator), _jfac(jfac), _hfac(hfac) {}
+    inline uint_fast64_t get_number_of_iterations() const {
+      return _number_of_iterations;
+    }
 
     /**
-     * @brief Do the temperature calculation for a single cell.
+     * @brief Get the number of cells for which the temperature computation did
+     * not converge.
      *
-     * @param cell DensityGrid::iterator pointing to a single cell in the grid.
+     * @return Number of unconverged cells.
      */
-    inline void operator()(DensityGrid::iterator cell) {
-      _calculator.calculate_temperature(_jfac / cell.get_volume(),
-                                        _hfac / cell.get_volume(), cell);
+    inline uint_fast64_t get_number_of_unconverged_cells() const {
+      return _number_of_unconverged_cells;
     }
   };
 
   void calculate_temperature(uint_fast32_t loop, double totweight,
                              DensityGrid &grid,
                              std::pair< cellsize_t, cellsize_t > &block) const;
+
+  uint_fast32_t
+  calculate_cell_state(uint_fast32_t loop, double totweight, double volume,
+                       IonizationVariablesReference ionization_variables,
+                       const CoordinateVector<> &cell_midpoint) const;
 };
 
 #endif // TEMPERATURECALCULATOR_HPP
@@ -27,6 +27,8 @@
 #define TIMELINE_HPP
 
 #include "Error.hpp"
+#include "RestartReader.hpp"
+#include "RestartWriter.hpp"
 
 #include <algorithm>
 #include <cstdint>
@@ -184,6 +186,32 @@ public:
 
     return _current_time < TIMELINE_MAX_INTEGER_TIMELINE_SIZE;
   }
+
+  /**
+   * @brief Write the TimeLine to the given RestartWriter.
+   *
+   * @param restart_writer RestartWriter to write to.
+   */
+  inline void write_restart_file(RestartWriter &restart_writer) const {
+    restart_writer.write(_minimum_timestep);
+    restart_writer.write(_maximum_timestep);
+    restart_writer.write(_conversion_factors[0]);
+    restart_writer.write(_conversion_factors[1]);
+    restart_writer.write(_current_time);
+  }
+
+  /**
+   * @brief Restore the TimeLine from the given RestartReader.
+   *
+   * @param restart_reader RestartReader to read from.
+   */
+  inline void read_restart_file(RestartReader &restart_reader) {
+    _minimum_timestep = restart_reader.read< uint64_t >();
+    _maximum_timestep = restart_reader.read< uint64_t >();
+    _conversion_factors[0] = restart_reader.read< double >();
+    _conversion_factors[1] = restart_reader.read< double >();
+    _current_time = restart_reader.read< uint64_t >();
+  }
 };
 
 #endif // TIMELINE_HPP
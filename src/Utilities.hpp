@@ -32,6 +32,7 @@
 #include "OperatingSystem.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
@@ -85,6 +86,21 @@ inline int_fast32_t random_int(int_fast32_t min_value, int_fast32_t max_value) {
   return min_value + random_double() * (max_value - min_value);
 }
 
+/**
+ * @brief Round the given value to the nearest integer multiple of 2^exponent.
+ *
+ * Sums of values that have been rounded this way are exact (and hence do not
+ * depend on the order of the additions) as long as all partial sums stay below
+ * 2^(53 + exponent) in absolute value.
+ *
+ * @param value Value to round.
+ * @param exponent Base 2 exponent of the fixed-point unit.
+ * @return Rounded value.
+ */
+inline double round_to_fixed_point(const double value, const int exponent) {
+  return std::ldexp(std::rint(std::ldexp(value, -exponent)), exponent);
+}
+
 /**
  * @brief Split a string of the form [str1, str2, str3] into its parts.
  *
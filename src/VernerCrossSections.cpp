@@ -308,3 +308,91 @@ double VernerCrossSections::get_cross_section(IonName ion,
   }
   return 0.;
 }
+
+/**
+ * @brief Get the photoionization cross sections for the given ion at the
+ * given photon energies.
+ *
+ * We select the contributing shells once (using the same shells as
+ * get_cross_section()), and then evaluate the fitting formulas for all
+ * energies.
+ *
+ * @param ion IonName of a valid ion.
+ * @param energies Photon energies (in Hz).
+ * @param cross_sections Array to store the photoionization cross sections in
+ * (in m^2).
+ * @param number Number of energies.
+ */
+void VernerCrossSections::get_cross_sections(IonName ion,
+                                             const double *energies,
+                                             double *cross_sections,
+                                             const uint_fast32_t number) const {
+
+  // atomic number, number of electrons, and the shells that contribute (a
+  // second shell of 0 means only one shell contributes)
+  uint_fast8_t nz, ne, is1, is2;
+  switch (ion) {
+
+  case ION_H_n:
+    nz = 1, ne = 1, is1 = 1, is2 = 0;
+    break;
+
+  case ION_He_n:
+    nz = 2, ne = 2, is1 = 1, is2 = 0;
+    break;
+
+  case ION_C_p1:
+    nz = 6, ne = 5, is1 = 3, is2 = 2;
+    break;
+  case ION_C_p2:
+    nz = 6, ne = 4, is1 = 2, is2 = 0;
+    break;
+
+  case ION_N_n:
+    nz = 7, ne = 7, is1 = 3, is2 = 2;
+    break;
+  case ION_N_p1:
+    nz = 7, ne = 6, is1 = 3, is2 = 2;
+    break;
+  case ION_N_p2:
+    nz = 7, ne = 5, is1 = 3, is2 = 0;
+    break;
+
+  case ION_O_n:
+    nz = 8, ne = 8, is1 = 3, is2 = 2;
+    break;
+  case ION_O_p1:
+    nz = 8, ne = 7, is1 = 3, is2 = 2;
+    break;
+
+  case ION_Ne_n:
+    nz = 10, ne = 10, is1 = 3, is2 = 2;
+    break;
+  case ION_Ne_p1:
+    nz = 10, ne = 9, is1 = 3, is2 = 0;
+    break;
+
+  case ION_S_p1:
+    nz = 16, ne = 15, is1 = 5, is2 = 4;
+    break;
+  case ION_S_p2:
+    nz = 16, ne = 14, is1 = 5, is2 = 4;
+    break;
+  case ION_S_p3:
+    nz = 16, ne = 13, is1 = 5, is2 = 0;
+    break;
+
+  default:
+    cmac_error("Unknown ion: %i", ion);
+    return;
+  }
+
+  for (uint_fast32_t i = 0; i < number; ++i) {
+    cross_sections[i] = get_cross_section_verner(nz, ne, is1, energies[i]);
+  }
+  if (is2 > 0) {
+    for (uint_fast32_t i = 0; i < number; ++i) {
+      cross_sections[i] += get_cross_section_verner(nz, ne, is2, energies[i]);
+    }
+  }
+}
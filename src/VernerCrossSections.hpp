@@ -99,6 +99,10 @@ public:
                                   uint_fast8_t is, double e) const;
 
   virtual double get_cross_section(IonName ion, double energy) const;
+
+  virtual void get_cross_sections(IonName ion, const double *energies,
+                                  double *cross_sections,
+                                  const uint_fast32_t number) const;
 };
 
 #endif // CROSSSECTIONS_HPP
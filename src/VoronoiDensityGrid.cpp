@@ -24,11 +24,15 @@
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
 #include "VoronoiDensityGrid.hpp"
+#include "DensityGridTraversalJobMarket.hpp"
 #include "SimulationBox.hpp"
 #include "VoronoiGeneratorDistribution.hpp"
 #include "VoronoiGeneratorDistributionFactory.hpp"
 #include "VoronoiGrid.hpp"
 #include "VoronoiGridFactory.hpp"
+#include "WorkDistributor.hpp"
+
+#include <algorithm>
 
 /*! @brief If defined, this prints out the grid to a file with the given name
  *  after it has been constructed. */
@@ -205,10 +209,147 @@ void VoronoiDensityGrid::initialize(std::pair< cellsize_t, cellsize_t > &block,
     }
   }
 
+  compute_face_table();
+
   DensityGrid::initialize(block, density_function);
   DensityGrid::set_densities(block, density_function);
 }
 
+/**
+ * @brief Copy the face connectivity of the underlying VoronoiGrid into the flat
+ * face table that is used for photon traversal.
+ *
+ * This needs to be done every time the VoronoiGrid is (re)computed.
+ */
+void VoronoiDensityGrid::compute_face_table() {
+
+  const generatornumber_t numcell = _generator_positions.size();
+  _face_offsets.resize(numcell + 1);
+  _face_neighbours.clear();
+  _face_midpoints.clear();
+  _face_normals.clear();
+
+  _face_offsets[0] = 0;
+  for (generatornumber_t i = 0; i < numcell; ++i) {
+    const CoordinateVector<> ipos = _generator_positions[i];
+    const std::vector< VoronoiFace > faces = _voronoi_grid->get_faces(i);
+    for (auto it = faces.begin(); it != faces.end(); ++it) {
+      const uint_fast32_t ngb = it->get_neighbour();
+      _face_neighbours.push_back(ngb);
+      _face_midpoints.push_back(it->get_midpoint());
+      if (_voronoi_grid->is_real_neighbour(ngb)) {
+        _face_normals.push_back(_generator_positions[ngb] - ipos);
+      } else {
+        _face_normals.push_back(_voronoi_grid->get_wall_normal(ngb));
+      }
+    }
+    _face_offsets[i + 1] = _face_neighbours.size();
+  }
+
+  if (_log) {
+    const size_t numface = _face_neighbours.size();
+    _log->write_status(
+        "Face table contains ", numface, " faces (",
+        Utilities::human_readable_bytes(
+            (numcell + 1) * sizeof(size_t) +
+            numface * (sizeof(uint_fast32_t) +
+                       2 * sizeof(CoordinateVector<>))),
+        ").");
+  }
+}
+
+/**
+ * @brief Rebuild the rows of the face table that belong to cells that changed
+ * during the last incremental update of the VoronoiGrid.
+ *
+ * If no cell changed its number of faces, the rows are rebuilt in place.
+ * Otherwise, a new face table is allocated and the rows of the unchanged cells
+ * are copied over from the old face table.
+ */
+void VoronoiDensityGrid::update_face_table() {
+
+  const generatornumber_t numcell = _generator_positions.size();
+  std::vector< size_t > face_offsets(numcell + 1);
+  face_offsets[0] = 0;
+  bool in_place = true;
+  for (generatornumber_t i = 0; i < numcell; ++i) {
+    if (_voronoi_grid->has_changed(i)) {
+      face_offsets[i + 1] =
+          face_offsets[i] + _voronoi_grid->get_number_of_faces(i);
+    } else {
+      face_offsets[i + 1] =
+          face_offsets[i] + _face_offsets[i + 1] - _face_offsets[i];
+    }
+    in_place &= (face_offsets[i + 1] == _face_offsets[i + 1]);
+  }
+
+  std::pair< cellsize_t, cellsize_t > block = std::make_pair(0, numcell);
+  WorkDistributor<
+      DensityGridTraversalJobMarket< VoronoiDensityGridFaceTableUpdateFunction >,
+      DensityGridTraversalJob< VoronoiDensityGridFaceTableUpdateFunction > >
+      workers;
+  if (in_place) {
+    VoronoiDensityGridFaceTableUpdateFunction update(
+        *this, _face_offsets, _face_neighbours, _face_midpoints, _face_normals,
+        true);
+    DensityGridTraversalJobMarket< VoronoiDensityGridFaceTableUpdateFunction >
+        jobs(*this, update, block);
+    workers.do_in_parallel(jobs);
+  } else {
+    const size_t numface = face_offsets[numcell];
+    std::vector< uint_fast32_t > face_neighbours(numface);
+    std::vector< CoordinateVector<> > face_midpoints(numface);
+    std::vector< CoordinateVector<> > face_normals(numface);
+    VoronoiDensityGridFaceTableUpdateFunction update(
+        *this, face_offsets, face_neighbours, face_midpoints, face_normals,
+        false);
+    DensityGridTraversalJobMarket< VoronoiDensityGridFaceTableUpdateFunction >
+        jobs(*this, update, block);
+    workers.do_in_parallel(jobs);
+
+    _face_offsets.swap(face_offsets);
+    _face_neighbours.swap(face_neighbours);
+    _face_midpoints.swap(face_midpoints);
+    _face_normals.swap(face_normals);
+  }
+}
+
+/**
+ * @brief Rebuild the face table row of the given cell if the cell changed, or
+ * copy it from the old face table if it did not change and the face table is
+ * not updated in place.
+ *
+ * @param cell DensityGrid::iterator pointing to a cell.
+ */
+void VoronoiDensityGrid::VoronoiDensityGridFaceTableUpdateFunction::operator()(
+    DensityGrid::iterator cell) {
+
+  const uint_fast32_t index = cell.get_index();
+  size_t iface = _face_offsets[index];
+  if (_grid._voronoi_grid->has_changed(index)) {
+    const CoordinateVector<> ipos = _grid._generator_positions[index];
+    const uint_fast32_t numface = _face_offsets[index + 1] - iface;
+    for (uint_fast32_t i = 0; i < numface; ++i, ++iface) {
+      const uint_fast32_t ngb = _grid._voronoi_grid->get_face_neighbour(index, i);
+      _face_neighbours[iface] = ngb;
+      _face_midpoints[iface] = _grid._voronoi_grid->get_face_midpoint(index, i);
+      if (_grid._voronoi_grid->is_real_neighbour(ngb)) {
+        _face_normals[iface] = _grid._generator_positions[ngb] - ipos;
+      } else {
+        _face_normals[iface] = _grid._voronoi_grid->get_wall_normal(ngb);
+      }
+    }
+  } else if (!_in_place) {
+    const size_t old_end = _grid._face_offsets[index + 1];
+    for (size_t old_iface = _grid._face_offsets[index]; old_iface < old_end;
+         ++old_iface, ++iface) {
+      _face_neighbours[iface] = _grid._face_neighbours[old_iface];
+      _face_midpoints[iface] = _grid._face_midpoints[old_iface];
+      _face_normals[iface] = _grid._face_normals[old_iface];
+    }
+  }
+}
+
 /**
  * @brief Evolve the grid by moving the grid generators.
  *
@@ -232,10 +373,18 @@ void VoronoiDensityGrid::evolve(double timestep) {
 
     voronoidensitygrid_print_generators();
 
-    delete _voronoi_grid;
-    _voronoi_grid = VoronoiGridFactory::generate(
-        _voronoi_grid_type, _generator_positions, _box, _periodicity_flags);
-    _voronoi_grid->compute_grid();
+    if (_voronoi_grid->has_incremental_update()) {
+      // only update the cells (and face table rows) that are affected by the
+      // movement
+      _voronoi_grid->update_grid();
+      update_face_table();
+    } else {
+      delete _voronoi_grid;
+      _voronoi_grid = VoronoiGridFactory::generate(
+          _voronoi_grid_type, _generator_positions, _box, _periodicity_flags);
+      _voronoi_grid->compute_grid();
+      compute_face_table();
+    }
 
     if (_log) {
       _log->write_status("Done evolving Voronoi grid.");
@@ -243,6 +392,14 @@ void VoronoiDensityGrid::evolve(double timestep) {
   }
 }
 
+/**
+ * @brief Does the geometry of the grid change when evolve() is called?
+ *
+ * @return True if hydrodynamics is active, since the generators then move with
+ * the flow.
+ */
+bool VoronoiDensityGrid::has_moving_geometry() const { return _has_hydro; }
+
 /**
  * @brief Set the velocities of the grid generators.
  *
@@ -278,6 +435,42 @@ void VoronoiDensityGrid::set_grid_velocity(double gamma) {
   }
 }
 
+/**
+ * @brief Write the state of the grid to the given RestartWriter.
+ *
+ * On top of the cell variables, we write the generator positions and
+ * velocities, since these change during a hydro simulation.
+ *
+ * @param restart_writer RestartWriter to write to.
+ */
+void VoronoiDensityGrid::write_restart_file(
+    RestartWriter &restart_writer) const {
+
+  DensityGrid::write_restart_file(restart_writer);
+  restart_writer.write(_generator_positions);
+  restart_writer.write(_hydro_generator_velocity);
+}
+
+/**
+ * @brief Restore the state of the grid from the given RestartReader.
+ *
+ * The Voronoi grid is recomputed for the restored generator positions.
+ *
+ * @param restart_reader RestartReader to read from.
+ */
+void VoronoiDensityGrid::read_restart_file(RestartReader &restart_reader) {
+
+  DensityGrid::read_restart_file(restart_reader);
+  restart_reader.read_fixed_size(_generator_positions);
+  restart_reader.read_fixed_size(_hydro_generator_velocity);
+
+  delete _voronoi_grid;
+  _voronoi_grid = VoronoiGridFactory::generate(
+      _voronoi_grid_type, _generator_positions, _box, _periodicity_flags);
+  _voronoi_grid->compute_grid();
+  compute_face_table();
+}
+
 /**
  * @brief Get the velocity of the interface between the two given cells.
  *
@@ -392,6 +585,72 @@ std::vector< Face > VoronoiDensityGrid::get_faces(cellsize_t index) const {
   return _voronoi_grid->get_geometrical_faces(index);
 }
 
+/**
+ * @brief Get the geometrical information needed to integrate a function over
+ * the cell with the given index and to walk from the cell to its neighbours.
+ *
+ * @param index Index of a cell.
+ * @param bounding_box Bounding box of the vertices of the cell (in m).
+ * @param planes Bisector planes between the generator of the cell and the
+ * generators of its neighbours.
+ * @param ngbs Indices of the neighbouring cells within the box.
+ */
+void VoronoiDensityGrid::get_cell_geometry(
+    cellsize_t index, Box<> &bounding_box,
+    std::vector< std::pair< CoordinateVector<>, double > > &planes,
+    std::vector< cellsize_t > &ngbs) const {
+
+  const std::vector< Face > geometrical_faces =
+      _voronoi_grid->get_geometrical_faces(index);
+  CoordinateVector<> minimum = _generator_positions[index];
+  CoordinateVector<> maximum = _generator_positions[index];
+  for (size_t i = 0; i < geometrical_faces.size(); ++i) {
+    for (auto it = geometrical_faces[i].first_vertex();
+         it != geometrical_faces[i].last_vertex(); ++it) {
+      const CoordinateVector<> vertex = it.get_position();
+      for (uint_fast8_t j = 0; j < 3; ++j) {
+        minimum[j] = std::min(minimum[j], vertex[j]);
+        maximum[j] = std::max(maximum[j], vertex[j]);
+      }
+    }
+  }
+  bounding_box = Box<>(minimum, maximum - minimum);
+
+  planes.clear();
+  ngbs.clear();
+  const CoordinateVector<> &generator = _generator_positions[index];
+  const std::vector< VoronoiFace > faces = _voronoi_grid->get_faces(index);
+  for (size_t i = 0; i < faces.size(); ++i) {
+    const uint_fast32_t ngb = faces[i].get_neighbour();
+    if (!_voronoi_grid->is_real_neighbour(ngb)) {
+      // walls coincide with the box, which bounds the bounding box
+      continue;
+    }
+    CoordinateVector<> rel_pos = _generator_positions[ngb] - generator;
+    bool periodic_ngb = false;
+    for (uint_fast8_t j = 0; j < 3; ++j) {
+      if (_periodicity_flags[j]) {
+        const double side = _box.get_sides()[j];
+        if (2. * rel_pos[j] < -side) {
+          rel_pos[j] += side;
+          periodic_ngb = true;
+        } else if (2. * rel_pos[j] >= side) {
+          rel_pos[j] -= side;
+          periodic_ngb = true;
+        }
+      }
+    }
+    // the bisector plane of the generator and the (periodic copy of the)
+    // neighbour
+    planes.push_back(std::make_pair(
+        rel_pos, CoordinateVector<>::dot_product(
+                     rel_pos, generator + 0.5 * rel_pos)));
+    if (!periodic_ngb) {
+      ngbs.push_back(ngb);
+    }
+  }
+}
+
 /**
  * @brief Get the volume of the cell with the given index.
  *
@@ -437,48 +696,17 @@ DensityGrid::iterator VoronoiDensityGrid::interact(Photon &photon,
 
   uint_fast32_t index = _voronoi_grid->get_index(photon_origin);
   while (_voronoi_grid->is_real_neighbour(index) && optical_depth > 0.) {
-    CoordinateVector<> ipos = _generator_positions[index];
     uint_fast32_t next_index = 0;
     uint_fast32_t loopcount = 0;
     double mins = -1.;
     while (mins <= 0.) {
-      mins = -1;
-      auto faces = _voronoi_grid->get_faces(index);
-      for (auto it = faces.begin(); it != faces.end(); ++it) {
-        const VoronoiFace &face = *it;
-        const uint_fast32_t ngb = face.get_neighbour();
-        CoordinateVector<> normal;
-        if (_voronoi_grid->is_real_neighbour(ngb)) {
-          normal = _generator_positions[ngb] - ipos;
-        } else {
-          normal = _voronoi_grid->get_wall_normal(ngb);
-        }
-        const double nk =
-            CoordinateVector<>::dot_product(normal, photon_direction);
-        if (nk > 0) {
-          const CoordinateVector<> point = face.get_midpoint();
-          // in principle, the dot product should always be positive (as
-          // 'photon_origin' is supposed to lie inside the cell)
-          // however, due to roundoff, it could happen that 'photon_origin'
-          // actually is marginally outside the cell, making the dot product
-          // negative. To resolve this issue, we take the absolute value of the
-          // dot product; this guarantees that the sign of 'sngb' is set by the
-          // sign of 'nk', as is the case in a perfect world without roundoff
-          const double sngb = std::abs(CoordinateVector<>::dot_product(
-                                  normal, (point - photon_origin))) /
-                              nk;
-          if (mins < 0. || (sngb > 0. && sngb < mins)) {
-            mins = sngb;
-            next_index = ngb;
-          }
-        }
-      }
+      mins = get_distance_to_next_face(index, photon_origin, photon_direction,
+                                       next_index);
       ++loopcount;
       cmac_assert_message(loopcount < 100, "mins: %g", mins);
       if (mins <= 0.) {
         photon_origin += _epsilon * photon_direction;
         index = _voronoi_grid->get_index(photon_origin);
-        ipos = _generator_positions[index];
       }
     }
     if (!_voronoi_grid->is_real_neighbour(index)) {
@@ -522,58 +750,38 @@ DensityGrid::iterator VoronoiDensityGrid::interact(Photon &photon,
 
 /**
  * @brief Get the total line emission along a ray with the given origin and
- * direction.
+ * direction, for all given lines at once.
  *
  * @param origin Origin of the ray (in m).
  * @param direction Direction of the ray.
- * @param line EmissionLine name of the line to trace.
- * @return Accumulated emission along the ray (in J m^-2 s^-1).
+ * @param lines EmissionLine names of the lines to trace.
+ * @param emissions Array to store the accumulated emission along the ray for
+ * every line in (in J m^-2 s^-1).
  */
-double VoronoiDensityGrid::get_total_emission(CoordinateVector<> origin,
-                                              CoordinateVector<> direction,
-                                              EmissionLine line) {
+void VoronoiDensityGrid::get_total_emissions(
+    CoordinateVector<> origin, CoordinateVector<> direction,
+    const std::vector< EmissionLine > &lines, double *emissions) {
 
-  double S = 0.;
+  const size_t numline = lines.size();
+  for (size_t iline = 0; iline < numline; ++iline) {
+    emissions[iline] = 0.;
+  }
 
   // move the ray a tiny bit to make sure it is inside the cell
   origin += _epsilon * direction;
 
   uint_fast32_t index = _voronoi_grid->get_index(origin);
   while (_voronoi_grid->is_real_neighbour(index)) {
-    CoordinateVector<> ipos = _generator_positions[index];
     uint_fast32_t next_index = 0;
     uint_fast32_t loopcount = 0;
     double mins = -1.;
     while (mins <= 0.) {
-      mins = -1;
-      auto faces = _voronoi_grid->get_faces(index);
-      for (auto it = faces.begin(); it != faces.end(); ++it) {
-        const VoronoiFace &face = *it;
-        const uint_fast32_t ngb = face.get_neighbour();
-        CoordinateVector<> normal;
-        if (_voronoi_grid->is_real_neighbour(ngb)) {
-          normal = _generator_positions[ngb] - ipos;
-        } else {
-          normal = _voronoi_grid->get_wall_normal(ngb);
-        }
-        const double nk = CoordinateVector<>::dot_product(normal, direction);
-        if (nk > 0) {
-          const CoordinateVector<> point = face.get_midpoint();
-          const double sngb = std::abs(CoordinateVector<>::dot_product(
-                                  normal, (point - origin))) /
-                              nk;
-          if (mins < 0. || (sngb > 0. && sngb < mins)) {
-            mins = sngb;
-            next_index = ngb;
-          }
-        }
-      }
+      mins = get_distance_to_next_face(index, origin, direction, next_index);
       ++loopcount;
       cmac_assert_message(loopcount < 100, "mins: %g", mins);
       if (mins <= 0.) {
         origin += _epsilon * direction;
         index = _voronoi_grid->get_index(origin);
-        ipos = _generator_positions[index];
       }
     }
     if (!_voronoi_grid->is_real_neighbour(index)) {
@@ -585,10 +793,11 @@ double VoronoiDensityGrid::get_total_emission(CoordinateVector<> origin,
     index = next_index;
     origin += mins * direction;
 
-    S += mins * it.get_emissivities()->get_emissivity(line);
+    const EmissivityValues *emissivities = it.get_emissivities();
+    for (size_t iline = 0; iline < numline; ++iline) {
+      emissions[iline] += mins * emissivities->get_emissivity(lines[iline]);
+    }
   }
-
-  return S;
 }
 
 /**
@@ -64,6 +64,119 @@ private:
   /*! @brief Type of Voronoi grid to use. */
   std::string _voronoi_grid_type;
 
+  /// flat face connectivity table used for photon traversal
+
+  /*! @brief Offsets of the faces of each cell in the face table: the faces of
+   *  cell i are stored in the range [_face_offsets[i], _face_offsets[i+1]). */
+  std::vector< size_t > _face_offsets;
+
+  /*! @brief Neighbour index of every face in the face table. */
+  std::vector< uint_fast32_t > _face_neighbours;
+
+  /*! @brief Midpoint of every face in the face table (in m). */
+  std::vector< CoordinateVector<> > _face_midpoints;
+
+  /*! @brief Normal of every face in the face table: the (not normalized)
+   *  vector from the cell generator to the neighbouring generator, or the wall
+   *  normal for faces on the simulation box walls. */
+  std::vector< CoordinateVector<> > _face_normals;
+
+  void compute_face_table();
+  void update_face_table();
+
+  /**
+   * @brief Functor class used to rebuild the rows of the face table that
+   * belong to cells that changed during the last update of the Voronoi grid.
+   *
+   * Rows of cells that did not change are copied from the old face table,
+   * unless the new face table is the same as the old face table (in which case
+   * they are left untouched).
+   */
+  class VoronoiDensityGridFaceTableUpdateFunction {
+  private:
+    /*! @brief VoronoiDensityGrid that owns the old face table. */
+    const VoronoiDensityGrid &_grid;
+
+    /*! @brief Offsets of the rows in the new face table. */
+    const std::vector< size_t > &_face_offsets;
+
+    /*! @brief Neighbour indices in the new face table. */
+    std::vector< uint_fast32_t > &_face_neighbours;
+
+    /*! @brief Face midpoints in the new face table (in m). */
+    std::vector< CoordinateVector<> > &_face_midpoints;
+
+    /*! @brief Face normals in the new face table. */
+    std::vector< CoordinateVector<> > &_face_normals;
+
+    /*! @brief Is the new face table the same as the old face table? */
+    const bool _in_place;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param grid VoronoiDensityGrid that owns the old face table.
+     * @param face_offsets Offsets of the rows in the new face table.
+     * @param face_neighbours Neighbour indices in the new face table.
+     * @param face_midpoints Face midpoints in the new face table (in m).
+     * @param face_normals Face normals in the new face table.
+     * @param in_place Is the new face table the same as the old face table?
+     */
+    inline VoronoiDensityGridFaceTableUpdateFunction(
+        const VoronoiDensityGrid &grid,
+        const std::vector< size_t > &face_offsets,
+        std::vector< uint_fast32_t > &face_neighbours,
+        std::vector< CoordinateVector<> > &face_midpoints,
+        std::vector< CoordinateVector<> > &face_normals, const bool in_place)
+        : _grid(grid), _face_offsets(face_offsets),
+          _face_neighbours(face_neighbours), _face_midpoints(face_midpoints),
+          _face_normals(face_normals), _in_place(in_place) {}
+
+    void operator()(DensityGrid::iterator cell);
+  };
+
+  /**
+   * @brief Get the distance along the given direction from the given position
+   * to the closest face of the cell with the given index.
+   *
+   * @param index Index of the cell that contains the position.
+   * @param position Position (in m).
+   * @param direction Direction.
+   * @param next_index Variable to store the index of the neighbour on the
+   * other side of the closest face in.
+   * @return Distance to the closest face (in m), or a negative value if no
+   * face could be found.
+   */
+  inline double get_distance_to_next_face(uint_fast32_t index,
+                                          const CoordinateVector<> &position,
+                                          const CoordinateVector<> &direction,
+                                          uint_fast32_t &next_index) const {
+    double mins = -1.;
+    const size_t face_end = _face_offsets[index + 1];
+    for (size_t iface = _face_offsets[index]; iface < face_end; ++iface) {
+      const CoordinateVector<> &normal = _face_normals[iface];
+      const double nk = CoordinateVector<>::dot_product(normal, direction);
+      if (nk > 0) {
+        // in principle, the dot product should always be positive (as
+        // 'position' is supposed to lie inside the cell)
+        // however, due to roundoff, it could happen that 'position' actually
+        // is marginally outside the cell, making the dot product negative. To
+        // resolve this issue, we take the absolute value of the dot product;
+        // this guarantees that the sign of 'sngb' is set by the sign of 'nk',
+        // as is the case in a perfect world without roundoff
+        const double sngb = std::abs(CoordinateVector<>::dot_product(
+                                normal, (_face_midpoints[iface] - position))) /
+                            nk;
+        if (mins < 0. || (sngb > 0. && sngb < mins)) {
+          mins = sngb;
+          next_index = _face_neighbours[iface];
+        }
+      }
+    }
+    return mins;
+  }
+
 public:
   VoronoiDensityGrid(
       VoronoiGeneratorDistribution *position_generator,
@@ -80,8 +193,12 @@ public:
   virtual void initialize(std::pair< cellsize_t, cellsize_t > &block,
                           DensityFunction &density_function);
   virtual void evolve(double timestep);
+  virtual bool has_moving_geometry() const;
   virtual void set_grid_velocity(double gamma);
 
+  virtual void write_restart_file(RestartWriter &restart_writer) const;
+  virtual void read_restart_file(RestartReader &restart_reader);
+
   virtual CoordinateVector<>
   get_interface_velocity(const iterator left, const iterator right,
                          const CoordinateVector<> interface_midpoint) const;
@@ -94,12 +211,17 @@ public:
                   CoordinateVector<> > >
   get_neighbours(cellsize_t index);
   virtual std::vector< Face > get_faces(cellsize_t index) const;
+  virtual void
+  get_cell_geometry(cellsize_t index, Box<> &bounding_box,
+                    std::vector< std::pair< CoordinateVector<>, double > > &planes,
+                    std::vector< cellsize_t > &ngbs) const;
   virtual double get_cell_volume(cellsize_t index) const;
   virtual double integrate_optical_depth(const Photon &photon);
   virtual DensityGrid::iterator interact(Photon &photon, double optical_depth);
-  virtual double get_total_emission(CoordinateVector<> origin,
-                                    CoordinateVector<> direction,
-                                    EmissionLine line);
+  virtual void get_total_emissions(CoordinateVector<> origin,
+                                   CoordinateVector<> direction,
+                                   const std::vector< EmissionLine > &lines,
+                                   double *emissions);
   virtual DensityGrid::iterator begin();
   virtual DensityGrid::iterator end();
 };
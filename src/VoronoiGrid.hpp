@@ -27,6 +27,7 @@
 #define VORONOIGRID_HPP
 
 #include "CoordinateVector.hpp"
+#include "Error.hpp"
 #include "Face.hpp"
 #include "VoronoiFace.hpp"
 
@@ -48,6 +49,30 @@ public:
    */
   virtual void compute_grid(int_fast32_t worksize = -1) = 0;
 
+  /**
+   * @brief Does this implementation support incremental updates of the grid
+   * after the generators have moved?
+   *
+   * @return False, implementations that support update_grid() should override
+   * this.
+   */
+  virtual bool has_incremental_update() const { return false; }
+
+  /**
+   * @brief Update the Voronoi grid after the generators have moved, by only
+   * recomputing the cells that are affected by the movement.
+   *
+   * Only supported if has_incremental_update() returns true; the grid needs to
+   * be reconstructed from scratch otherwise.
+   *
+   * @param worksize Number of shared memory threads to use during the grid
+   * update.
+   */
+  virtual void update_grid(int_fast32_t worksize = -1) {
+    cmac_error("This VoronoiGrid implementation does not support incremental "
+               "updates!");
+  }
+
   /**
    * @brief Get the volume of the Voronoi cell with the given index.
    *
@@ -89,6 +114,55 @@ public:
   virtual std::vector< Face >
   get_geometrical_faces(uint_fast32_t index) const = 0;
 
+  /**
+   * @brief Did the Voronoi cell with the given index change during the last
+   * grid construction or update?
+   *
+   * @param index Index of a cell.
+   * @return True, implementations that support update_grid() should override
+   * this.
+   */
+  virtual bool has_changed(uint_fast32_t index) const { return true; }
+
+  /**
+   * @brief Get the number of faces of the Voronoi cell with the given index.
+   *
+   * Implementations should override this (and the other face access
+   * functions below) if they can avoid the copy made by get_faces().
+   *
+   * @param index Index of a cell.
+   * @return Number of faces of that cell.
+   */
+  virtual uint_fast32_t get_number_of_faces(uint_fast32_t index) const {
+    return get_faces(index).size();
+  }
+
+  /**
+   * @brief Get the index of the neighbour that generated the given face of the
+   * Voronoi cell with the given index.
+   *
+   * @param index Index of a cell.
+   * @param face Index of a face of that cell.
+   * @return Index of the neighbouring cell (or wall).
+   */
+  virtual uint_fast32_t get_face_neighbour(uint_fast32_t index,
+                                           uint_fast32_t face) const {
+    return get_faces(index)[face].get_neighbour();
+  }
+
+  /**
+   * @brief Get the midpoint of the given face of the Voronoi cell with the
+   * given index.
+   *
+   * @param index Index of a cell.
+   * @param face Index of a face of that cell.
+   * @return Midpoint of the face (in m).
+   */
+  virtual CoordinateVector<> get_face_midpoint(uint_fast32_t index,
+                                               uint_fast32_t face) const {
+    return get_faces(index)[face].get_midpoint();
+  }
+
   /**
    * @brief Get the index of the Voronoi cell that contains the given position.
    *
@@ -0,0 +1,174 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file WalkerAliasTable.hpp
+ *
+ * @brief Walker alias table used to sample a discrete probability distribution
+ * in constant time.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef WALKERALIASTABLE_HPP
+#define WALKERALIASTABLE_HPP
+
+#include "Error.hpp"
+
+#include <cinttypes>
+#include <vector>
+
+/**
+ * @brief Walker alias table used to sample a discrete probability distribution
+ * in constant time.
+ *
+ * The table is set up using the algorithm of Vose, M. D. 1991, IEEE
+ * Transactions on Software Engineering, 17, 972. Every bin of the table has an
+ * acceptance probability and an alias: a uniform random number first selects
+ * a bin, and is then reused to decide between the bin itself and its alias.
+ */
+class WalkerAliasTable {
+private:
+  /*! @brief Acceptance probability of each bin. */
+  std::vector< double > _probabilities;
+
+  /*! @brief Alias of each bin. */
+  std::vector< uint_fast32_t > _aliases;
+
+public:
+  /**
+   * @brief Empty constructor.
+   */
+  inline WalkerAliasTable() {}
+
+  /**
+   * @brief Constructor.
+   *
+   * @param weights Weights of the discrete values (do not need to be
+   * normalized).
+   */
+  inline WalkerAliasTable(const std::vector< double > &weights) {
+    initialize(weights);
+  }
+
+  /**
+   * @brief Set up the table for the given weights.
+   *
+   * @param weights Weights of the discrete values (do not need to be
+   * normalized).
+   */
+  inline void initialize(const std::vector< double > &weights) {
+
+    const uint_fast32_t size = weights.size();
+    if (size == 0) {
+      cmac_error("Cannot set up a WalkerAliasTable without weights!");
+    }
+
+    double total_weight = 0.;
+    for (uint_fast32_t i = 0; i < size; ++i) {
+      if (weights[i] < 0.) {
+        cmac_error("Negative weight in WalkerAliasTable (%g)!", weights[i]);
+      }
+      total_weight += weights[i];
+    }
+    if (total_weight <= 0.) {
+      cmac_error("Total weight of a WalkerAliasTable is zero!");
+    }
+
+    _probabilities.resize(size);
+    _aliases.resize(size);
+
+    // rescale the weights so that the average bin has a weight of 1, and
+    // divide the bins into bins that are too small and bins that are too large
+    std::vector< double > scaled_weights(size);
+    std::vector< uint_fast32_t > small, large;
+    for (uint_fast32_t i = 0; i < size; ++i) {
+      scaled_weights[i] = weights[i] * size / total_weight;
+      if (scaled_weights[i] < 1.) {
+        small.push_back(i);
+      } else {
+        large.push_back(i);
+      }
+    }
+
+    // fill up the small bins using the excess weight of the large bins
+    while (!small.empty() && !large.empty()) {
+      const uint_fast32_t ismall = small.back();
+      small.pop_back();
+      const uint_fast32_t ilarge = large.back();
+      large.pop_back();
+
+      _probabilities[ismall] = scaled_weights[ismall];
+      _aliases[ismall] = ilarge;
+
+      scaled_weights[ilarge] =
+          (scaled_weights[ilarge] + scaled_weights[ismall]) - 1.;
+      if (scaled_weights[ilarge] < 1.) {
+        small.push_back(ilarge);
+      } else {
+        large.push_back(ilarge);
+      }
+    }
+
+    // the remaining bins have a weight of 1 (up to round off)
+    while (!large.empty()) {
+      const uint_fast32_t i = large.back();
+      large.pop_back();
+      _probabilities[i] = 1.;
+      _aliases[i] = i;
+    }
+    while (!small.empty()) {
+      const uint_fast32_t i = small.back();
+      small.pop_back();
+      _probabilities[i] = 1.;
+      _aliases[i] = i;
+    }
+  }
+
+  /**
+   * @brief Get the number of discrete values in the table.
+   *
+   * @return Number of discrete values.
+   */
+  inline uint_fast32_t get_size() const { return _probabilities.size(); }
+
+  /**
+   * @brief Sample a discrete value from the table.
+   *
+   * @param uniform_random_double Uniform random number in the range [0, 1[.
+   * @return Index of the sampled value.
+   */
+  inline uint_fast32_t sample(const double uniform_random_double) const {
+
+    cmac_assert(!_probabilities.empty());
+
+    const uint_fast32_t size = _probabilities.size();
+    const double x = uniform_random_double * size;
+    uint_fast32_t index = x;
+    if (index >= size) {
+      index = size - 1;
+    }
+    if (x - index < _probabilities[index]) {
+      return index;
+    } else {
+      return _aliases[index];
+    }
+  }
+};
+
+#endif // WALKERALIASTABLE_HPP
@@ -107,6 +107,35 @@ public:
 
     return num_threads;
   }
+
+  /**
+   * @brief Get the maximum number of threads that can be used by a parallel
+   * region that is started from the calling thread.
+   *
+   * @return Maximum number of threads (1 if OpenMP is not available).
+   */
+  inline static int_fast32_t get_max_num_threads() {
+#ifdef HAVE_OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+  }
+
+  /**
+   * @brief Get the rank of the calling thread within the current parallel
+   * region.
+   *
+   * @return Rank of the calling thread (0 if OpenMP is not available or if the
+   * caller is not inside a parallel region).
+   */
+  inline static int_fast32_t get_thread_id() {
+#ifdef HAVE_OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+  }
 };
 
 #endif // WORKENVIRONMENT_HPP
@@ -0,0 +1,442 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file WorkStealingScheduler.hpp
+ *
+ * @brief Scheduler that distributes a range of work items over a number of
+ * threads, using per thread queues, work stealing and adaptive chunk sizes.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef WORKSTEALINGSCHEDULER_HPP
+#define WORKSTEALINGSCHEDULER_HPP
+
+#include "Configuration.hpp"
+#include "Error.hpp"
+#include "Lock.hpp"
+#include "Timer.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <new>
+
+/*! @brief Size of a cache line (in bytes). */
+#define WORKSTEALINGSCHEDULER_CACHE_LINE_SIZE 64
+
+/**
+ * @brief Scheduler that distributes a range of work items over a number of
+ * threads, using per thread queues, work stealing and adaptive chunk sizes.
+ *
+ * The scheduler is meant to be used inside a JobMarket: the JobMarket resets
+ * the scheduler in its set_worksize() method (which is called by the
+ * WorkDistributor right before the workers are started), and asks it for a
+ * new chunk of work items in every call to get_job().
+ *
+ * When the scheduler is reset, the range of work items is split in equal
+ * contiguous blocks, one for every thread. Every thread has its own queue,
+ * which is protected by its own Lock, so that threads do not compete for a
+ * single shared counter. A thread takes chunks from the front of its own
+ * queue. When its queue is empty, it steals the back half of the remaining
+ * work in the queue with the most remaining work items. A thread only runs
+ * out of work when all queues are empty.
+ *
+ * The size of a chunk is not fixed, but adapts to the measured cost of the
+ * work items: the time in between two consecutive requests of the same
+ * thread is the time it took to execute the previous chunk, which gives us an
+ * estimate of the cost of a single work item. New chunks are then sized so
+ * that their execution takes approximately the requested target time. This
+ * way, expensive work items are handed out in small chunks (so that the load
+ * balance at the end of a pass is good), while cheap work items are handed
+ * out in large chunks (so that the scheduling overhead remains small).
+ *
+ * Optionally, all chunk boundaries can be aligned to a multiple of a given
+ * alignment (relative to the start of the range). This can be used to make
+ * sure groups of work items are always executed together, independent of how
+ * the work is distributed over the threads.
+ */
+class WorkStealingScheduler {
+private:
+  /*! @brief Number of threads that currently use the scheduler. */
+  int_fast32_t _worksize;
+
+  /*! @brief Target execution time for a single chunk (in s). */
+  const double _target_chunk_time;
+
+  /*! @brief Size of the first chunk handed out to a thread that has no cost
+   *  estimate yet. */
+  const uint_fast64_t _initial_chunk_size;
+
+  /*! @brief Minimum size of a chunk. */
+  const uint_fast64_t _minimum_chunk_size;
+
+  /*! @brief Maximum size of a chunk. */
+  const uint_fast64_t _maximum_chunk_size;
+
+  /*! @brief Alignment of the chunk boundaries. */
+  uint_fast64_t _alignment;
+
+  /*! @brief Index of the first work item in the range. */
+  uint_fast64_t _range_begin;
+
+  /**
+   * @brief Scheduling state of a single thread.
+   *
+   * The state of every thread lives in its own cache line(s), so that threads
+   * updating their own state do not invalidate the cache lines other threads
+   * are reading from (false sharing).
+   */
+  struct alignas(WORKSTEALINGSCHEDULER_CACHE_LINE_SIZE) ThreadState {
+    /*! @brief Index of the first work item in the queue of the thread. */
+    uint_fast64_t _queue_begin;
+
+    /*! @brief Index of the first work item beyond the queue of the thread. */
+    uint_fast64_t _queue_end;
+
+    /*! @brief Lock that protects the queue of the thread. */
+    Lock _queue_lock;
+
+    /*! @brief Estimated cost of a single work item, as measured by the thread
+     *  (in s). */
+    double _cost_per_item;
+
+    /*! @brief Size of the chunk that was last handed out to the thread. */
+    uint_fast64_t _last_chunk_size;
+
+    /*! @brief Timer used to measure the execution time of the last chunk
+     *  handed out to the thread. */
+    Timer _chunk_timer;
+
+    /*! @brief Number of successful steals by the thread since the last reset.
+     */
+    uint_fast32_t _number_of_steals;
+
+    /**
+     * @brief Constructor.
+     */
+    inline ThreadState()
+        : _queue_begin(0), _queue_end(0), _cost_per_item(0.),
+          _last_chunk_size(0), _number_of_steals(0) {}
+  };
+
+  /*! @brief Memory that holds the thread states. Allocated separately, since
+   *  operator new does not respect the alignment of ThreadState before
+   *  C++17. */
+  char *_thread_state_memory;
+
+  /*! @brief Scheduling state of each thread (stored in _thread_state_memory,
+   *  aligned to a cache line boundary). */
+  ThreadState *_threads;
+
+  /**
+   * @brief Round the given index up to the next chunk boundary.
+   *
+   * @param index Index.
+   * @param limit Upper limit for the result.
+   * @return Smallest aligned index that is larger than or equal to the given
+   * index, or the given limit if that is smaller.
+   */
+  inline uint_fast64_t align(const uint_fast64_t index,
+                             const uint_fast64_t limit) const {
+    const uint_fast64_t offset = index - _range_begin + _alignment - 1;
+    return std::min(_range_begin + offset - offset % _alignment, limit);
+  }
+
+  /**
+   * @brief Get the number of work items in the queue of the given thread.
+   *
+   * @param thread_id Thread index.
+   * @return Number of work items that are still in the queue of that thread.
+   */
+  inline uint_fast64_t get_queue_size(const int_fast32_t thread_id) {
+    ThreadState &state = _threads[thread_id];
+    state._queue_lock.lock();
+    const uint_fast64_t size = state._queue_end - state._queue_begin;
+    state._queue_lock.unlock();
+    return size;
+  }
+
+  /**
+   * @brief Get the size of the next chunk for the given thread, based on the
+   * cost of the last chunk it executed.
+   *
+   * @param thread_id Thread index.
+   * @return Size of the next chunk.
+   */
+  inline uint_fast64_t get_next_chunk_size(const int_fast32_t thread_id) {
+
+    ThreadState &state = _threads[thread_id];
+    if (state._last_chunk_size > 0) {
+      // a chunk that finishes within the timer resolution gives us an upper
+      // limit on the cost, which makes the chunk size grow rapidly
+      const double time = std::max(state._chunk_timer.interval(), 1.e-6);
+      const double cost = time / state._last_chunk_size;
+      if (state._cost_per_item > 0.) {
+        // smooth out fluctuations in the cost by averaging with the previous
+        // estimate
+        state._cost_per_item = 0.5 * (state._cost_per_item + cost);
+      } else {
+        state._cost_per_item = cost;
+      }
+    }
+
+    if (state._cost_per_item > 0.) {
+      const double chunk_size = _target_chunk_time / state._cost_per_item;
+      if (chunk_size >= _maximum_chunk_size) {
+        return _maximum_chunk_size;
+      } else {
+        return std::max(static_cast< uint_fast64_t >(chunk_size),
+                        _minimum_chunk_size);
+      }
+    } else {
+      return _initial_chunk_size;
+    }
+  }
+
+  /**
+   * @brief Steal the back half of the remaining work items from the queue with
+   * the most remaining work items.
+   *
+   * @param thread_id Index of the thread that steals.
+   * @param begin Variable to store the index of the first stolen work item in.
+   * @param end Variable to store the index beyond the last stolen work item
+   * in.
+   * @return True if work was stolen, false if all queues are empty.
+   */
+  inline bool steal(const int_fast32_t thread_id, uint_fast64_t &begin,
+                    uint_fast64_t &end) {
+
+    while (true) {
+      int_fast32_t victim = -1;
+      uint_fast64_t victim_size = 0;
+      for (int_fast32_t i = 1; i < _worksize; ++i) {
+        const int_fast32_t candidate = (thread_id + i) % _worksize;
+        const uint_fast64_t size = get_queue_size(candidate);
+        if (size > victim_size) {
+          victim = candidate;
+          victim_size = size;
+        }
+      }
+      if (victim < 0) {
+        // all queues are empty: the remaining work items are being executed
+        return false;
+      }
+
+      // the victim might have taken work from its queue (or another thread
+      // might have stolen from it) in the meantime, so we need to recheck
+      ThreadState &victim_state = _threads[victim];
+      victim_state._queue_lock.lock();
+      const uint_fast64_t size =
+          victim_state._queue_end - victim_state._queue_begin;
+      if (size > 0) {
+        end = victim_state._queue_end;
+        begin = align(victim_state._queue_begin + size / 2, end);
+        if (begin == end) {
+          // the remaining work cannot be split: steal all of it
+          begin = victim_state._queue_begin;
+        }
+        victim_state._queue_end = begin;
+      }
+      victim_state._queue_lock.unlock();
+      if (size > 0) {
+        ++_threads[thread_id]._number_of_steals;
+        return true;
+      }
+    }
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param target_chunk_time Target execution time for a single chunk (in s).
+   * @param initial_chunk_size Size of the first chunk handed out to a thread
+   * for which no cost estimate is available yet.
+   * @param minimum_chunk_size Minimum size of a chunk.
+   * @param maximum_chunk_size Maximum size of a chunk.
+   */
+  inline WorkStealingScheduler(
+      const double target_chunk_time = 1.e-3,
+      const uint_fast64_t initial_chunk_size = 1,
+      const uint_fast64_t minimum_chunk_size = 1,
+      const uint_fast64_t maximum_chunk_size = UINT_FAST64_MAX)
+      : _worksize(0), _target_chunk_time(target_chunk_time),
+        _initial_chunk_size(std::max(initial_chunk_size, minimum_chunk_size)),
+        _minimum_chunk_size(std::max(minimum_chunk_size, uint_fast64_t(1))),
+        _maximum_chunk_size(std::max(maximum_chunk_size, minimum_chunk_size)),
+        _alignment(1), _range_begin(0) {
+
+    _thread_state_memory =
+        new char[MAX_NUM_THREADS * sizeof(ThreadState) +
+                 WORKSTEALINGSCHEDULER_CACHE_LINE_SIZE];
+    const uintptr_t address =
+        reinterpret_cast< uintptr_t >(_thread_state_memory);
+    const uintptr_t offset = (WORKSTEALINGSCHEDULER_CACHE_LINE_SIZE -
+                              address % WORKSTEALINGSCHEDULER_CACHE_LINE_SIZE) %
+                             WORKSTEALINGSCHEDULER_CACHE_LINE_SIZE;
+    _threads =
+        reinterpret_cast< ThreadState * >(_thread_state_memory + offset);
+    for (int_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
+      new (&_threads[i]) ThreadState();
+    }
+  }
+
+  /**
+   * @brief Destructor.
+   */
+  inline ~WorkStealingScheduler() {
+    for (int_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
+      _threads[i].~ThreadState();
+    }
+    delete[] _thread_state_memory;
+  }
+
+  WorkStealingScheduler(const WorkStealingScheduler &) = delete;
+  WorkStealingScheduler &operator=(const WorkStealingScheduler &) = delete;
+
+  /**
+   * @brief Align all chunk boundaries to multiples of the given alignment.
+   *
+   * Takes effect at the next reset().
+   *
+   * @param alignment Alignment (relative to the start of the range).
+   */
+  inline void set_alignment(const uint_fast64_t alignment) {
+    _alignment = std::max(alignment, uint_fast64_t(1));
+  }
+
+  /**
+   * @brief Distribute the given range of work items over the queues of the
+   * given number of threads.
+   *
+   * The cost estimates of earlier runs are kept, so that a scheduler that is
+   * reused for similar work immediately hands out chunks of the right size.
+   *
+   * This method should not be called while threads are requesting chunks.
+   *
+   * @param begin Index of the first work item.
+   * @param end Index beyond the last work item.
+   * @param worksize Number of threads that will request chunks.
+   */
+  inline void reset(const uint_fast64_t begin, const uint_fast64_t end,
+                    const int_fast32_t worksize) {
+
+    cmac_assert(begin <= end);
+    if (worksize < 1 || worksize > MAX_NUM_THREADS) {
+      cmac_error("Invalid number of threads for WorkStealingScheduler: "
+                 "%" PRIiFAST32 " (MAX_NUM_THREADS = %i)!",
+                 worksize, MAX_NUM_THREADS);
+    }
+
+    _worksize = worksize;
+    _range_begin = begin;
+    const uint_fast64_t size = end - begin;
+    for (int_fast32_t i = 0; i < _worksize; ++i) {
+      ThreadState &state = _threads[i];
+      state._queue_begin = align(begin + (size * i) / _worksize, end);
+      state._queue_end = align(begin + (size * (i + 1)) / _worksize, end);
+      state._last_chunk_size = 0;
+      state._number_of_steals = 0;
+    }
+  }
+
+  /**
+   * @brief Get the next chunk of work items for the given thread.
+   *
+   * Calling this method also signals that the thread finished the previous
+   * chunk it got, which is used to update the cost estimate for that thread.
+   *
+   * @param thread_id Index of the thread that requests work.
+   * @param begin Variable to store the index of the first work item of the
+   * chunk in.
+   * @param end Variable to store the index beyond the last work item of the
+   * chunk in.
+   * @return True if a chunk was handed out, false if all work is done.
+   */
+  inline bool get_chunk(const int_fast32_t thread_id, uint_fast64_t &begin,
+                        uint_fast64_t &end) {
+
+    cmac_assert(thread_id >= 0 && thread_id < _worksize);
+
+    const uint_fast64_t chunk_size = get_next_chunk_size(thread_id);
+
+    ThreadState &state = _threads[thread_id];
+    bool has_chunk = false;
+    state._queue_lock.lock();
+    if (state._queue_begin < state._queue_end) {
+      begin = state._queue_begin;
+      end = align(begin + std::min(chunk_size, state._queue_end - begin),
+                  state._queue_end);
+      state._queue_begin = end;
+      has_chunk = true;
+    }
+    state._queue_lock.unlock();
+
+    if (!has_chunk) {
+      uint_fast64_t steal_begin, steal_end;
+      if (steal(thread_id, steal_begin, steal_end)) {
+        begin = steal_begin;
+        end = align(begin + std::min(chunk_size, steal_end - begin), steal_end);
+        // the remainder of the stolen work goes into our own (empty) queue,
+        // where other threads can steal it again
+        state._queue_lock.lock();
+        state._queue_begin = end;
+        state._queue_end = steal_end;
+        state._queue_lock.unlock();
+        has_chunk = true;
+      }
+    }
+
+    if (has_chunk) {
+      state._last_chunk_size = end - begin;
+      state._chunk_timer.start();
+    } else {
+      state._last_chunk_size = 0;
+    }
+    return has_chunk;
+  }
+
+  /**
+   * @brief Get the current cost estimate for a single work item, as measured
+   * by the given thread.
+   *
+   * @param thread_id Thread index.
+   * @return Estimated cost of a single work item (in s), or 0 if no estimate
+   * is available yet.
+   */
+  inline double get_cost_per_item(const int_fast32_t thread_id) const {
+    return _threads[thread_id]._cost_per_item;
+  }
+
+  /**
+   * @brief Get the total number of successful steals since the last reset.
+   *
+   * @return Number of times a thread stole work from another thread.
+   */
+  inline uint_fast32_t get_number_of_steals() const {
+    uint_fast32_t number_of_steals = 0;
+    for (int_fast32_t i = 0; i < _worksize; ++i) {
+      number_of_steals += _threads[i]._number_of_steals;
+    }
+    return number_of_steals;
+  }
+};
+
+#endif // WORKSTEALINGSCHEDULER_HPP
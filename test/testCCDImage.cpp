@@ -23,6 +23,7 @@
  *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
+#include "Assert.hpp"
 #include "CCDImage.hpp"
 #include "RandomGenerator.hpp"
 
@@ -71,5 +72,31 @@ int main(int argc, char **argv) {
 
   image.save();
 
+  /// multiple observers
+  {
+    ParameterFile params;
+    params.add_value("CCDImage:image width", "10");
+    params.add_value("CCDImage:image height", "10");
+    params.add_value("CCDImage:observer[1]:view theta", "30. degrees");
+    params.add_value("CCDImage:observer[1]:view phi", "45. degrees");
+    params.add_value("CCDImage:observer[1]:filename", "test_ccdimage_1");
+
+    // observer 0 is not in the parameter file and uses the default angles
+    CCDImage image0(0, ".", params);
+    CCDImage image1(1, ".", params);
+
+    double sint, cost, phi, sinp, cosp;
+    const CoordinateVector<> direction0 =
+        image0.get_direction(sint, cost, phi, sinp, cosp);
+    assert_values_equal_rel(direction0.x(), std::sin(89.7 * M_PI / 180.),
+                            1.e-12);
+    assert_condition(direction0.y() == 0.);
+    const CoordinateVector<> direction1 =
+        image1.get_direction(sint, cost, phi, sinp, cosp);
+    assert_values_equal_rel(direction1.x(), 0.25 * std::sqrt(2.), 1.e-12);
+    assert_values_equal_rel(direction1.y(), 0.25 * std::sqrt(2.), 1.e-12);
+    assert_values_equal_rel(direction1.z(), 0.5 * std::sqrt(3.), 1.e-12);
+  }
+
   return 0;
 }
@@ -23,6 +23,7 @@
  *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
+#include "Assert.hpp"
 #include "CMILibrary.hpp"
 #include <fstream>
 #include <vector>
@@ -75,8 +76,40 @@ int main(int argc, char **argv) {
   }
   ofile.close();
 
+  // switch to persistent mode and redo the calculation for the same density
+  // field: the grid is kept and the calculation continues from the previous
+  // solution, so that successive calls should converge to the same neutral
+  // fractions (up to Monte Carlo noise)
+  cmi_set_persistent_mode(1);
+  std::vector< double > nH_warm(1000, 0.);
+  cmi_compute_neutral_fraction_dp(x.data(), y.data(), z.data(), h.data(),
+                                  m.data(), nH_warm.data(), 1000);
+  double nH_warm_sum = 0.;
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    nH_warm_sum += nH_warm[i];
+  }
+
+  // a second persistent call with slightly displaced particles reuses the
+  // neighbour tree and the previous ionization state
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    x[i] += 0.001 * box_sides[0];
+  }
+  std::vector< double > nH_warm2(1000, 0.);
+  cmi_compute_neutral_fraction_dp(x.data(), y.data(), z.data(), h.data(),
+                                  m.data(), nH_warm2.data(), 1000);
+  double nH_warm2_sum = 0.;
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    assert_condition(nH_warm2[i] >= 0. && nH_warm2[i] <= 1.);
+    nH_warm2_sum += nH_warm2[i];
+  }
+  assert_values_equal_rel(nH_warm_sum, nH_warm2_sum, 0.05);
+
   // clean up the library
   cmi_destroy();
 
+  // the persistent mode flag can also be set when the library is not
+  // initialized: it is then applied during the next initialization
+  cmi_set_persistent_mode(0);
+
   return 0;
 }
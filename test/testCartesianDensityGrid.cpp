@@ -28,9 +28,48 @@
 #include "DensityFunction.hpp"
 #include "HomogeneousDensityFunction.hpp"
 #include "Photon.hpp"
+#include "Utilities.hpp"
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+
+/**
+ * @brief Compute the path length of a ray in every cell of a non-periodic
+ * grid, using CartesianDensityGrid::get_wall_intersection() for every cell.
+ *
+ * @param grid CartesianDensityGrid.
+ * @param box Box containing the grid.
+ * @param ncell Number of cells in each dimension.
+ * @param origin Origin of the ray (in m).
+ * @param direction Direction of the ray.
+ * @param lengths Path length in every cell (in m).
+ */
+static void
+get_reference_path_lengths(CartesianDensityGrid &grid, const Box<> &box,
+                           const CoordinateVector< int_fast32_t > &ncell,
+                           CoordinateVector<> origin,
+                           CoordinateVector<> direction,
+                           std::vector< double > &lengths) {
+
+  CoordinateVector< int_fast32_t > index;
+  for (uint_fast8_t i = 0; i < 3; ++i) {
+    index[i] = (origin[i] - box.get_anchor()[i]) /
+               (box.get_sides()[i] / ncell[i]);
+  }
+  while (index.x() >= 0 && index.x() < ncell.x() && index.y() >= 0 &&
+         index.y() < ncell.y() && index.z() >= 0 && index.z() < ncell.z()) {
+    const cellsize_t long_index =
+        (index.x() * ncell.y() + index.y()) * ncell.z() + index.z();
+    Box<> cell = grid.get_cell(long_index);
+    CoordinateVector< int_fast8_t > next_index;
+    double ds;
+    origin =
+        grid.get_wall_intersection(origin, direction, cell, next_index, ds);
+    lengths[long_index] += ds;
+    index += next_index;
+  }
+}
 
 /**
  * @brief Unit test for the CartesianDensityGrid class.
@@ -443,5 +482,147 @@ int main(int argc, char **argv) {
 
   assert_condition(inside == grid.end());
 
+  // check that all accumulation modes yield the same integrals
+  {
+    const CoordinateVector<> directions[3] = {
+        CoordinateVector<>(1., 0., 0.), CoordinateVector<>(0., -1., 0.),
+        CoordinateVector<>(1. / std::sqrt(3.))};
+
+    grid.set_accumulation_mode(DENSITYGRID_ACCUMULATION_LOCK);
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      it.reset_mean_intensities();
+    }
+    for (uint_fast32_t i = 0; i < 3; ++i) {
+      Photon photon(photon_origin, directions[i], 1.);
+      photon.set_cross_section(ION_H_n, 1.);
+      photon.set_cross_section(ION_He_n, 1.);
+      grid.interact(photon, 0.125);
+    }
+    std::vector< double > reference(grid.get_number_of_cells());
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      reference[it.get_index()] =
+          it.get_ionization_variables().get_mean_intensity(ION_H_n);
+    }
+
+    grid.set_accumulation_mode(DENSITYGRID_ACCUMULATION_THREADLOCAL);
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      it.reset_mean_intensities();
+    }
+    for (uint_fast32_t i = 0; i < 3; ++i) {
+      Photon photon(photon_origin, directions[i], 1.);
+      photon.set_cross_section(ION_H_n, 1.);
+      photon.set_cross_section(ION_He_n, 1.);
+      grid.interact(photon, 0.125);
+    }
+    // the integrals are only added to the cells after the reduction
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      assert_condition(
+          it.get_ionization_variables().get_mean_intensity(ION_H_n) == 0.);
+    }
+    grid.reduce_thread_accumulators();
+    double total_mean_intensity = 0.;
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      assert_values_equal_rel(
+          it.get_ionization_variables().get_mean_intensity(ION_H_n),
+          reference[it.get_index()], 1.e-15);
+      total_mean_intensity +=
+          it.get_ionization_variables().get_mean_intensity(ION_H_n);
+    }
+    assert_condition(total_mean_intensity > 0.);
+
+    grid.set_accumulation_mode(DENSITYGRID_ACCUMULATION_LOCK);
+  }
+
+  // check the incremental cell traversal against the wall intersection
+  // algorithm, for random rays through a grid with unequal cell sides
+  {
+    const Box<> test_box(CoordinateVector<>(-1., 0.5, 2.),
+                         CoordinateVector<>(2., 1., 0.5));
+    const CoordinateVector< int_fast32_t > ncell(16, 8, 4);
+    CartesianDensityGrid test_grid(test_box, ncell);
+    std::pair< cellsize_t, cellsize_t > test_block =
+        std::make_pair(0, test_grid.get_number_of_cells());
+    test_grid.initialize(test_block, testfunction);
+
+    for (uint_fast32_t iray = 0; iray < 100; ++iray) {
+      CoordinateVector<> origin = test_box.get_anchor();
+      for (uint_fast8_t i = 0; i < 3; ++i) {
+        origin[i] += Utilities::random_double() * test_box.get_sides()[i];
+      }
+      const double cost = 2. * Utilities::random_double() - 1.;
+      const double sint = std::sqrt(1. - cost * cost);
+      const double phi = 2. * M_PI * Utilities::random_double();
+      const CoordinateVector<> direction(sint * std::cos(phi),
+                                         sint * std::sin(phi), cost);
+
+      std::vector< double > lengths(test_grid.get_number_of_cells(), 0.);
+      get_reference_path_lengths(test_grid, test_box, ncell, origin,
+                                 direction, lengths);
+
+      for (auto it = test_grid.begin(); it != test_grid.end(); ++it) {
+        it.reset_mean_intensities();
+      }
+      // a photon with a unit weight and cross section accumulates its path
+      // length in every cell it crosses
+      Photon photon(origin, direction, 1.);
+      photon.set_cross_section(ION_H_n, 1.);
+      photon.set_cross_section(ION_He_n, 1.);
+      assert_condition(test_grid.interact(photon, 1.e99) == test_grid.end());
+      for (auto it = test_grid.begin(); it != test_grid.end(); ++it) {
+        assert_values_equal_tol(
+            it.get_ionization_variables().get_mean_intensity(ION_H_n),
+            lengths[it.get_index()], 1.e-12);
+      }
+    }
+  }
+
+  // check that photons are correctly wrapped around periodic boundaries
+  {
+    const Box<> test_box(CoordinateVector<>(-1., 0.5, 2.),
+                         CoordinateVector<>(2., 1., 0.5));
+    const CoordinateVector< int_fast32_t > ncell(16, 8, 4);
+    std::pair< cellsize_t, cellsize_t > test_block =
+        std::make_pair(0, ncell.x() * ncell.y() * ncell.z());
+
+    // optical depth per unit length in the homogeneous grid (we need a
+    // non-periodic grid to compute this, since a ray never leaves a periodic
+    // grid)
+    CartesianDensityGrid reference_grid(test_box, ncell);
+    reference_grid.initialize(test_block, testfunction);
+    Photon reference_photon(CoordinateVector<>(-1., 1., 2.25),
+                            CoordinateVector<>(1., 0., 0.), 1.);
+    reference_photon.set_cross_section(ION_H_n, 1.);
+    reference_photon.set_cross_section(ION_He_n, 1.);
+    const double tau_per_length =
+        reference_grid.integrate_optical_depth(reference_photon) /
+        test_box.get_sides().x();
+    assert_condition(tau_per_length > 0.);
+
+    CartesianDensityGrid test_grid(test_box, ncell, true);
+    test_grid.initialize(test_block, testfunction);
+
+    const CoordinateVector<> origin(-0.3, 0.7, 2.1);
+    const CoordinateVector<> direction(0.48, -0.6, 0.64);
+    Photon photon(origin, direction, 1.);
+    photon.set_cross_section(ION_H_n, 1.);
+    photon.set_cross_section(ION_He_n, 1.);
+    // travel a distance that crosses the box multiple times in all directions
+    assert_condition(test_grid.interact(photon, 5. * tau_per_length) !=
+                     test_grid.end());
+    CoordinateVector<> expected_position = origin + 5. * direction;
+    for (uint_fast8_t i = 0; i < 3; ++i) {
+      const double x = expected_position[i] - test_box.get_anchor()[i];
+      const double side = test_box.get_sides()[i];
+      expected_position[i] =
+          test_box.get_anchor()[i] + x - std::floor(x / side) * side;
+    }
+    assert_values_equal_tol(photon.get_position().x(), expected_position.x(),
+                            1.e-10);
+    assert_values_equal_tol(photon.get_position().y(), expected_position.y(),
+                            1.e-10);
+    assert_values_equal_tol(photon.get_position().z(), expected_position.z(),
+                            1.e-10);
+  }
+
   return 0;
 }
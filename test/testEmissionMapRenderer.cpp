@@ -0,0 +1,116 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file testEmissionMapRenderer.cpp
+ *
+ * @brief Unit test for the EmissionMapRenderer class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Assert.hpp"
+#include "CartesianDensityGrid.hpp"
+#include "EmissionMapRenderer.hpp"
+#include "HomogeneousDensityFunction.hpp"
+
+#include <cmath>
+
+/**
+ * @brief Unit test for the EmissionMapRenderer class.
+ *
+ * We render emission maps of a unit cube with a constant emissivity, for which
+ * every pixel value is the emissivity times the length of the ray through the
+ * cube.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  HomogeneousDensityFunction density_function(1., 2000.);
+  density_function.initialize();
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+  CartesianDensityGrid grid(box, 16);
+  std::pair< cellsize_t, cellsize_t > block =
+      std::make_pair(0, grid.get_number_of_cells());
+  grid.initialize(block, density_function);
+
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    EmissivityValues *emissivities = new EmissivityValues();
+    emissivities->set_emissivity(EMISSIONLINE_HAlpha, 1.);
+    emissivities->set_emissivity(EMISSIONLINE_OIII_5007, 2.);
+    it.set_emissivities(emissivities);
+  }
+
+  std::vector< EmissionLine > lines;
+  lines.push_back(EMISSIONLINE_HAlpha);
+  lines.push_back(EMISSIONLINE_OIII_5007);
+
+  /// view along the x axis
+  {
+    EmissionMapRenderer renderer(0.5 * M_PI, 0., 32, 16, 0., 0., -1., -1.,
+                                 lines);
+    renderer.render(grid);
+    for (uint_fast32_t ix = 0; ix < 32; ++ix) {
+      for (uint_fast32_t iy = 0; iy < 16; ++iy) {
+        assert_values_equal_rel(renderer.get_pixel(0, ix, iy), 1., 1.e-8);
+        assert_values_equal_rel(renderer.get_pixel(1, ix, iy), 2., 1.e-8);
+      }
+    }
+  }
+
+  /// oblique view: the ray through the centre of the cube crosses the cube
+  /// along a face diagonal
+  {
+    const double phi = 0.25 * M_PI;
+    EmissionMapRenderer single_thread_renderer(0.5 * M_PI, phi, 65, 33, 0.,
+                                               0., -1., -1., lines, "", ".",
+                                               1);
+    single_thread_renderer.render(grid);
+    EmissionMapRenderer renderer(0.5 * M_PI, phi, 65, 33, 0., 0., -1., -1.,
+                                 lines, "", ".", 4);
+    renderer.render(grid);
+
+    // the result should not depend on the number of threads
+    for (uint_fast32_t ix = 0; ix < 65; ++ix) {
+      for (uint_fast32_t iy = 0; iy < 33; ++iy) {
+        assert_condition(renderer.get_pixel(0, ix, iy) ==
+                         single_thread_renderer.get_pixel(0, ix, iy));
+        assert_condition(renderer.get_pixel(1, ix, iy) ==
+                         single_thread_renderer.get_pixel(1, ix, iy));
+      }
+    }
+
+    // the image box is fitted to the projected cube, which has a width of
+    // sqrt(2); the horizontal pixel coordinate x is measured from the centre
+    // of the image, and the ray length at x is sqrt(2) - 2|x|
+    for (uint_fast32_t ix = 0; ix < 65; ++ix) {
+      const double x = (ix + 0.5) * std::sqrt(2.) / 65. - 0.5 * std::sqrt(2.);
+      const double length = std::sqrt(2.) - 2. * std::abs(x);
+      for (uint_fast32_t iy = 0; iy < 33; ++iy) {
+        assert_values_equal_rel(renderer.get_pixel(0, ix, iy), length, 1.e-8);
+        assert_values_equal_rel(renderer.get_pixel(1, ix, iy), 2. * length,
+                                1.e-8);
+      }
+    }
+  }
+
+  return 0;
+}
@@ -32,6 +32,7 @@
 #include "HDF5Tools.hpp"
 #include "HomogeneousDensityFunction.hpp"
 #include "TerminalLog.hpp"
+#include <sstream>
 #include <vector>
 
 /**
@@ -62,6 +63,34 @@ int main(int argc, char **argv) {
     TerminalLog log(LOGLEVEL_INFO);
     GadgetDensityGridWriter writer("testgrid", ".", &log);
     writer.write(grid, 0, params);
+
+    // asynchronous output: the snapshots should contain the state of the grid
+    // at the time write() was called, even if the grid changes afterwards
+    GadgetDensityGridWriter async_writer("testgrid_async", ".", &log, 3, 1);
+    for (uint_fast32_t i = 0; i < 3; ++i) {
+      for (auto it = grid.begin(); it != grid.end(); ++it) {
+        it.get_ionization_variables().set_number_density(i + 1.);
+      }
+      async_writer.write(grid, i, params);
+    }
+    async_writer.flush();
+  }
+
+  // check the asynchronously written files
+  for (uint_fast32_t i = 0; i < 3; ++i) {
+    std::stringstream filename;
+    filename << "testgrid_async00" << i << ".hdf5";
+    HDF5Tools::HDF5File file =
+        HDF5Tools::open_file(filename.str(), HDF5Tools::HDF5FILEMODE_READ);
+    HDF5Tools::HDF5Group group = HDF5Tools::open_group(file, "PartType0");
+    std::vector< double > ntot =
+        HDF5Tools::read_dataset< double >(group, "NumberDensity");
+    assert_condition(ntot.size() == 512);
+    for (uint_fast32_t j = 0; j < ntot.size(); ++j) {
+      assert_condition(ntot[j] == i + 1.);
+    }
+    HDF5Tools::close_group(group);
+    HDF5Tools::close_file(file);
   }
 
   // read file and check contents
@@ -23,6 +23,8 @@
  *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
+#include "AMRDensityGrid.hpp"
+#include "AMRRefinementScheme.hpp"
 #include "Assert.hpp"
 #include "CartesianDensityGrid.hpp"
 #include "CoordinateVector.hpp"
@@ -30,6 +32,24 @@
 #include "GadgetSnapshotDensityFunction.hpp"
 #include "TerminalLog.hpp"
 
+/**
+ * @brief AMRRefinementScheme that refines the left half of the box up to level
+ * 6.
+ */
+class TestAMRRefinementScheme : public AMRRefinementScheme {
+public:
+  /**
+   * @brief Decide if the given cell should be refined or not.
+   *
+   * @param level Current refinement level of the cell.
+   * @param cell DensityGrid::iterator pointing to a cell.
+   * @return True if the cell is in the left half of the box.
+   */
+  virtual bool refine(uint_fast8_t level, DensityGrid::iterator &cell) const {
+    return cell.get_cell_midpoint().x() < 0.5 && level < 6;
+  }
+};
+
 /**
  * @brief Unit test for the GadgetSnapshotDensityFunction class.
  *
@@ -43,7 +63,7 @@ int main(int argc, char **argv) {
   // Gadget2 snapshot file.
   TerminalLog tlog(LOGLEVEL_INFO);
   GadgetSnapshotDensityFunction density("test.hdf5", false, 0., 0., 0., false,
-                                        0., false, 0., &tlog);
+                                        0., false, 0., false, &tlog);
   density.initialize();
 
   CoordinateVector<> anchor;
@@ -57,5 +77,45 @@ int main(int argc, char **argv) {
                       density.get_total_hydrogen_number());
   assert_values_equal(grid.get_average_temperature(), 0.);
 
+  // now check that particle deposition conserves mass and agrees with the
+  // point sampling
+  GadgetSnapshotDensityFunction deposition_density(
+      "test.hdf5", false, 0., 0., 0., false, 0., false, 0., true, &tlog);
+  CartesianDensityGrid deposition_grid(box, 32);
+  deposition_grid.initialize(block, deposition_density);
+  assert_values_equal_rel(deposition_grid.get_total_hydrogen_number(),
+                          deposition_density.get_total_hydrogen_number(),
+                          1.e-10);
+  assert_values_equal(deposition_grid.get_average_temperature(), 0.);
+
+  // the deposited density is a cell average, while the point sampled density
+  // is only evaluated at the cell midpoint, so we only compare the integrated
+  // difference
+  double difference = 0.;
+  double norm = 0.;
+  for (auto it = grid.begin(), deposition_it = deposition_grid.begin();
+       it != grid.end(); ++it, ++deposition_it) {
+    const double n_point = it.get_ionization_variables().get_number_density();
+    const double n_deposition =
+        deposition_it.get_ionization_variables().get_number_density();
+    difference += std::abs(n_point - n_deposition);
+    norm += n_point + n_deposition;
+  }
+  cmac_status("Relative L1 difference with point sampling: %g.",
+              difference / norm);
+  assert_condition(difference < 0.1 * norm);
+
+  // particle deposition onto a grid with cells of different sizes should
+  // conserve mass as well
+  AMRDensityGrid amr_grid(box, 16, new TestAMRRefinementScheme());
+  std::pair< cellsize_t, cellsize_t > amr_block =
+      std::make_pair(0, amr_grid.get_number_of_cells());
+  amr_grid.initialize(amr_block, deposition_density);
+  assert_condition(amr_grid.get_number_of_cells() ==
+                   16 * 16 * 16 / 2 + 64 * 64 * 64 / 2);
+  assert_values_equal_rel(amr_grid.get_total_hydrogen_number(),
+                          deposition_density.get_total_hydrogen_number(),
+                          1.e-10);
+
   return 0;
 }
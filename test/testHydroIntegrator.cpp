@@ -23,10 +23,13 @@
  *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
+#include "Assert.hpp"
 #include "CartesianDensityGrid.hpp"
 #include "DensityFunction.hpp"
 #include "HydroIntegrator.hpp"
+#include "ParameterFile.hpp"
 #include "RiemannSolver.hpp"
+#include "SimulationBox.hpp"
 #include "VoronoiDensityGrid.hpp"
 #include "VoronoiGeneratorDistribution.hpp"
 #include <fstream>
@@ -62,6 +65,40 @@ public:
   }
 };
 
+/**
+ * @brief DensityFunction implementation that sets up a strong shock moving into
+ * cold gas.
+ *
+ * The sound speed in the hot region is 1000 times larger than in the cold
+ * region, so that the shock runs into cells with much larger time steps.
+ */
+class StrongShockDensityFunction : public DensityFunction {
+public:
+  /**
+   * @brief Function that gives the density for a given cell.
+   *
+   * @param cell Geometrical information about the cell.
+   * @return Initial physical field values for that cell.
+   */
+  virtual DensityValues operator()(const Cell &cell) const {
+    const CoordinateVector<> position = cell.get_cell_midpoint();
+    const double hydrogen_mass =
+        PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_PROTON_MASS);
+    const double boltzmann_k =
+        PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_BOLTZMANN);
+    const double density_unit = 1. / hydrogen_mass;
+    const double temperature_unit = hydrogen_mass / boltzmann_k;
+    DensityValues values;
+    values.set_number_density(density_unit);
+    if (position.x() < 0.2) {
+      values.set_temperature(temperature_unit);
+    } else {
+      values.set_temperature(1.e-6 * temperature_unit);
+    }
+    return values;
+  }
+};
+
 /**
  * @brief 1D Voronoi grid generator distribution.
  */
@@ -133,11 +170,24 @@ int main(int argc, char **argv) {
       cmac_status("Total mass: %g, total energy: %g", mtot, etot);
     }
 
+    double mtot_initial = 0.;
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      mtot_initial += it.get_hydro_variables().get_conserved_mass();
+    }
+
     Timer serial_timer, parallel_timer;
     for (uint_fast8_t i = 0; i < 100; ++i) {
       integrator.do_hydro_step(grid, 0.001, serial_timer, parallel_timer);
     }
 
+    // every interface flux is added to both neighbouring cells, so mass is
+    // conserved up to round off
+    double mtot_final = 0.;
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      mtot_final += it.get_hydro_variables().get_conserved_mass();
+    }
+    assert_values_equal_rel(mtot_initial, mtot_final, 1.e-12);
+
     // write final snapshot
     {
       std::ofstream snapfile("hydro_snap_1.txt");
@@ -170,6 +220,231 @@ int main(int argc, char **argv) {
     }
   }
 
+  /// Cartesian grid with the approximate HLLC solver for small jumps
+  {
+    Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+    CoordinateVector< bool > periodic(false, true, true);
+    SimulationBox simulation_box(box, periodic);
+    ParameterFile params;
+    params.add_value("HydroIntegrator:radiative heating", "false");
+    params.add_value("HydroIntegrator:HLLC threshold", "2.");
+    HydroIntegrator exact_integrator(5. / 3., false, false);
+    HydroIntegrator hllc_integrator(simulation_box, params);
+
+    CoordinateVector< int_fast32_t > ncell(100, 1, 1);
+    SodShockDensityFunction density_function;
+    density_function.initialize();
+    CartesianDensityGrid exact_grid(box, ncell, periodic, true);
+    CartesianDensityGrid hllc_grid(box, ncell, periodic, true);
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, exact_grid.get_number_of_cells());
+    exact_grid.initialize(block, density_function);
+    hllc_grid.initialize(block, density_function);
+
+    exact_integrator.initialize_hydro_variables(exact_grid);
+    hllc_integrator.initialize_hydro_variables(hllc_grid);
+
+    double mtot_initial = 0.;
+    for (auto it = hllc_grid.begin(); it != hllc_grid.end(); ++it) {
+      mtot_initial += it.get_hydro_variables().get_conserved_mass();
+    }
+
+    Timer serial_timer, parallel_timer;
+    for (uint_fast8_t i = 0; i < 100; ++i) {
+      exact_integrator.do_hydro_step(exact_grid, 0.001, serial_timer,
+                                     parallel_timer);
+      hllc_integrator.do_hydro_step(hllc_grid, 0.001, serial_timer,
+                                    parallel_timer);
+    }
+
+    double mtot_final = 0.;
+    for (auto it = hllc_grid.begin(); it != hllc_grid.end(); ++it) {
+      mtot_final += it.get_hydro_variables().get_conserved_mass();
+    }
+    assert_values_equal_rel(mtot_initial, mtot_final, 1.e-12);
+
+    // the HLLC solver is used for the interfaces with small jumps, so the
+    // solution should be different from, but close to, the exact solution
+    double density_difference = 0.;
+    double density_norm = 0.;
+    auto exact_it = exact_grid.begin();
+    for (auto it = hllc_grid.begin(); it != hllc_grid.end(); ++it, ++exact_it) {
+      const double rho_hllc = it.get_hydro_variables().get_primitives_density();
+      const double rho_exact =
+          exact_it.get_hydro_variables().get_primitives_density();
+      density_difference += std::abs(rho_hllc - rho_exact);
+      density_norm += rho_exact;
+    }
+    cmac_status("Relative L1 density difference HLLC: %g",
+                density_difference / density_norm);
+    assert_condition(density_difference > 0.);
+    assert_condition(density_difference < 0.01 * density_norm);
+  }
+
+  /// Cartesian grid with individual time steps
+  {
+    HydroIntegrator global_integrator(5. / 3., false, false);
+    HydroIntegrator individual_integrator(
+        5. / 3., false, false, "reflective", "reflective", "periodic",
+        "periodic", "periodic", "periodic",
+        CoordinateVector< bool >(false, true, true), true);
+
+    // use cubic cells, so that the time step criterion depends on the local
+    // sound speed of the cells
+    Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1., 0.01, 0.01));
+    CoordinateVector< int_fast32_t > ncell(100, 1, 1);
+    SodShockDensityFunction density_function;
+    density_function.initialize();
+    CoordinateVector< bool > periodic(false, true, true);
+    CartesianDensityGrid global_grid(box, ncell, periodic, true);
+    CartesianDensityGrid individual_grid(box, ncell, periodic, true);
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, global_grid.get_number_of_cells());
+    global_grid.initialize(block, density_function);
+    individual_grid.initialize(block, density_function);
+
+    global_integrator.initialize_hydro_variables(global_grid);
+    individual_integrator.initialize_hydro_variables(individual_grid);
+
+    double mtot_initial = 0.;
+    for (auto it = individual_grid.begin(); it != individual_grid.end();
+         ++it) {
+      mtot_initial += it.get_hydro_variables().get_conserved_mass();
+    }
+
+    Timer serial_timer, parallel_timer;
+    // the global time step is the smallest cell time step
+    for (uint_fast32_t i = 0; i < 200; ++i) {
+      global_integrator.do_hydro_step(global_grid, 0.0005, serial_timer,
+                                      parallel_timer);
+    }
+    // the system time step is subdivided by the cells that need a smaller
+    // time step
+    uint_fast64_t number_of_cell_updates = 0;
+    for (uint_fast32_t i = 0; i < 25; ++i) {
+      individual_integrator.do_hydro_step(individual_grid, 0.004, serial_timer,
+                                          parallel_timer);
+      assert_condition(individual_integrator.get_last_number_of_substeps() >
+                       1);
+      number_of_cell_updates +=
+          individual_integrator.get_last_number_of_cell_updates();
+    }
+    // not all cells should have been updated during every substep
+    assert_condition(number_of_cell_updates <
+                     200 * individual_grid.get_number_of_cells());
+    cmac_status("Number of cell updates: %" PRIuFAST64 " (global: %zu)",
+                number_of_cell_updates,
+                200 * individual_grid.get_number_of_cells());
+
+    // fluxes are always applied to both cells, so mass is conserved up to
+    // round off
+    double mtot_final = 0.;
+    for (auto it = individual_grid.begin(); it != individual_grid.end();
+         ++it) {
+      mtot_final += it.get_hydro_variables().get_conserved_mass();
+    }
+    assert_values_equal_rel(mtot_initial, mtot_final, 1.e-12);
+
+    // the solution should be close to the solution with a global time step
+    double density_difference = 0.;
+    double density_norm = 0.;
+    auto global_it = global_grid.begin();
+    for (auto it = individual_grid.begin(); it != individual_grid.end();
+         ++it, ++global_it) {
+      const double rho_individual =
+          it.get_hydro_variables().get_primitives_density();
+      const double rho_global =
+          global_it.get_hydro_variables().get_primitives_density();
+      density_difference += std::abs(rho_individual - rho_global);
+      density_norm += rho_global;
+    }
+    cmac_status("Relative L1 density difference: %g",
+                density_difference / density_norm);
+    assert_condition(density_difference < 0.01 * density_norm);
+  }
+
+  /// Cartesian grid with individual time steps and a strong shock
+  {
+    HydroIntegrator global_integrator(5. / 3., false, false);
+    HydroIntegrator individual_integrator(
+        5. / 3., false, false, "reflective", "reflective", "periodic",
+        "periodic", "periodic", "periodic",
+        CoordinateVector< bool >(false, true, true), true);
+
+    Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1., 0.01, 0.01));
+    CoordinateVector< int_fast32_t > ncell(100, 1, 1);
+    StrongShockDensityFunction density_function;
+    density_function.initialize();
+    CoordinateVector< bool > periodic(false, true, true);
+    CartesianDensityGrid global_grid(box, ncell, periodic, true);
+    CartesianDensityGrid individual_grid(box, ncell, periodic, true);
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, global_grid.get_number_of_cells());
+    global_grid.initialize(block, density_function);
+    individual_grid.initialize(block, density_function);
+
+    global_integrator.initialize_hydro_variables(global_grid);
+    individual_integrator.initialize_hydro_variables(individual_grid);
+
+    double mtot_initial = 0.;
+    for (auto it = individual_grid.begin(); it != individual_grid.end();
+         ++it) {
+      mtot_initial += it.get_hydro_variables().get_conserved_mass();
+    }
+
+    Timer serial_timer, parallel_timer;
+    for (uint_fast32_t i = 0; i < 1500; ++i) {
+      global_integrator.do_hydro_step(global_grid, 0.0001, serial_timer,
+                                      parallel_timer);
+    }
+    // the shock crosses cells that had the system time step; after every
+    // system step, the time steps of neighbouring cells should differ by at
+    // most a factor 4
+    for (uint_fast32_t i = 0; i < 3; ++i) {
+      individual_integrator.do_hydro_step(individual_grid, 0.05, serial_timer,
+                                          parallel_timer);
+      for (cellsize_t index = 0; index + 1 < 100; ++index) {
+        const uint64_t timestep_left =
+            individual_integrator.get_individual_timestep(index);
+        const uint64_t timestep_right =
+            individual_integrator.get_individual_timestep(index + 1);
+        assert_condition(timestep_left <= 4 * timestep_right);
+        assert_condition(timestep_right <= 4 * timestep_left);
+      }
+    }
+
+    double mtot_final = 0.;
+    for (auto it = individual_grid.begin(); it != individual_grid.end();
+         ++it) {
+      mtot_final += it.get_hydro_variables().get_conserved_mass();
+    }
+    assert_values_equal_rel(mtot_initial, mtot_final, 1.e-12);
+
+    // the shock should have moved well into the cold gas, and the solution
+    // should be close to the solution with a global time step
+    double density_difference = 0.;
+    double density_norm = 0.;
+    double shocked_density = 0.;
+    auto global_it = global_grid.begin();
+    for (auto it = individual_grid.begin(); it != individual_grid.end();
+         ++it, ++global_it) {
+      const double rho_individual =
+          it.get_hydro_variables().get_primitives_density();
+      const double rho_global =
+          global_it.get_hydro_variables().get_primitives_density();
+      density_difference += std::abs(rho_individual - rho_global);
+      density_norm += rho_global;
+      if (it.get_cell_midpoint().x() > 0.3) {
+        shocked_density = std::max(shocked_density, rho_individual);
+      }
+    }
+    cmac_status("Maximum density beyond x = 0.3: %g", shocked_density);
+    cmac_status("Relative L1 density difference: %g",
+                density_difference / density_norm);
+    assert_condition(shocked_density > 2.);
+    assert_condition(density_difference < 0.05 * density_norm);
+  }
+
   /// Voronoi grid
   {
     HydroIntegrator integrator(5. / 3., false, false);
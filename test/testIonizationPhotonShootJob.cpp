@@ -0,0 +1,286 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testIonizationPhotonShootJob.cpp
+ *
+ * @brief Unit test for the IonizationPhotonShootJob class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Abundances.hpp"
+#include "Assert.hpp"
+#include "CartesianDensityGrid.hpp"
+#include "DiffuseReemissionHandler.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "IonizationPhotonShootJobMarket.hpp"
+#include "PlanckPhotonSourceSpectrum.hpp"
+#include "SingleStarPhotonSourceDistribution.hpp"
+#include "UniformRandomVoronoiGeneratorDistribution.hpp"
+#include "VernerCrossSections.hpp"
+#include "VoronoiDensityGrid.hpp"
+#include "WorkDistributor.hpp"
+#include "WorkEnvironment.hpp"
+
+#include <vector>
+
+/*! @brief Number of values stored per cell in a ShootResult: the accumulated
+ *  integrals, followed by the second moment of the hydrogen mean intensity. */
+#define SHOOTRESULT_NUMBER_OF_VALUES                                           \
+  (DENSITYGRID_NUMBER_OF_ACCUMULATED_VALUES + 1)
+
+/**
+ * @brief Result of a photon shooting pass.
+ */
+class ShootResult {
+public:
+  /*! @brief Accumulated values for all cells. */
+  std::vector< double > _values;
+
+  /*! @brief Total weight of all photons. */
+  double _totweight;
+
+  /*! @brief Total weights per photon type. */
+  double _typecount[PHOTONTYPE_NUMBER];
+
+  /**
+   * @brief Constructor.
+   *
+   * @param numcell Number of cells in the grid.
+   */
+  ShootResult(const cellsize_t numcell)
+      : _values(numcell * SHOOTRESULT_NUMBER_OF_VALUES, 0.),
+        _totweight(0.), _typecount{0.} {}
+
+  /**
+   * @brief Add the given result to this result.
+   *
+   * @param result Other ShootResult.
+   */
+  void add(const ShootResult &result) {
+    for (size_t i = 0; i < _values.size(); ++i) {
+      _values[i] += result._values[i];
+    }
+    _totweight += result._totweight;
+    for (int_fast32_t i = 0; i < PHOTONTYPE_NUMBER; ++i) {
+      _typecount[i] += result._typecount[i];
+    }
+  }
+
+  /**
+   * @brief Check that the given result is bitwise identical to this result.
+   *
+   * @param result Other ShootResult.
+   */
+  void check_identical(const ShootResult &result) const {
+    for (size_t i = 0; i < _values.size(); ++i) {
+      assert_condition(_values[i] == result._values[i]);
+    }
+    assert_condition(_totweight == result._totweight);
+    for (int_fast32_t i = 0; i < PHOTONTYPE_NUMBER; ++i) {
+      assert_condition(_typecount[i] == result._typecount[i]);
+    }
+  }
+};
+
+/**
+ * @brief Shoot the given photons through the given grid, using the given
+ * number of threads and accumulation mode.
+ *
+ * @param grid DensityGrid.
+ * @param density_function DensityFunction used to reset the grid.
+ * @param source PhotonSource.
+ * @param numthread Number of threads to use.
+ * @param mode DensityGridAccumulationMode to use.
+ * @param first_photon_index Global index of the first photon.
+ * @param numphoton Number of photons to shoot.
+ * @param reproducible Use reproducible accumulation?
+ * @param second_moment Accumulate the second moment of the hydrogen mean
+ * intensity?
+ * @return ShootResult containing the accumulated values.
+ */
+ShootResult shoot_photons(DensityGrid &grid, DensityFunction &density_function,
+                          PhotonSource &source, const int_fast32_t numthread,
+                          const DensityGridAccumulationMode mode,
+                          const uint_fast64_t first_photon_index,
+                          const uint_fast64_t numphoton,
+                          const bool reproducible = true,
+                          const bool second_moment = true) {
+
+  WorkEnvironment::set_max_num_threads(numthread);
+  grid.set_accumulation_mode(mode);
+  grid.set_reproducible_accumulation(reproducible);
+  grid.set_second_moment_accumulation(second_moment);
+  grid.reset_grid(density_function);
+  DiffuseReemissionHandler::set_reemission_probabilities(grid);
+
+  WorkDistributor< IonizationPhotonShootJobMarket, IonizationPhotonShootJob >
+      workers(numthread);
+  IonizationPhotonShootJobMarket jobs(source, 42, grid, 0, 100,
+                                      workers.get_worksize(), true);
+  jobs.set_numphoton(numphoton, first_photon_index);
+  workers.do_in_parallel(jobs);
+  grid.reduce_thread_accumulators(workers.get_worksize());
+
+  ShootResult result(grid.get_number_of_cells());
+  jobs.update_counters(result._totweight, result._typecount);
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    const IonizationVariablesReference ionization_variables =
+        it.get_ionization_variables();
+    double *values = &result._values[it.get_index() *
+                                     SHOOTRESULT_NUMBER_OF_VALUES];
+    for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+      values[i] =
+          ionization_variables.get_mean_intensity(static_cast< IonName >(i));
+    }
+    for (int_fast32_t i = 0; i < NUMBER_OF_HEATINGTERMS; ++i) {
+      values[NUMBER_OF_IONNAMES + i] = ionization_variables.get_heating(
+          static_cast< HeatingTermName >(i));
+    }
+    values[NUMBER_OF_IONNAMES + NUMBER_OF_HEATINGTERMS] =
+        ionization_variables.get_mean_intensity_second_moment();
+  }
+  return result;
+}
+
+/**
+ * @brief Check that photon shooting gives bitwise identical results for
+ * different numbers of threads, accumulation modes and distributions of the
+ * photons over processes.
+ *
+ * @param grid DensityGrid.
+ * @param density_function DensityFunction used to initialize the grid.
+ * @param source PhotonSource.
+ */
+void check_reproducibility(DensityGrid &grid,
+                           DensityFunction &density_function,
+                           PhotonSource &source) {
+
+  // not a multiple of PHOTONPACKETBATCH_SIZE
+  const uint_fast64_t numphoton = 20000;
+
+  const ShootResult reference =
+      shoot_photons(grid, density_function, source, 1,
+                    DENSITYGRID_ACCUMULATION_LOCK, 0, numphoton);
+  assert_condition(reference._totweight > 0.);
+  // make sure the photons actually interacted with the gas
+  assert_condition(reference._typecount[PHOTONTYPE_ABSORBED] > 0.);
+  assert_condition(reference._typecount[PHOTONTYPE_DIFFUSE_HI] > 0.);
+
+  // the rounding to fixed-point units should not change the integrals
+  // significantly
+  {
+    const ShootResult result =
+        shoot_photons(grid, density_function, source, 1,
+                      DENSITYGRID_ACCUMULATION_LOCK, 0, numphoton, false);
+    for (int_fast32_t i = 0; i < SHOOTRESULT_NUMBER_OF_VALUES; ++i) {
+      double reference_total = 0.;
+      double total = 0.;
+      for (size_t j = i; j < reference._values.size();
+           j += SHOOTRESULT_NUMBER_OF_VALUES) {
+        reference_total += reference._values[j];
+        total += result._values[j];
+      }
+      assert_values_equal_rel(reference_total, total, 1.e-6);
+    }
+    assert_values_equal_rel(reference._totweight, result._totweight, 1.e-10);
+  }
+
+  const DensityGridAccumulationMode modes[3] = {
+      DENSITYGRID_ACCUMULATION_LOCK, DENSITYGRID_ACCUMULATION_ATOMIC,
+      DENSITYGRID_ACCUMULATION_THREADLOCAL};
+  for (uint_fast8_t imode = 0; imode < 3; ++imode) {
+    const ShootResult result = shoot_photons(grid, density_function, source, 4,
+                                             modes[imode], 0, numphoton);
+    reference.check_identical(result);
+  }
+
+  // without second moment accumulation, the other integrals should not change
+  // and the second moment should not be touched
+  for (uint_fast8_t imode = 0; imode < 3; ++imode) {
+    const ShootResult result =
+        shoot_photons(grid, density_function, source, 4, modes[imode], 0,
+                      numphoton, true, false);
+    for (size_t i = 0; i < result._values.size(); ++i) {
+      if (i % SHOOTRESULT_NUMBER_OF_VALUES <
+          DENSITYGRID_NUMBER_OF_ACCUMULATED_VALUES) {
+        assert_condition(result._values[i] == reference._values[i]);
+      } else {
+        assert_condition(result._values[i] == 0.);
+      }
+    }
+  }
+
+  // emulate two MPI processes that each shoot half of the photon batches and
+  // sum their results
+  const uint_fast64_t half = (numphoton / PHOTONPACKETBATCH_SIZE / 2) *
+                             PHOTONPACKETBATCH_SIZE;
+  ShootResult result = shoot_photons(grid, density_function, source, 3,
+                                     DENSITYGRID_ACCUMULATION_THREADLOCAL,
+                                     half, numphoton - half);
+  result.add(shoot_photons(grid, density_function, source, 2,
+                           DENSITYGRID_ACCUMULATION_ATOMIC, 0, half));
+  reference.check_identical(result);
+
+  grid.set_accumulation_mode(DENSITYGRID_ACCUMULATION_LOCK);
+}
+
+/**
+ * @brief Unit test for the IonizationPhotonShootJob class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  const Box<> box(CoordinateVector<>(-1.5e17), CoordinateVector<>(3.e17));
+  HomogeneousDensityFunction density_function(1.e8, 8000.);
+  density_function.initialize();
+
+  SingleStarPhotonSourceDistribution distribution(CoordinateVector<>(0.),
+                                                  4.26e49);
+  PlanckPhotonSourceSpectrum spectrum(40000.);
+  VernerCrossSections cross_sections;
+  Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
+  PhotonSource source(&distribution, &spectrum, nullptr, nullptr, abundances,
+                      cross_sections, true);
+
+  /// Cartesian grid
+  {
+    CartesianDensityGrid grid(box, 16);
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, grid.get_number_of_cells());
+    grid.initialize(block, density_function);
+    check_reproducibility(grid, density_function, source);
+  }
+
+  /// Voronoi grid: the cells have a wide range of volumes, and hence a wide
+  /// range of fixed-point units
+  {
+    UniformRandomVoronoiGeneratorDistribution *generators =
+        new UniformRandomVoronoiGeneratorDistribution(box, 1000, 42);
+    VoronoiDensityGrid grid(generators, box);
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, grid.get_number_of_cells());
+    grid.initialize(block, density_function);
+    check_reproducibility(grid, density_function, source);
+  }
+
+  return 0;
+}
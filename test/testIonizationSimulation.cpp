@@ -23,9 +23,39 @@
  *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
+#include "Assert.hpp"
 #include "IonizationSimulation.hpp"
 #include "MPICommunicator.hpp"
 #include "TerminalLog.hpp"
+#include "Utilities.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Get the total ionized volume in the given AsciiFileDensityGridWriter
+ * snapshot file.
+ *
+ * @param filename Name of the snapshot file.
+ * @return Total ionized volume (in m^3).
+ */
+double get_ionized_volume(const std::string filename) {
+  std::ifstream file(filename);
+  assert_condition(file.good());
+  double ionized_volume = 0.;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line[0] == '#') {
+      continue;
+    }
+    std::istringstream linestream(line);
+    double x, y, z, n, volume, xH;
+    linestream >> x >> y >> z >> n >> volume >> xH;
+    ionized_volume += (1. - xH) * volume;
+  }
+  return ionized_volume;
+}
 
 /**
  * @brief Unit test for the IonizationSimulation class.
@@ -38,10 +68,47 @@ int main(int argc, char **argv) {
 
   MPICommunicator comm(argc, argv);
   TerminalLog log(LOGLEVEL_STATUS);
-  IonizationSimulation simulation(
-      true, false, false, -1, "test_ionizationsimulation.param", &comm, &log);
-  simulation.initialize();
-  simulation.run();
+  {
+    IonizationSimulation simulation(comm.get_rank() == 0, false, false, -1,
+                                    "test_ionizationsimulation.param", &comm,
+                                    &log);
+    simulation.initialize();
+    simulation.run();
+  }
+
+  /// distributed grid mode
+  // every process only stores and writes part of the grid
+  {
+    IonizationSimulation simulation(comm.get_rank() == 0, false, false, -1,
+                                    "test_distributed_grid.param", &comm,
+                                    &log);
+    simulation.initialize();
+    simulation.run();
+  }
+
+  // make sure all processes have written their snapshot
+  uint_fast32_t done = 1;
+  comm.reduce< MPI_SUM_OF_ALL_PROCESSES >(done);
+
+  if (comm.get_rank() == 0) {
+    const double ref_volume = get_ionized_volume(Utilities::compose_filename(
+        ".", "test_ionizationsimulation", "txt", 4, 3));
+    double volume = 0.;
+    if (comm.get_size() > 1) {
+      for (int_fast32_t rank = 0; rank < comm.get_size(); ++rank) {
+        std::stringstream prefix;
+        prefix << "test_distributed_grid_rank" << rank << "_";
+        volume += get_ionized_volume(
+            Utilities::compose_filename(".", prefix.str(), "txt", 4, 3));
+      }
+    } else {
+      volume = get_ionized_volume(Utilities::compose_filename(
+          ".", "test_distributed_grid", "txt", 4, 3));
+    }
+    // both runs use different random numbers, so we only expect agreement
+    // within the Monte Carlo noise
+    assert_values_equal_rel(volume, ref_volume, 0.05);
+  }
 
   return 0;
 }
@@ -78,7 +78,8 @@ int main(int argc, char **argv) {
     // set the cell values
     cell.reset_mean_intensities();
 
-    IonizationVariables &ionization_variables = cell.get_ionization_variables();
+    IonizationVariablesReference ionization_variables =
+        cell.get_ionization_variables();
 
     ionization_variables.increase_mean_intensity(
         ION_H_n, UnitConverter::to_SI< QUANTITY_FREQUENCY >(jH, "s^-1"));
@@ -0,0 +1,168 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file testIterationConvergenceChecker.cpp
+ *
+ * @brief Unit test for the IterationConvergenceChecker class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Assert.hpp"
+#include "CartesianDensityGrid.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "IterationConvergenceChecker.hpp"
+
+/**
+ * @brief Set the neutral fraction of all cells in the given grid to the given
+ * value.
+ *
+ * @param grid DensityGrid.
+ * @param neutral_fraction New value for the neutral fraction.
+ */
+void set_neutral_fractions(DensityGrid &grid, const double neutral_fraction) {
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    it.get_ionization_variables().set_ionic_fraction(ION_H_n,
+                                                     neutral_fraction);
+  }
+}
+
+/**
+ * @brief Set the hydrogen mean intensity estimators of all cells in the given
+ * grid to the values obtained from the given number of identical photon packet
+ * contributions.
+ *
+ * @param grid DensityGrid.
+ * @param number_of_packets Number of photon packets that contributed to the
+ * mean intensity integral of every cell.
+ */
+void set_mean_intensities(DensityGrid &grid, const double number_of_packets) {
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    it.get_ionization_variables().set_mean_intensity(ION_H_n, 1.);
+    it.get_ionization_variables().set_mean_intensity_second_moment(
+        1. / number_of_packets);
+  }
+}
+
+/**
+ * @brief Unit test for the IterationConvergenceChecker class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  HomogeneousDensityFunction function(1., 8000.);
+  function.initialize();
+  Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+  CartesianDensityGrid grid(box, 8);
+  std::pair< cellsize_t, cellsize_t > block =
+      std::make_pair(0, grid.get_number_of_cells());
+  grid.initialize(block, function);
+  set_neutral_fractions(grid, 0.5);
+
+  /// an unchanged grid converges immediately, without changing the photon
+  /// number
+  {
+    IterationConvergenceChecker checker(0.01, 1, 100, 10000, 2.);
+    checker.initialize(grid);
+    uint_fast64_t numphoton = 1000;
+    assert_condition(checker.is_converged(grid, numphoton));
+    assert_condition(numphoton == 1000);
+    assert_condition(checker.get_statistics().size() == 1);
+    assert_condition(checker.get_statistics()[0]._neutral_fraction_change ==
+                     0.);
+  }
+
+  /// a large change that is not dominated by noise decreases the photon
+  /// number, a change that is dominated by noise increases it, and a small
+  /// change with a small noise stops the iteration
+  {
+    IterationConvergenceChecker checker(0.01, 3, 100, 10000, 2.);
+    checker.initialize(grid);
+    uint_fast64_t numphoton = 1000;
+
+    // change: 0.4, noise: 8.2e-4
+    set_neutral_fractions(grid, 0.1);
+    set_mean_intensities(grid, 1.e4);
+    assert_condition(!checker.is_converged(grid, numphoton));
+    assert_condition(numphoton == 500);
+    assert_condition(!checker.get_statistics()[0]._noise_dominated);
+
+    // change: 0.03, noise: 1.6e-3
+    set_neutral_fractions(grid, 0.13);
+    set_mean_intensities(grid, 5.e3);
+    assert_condition(!checker.is_converged(grid, numphoton));
+    assert_condition(numphoton == 500);
+
+    // change: 0.005, noise: 0.01
+    // the change is below the tolerance, but the noise is not, so we need
+    // (0.01/0.005)^2 = 4.3 times more photons
+    set_neutral_fractions(grid, 0.135);
+    set_mean_intensities(grid, 1.e2);
+    assert_condition(!checker.is_converged(grid, numphoton));
+    assert_condition(checker.get_statistics()[2]._noise_dominated);
+    assert_condition(numphoton > 2000 && numphoton < 2300);
+
+    // change: 0.001, noise: 0.01 (due to the noise in the previous iteration)
+    set_neutral_fractions(grid, 0.136);
+    set_mean_intensities(grid, 1.e4);
+    assert_condition(!checker.is_converged(grid, numphoton));
+
+    // change: 0.0005, noise: 1.5e-3
+    const uint_fast64_t old_numphoton = numphoton;
+    set_neutral_fractions(grid, 0.1365);
+    set_mean_intensities(grid, 1.e4);
+    assert_condition(checker.is_converged(grid, numphoton));
+    assert_condition(numphoton == old_numphoton);
+
+    const std::vector< IterationStatistics > &statistics =
+        checker.get_statistics();
+    assert_condition(statistics.size() == 5);
+    assert_condition(statistics[0]._number_of_photons == 1000);
+    assert_condition(statistics[1]._number_of_photons == 500);
+    assert_condition(statistics[4]._converged);
+    assert_values_equal_rel(statistics[0]._neutral_fraction_change, 0.4,
+                            1.e-12);
+    assert_values_equal_rel(statistics[0]._maximum_neutral_fraction_change, 0.4,
+                            1.e-12);
+    assert_condition(statistics[0]._temperature_change == 0.);
+    // noise on the neutral fraction: x(1-x)/(1+x)/sqrt(N)
+    assert_values_equal_rel(statistics[0]._noise, 0.09 / 1.1 * 0.01, 1.e-12);
+  }
+
+  /// the photon number stays within the given bounds, and the iteration is
+  /// not converged before the minimum number of iterations
+  {
+    IterationConvergenceChecker checker(0.01, 2, 100, 1500, 2.);
+    set_neutral_fractions(grid, 0.5);
+    checker.initialize(grid);
+    uint_fast64_t numphoton = 1000;
+    set_neutral_fractions(grid, 0.55);
+    set_mean_intensities(grid, 1.e2);
+    assert_condition(!checker.is_converged(grid, numphoton));
+    assert_condition(numphoton == 1500);
+    set_neutral_fractions(grid, 0.5);
+    assert_condition(!checker.is_converged(grid, numphoton));
+    assert_condition(numphoton == 1500);
+  }
+
+  return 0;
+}
@@ -128,6 +128,36 @@ int main(int argc, char **argv) {
     }
   }
 
+  // the batched solver should give the same results as the single system
+  // solver
+  {
+    double A[5][5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS];
+    double B[5][LINECOOLINGDATA_NUMFIVELEVELELEMENTS];
+    double Ac[LINECOOLINGDATA_NUMFIVELEVELELEMENTS][5][5];
+    double Bc[LINECOOLINGDATA_NUMFIVELEVELELEMENTS][5];
+    for (uint_fast8_t l = 0; l < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++l) {
+      for (uint_fast8_t i = 0; i < 5; ++i) {
+        for (uint_fast8_t j = 0; j < 5; ++j) {
+          A[i][j][l] = Utilities::random_double();
+          Ac[l][i][j] = A[i][j][l];
+        }
+        B[i][l] = Utilities::random_double();
+        Bc[l][i] = B[i][l];
+      }
+    }
+
+    assert_condition(
+        LineCoolingData::solve_systems_of_linear_equations(A, B) == 0);
+
+    for (uint_fast8_t l = 0; l < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++l) {
+      assert_condition(
+          LineCoolingData::solve_system_of_linear_equations(Ac[l], Bc[l]) == 0);
+      for (uint_fast8_t i = 0; i < 5; ++i) {
+        assert_values_equal_rel(B[i][l], Bc[l][i], 1.e-12);
+      }
+    }
+  }
+
   // linecool
   {
     std::ifstream file("linecool_testdata.txt");
@@ -152,6 +182,34 @@ int main(int argc, char **argv) {
     }
   }
 
+  // derivative of the cooling w.r.t. log T: compare with a central difference
+  // (the cooling contains round off noise, so the step cannot be too small;
+  // the remaining difference is a mix of noise and truncation error)
+  {
+    double abundances[LINECOOLINGDATA_NUMELEMENTS];
+    for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMELEMENTS; ++j) {
+      abundances[j] = 1.e-4 * (j + 1.);
+    }
+    const double dlogT = 1.e-3;
+    for (uint_fast32_t iT = 0; iT < 20; ++iT) {
+      const double T = 1000. * std::pow(100., 0.05 * iT);
+      for (uint_fast32_t ine = 0; ine < 5; ++ine) {
+        const double ne = std::pow(10., 4. + 2. * ine);
+        double dcool;
+        const double cool = data.get_cooling(T, ne, abundances, dcool);
+        assert_condition(cool == data.get_cooling(T, ne, abundances));
+        const double dcool_numerical =
+            (data.get_cooling(T * std::exp(dlogT), ne, abundances) -
+             data.get_cooling(T * std::exp(-dlogT), ne, abundances)) /
+            (2. * dlogT);
+        assert_values_equal_rel(dcool, dcool_numerical, 1.e-4);
+      }
+    }
+    double dcool;
+    assert_condition(data.get_cooling(1.e4, 0., abundances, dcool) == 1.e-99);
+    assert_condition(dcool == 0.);
+  }
+
   // linestr
   {
     std::ifstream file("linestr_testdata.txt");
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file testLineCoolingTable.cpp
+ *
+ * @brief Unit test for the LineCoolingTable class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Assert.hpp"
+#include "LineCoolingTable.hpp"
+#include "Utilities.hpp"
+
+#include <cmath>
+
+/**
+ * @brief Unit test for the LineCoolingTable class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  LineCoolingData data;
+  LineCoolingTable table(data);
+
+  // compare with the direct calculation for random temperatures, electron
+  // densities and abundances inside the table range
+  for (uint_fast32_t i = 0; i < 10000; ++i) {
+    const double temperature =
+        1000. * std::pow(100., Utilities::random_double());
+    const double electron_density =
+        std::pow(10., 4. + 8. * Utilities::random_double());
+    double abundances[LINECOOLINGDATA_NUMELEMENTS];
+    for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMELEMENTS; ++j) {
+      abundances[j] = 1.e-4 * Utilities::random_double();
+    }
+    const double cooling =
+        data.get_cooling(temperature, electron_density, abundances);
+    const double tabulated_cooling =
+        table.get_cooling(temperature, electron_density, abundances);
+    assert_values_equal_rel(tabulated_cooling, cooling, 1.e-4);
+
+    // the derivative of the tabulated cooling is the derivative of the linear
+    // interpolation, which is only first order accurate
+    double dcooling, tabulated_dcooling;
+    data.get_cooling(temperature, electron_density, abundances, dcooling);
+    assert_condition(table.get_cooling(temperature, electron_density,
+                                       abundances, tabulated_dcooling) ==
+                     tabulated_cooling);
+    // the table derivative is the slope of the linear interpolation, which
+    // is only first order accurate
+    assert_condition(std::abs(tabulated_dcooling - dcooling) <
+                     0.1 * cooling);
+  }
+
+  double abundances[LINECOOLINGDATA_NUMELEMENTS];
+  for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMELEMENTS; ++j) {
+    abundances[j] = 1.e-4;
+  }
+
+  // outside the table range, the direct calculation is used
+  assert_condition(table.get_cooling(500., 1.e8, abundances) ==
+                   data.get_cooling(500., 1.e8, abundances));
+  assert_condition(table.get_cooling(2.e5, 1.e8, abundances) ==
+                   data.get_cooling(2.e5, 1.e8, abundances));
+
+  // the cooling in the absence of free electrons is not exactly zero
+  assert_condition(table.get_cooling(1.e4, 0., abundances) == 1.e-99);
+  double dcooling;
+  assert_condition(table.get_cooling(1.e4, 0., abundances, dcooling) ==
+                   1.e-99);
+  assert_condition(dcooling == 0.);
+
+  return 0;
+}
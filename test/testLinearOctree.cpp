@@ -0,0 +1,163 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2016 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testLinearOctree.cpp
+ *
+ * @brief Unit test for the LinearOctree class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Assert.hpp"
+#include "Box.hpp"
+#include "CoordinateVector.hpp"
+#include "Error.hpp"
+#include "LinearOctree.hpp"
+#include "Utilities.hpp"
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief Compare the neighbours found by the tree with a brute force search.
+ *
+ * @param positions Positions.
+ * @param hs Smoothing lengths.
+ * @param box Box containing the positions.
+ * @param periodic Periodicity flag.
+ * @param tree LinearOctree to test.
+ * @param centre Centre of the neighbour search.
+ * @param radius Radius of the neighbour search.
+ */
+void check_ngbs(const std::vector< CoordinateVector<> > &positions,
+                const std::vector< double > &hs, const Box<> &box,
+                const bool periodic, const LinearOctree &tree,
+                const CoordinateVector<> centre, const double radius) {
+
+  std::vector< uint_fast32_t > ngbs_brute_force;
+  for (uint_fast32_t i = 0; i < positions.size(); ++i) {
+    double r;
+    if (periodic) {
+      r = box.periodic_distance(positions[i], centre).norm();
+    } else {
+      r = (positions[i] - centre).norm();
+    }
+    if (r <= hs[i] + radius) {
+      ngbs_brute_force.push_back(i);
+    }
+  }
+
+  std::vector< uint_fast32_t > ngbs_tree;
+  if (radius > 0.) {
+    ngbs_tree = tree.get_ngbs_sphere(centre, radius);
+  } else {
+    tree.get_ngbs(centre, ngbs_tree);
+  }
+  cmac_status("Number of ngbs (brute force): %zu, tree: %zu.",
+              ngbs_brute_force.size(), ngbs_tree.size());
+
+  assert_condition(ngbs_brute_force.size() == ngbs_tree.size());
+  std::sort(ngbs_brute_force.begin(), ngbs_brute_force.end());
+  std::sort(ngbs_tree.begin(), ngbs_tree.end());
+  for (size_t i = 0; i < ngbs_tree.size(); ++i) {
+    assert_condition(ngbs_brute_force[i] == ngbs_tree[i]);
+  }
+}
+
+/**
+ * @brief Unit test for the LinearOctree class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  const Box<> box(CoordinateVector<>(), CoordinateVector<>(1.));
+
+  const uint_fast32_t numpos = 10000;
+  std::vector< CoordinateVector<> > positions(numpos);
+  std::vector< double > hs(numpos);
+  for (uint_fast32_t i = 0; i < numpos; ++i) {
+    positions[i] = Utilities::random_position();
+    hs[i] = 0.05 * Utilities::random_double();
+  }
+  // add some duplicate positions to test leaves on the maximum level
+  for (uint_fast32_t i = 0; i < 2 * LINEAROCTREE_LEAF_SIZE; ++i) {
+    positions[i] = positions[numpos - 1];
+  }
+
+  // non-periodic
+  {
+    LinearOctree tree(positions, box, false);
+    tree.set_auxiliaries(hs, LinearOctree::max< double >);
+    cmac_status("Number of nodes: %zu.", tree.get_number_of_nodes());
+
+    check_ngbs(positions, hs, box, false, tree, CoordinateVector<>(0.5), 0.);
+    check_ngbs(positions, hs, box, false, tree, positions[numpos - 1], 0.);
+    check_ngbs(positions, hs, box, false, tree, CoordinateVector<>(0.2), 0.1);
+
+    // the callback version should find the same neighbours
+    const CoordinateVector<> centre(0.3, 0.6, 0.7);
+    uint_fast32_t count = 0;
+    tree.for_each_ngb(centre, [&count](const uint_fast32_t) { ++count; });
+    assert_condition(count == tree.get_ngbs(centre).size());
+
+    // closest neighbour
+    for (uint_fast32_t j = 0; j < 10; ++j) {
+      const CoordinateVector<> p = Utilities::random_position();
+      double rmin = DBL_MAX;
+      for (uint_fast32_t i = 0; i < numpos; ++i) {
+        rmin = std::min(rmin, (positions[i] - p).norm());
+      }
+      const uint_fast32_t closest = tree.get_closest_ngb(p);
+      assert_condition((positions[closest] - p).norm() == rmin);
+    }
+  }
+
+  // periodic
+  {
+    LinearOctree tree(positions, box, true);
+    tree.set_auxiliaries(hs, LinearOctree::max< double >);
+
+    check_ngbs(positions, hs, box, true, tree, CoordinateVector<>(0.01), 0.);
+    check_ngbs(positions, hs, box, true, tree, CoordinateVector<>(0.99), 0.05);
+  }
+
+  // moved positions: update the existing tree instead of rebuilding it
+  {
+    LinearOctree tree(positions, box, true);
+    for (uint_fast32_t i = 0; i < numpos; ++i) {
+      for (uint_fast8_t j = 0; j < 3; ++j) {
+        positions[i][j] += 0.1 * (Utilities::random_double() - 0.5);
+        if (positions[i][j] < 0.) {
+          positions[i][j] += 1.;
+        }
+        if (positions[i][j] >= 1.) {
+          positions[i][j] -= 1.;
+        }
+      }
+    }
+    tree.update_boxes();
+    tree.set_auxiliaries(hs, LinearOctree::max< double >);
+
+    check_ngbs(positions, hs, box, true, tree, CoordinateVector<>(0.01), 0.);
+    check_ngbs(positions, hs, box, true, tree, CoordinateVector<>(0.5), 0.);
+  }
+
+  return 0;
+}
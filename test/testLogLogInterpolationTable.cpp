@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file testLogLogInterpolationTable.cpp
+ *
+ * @brief Unit test for the LogLogInterpolationTable class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Assert.hpp"
+#include "LogLogInterpolationTable.hpp"
+
+#include <cmath>
+
+/**
+ * @brief Unit test for the LogLogInterpolationTable class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// power law: the interpolation is exact, also outside the table range
+  {
+    LogLogInterpolationTable table(
+        [](const double x) { return 3. * std::pow(x, -2.5); }, 1., 100., 10);
+
+    assert_condition(table.get_number_of_segments() == 1);
+    assert_condition(table.get_maximum_relative_error() < 1.e-12);
+    for (uint_fast32_t i = 0; i < 100; ++i) {
+      const double x = 0.5 * std::pow(400., 0.01 * i);
+      assert_values_equal_rel(table.get_value(x), 3. * std::pow(x, -2.5),
+                              1.e-12);
+    }
+  }
+
+  /// piecewise power law with a threshold and a jump: both discontinuities
+  /// are located and are never interpolated across
+  {
+    auto function = [](const double x) {
+      if (x < 3.) {
+        return 0.;
+      } else if (x < 7.) {
+        return x;
+      } else {
+        return 2. / (x * x);
+      }
+    };
+    LogLogInterpolationTable table(function, 1., 100., 10);
+
+    assert_condition(table.get_number_of_segments() == 3);
+    assert_condition(table.get_maximum_relative_error() < 1.e-12);
+    for (uint_fast32_t i = 0; i < 1000; ++i) {
+      const double x = std::pow(100., 0.001 * i);
+      // skip the tiny intervals in which the discontinuities are located
+      if (std::abs(x / 3. - 1.) < 1.e-12 || std::abs(x / 7. - 1.) < 1.e-12) {
+        continue;
+      }
+      assert_values_equal_rel(table.get_value(x), function(x), 1.e-12);
+    }
+    assert_condition(table.get_value(2.9999) == 0.);
+    assert_values_equal_rel(table.get_value(3.0001), 3.0001, 1.e-12);
+    assert_values_equal_rel(table.get_value(6.9999), 6.9999, 1.e-12);
+    assert_values_equal_rel(table.get_value(7.0001), 2. / (7.0001 * 7.0001),
+                            1.e-12);
+  }
+
+  /// function that goes to zero smoothly: the interpolation remains accurate
+  /// close to the transition
+  {
+    auto function = [](const double x) { return std::max(0., 5. - x); };
+    LogLogInterpolationTable table(function, 1., 100., 100);
+
+    assert_condition(table.get_number_of_segments() == 3);
+    assert_condition(table.get_maximum_relative_error() < 1.e-3);
+    for (uint_fast32_t i = 0; i < 1000; ++i) {
+      const double x = 5. - std::pow(10., -0.007 * i);
+      assert_values_equal_rel(table.get_value(x), function(x),
+                              table.get_maximum_relative_error());
+    }
+    assert_condition(table.get_value(5.0001) == 0.);
+  }
+
+  /// smooth function: the reported error is a good estimate of the actual
+  /// error and decreases quadratically with the number of points
+  {
+    auto function = [](const double x) { return std::exp(-x) + 0.1; };
+    LogLogInterpolationTable coarse_table(function, 0.1, 10., 100);
+    LogLogInterpolationTable fine_table(function, 0.1, 10., 1000);
+
+    const double coarse_error = coarse_table.get_maximum_relative_error();
+    const double fine_error = fine_table.get_maximum_relative_error();
+    assert_condition(coarse_table.get_number_of_segments() == 1);
+    assert_condition(fine_error < 1.e-5);
+    assert_condition(fine_error < 0.02 * coarse_error);
+
+    double maximum_error = 0.;
+    for (uint_fast32_t i = 0; i < 100000; ++i) {
+      const double x = 0.1 * std::pow(100., 1.e-5 * i);
+      maximum_error = std::max(
+          maximum_error, std::abs(fine_table.get_value(x) / function(x) - 1.));
+    }
+    assert_condition(maximum_error <= 1.01 * fine_error);
+  }
+
+  return 0;
+}
@@ -348,5 +348,66 @@ int main(int argc, char **argv) {
                          ION_H_n) == comm.get_size());
   }
 
+  // fused reduction of multiple properties, first with a buffer that is too
+  // small to hold a single chunk (and that is not a multiple of the number of
+  // properties), then with the default buffer size
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    it.get_ionization_variables().set_mean_intensity(ION_H_n, 1.);
+    it.get_ionization_variables().set_mean_intensity(ION_He_n, 2.);
+    it.get_ionization_variables().set_heating(HEATINGTERM_H, 3.);
+  }
+
+  comm.reduce_multiple< MPI_SUM_OF_ALL_PROCESSES, double,
+                        MeanIntensityPropertyAccessor< ION_H_n >,
+                        MeanIntensityPropertyAccessor< ION_He_n >,
+                        HeatingPropertyAccessor< HEATINGTERM_H > >(
+      grid.begin(), grid.end(), 7);
+
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    const IonizationVariablesReference vars = it.get_ionization_variables();
+    assert_condition(vars.get_mean_intensity(ION_H_n) == comm.get_size());
+    assert_condition(vars.get_mean_intensity(ION_He_n) ==
+                     2. * comm.get_size());
+    assert_condition(vars.get_heating(HEATINGTERM_H) == 3. * comm.get_size());
+  }
+
+  comm.reduce_multiple< MPI_SUM_OF_ALL_PROCESSES, double,
+                        MeanIntensityPropertyAccessor< ION_H_n >,
+                        MeanIntensityPropertyAccessor< ION_He_n >,
+                        HeatingPropertyAccessor< HEATINGTERM_H > >(
+      grid.begin(), grid.end(), 0);
+
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    const IonizationVariablesReference vars = it.get_ionization_variables();
+    assert_condition(vars.get_mean_intensity(ION_H_n) ==
+                     comm.get_size() * comm.get_size());
+    assert_condition(vars.get_mean_intensity(ION_He_n) ==
+                     2. * comm.get_size() * comm.get_size());
+    assert_condition(vars.get_heating(HEATINGTERM_H) ==
+                     3. * comm.get_size() * comm.get_size());
+  }
+
+  // fused gather of multiple properties
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    it.get_ionization_variables().set_temperature(comm.get_rank());
+    it.get_ionization_variables().set_ionic_fraction(ION_H_n,
+                                                     0.1 * comm.get_rank());
+  }
+
+  comm.gather_multiple< double, TemperaturePropertyAccessor,
+                        IonicFractionPropertyAccessor< ION_H_n > >(
+      grid.begin(), grid.end(), local_chunk.first, local_chunk.second, 5);
+
+  for (int_fast32_t i = 0; i < comm.get_size(); ++i) {
+    std::pair< size_t, size_t > iblock = comm.distribute_block(
+        i, comm.get_size(), 0, grid.get_number_of_cells());
+    auto ichunk = grid.get_chunk(iblock.first, iblock.second);
+    for (auto it = ichunk.first; it != ichunk.second; ++it) {
+      const IonizationVariablesReference vars = it.get_ionization_variables();
+      assert_condition(vars.get_temperature() == i);
+      assert_condition(vars.get_ionic_fraction(ION_H_n) == 0.1 * i);
+    }
+  }
+
   return 0;
 }
@@ -29,6 +29,7 @@
 #include "Timer.hpp"
 #include "Utilities.hpp"
 
+#include <algorithm>
 #include <fstream>
 
 /**
@@ -1256,5 +1257,76 @@ int main(int argc, char **argv) {
         timer.value(), time_per_cell);
   }
 
+  /// test NewVoronoiGrid incremental update: the updated grid should be the
+  /// same as a grid constructed from scratch
+  {
+    const uint_fast32_t ncell = 1000;
+    std::vector< CoordinateVector<> > positions(ncell);
+    for (uint_fast32_t i = 0; i < ncell; ++i) {
+      positions[i] = Utilities::random_position();
+    }
+
+    Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+    NewVoronoiGrid grid(positions, box);
+    grid.compute_grid();
+    assert_condition(grid.has_incremental_update());
+
+    // step 0: only a few generators move; step 1: all generators move, over a
+    // distance that is comparable to the cell size; step 2: all generators
+    // move over a small distance, so that most cells keep their topology and
+    // only get a geometry update
+    for (uint_fast32_t step = 0; step < 3; ++step) {
+      const uint_fast32_t nmove = (step == 0) ? ncell / 20 : ncell;
+      const double dmax = (step == 0) ? 0.01 : ((step == 1) ? 0.05 : 1.e-4);
+      for (uint_fast32_t i = 0; i < nmove; ++i) {
+        for (uint_fast32_t j = 0; j < 3; ++j) {
+          positions[i][j] += dmax * (2. * Utilities::random_double() - 1.);
+          positions[i][j] = std::max(0.001, std::min(0.999, positions[i][j]));
+        }
+      }
+
+      Timer update_timer;
+      update_timer.start();
+      grid.update_grid();
+      update_timer.stop();
+
+      NewVoronoiGrid reference_grid(positions, box);
+      Timer reference_timer;
+      reference_timer.start();
+      reference_grid.compute_grid();
+      reference_timer.stop();
+
+      for (uint_fast32_t i = 0; i < ncell; ++i) {
+        assert_values_equal_rel(grid.get_volume(i),
+                                reference_grid.get_volume(i), 1.e-12);
+        const CoordinateVector<> centroid = grid.get_centroid(i);
+        const CoordinateVector<> reference_centroid =
+            reference_grid.get_centroid(i);
+        assert_values_equal_rel(centroid.x(), reference_centroid.x(), 1.e-12);
+        assert_values_equal_rel(centroid.y(), reference_centroid.y(), 1.e-12);
+        assert_values_equal_rel(centroid.z(), reference_centroid.z(), 1.e-12);
+
+        std::vector< uint_fast32_t > neighbours, reference_neighbours;
+        const std::vector< VoronoiFace > faces = grid.get_faces(i);
+        for (uint_fast32_t j = 0; j < faces.size(); ++j) {
+          neighbours.push_back(faces[j].get_neighbour());
+        }
+        const std::vector< VoronoiFace > reference_faces =
+            reference_grid.get_faces(i);
+        for (uint_fast32_t j = 0; j < reference_faces.size(); ++j) {
+          reference_neighbours.push_back(reference_faces[j].get_neighbour());
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        std::sort(reference_neighbours.begin(), reference_neighbours.end());
+        assert_condition(neighbours == reference_neighbours);
+        assert_condition(grid.get_number_of_faces(i) == faces.size());
+      }
+
+      cmac_status("Incremental grid update works (%g s, full construction: "
+                  "%g s)!",
+                  update_timer.value(), reference_timer.value());
+    }
+  }
+
   return 0;
 }
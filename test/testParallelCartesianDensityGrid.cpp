@@ -23,10 +23,51 @@
  *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
+#include "Assert.hpp"
 #include "BlockSyntaxDensityFunction.hpp"
 #include "Box.hpp"
 #include "HDF5Tools.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "MPICommunicator.hpp"
 #include "ParallelCartesianDensityGrid.hpp"
+#include "RandomGenerator.hpp"
+
+/**
+ * @brief Add the given number of photons to the given grid.
+ *
+ * All photons start from the centre of the box, have isotropic random
+ * directions and are given a random optical depth. The random generator is
+ * seeded with the same value on all processes, so that every process generates
+ * the same photons. Only the process that holds the central sub region actually
+ * adds them.
+ *
+ * @param grid ParallelCartesianDensityGrid to add photons to.
+ * @param numphoton Number of photons to add.
+ * @return Number of photons that were added to the local grid.
+ */
+uint_fast64_t add_photons(ParallelCartesianDensityGrid &grid,
+                          uint_fast64_t numphoton) {
+  RandomGenerator random_generator(42);
+  const CoordinateVector<> position(0.5);
+  const int_fast32_t block_index = grid.get_block_index(position);
+  uint_fast64_t numadded = 0;
+  for (uint_fast64_t i = 0; i < numphoton; ++i) {
+    const double cost = 2. * random_generator.get_uniform_random_double() - 1.;
+    const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+    const double phi = 2. * M_PI * random_generator.get_uniform_random_double();
+    const CoordinateVector<> direction(sint * std::cos(phi),
+                                       sint * std::sin(phi), cost);
+    const double optical_depth =
+        -std::log(random_generator.get_uniform_random_double());
+    if (grid.is_local(block_index)) {
+      Photon *photon = new Photon(position, direction, 0.);
+      photon->set_cross_section(ION_H_n, 1.);
+      grid.add_photon(block_index, photon, optical_depth);
+      ++numadded;
+    }
+  }
+  return numadded;
+}
 
 /**
  * @brief Unit test for the ParallelCartesianDensityGrid class.
@@ -37,6 +78,57 @@
  */
 int main(int argc, char **argv) {
 
+  MPICommunicator comm(argc, argv);
+
+  /// distributed photon propagation
+  {
+    // with a neutral fraction of 1e-6 and a cross section of 1 m^2, this
+    // density gives an optical depth of 1 per unit length
+    HomogeneousDensityFunction density_function(1.e6);
+    density_function.initialize();
+
+    const Box<> box(0., 1.);
+    const CoordinateVector< int_fast32_t > numcell(32, 32, 32);
+    const uint_fast64_t numphoton = 10000;
+
+    // reference run: every process holds the entire grid
+    uint_fast64_t ref_absorbed = 0;
+    uint_fast64_t ref_escaped = 0;
+    {
+      ParallelCartesianDensityGrid grid(box, numcell, 64,
+                                        std::make_pair(0, 64));
+      for (auto it = grid.begin(); it != grid.end(); ++it) {
+        (*it).initialize(density_function);
+      }
+      assert_condition(add_photons(grid, numphoton) == numphoton);
+      grid.propagate_photons(nullptr, ref_absorbed, ref_escaped);
+    }
+    assert_condition(ref_absorbed + ref_escaped == numphoton);
+    assert_condition(ref_absorbed > 0);
+    assert_condition(ref_escaped > 0);
+
+    // distributed run: every process only holds part of the grid
+    uint_fast64_t num_absorbed = 0;
+    uint_fast64_t num_escaped = 0;
+    {
+      ParallelCartesianDensityGrid grid(box, numcell, 64, &comm);
+      for (auto it = grid.begin(); it != grid.end(); ++it) {
+        (*it).initialize(density_function);
+      }
+      add_photons(grid, numphoton);
+      grid.propagate_photons(&comm, num_absorbed, num_escaped);
+    }
+    comm.reduce< MPI_SUM_OF_ALL_PROCESSES >(num_absorbed);
+    comm.reduce< MPI_SUM_OF_ALL_PROCESSES >(num_escaped);
+    assert_condition(num_absorbed == ref_absorbed);
+    assert_condition(num_escaped == ref_escaped);
+  }
+
+  // the snapshot test below is only done by a single process
+  if (comm.get_rank() != 0) {
+    return 0;
+  }
+
   // this is shorthand for box(CoordinateVector<>(0.), CoordinateVector<>(1.))
   // and only works because we have defined the single value constructor for
   // CoordinateVector<>
@@ -106,12 +198,16 @@ int main(int argc, char **argv) {
                                                   totnumcell);
   HDF5Tools::create_dataset< double >(group, "NumberDensity", totnumcell);
   for (auto it = grid.begin(); it != grid.end(); ++it) {
-    ParallelCartesianDensitySubGrid &subgrid =
-        reinterpret_cast< ParallelCartesianDensitySubGrid & >(*it);
+    ParallelCartesianDensitySubGrid &subgrid = *it;
     std::vector< CoordinateVector<> > positions = subgrid.get_positions();
+    std::vector< double > number_densities(subgrid.get_number_of_cells());
+    for (uint_fast32_t i = 0; i < subgrid.get_number_of_cells(); ++i) {
+      number_densities[i] =
+          subgrid.get_ionization_variables(i).get_number_density();
+    }
     HDF5Tools::append_dataset(group, "Coordinates", it.offset(), positions);
     HDF5Tools::append_dataset(group, "NumberDensity", it.offset(),
-                              subgrid.get_number_density_handle());
+                              number_densities);
   }
   HDF5Tools::close_group(group);
 
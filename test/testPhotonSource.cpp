@@ -29,6 +29,7 @@
 #include "CrossSections.hpp"
 #include "Error.hpp"
 #include "Photon.hpp"
+#include "PhotonPacketBatch.hpp"
 #include "PhotonSource.hpp"
 #include "PhotonSourceSpectrum.hpp"
 #include "SingleStarPhotonSourceDistribution.hpp"
@@ -127,5 +128,44 @@ int main(int argc, char **argv) {
     assert_values_equal_tol(meanenergy, 34., 1.e-2);
   }
 
+  // check the same for the batched version
+  {
+    CoordinateVector<> mean_direction;
+    uint_fast32_t numphoton = 1000000;
+    double weight = 1. / numphoton;
+    double meanenergy = 0.;
+    PhotonPacketBatch batch;
+    for (uint_fast32_t i = 0; i < numphoton / PHOTONPACKETBATCH_SIZE; ++i) {
+      source.get_random_photons(random_generator, batch,
+                                PHOTONPACKETBATCH_SIZE);
+      assert_condition(batch.size() == PHOTONPACKETBATCH_SIZE);
+      for (uint_fast32_t j = 0; j < batch.size(); ++j) {
+        Photon photon = batch.get_photon(j);
+        assert_condition(photon.get_position().x() == 0.5);
+        assert_condition(photon.get_position().y() == 0.5);
+        assert_condition(photon.get_position().z() == 0.5);
+        assert_values_equal_rel(photon.get_direction().norm(), 1., 1.e-12);
+        assert_condition(photon.get_cross_section(ION_H_n) == 1.);
+        assert_condition(photon.get_weight() == 1.);
+        mean_direction += weight * photon.get_direction();
+        meanenergy += weight * photon.get_energy();
+      }
+    }
+    // the number of photons is not an exact multiple of the batch size
+    const double norm =
+        numphoton / (PHOTONPACKETBATCH_SIZE *
+                     double(numphoton / PHOTONPACKETBATCH_SIZE));
+    mean_direction *= norm;
+    meanenergy *= norm;
+    assert_condition(std::abs(mean_direction.x()) < 1.e-3);
+    assert_condition(std::abs(mean_direction.y()) < 1.e-3);
+    assert_condition(std::abs(mean_direction.z()) < 1.e-3);
+    assert_values_equal_tol(meanenergy, 34., 1.e-2);
+
+    // partial batch
+    source.get_random_photons(random_generator, batch, 3);
+    assert_condition(batch.size() == 3);
+  }
+
   return 0;
 }
@@ -183,6 +183,36 @@ int main(int argc, char **argv) {
            << tolerance << "\n";
       assert_values_equal_rel(tval, bval, tolerance);
     }
+
+    // the batched version should sample the same spectrum
+    // we use a separate RandomGenerator, since the tolerances for the other
+    // spectra were fitted to a specific random sequence
+    RandomGenerator batch_random_generator(42);
+    for (uint_fast8_t i = 0; i < 100; ++i) {
+      counts[i] = 0;
+    }
+    double frequencies[100];
+    for (uint_fast32_t i = 0; i < numsample / 100; ++i) {
+      spectrum.get_random_frequencies(batch_random_generator, frequencies,
+                                      100);
+      for (uint_fast32_t j = 0; j < 100; ++j) {
+        double rand_freq = frequencies[j] / 3.288465385e15;
+        uint_fast32_t index = (rand_freq - 1.) * 100. / 3.;
+        ++counts[index];
+      }
+    }
+
+    enorm = planck_luminosity(1.015);
+    if (counts[0]) {
+      enorm /= counts[0];
+    }
+    for (uint_fast8_t i = 0; i < 100; ++i) {
+      double nu = 1. + (i + 0.5) * 0.03;
+      double tval = planck_luminosity(nu);
+      double bval = counts[i] * enorm;
+      double tolerance = std::pow(10., -2.29 + 0.0239001 * (i - 3.));
+      assert_values_equal_rel(tval, bval, tolerance);
+    }
   }
 
   // HydrogenLymanContinuumSpectrum
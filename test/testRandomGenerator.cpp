@@ -58,5 +58,70 @@ int main(int argc, char **argv) {
                      generator_B.get_uniform_random_double());
   }
 
+  /// Counter-based generator: known answer test
+  /// we check the first two values of stream 0 for key 0 against the output of
+  /// the Random123 reference implementation of Philox4x32-10 for a zero counter
+  /// and key: {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}
+  {
+    RandomGenerator generator(0, true);
+    assert_condition(generator.is_counter_based());
+
+    const double norm = 1. / 9007199254740992.;
+    const double reference_0 =
+        norm * (((uint64_t(0x6627e8d5) << 32) | 0xe169c58d) >> 11);
+    const double reference_1 =
+        norm * (((uint64_t(0xbc57ac4c) << 32) | 0x9b00dbd8) >> 11);
+    assert_condition(generator.get_uniform_random_double() == reference_0);
+    assert_condition(generator.get_uniform_random_double() == reference_1);
+  }
+
+  /// Counter-based generator: basic test for every stream
+  {
+    RandomGenerator generator(42, true);
+
+    double mean_random = 0.;
+    uint_fast32_t num = 1000000;
+    double weight = 1. / num;
+    for (uint_fast32_t i = 0; i < num; ++i) {
+      if (i % 100 == 0) {
+        generator.set_stream(i / 100);
+      }
+      mean_random += weight * generator.get_uniform_random_double();
+    }
+    assert_values_equal_tol(mean_random, 0.5, 1.e-3);
+  }
+
+  /// Counter-based generator: stream test
+  /// the values in a stream should only depend on the seed, stream and
+  /// substream, and not on the values that were generated before
+  {
+    RandomGenerator generator_A(42, true);
+    RandomGenerator generator_B(42, true);
+
+    generator_A.set_stream(12345, 1);
+    const double value_A = generator_A.get_uniform_random_double();
+    const double value_B = generator_A.get_uniform_random_double();
+    const double value_C = generator_A.get_uniform_random_double();
+
+    for (uint_fast32_t i = 0; i < 1001; ++i) {
+      generator_B.get_uniform_random_double();
+    }
+    generator_B.set_stream(12345, 1);
+    assert_condition(generator_B.get_uniform_random_double() == value_A);
+    assert_condition(generator_B.get_uniform_random_double() == value_B);
+    assert_condition(generator_B.get_uniform_random_double() == value_C);
+
+    // neighbouring streams and substreams and other seeds should differ
+    generator_B.set_stream(12346, 1);
+    assert_condition(generator_B.get_uniform_random_double() != value_A);
+    generator_B.set_stream(12345, 0);
+    assert_condition(generator_B.get_uniform_random_double() != value_A);
+    generator_B.set_stream(uint_fast64_t(12345) + (uint_fast64_t(1) << 32), 1);
+    assert_condition(generator_B.get_uniform_random_double() != value_A);
+    RandomGenerator generator_C(512, true);
+    generator_C.set_stream(12345, 1);
+    assert_condition(generator_C.get_uniform_random_double() != value_A);
+  }
+
   return 0;
 }
@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file testRestartFile.cpp
+ *
+ * @brief Unit test for the RestartWriter and RestartReader classes.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Assert.hpp"
+#include "CartesianDensityGrid.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "RandomGenerator.hpp"
+#include "RestartReader.hpp"
+#include "RestartWriter.hpp"
+#include "TimeLine.hpp"
+
+/**
+ * @brief Unit test for the RestartWriter and RestartReader classes.
+ *
+ * We write the state of two RandomGenerators, a TimeLine and a DensityGrid to a
+ * restart file halfway through their evolution, and check that objects
+ * restored from the restart file continue in a bit-reproducible way.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  RandomGenerator random_generator(42);
+  RandomGenerator counter_based_random_generator(42, true);
+  TimeLine timeline(0., 1., 0.0001, 0.1);
+
+  HomogeneousDensityFunction density_function(1., 2000.);
+  density_function.initialize();
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+  CartesianDensityGrid grid(box, 8, false, true);
+  std::pair< cellsize_t, cellsize_t > block =
+      std::make_pair(0, grid.get_number_of_cells());
+  grid.initialize(block, density_function);
+
+  // evolve the objects for a while
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    random_generator.get_uniform_random_double();
+  }
+  counter_based_random_generator.set_stream(42, 1);
+  // use an odd number, so that half of the last Philox block is still unused
+  for (uint_fast32_t i = 0; i < 1001; ++i) {
+    counter_based_random_generator.get_uniform_random_double();
+  }
+  double actual_timestep, current_time;
+  for (uint_fast32_t i = 0; i < 10; ++i) {
+    const double requested_timestep =
+        0.01 * (0.5 + 0.5 * random_generator.get_uniform_random_double());
+    timeline.advance(requested_timestep, actual_timestep, current_time);
+  }
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    IonizationVariablesReference ionization_variables =
+        it.get_ionization_variables();
+    ionization_variables.set_temperature(
+        1.e4 * random_generator.get_uniform_random_double());
+    ionization_variables.set_ionic_fraction(
+        ION_H_n, random_generator.get_uniform_random_double());
+    HydroVariables &hydro_variables = it.get_hydro_variables();
+    for (uint_fast8_t i = 0; i < 5; ++i) {
+      hydro_variables.primitives(i) =
+          random_generator.get_uniform_random_double();
+      hydro_variables.conserved(i) =
+          random_generator.get_uniform_random_double();
+    }
+  }
+
+  {
+    RestartWriter restart_writer("test_restart.dat");
+    random_generator.write_restart_file(restart_writer);
+    counter_based_random_generator.write_restart_file(restart_writer);
+    timeline.write_restart_file(restart_writer);
+    grid.write_restart_file(restart_writer);
+    restart_writer.write(std::string("end of test"));
+    restart_writer.finalize();
+  }
+
+  // a writer that is not finalized should not replace the existing file
+  {
+    RestartWriter restart_writer("test_restart.dat");
+    restart_writer.write(std::string("unfinished restart file"));
+  }
+
+  // set up objects with a different state and restore them
+  RandomGenerator restart_random_generator(1);
+  RandomGenerator restart_counter_based_random_generator(1);
+  TimeLine restart_timeline(0., 2., 0.1, 0.2);
+  CartesianDensityGrid restart_grid(box, 8, false, true);
+  restart_grid.initialize(block, density_function);
+  {
+    RestartReader restart_reader("test_restart.dat");
+    restart_random_generator.read_restart_file(restart_reader);
+    restart_counter_based_random_generator.read_restart_file(restart_reader);
+    restart_timeline.read_restart_file(restart_reader);
+    restart_grid.read_restart_file(restart_reader);
+    assert_condition(restart_reader.read_string() == "end of test");
+  }
+
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    assert_condition(random_generator.get_uniform_random_double() ==
+                     restart_random_generator.get_uniform_random_double());
+  }
+  assert_condition(restart_counter_based_random_generator.is_counter_based());
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    assert_condition(
+        counter_based_random_generator.get_uniform_random_double() ==
+        restart_counter_based_random_generator.get_uniform_random_double());
+  }
+
+  bool has_next_step = true;
+  while (has_next_step) {
+    const double requested_timestep =
+        0.01 * (0.5 + 0.5 * random_generator.get_uniform_random_double());
+    double restart_actual_timestep, restart_current_time;
+    has_next_step =
+        timeline.advance(requested_timestep, actual_timestep, current_time);
+    assert_condition(restart_timeline.advance(requested_timestep,
+                                              restart_actual_timestep,
+                                              restart_current_time) ==
+                     has_next_step);
+    assert_condition(actual_timestep == restart_actual_timestep);
+    assert_condition(current_time == restart_current_time);
+  }
+
+  for (auto it = grid.begin(), restart_it = restart_grid.begin();
+       it != grid.end(); ++it, ++restart_it) {
+    const IonizationVariablesReference ionization_variables =
+        it.get_ionization_variables();
+    const IonizationVariablesReference restart_ionization_variables =
+        restart_it.get_ionization_variables();
+    assert_condition(ionization_variables.get_number_density() ==
+                     restart_ionization_variables.get_number_density());
+    assert_condition(ionization_variables.get_temperature() ==
+                     restart_ionization_variables.get_temperature());
+    assert_condition(ionization_variables.get_ionic_fraction(ION_H_n) ==
+                     restart_ionization_variables.get_ionic_fraction(ION_H_n));
+    const HydroVariables &hydro_variables = it.get_hydro_variables();
+    const HydroVariables &restart_hydro_variables =
+        restart_it.get_hydro_variables();
+    for (uint_fast8_t i = 0; i < 5; ++i) {
+      assert_condition(hydro_variables.primitives(i) ==
+                       restart_hydro_variables.primitives(i));
+      assert_condition(hydro_variables.conserved(i) ==
+                       restart_hydro_variables.conserved(i));
+    }
+  }
+
+  return 0;
+}
@@ -25,8 +25,10 @@
  */
 #include "Assert.hpp"
 #include "RiemannSolver.hpp"
+#include "Utilities.hpp"
 #include <fstream>
 #include <string>
+#include <vector>
 
 /**
  * @brief Run a Rieman solver test.
@@ -94,6 +96,79 @@ void plot_solution(RiemannSolver &solver, double rhoL, double uL, double PL,
   }
 }
 
+/**
+ * @brief Get a uniform random value in the given range.
+ *
+ * @param min_value Lower limit of the range.
+ * @param max_value Upper limit of the range.
+ * @return Uniform random value in the range [min_value, max_value].
+ */
+double random_value(double min_value, double max_value) {
+  return min_value + Utilities::random_double() * (max_value - min_value);
+}
+
+/**
+ * @brief Check that the batched Riemann solver gives the same result as the
+ * scalar Riemann solver.
+ *
+ * @param solver RiemannSolver to test.
+ * @param num_test Number of interfaces to test.
+ */
+void run_batch_test(RiemannSolver &solver, const size_t num_test) {
+
+  std::vector< double > rhoL(num_test), uL(num_test), PL(num_test),
+      rhoR(num_test), uR(num_test), PR(num_test);
+  for (size_t i = 0; i < num_test; ++i) {
+    rhoL[i] = random_value(0.125, 1.);
+    uL[i] = random_value(-1., 1.);
+    PL[i] = random_value(0.1, 1.);
+    if (i % 2 == 0) {
+      // strong jump
+      rhoR[i] = random_value(0.125, 1.);
+      uR[i] = random_value(-1., 1.);
+      PR[i] = random_value(0.1, 1.);
+    } else {
+      // small jump
+      rhoR[i] = rhoL[i] * random_value(0.99, 1.01);
+      uR[i] = uL[i] + random_value(-0.01, 0.01);
+      PR[i] = PL[i] * random_value(0.99, 1.01);
+    }
+  }
+  // vacuum and vacuum generation
+  rhoL[3] = 0.;
+  PL[3] = 0.;
+  uL[5] = -10.;
+  uR[5] = 10.;
+
+  std::vector< double > rhosol(num_test), usol(num_test), Psol(num_test);
+  std::vector< int_fast32_t > flags(num_test);
+
+  // exact solver for all lanes
+  solver.solve_batch(num_test, &rhoL[0], &uL[0], &PL[0], &rhoR[0], &uR[0],
+                     &PR[0], &rhosol[0], &usol[0], &Psol[0], &flags[0]);
+  for (size_t i = 0; i < num_test; ++i) {
+    double rhoexp, uexp, Pexp;
+    const int_fast32_t flagexp = solver.solve(
+        rhoL[i], uL[i], PL[i], rhoR[i], uR[i], PR[i], rhoexp, uexp, Pexp);
+    assert_condition(flags[i] == flagexp);
+    assert_values_equal_rel(rhosol[i], rhoexp, 1.e-8);
+    assert_values_equal_rel(usol[i], uexp, 1.e-8);
+    assert_values_equal_rel(Psol[i], Pexp, 1.e-8);
+  }
+
+  // approximate HLLC solver for the lanes with a small jump
+  solver.solve_batch(num_test, &rhoL[0], &uL[0], &PL[0], &rhoR[0], &uR[0],
+                     &PR[0], &rhosol[0], &usol[0], &Psol[0], nullptr, 1.1);
+  for (size_t i = 0; i < num_test; ++i) {
+    double rhoexp, uexp, Pexp;
+    solver.solve(rhoL[i], uL[i], PL[i], rhoR[i], uR[i], PR[i], rhoexp, uexp,
+                 Pexp);
+    assert_values_equal_rel(rhosol[i], rhoexp, 1.e-2);
+    assert_values_equal_rel(usol[i], uexp, 1.e-2);
+    assert_values_equal_rel(Psol[i], Pexp, 1.e-2);
+  }
+}
+
 /**
  * @brief Unit test for the RiemannSolver class.
  *
@@ -126,5 +201,8 @@ int main(int argc, char **argv) {
   plot_solution(solver, 5.99924, 19.5975, 460.894, 5.99242, -6.19633, 46.0950,
                 0.035, "test_riemann_test5.txt");
 
+  // batched solver (deliberately not a multiple of the batch size)
+  run_batch_test(solver, 1003);
+
   return 0;
 }
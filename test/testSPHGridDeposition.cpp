@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testSPHGridDeposition.cpp
+ *
+ * @brief Unit test for the SPHGridDeposition class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "AMRDensityGrid.hpp"
+#include "AMRRefinementScheme.hpp"
+#include "Assert.hpp"
+#include "CartesianDensityGrid.hpp"
+#include "CubicSplineKernel.hpp"
+#include "SPHGridDeposition.hpp"
+#include "UniformRandomVoronoiGeneratorDistribution.hpp"
+#include "VoronoiDensityGrid.hpp"
+
+/**
+ * @brief DensityFunction that has a higher density in the upper half of the
+ * box.
+ */
+class TestDensityFunction : public DensityFunction {
+public:
+  /**
+   * @brief Function that gives the density for a given cell.
+   *
+   * @param cell Geometrical information about the cell.
+   * @return Initial physical field values for that cell.
+   */
+  DensityValues operator()(const Cell &cell) const {
+    DensityValues values;
+    if (cell.get_cell_midpoint().z() < 0.5) {
+      values.set_number_density(1.);
+    } else {
+      values.set_number_density(2.);
+    }
+    values.set_temperature(4000.);
+    return values;
+  }
+};
+
+/**
+ * @brief AMRRefinementScheme that refines the upper half of the box up to
+ * level 6.
+ */
+class TestAMRRefinementScheme : public AMRRefinementScheme {
+public:
+  /**
+   * @brief Decide if the given cell should be refined or not.
+   *
+   * @param level Current refinement level of the cell.
+   * @param cell DensityGrid::iterator pointing to a cell.
+   * @return True if the density is larger than 1.
+   */
+  virtual bool refine(uint_fast8_t level, DensityGrid::iterator &cell) const {
+    return cell.get_ionization_variables().get_number_density() > 1. &&
+           level < 6;
+  }
+};
+
+/**
+ * @brief Deposit a set of particles onto the given grid and check that the mass
+ * is conserved and that every cell that overlaps with the core of a particle
+ * kernel receives mass.
+ *
+ * @param grid DensityGrid to deposit onto.
+ */
+void check_deposition(const DensityGrid &grid) {
+
+  // the particles are close to the middle of the box, but on the coarse side of
+  // the AMR refinement boundary
+  std::vector< CoordinateVector<> > positions;
+  std::vector< double > smoothing_lengths;
+  positions.push_back(CoordinateVector<>(0.5, 0.5, 0.45));
+  smoothing_lengths.push_back(0.1);
+  positions.push_back(CoordinateVector<>(0.3, 0.6, 0.47));
+  smoothing_lengths.push_back(0.08);
+  positions.push_back(CoordinateVector<>(0.7, 0.35, 0.4));
+  smoothing_lengths.push_back(0.15);
+  std::vector< std::vector< double > > quantities(1);
+  quantities[0].push_back(1.);
+  quantities[0].push_back(2.);
+  quantities[0].push_back(3.);
+
+  std::vector< std::vector< double > > result;
+  SPHGridDeposition::deposit(grid, positions, smoothing_lengths, quantities,
+                             CubicSplineKernel::kernel_evaluate, Box<>(),
+                             result);
+
+  assert_condition(result.size() == 1);
+  assert_condition(result[0].size() == grid.get_number_of_cells());
+
+  double total_mass = 0.;
+  uint_fast32_t number_of_missed_cells = 0;
+  for (cellsize_t i = 0; i < grid.get_number_of_cells(); ++i) {
+    total_mass += result[0][i];
+    const CoordinateVector<> midpoint = grid.get_cell_midpoint(i);
+    for (size_t ipart = 0; ipart < positions.size(); ++ipart) {
+      if ((midpoint - positions[ipart]).norm() <
+              0.9 * smoothing_lengths[ipart] &&
+          result[0][i] == 0.) {
+        ++number_of_missed_cells;
+      }
+    }
+  }
+  cmac_status("Number of cells: %" PRIuFAST32 ", missed cells: %" PRIuFAST32,
+              grid.get_number_of_cells(), number_of_missed_cells);
+  assert_values_equal_rel(total_mass, 6., 1.e-12);
+  assert_condition(number_of_missed_cells == 0);
+}
+
+/**
+ * @brief Deposit particles whose kernel sticks out of the grid and check that
+ * the mass is conserved for a periodic box, and that only the fraction of the
+ * kernel inside the grid is deposited for a non-periodic box.
+ *
+ * @param grid DensityGrid to deposit onto, covering the unit box.
+ */
+void check_boundary_deposition(const DensityGrid &grid) {
+
+  // one particle straddles a face of the box, the other a corner
+  std::vector< CoordinateVector<> > positions;
+  std::vector< double > smoothing_lengths;
+  positions.push_back(CoordinateVector<>(0.02, 0.5, 0.5));
+  smoothing_lengths.push_back(0.1);
+  positions.push_back(CoordinateVector<>(0.97, 0.98, 0.01));
+  smoothing_lengths.push_back(0.08);
+  std::vector< std::vector< double > > quantities(1);
+  quantities[0].push_back(1.);
+  quantities[0].push_back(2.);
+
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+  std::vector< std::vector< double > > result;
+  SPHGridDeposition::deposit(grid, positions, smoothing_lengths, quantities,
+                             CubicSplineKernel::kernel_evaluate, box, result);
+  double total_mass = 0.;
+  for (cellsize_t i = 0; i < grid.get_number_of_cells(); ++i) {
+    total_mass += result[0][i];
+  }
+  assert_values_equal_rel(total_mass, 3., 1.e-12);
+
+  SPHGridDeposition::deposit(grid, positions, smoothing_lengths, quantities,
+                             CubicSplineKernel::kernel_evaluate, Box<>(),
+                             result);
+  total_mass = 0.;
+  for (cellsize_t i = 0; i < grid.get_number_of_cells(); ++i) {
+    total_mass += result[0][i];
+  }
+  // the fractions of the kernels inside the box (0.7601 and 0.4879) were
+  // computed using a fine Cartesian quadrature over the kernels
+  cmac_status("Mass inside a non-periodic box: %g", total_mass);
+  assert_values_equal_rel(total_mass, 0.7601 + 2. * 0.4879, 1.e-2);
+}
+
+/**
+ * @brief Unit test for the SPHGridDeposition class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+  TestDensityFunction density_function;
+  density_function.initialize();
+
+  /// Cartesian grid
+  {
+    CartesianDensityGrid grid(box, 32);
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, grid.get_number_of_cells());
+    grid.initialize(block, density_function);
+    check_deposition(grid);
+    check_boundary_deposition(grid);
+  }
+
+  /// AMR grid: the particles sit in coarse cells, but their kernels overlap
+  /// with much smaller cells
+  {
+    AMRDensityGrid grid(box, 16, new TestAMRRefinementScheme());
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, grid.get_number_of_cells());
+    grid.initialize(block, density_function);
+    assert_condition(grid.get_number_of_cells() == 16 * 16 * 8 + 64 * 64 * 32);
+    check_deposition(grid);
+    check_boundary_deposition(grid);
+  }
+
+  /// Voronoi grid: the cells have a wide range of sizes
+  {
+    UniformRandomVoronoiGeneratorDistribution *generators =
+        new UniformRandomVoronoiGeneratorDistribution(box, 1000, 42);
+    VoronoiDensityGrid grid(generators, box);
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, grid.get_number_of_cells());
+    grid.initialize(block, density_function);
+    check_deposition(grid);
+    check_boundary_deposition(grid);
+  }
+
+  return 0;
+}
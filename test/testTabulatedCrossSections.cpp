@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file testTabulatedCrossSections.cpp
+ *
+ * @brief Unit test for the TabulatedCrossSections class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Assert.hpp"
+#include "CrossSectionsFactory.hpp"
+#include "TabulatedCrossSections.hpp"
+#include "UnitConverter.hpp"
+#include "VernerCrossSections.hpp"
+
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Unit test for the TabulatedCrossSections class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  VernerCrossSections verner_cross_sections;
+
+  const double minimum_frequency =
+      UnitConverter::to_SI< QUANTITY_FREQUENCY >(10., "eV");
+  const double maximum_frequency =
+      UnitConverter::to_SI< QUANTITY_FREQUENCY >(1000., "eV");
+  TabulatedCrossSections cross_sections(
+      verner_cross_sections, minimum_frequency, maximum_frequency, 1000);
+
+  const double maximum_relative_error =
+      cross_sections.get_maximum_relative_error();
+  cmac_status("Maximum relative error: %g", maximum_relative_error);
+  assert_condition(maximum_relative_error < 1.e-2);
+
+  // compare with the exact cross sections on a much finer grid, and check that
+  // the reported error bounds the actual error
+  const uint_fast32_t number_of_frequencies = 100000;
+  std::vector< double > frequencies(number_of_frequencies);
+  for (uint_fast32_t i = 0; i < number_of_frequencies; ++i) {
+    frequencies[i] = minimum_frequency *
+                     std::pow(maximum_frequency / minimum_frequency,
+                              (i + 0.5) / number_of_frequencies);
+  }
+  std::vector< double > batch_cross_sections(number_of_frequencies);
+  for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+    const IonName ion_name = static_cast< IonName >(ion);
+    cross_sections.get_cross_sections(ion_name, &frequencies[0],
+                                      &batch_cross_sections[0],
+                                      number_of_frequencies);
+    for (uint_fast32_t i = 0; i < number_of_frequencies; ++i) {
+      const double exact =
+          verner_cross_sections.get_cross_section(ion_name, frequencies[i]);
+      const double tabulated =
+          cross_sections.get_cross_section(ion_name, frequencies[i]);
+      assert_condition(batch_cross_sections[i] == tabulated);
+      if (exact == 0.) {
+        assert_condition(tabulated == 0.);
+      } else {
+        assert_values_equal_rel(tabulated, exact,
+                                1.01 * maximum_relative_error);
+      }
+    }
+  }
+
+  // check that the factory correctly sets up the tabulated cross sections
+  {
+    ParameterFile params;
+    params.add_value("CrossSections:type", "Tabulated");
+    params.add_value("CrossSections:number of frequencies", "100");
+    CrossSections *factory_cross_sections =
+        CrossSectionsFactory::generate(params);
+    TabulatedCrossSections *tabulated_cross_sections =
+        dynamic_cast< TabulatedCrossSections * >(factory_cross_sections);
+    assert_condition(tabulated_cross_sections != nullptr);
+    assert_condition(tabulated_cross_sections->get_maximum_relative_error() >
+                     maximum_relative_error);
+    const double frequency =
+        UnitConverter::to_SI< QUANTITY_FREQUENCY >(20., "eV");
+    assert_values_equal_rel(
+        factory_cross_sections->get_cross_section(ION_H_n, frequency),
+        verner_cross_sections.get_cross_section(ION_H_n, frequency),
+        tabulated_cross_sections->get_maximum_relative_error());
+    delete factory_cross_sections;
+  }
+
+  return 0;
+}
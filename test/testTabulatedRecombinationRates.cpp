@@ -0,0 +1,102 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file testTabulatedRecombinationRates.cpp
+ *
+ * @brief Unit test for the TabulatedRecombinationRates class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Assert.hpp"
+#include "RecombinationRatesFactory.hpp"
+#include "TabulatedRecombinationRates.hpp"
+#include "VernerRecombinationRates.hpp"
+
+#include <cmath>
+
+/**
+ * @brief Unit test for the TabulatedRecombinationRates class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  VernerRecombinationRates verner_recombination_rates;
+
+  const double minimum_temperature = 10.;
+  const double maximum_temperature = 1.e9;
+  TabulatedRecombinationRates recombination_rates(
+      verner_recombination_rates, minimum_temperature, maximum_temperature,
+      1000);
+
+  const double maximum_relative_error =
+      recombination_rates.get_maximum_relative_error();
+  cmac_status("Maximum relative error: %g", maximum_relative_error);
+  assert_condition(maximum_relative_error < 1.e-3);
+
+  // compare with the exact recombination rates on a much finer grid, and check
+  // that the reported error bounds the actual error
+  const uint_fast32_t number_of_temperatures = 100000;
+  for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+    const IonName ion_name = static_cast< IonName >(ion);
+    for (uint_fast32_t i = 0; i < number_of_temperatures; ++i) {
+      const double temperature =
+          minimum_temperature *
+          std::pow(maximum_temperature / minimum_temperature,
+                   (i + 0.5) / number_of_temperatures);
+      const double exact =
+          verner_recombination_rates.get_recombination_rate(ion_name,
+                                                            temperature);
+      const double tabulated =
+          recombination_rates.get_recombination_rate(ion_name, temperature);
+      if (exact == 0.) {
+        assert_condition(tabulated == 0.);
+      } else {
+        assert_values_equal_rel(tabulated, exact,
+                                1.01 * maximum_relative_error);
+      }
+    }
+  }
+
+  // check that the factory correctly sets up the tabulated recombination rates
+  {
+    ParameterFile params;
+    params.add_value("RecombinationRates:type", "Tabulated");
+    params.add_value("RecombinationRates:number of temperatures", "100");
+    RecombinationRates *factory_recombination_rates =
+        RecombinationRatesFactory::generate(params);
+    TabulatedRecombinationRates *tabulated_recombination_rates =
+        dynamic_cast< TabulatedRecombinationRates * >(
+            factory_recombination_rates);
+    assert_condition(tabulated_recombination_rates != nullptr);
+    assert_condition(
+        tabulated_recombination_rates->get_maximum_relative_error() >
+        maximum_relative_error);
+    assert_values_equal_rel(
+        factory_recombination_rates->get_recombination_rate(ION_H_n, 8000.),
+        verner_recombination_rates.get_recombination_rate(ION_H_n, 8000.),
+        tabulated_recombination_rates->get_maximum_relative_error());
+    delete factory_recombination_rates;
+  }
+
+  return 0;
+}
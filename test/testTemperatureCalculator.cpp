@@ -78,6 +78,12 @@ int main(int argc, char **argv) {
     Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
     TemperatureCalculator calculator(true, 3, 1., abundances, 1.e-3, 100, 1.,
                                      0., 1., 0., data, rates, ctr);
+    TemperatureCalculator tabulated_calculator(true, 3, 1., abundances, 1.e-3,
+                                               100, 1., 0., 1., 0., data,
+                                               rates, ctr, true);
+    TemperatureCalculator newton_raphson_calculator(
+        true, 3, 1., abundances, 1.e-3, 100, 1., 0., 1., 0., data, rates, ctr,
+        false, true);
 
     HomogeneousDensityFunction function(1.);
     function.initialize();
@@ -111,7 +117,7 @@ int main(int argc, char **argv) {
 
         cell.reset_mean_intensities();
 
-        IonizationVariables &ionization_variables =
+        IonizationVariablesReference ionization_variables =
             cell.get_ionization_variables();
 
         const double j[NUMBER_OF_IONNAMES] = {jH,    jHe,  jCp1, jCp2, jN,
@@ -166,6 +172,29 @@ int main(int argc, char **argv) {
         assert_values_equal_rel(Sp1, fSp1, tolerance);
         assert_values_equal_rel(Sp2, fSp2, tolerance);
         assert_values_equal_rel(Sp3, fSp3, tolerance);
+
+        // the analytic derivatives of the heating and cooling w.r.t. log T at
+        // fixed ionization state should match a central difference (the line
+        // cooling contains round off noise, so the step cannot be too small)
+        double gain_fixed, loss_fixed, dgain, dloss;
+        TemperatureCalculator::compute_cooling_and_heating(
+            gain_fixed, loss_fixed, h0, he0, T, ionization_variables,
+            cell.get_cell_midpoint(), abundances, h, 1., 0., 0.75, data,
+            nullptr, &dgain, &dloss);
+        assert_condition(gain_fixed == gain);
+        assert_condition(loss_fixed == loss);
+        const double dlogT = 1.e-2;
+        double gain_p, loss_p, gain_m, loss_m;
+        TemperatureCalculator::compute_cooling_and_heating(
+            gain_p, loss_p, h0, he0, T * std::exp(dlogT), ionization_variables,
+            cell.get_cell_midpoint(), abundances, h, 1., 0., 0.75, data);
+        TemperatureCalculator::compute_cooling_and_heating(
+            gain_m, loss_m, h0, he0, T * std::exp(-dlogT), ionization_variables,
+            cell.get_cell_midpoint(), abundances, h, 1., 0., 0.75, data);
+        assert_condition(std::abs(dgain - 0.5 * (gain_p - gain_m) / dlogT) <
+                         1.e-3 * gain);
+        assert_condition(std::abs(dloss - 0.5 * (loss_p - loss_m) / dlogT) <
+                         1.e-3 * loss);
       }
     }
 
@@ -205,7 +234,7 @@ int main(int argc, char **argv) {
         // set the cell values
         cell.reset_mean_intensities();
 
-        IonizationVariables &ionization_variables =
+        IonizationVariablesReference ionization_variables =
             cell.get_ionization_variables();
 
         ionization_variables.increase_mean_intensity(
@@ -311,6 +340,40 @@ int main(int argc, char **argv) {
         assert_values_equal_rel(sp3, sp3f, tolerance);
 
         assert_values_equal_rel(Tnew, Tnewf, tolerance);
+
+        // the tabulated line cooling should give the same temperature, up to
+        // the convergence criterion of the temperature iteration
+        ionization_variables.set_temperature(T);
+        tabulated_calculator.calculate_temperature(1., 1., cell);
+        assert_values_equal_rel(ionization_variables.get_temperature(), Tnew,
+                                1.e-3);
+
+        // the Newton-Raphson solver should converge to the same temperature
+        // if the secant solver finds an equilibrium temperature; the secant
+        // solver sometimes overshoots below 4,000 K and assumes the gas is
+        // neutral, while the Newton-Raphson solver finds a real equilibrium
+        ionization_variables.set_temperature(T);
+        assert_condition(
+            newton_raphson_calculator.calculate_temperature(1., 1., cell) > 0);
+        const double Tnr = ionization_variables.get_temperature();
+        if (Tnew > 500.) {
+          assert_values_equal_rel(Tnr, Tnew, 1.e-3);
+        }
+        // restarting from the converged temperature should not require any
+        // more iterations (or a single iteration to confirm that the gas is
+        // neutral); temperatures above 30,000 K are capped, so those are not
+        // converged solutions
+        if (Tnr < 30000.) {
+          const uint_fast32_t warm_start_iterations =
+              newton_raphson_calculator.calculate_temperature(1., 1., cell);
+          if (Tnr > 500.) {
+            assert_condition(warm_start_iterations == 0);
+            assert_values_equal_rel(ionization_variables.get_temperature(),
+                                    Tnr, 1.e-12);
+          } else {
+            assert_condition(warm_start_iterations == 1);
+          }
+        }
       }
     }
   }
@@ -337,7 +400,8 @@ int main(int argc, char **argv) {
     std::ofstream ofile("test_temperaturecalculator_cr.txt");
     ofile << "# z (m)\tn (m^-3)\tT (K)\n";
     for (auto it = grid.begin(); it != grid.end(); ++it) {
-      IonizationVariables &ionization_variables = it.get_ionization_variables();
+      IonizationVariablesReference ionization_variables =
+          it.get_ionization_variables();
 
       const double z = it.get_cell_midpoint().z();
       const double z2 = z * z;
@@ -31,6 +31,7 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 /**
  * @brief Unit test for the VernerCrossSections class.
@@ -141,5 +142,25 @@ int main(int argc, char **argv) {
     }
   }
 
+  // the batched version should give exactly the same cross sections
+  {
+    const uint_fast32_t number = 1000;
+    std::vector< double > energies(number);
+    for (uint_fast32_t i = 0; i < number; ++i) {
+      energies[i] = UnitConverter::to_SI< QUANTITY_FREQUENCY >(
+          13. + i * (60. - 13.) / number, "eV");
+    }
+    std::vector< double > xsecs(number);
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      cross_sections.get_cross_sections(static_cast< IonName >(ion),
+                                        energies.data(), xsecs.data(), number);
+      for (uint_fast32_t i = 0; i < number; ++i) {
+        assert_condition(xsecs[i] ==
+                         cross_sections.get_cross_section(
+                             static_cast< IonName >(ion), energies[i]));
+      }
+    }
+  }
+
   return 0;
 }
@@ -71,6 +71,74 @@ int main(int argc, char **argv) {
 
     assert_values_equal(1., grid.get_total_hydrogen_number());
     assert_values_equal(2000., grid.get_average_temperature());
+
+    // check the photon traversal: the mean intensity integrals should add up
+    // to the total path length through the grid
+    Photon photon(CoordinateVector<>(0.01, 0.5, 0.5),
+                  CoordinateVector<>(1., 0., 0.), 1.);
+    photon.set_cross_section(ION_H_n, 1.);
+    photon.set_cross_section(ION_He_n, 1.);
+    DensityGrid::iterator inside = grid.interact(photon, 100.);
+    assert_condition(inside == grid.end());
+    double total_path_length = 0.;
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      total_path_length +=
+          it.get_ionization_variables().get_mean_intensity(ION_H_n);
+    }
+    assert_values_equal_rel(total_path_length, 0.99, 1.e-10);
+  }
+
+  /// moving generators: the incrementally updated grid and face table should
+  /// still cover the entire box and give a valid photon traversal
+  {
+    HomogeneousDensityFunction density_function(1., 2000.);
+    density_function.initialize();
+    Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+    UniformRandomVoronoiGeneratorDistribution *test_positions =
+        new UniformRandomVoronoiGeneratorDistribution(box, 1000, 42);
+    VoronoiDensityGrid grid(test_positions, box, "New", 0, false, true,
+                            nullptr);
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, grid.get_number_of_cells());
+    grid.initialize(block, density_function);
+
+    // the last step uses a very small time step, so that no cell changes its
+    // topology and the face table is updated in place
+    const double timesteps[3] = {0.001, 0.002, 1.e-8};
+    for (uint_fast32_t step = 0; step < 3; ++step) {
+      // a velocity field that vanishes at the walls of the box
+      for (auto it = grid.begin(); it != grid.end(); ++it) {
+        const CoordinateVector<> x = it.get_cell_midpoint();
+        HydroVariables &hydro_variables = it.get_hydro_variables();
+        hydro_variables.set_primitives_density(1.);
+        hydro_variables.set_primitives_pressure(1.);
+        hydro_variables.set_primitives_velocity(CoordinateVector<>(
+            std::sin(2. * M_PI * x.y()) * std::sin(M_PI * x.x()),
+            -std::sin(2. * M_PI * x.x()) * std::sin(M_PI * x.y()), 0.));
+      }
+      grid.set_grid_velocity(5. / 3.);
+      grid.evolve(timesteps[step]);
+
+      double total_volume = 0.;
+      for (auto it = grid.begin(); it != grid.end(); ++it) {
+        total_volume += it.get_volume();
+        it.get_ionization_variables().set_mean_intensity(ION_H_n, 0.);
+      }
+      assert_values_equal_rel(total_volume, 1., 1.e-10);
+
+      Photon photon(CoordinateVector<>(0.01, 0.01, 0.01),
+                    CoordinateVector<>(1. / std::sqrt(3.)), 1.);
+      photon.set_cross_section(ION_H_n, 1.);
+      photon.set_cross_section(ION_He_n, 1.);
+      DensityGrid::iterator inside = grid.interact(photon, 100.);
+      assert_condition(inside == grid.end());
+      double total_path_length = 0.;
+      for (auto it = grid.begin(); it != grid.end(); ++it) {
+        total_path_length +=
+            it.get_ionization_variables().get_mean_intensity(ION_H_n);
+      }
+      assert_values_equal_rel(total_path_length, 0.99 * std::sqrt(3.), 1.e-10);
+    }
   }
 
   return 0;
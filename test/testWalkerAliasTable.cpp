@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file testWalkerAliasTable.cpp
+ *
+ * @brief Unit test for the WalkerAliasTable class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Assert.hpp"
+#include "RandomGenerator.hpp"
+#include "WalkerAliasTable.hpp"
+
+#include <vector>
+
+/**
+ * @brief Unit test for the WalkerAliasTable class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  // a table with a single value always returns that value
+  {
+    WalkerAliasTable table(std::vector< double >(1, 3.));
+    assert_condition(table.get_size() == 1);
+    assert_condition(table.sample(0.) == 0);
+    assert_condition(table.sample(0.999) == 0);
+  }
+
+  // values with zero weight are never sampled, and the other values are
+  // sampled according to their weights
+  {
+    std::vector< double > weights(10);
+    double total_weight = 0.;
+    for (uint_fast32_t i = 0; i < 10; ++i) {
+      weights[i] = (i % 3 == 0) ? 0. : i;
+      total_weight += weights[i];
+    }
+    WalkerAliasTable table(weights);
+    assert_condition(table.get_size() == 10);
+
+    RandomGenerator random_generator(42);
+    std::vector< uint_fast32_t > counts(10, 0);
+    const uint_fast32_t numsample = 1000000;
+    for (uint_fast32_t i = 0; i < numsample; ++i) {
+      const uint_fast32_t index =
+          table.sample(random_generator.get_uniform_random_double());
+      assert_condition(index < 10);
+      ++counts[index];
+    }
+    for (uint_fast32_t i = 0; i < 10; ++i) {
+      if (weights[i] == 0.) {
+        assert_condition(counts[i] == 0);
+      } else {
+        assert_values_equal_rel(counts[i] / double(numsample),
+                                weights[i] / total_weight, 1.e-2);
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,306 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file testWorkStealingScheduler.cpp
+ *
+ * @brief Unit test for the WorkStealingScheduler class.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Assert.hpp"
+#include "Timer.hpp"
+#include "WorkDistributor.hpp"
+#include "WorkStealingScheduler.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Do an amount of work proportional to the given cost.
+ *
+ * @param cost Number of iterations to do.
+ * @return Result of the work, which should be used to make sure the work is
+ * not optimized away.
+ */
+inline double do_work(const uint_fast32_t cost) {
+  double result = 0.;
+  for (uint_fast32_t i = 0; i < cost; ++i) {
+    result += std::sqrt(i + result);
+  }
+  return result;
+}
+
+/**
+ * @brief Job that executes a chunk of work items.
+ */
+class TestJob {
+private:
+  /*! @brief Index of the first work item. */
+  const uint_fast64_t _begin;
+
+  /*! @brief Index beyond the last work item. */
+  const uint_fast64_t _end;
+
+  /*! @brief Number of times each work item was executed. */
+  std::vector< uint_fast32_t > &_counts;
+
+  /*! @brief Cost of each work item. */
+  const std::vector< uint_fast32_t > &_costs;
+
+  /*! @brief Result of each work item. */
+  std::vector< double > &_results;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param begin Index of the first work item.
+   * @param end Index beyond the last work item.
+   * @param counts Number of times each work item was executed.
+   * @param costs Cost of each work item.
+   * @param results Result of each work item.
+   */
+  inline TestJob(const uint_fast64_t begin, const uint_fast64_t end,
+                 std::vector< uint_fast32_t > &counts,
+                 const std::vector< uint_fast32_t > &costs,
+                 std::vector< double > &results)
+      : _begin(begin), _end(end), _counts(counts), _costs(costs),
+        _results(results) {}
+
+  /**
+   * @brief Should the Job be deleted by the Worker when it is finished?
+   *
+   * @return True.
+   */
+  inline bool do_cleanup() const { return true; }
+
+  /**
+   * @brief Execute all work items in the chunk.
+   */
+  inline void execute() {
+    for (uint_fast64_t i = _begin; i < _end; ++i) {
+      ++_counts[i];
+      _results[i] = do_work(_costs[i]);
+    }
+  }
+
+  /**
+   * @brief Get a name tag for this job.
+   *
+   * @return "testjob".
+   */
+  inline std::string get_tag() const { return "testjob"; }
+};
+
+/**
+ * @brief JobMarket that uses a WorkStealingScheduler to hand out TestJobs.
+ */
+class TestJobMarket {
+private:
+  /*! @brief Scheduler. */
+  WorkStealingScheduler &_scheduler;
+
+  /*! @brief Number of times each work item was executed. */
+  std::vector< uint_fast32_t > &_counts;
+
+  /*! @brief Cost of each work item. */
+  const std::vector< uint_fast32_t > &_costs;
+
+  /*! @brief Result of each work item. */
+  std::vector< double > &_results;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param scheduler Scheduler.
+   * @param counts Number of times each work item was executed.
+   * @param costs Cost of each work item.
+   * @param results Result of each work item.
+   */
+  inline TestJobMarket(WorkStealingScheduler &scheduler,
+                       std::vector< uint_fast32_t > &counts,
+                       const std::vector< uint_fast32_t > &costs,
+                       std::vector< double > &results)
+      : _scheduler(scheduler), _counts(counts), _costs(costs),
+        _results(results) {}
+
+  /**
+   * @brief Set the number of parallel threads that will be used to execute
+   * the jobs.
+   *
+   * @param worksize Number of parallel threads that will be used.
+   */
+  inline void set_worksize(int_fast32_t worksize) {
+    _scheduler.reset(0, _costs.size(), worksize);
+  }
+
+  /**
+   * @brief Get a TestJob.
+   *
+   * @param thread_id Rank of the thread that wants to get a job.
+   * @return TestJob, or a null pointer if all work is done.
+   */
+  inline TestJob *get_job(int_fast32_t thread_id) {
+    uint_fast64_t begin, end;
+    if (_scheduler.get_chunk(thread_id, begin, end)) {
+      return new TestJob(begin, end, _counts, _costs, _results);
+    } else {
+      return nullptr;
+    }
+  }
+};
+
+/**
+ * @brief Unit test for the WorkStealingScheduler class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// serial use: chunks are handed out in order and cover the entire range
+  {
+    WorkStealingScheduler scheduler(1.e-3, 10, 1, 50);
+    scheduler.reset(42, 1042, 1);
+    uint_fast64_t begin, end;
+    uint_fast64_t next = 42;
+    uint_fast32_t number_of_chunks = 0;
+    while (scheduler.get_chunk(0, begin, end)) {
+      assert_condition(begin == next);
+      assert_condition(end > begin);
+      assert_condition(end - begin <= 50);
+      if (number_of_chunks == 0) {
+        assert_condition(end - begin == 10);
+      }
+      next = end;
+      ++number_of_chunks;
+    }
+    assert_condition(next == 1042);
+    // the chunk size grows to the maximum, since no work is done in between
+    // requests
+    assert_condition(number_of_chunks < 100);
+    assert_condition(scheduler.get_number_of_steals() == 0);
+
+    // a reset with an empty range immediately signals the end of the work
+    scheduler.reset(7, 7, 1);
+    assert_condition(!scheduler.get_chunk(0, begin, end));
+  }
+
+  /// aligned use: all chunk boundaries are multiples of the alignment, also
+  /// for chunks that are stolen from other threads
+  {
+    WorkStealingScheduler scheduler(1.e-3, 10, 1, 100);
+    scheduler.set_alignment(64);
+    // we cannot use more queues than MAX_NUM_THREADS
+    const int_fast32_t worksize = std::min(3, MAX_NUM_THREADS);
+    scheduler.reset(3, 1003, worksize);
+    std::vector< uint_fast32_t > counts(1000, 0);
+    uint_fast64_t begin, end;
+    // thread 0 does all the work, so that it has to steal the work in the
+    // queues of the other threads (if there are any)
+    while (scheduler.get_chunk(0, begin, end)) {
+      assert_condition((begin - 3) % 64 == 0);
+      assert_condition(end == 1003 || (end - 3) % 64 == 0);
+      assert_condition(end > begin);
+      for (uint_fast64_t i = begin; i < end; ++i) {
+        ++counts[i - 3];
+      }
+    }
+    for (int_fast32_t i = 1; i < worksize; ++i) {
+      assert_condition(!scheduler.get_chunk(i, begin, end));
+    }
+    for (uint_fast32_t i = 0; i < 1000; ++i) {
+      assert_condition(counts[i] == 1);
+    }
+    if (worksize > 1) {
+      assert_condition(scheduler.get_number_of_steals() > 0);
+    }
+  }
+
+  /// chunk sizes adapt to the measured cost of the work items
+  {
+    WorkStealingScheduler scheduler(1.e-3, 1);
+    scheduler.reset(0, 1000000, 1);
+    uint_fast64_t begin, end;
+    uint_fast64_t last_chunk_size = 0;
+    for (uint_fast32_t i = 0; i < 20; ++i) {
+      assert_condition(scheduler.get_chunk(0, begin, end));
+      last_chunk_size = end - begin;
+      // every work item takes (at least) 0.1 ms
+      Timer timer;
+      timer.start();
+      while (timer.interval() < 1.e-4 * last_chunk_size) {
+      }
+    }
+    const double cost = scheduler.get_cost_per_item(0);
+    cmac_status("Cost per item: %g s, chunk size: %" PRIuFAST64 ".", cost,
+                last_chunk_size);
+    // the execution time can be longer than requested on a busy system, but
+    // it is never shorter
+    assert_condition(cost >= 1.e-4);
+    assert_condition(last_chunk_size <= 10);
+  }
+
+  /// parallel use with a very unbalanced workload: every work item is
+  /// executed exactly once, and idle threads steal work from busy threads
+  {
+    const uint_fast32_t number_of_items = 100000;
+    std::vector< uint_fast32_t > costs(number_of_items, 10);
+    // the first 10% of the work items are 1000 times more expensive
+    for (uint_fast32_t i = 0; i < number_of_items / 10; ++i) {
+      costs[i] = 10000;
+    }
+    std::vector< uint_fast32_t > counts(number_of_items, 0);
+    std::vector< double > results(number_of_items, 0.);
+
+    WorkStealingScheduler scheduler(1.e-4, 10);
+    TestJobMarket jobs(scheduler, counts, costs, results);
+    WorkDistributor< TestJobMarket, TestJob > workers;
+    const int_fast32_t worksize = workers.get_worksize();
+    workers.do_in_parallel(jobs);
+
+    for (uint_fast32_t i = 0; i < number_of_items; ++i) {
+      assert_condition(counts[i] == 1);
+      assert_condition(results[i] == do_work(costs[i]));
+    }
+    cmac_status("%" PRIiFAST32 " threads, %" PRIuFAST32 " steals.", worksize,
+                scheduler.get_number_of_steals());
+    if (worksize > 1) {
+      // the thread that gets the expensive items cannot finish before the
+      // other threads run out of work
+      assert_condition(scheduler.get_number_of_steals() > 0);
+    }
+
+    // a second run reuses the cost estimates and again covers all items
+    for (uint_fast32_t i = 0; i < number_of_items; ++i) {
+      counts[i] = 0;
+    }
+    workers.do_in_parallel(jobs);
+    for (uint_fast32_t i = 0; i < number_of_items; ++i) {
+      assert_condition(counts[i] == 1);
+    }
+  }
+
+  return 0;
+}
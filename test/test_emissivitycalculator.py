@@ -47,7 +47,44 @@ def main():
 
   emissivities = emissivitycalculator.get_emissivities(densitygrid)
 
-  print emissivities
+  print(emissivities)
+
+  # make maps along the three coordinate axes. All maps cover the same area, so
+  # they should contain the same total emission
+  maps = {}
+  for direction in ["x", "y", "z"]:
+    emission_map = emissivitycalculator.make_emission_map(
+      densitygrid, direction, "Halpha", (24, 16))
+    if not emission_map["units"] == "J m^-2 s^-1":
+      print("Error: wrong units (\"{a}\", expected \"{b}\")!".format(
+        a = emission_map["units"], b = "J m^-2 s^-1"))
+      sys.exit(1)
+    maps[direction] = np.array(emission_map["values"])
+    if not maps[direction].shape == (24, 16):
+      print("Error: wrong map shape ({a}, expected {b})!".format(
+        a = maps[direction].shape, b = (24, 16)))
+      sys.exit(1)
+  total = maps["x"].sum()
+  if not total > 0.:
+    print("Error: empty emission map!")
+    sys.exit(1)
+  for direction in ["y", "z"]:
+    if abs(maps[direction].sum() - total) > 1.e-10 * total:
+      print("Error: wrong total emission along {d} ({a}, expected {b})!".format(
+        d = direction, a = maps[direction].sum(), b = total))
+      sys.exit(1)
+
+  # the y map is a flipped version of the map for the corresponding viewing
+  # angles, since its first axis points in the positive x direction
+  multi_maps = emissivitycalculator.make_emission_maps(
+    densitygrid, 0.5 * np.pi, 0.5 * np.pi, ["Halpha", "OIII_5007"], (24, 16),
+    -1)
+  if not np.array_equal(np.array(multi_maps["Halpha"])[::-1], maps["y"]):
+    print("Error: make_emission_map and make_emission_maps do not agree!")
+    sys.exit(1)
+  if not np.array(multi_maps["OIII_5007"]).shape == (24, 16):
+    print("Error: wrong OIII_5007 map shape!")
+    sys.exit(1)
 
   sys.exit(0)
 
@@ -0,0 +1,193 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file ParallelLoopJobMarket.hpp
+ *
+ * @brief JobMarket that executes a function for every index in a range, used
+ * to measure the scaling of serial kernels across threads.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#ifndef PARALLELLOOPJOBMARKET_HPP
+#define PARALLELLOOPJOBMARKET_HPP
+
+#include "WorkDistributor.hpp"
+#include "WorkStealingScheduler.hpp"
+
+/**
+ * @brief Job that executes a function for a chunk of indices.
+ *
+ * The function is called as function(thread_id, index), so that it can use
+ * per thread resources (like a RandomGenerator).
+ */
+template < typename _function_ > class ParallelLoopJob {
+private:
+  /*! @brief Function to execute. */
+  _function_ &_function;
+
+  /*! @brief Rank of the thread that executes this job. */
+  const int_fast32_t _thread_id;
+
+  /*! @brief First index of the chunk. */
+  uint_fast64_t _first_index;
+
+  /*! @brief Index beyond the last index of the chunk. */
+  uint_fast64_t _last_index;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param function Function to execute.
+   * @param thread_id Rank of the thread that executes this job.
+   */
+  inline ParallelLoopJob(_function_ &function, const int_fast32_t thread_id)
+      : _function(function), _thread_id(thread_id), _first_index(0),
+        _last_index(0) {}
+
+  /**
+   * @brief Update the chunk of indices for the next run of this job.
+   *
+   * @param first_index First index of the chunk.
+   * @param last_index Index beyond the last index of the chunk.
+   */
+  inline void update_indices(const uint_fast64_t first_index,
+                             const uint_fast64_t last_index) {
+    _first_index = first_index;
+    _last_index = last_index;
+  }
+
+  /**
+   * @brief Should the Worker delete the Job when it is finished?
+   *
+   * @return False, since the job is reused.
+   */
+  inline bool do_cleanup() const { return false; }
+
+  /**
+   * @brief Execute the function for every index in the chunk.
+   */
+  inline void execute() {
+    for (uint_fast64_t i = _first_index; i < _last_index; ++i) {
+      _function(_thread_id, i);
+    }
+  }
+
+  /**
+   * @brief Get a name tag for this job.
+   *
+   * @return "parallel_loop".
+   */
+  inline std::string get_tag() const { return "parallel_loop"; }
+};
+
+/**
+ * @brief JobMarket for ParallelLoopJobs.
+ */
+template < typename _function_ > class ParallelLoopJobMarket {
+private:
+  /*! @brief Function to execute. */
+  _function_ &_function;
+
+  /*! @brief Number of indices in the range. */
+  const uint_fast64_t _size;
+
+  /*! @brief Per thread ParallelLoopJob. */
+  ParallelLoopJob< _function_ > *_jobs[MAX_NUM_THREADS];
+
+  /*! @brief Scheduler that distributes the indices over the threads. */
+  WorkStealingScheduler _scheduler;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param function Function to execute.
+   * @param size Number of indices in the range.
+   * @param jobsize Number of indices in the first job of every thread (later
+   * jobs adapt their size to the measured cost).
+   */
+  inline ParallelLoopJobMarket(_function_ &function, const uint_fast64_t size,
+                               const uint_fast64_t jobsize)
+      : _function(function), _size(size), _scheduler(1.e-3, jobsize) {
+    for (int_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
+      _jobs[i] = nullptr;
+    }
+  }
+
+  /**
+   * @brief Destructor.
+   */
+  inline ~ParallelLoopJobMarket() {
+    for (int_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
+      delete _jobs[i];
+    }
+  }
+
+  /**
+   * @brief Set the number of parallel threads that will be used.
+   *
+   * @param worksize Number of parallel threads.
+   */
+  inline void set_worksize(const int_fast32_t worksize) {
+    _scheduler.reset(0, _size, worksize);
+    for (int_fast32_t i = 0; i < worksize; ++i) {
+      if (_jobs[i] == nullptr) {
+        _jobs[i] = new ParallelLoopJob< _function_ >(_function, i);
+      }
+    }
+  }
+
+  /**
+   * @brief Get a ParallelLoopJob.
+   *
+   * @param thread_id Rank of the thread that calls this function.
+   * @return ParallelLoopJob, or a nullptr if all indices have been handed out.
+   */
+  inline ParallelLoopJob< _function_ > *get_job(const int_fast32_t thread_id) {
+    uint_fast64_t first_index, last_index;
+    if (_scheduler.get_chunk(thread_id, first_index, last_index)) {
+      _jobs[thread_id]->update_indices(first_index, last_index);
+      return _jobs[thread_id];
+    } else {
+      return nullptr;
+    }
+  }
+};
+
+/**
+ * @brief Execute the given function for every index in the range [0, size[,
+ * using as many threads as allowed by the WorkEnvironment.
+ *
+ * @param size Number of indices in the range.
+ * @param function Function to execute, called as function(thread_id, index).
+ * @param jobsize Number of indices in the first job of every thread.
+ */
+template < typename _function_ >
+inline void parallel_loop(const uint_fast64_t size, _function_ &function,
+                          const uint_fast64_t jobsize = 100) {
+  WorkDistributor< ParallelLoopJobMarket< _function_ >,
+                   ParallelLoopJob< _function_ > >
+      workers;
+  ParallelLoopJobMarket< _function_ > jobs(function, size, jobsize);
+  workers.do_in_parallel(jobs);
+}
+
+#endif // PARALLELLOOPJOBMARKET_HPP
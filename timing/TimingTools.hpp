@@ -35,9 +35,213 @@
 #include <cmath>
 #include <cstdint>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 
+/**
+ * @brief Machine-readable JSON summary of the results of a timing test.
+ *
+ * Every timing and scaling block adds an entry to the summary. The summary is
+ * written to the JSON file when the object is destroyed at the end of the
+ * timing test.
+ */
+class TimingToolsJSONOutput {
+private:
+  /*! @brief Name of the timing test. */
+  const std::string _name;
+
+  /*! @brief Name of the JSON file (no file is written if this is empty). */
+  const std::string _filename;
+
+  /*! @brief Number of samples used for every timing. */
+  const uint_fast32_t _number_of_samples;
+
+  /*! @brief JSON representations of the timing blocks. */
+  std::vector< std::string > _timings;
+
+  /*! @brief JSON representations of the scaling blocks. */
+  std::vector< std::string > _scalings;
+
+  /**
+   * @brief Get the JSON representation of the given string.
+   *
+   * @param value String value.
+   * @return Quoted and escaped string.
+   */
+  inline static std::string to_json(const std::string &value) {
+    std::string json = "\"";
+    for (size_t i = 0; i < value.size(); ++i) {
+      if (value[i] == '"' || value[i] == '\\') {
+        json += '\\';
+        json += value[i];
+      } else if (value[i] == '\n') {
+        json += "\\n";
+      } else if (value[i] == '\t') {
+        json += "\\t";
+      } else {
+        json += value[i];
+      }
+    }
+    json += "\"";
+    return json;
+  }
+
+  /**
+   * @brief Get the JSON representation of the given floating point value.
+   *
+   * @param value Floating point value.
+   * @return String representation of the value (null if the value is not a
+   * finite number).
+   */
+  inline static std::string to_json(const double value) {
+    if (!std::isfinite(value)) {
+      return "null";
+    }
+    std::stringstream json;
+    json.precision(10);
+    json << value;
+    return json.str();
+  }
+
+  /**
+   * @brief Get the JSON fields containing the throughput for the given time.
+   *
+   * @param time Time (in s).
+   * @param number Number of items processed in that time.
+   * @param item Name of a single item.
+   * @return JSON fields (empty if the number of items is zero).
+   */
+  inline static std::string get_throughput_fields(const double time,
+                                                  const double number,
+                                                  const std::string &item) {
+    if (number == 0.) {
+      return "";
+    }
+    return ", \"throughput\": " + to_json(number / time) +
+           ", \"throughput_unit\": " + to_json(item + " per second");
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param name Name of the timing test.
+   * @param filename Name of the JSON file (no file is written if this is
+   * empty).
+   * @param number_of_samples Number of samples used for every timing.
+   */
+  inline TimingToolsJSONOutput(const std::string name,
+                               const std::string filename,
+                               const uint_fast32_t number_of_samples)
+      : _name(name), _filename(filename),
+        _number_of_samples(number_of_samples) {}
+
+  /**
+   * @brief Destructor.
+   *
+   * Writes the JSON file.
+   */
+  inline ~TimingToolsJSONOutput() {
+
+    if (_filename.empty()) {
+      return;
+    }
+
+    std::ofstream ofile(_filename);
+    ofile << "{\n";
+    ofile << "  \"name\": " << to_json(_name) << ",\n";
+    ofile << "  \"timestamp\": " << to_json(Utilities::get_timestamp())
+          << ",\n";
+    ofile << "  \"number_of_samples\": " << _number_of_samples << ",\n";
+    ofile << "  \"system\": {";
+    for (auto it = CompilerInfo::begin(); it != CompilerInfo::end(); ++it) {
+      if (it != CompilerInfo::begin()) {
+        ofile << ",";
+      }
+      ofile << "\n    " << to_json(it.get_key()) << ": "
+            << to_json(it.get_value());
+    }
+    ofile << "\n  },\n";
+    ofile << "  \"timings\": [";
+    for (size_t i = 0; i < _timings.size(); ++i) {
+      if (i > 0) {
+        ofile << ",";
+      }
+      ofile << "\n    " << _timings[i];
+    }
+    ofile << "\n  ],\n";
+    ofile << "  \"scaling\": [";
+    for (size_t i = 0; i < _scalings.size(); ++i) {
+      if (i > 0) {
+        ofile << ",";
+      }
+      ofile << "\n    " << _scalings[i];
+    }
+    ofile << "\n  ]\n";
+    ofile << "}\n";
+  }
+
+  /**
+   * @brief Add the result of a timing block.
+   *
+   * @param name Name of the timing block.
+   * @param average_time Average time of a single sample (in s).
+   * @param standard_deviation Standard deviation on the time (in s).
+   * @param number Number of items processed during a single sample (0 if the
+   * throughput is not known).
+   * @param item Name of a single item.
+   */
+  inline void add_timing(const std::string name, const double average_time,
+                         const double standard_deviation,
+                         const double number = 0.,
+                         const std::string item = "") {
+    _timings.push_back(
+        "{\"name\": " + to_json(name) + ", \"average_time\": " +
+        to_json(average_time) + ", \"standard_deviation\": " +
+        to_json(standard_deviation) +
+        get_throughput_fields(average_time, number, item) + "}");
+  }
+
+  /**
+   * @brief Add the result of a scaling block.
+   *
+   * The speedup and parallel efficiency are computed with respect to the
+   * single thread time.
+   *
+   * @param name Name of the scaling block.
+   * @param average_times Average time of a single sample for every number of
+   * threads (in s).
+   * @param standard_deviations Standard deviation on the time for every number
+   * of threads (in s).
+   * @param number Number of items processed during a single sample (0 if the
+   * throughput is not known).
+   * @param item Name of a single item.
+   */
+  inline void add_scaling(const std::string name,
+                          const std::vector< double > &average_times,
+                          const std::vector< double > &standard_deviations,
+                          const double number = 0.,
+                          const std::string item = "") {
+    std::string json = "{\"name\": " + to_json(name) + ", \"threads\": [";
+    for (size_t i = 0; i < average_times.size(); ++i) {
+      if (i > 0) {
+        json += ",";
+      }
+      const double speedup = average_times[0] / average_times[i];
+      json += "\n      {\"number_of_threads\": " + std::to_string(i + 1) +
+              ", \"average_time\": " + to_json(average_times[i]) +
+              ", \"standard_deviation\": " +
+              to_json(standard_deviations[i]) +
+              ", \"speedup\": " + to_json(speedup) +
+              ", \"efficiency\": " + to_json(speedup / (i + 1)) +
+              get_throughput_fields(average_times[i], number, item) + "}";
+    }
+    json += "]}";
+    _scalings.push_back(json);
+  }
+};
+
 /**
  * @brief Wrapper around printf.
  *
@@ -60,6 +264,9 @@
  *
  * All other macros in this file only work after this macro has been called.
  *
+ * The results of all timing and scaling blocks are written to a JSON file
+ * (by default called name.json) at the end of the timing test.
+ *
  * @param name Name of the timing test.
  * @param argc Number of command line arguments.
  * @param argv Command line arguments.
@@ -74,6 +281,10 @@
       "number_of_threads", 't',                                                \
       "Set the maximum number of threads available on the system.",            \
       COMMANDLINEOPTION_INTARGUMENT, "1");                                     \
+  timingtools_command_line_parser.add_option(                                  \
+      "json_output", 'j',                                                      \
+      "Set the name of the JSON file with the timing results (none if empty).",\
+      COMMANDLINEOPTION_STRINGARGUMENT, std::string(name) + ".json");          \
   timingtools_command_line_parser.parse_arguments(argc, argv);                 \
   const uint_fast32_t timingtools_num_sample =                                 \
       timingtools_command_line_parser.get_value< int_fast32_t >(               \
@@ -81,6 +292,10 @@
   const uint_fast32_t timingtools_num_threads =                                \
       timingtools_command_line_parser.get_value< int_fast32_t >(               \
           "number_of_threads");                                                \
+  TimingToolsJSONOutput timingtools_json_output(                               \
+      name,                                                                    \
+      timingtools_command_line_parser.get_value< std::string >("json_output"), \
+      timingtools_num_sample);                                                 \
   (void)timingtools_num_sample;                                                \
   (void)timingtools_num_threads;
 
@@ -104,13 +319,12 @@
          timingtools_index < timingtools_num_sample; ++timingtools_index)
 
 /**
- * @brief End the timing block with the given name.
+ * @brief Compute the average time and standard deviation of the timing block.
  *
- * See timingtools_start_timing_block for more information.
- *
- * @param name Name of the timing block.
+ * Used internally by timingtools_end_timing_block and
+ * timingtools_end_timing_block_rate.
  */
-#define timingtools_end_timing_block(name)                                     \
+#define timingtools_compute_timing_statistics()                                \
   double timingtools_average_time = 0.;                                        \
   for (uint_fast8_t timingtools_index = 0;                                     \
        timingtools_index < timingtools_num_sample; ++timingtools_index) {      \
@@ -126,9 +340,42 @@
         timingtools_time_diff * timingtools_time_diff;                         \
   }                                                                            \
   timingtools_standard_deviation /= timingtools_num_sample;                    \
-  timingtools_standard_deviation = std::sqrt(timingtools_standard_deviation);  \
+  timingtools_standard_deviation = std::sqrt(timingtools_standard_deviation);
+
+/**
+ * @brief End the timing block with the given name.
+ *
+ * See timingtools_start_timing_block for more information.
+ *
+ * @param name Name of the timing block.
+ */
+#define timingtools_end_timing_block(name)                                     \
+  timingtools_compute_timing_statistics();                                     \
   timingtools_print("Finished timing %s: %g +- %g s.", name,                   \
                     timingtools_average_time, timingtools_standard_deviation); \
+  timingtools_json_output.add_timing(name, timingtools_average_time,           \
+                                     timingtools_standard_deviation);          \
+  }
+
+/**
+ * @brief End the timing block with the given name and also print the number
+ * of processed items per second.
+ *
+ * See timingtools_start_timing_block for more information.
+ *
+ * @param name Name of the timing block.
+ * @param number Number of items processed during a single sample.
+ * @param item Name of a single item (used for the output).
+ */
+#define timingtools_end_timing_block_rate(name, number, item)                  \
+  timingtools_compute_timing_statistics();                                     \
+  timingtools_print("Finished timing %s: %g +- %g s (%g %s per second).",      \
+                    name, timingtools_average_time,                            \
+                    timingtools_standard_deviation,                            \
+                    (number) / timingtools_average_time, item);                \
+  timingtools_json_output.add_timing(name, timingtools_average_time,           \
+                                     timingtools_standard_deviation, (number), \
+                                     item);                                    \
   }
 
 /**
@@ -178,14 +425,17 @@
            timingtools_index < timingtools_num_sample; ++timingtools_index)
 
 /**
- * @brief End the scaling block with the given name.
+ * @brief End the scaling block with the given name and also store the number
+ * of processed items per second in the JSON output.
  *
  * See timingtools_start_scaling_block for more information.
  *
  * @param name Name of the scaling block.
  * @param filename Name of the file to write scaling statistics to.
+ * @param number Number of items processed during a single sample.
+ * @param item Name of a single item (used for the output).
  */
-#define timingtools_end_scaling_block(name, filename)                          \
+#define timingtools_end_scaling_block_rate(name, filename, number, item)       \
   for (uint_fast8_t timingtools_index = 0;                                     \
        timingtools_index < timingtools_num_sample; ++timingtools_index) {      \
     timingtools_scaling_array[timingtools_current_num_threads] +=              \
@@ -201,8 +451,10 @@
     timingtools_scaling_standard_deviation[timingtools_current_num_threads] += \
         timingtools_time_diff * timingtools_time_diff;                         \
   }                                                                            \
-  timingtools_scaling_standard_deviation[timingtools_current_num_threads] /=   \
-      timingtools_num_sample;                                                  \
+  timingtools_scaling_standard_deviation[timingtools_current_num_threads] =    \
+      std::sqrt(timingtools_scaling_standard_deviation                         \
+                    [timingtools_current_num_threads] /                        \
+                timingtools_num_sample);                                       \
   }                                                                            \
   timingtools_print("Finished scaling test for %s:", name);                    \
   timingtools_print("number of threads\ttotal time (s)\tstandard deviation");  \
@@ -239,6 +491,20 @@
                [timingtools_current_num_threads]                               \
         << "\n";                                                               \
   }                                                                            \
+  timingtools_json_output.add_scaling(name, timingtools_scaling_array,         \
+                                      timingtools_scaling_standard_deviation,  \
+                                      (number), item);                         \
   }
 
+/**
+ * @brief End the scaling block with the given name.
+ *
+ * See timingtools_start_scaling_block for more information.
+ *
+ * @param name Name of the scaling block.
+ * @param filename Name of the file to write scaling statistics to.
+ */
+#define timingtools_end_scaling_block(name, filename)                          \
+  timingtools_end_scaling_block_rate(name, filename, 0., "")
+
 #endif // TIMINGTOOLS_HPP
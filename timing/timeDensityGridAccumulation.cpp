@@ -0,0 +1,229 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeDensityGridAccumulation.cpp
+ *
+ * @brief Timing test for the different DensityGridAccumulationMode options.
+ *
+ * All photons are emitted from the centre of the grid, so that the central
+ * cells are traversed by every photon and the threads constantly compete for
+ * the same cells. To compare with the USE_LOCKFREE configuration option, the
+ * code has to be reconfigured with that option enabled, in which case the
+ * "Lock" timings use atomic additions.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "CartesianDensityGrid.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "Lock.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+#include "WorkDistributor.hpp"
+
+/**
+ * @brief Job that propagates photons emitted from the centre of the grid.
+ */
+class AccumulationJob {
+private:
+  /*! @brief DensityGrid through which photons are propagated. */
+  DensityGrid &_grid;
+
+  /*! @brief RandomGenerator used to generate random photon directions. */
+  RandomGenerator _random_generator;
+
+  /*! @brief Number of photons to propagate. */
+  uint_fast32_t _numphoton;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param grid DensityGrid through which photons are propagated.
+   * @param random_seed Seed for the random generator.
+   */
+  AccumulationJob(DensityGrid &grid, int_fast32_t random_seed)
+      : _grid(grid), _random_generator(random_seed), _numphoton(0) {}
+
+  /**
+   * @brief Set the number of photons to propagate.
+   *
+   * @param numphoton Number of photons to propagate.
+   */
+  inline void set_numphoton(uint_fast32_t numphoton) { _numphoton = numphoton; }
+
+  /**
+   * @brief Should the Job be deleted by the Worker when it is finished?
+   *
+   * @return False, since the Job is reused.
+   */
+  inline bool do_cleanup() const { return false; }
+
+  /**
+   * @brief Propagate the photons.
+   */
+  inline void execute() {
+    const CoordinateVector<> origin(0.5, 0.5, 0.5);
+    for (uint_fast32_t i = 0; i < _numphoton; ++i) {
+      const double cost =
+          2. * _random_generator.get_uniform_random_double() - 1.;
+      const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+      const double phi =
+          2. * M_PI * _random_generator.get_uniform_random_double();
+      const CoordinateVector<> direction(sint * std::cos(phi),
+                                         sint * std::sin(phi), cost);
+      Photon photon(origin, direction, 1.);
+      photon.set_cross_section(ION_H_n, 1.);
+      photon.set_cross_section(ION_He_n, 1.);
+      _grid.interact(photon, 100.);
+    }
+  }
+
+  /**
+   * @brief Get a name tag for this job.
+   *
+   * @return "accumulationjob".
+   */
+  inline std::string get_tag() const { return "accumulationjob"; }
+};
+
+/**
+ * @brief JobMarket for AccumulationJob instances.
+ */
+class AccumulationJobMarket {
+private:
+  /*! @brief Per thread AccumulationJob. */
+  AccumulationJob *_jobs[MAX_NUM_THREADS];
+
+  /*! @brief Number of photons that still needs to be propagated. */
+  uint_fast32_t _numphoton;
+
+  /*! @brief Number of photons per job. */
+  const uint_fast32_t _jobsize;
+
+  /*! @brief Lock used to ensure safe access to the photon counter. */
+  Lock _lock;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param grid DensityGrid through which photons are propagated.
+   * @param numphoton Total number of photons to propagate.
+   * @param jobsize Number of photons per job.
+   */
+  AccumulationJobMarket(DensityGrid &grid, uint_fast32_t numphoton,
+                        uint_fast32_t jobsize)
+      : _numphoton(numphoton), _jobsize(jobsize) {
+    for (int_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
+      _jobs[i] = new AccumulationJob(grid, 42 + i);
+    }
+  }
+
+  /**
+   * @brief Destructor.
+   */
+  ~AccumulationJobMarket() {
+    for (int_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
+      delete _jobs[i];
+    }
+  }
+
+  /**
+   * @brief Set the number of parallel threads that will be used.
+   *
+   * @param worksize Number of parallel threads.
+   */
+  inline void set_worksize(int_fast32_t worksize) {}
+
+  /**
+   * @brief Get an AccumulationJob.
+   *
+   * @param thread_id Rank of the thread that calls this function.
+   * @return AccumulationJob, or a nullptr if all photons have been handed out.
+   */
+  inline AccumulationJob *get_job(int_fast32_t thread_id) {
+    _lock.lock();
+    const uint_fast32_t numphoton = std::min(_jobsize, _numphoton);
+    _numphoton -= numphoton;
+    _lock.unlock();
+    if (numphoton == 0) {
+      return nullptr;
+    }
+    _jobs[thread_id]->set_numphoton(numphoton);
+    return _jobs[thread_id];
+  }
+};
+
+/**
+ * @brief Propagate photons through the grid and add the per-thread
+ * accumulators to the cells (if applicable).
+ *
+ * @param grid DensityGrid to use.
+ * @param numphoton Number of photons to propagate.
+ */
+static void propagate_photons(DensityGrid &grid, uint_fast32_t numphoton) {
+  WorkDistributor< AccumulationJobMarket, AccumulationJob > workers;
+  AccumulationJobMarket jobs(grid, numphoton, 100);
+
+  workers.do_in_parallel(jobs);
+  grid.reduce_thread_accumulators(workers.get_worksize());
+}
+
+/**
+ * @brief Timing test for the different DensityGridAccumulationMode options.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeDensityGridAccumulation", argc, argv);
+
+  HomogeneousDensityFunction density_function(1., 8000.);
+  density_function.initialize();
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+  CartesianDensityGrid grid(box, 32);
+  std::pair< cellsize_t, cellsize_t > block =
+      std::make_pair(0, grid.get_number_of_cells());
+  grid.initialize(block, density_function);
+
+  const uint_fast32_t numphoton = 100000;
+
+  timingtools_print_header("Accumulation of the mean intensity integrals "
+                           "(%" PRIuFAST32 " photons).",
+                           numphoton);
+
+  const std::string modes[3] = {"Lock", "Atomic", "ThreadLocal"};
+  for (uint_fast8_t i = 0; i < 3; ++i) {
+    timingtools_start_scaling_block(modes[i].c_str()) {
+      // the mode needs to be set inside the scaling loop, since the number of
+      // per-thread accumulators depends on the number of threads
+      grid.set_accumulation_mode(DensityGrid::get_accumulation_mode(modes[i]));
+      timingtools_start_timing();
+      propagate_photons(grid, numphoton);
+      timingtools_stop_timing();
+    }
+    timingtools_end_scaling_block(
+        modes[i].c_str(),
+        "timeDensityGridAccumulation_scaling_" + modes[i] + ".txt");
+  }
+
+  return 0;
+}
@@ -0,0 +1,176 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file timeDensityGridInteract.cpp
+ *
+ * @brief Timing test for the photon traversal (DensityGrid::interact()) of the
+ * Cartesian, AMR and Voronoi grids.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "AMRDensityGrid.hpp"
+#include "CartesianDensityGrid.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "ParallelLoopJobMarket.hpp"
+#include "RandomGenerator.hpp"
+#include "SpatialAMRRefinementScheme.hpp"
+#include "TimingTools.hpp"
+#include "UniformRandomVoronoiGeneratorDistribution.hpp"
+#include "VoronoiDensityGrid.hpp"
+
+#include <vector>
+
+/**
+ * @brief Functor that propagates a single photon through a DensityGrid.
+ */
+class PhotonTraversalFunction {
+private:
+  /*! @brief DensityGrid through which photons are propagated. */
+  DensityGrid &_grid;
+
+  /*! @brief Photon origins (in m). */
+  const std::vector< CoordinateVector<> > &_origins;
+
+  /*! @brief Photon directions. */
+  const std::vector< CoordinateVector<> > &_directions;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param grid DensityGrid through which photons are propagated.
+   * @param origins Photon origins (in m).
+   * @param directions Photon directions.
+   */
+  inline PhotonTraversalFunction(
+      DensityGrid &grid, const std::vector< CoordinateVector<> > &origins,
+      const std::vector< CoordinateVector<> > &directions)
+      : _grid(grid), _origins(origins), _directions(directions) {}
+
+  /**
+   * @brief Propagate the photon with the given index through the grid.
+   *
+   * @param thread_id Rank of the thread that executes the function (not used).
+   * @param index Index of the photon.
+   */
+  inline void operator()(const int_fast32_t thread_id,
+                         const uint_fast64_t index) {
+    Photon photon(_origins[index], _directions[index], 1.);
+    photon.set_cross_section(ION_H_n, 1.);
+    photon.set_cross_section(ION_He_n, 1.);
+    _grid.interact(photon, 100.);
+  }
+};
+
+/**
+ * @brief Timing test for the photon traversal (DensityGrid::interact()) of the
+ * Cartesian, AMR and Voronoi grids.
+ *
+ * All grids have a comparable number of cells, and photons start from random
+ * positions in random directions until they leave the grid.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeDensityGridInteract", argc, argv);
+
+  const uint_fast32_t numphoton = 100000;
+
+  HomogeneousDensityFunction density_function(1., 8000.);
+  density_function.initialize();
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+
+  // set up the photon origins and directions
+  RandomGenerator random_generator(42);
+  std::vector< CoordinateVector<> > origins(numphoton);
+  std::vector< CoordinateVector<> > directions(numphoton);
+  for (uint_fast32_t i = 0; i < numphoton; ++i) {
+    origins[i][0] = random_generator.get_uniform_random_double();
+    origins[i][1] = random_generator.get_uniform_random_double();
+    origins[i][2] = random_generator.get_uniform_random_double();
+    const double cost = 2. * random_generator.get_uniform_random_double() - 1.;
+    const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+    const double phi = 2. * M_PI * random_generator.get_uniform_random_double();
+    directions[i][0] = sint * std::cos(phi);
+    directions[i][1] = sint * std::sin(phi);
+    directions[i][2] = cost;
+  }
+
+  // the AMR grid has a 32^3 top level grid that is refined once in the
+  // central region
+  DensityGrid *grids[3];
+  grids[0] = new CartesianDensityGrid(box, 40);
+  grids[1] = new AMRDensityGrid(
+      box, 32,
+      new SpatialAMRRefinementScheme(
+          Box<>(CoordinateVector<>(0.25), CoordinateVector<>(0.5)), 6));
+  grids[2] = new VoronoiDensityGrid(
+      new UniformRandomVoronoiGeneratorDistribution(box, 64000, 42), box,
+      "New");
+  const std::string names[3] = {"Cartesian", "AMR", "Voronoi"};
+  // photon traversal through the Voronoi grid is much more expensive, so we
+  // use fewer photons for that grid
+  const uint_fast32_t grid_numphoton[3] = {numphoton, numphoton,
+                                           numphoton / 10};
+
+  for (uint_fast8_t igrid = 0; igrid < 3; ++igrid) {
+    DensityGrid &grid = *grids[igrid];
+    const uint_fast32_t number_of_photons = grid_numphoton[igrid];
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, grid.get_number_of_cells());
+    grid.initialize(block, density_function);
+
+    timingtools_print_header("%s grid (%" PRIuFAST32 " cells, %" PRIuFAST32
+                             " photons).",
+                             names[igrid].c_str(),
+                             uint_fast32_t(grid.get_number_of_cells()),
+                             number_of_photons);
+
+    PhotonTraversalFunction propagate_photon(grid, origins, directions);
+
+    const std::string name = names[igrid] + " interact";
+    timingtools_start_timing_block(name.c_str()) {
+      timingtools_start_timing();
+      for (uint_fast32_t i = 0; i < number_of_photons; ++i) {
+        propagate_photon(0, i);
+      }
+      timingtools_stop_timing();
+    }
+    timingtools_end_timing_block_rate(name.c_str(), number_of_photons,
+                                      "photons");
+
+    timingtools_start_scaling_block(name.c_str()) {
+      timingtools_start_timing();
+      parallel_loop(number_of_photons, propagate_photon, 100);
+      timingtools_stop_timing();
+    }
+    timingtools_end_scaling_block_rate(
+        name.c_str(),
+        "timeDensityGridInteract_scaling_" + names[igrid] + ".txt",
+        number_of_photons, "photons");
+
+    delete grids[igrid];
+  }
+
+  return 0;
+}
@@ -0,0 +1,160 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file timeEmissivityCalculator.cpp
+ *
+ * @brief Timing test for the EmissivityCalculator.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Abundances.hpp"
+#include "EmissivityCalculator.hpp"
+#include "IonizationVariables.hpp"
+#include "LineCoolingData.hpp"
+#include "ParallelLoopJobMarket.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+
+#include <vector>
+
+/**
+ * @brief Functor that computes the emissivities for a single cell.
+ */
+class EmissivityFunction {
+private:
+  /*! @brief EmissivityCalculator to use. */
+  const EmissivityCalculator &_calculator;
+
+  /*! @brief Abundances. */
+  const Abundances &_abundances;
+
+  /*! @brief LineCoolingData used to compute the line emissivities. */
+  const LineCoolingData &_line_cooling_data;
+
+  /*! @brief IonizationVariables of the cells. */
+  const std::vector< IonizationVariables > &_ionization_variables;
+
+  /*! @brief Per thread total H-alpha emissivity (prevents the compiler from
+   *  optimizing away the computation). */
+  std::vector< double > &_total_emissivity;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param calculator EmissivityCalculator to use.
+   * @param abundances Abundances.
+   * @param line_cooling_data LineCoolingData used to compute the line
+   * emissivities.
+   * @param ionization_variables IonizationVariables of the cells.
+   * @param total_emissivity Per thread total H-alpha emissivity.
+   */
+  inline EmissivityFunction(
+      const EmissivityCalculator &calculator, const Abundances &abundances,
+      const LineCoolingData &line_cooling_data,
+      const std::vector< IonizationVariables > &ionization_variables,
+      std::vector< double > &total_emissivity)
+      : _calculator(calculator), _abundances(abundances),
+        _line_cooling_data(line_cooling_data),
+        _ionization_variables(ionization_variables),
+        _total_emissivity(total_emissivity) {}
+
+  /**
+   * @brief Compute the emissivities for the cell with the given index.
+   *
+   * @param thread_id Rank of the thread that executes the function.
+   * @param index Index of the cell.
+   */
+  inline void operator()(const int_fast32_t thread_id,
+                         const uint_fast64_t index) {
+    const EmissivityValues values = _calculator.calculate_emissivities(
+        _ionization_variables[index], _abundances, _line_cooling_data);
+    _total_emissivity[thread_id] +=
+        values.get_emissivity(EMISSIONLINE_HAlpha);
+  }
+};
+
+/**
+ * @brief Timing test for the EmissivityCalculator.
+ *
+ * The emissivities are computed for a set of cells with a random temperature
+ * in the range [5000, 15000] K and random ionic fractions.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeEmissivityCalculator", argc, argv);
+
+  const uint_fast32_t numcell = 100000;
+
+  RandomGenerator random_generator(42);
+  std::vector< IonizationVariables > ionization_variables(numcell);
+  for (uint_fast32_t i = 0; i < numcell; ++i) {
+    ionization_variables[i].set_number_density(1.e8);
+    ionization_variables[i].set_temperature(
+        5000. + 10000. * random_generator.get_uniform_random_double());
+    for (int_fast32_t j = 0; j < NUMBER_OF_IONNAMES; ++j) {
+      ionization_variables[i].set_ionic_fraction(
+          static_cast< IonName >(j),
+          random_generator.get_uniform_random_double());
+    }
+  }
+
+  Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
+  LineCoolingData lines;
+  EmissivityCalculator calculator(abundances);
+  std::vector< double > total_emissivity(MAX_NUM_THREADS, 0.);
+  EmissivityFunction compute_emissivities(calculator, abundances, lines,
+                                          ionization_variables,
+                                          total_emissivity);
+
+  timingtools_print_header("EmissivityCalculator (%" PRIuFAST32 " cells).",
+                           numcell);
+
+  timingtools_start_timing_block("emissivity calculation") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < numcell; ++i) {
+      compute_emissivities(0, i);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("emissivity calculation", numcell,
+                                    "cells");
+
+  timingtools_start_scaling_block("emissivity calculation") {
+    timingtools_start_timing();
+    parallel_loop(numcell, compute_emissivities, 1000);
+    timingtools_stop_timing();
+  }
+  timingtools_end_scaling_block_rate("emissivity calculation",
+                                     "timeEmissivityCalculator_scaling.txt",
+                                     numcell, "cells");
+
+  double total = 0.;
+  for (int_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
+    total += total_emissivity[i];
+  }
+  timingtools_print("Total H-alpha emissivity: %g", total);
+
+  return 0;
+}
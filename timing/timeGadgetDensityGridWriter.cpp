@@ -0,0 +1,89 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file timeGadgetDensityGridWriter.cpp
+ *
+ * @brief Timing test for the GadgetDensityGridWriter.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "CartesianDensityGrid.hpp"
+#include "GadgetDensityGridWriter.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "ParameterFile.hpp"
+#include "TimingTools.hpp"
+
+#include <cstdio>
+
+/**
+ * @brief Timing test for the GadgetDensityGridWriter.
+ *
+ * We time both a synchronous snapshot write and the time spent in write() when
+ * the snapshot is written asynchronously (i.e. the time the simulation is
+ * blocked by the output). Snapshot output is serial I/O, so no scaling test is
+ * performed.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeGadgetDensityGridWriter", argc, argv);
+
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+  HomogeneousDensityFunction density_function;
+  density_function.initialize();
+  CartesianDensityGrid grid(box, 64);
+  std::pair< cellsize_t, cellsize_t > block =
+      std::make_pair(0, grid.get_number_of_cells());
+  grid.initialize(block, density_function);
+  const uint_fast32_t number_of_cells = grid.get_number_of_cells();
+
+  ParameterFile params;
+
+  timingtools_print_header("GadgetDensityGridWriter (%" PRIuFAST32 " cells).",
+                           number_of_cells);
+
+  GadgetDensityGridWriter writer("timeGadgetDensityGridWriter", ".");
+  timingtools_start_timing_block("synchronous write") {
+    timingtools_start_timing();
+    writer.write(grid, 0, params);
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("synchronous write", number_of_cells,
+                                    "cells");
+
+  GadgetDensityGridWriter async_writer("timeGadgetDensityGridWriter_async", ".",
+                                       nullptr, 3, 1);
+  timingtools_start_timing_block("asynchronous write") {
+    timingtools_start_timing();
+    async_writer.write(grid, 0, params);
+    timingtools_stop_timing();
+    async_writer.flush();
+  }
+  timingtools_end_timing_block_rate("asynchronous write", number_of_cells,
+                                    "cells");
+
+  std::remove("timeGadgetDensityGridWriter000.hdf5");
+  std::remove("timeGadgetDensityGridWriter_async000.hdf5");
+
+  return 0;
+}
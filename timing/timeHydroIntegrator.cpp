@@ -0,0 +1,112 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file timeHydroIntegrator.cpp
+ *
+ * @brief Timing test for the HydroIntegrator.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "CartesianDensityGrid.hpp"
+#include "DensityFunction.hpp"
+#include "HydroIntegrator.hpp"
+#include "PhysicalConstants.hpp"
+#include "Timer.hpp"
+#include "TimingTools.hpp"
+
+/**
+ * @brief DensityFunction implementation that sets up a basic Sod shock problem.
+ */
+class SodShockDensityFunction : public DensityFunction {
+public:
+  /**
+   * @brief Function that gives the density for a given cell.
+   *
+   * @param cell Geometrical information about the cell.
+   * @return Initial physical field values for that cell.
+   */
+  virtual DensityValues operator()(const Cell &cell) const {
+    const CoordinateVector<> position = cell.get_cell_midpoint();
+    const double hydrogen_mass =
+        PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_PROTON_MASS);
+    const double boltzmann_k =
+        PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_BOLTZMANN);
+    const double density_unit = 1. / hydrogen_mass;
+    const double temperature_unit = hydrogen_mass / boltzmann_k;
+    DensityValues values;
+    if (position.x() < 0.5) {
+      values.set_number_density(density_unit);
+      values.set_temperature(temperature_unit);
+    } else {
+      values.set_number_density(0.125 * density_unit);
+      values.set_temperature(0.8 * temperature_unit);
+    }
+    return values;
+  }
+};
+
+/**
+ * @brief Timing test for the HydroIntegrator.
+ *
+ * Every sample sets up a 3D Sod shock on a Cartesian grid and evolves it for a
+ * fixed number of time steps.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeHydroIntegrator", argc, argv);
+
+  const uint_fast32_t numstep = 10;
+
+  HydroIntegrator integrator(5. / 3., false, false);
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+  const CoordinateVector< int_fast32_t > ncell(32);
+  SodShockDensityFunction density_function;
+  density_function.initialize();
+  CartesianDensityGrid grid(box, ncell, CoordinateVector< bool >(false), true);
+  std::pair< cellsize_t, cellsize_t > block =
+      std::make_pair(0, grid.get_number_of_cells());
+  grid.initialize(block, density_function);
+  const uint_fast32_t number_of_cells = grid.get_number_of_cells();
+
+  timingtools_print_header("HydroIntegrator (%" PRIuFAST32
+                           " cells, %" PRIuFAST32 " steps).",
+                           number_of_cells, numstep);
+
+  timingtools_start_scaling_block("hydro step") {
+    grid.set_densities(block, density_function);
+    integrator.initialize_hydro_variables(grid);
+    Timer serial_timer, parallel_timer;
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < numstep; ++i) {
+      integrator.do_hydro_step(grid, 0.001, serial_timer, parallel_timer);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_scaling_block_rate("hydro step",
+                                     "timeHydroIntegrator_scaling.txt",
+                                     number_of_cells * numstep,
+                                     "cell updates");
+
+  return 0;
+}
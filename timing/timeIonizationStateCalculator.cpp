@@ -0,0 +1,117 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file timeIonizationStateCalculator.cpp
+ *
+ * @brief Timing test for the IonizationStateCalculator.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Abundances.hpp"
+#include "CartesianDensityGrid.hpp"
+#include "ChargeTransferRates.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "IonizationStateCalculator.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+#include "VernerRecombinationRates.hpp"
+
+#include <cmath>
+
+/**
+ * @brief Timing test for the IonizationStateCalculator.
+ *
+ * Every cell of a homogeneous grid gets a random hydrogen photoionization rate
+ * in the range [1e-13, 1e-7] s^-1 (the rates for the other ions are scaled
+ * versions of it), after which the ionization state of all cells is computed.
+ * The input of the calculation is not changed by the calculation, so that
+ * every sample performs exactly the same computation.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeIonizationStateCalculator", argc, argv);
+
+  VernerRecombinationRates rates;
+  ChargeTransferRates ctr;
+  Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
+  IonizationStateCalculator calculator(1., abundances, rates, ctr);
+
+  HomogeneousDensityFunction function(1.e8);
+  function.initialize();
+  const Box<> box(CoordinateVector<>(), CoordinateVector<>(1.));
+  CartesianDensityGrid grid(box, 32);
+  std::pair< cellsize_t, cellsize_t > block =
+      std::make_pair(0, grid.get_number_of_cells());
+  grid.initialize(block, function);
+  const uint_fast32_t number_of_cells = grid.get_number_of_cells();
+
+  RandomGenerator random_generator(42);
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    const double jH =
+        std::pow(10., -13. + 6. * random_generator.get_uniform_random_double());
+    IonizationVariablesReference ionization_variables =
+        it.get_ionization_variables();
+    ionization_variables.set_mean_intensity(ION_H_n, jH);
+    for (int_fast32_t i = 1; i < NUMBER_OF_IONNAMES; ++i) {
+      ionization_variables.set_mean_intensity(static_cast< IonName >(i),
+                                              0.1 * jH);
+    }
+  }
+
+  timingtools_print_header("IonizationStateCalculator (%" PRIuFAST32
+                           " cells).",
+                           number_of_cells);
+
+  // with a unit luminosity, a total weight equal to the inverse cell volume
+  // makes sure the mean intensities are used as is
+  const double cell_volume = grid.begin().get_volume();
+  timingtools_start_timing_block("ionization state calculation") {
+    timingtools_start_timing();
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      calculator.calculate_ionization_state(1., it);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("ionization state calculation",
+                                    number_of_cells, "cells");
+
+  timingtools_start_scaling_block("grid ionization state calculation") {
+    timingtools_start_timing();
+    calculator.calculate_ionization_state(1. / cell_volume, grid, block);
+    timingtools_stop_timing();
+  }
+  timingtools_end_scaling_block_rate(
+      "grid ionization state calculation",
+      "timeIonizationStateCalculator_scaling.txt", number_of_cells, "cells");
+
+  double average_neutral_fraction = 0.;
+  for (auto it = grid.begin(); it != grid.end(); ++it) {
+    average_neutral_fraction +=
+        it.get_ionization_variables().get_ionic_fraction(ION_H_n);
+  }
+  timingtools_print("Average neutral fraction: %g",
+                    average_neutral_fraction / number_of_cells);
+
+  return 0;
+}
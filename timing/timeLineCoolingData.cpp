@@ -0,0 +1,225 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file timeLineCoolingData.cpp
+ *
+ * @brief Timing test for the line cooling computation, with and without
+ * tabulated collision rate coefficients.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "LineCoolingData.hpp"
+#include "LineCoolingTable.hpp"
+#include "ParallelLoopJobMarket.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Functor that computes the line cooling for a single sample.
+ *
+ * @tparam _cooling_ Object that computes the line cooling (LineCoolingData or
+ * LineCoolingTable).
+ */
+template < typename _cooling_ > class LineCoolingFunction {
+private:
+  /*! @brief Object that computes the line cooling. */
+  const _cooling_ &_cooling;
+
+  /*! @brief Temperatures (in K). */
+  const std::vector< double > &_temperatures;
+
+  /*! @brief Electron densities (in m^-3). */
+  const std::vector< double > &_electron_densities;
+
+  /*! @brief Coolant abundances. */
+  const std::vector< double > &_abundances;
+
+  /*! @brief Per thread total cooling (prevents the compiler from optimizing
+   *  away the computation). */
+  std::vector< double > &_total_cooling;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param cooling Object that computes the line cooling.
+   * @param temperatures Temperatures (in K).
+   * @param electron_densities Electron densities (in m^-3).
+   * @param abundances Coolant abundances (LINECOOLINGDATA_NUMELEMENTS values
+   * per sample).
+   * @param total_cooling Per thread total cooling.
+   */
+  inline LineCoolingFunction(const _cooling_ &cooling,
+                             const std::vector< double > &temperatures,
+                             const std::vector< double > &electron_densities,
+                             const std::vector< double > &abundances,
+                             std::vector< double > &total_cooling)
+      : _cooling(cooling), _temperatures(temperatures),
+        _electron_densities(electron_densities), _abundances(abundances),
+        _total_cooling(total_cooling) {}
+
+  /**
+   * @brief Compute the line cooling for the sample with the given index.
+   *
+   * @param thread_id Rank of the thread that executes the function.
+   * @param index Index of the sample.
+   */
+  inline void operator()(const int_fast32_t thread_id,
+                         const uint_fast64_t index) {
+    _total_cooling[thread_id] += _cooling.get_cooling(
+        _temperatures[index], _electron_densities[index],
+        &_abundances[index * LINECOOLINGDATA_NUMELEMENTS]);
+  }
+};
+
+/**
+ * @brief Timing test for the line cooling computation, with and without
+ * tabulated collision rate coefficients.
+ *
+ * The line cooling is computed for a set of random temperatures in the range
+ * [1e3, 1e5] K, electron densities in the range [1e6, 1e10] m^-3 and coolant
+ * abundances in the range [0, 1e-4].
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeLineCoolingData", argc, argv);
+
+  const uint_fast32_t numsample = 100000;
+
+  RandomGenerator random_generator(42);
+  std::vector< double > temperatures(numsample);
+  std::vector< double > electron_densities(numsample);
+  std::vector< double > abundances(numsample * LINECOOLINGDATA_NUMELEMENTS);
+  for (uint_fast32_t i = 0; i < numsample; ++i) {
+    temperatures[i] =
+        std::pow(10., 3. + 2. * random_generator.get_uniform_random_double());
+    electron_densities[i] =
+        std::pow(10., 6. + 4. * random_generator.get_uniform_random_double());
+    for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMELEMENTS; ++j) {
+      abundances[i * LINECOOLINGDATA_NUMELEMENTS + j] =
+          1.e-4 * random_generator.get_uniform_random_double();
+    }
+  }
+
+  LineCoolingData data;
+  LineCoolingTable table(data);
+  std::vector< double > direct_cooling(MAX_NUM_THREADS, 0.);
+  std::vector< double > tabulated_cooling(MAX_NUM_THREADS, 0.);
+  LineCoolingFunction< LineCoolingData > direct_function(
+      data, temperatures, electron_densities, abundances, direct_cooling);
+  LineCoolingFunction< LineCoolingTable > tabulated_function(
+      table, temperatures, electron_densities, abundances, tabulated_cooling);
+
+  timingtools_print_header("LineCoolingData (%" PRIuFAST32 " samples).",
+                           numsample);
+
+  timingtools_start_timing_block("direct line cooling") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < numsample; ++i) {
+      direct_function(0, i);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("direct line cooling", numsample,
+                                    "samples");
+
+  timingtools_start_timing_block("tabulated line cooling") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < numsample; ++i) {
+      tabulated_function(0, i);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("tabulated line cooling", numsample,
+                                    "samples");
+
+  // the derivative of the cooling w.r.t. log T is used by the Newton-Raphson
+  // temperature solver
+  // we use separate accumulators to not affect the comparison below
+  double total_derivative_cooling = 0.;
+  double total_dcooling = 0.;
+  timingtools_start_timing_block("direct line cooling with derivative") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < numsample; ++i) {
+      double dcooling;
+      total_derivative_cooling += data.get_cooling(
+          temperatures[i], electron_densities[i],
+          &abundances[i * LINECOOLINGDATA_NUMELEMENTS], dcooling);
+      total_dcooling += dcooling;
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("direct line cooling with derivative",
+                                    numsample, "samples");
+
+  timingtools_start_timing_block("tabulated line cooling with derivative") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < numsample; ++i) {
+      double dcooling;
+      total_derivative_cooling += table.get_cooling(
+          temperatures[i], electron_densities[i],
+          &abundances[i * LINECOOLINGDATA_NUMELEMENTS], dcooling);
+      total_dcooling += dcooling;
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("tabulated line cooling with derivative",
+                                    numsample, "samples");
+
+  timingtools_start_scaling_block("direct line cooling") {
+    timingtools_start_timing();
+    parallel_loop(numsample, direct_function, 1000);
+    timingtools_stop_timing();
+  }
+  timingtools_end_scaling_block_rate("direct line cooling",
+                                     "timeLineCoolingData_scaling_direct.txt",
+                                     numsample, "samples");
+
+  timingtools_start_scaling_block("tabulated line cooling") {
+    timingtools_start_timing();
+    parallel_loop(numsample, tabulated_function, 1000);
+    timingtools_stop_timing();
+  }
+  timingtools_end_scaling_block_rate(
+      "tabulated line cooling", "timeLineCoolingData_scaling_tabulated.txt",
+      numsample, "samples");
+
+  double total_direct_cooling = 0.;
+  double total_tabulated_cooling = 0.;
+  for (int_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
+    total_direct_cooling += direct_cooling[i];
+    total_tabulated_cooling += tabulated_cooling[i];
+  }
+  timingtools_print("Relative difference between tabulated and direct "
+                    "cooling: %g",
+                    std::abs(total_tabulated_cooling - total_direct_cooling) /
+                        total_direct_cooling);
+  timingtools_print("Total cooling: %g, total cooling derivative: %g",
+                    total_derivative_cooling, total_dcooling);
+
+  return 0;
+}
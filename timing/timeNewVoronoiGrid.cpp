@@ -99,5 +99,78 @@ int main(int argc, char **argv) {
     timingtools_end_timing_block("NewVoronoiGrid");
   }
 
+  /// Test 3: incremental update after generator movement
+  {
+    timingtools_print_header("Incremental update test.");
+
+    const uint_fast32_t numpositions = 10000;
+
+    std::vector< CoordinateVector<> > positions(numpositions);
+    for (uint_fast32_t i = 0; i < numpositions; ++i) {
+      positions[i] = Utilities::random_position();
+    }
+    const std::vector< CoordinateVector<> > original_positions = positions;
+    // displacements of 5% of the average generator spacing
+    const double dmax = 0.05 / std::cbrt(numpositions);
+    std::vector< CoordinateVector<> > displacements(numpositions);
+    for (uint_fast32_t i = 0; i < numpositions; ++i) {
+      displacements[i] = CoordinateVector<>(
+          dmax * (2. * Utilities::random_double() - 1.),
+          dmax * (2. * Utilities::random_double() - 1.),
+          dmax * (2. * Utilities::random_double() - 1.));
+    }
+
+    Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+
+    // move all generators that are in the given region
+    auto move_generators = [&positions, &original_positions, &displacements](
+        const double xmax) {
+      for (uint_fast32_t i = 0; i < positions.size(); ++i) {
+        positions[i] = original_positions[i];
+        if (positions[i].x() < xmax) {
+          positions[i] += displacements[i];
+          for (uint_fast8_t j = 0; j < 3; ++j) {
+            positions[i][j] = std::max(1.e-3, std::min(0.999, positions[i][j]));
+          }
+        }
+      }
+    };
+
+    timingtools_start_timing_block("NewVoronoiGrid full construction") {
+      positions = original_positions;
+      move_generators(1.);
+      NewVoronoiGrid grid(positions, box);
+
+      timingtools_start_timing();
+      grid.compute_grid(1);
+      timingtools_stop_timing();
+    }
+    timingtools_end_timing_block("NewVoronoiGrid full construction");
+
+    timingtools_start_timing_block("NewVoronoiGrid update (all moved)") {
+      positions = original_positions;
+      NewVoronoiGrid grid(positions, box);
+      grid.compute_grid(1);
+      move_generators(1.);
+
+      timingtools_start_timing();
+      grid.update_grid(1);
+      timingtools_stop_timing();
+    }
+    timingtools_end_timing_block("NewVoronoiGrid update (all moved)");
+
+    timingtools_start_timing_block("NewVoronoiGrid update (10% moved)") {
+      positions = original_positions;
+      NewVoronoiGrid grid(positions, box);
+      grid.compute_grid(1);
+      move_generators(0.1);
+
+      timingtools_start_timing();
+      grid.update_grid(1);
+      timingtools_stop_timing();
+    }
+    timingtools_end_timing_block("NewVoronoiGrid update (10% moved)");
+  }
+
   return 0;
 }
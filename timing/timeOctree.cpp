@@ -0,0 +1,172 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file timeOctree.cpp
+ *
+ * @brief Timing test for the construction of and neighbour searches in the
+ * LinearOctree.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "LinearOctree.hpp"
+#include "ParallelLoopJobMarket.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+
+#include <vector>
+
+/**
+ * @brief Functor that finds the neighbours of a single position.
+ */
+class NeighbourSearchFunction {
+private:
+  /*! @brief LinearOctree to query. */
+  const LinearOctree &_octree;
+
+  /*! @brief Positions for which to find neighbours (in m). */
+  const std::vector< CoordinateVector<> > &_positions;
+
+  /*! @brief Per thread total number of neighbours found (prevents the
+   *  compiler from optimizing away the searches). */
+  std::vector< uint_fast64_t > &_number_of_neighbours;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param octree LinearOctree to query.
+   * @param positions Positions for which to find neighbours (in m).
+   * @param number_of_neighbours Per thread total number of neighbours found.
+   */
+  inline NeighbourSearchFunction(
+      const LinearOctree &octree,
+      const std::vector< CoordinateVector<> > &positions,
+      std::vector< uint_fast64_t > &number_of_neighbours)
+      : _octree(octree), _positions(positions),
+        _number_of_neighbours(number_of_neighbours) {}
+
+  /**
+   * @brief Find the neighbours of the position with the given index.
+   *
+   * @param thread_id Rank of the thread that executes the function.
+   * @param index Index of the position.
+   */
+  inline void operator()(const int_fast32_t thread_id,
+                         const uint_fast64_t index) {
+    uint_fast64_t number_of_neighbours = 0;
+    _octree.for_each_ngb(_positions[index],
+                         [&number_of_neighbours](const uint_fast32_t) {
+                           ++number_of_neighbours;
+                         });
+    _number_of_neighbours[thread_id] += number_of_neighbours;
+  }
+};
+
+/**
+ * @brief Timing test for the construction of and neighbour searches in the
+ * LinearOctree.
+ *
+ * The neighbour search finds all positions whose smoothing sphere contains
+ * the given position, with smoothing lengths chosen so that every position has
+ * roughly 50 neighbours. Neighbours are only searched for a subset of the
+ * positions, since the search is relatively expensive.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeOctree", argc, argv);
+
+  const uint_fast32_t numpos = 100000;
+  const uint_fast32_t numquery = 10000;
+  const uint_fast32_t numngb = 50;
+
+  RandomGenerator random_generator(42);
+  std::vector< CoordinateVector<> > positions(numpos);
+  for (uint_fast32_t i = 0; i < numpos; ++i) {
+    positions[i][0] = random_generator.get_uniform_random_double();
+    positions[i][1] = random_generator.get_uniform_random_double();
+    positions[i][2] = random_generator.get_uniform_random_double();
+  }
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+  const double h = std::cbrt(0.75 * numngb / (M_PI * numpos));
+  std::vector< double > smoothing_lengths(numpos, h);
+
+  timingtools_print_header("LinearOctree (%" PRIuFAST32 " positions).",
+                           numpos);
+
+  timingtools_start_timing_block("LinearOctree construction") {
+    timingtools_start_timing();
+    LinearOctree octree(positions, box);
+    octree.set_auxiliaries(smoothing_lengths, LinearOctree::max< double >);
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("LinearOctree construction", numpos,
+                                    "positions");
+
+  // the key sorting and sub tree construction are done in parallel
+  timingtools_start_scaling_block("LinearOctree construction") {
+    timingtools_start_timing();
+    LinearOctree octree(positions, box);
+    octree.set_auxiliaries(smoothing_lengths, LinearOctree::max< double >);
+    timingtools_stop_timing();
+  }
+  timingtools_end_scaling_block_rate("LinearOctree construction",
+                                     "timeOctree_construction_scaling.txt",
+                                     numpos, "positions");
+
+  LinearOctree octree(positions, box);
+  octree.set_auxiliaries(smoothing_lengths, LinearOctree::max< double >);
+  std::vector< uint_fast64_t > number_of_neighbours(MAX_NUM_THREADS, 0);
+  NeighbourSearchFunction find_neighbours(octree, positions,
+                                          number_of_neighbours);
+
+  timingtools_start_timing_block("LinearOctree neighbour search") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < numquery; ++i) {
+      find_neighbours(0, i);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("LinearOctree neighbour search", numquery,
+                                    "queries");
+
+  timingtools_start_scaling_block("LinearOctree neighbour search") {
+    timingtools_start_timing();
+    parallel_loop(numquery, find_neighbours, 100);
+    timingtools_stop_timing();
+  }
+  timingtools_end_scaling_block_rate("LinearOctree neighbour search",
+                                     "timeOctree_scaling.txt", numquery,
+                                     "queries");
+
+  uint_fast64_t total_number_of_neighbours = 0;
+  for (int_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
+    total_number_of_neighbours += number_of_neighbours[i];
+  }
+  timingtools_print("Average number of neighbours: %g",
+                    total_number_of_neighbours /
+                        double(numquery * (timingtools_num_sample *
+                                             (1 + timingtools_num_threads))));
+
+  return 0;
+}
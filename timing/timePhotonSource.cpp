@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file timePhotonSource.cpp
+ *
+ * @brief Timing test for the generation of photon packets by the
+ * PhotonSource.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Abundances.hpp"
+#include "ParallelLoopJobMarket.hpp"
+#include "PhotonPacketBatch.hpp"
+#include "PhotonSource.hpp"
+#include "PlanckPhotonSourceSpectrum.hpp"
+#include "SingleStarPhotonSourceDistribution.hpp"
+#include "TimingTools.hpp"
+#include "VernerCrossSections.hpp"
+
+#include <vector>
+
+/**
+ * @brief Functor that generates a single photon packet.
+ */
+class PhotonGenerationFunction {
+private:
+  /*! @brief PhotonSource to use. */
+  const PhotonSource &_source;
+
+  /*! @brief Per thread RandomGenerator. */
+  std::vector< RandomGenerator > &_random_generators;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param source PhotonSource to use.
+   * @param random_generators Per thread RandomGenerator.
+   */
+  inline PhotonGenerationFunction(
+      const PhotonSource &source,
+      std::vector< RandomGenerator > &random_generators)
+      : _source(source), _random_generators(random_generators) {}
+
+  /**
+   * @brief Generate a single photon packet.
+   *
+   * @param thread_id Rank of the thread that executes the function.
+   * @param index Index of the photon packet (not used).
+   */
+  inline void operator()(const int_fast32_t thread_id,
+                         const uint_fast64_t index) {
+    _source.get_random_photon(_random_generators[thread_id]);
+  }
+};
+
+/**
+ * @brief Timing test for the generation of photon packets by the
+ * PhotonSource.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timePhotonSource", argc, argv);
+
+  const uint_fast32_t numphoton = 100000;
+
+  SingleStarPhotonSourceDistribution distribution(
+      CoordinateVector<>(0.5, 0.5, 0.5), 4.26e49);
+  PlanckPhotonSourceSpectrum spectrum(40000.);
+  VernerCrossSections cross_sections;
+  Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
+  PhotonSource source(&distribution, &spectrum, nullptr, nullptr, abundances,
+                      cross_sections, false);
+
+  std::vector< RandomGenerator > random_generators;
+  for (int_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
+    random_generators.push_back(RandomGenerator(42 + i));
+  }
+
+  timingtools_print_header("Photon packet generation (%" PRIuFAST32
+                           " photons).",
+                           numphoton);
+
+  timingtools_start_timing_block("get_random_photon") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < numphoton; ++i) {
+      source.get_random_photon(random_generators[0]);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("get_random_photon", numphoton, "photons");
+
+  timingtools_start_timing_block("get_random_photons") {
+    PhotonPacketBatch batch;
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < numphoton / PHOTONPACKETBATCH_SIZE; ++i) {
+      source.get_random_photons(random_generators[0], batch,
+                                PHOTONPACKETBATCH_SIZE);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate(
+      "get_random_photons",
+      (numphoton / PHOTONPACKETBATCH_SIZE) * PHOTONPACKETBATCH_SIZE,
+      "photons");
+
+  PhotonGenerationFunction generate_photon(source, random_generators);
+  timingtools_start_scaling_block("get_random_photon") {
+    timingtools_start_timing();
+    parallel_loop(numphoton, generate_photon, 1000);
+    timingtools_stop_timing();
+  }
+  timingtools_end_scaling_block_rate("get_random_photon",
+                                     "timePhotonSource_scaling.txt", numphoton,
+                                     "photons");
+
+  return 0;
+}
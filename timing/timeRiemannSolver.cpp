@@ -50,17 +50,62 @@ int main(int argc, char **argv) {
     P[i] = 0.1 + Utilities::random_double() * 0.9;
   }
 
+  std::vector< double > rhoR(num_test), uR(num_test), PR(num_test);
+  for (uint_fast32_t i = 0; i < num_test; ++i) {
+    const uint_fast32_t iplus = (i + 1) % num_test;
+    rhoR[i] = rho[iplus];
+    uR[i] = u[iplus];
+    PR[i] = P[iplus];
+  }
+  std::vector< double > rhosol(num_test), usol(num_test), Psol(num_test);
+
   RiemannSolver solver(5. / 3.);
-  double rhosol, usol, Psol;
 
   timingtools_start_timing_block("RiemannSolver") {
     timingtools_start_timing();
     for (uint_fast32_t i = 0; i < num_test; ++i) {
-      const uint_fast32_t iplus = (i + 1) % num_test;
-      solver.solve(rho[i], u[i], P[i], rho[iplus], u[iplus], P[iplus], rhosol,
-                   usol, Psol);
+      solver.solve(rho[i], u[i], P[i], rhoR[i], uR[i], PR[i], rhosol[i],
+                   usol[i], Psol[i]);
     }
     timingtools_stop_timing();
   }
-  timingtools_end_timing_block("RiemannSolver");
+  timingtools_end_timing_block_rate("RiemannSolver", num_test, "interfaces");
+
+  timingtools_start_timing_block("RiemannSolver batch") {
+    timingtools_start_timing();
+    solver.solve_batch(num_test, &rho[0], &u[0], &P[0], &rhoR[0], &uR[0],
+                       &PR[0], &rhosol[0], &usol[0], &Psol[0]);
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("RiemannSolver batch", num_test,
+                                    "interfaces");
+
+  // states with small jumps, for which the HLLC fast path is used
+  for (uint_fast32_t i = 0; i < num_test; ++i) {
+    rhoR[i] = rho[i] * (0.99 + 0.02 * Utilities::random_double());
+    uR[i] = u[i] + 0.02 * Utilities::random_double() - 0.01;
+    PR[i] = P[i] * (0.99 + 0.02 * Utilities::random_double());
+  }
+
+  timingtools_start_timing_block("RiemannSolver small jumps") {
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_test; ++i) {
+      solver.solve(rho[i], u[i], P[i], rhoR[i], uR[i], PR[i], rhosol[i],
+                   usol[i], Psol[i]);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("RiemannSolver small jumps", num_test,
+                                    "interfaces");
+
+  timingtools_start_timing_block("RiemannSolver batch HLLC") {
+    timingtools_start_timing();
+    solver.solve_batch(num_test, &rho[0], &u[0], &P[0], &rhoR[0], &uR[0],
+                       &PR[0], &rhosol[0], &usol[0], &Psol[0], nullptr, 2.);
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("RiemannSolver batch HLLC", num_test,
+                                    "interfaces");
+
+  return 0;
 }
@@ -0,0 +1,169 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeSPHGridDeposition.cpp
+ *
+ * @brief Timing test that compares particle deposition with SPHGridDeposition
+ * with the cell midpoint sampling used by the SPH density functions.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "CartesianDensityGrid.hpp"
+#include "CubicSplineKernel.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "LinearOctree.hpp"
+#include "SPHGridDeposition.hpp"
+#include "TimingTools.hpp"
+#include "Utilities.hpp"
+
+#include <sstream>
+
+/**
+ * @brief Sample the SPH density at the midpoint of every cell of the given
+ * grid, like GadgetSnapshotDensityFunction does.
+ *
+ * @param grid DensityGrid.
+ * @param octree LinearOctree containing the particles.
+ * @param positions Positions of the particles (in m).
+ * @param smoothing_lengths Smoothing lengths of the particles (in m).
+ * @param masses Masses of the particles (in kg).
+ * @param densities Output densities for all cells (in kg m^-3).
+ */
+void sample_midpoints(const DensityGrid &grid, const LinearOctree &octree,
+                      const std::vector< CoordinateVector<> > &positions,
+                      const std::vector< double > &smoothing_lengths,
+                      const std::vector< double > &masses,
+                      std::vector< double > &densities) {
+
+  const cellsize_t numcell = grid.get_number_of_cells();
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for (cellsize_t i = 0; i < numcell; ++i) {
+    const CoordinateVector<> midpoint = grid.get_cell_midpoint(i);
+    double density = 0.;
+    octree.for_each_ngb(midpoint, [&positions, &smoothing_lengths, &masses,
+                                   &midpoint,
+                                   &density](const uint_fast32_t index) {
+      const double h = smoothing_lengths[index];
+      const double u = (midpoint - positions[index]).norm() / h;
+      density += masses[index] * CubicSplineKernel::kernel_evaluate(u, h);
+    });
+    densities[i] = density;
+  }
+}
+
+/**
+ * @brief Timing test that compares particle deposition with SPHGridDeposition
+ * with the cell midpoint sampling used by the SPH density functions.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeSPHGridDeposition", argc, argv);
+
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+
+  HomogeneousDensityFunction density_function;
+  density_function.initialize();
+
+  // we test two sets of random particles: particles that are mostly smaller
+  // than the cells of the finest grid, and particles that cover many cells of
+  // the finest grid
+  const double minimum_smoothing_length[2] = {0.005, 0.02};
+  const double maximum_smoothing_length[2] = {0.025, 0.06};
+  const std::string set_name[2] = {"small particles", "large particles"};
+  const uint_fast32_t numpart = 100000;
+  for (uint_fast8_t iset = 0; iset < 2; ++iset) {
+    std::vector< CoordinateVector<> > positions(numpart);
+    std::vector< double > smoothing_lengths(numpart);
+    std::vector< std::vector< double > > masses(
+        1, std::vector< double >(numpart, 1. / numpart));
+    for (uint_fast32_t i = 0; i < numpart; ++i) {
+      positions[i] = Utilities::random_position();
+      smoothing_lengths[i] =
+          minimum_smoothing_length[iset] +
+          (maximum_smoothing_length[iset] - minimum_smoothing_length[iset]) *
+              Utilities::random_double();
+    }
+
+    LinearOctree octree(positions, box);
+    octree.set_auxiliaries(smoothing_lengths, LinearOctree::max< double >);
+
+    for (uint_fast32_t ncell = 32; ncell <= 128; ncell *= 2) {
+      timingtools_print_header("h in [%g, %g[, %" PRIuFAST32 "^3 cells",
+                               minimum_smoothing_length[iset],
+                               maximum_smoothing_length[iset], ncell);
+
+      CartesianDensityGrid grid(box, ncell);
+      std::pair< cellsize_t, cellsize_t > block =
+          std::make_pair(0, grid.get_number_of_cells());
+      grid.initialize(block, density_function);
+      const cellsize_t numcell = grid.get_number_of_cells();
+
+      std::vector< double > midpoint_densities(numcell);
+      std::stringstream midpoint_name;
+      midpoint_name << "midpoint sampling " << set_name[iset] << " " << ncell
+                    << "^3";
+      timingtools_start_timing_block(midpoint_name.str().c_str()) {
+        timingtools_start_timing();
+        sample_midpoints(grid, octree, positions, smoothing_lengths, masses[0],
+                         midpoint_densities);
+        timingtools_stop_timing();
+      }
+      timingtools_end_timing_block_rate(midpoint_name.str().c_str(), numcell,
+                                        "cells");
+
+      std::vector< std::vector< double > > deposited_masses;
+      std::stringstream deposition_name;
+      deposition_name << "deposition " << set_name[iset] << " " << ncell
+                      << "^3";
+      timingtools_start_timing_block(deposition_name.str().c_str()) {
+        timingtools_start_timing();
+        SPHGridDeposition::deposit(grid, positions, smoothing_lengths, masses,
+                                   CubicSplineKernel::kernel_evaluate, Box<>(),
+                                   deposited_masses);
+        timingtools_stop_timing();
+      }
+      timingtools_end_timing_block_rate(deposition_name.str().c_str(), numcell,
+                                        "cells");
+
+      // compare the two density fields
+      const double cell_volume = grid.get_cell_volume(0);
+      double midpoint_mass = 0.;
+      double deposited_mass = 0.;
+      double difference = 0.;
+      for (cellsize_t i = 0; i < numcell; ++i) {
+        midpoint_mass += midpoint_densities[i] * cell_volume;
+        deposited_mass += deposited_masses[0][i];
+        difference += std::abs(midpoint_densities[i] * cell_volume -
+                               deposited_masses[0][i]);
+      }
+      timingtools_print("Total mass: midpoint sampling: %g, deposition: %g, "
+                        "relative L1 difference: %g",
+                        midpoint_mass, deposited_mass,
+                        difference / deposited_mass);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file timeTabulatedRates.cpp
+ *
+ * @brief Timing test for the tabulated cross sections and recombination rates.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "TabulatedCrossSections.hpp"
+#include "TabulatedRecombinationRates.hpp"
+#include "TimingTools.hpp"
+#include "UnitConverter.hpp"
+#include "VernerCrossSections.hpp"
+#include "VernerRecombinationRates.hpp"
+
+#include <vector>
+
+/**
+ * @brief Timing test for the tabulated cross sections and recombination rates.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeTabulatedRates", argc, argv);
+
+  const uint_fast32_t num_test = 1000000;
+
+  // photon frequencies in the range [13.6 eV, 54.4 eV[
+  const double min_frequency =
+      UnitConverter::to_SI< QUANTITY_FREQUENCY >(13.6, "eV");
+  std::vector< double > frequencies(num_test);
+  for (uint_fast32_t i = 0; i < num_test; ++i) {
+    frequencies[i] = min_frequency * (1. + 3. * Utilities::random_double());
+  }
+  // temperatures in the range [500 K, 50,000 K[
+  std::vector< double > temperatures(num_test);
+  for (uint_fast32_t i = 0; i < num_test; ++i) {
+    temperatures[i] = 500. * std::pow(100., Utilities::random_double());
+  }
+  std::vector< double > results(num_test);
+
+  VernerCrossSections verner_cross_sections;
+  TabulatedCrossSections tabulated_cross_sections(
+      verner_cross_sections,
+      UnitConverter::to_SI< QUANTITY_FREQUENCY >(10., "eV"),
+      UnitConverter::to_SI< QUANTITY_FREQUENCY >(1000., "eV"), 1000);
+  timingtools_print("Tabulated cross sections maximum relative error: %g",
+                    tabulated_cross_sections.get_maximum_relative_error());
+
+  VernerRecombinationRates verner_recombination_rates;
+  TabulatedRecombinationRates tabulated_recombination_rates(
+      verner_recombination_rates, 10., 1.e9, 1000);
+  timingtools_print(
+      "Tabulated recombination rates maximum relative error: %g",
+      tabulated_recombination_rates.get_maximum_relative_error());
+
+  timingtools_start_timing_block("Verner cross sections") {
+    timingtools_start_timing();
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      verner_cross_sections.get_cross_sections(static_cast< IonName >(ion),
+                                               &frequencies[0], &results[0],
+                                               num_test);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("Verner cross sections",
+                                    num_test * NUMBER_OF_IONNAMES,
+                                    "cross sections");
+
+  timingtools_start_timing_block("Tabulated cross sections") {
+    timingtools_start_timing();
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      tabulated_cross_sections.get_cross_sections(static_cast< IonName >(ion),
+                                                  &frequencies[0],
+                                                  &results[0], num_test);
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("Tabulated cross sections",
+                                    num_test * NUMBER_OF_IONNAMES,
+                                    "cross sections");
+
+  timingtools_start_timing_block("Verner recombination rates") {
+    timingtools_start_timing();
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      for (uint_fast32_t i = 0; i < num_test; ++i) {
+        results[i] = verner_recombination_rates.get_recombination_rate(
+            static_cast< IonName >(ion), temperatures[i]);
+      }
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("Verner recombination rates",
+                                    num_test * NUMBER_OF_IONNAMES, "rates");
+
+  timingtools_start_timing_block("Tabulated recombination rates") {
+    timingtools_start_timing();
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      for (uint_fast32_t i = 0; i < num_test; ++i) {
+        results[i] = tabulated_recombination_rates.get_recombination_rate(
+            static_cast< IonName >(ion), temperatures[i]);
+      }
+    }
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block_rate("Tabulated recombination rates",
+                                    num_test * NUMBER_OF_IONNAMES, "rates");
+
+  return 0;
+}
@@ -0,0 +1,187 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+/**
+ * @file timeTemperatureCalculator.cpp
+ *
+ * @brief Timing test for the TemperatureCalculator, with and without
+ * tabulated line cooling, and for both temperature solvers.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "Abundances.hpp"
+#include "CartesianDensityGrid.hpp"
+#include "ChargeTransferRates.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "LineCoolingData.hpp"
+#include "PhysicalConstants.hpp"
+#include "TemperatureCalculator.hpp"
+#include "TimingTools.hpp"
+#include "UnitConverter.hpp"
+#include "VernerRecombinationRates.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Reset the given cell to the state in the given row of the
+ * TemperatureCalculator test data.
+ *
+ * @param row Row of the test data (mean intensities, heating terms, initial
+ * temperature and number density, in the units of the test data file).
+ * @param ionization_variables IonizationVariables of the cell.
+ * @param heating_factor Factor by which the heating terms are divided (to
+ * compensate for the normalization in the grid level calculation).
+ */
+inline void reset_cell(const std::vector< double > &row,
+                       IonizationVariablesReference ionization_variables,
+                       const double heating_factor = 1.) {
+
+  for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+    ionization_variables.set_mean_intensity(static_cast< IonName >(i), row[i]);
+  }
+  ionization_variables.set_heating(
+      HEATINGTERM_H, UnitConverter::to_SI< QUANTITY_ENERGY_RATE >(
+                         row[NUMBER_OF_IONNAMES], "erg s^-1") /
+                         heating_factor);
+  ionization_variables.set_heating(
+      HEATINGTERM_He, UnitConverter::to_SI< QUANTITY_ENERGY_RATE >(
+                          row[NUMBER_OF_IONNAMES + 1], "erg s^-1") /
+                          heating_factor);
+  ionization_variables.set_temperature(row[NUMBER_OF_IONNAMES + 2]);
+  ionization_variables.set_number_density(
+      UnitConverter::to_SI< QUANTITY_NUMBER_DENSITY >(
+          row[NUMBER_OF_IONNAMES + 3], "cm^-3"));
+}
+
+/**
+ * @brief Timing test for the TemperatureCalculator, with and without
+ * tabulated line cooling, and for both temperature solvers.
+ *
+ * Every cell of a small grid is set to the state of one of the cells in the
+ * TemperatureCalculator unit test data, after which the temperature of all
+ * cells is computed. For a warm start, the temperature is computed once before
+ * the timing starts, so that the timed computation starts from the converged
+ * temperatures (as would be the case in later iterations of the
+ * photoionization algorithm).
+ *
+ * Finally, the parallel scaling of the grid level temperature calculation is
+ * measured for the default solver configuration.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeTemperatureCalculator", argc, argv);
+
+  std::vector< std::vector< double > > rows;
+  std::ifstream file("tbal_testdata.txt");
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream linestream(line);
+    std::vector< double > row(NUMBER_OF_IONNAMES + 4);
+    for (uint_fast32_t i = 0; i < row.size(); ++i) {
+      linestream >> row[i];
+    }
+    rows.push_back(row);
+  }
+  if (rows.empty()) {
+    cmac_error("Could not read tbal_testdata.txt!");
+  }
+
+  LineCoolingData data;
+  VernerRecombinationRates rates;
+  ChargeTransferRates ctr;
+  Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
+
+  HomogeneousDensityFunction function(1.);
+  function.initialize();
+  const Box<> box(CoordinateVector<>(), CoordinateVector<>(1.));
+  CartesianDensityGrid grid(box, 16);
+  std::pair< cellsize_t, cellsize_t > block =
+      std::make_pair(0, grid.get_number_of_cells());
+  grid.initialize(block, function);
+  const uint_fast32_t number_of_cells = grid.get_number_of_cells();
+
+  for (uint_fast32_t i = 0; i < 8; ++i) {
+    const bool tabulated_cooling = (i & 1);
+    const bool newton_raphson = (i & 2);
+    const bool warm_start = (i & 4);
+    std::string name = newton_raphson ? "Newton-Raphson" : "secant";
+    name += tabulated_cooling ? ", tabulated line cooling"
+                              : ", direct line cooling";
+    name += warm_start ? ", warm start" : ", cold start";
+    TemperatureCalculator calculator(true, 3, 1., abundances, 1.e-3, 100, 1.,
+                                     0., 1., 0., data, rates, ctr,
+                                     tabulated_cooling, newton_raphson);
+
+    uint_fast64_t number_of_iterations = 0;
+    timingtools_start_timing_block(name.c_str()) {
+      uint_fast32_t index = 0;
+      for (auto it = grid.begin(); it != grid.end(); ++it) {
+        reset_cell(rows[index % rows.size()], it.get_ionization_variables());
+        ++index;
+      }
+      if (warm_start) {
+        for (auto it = grid.begin(); it != grid.end(); ++it) {
+          calculator.calculate_temperature(1., 1., it);
+        }
+      }
+      number_of_iterations = 0;
+      timingtools_start_timing();
+      for (auto it = grid.begin(); it != grid.end(); ++it) {
+        number_of_iterations += calculator.calculate_temperature(1., 1., it);
+      }
+      timingtools_stop_timing();
+    }
+    timingtools_end_timing_block_rate(name.c_str(), number_of_cells, "cells");
+    timingtools_print("Average number of iterations per cell: %g",
+                      number_of_iterations / double(number_of_cells));
+  }
+
+  // the grid level calculation normalizes the mean intensities and heating
+  // terms with the cell volume and the total photon weight, and converts the
+  // heating terms to energies using the Planck constant: we choose the total
+  // weight so that the first two factors cancel and compensate for the last
+  const double cell_volume = grid.begin().get_volume();
+  const double planck_constant =
+      PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_PLANCK);
+  TemperatureCalculator calculator(true, 3, 1., abundances, 1.e-3, 100, 1., 0.,
+                                   1., 0., data, rates, ctr);
+  timingtools_start_scaling_block("grid temperature calculation") {
+    uint_fast32_t index = 0;
+    for (auto it = grid.begin(); it != grid.end(); ++it) {
+      reset_cell(rows[index % rows.size()], it.get_ionization_variables(),
+                 planck_constant);
+      ++index;
+    }
+    timingtools_start_timing();
+    calculator.calculate_temperature(4, 1. / cell_volume, grid, block);
+    timingtools_stop_timing();
+  }
+  timingtools_end_scaling_block_rate("grid temperature calculation",
+                                     "timeTemperatureCalculator_scaling.txt",
+                                     number_of_cells, "cells");
+
+  return 0;
+}
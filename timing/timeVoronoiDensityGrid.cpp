@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2017 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeVoronoiDensityGrid.cpp
+ *
+ * @brief Timing test for photon traversal through a VoronoiDensityGrid.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "HomogeneousDensityFunction.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+#include "UniformRandomVoronoiGeneratorDistribution.hpp"
+#include "VoronoiDensityGrid.hpp"
+
+/**
+ * @brief Time the propagation of photons through a VoronoiDensityGrid of the
+ * given type.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeVoronoiDensityGrid", argc, argv);
+
+  const uint_fast32_t numgenerator = 100000;
+  const uint_fast32_t numphoton = 10000;
+
+  HomogeneousDensityFunction density_function(1., 8000.);
+  density_function.initialize();
+  const Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+
+  // set up the photon origins and directions
+  RandomGenerator random_generator(42);
+  std::vector< CoordinateVector<> > origins(numphoton);
+  std::vector< CoordinateVector<> > directions(numphoton);
+  for (uint_fast32_t i = 0; i < numphoton; ++i) {
+    origins[i][0] = random_generator.get_uniform_random_double();
+    origins[i][1] = random_generator.get_uniform_random_double();
+    origins[i][2] = random_generator.get_uniform_random_double();
+    const double cost =
+        2. * random_generator.get_uniform_random_double() - 1.;
+    const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+    const double phi = 2. * M_PI * random_generator.get_uniform_random_double();
+    directions[i][0] = sint * std::cos(phi);
+    directions[i][1] = sint * std::sin(phi);
+    directions[i][2] = cost;
+  }
+
+  const std::string types[2] = {"Old", "New"};
+  for (uint_fast8_t itype = 0; itype < 2; ++itype) {
+
+    timingtools_print_header("%s Voronoi grid (%" PRIuFAST32
+                             " generators, %" PRIuFAST32 " photons).",
+                             types[itype].c_str(), numgenerator, numphoton);
+
+    UniformRandomVoronoiGeneratorDistribution *generators =
+        new UniformRandomVoronoiGeneratorDistribution(box, numgenerator, 42);
+    VoronoiDensityGrid grid(generators, box, types[itype]);
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, grid.get_number_of_cells());
+    grid.initialize(block, density_function);
+
+    timingtools_start_timing_block("photon traversal") {
+      timingtools_start_timing();
+      for (uint_fast32_t i = 0; i < numphoton; ++i) {
+        Photon photon(origins[i], directions[i], 1.);
+        photon.set_cross_section(ION_H_n, 1.);
+        photon.set_cross_section(ION_He_n, 1.);
+        grid.interact(photon, 100.);
+      }
+      timingtools_stop_timing();
+    }
+    timingtools_end_timing_block("photon traversal");
+  }
+
+  return 0;
+}